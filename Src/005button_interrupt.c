@@ -77,7 +77,7 @@ int main(void)
 	// We will be using the external pull up resister.
 	//GpioBtn.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
 
-	GPIO_PeriClockControl(GPIOD, ENABLE);
+	// same port as the LED, its clock is already requested
 	GPIO_Init(&GpioBtn);
 
 	/*while(1)
@@ -97,6 +97,19 @@ int main(void)
 	// PD5 will sent its interrupt over EXTI5.
 	GPIO_IRQInterruptConfig(IRQ_NO_EXTI9_5, ENABLE);
 
+	// Nothing to do until the button is pressed: stay in Stop mode
+	// (low-power regulator), EXTI5 wakes the CPU up and the handler runs.
+	Pwr_Config_t PwrConfig;
+
+	memset(&PwrConfig, 0, sizeof(PwrConfig));
+	PwrConfig.Pwr_StopRegulator = PWR_REGULATOR_LOW_POWER;
+	Pwr_Init(&PwrConfig);
+
+	while(1)
+	{
+		Pwr_Idle(PWR_MODE_STOP);
+	}
+
 	return 0;
 }
 
@@ -122,7 +122,9 @@ int main(void)
 	SPI_SSIConfig(SPI2, ENABLE); // this makes NSS signal internally high and avoids MODF error
 
 	// Before sending the data, the SPI peripheral needs to be enabled.
+	// SPI_Init turned the clock on without holding it: take it for the transfer.
 	SPI_PeriClockControl(SPI2, ENABLE);
+	SPI_PeripheralControl(SPI2, ENABLE);
 
 	// user_data is of type char pointer, but you need uint8_t so typecast it
 	SPI_SendData(SPI2, (uint8_t*)user_data, strlen(user_data));
@@ -135,6 +137,8 @@ int main(void)
 	// All data is sent to the external world, so we have to disable the peripheral.
 	// After the last byte transmission, we close the SPI communication.
 	// So MOSI and CLK are pulled to high. That's the idle state.
+	// The last release gates the clock, the configuration stays.
+	SPI_PeripheralControl(SPI2, DISABLE);
 	SPI_PeriClockControl(SPI2, DISABLE);
 
 	while(1); // infinite while loop to hang the application
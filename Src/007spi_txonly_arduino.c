@@ -181,7 +181,9 @@ int main(void)
 		 * Enable the peripheral SPI and do the transmission only when button is pressed.
 		 ******************************************************************************/
 		// Before sending the data, the SPI peripheral needs to be enabled.
+		// The clock is held for the burst only: it is gated between button presses.
 		SPI_PeriClockControl(SPI2, ENABLE);
+		SPI_PeripheralControl(SPI2, ENABLE); // SSOE: NSS goes low
 
 		/******************************************************************************
 		 * Send the data
@@ -213,6 +215,7 @@ int main(void)
 		// If function returns 0, that means SPI is not busy. Loop will break and close the communication.
 		while(SPI_GetFlagStatus(SPI2, SPI_BUSY_FLAG));
 
+		SPI_PeripheralControl(SPI2, DISABLE); // NSS goes high, the slave takes the message
 		SPI_PeriClockControl(SPI2, DISABLE);
 	}
 
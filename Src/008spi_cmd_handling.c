@@ -1,6 +1,9 @@
 /*************************************************************************
  * We derived the pins. We will be using GPIO port B.
- * This code needs your driver APIs to transmit "Hello world" over MOSI line.
+ * On each button press the five commands of the Arduino slave (0x50..0x54)
+ * are sent through the SPI command engine (stm32f407xx_spicmd.h): one
+ * SpiCmd_Submit per command, ACK check, turnaround wait and NACK retry are
+ * done in the background (SPI2 interrupt, TIM6 scheduler tick).
  * We want to use MISO and NSS, b/c there is a Arduino slave.
  *
  * PB14 --> SPI2_MISO
@@ -12,19 +15,9 @@
 #include <string.h>
 // Do not forgot to include device specific header file.
 #include "stm32f407xx.h"
+#include "stm32f407xx_spicmd.h"
 
 #include <stdio.h>
-extern void initialise_monitor_handles();
-
-// Command codes that slave recognizes
-#define COMMAND_LED_CTRL		0x50
-#define COMMAND_SENSOR_READ		0x51
-#define COMMAND_LED_READ		0x52
-#define COMMAND_PRINT			0x53
-#define COMMAND_ID_READ			0x54
-
-#define LED_ON		1
-#define LED_OFF		0
 
 // Arduino analog pins
 #define ANALOG_PIN0		0
@@ -34,9 +27,16 @@ extern void initialise_monitor_handles();
 #define ANALOG_PIN4		4
 
 #define LED_PIN			9
+#define LED_ON			1
+#define LED_OFF			0
+
+#define TICK_HZ			1000
 
+static SPI_Handle_t SPI2handle;
+static TIM_Handle_t TIM6Handle;
+static SpiCmd_Engine_t CmdEngine;
 
-// time we are giving slave to be ready with data
+// time to let the button settle
 void delay(void)
 {
 	for(uint32_t i = 0; i < 500000/2; i++); // 200 ms of gap
@@ -91,8 +91,6 @@ void SPI2_GPIOInits(void)
 
 void SPI2_Inits(void)
 {
-	SPI_Handle_t SPI2handle;
-
 	// initialize base address of SPI peripheral
 	SPI2handle.pSPIx = SPI2;
 	// bus configuration is full duplex
@@ -188,26 +186,49 @@ void GPIO_LEDInit(void)
 	GPIO_Init(&GpioLed);
 }
 
-uint8_t SPI_VerifyResponse(uint8_t ackbyte)
+void TIM6_Inits(void)
 {
-	if(ackbyte == 0xF5)
-	{
-		// ack
-		return 1;
-	} // else nack so return 0
-	return 0;
+	// 1 ms scheduler tick: the engine waits for the slave with scheduler timers
+	memset(&TIM6Handle, 0, sizeof(TIM6Handle));
+	TIM6Handle.pTIMx = TIM6;
+	TIM6Handle.TIM_Config.TIM_Prescaler = (uint16_t)(TIM_GetClockValue(TIM6) / 1000000U - 1); // 1 MHz
+	TIM6Handle.TIM_Config.TIM_Period = 1000000U / TICK_HZ - 1;
+	TIM6Handle.TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+	TIM_Init(&TIM6Handle);
 }
 
-int main(void)
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle, uint8_t AppEv)
 {
-	// 007spi_txonly_arduino.c
-	// Let's create small user buffer.
-	// char user_data[] = "Hello world";
+	SpiCmd_EventHandling(&CmdEngine, pSPIHandle, AppEv);
+}
 
-	uint8_t dummy_write = 0xff;
-	uint8_t dummy_read;
+void TIM_ApplicationEventCallback(TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	if(pTIMHandle == &TIM6Handle && AppEv == TIM_EVENT_UPDATE)
+		Sched_Tick();
+}
 
-	initialise_monitor_handles();
+int main(void)
+{
+	static const char message[] = "Hello from the STM32";
+	uint8_t led_args[2] = { LED_PIN, LED_ON };
+	uint8_t sensor_args[1] = { ANALOG_PIN0 };
+	uint8_t led_read_args[1] = { LED_PIN };
+	uint8_t print_args[1 + sizeof(message)];
+	uint8_t analog_read, led_state, board_id[11];
+	SpiCmd_Request_t requests[5];
+	SpiCmd_Config_t CmdConfig;
+	Pwr_Config_t PwrConfig = {0};
+
+	// printf goes into the log ring buffer and out over SWO (ITM stimulus port 0).
+	// Semihosting (initialise_monitor_handles) halted the core on every printf.
+	Log_Config_t LogConfig = {0};
+	LogConfig.Log_Backend = LOG_BACKEND_ITM;
+	LogConfig.Log_ITMPort = 0;
+	Log_Init(&LogConfig);
+
+	Pwr_Init(&PwrConfig);
+	Sched_Init(PWR_MODE_SLEEP);
 
 	GPIO_ButtonInit();
 
@@ -218,25 +239,6 @@ int main(void)
 	SPI2_GPIOInits();
 	// This is the peripheral configuration.
 	SPI2_Inits();
-	// After completing this, the peripheral is not active.
-	// All the required configurations are loaded into the control registers of
-	// SPI peripherals, but that does not mean peripheral is enabled.
-	// You have to explicitly enable the SPI peripheral. For that we have a dedicated control bit 6 (SPE).
-	// The control bit is 0 or disabled by default.
-
-	// All configurations should be done when SPI peripheral is disabled.
-	// When you enable SPI peripheral, it will be busy in data communication, so the SPI peripheral
-	// will not accept any changes made.
-
-	/************************************************************************
-	 * SSI only makes sense when software slave management is enabled.
-	 ************************************************************************/
-	// Pulling NSS to ground indicates that some other master has taken over bus.
-	// The problem is keeping SSI to 0. It will solved by keeping SSI it 1.
-	// NSS will be connected to Vdd internally and we can avoid the mode fault error.
-	// The mode fault error happens ins multi-master configuration.
-	// We have to do before enabling the peripheral.
-	// SPI_SSIConfig(SPI2, ENABLE); // this makes NSS signal internally high and avoids MODF error
 
 	/************************************************************************
 	 * SSOE bit
@@ -244,153 +246,83 @@ int main(void)
 	 * The NSS pin is automatically managed by the hardware.
 	 * i.e when SPE=1, NSS will be pulled to low
 	 * and NSS pin will be high when SPE=0
+	 * The engine sets SPE for each command, so NSS frames every command.
 	 ************************************************************************/
-	//Before enabling the peripheral, let's make SSOE as 1.
 	SPI_SSOEConfig(SPI2, ENABLE);
-
-	while(1)// infinite while loop to hang the application
+	SPI_IRQInterruptConfig(IRQ_NO_SPI2, ENABLE);
+
+	TIM6_Inits();
+	TIM_IRQInterruptConfig(IRQ_NO_TIM6_DAC, ENABLE);
+	TIM_StartIT(&TIM6Handle);
+
+	memset(&CmdConfig, 0, sizeof(CmdConfig));
+	CmdConfig.pSPIHandle = &SPI2handle;
+	CmdConfig.pCmdTable = SpiCmd_ArduinoCmds;
+	CmdConfig.CmdCount = SPICMD_ARDUINO_NO_OF_CMDS;
+	CmdConfig.SpiCmd_MaxRetries = 2;
+	CmdConfig.SpiCmd_Priority = SCHED_PRI_HIGH;
+	SpiCmd_Init(&CmdEngine, &CmdConfig);
+
+	// CMD_PRINT <len> <message>
+	print_args[0] = sizeof(message) - 1;
+	memcpy(&print_args[1], message, sizeof(message) - 1);
+
+	memset(requests, 0, sizeof(requests));
+	requests[0].Opcode = SPICMD_LED_CTRL;
+	requests[0].pArgs = led_args;
+	requests[1].Opcode = SPICMD_SENSOR_READ;
+	requests[1].pArgs = sensor_args;
+	requests[1].pRsp = &analog_read;
+	requests[2].Opcode = SPICMD_LED_READ;
+	requests[2].pArgs = led_read_args;
+	requests[2].pRsp = &led_state;
+	requests[3].Opcode = SPICMD_PRINT;
+	requests[3].pArgs = print_args;
+	requests[3].ArgLen = 1 + print_args[0];
+	requests[4].Opcode = SPICMD_ID_READ;
+	requests[4].pRsp = board_id;
+
+	while(1)
 	{
-		while( ! GPIO_ReadFromInputPin(GPIOA, GPIO_PIN_NO_0)); // The code should go back and hang here.
-		// button is pressed if break out of while loop
+		while( ! GPIO_ReadFromInputPin(GPIOA, GPIO_PIN_NO_0)); // wait until button is pressed
 
 		// To avoid button de-bouncing related issues, 200ms of delay.
 		delay();
 
-		/******************************************************************************************************
-		 * 1. Enable the SPI peripheral and do the transmission only when button is pressed.
-		 ******************************************************************************************************/
-		SPI_PeriClockControl(SPI2, ENABLE); // Before sending the data, the SPI peripheral needs to be enabled.
-		/******************************************************************************************************
-		 * 2. Send first command
-		 *
-		 * CMD_LED_CTRL		<pin no(1)>		<value(1)>
-		 ******************************************************************************************************/
-		uint8_t commandcode = COMMAND_LED_CTRL; // 0x50
-		uint8_t ackbyte;
-		uint8_t args[2]; // arg[0] is pin number 9
-
-		// Send command.
-		SPI_SendData(SPI2, &commandcode, 1); // send only 1 byte
-		// When slave receives this, it will check whether or not command is supported or not.
-		// If slave supports this command, it will send ACK. So we have to now receive the ACK.
-		// Remember that in SPI communications, SPI will not initiate the data transfer
-		// so you have to send a dummy byte to the SPI and get that response back.
-		// The slave is read with ACK or NACK byte in its shift register, but if you want to move that
-		// data out of the slave shift register, you have to send some dummy byte.
-
-		// After sending the data(command code), the master is going receive something in return.
-		// For every transmission the master does, it is also going to receive one byte in return.
-		// You have to do dummy read. RXNE has been set and you have to clear that.
-
-		// do dummy read to clear off the RXNE
-		// When you read the data register, RXNE will automatically be cleared.
-		SPI_ReceiveData(SPI2, &dummy_read, 1);
-
-		// Send some dummy bits(1 byte of dummy data) to fetch the response from slave.
-		SPI_SendData(SPI2, &dummy_write, 1);
-
-		// Receive the data which arrived at the master.
-		SPI_ReceiveData(SPI2, &ackbyte, 1);
-
-		// Compare whether you received ACK or NACK.
-		// Call this function to see whether the ACK byte is valid or not.
-		// If response is ACK(true), then only send arguments.
-
-		// Fetch the ACK byte from slave using ackbyte variable.
-		if ( SPI_VerifyResponse(ackbyte) )
+		// One call per command, they run back to back in the background.
+		for(uint8_t i = 0; i < 5; i++)
+			SpiCmd_Submit(&CmdEngine, &requests[i]);
+
+		while(SpiCmd_Busy(&CmdEngine))
 		{
-			// send other arguments of this command, pin number and value
-			args[0] = LED_PIN; // we are going to connect LED to 9th pin of Arduino
-			args[1] = LED_ON;
-			// send data to the slave, you send args which is two bytes
-			SPI_SendData(SPI2, args, 2);
+			if(!Sched_RunOnce())
+				Pwr_Idle(PWR_MODE_SLEEP);
 		}
-		// end of COMMAND_LED_CTRL
-
-		/**************************************************
-		 * CMD_SENSOR_READ	<analog pin number(1)>
-		 *
-		 * Connect analog pin to 5V and 3.3V.
-		 * When reading 5V, it should be 255.
-		 * When reading 3.3V, it should be 170.
-		 **************************************************/
-
-		// wait until button is pressed
-		while( ! GPIO_ReadFromInputPin(GPIOA, GPIO_PIN_NO_0));
-		// button is pressed if break out of while loop
-
-		// To avoid button de-bouncing related issues, 200ms of delay.
-		delay();
-
-		commandcode = COMMAND_SENSOR_READ; // 0x51
-
-		// Send command.
-		SPI_SendData(SPI2, &commandcode, 1); // send only 1 byte
-
-		// do dummy read to clear off the RXNE
-		// When you read the data register, RXNE will automatically be cleared.
-		SPI_ReceiveData(SPI2, &dummy_read, 1);
-
-		// Send some dummy bits(1 byte of dummy data) to fetch the response from slave.
-		SPI_SendData(SPI2, &dummy_write, 1);
 
-		// Receive the data which arrived at the master.
-		SPI_ReceiveData(SPI2, &ackbyte, 1);
-
-		// Compare whether you received ACK or NACK.
-		// Call this function to see whether the ACK byte is valid or not.
-		// If response is ACK(true), then only send arguments.
-
-		// ONLY IF WE RECEIVE ACK, we should implement IF code.
-		// Fetch the ACK byte from slave using ackbyte variable.
-		if ( SPI_VerifyResponse(ackbyte) )
+		printf("LED_CTRL %u, PRINT %u\n", requests[0].Status, requests[3].Status);
+		if(requests[1].Status == SPICMD_STATUS_OK)
+			printf("Analog read %u\n", analog_read);
+		if(requests[2].Status == SPICMD_STATUS_OK)
+			printf("LED state %u\n", led_state);
+		if(requests[4].Status == SPICMD_STATUS_OK)
 		{
-			// send other arguments of this command, pin number
-			args[0] = ANALOG_PIN0; // we are going to connect LED to 9th pin of Arduino
-			// send data to the slave, you send args which is one byte
-			SPI_SendData(SPI2, args, 1); // send only 1 byte
-
-			// Send always results in reception, so we are reading the data register to clear off the RXNE.
-			// do a dummy read to clear off the RXNE b/c we have transmitted in IF block
-			// When you read the data register, RXNE will automatically be cleared.
-			SPI_ReceiveData(SPI2, &dummy_read, 1);
-
-			// Slave is busy in ADC conversion, b/c that is analog read.
-			// This will take some microseconds. But we are immediately asking slave for data and that is not good.
-			// So insert some delay so that slave can be ready with the data.
-			delay();
-
-
-			// Transmit the dummy byte in order to receive response (fetch the analog sensor value)
-			// Send some dummy bits(1 byte of dummy data) to fetch the response(acknowledgment) from slave.
-			SPI_SendData(SPI2, &dummy_write, 1);
-
-			uint8_t analog_read;
-			SPI_ReceiveData(SPI2, &analog_read, 1);
+			board_id[10] = '\0';
+			printf("Board id %s\n", (char*)board_id);
 		}
-		// end of COMMAND_SENSOR_READ
-
-		/*************************************************************************
-		 * Disable peripheral SPI
-		 * Whenever the SPI is busy in communication, the busy flag of SPI peripheral will be HIGH.
-		 * The busy flag BSY can be found in the status register.
-		 * If flag is 0, that means not busy. Its shift registers are actually at rest.
-		 * If equal to 1, SPI is busy in communication.
-		 *
-		 * This flag is set and cleared by the hardware so you don't need to worry about it.
-		 * But before closing the SPI communication, you need to first check this flag.
-		 * If this flag is 0, then you close the communication.
-		 *************************************************************************/
-		// All data is sent to the external world, so we have to disable the peripheral.
-		// After the last byte transmission, we close the SPI communication.
-		// So MOSI and CLK are pulled to high. That's the idle state.
-
-		// Let's confirm SPI flag is not busy.
-		// If this function keeps returning 1, that means SPI is busy.
-		// If function returns 0, that means SPI is not busy. Loop will break and close the communication.
-		while(SPI_GetFlagStatus(SPI2, SPI_BUSY_FLAG));
-		SPI_PeriClockControl(SPI2, DISABLE);
 	}
 
 	return 0;
 }
+
+/***************************************************
+ * Interrupt handlers
+ ***************************************************/
+void SPI2_IRQHandler(void)
+{
+	SPI_IRQHandling(&SPI2handle);
+}
+
+void TIM6_DAC_IRQHandler(void)
+{
+	TIM_IRQHandling(&TIM6Handle);
+}
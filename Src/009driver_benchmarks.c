@@ -0,0 +1,340 @@
+/*************************************************************************
+ * Driver micro-benchmarks
+ *
+ * Measures the CPU cycles (DWT cycle counter) of the driver APIs and prints
+ * one "benchmark,cycles" line per measurement (CSV), so the results can be
+ * compared against stored baselines.
+ *
+ * Target: the output goes over SWO (ITM stimulus port 0). No wiring needed,
+ * the SPI runs as master with software NSS and nothing connected, the EXTI
+ * interrupt is triggered by software (SWIER), the software SPI clocks out on
+ * PE2/PE3 and reads PE4, the keypad drives PC0..PC7 and reads PB8..PB15.
+ *
+ * Host: the same program runs on the peripheral simulator, where the cycle
+ * counter follows the modelled cost of the register accesses:
+ *   make -C host bench			print the results
+ *   make -C host bench-check	compare with host/bench_baseline.csv
+ *
+ * Every measurement is repeated BENCH_REPEAT times and the minimum is
+ * reported (interrupts and flash wait states on the target only add).
+ * The cost of reading the cycle counter is subtracted.
+ **************************************************************************/
+#include <string.h>
+#include <stdio.h>
+// Do not forgot to include device specific header file.
+#include "stm32f407xx.h"
+#include "stm32f407xx_softspi.h"
+#include "stm32f407xx_keypad.h"
+
+#define BENCH_REPEAT			5
+#define BENCH_GPIO_ITERATIONS	16
+#define BENCH_EXTI_ITERATIONS	8
+#define BENCH_SPI_MAX_LEN		256
+
+/*
+ * Runs Code Iterations times, BENCH_REPEAT rounds, and reports the fastest
+ * round in cycles per iteration.
+ */
+#define BENCH(Name, Iterations, Code)											\
+	do {																		\
+		uint32_t best = 0xFFFFFFFF;												\
+		for(uint32_t round = 0; round < BENCH_REPEAT; round++)					\
+		{																		\
+			uint32_t start = *DWT_CYCCNT;										\
+			for(uint32_t iteration = 0; iteration < (Iterations); iteration++)	\
+			{																	\
+				Code;															\
+			}																	\
+			uint32_t cycles = *DWT_CYCCNT - start - bench_overhead;				\
+			if(cycles < best)													\
+				best = cycles;													\
+		}																		\
+		bench_report((Name), best / (Iterations));								\
+	} while(0)
+
+static uint32_t bench_overhead;				// cycles of two back to back counter reads
+static __vo uint32_t bench_isr_cycle;		// counter value at the start of the EXTI0 handler
+static __vo uint32_t bench_isr_count;
+
+static uint8_t bench_tx[BENCH_SPI_MAX_LEN];
+static uint8_t bench_rx[BENCH_SPI_MAX_LEN];
+
+static void bench_report(const char *pName, uint32_t Cycles)
+{
+	printf("%s,%lu\n", pName, (unsigned long)Cycles);
+#ifndef STM32_HOST_SIM
+	// keep the log ring buffer from overflowing (outside the measurements)
+	while(Log_Pending())
+		Log_Process();
+#endif
+}
+
+static void bench_cycle_counter_init(void)
+{
+	uint32_t start;
+
+	*DEMCR |= (1 << DEMCR_TRCENA);
+	*DWT_CYCCNT = 0;
+	*DWT_CTRL |= (1 << DWT_CTRL_CYCCNTENA);
+
+	start = *DWT_CYCCNT;
+	bench_overhead = *DWT_CYCCNT - start;
+}
+
+/*********************************************************************************
+ * GPIO: PD12 (LED) as output, PA0 (user button) as falling edge interrupt
+ *********************************************************************************/
+static void bench_gpio(void)
+{
+	GPIO_Handle_t GpioLed, GpioBtn;
+	uint16_t port;
+
+	memset(&GpioLed, 0, sizeof(GpioLed));
+	GpioLed.pGPIOx = GPIOD;
+	GpioLed.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_12;
+	GpioLed.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	GpioLed.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	GpioLed.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	GpioLed.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+
+	memset(&GpioBtn, 0, sizeof(GpioBtn));
+	GpioBtn.pGPIOx = GPIOA;
+	GpioBtn.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_0;
+	GpioBtn.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IT_FT;
+	GpioBtn.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	GpioBtn.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+
+	GPIO_PeriClockControl(GPIOD, ENABLE);
+	GPIO_PeriClockControl(GPIOA, ENABLE);
+
+	BENCH("gpio_init_output", BENCH_GPIO_ITERATIONS, GPIO_Init(&GpioLed));
+	BENCH("gpio_init_exti", BENCH_GPIO_ITERATIONS, GPIO_Init(&GpioBtn));
+	BENCH("gpio_write_pin", BENCH_GPIO_ITERATIONS, GPIO_WriteToOutputPin(GPIOD, GPIO_PIN_NO_12, iteration & 1));
+	BENCH("gpio_toggle_pin", BENCH_GPIO_ITERATIONS, GPIO_ToggleOutputPin(GPIOD, GPIO_PIN_NO_12));
+	port = GPIO_ReadFromInputPort(GPIOD);
+	BENCH("gpio_write_port", BENCH_GPIO_ITERATIONS, GPIO_WriteToOutputPort(GPIOD, port));
+	BENCH("gpio_read_pin", BENCH_GPIO_ITERATIONS, (void)GPIO_ReadFromInputPin(GPIOA, GPIO_PIN_NO_0));
+	BENCH("gpio_read_port", BENCH_GPIO_ITERATIONS, (void)GPIO_ReadFromInputPort(GPIOA));
+
+	GPIO_WriteToOutputPin(GPIOD, GPIO_PIN_NO_12, GPIO_PIN_RESET);
+}
+
+/*********************************************************************************
+ * EXTI: software trigger of line 0 -> EXTI0_IRQHandler
+ *
+ * exti_dispatch_latency:	SWIER write until the first handler statement
+ * exti_roundtrip:			SWIER write until back in thread mode (handler
+ * 							with GPIO_IRQHandling included)
+ *********************************************************************************/
+void EXTI0_IRQHandler(void)
+{
+	bench_isr_cycle = *DWT_CYCCNT;
+	GPIO_IRQHandling(GPIO_PIN_NO_0);
+	bench_isr_count++;
+}
+
+static void bench_exti(void)
+{
+	uint32_t latency = 0xFFFFFFFF;
+	uint32_t roundtrip = 0xFFFFFFFF;
+
+	GPIO_IRQPriorityConfig(IRQ_NO_EXTI0, NVIC_IRQ_PRI15);
+	GPIO_IRQInterruptConfig(IRQ_NO_EXTI0, ENABLE);
+
+	for(uint32_t i = 0; i < BENCH_EXTI_ITERATIONS; i++)
+	{
+		uint32_t count = bench_isr_count;
+		uint32_t start = *DWT_CYCCNT;
+
+		EXTI->SWIER = (1 << GPIO_PIN_NO_0);
+		while(bench_isr_count == count);
+
+		uint32_t end = *DWT_CYCCNT;
+
+		if(bench_isr_cycle - start - bench_overhead < latency)
+			latency = bench_isr_cycle - start - bench_overhead;
+		if(end - start - bench_overhead < roundtrip)
+			roundtrip = end - start - bench_overhead;
+	}
+
+	GPIO_IRQInterruptConfig(IRQ_NO_EXTI0, DISABLE);
+
+	bench_report("exti_dispatch_latency", latency);
+	bench_report("exti_roundtrip", roundtrip);
+}
+
+/*********************************************************************************
+ * SPI2 master, full duplex, software NSS
+ *
+ * spi_send_<dff>_<div>_len<n>:	SPI_SendData of n bytes until BSY is cleared
+ * spi_recv_<dff>_<div>_len<n>:	n bytes received, one dummy frame sent and
+ * 								one frame received per SPI_SendData /
+ * 								SPI_ReceiveData call (the usual master read)
+ *********************************************************************************/
+static void bench_spi_config(uint8_t SclkSpeed, uint8_t DFF)
+{
+	SPI_Handle_t SPI2handle;
+
+	memset(&SPI2handle, 0, sizeof(SPI2handle));
+	SPI2handle.pSPIx = SPI2;
+	SPI2handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	SPI2handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	SPI2handle.SPIConfig.SPI_SclkSpeed = SclkSpeed;
+	SPI2handle.SPIConfig.SPI_DFF = DFF;
+	SPI2handle.SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+	SPI2handle.SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+	SPI2handle.SPIConfig.SPI_SSM = SPI_SSM_EN;
+
+	SPI_PeriClockControl(SPI2, ENABLE);
+	SPI_PeripheralControl(SPI2, DISABLE);
+	SPI_Init(&SPI2handle);
+	SPI_SSIConfig(SPI2, ENABLE);
+	SPI_PeripheralControl(SPI2, ENABLE);
+}
+
+static void bench_spi_flush(void)
+{
+	uint32_t dummy;
+
+	while(SPI_GetFlagStatus(SPI2, SPI_BUSY_FLAG));
+	// clears RXNE and OVR left by the transmit only transfers
+	dummy = SPI2->SPI_DR;
+	dummy = SPI2->SPI_SR;
+	(void)dummy;
+}
+
+static void bench_spi_receive(uint32_t Len, uint32_t FrameSize)
+{
+	for(uint32_t i = 0; i < Len; i += FrameSize)
+	{
+		SPI_SendData(SPI2, &bench_tx[i], FrameSize);
+		SPI_ReceiveData(SPI2, &bench_rx[i], FrameSize);
+	}
+}
+
+static void bench_spi(void)
+{
+	static const uint8_t dividers[] = { SPI_SCLK_SPEED_DIV2, SPI_SCLK_SPEED_DIV8, SPI_SCLK_SPEED_DIV64 };
+	static const uint32_t lengths[] = { 2, 16, BENCH_SPI_MAX_LEN };
+	char name[48];
+
+	for(uint32_t i = 0; i < BENCH_SPI_MAX_LEN; i++)
+		bench_tx[i] = (uint8_t)i;
+
+	for(uint8_t dff = SPI_DFF_8BITS; dff <= SPI_DFF_16BITS; dff++)
+	{
+		uint32_t frame = (dff == SPI_DFF_16BITS) ? 2 : 1;
+
+		for(uint32_t d = 0; d < sizeof(dividers); d++)
+		{
+			bench_spi_config(dividers[d], dff);
+
+			for(uint32_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+			{
+				snprintf(name, sizeof(name), "spi_send_%ubit_div%u_len%lu", 8U * frame,
+						2U << dividers[d], (unsigned long)lengths[l]);
+				BENCH(name, 1, SPI_SendData(SPI2, bench_tx, lengths[l]);
+						while(SPI_GetFlagStatus(SPI2, SPI_BUSY_FLAG)));
+				bench_spi_flush();
+
+				snprintf(name, sizeof(name), "spi_recv_%ubit_div%u_len%lu", 8U * frame,
+						2U << dividers[d], (unsigned long)lengths[l]);
+				BENCH(name, 1, bench_spi_receive(lengths[l], frame));
+				bench_spi_flush();
+			}
+		}
+	}
+
+	SPI_PeripheralControl(SPI2, DISABLE);
+}
+
+/*********************************************************************************
+ * Software SPI: SCK PE2, MOSI PE3 (or PD3: two ports), MISO PE4
+ *
+ * softspi_mode<n>_len16:			16 bytes full duplex, SCK and MOSI on one port
+ * softspi_twoport_mode0_len16:		the same with MOSI on another port
+ *********************************************************************************/
+static void bench_softspi(void)
+{
+	SoftSpi_Handle_t soft;
+	SoftSpi_Config_t config;
+	char name[48];
+
+	memset(&config, 0, sizeof(config));
+	config.pSckPort = GPIOE;
+	config.SckPin = GPIO_PIN_NO_2;
+	config.pMosiPort = GPIOE;
+	config.MosiPin = GPIO_PIN_NO_3;
+	config.pMisoPort = GPIOE;
+	config.MisoPin = GPIO_PIN_NO_4;
+
+	for(uint8_t mode = 0; mode < 4; mode++)
+	{
+		config.SoftSpi_CPOL = (mode >> 1) & 1;
+		config.SoftSpi_CPHA = mode & 1;
+		SoftSpi_Init(&soft, &config);
+		snprintf(name, sizeof(name), "softspi_mode%u_len16", mode);
+		BENCH(name, 1, SoftSpi_Transfer(&soft, bench_tx, bench_rx, 16));
+	}
+
+	config.SoftSpi_CPOL = SPI_CPOL_LOW;
+	config.SoftSpi_CPHA = SPI_CPHA_LOW;
+	config.pMosiPort = GPIOD;
+	SoftSpi_Init(&soft, &config);
+	BENCH("softspi_twoport_mode0_len16", 1, SoftSpi_Transfer(&soft, bench_tx, bench_rx, 16));
+}
+
+/*********************************************************************************
+ * Keypad: 8 x 8 matrix, rows PC0..PC7, columns PB8..PB15, no keys
+ *
+ * keypad_scan_row:		one Keypad_Scan call (a timer tick), average
+ * keypad_scan_8x8:		the 8 calls of a full scan, with the debouncer
+ *********************************************************************************/
+static void bench_keypad(void)
+{
+	Keypad_Handle_t keypad;
+	Keypad_Config_t config;
+
+	memset(&config, 0, sizeof(config));
+	for(uint8_t r = 0; r < 8; r++)
+	{
+		config.Row[r].pGPIOx = GPIOC;
+		config.Row[r].PinNumber = r;
+	}
+	config.Rows = 8;
+	config.pColPort = GPIOB;
+	config.ColPin = GPIO_PIN_NO_8;
+	config.Cols = 8;
+	Keypad_Init(&keypad, &config);
+
+	BENCH("keypad_scan_row", 8, Keypad_Scan(&keypad));
+	BENCH("keypad_scan_8x8", 1, for(uint8_t r = 0; r < 8; r++) Keypad_Scan(&keypad));
+}
+
+int main(void)
+{
+#ifndef STM32_HOST_SIM
+	Log_Config_t LogConfig = {0};
+	LogConfig.Log_Backend = LOG_BACKEND_ITM;
+	LogConfig.Log_ITMPort = 0;
+	Log_Init(&LogConfig);
+#endif
+
+	bench_cycle_counter_init();
+
+	printf("# stm32f407xx driver benchmarks, HCLK %lu Hz, cycles per operation\n",
+			(unsigned long)RCC_GetHCLKValue());
+	printf("benchmark,cycles\n");
+
+	bench_gpio();
+	bench_exti();
+	bench_spi();
+	bench_softspi();
+	bench_keypad();
+
+#ifdef STM32_HOST_SIM
+	return 0;
+#else
+	while(1);
+#endif
+}
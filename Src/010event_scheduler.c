@@ -0,0 +1,194 @@
+/*************************************************************************
+ * Event driven main loop
+ *
+ * Nothing in here waits: the button (PA0, EXTI0), the SPI2 transfer
+ * (interrupt mode) and a 1 ms time base (TIM6) post events, the scheduler
+ * runs their handlers one after the other and sleeps in between.
+ *
+ * - PD12 blinks every 500 ms (periodic timer)
+ * - a button press is debounced for 20 ms (one-shot timer), then the
+ *   command 0x50 (LED control) is sent to the SPI2 slave
+ * - PD13 toggles when the SPI2 transfer is complete
+ *
+ * PB13 --> SPI2_SCLK
+ * PB15 --> SPI2_MOSI
+ * PB12 --> SPI2_NSS (software slave management, not driven)
+ **************************************************************************/
+#include <string.h>
+// Do not forgot to include device specific header file.
+#include "stm32f407xx.h"
+
+#define COMMAND_LED_CTRL		0x50
+#define LED_PIN					9
+#define LED_ON					1
+
+#define TICK_HZ					1000
+#define BLINK_TICKS				500
+#define DEBOUNCE_TICKS			20
+
+static SPI_Handle_t SPI2Handle;
+static TIM_Handle_t TIM6Handle;
+static Sched_Timer_t BlinkTimer, DebounceTimer;
+
+static uint8_t Command[3] = { COMMAND_LED_CTRL, LED_PIN, LED_ON };
+
+/***************************************************
+ * Event handlers (run from Sched_Run)
+ ***************************************************/
+static void Blink(uint32_t Arg)
+{
+	(void)Arg;
+	GPIO_ToggleOutputPin(GPIOD, GPIO_PIN_NO_12);
+}
+
+static void ButtonDebounced(uint32_t Arg)
+{
+	(void)Arg;
+
+	// still pressed after the debounce time, and SPI2 is free
+	if(GPIO_ReadFromInputPin(GPIOA, GPIO_PIN_NO_0) == 1)
+		SPI_SendDataIT(&SPI2Handle, Command, sizeof(Command));
+}
+
+static void ButtonPressed(uint32_t Arg)
+{
+	(void)Arg;
+	Sched_TimerStart(&DebounceTimer, DEBOUNCE_TICKS, 0);
+}
+
+static void SpiDone(uint32_t Arg)
+{
+	if(Arg == SPI_EVENT_TX_CMPLT)
+		GPIO_ToggleOutputPin(GPIOD, GPIO_PIN_NO_13);
+}
+
+/***************************************************
+ * Driver callbacks (interrupt context): post only
+ ***************************************************/
+void GPIO_ApplicationEventCallback(uint8_t PinNumber)
+{
+	if(PinNumber == GPIO_PIN_NO_0)
+		Sched_Post(ButtonPressed, 0, SCHED_PRI_HIGH);
+}
+
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	if(pSPIHandle == &SPI2Handle)
+		Sched_Post(SpiDone, AppEv, SCHED_PRI_HIGHEST);
+}
+
+void TIM_ApplicationEventCallback(TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	if(pTIMHandle == &TIM6Handle && AppEv == TIM_EVENT_UPDATE)
+		Sched_Tick();
+}
+
+/***************************************************
+ * Initialization
+ ***************************************************/
+static void GPIO_Inits(void)
+{
+	GPIO_Handle_t GpioPin;
+
+	memset(&GpioPin, 0, sizeof(GpioPin));
+
+	// LEDs
+	GpioPin.pGPIOx = GPIOD;
+	GpioPin.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	GpioPin.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_LOW;
+	GpioPin.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	GpioPin.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	GpioPin.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_12;
+	GPIO_Init(&GpioPin);
+	GpioPin.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_13;
+	GPIO_Init(&GpioPin);
+
+	// user button, external pull down, rising edge when pressed
+	GpioPin.pGPIOx = GPIOA;
+	GpioPin.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_0;
+	GpioPin.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IT_RT;
+	GpioPin.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	GPIO_Init(&GpioPin);
+
+	// SPI2 SCLK and MOSI
+	GpioPin.pGPIOx = GPIOB;
+	GpioPin.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_ALTFN;
+	GpioPin.GPIO_PinConfig.GPIO_PinAltFunMode = 5;
+	GpioPin.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_13;
+	GPIO_Init(&GpioPin);
+	GpioPin.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_15;
+	GPIO_Init(&GpioPin);
+}
+
+static void SPI2_Inits(void)
+{
+	memset(&SPI2Handle, 0, sizeof(SPI2Handle));
+	SPI2Handle.pSPIx = SPI2;
+	SPI2Handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	SPI2Handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	SPI2Handle.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV8;
+	SPI2Handle.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	SPI2Handle.SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+	SPI2Handle.SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+	SPI2Handle.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI_Init(&SPI2Handle);
+
+	SPI_SSIConfig(SPI2, ENABLE);
+	SPI_PeripheralControl(SPI2, ENABLE);
+}
+
+static void TIM6_Inits(void)
+{
+	memset(&TIM6Handle, 0, sizeof(TIM6Handle));
+	TIM6Handle.pTIMx = TIM6;
+	TIM6Handle.TIM_Config.TIM_Prescaler = (uint16_t)(TIM_GetClockValue(TIM6) / 1000000U - 1); // 1 MHz
+	TIM6Handle.TIM_Config.TIM_Period = 1000000U / TICK_HZ - 1;
+	TIM6Handle.TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+	TIM_Init(&TIM6Handle);
+}
+
+int main(void)
+{
+	Pwr_Config_t PwrConfig;
+
+	memset(&PwrConfig, 0, sizeof(PwrConfig));
+	Pwr_Init(&PwrConfig);
+
+	// The tick timer must run while the CPU sleeps, so Sleep is the deepest mode.
+	Sched_Init(PWR_MODE_SLEEP);
+
+	GPIO_Inits();
+	SPI2_Inits();
+	TIM6_Inits();
+
+	Sched_TimerInit(&BlinkTimer, Blink, 0, SCHED_PRI_LOW);
+	Sched_TimerInit(&DebounceTimer, ButtonDebounced, 0, SCHED_PRI_HIGH);
+	Sched_TimerStart(&BlinkTimer, BLINK_TICKS, BLINK_TICKS);
+
+	GPIO_IRQInterruptConfig(IRQ_NO_EXTI0, ENABLE);
+	SPI_IRQInterruptConfig(IRQ_NO_SPI2, ENABLE);
+	TIM_IRQInterruptConfig(IRQ_NO_TIM6_DAC, ENABLE);
+	TIM_StartIT(&TIM6Handle);
+
+	Sched_Run();
+
+	return 0;
+}
+
+/***************************************************
+ * Interrupt handlers
+ ***************************************************/
+void EXTI0_IRQHandler(void)
+{
+	GPIO_IRQHandling(GPIO_PIN_NO_0);
+}
+
+void SPI2_IRQHandler(void)
+{
+	SPI_IRQHandling(&SPI2Handle);
+}
+
+void TIM6_DAC_IRQHandler(void)
+{
+	TIM_IRQHandling(&TIM6Handle);
+}
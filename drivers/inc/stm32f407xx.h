@@ -24,6 +24,70 @@
 #define NVIC_PR_BASE_ADDR		((__vo uint32_t*)0xE000E400)
 
 #define NO_PR_BITS_IMPLEMENTED					4
+
+/***************************************************************************
+ * ARM Cortex MX Processor debug and trace register addresses
+ ***************************************************************************/
+#define ITM_BASEADDR			0xE0000000U
+#define DEMCR					((__vo uint32_t*)0xE000EDFC) // Debug Exception and Monitor Control Register
+
+#define DWT_CTRL				((__vo uint32_t*)0xE0001000) // Data Watchpoint and Trace control register
+#define DWT_CYCCNT				((__vo uint32_t*)0xE0001004) // cycle counter (CPU clock)
+
+#define DEMCR_TRCENA			24 // global enable for DWT and ITM
+#define DWT_CTRL_CYCCNTENA		0  // enable the cycle counter
+
+/***************************************************************************
+ * ARM Cortex MX Processor system control register (sleep configuration)
+ ***************************************************************************/
+#define SCB_SCR					((__vo uint32_t*)0xE000ED10)
+
+#define SCB_SCR_SLEEPONEXIT		1
+#define SCB_SCR_SLEEPDEEP		2
+
+/***************************************************************************
+ * ARM Cortex MX Processor intrinsics
+ * (PRIMASK based critical sections, barriers and wait for interrupt)
+ ***************************************************************************/
+#ifdef STM32_HOST_SIM
+/*
+ * Host build (host/Makefile): the peripheral simulator keeps PRIMASK and
+ * delivers the interrupts, see host/stm32_sim.h
+ */
+uint32_t sim_get_primask(void);
+void sim_set_primask(uint32_t primask);
+
+#define __get_PRIMASK()			sim_get_primask()
+#define __set_PRIMASK(primask)	sim_set_primask(primask)
+#define __disable_irq()			sim_set_primask(1)
+#define __enable_irq()			sim_set_primask(0)
+#define __DMB()					__sync_synchronize()
+#define __DSB()					__sync_synchronize()
+#define __ISB()					__sync_synchronize()
+
+void sim_wfi(void);
+
+#define __WFI()					sim_wfi()
+#else
+static inline uint32_t __get_PRIMASK(void)
+{
+	uint32_t primask;
+	__asm volatile ("MRS %0, primask" : "=r" (primask));
+	return primask;
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+	__asm volatile ("MSR primask, %0" : : "r" (primask) : "memory");
+}
+
+#define __disable_irq()			__asm volatile ("cpsid i" : : : "memory")
+#define __enable_irq()			__asm volatile ("cpsie i" : : : "memory")
+#define __DMB()					__asm volatile ("dmb 0xF" : : : "memory")
+#define __DSB()					__asm volatile ("dsb 0xF" : : : "memory")
+#define __ISB()					__asm volatile ("isb 0xF" : : : "memory")
+#define __WFI()					__asm volatile ("wfi" : : : "memory")
+#endif /* STM32_HOST_SIM */
 /**********************************************************************
  * Define base addresses for FLASH, SRAMs and system memory(ROM)
  **********************************************************************/
@@ -57,6 +121,8 @@
 #define GPIOH_BASEADDR			(AHB1PERIPH_BASEADDR + 0x1C00)
 #define GPIOI_BASEADDR			(AHB1PERIPH_BASEADDR + 0x2000)
 #define RCC_BASEADDR			(AHB1PERIPH_BASEADDR + 0x3800)
+#define DMA1_BASEADDR			(AHB1PERIPH_BASEADDR + 0x6000)
+#define DMA2_BASEADDR			(AHB1PERIPH_BASEADDR + 0x6400)
 
 /**********************************************************************
  * Define base addresses for peripherals which are hanging on APB1 bus
@@ -70,6 +136,16 @@
 #define USART3_BASEADDR			(APB1PERIPH_BASEADDR + 0x4800)
 #define UART4_BASEADDR			(APB1PERIPH_BASEADDR + 0x4C00)
 #define UART5_BASEADDR			(APB1PERIPH_BASEADDR + 0x5000)
+#define TIM2_BASEADDR			(APB1PERIPH_BASEADDR + 0x0000)
+#define TIM3_BASEADDR			(APB1PERIPH_BASEADDR + 0x0400)
+#define TIM4_BASEADDR			(APB1PERIPH_BASEADDR + 0x0800)
+#define TIM5_BASEADDR			(APB1PERIPH_BASEADDR + 0x0C00)
+#define TIM6_BASEADDR			(APB1PERIPH_BASEADDR + 0x1000)
+#define TIM7_BASEADDR			(APB1PERIPH_BASEADDR + 0x1400)
+#define TIM12_BASEADDR			(APB1PERIPH_BASEADDR + 0x1800)
+#define TIM13_BASEADDR			(APB1PERIPH_BASEADDR + 0x1C00)
+#define TIM14_BASEADDR			(APB1PERIPH_BASEADDR + 0x2000)
+#define PWR_BASEADDR			(APB1PERIPH_BASEADDR + 0x7000)
 
 /**********************************************************************
  * Define base addresses for peripherals which are hanging on APB2 bus
@@ -80,6 +156,15 @@
 #define USART1_BASEADDR			(APB2PERIPH_BASEADDR + 0x1000)
 #define USART6_BASEADDR			(APB2PERIPH_BASEADDR + 0x1400)
 #define SYSCFG_BASEADDR			(APB2PERIPH_BASEADDR + 0x3800)
+#define TIM1_BASEADDR			(APB2PERIPH_BASEADDR + 0x0000)
+#define TIM8_BASEADDR			(APB2PERIPH_BASEADDR + 0x0400)
+#define TIM9_BASEADDR			(APB2PERIPH_BASEADDR + 0x4000)
+#define TIM10_BASEADDR			(APB2PERIPH_BASEADDR + 0x4400)
+#define TIM11_BASEADDR			(APB2PERIPH_BASEADDR + 0x4800)
+#define ADC1_BASEADDR			(APB2PERIPH_BASEADDR + 0x2000)
+#define ADC2_BASEADDR			(APB2PERIPH_BASEADDR + 0x2100)
+#define ADC3_BASEADDR			(APB2PERIPH_BASEADDR + 0x2200)
+#define ADC_COMMON_BASEADDR		(APB2PERIPH_BASEADDR + 0x2300)
 
 /*********************************************************************
  * Create peripheral register definition structure for GPIO
@@ -182,6 +267,136 @@ typedef struct
 	__vo uint32_t SPI_I2SPR;			//  SPI_I2S prescaler register, address offset: 0x20
 } SPI_RegDef_t;
 
+/*********************************************************************************
+ * Create peripheral register definition structure for I2C
+ *********************************************************************************/
+typedef struct
+{
+	__vo uint32_t CR1;				//  Control register 1, address offset: 0x00
+	__vo uint32_t CR2;				//  Control register 2, address offset: 0x04
+	__vo uint32_t OAR1;				//  Own address register 1, address offset: 0x08
+	__vo uint32_t OAR2;				//  Own address register 2, address offset: 0x0C
+	__vo uint32_t DR;				//  Data register, address offset: 0x10
+	__vo uint32_t SR1;				//  Status register 1, address offset: 0x14
+	__vo uint32_t SR2;				//  Status register 2, address offset: 0x18
+	__vo uint32_t CCR;				//  Clock control register, address offset: 0x1C
+	__vo uint32_t TRISE;			//  TRISE register, address offset: 0x20
+	__vo uint32_t FLTR;				//  FLTR register, address offset: 0x24
+} I2C_RegDef_t;
+
+/*********************************************************************************
+ * Create peripheral register definition structure for DMA
+ *********************************************************************************/
+typedef struct
+{
+	__vo uint32_t CR;				//  DMA stream x configuration register, address offset: 0x10 + 0x18 * x
+	__vo uint32_t NDTR;				//  DMA stream x number of data register, address offset: 0x14 + 0x18 * x
+	__vo uint32_t PAR;				//  DMA stream x peripheral address register, address offset: 0x18 + 0x18 * x
+	__vo uint32_t M0AR;				//  DMA stream x memory 0 address register, address offset: 0x1C + 0x18 * x
+	__vo uint32_t M1AR;				//  DMA stream x memory 1 address register, address offset: 0x20 + 0x18 * x
+	__vo uint32_t FCR;				//  DMA stream x FIFO control register, address offset: 0x24 + 0x18 * x
+} DMA_Stream_RegDef_t;
+
+typedef struct
+{
+	__vo uint32_t LISR;				//  DMA low interrupt status register, address offset: 0x00
+	__vo uint32_t HISR;				//  DMA high interrupt status register, address offset: 0x04
+	__vo uint32_t LIFCR;			//  DMA low interrupt flag clear register, address offset: 0x08
+	__vo uint32_t HIFCR;			//  DMA high interrupt flag clear register, address offset: 0x0C
+	DMA_Stream_RegDef_t STREAM[8];	//  DMA stream 0..7 registers, address offset: 0x10-0xCC
+} DMA_RegDef_t;
+
+/*********************************************************************************
+ * Create peripheral register definition structure for USART
+ *********************************************************************************/
+typedef struct
+{
+	__vo uint32_t SR;				//  Status register, address offset: 0x00
+	__vo uint32_t DR;				//  Data register, address offset: 0x04
+	__vo uint32_t BRR;				//  Baud rate register, address offset: 0x08
+	__vo uint32_t CR1;				//  Control register 1, address offset: 0x0C
+	__vo uint32_t CR2;				//  Control register 2, address offset: 0x10
+	__vo uint32_t CR3;				//  Control register 3, address offset: 0x14
+	__vo uint32_t GTPR;				//  Guard time and prescaler register, address offset: 0x18
+} USART_RegDef_t;
+
+/*********************************************************************************
+ * Create peripheral register definition structure for TIM
+ * (one layout for advanced, general purpose and basic timers,
+ *  registers a timer does not have read as 0)
+ *********************************************************************************/
+typedef struct
+{
+	__vo uint32_t CR1;				//  Control register 1, address offset: 0x00
+	__vo uint32_t CR2;				//  Control register 2, address offset: 0x04
+	__vo uint32_t SMCR;				//  Slave mode control register, address offset: 0x08
+	__vo uint32_t DIER;				//  DMA/interrupt enable register, address offset: 0x0C
+	__vo uint32_t SR;				//  Status register, address offset: 0x10
+	__vo uint32_t EGR;				//  Event generation register, address offset: 0x14
+	__vo uint32_t CCMR[2];			//  Capture/compare mode register 1 (CH1/2) and 2 (CH3/4), address offset: 0x18-0x1C
+	__vo uint32_t CCER;				//  Capture/compare enable register, address offset: 0x20
+	__vo uint32_t CNT;				//  Counter, address offset: 0x24
+	__vo uint32_t PSC;				//  Prescaler, address offset: 0x28
+	__vo uint32_t ARR;				//  Auto-reload register, address offset: 0x2C
+	__vo uint32_t RCR;				//  Repetition counter register (TIM1/8), address offset: 0x30
+	__vo uint32_t CCR[4];			//  Capture/compare register 1..4, address offset: 0x34-0x40
+	__vo uint32_t BDTR;				//  Break and dead-time register (TIM1/8), address offset: 0x44
+	__vo uint32_t DCR;				//  DMA control register, address offset: 0x48
+	__vo uint32_t DMAR;				//  DMA address for full transfer, address offset: 0x4C
+	__vo uint32_t OR;				//  Option register (TIM2/5/11), address offset: 0x50
+} TIM_RegDef_t;
+
+/*********************************************************************************
+ * Create peripheral register definition structure for ADC
+ *********************************************************************************/
+typedef struct
+{
+	__vo uint32_t SR;				//  Status register, address offset: 0x00
+	__vo uint32_t CR1;				//  Control register 1, address offset: 0x04
+	__vo uint32_t CR2;				//  Control register 2, address offset: 0x08
+	__vo uint32_t SMPR1;			//  Sample time register 1 (channels 10..18), address offset: 0x0C
+	__vo uint32_t SMPR2;			//  Sample time register 2 (channels 0..9), address offset: 0x10
+	__vo uint32_t JOFR[4];			//  Injected channel data offset registers, address offset: 0x14-0x20
+	__vo uint32_t HTR;				//  Watchdog higher threshold register, address offset: 0x24
+	__vo uint32_t LTR;				//  Watchdog lower threshold register, address offset: 0x28
+	__vo uint32_t SQR1;				//  Regular sequence register 1 (ranks 13..16, length), address offset: 0x2C
+	__vo uint32_t SQR2;				//  Regular sequence register 2 (ranks 7..12), address offset: 0x30
+	__vo uint32_t SQR3;				//  Regular sequence register 3 (ranks 1..6), address offset: 0x34
+	__vo uint32_t JSQR;				//  Injected sequence register, address offset: 0x38
+	__vo uint32_t JDR[4];			//  Injected data registers, address offset: 0x3C-0x48
+	__vo uint32_t DR;				//  Regular data register, address offset: 0x4C
+} ADC_RegDef_t;
+
+typedef struct
+{
+	__vo uint32_t CSR;				//  Common status register, address offset: 0x300 (ADC1 base)
+	__vo uint32_t CCR;				//  Common control register, address offset: 0x304
+	__vo uint32_t CDR;				//  Common regular data register for dual/triple modes, address offset: 0x308
+} ADC_Common_RegDef_t;
+
+/*********************************************************************************
+ * Create register definition structure for PWR
+ *********************************************************************************/
+typedef struct
+{
+	__vo uint32_t CR;				//  Power control register, address offset: 0x00
+	__vo uint32_t CSR;				//  Power control/status register, address offset: 0x04
+} PWR_RegDef_t;
+
+/*********************************************************************************
+ * Create register definition structure for ITM (instrumentation trace macrocell)
+ *********************************************************************************/
+typedef struct
+{
+	__vo uint32_t PORT[32];			//  Stimulus port registers, address offset: 0x00-0x7C
+	uint32_t RESERVED0[864];		//  Reserved, 0x80-0xDFC
+	__vo uint32_t TER;				//  Trace enable register, address offset: 0xE00
+	uint32_t RESERVED1[15];			//  Reserved, 0xE04-0xE3C
+	__vo uint32_t TPR;				//  Trace privilege register, address offset: 0xE40
+	uint32_t RESERVED2[15];			//  Reserved, 0xE44-0xE7C
+	__vo uint32_t TCR;				//  Trace control register, address offset: 0xE80
+} ITM_RegDef_t;
+
 /*********************************************************************************
  * Define peripheral definition macros
  * (peripheral base addresses typecasted to xxx_RegDef_t)
@@ -196,6 +411,7 @@ typedef struct
 #define GPIOH 					((GPIO_RegDef_t*)GPIOH_BASEADDR)
 #define GPIOI 					((GPIO_RegDef_t*)GPIOI_BASEADDR)
 #define RCC						((RCC_RegDef_t*)RCC_BASEADDR)
+#define PWR						((PWR_RegDef_t*)PWR_BASEADDR)
 
 #define EXTI					((EXTI_RegDef_t*)EXTI_BASEADDR)
 #define SYSCFG					((SYSCFG_RegDef_t*)SYSCFG_BASEADDR)
@@ -204,6 +420,42 @@ typedef struct
 #define SPI2					((SPI_RegDef_t*)SPI2_BASEADDR)
 #define SPI3					((SPI_RegDef_t*)SPI3_BASEADDR)
 #define SPI4					((SPI_RegDef_t*)SPI4_BASEADDR)
+
+#define I2C1					((I2C_RegDef_t*)I2C1_BASEADDR)
+#define I2C2					((I2C_RegDef_t*)I2C2_BASEADDR)
+#define I2C3					((I2C_RegDef_t*)I2C3_BASEADDR)
+
+#define USART1					((USART_RegDef_t*)USART1_BASEADDR)
+#define USART2					((USART_RegDef_t*)USART2_BASEADDR)
+#define USART3					((USART_RegDef_t*)USART3_BASEADDR)
+#define UART4					((USART_RegDef_t*)UART4_BASEADDR)
+#define UART5					((USART_RegDef_t*)UART5_BASEADDR)
+#define USART6					((USART_RegDef_t*)USART6_BASEADDR)
+
+#define TIM1					((TIM_RegDef_t*)TIM1_BASEADDR)
+#define TIM2					((TIM_RegDef_t*)TIM2_BASEADDR)
+#define TIM3					((TIM_RegDef_t*)TIM3_BASEADDR)
+#define TIM4					((TIM_RegDef_t*)TIM4_BASEADDR)
+#define TIM5					((TIM_RegDef_t*)TIM5_BASEADDR)
+#define TIM6					((TIM_RegDef_t*)TIM6_BASEADDR)
+#define TIM7					((TIM_RegDef_t*)TIM7_BASEADDR)
+#define TIM8					((TIM_RegDef_t*)TIM8_BASEADDR)
+#define TIM9					((TIM_RegDef_t*)TIM9_BASEADDR)
+#define TIM10					((TIM_RegDef_t*)TIM10_BASEADDR)
+#define TIM11					((TIM_RegDef_t*)TIM11_BASEADDR)
+#define TIM12					((TIM_RegDef_t*)TIM12_BASEADDR)
+#define TIM13					((TIM_RegDef_t*)TIM13_BASEADDR)
+#define TIM14					((TIM_RegDef_t*)TIM14_BASEADDR)
+
+#define ADC1					((ADC_RegDef_t*)ADC1_BASEADDR)
+#define ADC2					((ADC_RegDef_t*)ADC2_BASEADDR)
+#define ADC3					((ADC_RegDef_t*)ADC3_BASEADDR)
+#define ADC_COMMON				((ADC_Common_RegDef_t*)ADC_COMMON_BASEADDR)
+
+#define DMA1					((DMA_RegDef_t*)DMA1_BASEADDR)
+#define DMA2					((DMA_RegDef_t*)DMA2_BASEADDR)
+
+#define ITM						((ITM_RegDef_t*)ITM_BASEADDR)
 /***************************************************************************
  * Clock Enable Macros for GPIOx peripherals
  ***************************************************************************/
@@ -237,9 +489,42 @@ typedef struct
  */
 #define USART2_PCLK_EN()		(RCC->APB1ENR |= (1<<17))
 #define USART3_PCLK_EN()		(RCC->APB1ENR |= (1<<18))
+#define UART4_PCLK_EN()			(RCC->APB1ENR |= (1<<19))
+#define UART5_PCLK_EN()			(RCC->APB1ENR |= (1<<20))
 #define USART1_PCLK_EN()		(RCC->APB2ENR |= (1<<4))
 #define USART6_PCLK_EN()		(RCC->APB2ENR |= (1<<5))
 
+/*
+ * Clock Enable Macros for DMAx controllers
+ */
+#define DMA1_PCLK_EN()			(RCC->AHB1ENR |= (1<<21))
+#define DMA2_PCLK_EN()			(RCC->AHB1ENR |= (1<<22))
+
+/*
+ * Clock Enable Macros for TIMx peripherals
+ */
+#define TIM2_PCLK_EN()			(RCC->APB1ENR |= (1<<0))
+#define TIM3_PCLK_EN()			(RCC->APB1ENR |= (1<<1))
+#define TIM4_PCLK_EN()			(RCC->APB1ENR |= (1<<2))
+#define TIM5_PCLK_EN()			(RCC->APB1ENR |= (1<<3))
+#define TIM6_PCLK_EN()			(RCC->APB1ENR |= (1<<4))
+#define TIM7_PCLK_EN()			(RCC->APB1ENR |= (1<<5))
+#define TIM12_PCLK_EN()			(RCC->APB1ENR |= (1<<6))
+#define TIM13_PCLK_EN()			(RCC->APB1ENR |= (1<<7))
+#define TIM14_PCLK_EN()			(RCC->APB1ENR |= (1<<8))
+#define TIM1_PCLK_EN()			(RCC->APB2ENR |= (1<<0))
+#define TIM8_PCLK_EN()			(RCC->APB2ENR |= (1<<1))
+#define TIM9_PCLK_EN()			(RCC->APB2ENR |= (1<<16))
+#define TIM10_PCLK_EN()			(RCC->APB2ENR |= (1<<17))
+#define TIM11_PCLK_EN()			(RCC->APB2ENR |= (1<<18))
+
+/*
+ * Clock Enable Macros for ADCx peripherals
+ */
+#define ADC1_PCLK_EN()			(RCC->APB2ENR |= (1<<8))
+#define ADC2_PCLK_EN()			(RCC->APB2ENR |= (1<<9))
+#define ADC3_PCLK_EN()			(RCC->APB2ENR |= (1<<10))
+
 /*
  * Clock Enable Macros for SYSCFG peripherals
  */
@@ -248,42 +533,75 @@ typedef struct
 /*
  * Clock Disable Macros for GPIOx peripherals
  */
-#define GPIOA_PCLK_DI()			(RCC->AHB1ENR &= !(1<<0))
-#define GPIOB_PCLK_DI()			(RCC->AHB1ENR &= !(1<<1))
-#define GPIOC_PCLK_DI()			(RCC->AHB1ENR &= !(1<<2))
-#define GPIOD_PCLK_DI()			(RCC->AHB1ENR &= !(1<<3))
-#define GPIOE_PCLK_DI()			(RCC->AHB1ENR &= !(1<<4))
-#define GPIOF_PCLK_DI()			(RCC->AHB1ENR &= !(1<<5))
-#define GPIOG_PCLK_DI()			(RCC->AHB1ENR &= !(1<<6))
-#define GPIOH_PCLK_DI()			(RCC->AHB1ENR &= !(1<<7))
-#define GPIOI_PCLK_DI()			(RCC->AHB1ENR &= !(1<<8))
+#define GPIOA_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<0))
+#define GPIOB_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<1))
+#define GPIOC_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<2))
+#define GPIOD_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<3))
+#define GPIOE_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<4))
+#define GPIOF_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<5))
+#define GPIOG_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<6))
+#define GPIOH_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<7))
+#define GPIOI_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<8))
 
 /*
  * Clock Disable Macros for I2Cx peripherals
  */
-#define I2C1_PCLK_DI()			(RCC->APB1ENR &= !(1<<21)) //21 bit position is I2C1 enable
-#define I2C2_PCLK_DI()			(RCC->APB1ENR &= !(1<<22)) //22 bit position is I2C1 enable
-#define I2C3_PCLK_DI()			(RCC->APB1ENR &= !(1<<23)) //23 bit position is I2C1 enable
+#define I2C1_PCLK_DI()			(RCC->APB1ENR &= ~(1<<21)) //21 bit position is I2C1 enable
+#define I2C2_PCLK_DI()			(RCC->APB1ENR &= ~(1<<22)) //22 bit position is I2C1 enable
+#define I2C3_PCLK_DI()			(RCC->APB1ENR &= ~(1<<23)) //23 bit position is I2C1 enable
 
 /*
  * Clock Disable Macros for SPIx peripherals
  */
-#define SPI1_PCLK_DI()			(RCC->APB2ENR &= !(1<<12)) //12 bit position is SPI1 enable
-#define SPI2_PCLK_DI()			(RCC->APB1ENR &= !(1<<14))
-#define SPI3_PCLK_DI()			(RCC->APB1ENR &= !(1<<15))
-#define SPI4_PCLK_DI()			(RCC->APB2ENR &= !(1<<13))
+#define SPI1_PCLK_DI()			(RCC->APB2ENR &= ~(1<<12)) //12 bit position is SPI1 enable
+#define SPI2_PCLK_DI()			(RCC->APB1ENR &= ~(1<<14))
+#define SPI3_PCLK_DI()			(RCC->APB1ENR &= ~(1<<15))
+#define SPI4_PCLK_DI()			(RCC->APB2ENR &= ~(1<<13))
 /*
  * Clock Disable Macros for USARTx peripherals
  */
-#define USART2_PCLK_DI()		(RCC->APB1ENR &= (1<<17))
-#define USART3_PCLK_DI()		(RCC->APB1ENR &= (1<<18))
-#define USART1_PCLK_DI()		(RCC->APB2ENR &= (1<<4))
-#define USART6_PCLK_DI()		(RCC->APB2ENR &= (1<<5))
+#define USART2_PCLK_DI()		(RCC->APB1ENR &= ~(1<<17))
+#define USART3_PCLK_DI()		(RCC->APB1ENR &= ~(1<<18))
+#define UART4_PCLK_DI()			(RCC->APB1ENR &= ~(1<<19))
+#define UART5_PCLK_DI()			(RCC->APB1ENR &= ~(1<<20))
+#define USART1_PCLK_DI()		(RCC->APB2ENR &= ~(1<<4))
+#define USART6_PCLK_DI()		(RCC->APB2ENR &= ~(1<<5))
+
+/*
+ * Clock Disable Macros for DMAx controllers
+ */
+#define DMA1_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<21))
+#define DMA2_PCLK_DI()			(RCC->AHB1ENR &= ~(1<<22))
+
+/*
+ * Clock Disable Macros for TIMx peripherals
+ */
+#define TIM2_PCLK_DI()			(RCC->APB1ENR &= ~(1<<0))
+#define TIM3_PCLK_DI()			(RCC->APB1ENR &= ~(1<<1))
+#define TIM4_PCLK_DI()			(RCC->APB1ENR &= ~(1<<2))
+#define TIM5_PCLK_DI()			(RCC->APB1ENR &= ~(1<<3))
+#define TIM6_PCLK_DI()			(RCC->APB1ENR &= ~(1<<4))
+#define TIM7_PCLK_DI()			(RCC->APB1ENR &= ~(1<<5))
+#define TIM12_PCLK_DI()			(RCC->APB1ENR &= ~(1<<6))
+#define TIM13_PCLK_DI()			(RCC->APB1ENR &= ~(1<<7))
+#define TIM14_PCLK_DI()			(RCC->APB1ENR &= ~(1<<8))
+#define TIM1_PCLK_DI()			(RCC->APB2ENR &= ~(1<<0))
+#define TIM8_PCLK_DI()			(RCC->APB2ENR &= ~(1<<1))
+#define TIM9_PCLK_DI()			(RCC->APB2ENR &= ~(1<<16))
+#define TIM10_PCLK_DI()			(RCC->APB2ENR &= ~(1<<17))
+#define TIM11_PCLK_DI()			(RCC->APB2ENR &= ~(1<<18))
+
+/*
+ * Clock Disable Macros for ADCx peripherals
+ */
+#define ADC1_PCLK_DI()			(RCC->APB2ENR &= ~(1<<8))
+#define ADC2_PCLK_DI()			(RCC->APB2ENR &= ~(1<<9))
+#define ADC3_PCLK_DI()			(RCC->APB2ENR &= ~(1<<10))
 
 /***************************************************************************
  * Clock Disable Macros for SYSCFG peripherals
  ***************************************************************************/
-#define SYSCFG_PCLK_DI()		(RCC->APB2ENR &= (1<<14))
+#define SYSCFG_PCLK_DI()		(RCC->APB2ENR &= ~(1<<14))
 
 /***************************************************************************
  * macros to reset GPIOx peripherals
@@ -305,17 +623,50 @@ typedef struct
 #define SPI3_REG_RESET()		do{RCC->APB1RSTR |= (1<<0); RCC->AHB1RSTR &= ~(1<<15);} while(0)
 #define SPI4_REG_RESET()		do{RCC->APB2RSTR |= (1<<0); RCC->AHB1RSTR &= ~(1<<13);} while(0)
 
+/***************************************************************************
+ * macros to reset I2Cx peripherals
+ ***************************************************************************/
+#define I2C1_REG_RESET()		do{RCC->APB1RSTR |= (1<<21); RCC->APB1RSTR &= ~(1<<21);} while(0)
+#define I2C2_REG_RESET()		do{RCC->APB1RSTR |= (1<<22); RCC->APB1RSTR &= ~(1<<22);} while(0)
+#define I2C3_REG_RESET()		do{RCC->APB1RSTR |= (1<<23); RCC->APB1RSTR &= ~(1<<23);} while(0)
+
+/***************************************************************************
+ * macros to reset USARTx peripherals
+ ***************************************************************************/
+#define USART1_REG_RESET()		do{RCC->APB2RSTR |= (1<<4); RCC->APB2RSTR &= ~(1<<4);} while(0)
+#define USART2_REG_RESET()		do{RCC->APB1RSTR |= (1<<17); RCC->APB1RSTR &= ~(1<<17);} while(0)
+#define USART3_REG_RESET()		do{RCC->APB1RSTR |= (1<<18); RCC->APB1RSTR &= ~(1<<18);} while(0)
+#define UART4_REG_RESET()		do{RCC->APB1RSTR |= (1<<19); RCC->APB1RSTR &= ~(1<<19);} while(0)
+#define UART5_REG_RESET()		do{RCC->APB1RSTR |= (1<<20); RCC->APB1RSTR &= ~(1<<20);} while(0)
+#define USART6_REG_RESET()		do{RCC->APB2RSTR |= (1<<5); RCC->APB2RSTR &= ~(1<<5);} while(0)
+
+/***************************************************************************
+ * macros to reset TIMx peripherals
+ ***************************************************************************/
+#define TIM2_REG_RESET()		do{RCC->APB1RSTR |= (1<<0); RCC->APB1RSTR &= ~(1<<0);} while(0)
+#define TIM3_REG_RESET()		do{RCC->APB1RSTR |= (1<<1); RCC->APB1RSTR &= ~(1<<1);} while(0)
+#define TIM4_REG_RESET()		do{RCC->APB1RSTR |= (1<<2); RCC->APB1RSTR &= ~(1<<2);} while(0)
+#define TIM5_REG_RESET()		do{RCC->APB1RSTR |= (1<<3); RCC->APB1RSTR &= ~(1<<3);} while(0)
+#define TIM6_REG_RESET()		do{RCC->APB1RSTR |= (1<<4); RCC->APB1RSTR &= ~(1<<4);} while(0)
+#define TIM7_REG_RESET()		do{RCC->APB1RSTR |= (1<<5); RCC->APB1RSTR &= ~(1<<5);} while(0)
+#define TIM12_REG_RESET()		do{RCC->APB1RSTR |= (1<<6); RCC->APB1RSTR &= ~(1<<6);} while(0)
+#define TIM13_REG_RESET()		do{RCC->APB1RSTR |= (1<<7); RCC->APB1RSTR &= ~(1<<7);} while(0)
+#define TIM14_REG_RESET()		do{RCC->APB1RSTR |= (1<<8); RCC->APB1RSTR &= ~(1<<8);} while(0)
+#define TIM1_REG_RESET()		do{RCC->APB2RSTR |= (1<<0); RCC->APB2RSTR &= ~(1<<0);} while(0)
+#define TIM8_REG_RESET()		do{RCC->APB2RSTR |= (1<<1); RCC->APB2RSTR &= ~(1<<1);} while(0)
+#define TIM9_REG_RESET()		do{RCC->APB2RSTR |= (1<<16); RCC->APB2RSTR &= ~(1<<16);} while(0)
+#define TIM10_REG_RESET()		do{RCC->APB2RSTR |= (1<<17); RCC->APB2RSTR &= ~(1<<17);} while(0)
+#define TIM11_REG_RESET()		do{RCC->APB2RSTR |= (1<<18); RCC->APB2RSTR &= ~(1<<18);} while(0)
+
+/***************************************************************************
+ * macro to reset the ADCs (one reset bit for ADC1, ADC2, ADC3 and common)
+ ***************************************************************************/
+#define ADC_REG_RESET()			do{RCC->APB2RSTR |= (1<<8); RCC->APB2RSTR &= ~(1<<8);} while(0)
+
 /***************************************************************************
  * Returns port code for given GPIOx base address
  ***************************************************************************/
-#define GPIO_BASEADDR_TO_CODE(x)	((x == GPIOA) ? 0 : \
-									 (x == GPIOB) ? 1 : \
-									 (x == GPIOC) ? 2 : \
-									 (x == GPIOD) ? 3 : \
-									 (x == GPIOE) ? 4 : \
-									 (x == GPIOF) ? 5 : \
-									 (x == GPIOG) ? 6 : \
-									 (x == GPIOH) ? 7 : 0)
+#define GPIO_BASEADDR_TO_CODE(x)	(((uint32_t)(x) - GPIOA_BASEADDR) / 0x400U)
 
 /***************************************************************************
  * IRQ (Interrupt Request) Numbers for different EXTI lines (for F4 family)
@@ -329,6 +680,59 @@ typedef struct
 #define IRQ_NO_EXTI4				10
 #define IRQ_NO_EXTI9_5				23
 #define IRQ_NO_EXTI15_10			40
+
+#define IRQ_NO_DMA1_STREAM0			11
+#define IRQ_NO_DMA1_STREAM1			12
+#define IRQ_NO_DMA1_STREAM2			13
+#define IRQ_NO_DMA1_STREAM3			14
+#define IRQ_NO_DMA1_STREAM4			15
+#define IRQ_NO_DMA1_STREAM5			16
+#define IRQ_NO_DMA1_STREAM6			17
+#define IRQ_NO_DMA1_STREAM7			47
+#define IRQ_NO_DMA2_STREAM0			56
+#define IRQ_NO_DMA2_STREAM1			57
+#define IRQ_NO_DMA2_STREAM2			58
+#define IRQ_NO_DMA2_STREAM3			59
+#define IRQ_NO_DMA2_STREAM4			60
+#define IRQ_NO_DMA2_STREAM5			68
+#define IRQ_NO_DMA2_STREAM6			69
+#define IRQ_NO_DMA2_STREAM7			70
+
+#define IRQ_NO_SPI1					35
+#define IRQ_NO_SPI2					36
+#define IRQ_NO_SPI3					51
+#define IRQ_NO_SPI4					84 // STM32F42x/43x only
+
+#define IRQ_NO_I2C1_EV				31
+#define IRQ_NO_I2C1_ER				32
+#define IRQ_NO_I2C2_EV				33
+#define IRQ_NO_I2C2_ER				34
+#define IRQ_NO_I2C3_EV				72
+#define IRQ_NO_I2C3_ER				73
+
+#define IRQ_NO_USART1				37
+#define IRQ_NO_USART2				38
+#define IRQ_NO_USART3				39
+#define IRQ_NO_UART4				52
+#define IRQ_NO_UART5				53
+#define IRQ_NO_USART6				71
+
+#define IRQ_NO_TIM1_BRK_TIM9		24
+#define IRQ_NO_TIM1_UP_TIM10		25
+#define IRQ_NO_TIM1_TRG_COM_TIM11	26
+#define IRQ_NO_TIM1_CC				27
+#define IRQ_NO_TIM2					28
+#define IRQ_NO_TIM3					29
+#define IRQ_NO_TIM4					30
+#define IRQ_NO_TIM8_BRK_TIM12		43
+#define IRQ_NO_TIM8_UP_TIM13		44
+#define IRQ_NO_TIM8_TRG_COM_TIM14	45
+#define IRQ_NO_TIM8_CC				46
+#define IRQ_NO_TIM5					50
+#define IRQ_NO_TIM6_DAC				54
+#define IRQ_NO_TIM7					55
+
+#define IRQ_NO_ADC					18 // shared by ADC1, ADC2 and ADC3
 /***************************************************************************
  * IRQ Priority
  ***************************************************************************/
@@ -411,8 +815,413 @@ typedef struct
 #define SPI_SR_BSY			7
 #define SPI_SR_FRE			8
 
+/**********************************************
+ * Bit position definitions of I2C peripheral
+ **********************************************/
+
+/***************************************
+ * Bit position definitions I2C_CR1
+ ***************************************/
+#define I2C_CR1_PE			0
+#define I2C_CR1_NOSTRETCH	7
+#define I2C_CR1_START		8
+#define I2C_CR1_STOP		9
+#define I2C_CR1_ACK			10
+#define I2C_CR1_POS			11
+#define I2C_CR1_SWRST		15
+
+/***************************************
+ * Bit position definitions I2C_CR2
+ ***************************************/
+#define I2C_CR2_FREQ		0
+#define I2C_CR2_ITERREN		8
+#define I2C_CR2_ITEVTEN		9
+#define I2C_CR2_ITBUFEN		10
+#define I2C_CR2_DMAEN		11
+#define I2C_CR2_LAST		12
+
+/***************************************
+ * Bit position definitions I2C_OAR1
+ ***************************************/
+#define I2C_OAR1_ADD0		0
+#define I2C_OAR1_ADD71		1
+#define I2C_OAR1_ADD98		8
+#define I2C_OAR1_ADDMODE	15
+
+/***************************************
+ * Bit position definitions I2C_SR1
+ ***************************************/
+#define I2C_SR1_SB			0
+#define I2C_SR1_ADDR		1
+#define I2C_SR1_BTF			2
+#define I2C_SR1_ADD10		3
+#define I2C_SR1_STOPF		4
+#define I2C_SR1_RXNE		6
+#define I2C_SR1_TXE			7
+#define I2C_SR1_BERR		8
+#define I2C_SR1_ARLO		9
+#define I2C_SR1_AF			10
+#define I2C_SR1_OVR			11
+#define I2C_SR1_TIMEOUT		14
+
+/***************************************
+ * Bit position definitions I2C_SR2
+ ***************************************/
+#define I2C_SR2_MSL			0
+#define I2C_SR2_BUSY		1
+#define I2C_SR2_TRA			2
+#define I2C_SR2_GENCALL		4
+#define I2C_SR2_DUALF		7
+
+/***************************************
+ * Bit position definitions I2C_CCR
+ ***************************************/
+#define I2C_CCR_CCR			0
+#define I2C_CCR_DUTY		14
+#define I2C_CCR_FS			15
+
+/**********************************************
+ * Bit position definitions of RCC
+ **********************************************/
+
+/***************************************
+ * Bit position definitions RCC_CR
+ ***************************************/
+#define RCC_CR_HSION		0
+#define RCC_CR_HSIRDY		1
+#define RCC_CR_HSEON		16
+#define RCC_CR_HSERDY		17
+#define RCC_CR_PLLON		24
+#define RCC_CR_PLLRDY		25
+
+/***************************************
+ * Bit position definitions RCC_CFGR
+ ***************************************/
+#define RCC_CFGR_SW			0
+#define RCC_CFGR_SWS		2
+#define RCC_CFGR_HPRE		4
+#define RCC_CFGR_PPRE1		10
+#define RCC_CFGR_PPRE2		13
+
+/***************************************
+ * Bit position definitions RCC_PLLCFGR
+ ***************************************/
+#define RCC_PLLCFGR_PLLM	0
+#define RCC_PLLCFGR_PLLN	6
+#define RCC_PLLCFGR_PLLP	16
+#define RCC_PLLCFGR_PLLSRC	22
+#define RCC_PLLCFGR_PLLQ	24
+
+/**********************************************
+ * Bit position definitions of USART peripheral
+ **********************************************/
+
+/***************************************
+ * Bit position definitions USART_SR
+ ***************************************/
+#define USART_SR_PE			0
+#define USART_SR_FE			1
+#define USART_SR_NF			2
+#define USART_SR_ORE		3
+#define USART_SR_IDLE		4
+#define USART_SR_RXNE		5
+#define USART_SR_TC			6
+#define USART_SR_TXE		7
+#define USART_SR_LBD		8
+#define USART_SR_CTS		9
+
+/***************************************
+ * Bit position definitions USART_CR1
+ ***************************************/
+#define USART_CR1_SBK		0
+#define USART_CR1_RWU		1
+#define USART_CR1_RE		2
+#define USART_CR1_TE		3
+#define USART_CR1_IDLEIE	4
+#define USART_CR1_RXNEIE	5
+#define USART_CR1_TCIE		6
+#define USART_CR1_TXEIE		7
+#define USART_CR1_PEIE		8
+#define USART_CR1_PS		9
+#define USART_CR1_PCE		10
+#define USART_CR1_WAKE		11
+#define USART_CR1_M			12
+#define USART_CR1_UE		13
+#define USART_CR1_OVER8		15
+
+/***************************************
+ * Bit position definitions USART_CR2
+ ***************************************/
+#define USART_CR2_ADD		0
+#define USART_CR2_LBDL		5
+#define USART_CR2_LBDIE		6
+#define USART_CR2_LBCL		8
+#define USART_CR2_CPHA		9
+#define USART_CR2_CPOL		10
+#define USART_CR2_CLKEN		11
+#define USART_CR2_STOP		12
+#define USART_CR2_LINEN		14
+
+/***************************************
+ * Bit position definitions USART_CR3
+ ***************************************/
+#define USART_CR3_EIE		0
+#define USART_CR3_IREN		1
+#define USART_CR3_IRLP		2
+#define USART_CR3_HDSEL		3
+#define USART_CR3_NACK		4
+#define USART_CR3_SCEN		5
+#define USART_CR3_DMAR		6
+#define USART_CR3_DMAT		7
+#define USART_CR3_RTSE		8
+#define USART_CR3_CTSE		9
+#define USART_CR3_CTSIE		10
+#define USART_CR3_ONEBIT	11
+
+/**********************************************
+ * Bit position definitions of DMA controller
+ **********************************************/
+
+/***************************************
+ * Bit position definitions DMA_SxCR
+ ***************************************/
+#define DMA_SxCR_EN			0
+#define DMA_SxCR_DMEIE		1
+#define DMA_SxCR_TEIE		2
+#define DMA_SxCR_HTIE		3
+#define DMA_SxCR_TCIE		4
+#define DMA_SxCR_PFCTRL		5
+#define DMA_SxCR_DIR		6
+#define DMA_SxCR_CIRC		8
+#define DMA_SxCR_PINC		9
+#define DMA_SxCR_MINC		10
+#define DMA_SxCR_PSIZE		11
+#define DMA_SxCR_MSIZE		13
+#define DMA_SxCR_PINCOS		15
+#define DMA_SxCR_PL			16
+#define DMA_SxCR_DBM		18
+#define DMA_SxCR_CT			19
+#define DMA_SxCR_PBURST		21
+#define DMA_SxCR_MBURST		23
+#define DMA_SxCR_CHSEL		25
+
+/***************************************
+ * Bit position definitions DMA_SxFCR
+ ***************************************/
+#define DMA_SxFCR_FTH		0
+#define DMA_SxFCR_DMDIS		2
+#define DMA_SxFCR_FS		3
+#define DMA_SxFCR_FEIE		7
+
+/***************************************
+ * Bit position definitions DMA_LISR/HISR
+ * (relative to the stream's flag group)
+ ***************************************/
+#define DMA_ISR_FEIF		0
+#define DMA_ISR_DMEIF		2
+#define DMA_ISR_TEIF		3
+#define DMA_ISR_HTIF		4
+#define DMA_ISR_TCIF		5
+
+/**********************************************
+ * Bit position definitions of TIM peripheral
+ **********************************************/
+
+/***************************************
+ * Bit position definitions TIM_CR1
+ ***************************************/
+#define TIM_CR1_CEN			0
+#define TIM_CR1_UDIS		1
+#define TIM_CR1_URS			2
+#define TIM_CR1_OPM			3
+#define TIM_CR1_DIR			4
+#define TIM_CR1_CMS			5
+#define TIM_CR1_ARPE		7
+#define TIM_CR1_CKD			8
+
+/***************************************
+ * Bit position definitions TIM_CR2
+ ***************************************/
+#define TIM_CR2_CCDS		3
+#define TIM_CR2_MMS			4
+#define TIM_CR2_TI1S		7
+
+/***************************************
+ * Bit position definitions TIM_SMCR
+ ***************************************/
+#define TIM_SMCR_SMS		0
+#define TIM_SMCR_TS			4
+#define TIM_SMCR_MSM		7
+#define TIM_SMCR_ETF		8
+#define TIM_SMCR_ETPS		12
+#define TIM_SMCR_ECE		14
+#define TIM_SMCR_ETP		15
+
+/***************************************
+ * Bit position definitions TIM_DIER
+ * (CCxIE = TIM_DIER_CC1IE + x - 1,
+ *  CCxDE = TIM_DIER_CC1DE + x - 1)
+ ***************************************/
+#define TIM_DIER_UIE		0
+#define TIM_DIER_CC1IE		1
+#define TIM_DIER_TIE		6
+#define TIM_DIER_UDE		8
+#define TIM_DIER_CC1DE		9
+#define TIM_DIER_TDE		14
+
+/***************************************
+ * Bit position definitions TIM_SR
+ * (CCxIF = TIM_SR_CC1IF + x - 1,
+ *  CCxOF = TIM_SR_CC1OF + x - 1)
+ ***************************************/
+#define TIM_SR_UIF			0
+#define TIM_SR_CC1IF		1
+#define TIM_SR_TIF			6
+#define TIM_SR_CC1OF		9
+
+/***************************************
+ * Bit position definitions TIM_EGR
+ ***************************************/
+#define TIM_EGR_UG			0
+#define TIM_EGR_CC1G		1
+#define TIM_EGR_TG			6
+
+/***************************************
+ * Bit position definitions TIM_CCMRx
+ * (channel 1/3 fields, +8 for channel 2/4)
+ ***************************************/
+#define TIM_CCMR_CCS		0
+#define TIM_CCMR_OCFE		2
+#define TIM_CCMR_OCPE		3
+#define TIM_CCMR_OCM		4
+#define TIM_CCMR_OCCE		7
+#define TIM_CCMR_ICPSC		2
+#define TIM_CCMR_ICF		4
+
+/***************************************
+ * Bit position definitions TIM_CCER
+ * (channel 1 fields, +4 per channel)
+ ***************************************/
+#define TIM_CCER_CCE		0
+#define TIM_CCER_CCP		1
+#define TIM_CCER_CCNE		2
+#define TIM_CCER_CCNP		3
+
+/***************************************
+ * Bit position definitions TIM_BDTR
+ ***************************************/
+#define TIM_BDTR_MOE		15
+
+/***************************************
+ * Bit position definitions TIM_DCR
+ ***************************************/
+#define TIM_DCR_DBA			0
+#define TIM_DCR_DBL			8
+
+/**********************************************
+ * Bit position definitions of ADC peripheral
+ **********************************************/
+
+/***************************************
+ * Bit position definitions ADC_SR
+ ***************************************/
+#define ADC_SR_AWD			0
+#define ADC_SR_EOC			1
+#define ADC_SR_JEOC			2
+#define ADC_SR_JSTRT		3
+#define ADC_SR_STRT			4
+#define ADC_SR_OVR			5
+
+/***************************************
+ * Bit position definitions ADC_CR1
+ ***************************************/
+#define ADC_CR1_AWDCH		0
+#define ADC_CR1_EOCIE		5
+#define ADC_CR1_AWDIE		6
+#define ADC_CR1_JEOCIE		7
+#define ADC_CR1_SCAN		8
+#define ADC_CR1_AWDSGL		9
+#define ADC_CR1_JAUTO		10
+#define ADC_CR1_DISCEN		11
+#define ADC_CR1_JDISCEN		12
+#define ADC_CR1_DISCNUM		13
+#define ADC_CR1_JAWDEN		22
+#define ADC_CR1_AWDEN		23
+#define ADC_CR1_RES			24
+#define ADC_CR1_OVRIE		26
+
+/***************************************
+ * Bit position definitions ADC_CR2
+ ***************************************/
+#define ADC_CR2_ADON		0
+#define ADC_CR2_CONT		1
+#define ADC_CR2_DMA			8
+#define ADC_CR2_DDS			9
+#define ADC_CR2_EOCS		10
+#define ADC_CR2_ALIGN		11
+#define ADC_CR2_JEXTSEL		16
+#define ADC_CR2_JEXTEN		20
+#define ADC_CR2_JSWSTART	22
+#define ADC_CR2_EXTSEL		24
+#define ADC_CR2_EXTEN		28
+#define ADC_CR2_SWSTART		30
+
+/***************************************
+ * Bit position definitions ADC_SQR1
+ ***************************************/
+#define ADC_SQR1_L			20
+
+/***************************************
+ * Bit position definitions ADC_CCR
+ ***************************************/
+#define ADC_CCR_MULTI		0
+#define ADC_CCR_DELAY		8
+#define ADC_CCR_DDS			13
+#define ADC_CCR_DMA			14
+#define ADC_CCR_ADCPRE		16
+#define ADC_CCR_VBATE		22
+#define ADC_CCR_TSVREFE		23
+
+/***************************************
+ * Bit position definitions ITM_TCR
+ ***************************************/
+#define ITM_TCR_ITMENA		0
+
+/**********************************************
+ * Bit position definitions of PWR
+ **********************************************/
+
+/***************************************
+ * Bit position definitions PWR_CR
+ ***************************************/
+#define PWR_CR_LPDS			0
+#define PWR_CR_PDDS			1
+#define PWR_CR_CWUF			2
+#define PWR_CR_CSBF			3
+#define PWR_CR_FPDS			9
+#define PWR_CR_VOS			14
+
+/***************************************
+ * Bit position definitions PWR_CSR
+ ***************************************/
+#define PWR_CSR_WUF			0
+#define PWR_CSR_SBF			1
+
 
+#include "stm32f407xx_ring.h"
+#include "stm32f407xx_periph.h"
+#include "stm32f407xx_clk.h"
 #include "stm32f407xx_gpio_driver.h"
+#include "stm32f407xx_dma_driver.h"
 #include "stm32f407xx_spi_driver.h"
+#include "stm32f407xx_rcc_driver.h"
+#include "stm32f407xx_usart_driver.h"
+#include "stm32f407xx_i2c_driver.h"
+#include "stm32f407xx_tim_driver.h"
+#include "stm32f407xx_adc_driver.h"
+#include "stm32f407xx_log.h"
+#include "stm32f407xx_prof.h"
+#include "stm32f407xx_pwr.h"
+#include "stm32f407xx_sched.h"
 
 #endif /* INC_STM32F407XX_H_ */
@@ -0,0 +1,208 @@
+#ifndef INC_STM32F407XX_ADC_DRIVER_H_
+#define INC_STM32F407XX_ADC_DRIVER_H_
+
+// Every driver header should contain this device-specific header file.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Configuration Settings (one ADC, regular group)
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t ADC_Resolution;			/* possible values from @ADC_Resolution */
+	uint8_t ADC_DataAlign;			/* possible values from @ADC_DataAlign */
+	uint8_t ADC_ContinuousMode;		/* ENABLE: restart the sequence after the last rank */
+	uint8_t ADC_NoOfConversions;	/* ranks in the regular sequence 1..16, scan mode when > 1 */
+	uint8_t ADC_ExtTrigger;			/* possible values from @ADC_ExtTrigger */
+	uint8_t ADC_ExtTriggerEdge;		/* possible values from @ADC_ExtTriggerEdge */
+} ADC_Config_t;
+
+/****************************************************************************
+ * Common Configuration Settings (all ADCs)
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t ADC_Prescaler;			/* possible values from @ADC_Prescaler */
+	uint8_t ADC_MultiMode;			/* possible values from @ADC_MultiMode */
+	uint8_t ADC_MultiDMAMode;		/* possible values from @ADC_MultiDMAMode */
+	uint8_t ADC_TwoSamplingDelay;	/* 5..20 ADC clock cycles between interleaved conversions */
+} ADC_CommonConfig_t;
+
+/****************************************************************************
+ * Handle Structure
+ *
+ * The DMA stream of the ADC is used in circular mode, so sampling runs
+ * forever without CPU work: either one buffer with half/full callbacks, or
+ * two buffers (DMA double buffer mode) with one callback per filled buffer.
+ ****************************************************************************/
+typedef struct
+{
+	ADC_RegDef_t *pADCx;
+	ADC_Config_t ADC_Config;
+	DMA_Handle_t DMA;
+	uint16_t *pBuffer0;				/* buffer (or first buffer) given to the DMA */
+	uint16_t *pBuffer1;				/* second buffer, double buffer mode only */
+	uint16_t BufferLen;				/* 16-bit elements per buffer */
+} ADC_Handle_t;
+
+/****************************************************************************
+ * @ADC_Resolution
+ *****************************************************************************/
+#define ADC_RESOLUTION_12BIT		0 // 15 ADC clock cycles per conversion with 3 cycle sampling
+#define ADC_RESOLUTION_10BIT		1
+#define ADC_RESOLUTION_8BIT			2
+#define ADC_RESOLUTION_6BIT			3
+
+/****************************************************************************
+ * @ADC_DataAlign
+ *****************************************************************************/
+#define ADC_ALIGN_RIGHT				0
+#define ADC_ALIGN_LEFT				1
+
+/****************************************************************************
+ * @ADC_ExtTrigger
+ * EXTSEL values of the regular group, ADC_EXTTRIG_SOFTWARE for SWSTART only
+ *****************************************************************************/
+#define ADC_EXTTRIG_TIM1_CC1		0
+#define ADC_EXTTRIG_TIM1_CC2		1
+#define ADC_EXTTRIG_TIM1_CC3		2
+#define ADC_EXTTRIG_TIM2_CC2		3
+#define ADC_EXTTRIG_TIM2_CC3		4
+#define ADC_EXTTRIG_TIM2_CC4		5
+#define ADC_EXTTRIG_TIM2_TRGO		6
+#define ADC_EXTTRIG_TIM3_CC1		7
+#define ADC_EXTTRIG_TIM3_TRGO		8
+#define ADC_EXTTRIG_TIM4_CC4		9
+#define ADC_EXTTRIG_TIM5_CC1		10
+#define ADC_EXTTRIG_TIM5_CC2		11
+#define ADC_EXTTRIG_TIM5_CC3		12
+#define ADC_EXTTRIG_TIM8_CC1		13
+#define ADC_EXTTRIG_TIM8_TRGO		14
+#define ADC_EXTTRIG_EXTI11			15
+#define ADC_EXTTRIG_SOFTWARE		0xFF
+
+/****************************************************************************
+ * @ADC_ExtTriggerEdge
+ *****************************************************************************/
+#define ADC_EXTTRIG_EDGE_RISING		1
+#define ADC_EXTTRIG_EDGE_FALLING	2
+#define ADC_EXTTRIG_EDGE_BOTH		3
+
+/****************************************************************************
+ * @ADC_SampleTime
+ * Sampling time in ADC clock cycles
+ *****************************************************************************/
+#define ADC_SAMPLETIME_3CYCLES		0
+#define ADC_SAMPLETIME_15CYCLES		1
+#define ADC_SAMPLETIME_28CYCLES		2
+#define ADC_SAMPLETIME_56CYCLES		3
+#define ADC_SAMPLETIME_84CYCLES		4
+#define ADC_SAMPLETIME_112CYCLES	5
+#define ADC_SAMPLETIME_144CYCLES	6
+#define ADC_SAMPLETIME_480CYCLES	7
+
+/****************************************************************************
+ * @ADC_Channel
+ *****************************************************************************/
+#define ADC_CHANNEL_TEMPSENSOR		16 // ADC1 only, needs ADC_CCR TSVREFE
+#define ADC_CHANNEL_VREFINT			17 // ADC1 only, needs ADC_CCR TSVREFE
+#define ADC_CHANNEL_VBAT			18 // ADC1 only, needs ADC_CCR VBATE
+
+/****************************************************************************
+ * @ADC_Prescaler
+ * ADCCLK = PCLK2 / (2, 4, 6, 8), 36 MHz maximum
+ *****************************************************************************/
+#define ADC_PRESCALER_DIV2			0
+#define ADC_PRESCALER_DIV4			1
+#define ADC_PRESCALER_DIV6			2
+#define ADC_PRESCALER_DIV8			3
+
+/****************************************************************************
+ * @ADC_MultiMode
+ *****************************************************************************/
+#define ADC_MULTI_INDEPENDENT		0x00
+#define ADC_MULTI_DUAL_INTERLEAVED	0x07 // ADC1 + ADC2
+#define ADC_MULTI_TRIPLE_INTERLEAVED 0x17 // ADC1 + ADC2 + ADC3
+
+/****************************************************************************
+ * @ADC_MultiDMAMode
+ *****************************************************************************/
+#define ADC_MULTI_DMA_DISABLED		0
+#define ADC_MULTI_DMA_MODE1			1 // one half-word per request
+#define ADC_MULTI_DMA_MODE2			2 // two half-words per request (interleaved modes)
+#define ADC_MULTI_DMA_MODE3			3 // two bytes per request (6/8 bit), packed in a half-word
+
+/****************************************************************************
+ * ADC related status flags definitions
+ *****************************************************************************/
+#define ADC_FLAG_AWD				(1 << ADC_SR_AWD)
+#define ADC_FLAG_EOC				(1 << ADC_SR_EOC)
+#define ADC_FLAG_JEOC				(1 << ADC_SR_JEOC)
+#define ADC_FLAG_STRT				(1 << ADC_SR_STRT)
+#define ADC_FLAG_OVR				(1 << ADC_SR_OVR)
+
+/****************************************************************************
+ * Possible ADC application events
+ *****************************************************************************/
+#define ADC_EVENT_EOC				0 // end of conversion (interrupt mode), read ADC_GetValue
+#define ADC_EVENT_HALF_CMPLT		1 // first half of the buffer is filled
+#define ADC_EVENT_CMPLT				2 // second half of the buffer is filled
+#define ADC_EVENT_BUFFER0_READY		3 // double buffer mode: pBuffer0 is filled
+#define ADC_EVENT_BUFFER1_READY		4 // double buffer mode: pBuffer1 is filled
+#define ADC_ERROR_OVR				5 // data lost, sampling stopped, restart the DMA
+#define ADC_ERROR_DMA				6
+
+/****************************************************************************
+ *							APIs supported by this driver
+ * 		For more information about the APIs check the function definitions
+ ****************************************************************************/
+
+/***********************************************************************
+ * Peripheral Clock setup
+ ***********************************************************************/
+void ADC_PeriClockControl(ADC_RegDef_t *pADCx, uint8_t EnorDi);
+
+/***********************************************************************
+ * Init and De-init
+ ***********************************************************************/
+void ADC_CommonInit(ADC_CommonConfig_t *pCommonConfig);
+void ADC_Init(ADC_Handle_t *pADCHandle);
+void ADC_DeInit(void);
+void ADC_ConfigChannel(ADC_RegDef_t *pADCx, uint8_t Rank, uint8_t Channel, uint8_t SampleTime);
+
+/***********************************************************************
+ * Conversion control
+ ***********************************************************************/
+// polling (blocking)
+void ADC_StartConversion(ADC_RegDef_t *pADCx);
+void ADC_PollForConversion(ADC_RegDef_t *pADCx);
+uint16_t ADC_GetValue(ADC_RegDef_t *pADCx);
+// interrupt
+void ADC_StartIT(ADC_Handle_t *pADCHandle);
+void ADC_StopIT(ADC_Handle_t *pADCHandle);
+// DMA (circular)
+void ADC_StartDMA(ADC_Handle_t *pADCHandle, uint16_t *pBuffer, uint16_t Len);
+void ADC_StartDMADoubleBuffer(ADC_Handle_t *pADCHandle, uint16_t *pBuffer0, uint16_t *pBuffer1, uint16_t Len);
+uint8_t ADC_MultiStartDMA(ADC_Handle_t *pMasterHandle, uint16_t *pBuffer, uint16_t Len);
+void ADC_StopDMA(ADC_Handle_t *pADCHandle);
+
+/***********************************************************************
+ * IRQ Configuration and ISR handling
+ ***********************************************************************/
+void ADC_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void ADC_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority);
+void ADC_IRQHandling(ADC_Handle_t *pADCHandle);
+// The DMA stream handler calls DMA_IRQHandling(&handle.DMA).
+
+/***********************************************************************
+ * Other Peripheral Control APIs
+ ***********************************************************************/
+void ADC_PeripheralControl(ADC_RegDef_t *pADCx, uint8_t EnOrDi);
+uint8_t ADC_GetFlagStatus(ADC_RegDef_t *pADCx, uint32_t FlagName);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void ADC_ApplicationEventCallback(ADC_Handle_t *pADCHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_ADC_DRIVER_H_ */
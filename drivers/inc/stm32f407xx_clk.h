@@ -0,0 +1,71 @@
+#ifndef INC_STM32F407XX_CLK_H_
+#define INC_STM32F407XX_CLK_H_
+
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Peripheral clock manager
+ *
+ * Reference counts the users of every peripheral clock. The first
+ * Clk_Request of a peripheral turns its clock on, the last Clk_Release
+ * turns it off again, so one user can not switch off a clock another user
+ * (driver, DMA stream, log module, ...) still needs. The
+ * xxx_PeriClockControl APIs of the drivers go through it: every ENABLE
+ * must be paired with one DISABLE.
+ *
+ * The driver Inits only make sure the clock is on for their register
+ * writes (Clk_Ensure), they do not add a user: the clock of a peripheral
+ * the application configured and then released goes off, the registers
+ * keep their values until it is requested again.
+ *
+ * Sleep mode: with sleep gating on (Clk_Init), a peripheral keeps its
+ * clock while the CPU sleeps only if somebody asked for it with
+ * Clk_SleepRequest (RCC AHB1LPENR/APB1LPENR/APB2LPENR). Peripherals which
+ * have to run or wake the CPU from sleep (timer, USART RX, DMA, ...) need
+ * a sleep request.
+ *
+ * Clock-on time is counted per peripheral with the DWT cycle counter
+ * (HCLK cycles). Call Clk_Update, Clk_GetOnTime or Clk_Report at least
+ * once every 2^32 cycles (4.4 minutes at 16 MHz) while clocks are on.
+ ****************************************************************************/
+
+/****************************************************************************
+ * Per peripheral state
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t RefCount;				/* users of the clock */
+	uint8_t SleepRefCount;			/* users of the clock in sleep mode */
+	uint32_t OnSince;				/* cycle counter when turned on / last update */
+	uint64_t OnCycles;				/* cycles with the clock on */
+	uint32_t OnCount;				/* number of times turned on */
+} Clk_State_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+void Clk_Init(uint8_t SleepGating);
+
+/*
+ * Run mode clock
+ */
+void Clk_Request(const __vo void *pRegs);
+void Clk_Release(const __vo void *pRegs);
+void Clk_Control(const __vo void *pRegs, uint8_t EnorDi);
+void Clk_Ensure(const __vo void *pRegs);
+
+/*
+ * Sleep mode clock
+ */
+void Clk_SleepRequest(const __vo void *pRegs);
+void Clk_SleepRelease(const __vo void *pRegs);
+
+/*
+ * Statistics
+ */
+void Clk_Update(void);
+uint8_t Clk_GetRefCount(const __vo void *pRegs);
+uint64_t Clk_GetOnTime(const __vo void *pRegs);
+void Clk_Report(void);
+
+#endif /* INC_STM32F407XX_CLK_H_ */
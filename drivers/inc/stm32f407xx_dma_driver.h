@@ -0,0 +1,146 @@
+// Every driver header should contain this device-specific header file.
+// It is included before the guard: other driver headers (USART, ...) embed a
+// DMA_Handle_t, so the device header must always get to define it first.
+#include "stm32f407xx.h"
+
+#ifndef INC_STM32F407XX_DMA_DRIVER_H_
+#define INC_STM32F407XX_DMA_DRIVER_H_
+
+/****************************************************************************
+ * Stream Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t DMA_Channel;			/* possible values from @DMA_CHANNEL */
+	uint8_t DMA_Direction;			/* possible values from @DMA_DIRECTION */
+	uint8_t DMA_PeriphInc;			/* ENABLE or DISABLE */
+	uint8_t DMA_MemInc;				/* ENABLE or DISABLE */
+	uint8_t DMA_PeriphDataSize;		/* possible values from @DMA_DATA_SIZE */
+	uint8_t DMA_MemDataSize;		/* possible values from @DMA_DATA_SIZE */
+	uint8_t DMA_Mode;				/* possible values from @DMA_MODE */
+	uint8_t DMA_Priority;			/* possible values from @DMA_PRIORITY */
+	uint8_t DMA_FIFOMode;			/* possible values from @DMA_FIFO_MODE */
+} DMA_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ *
+ * One handle describes one stream of one DMA controller.
+ * The peripheral driver which owns the stream (USART, SPI, ...) stores
+ * its own handle in pParent and gets the stream events in pEventCallback.
+ * If no callback is registered, DMA_ApplicationEventCallback is called.
+ ****************************************************************************/
+typedef struct DMA_Handle
+{
+	DMA_RegDef_t *pDMAx;			// base address of DMA1 or DMA2
+	uint8_t Stream;					// stream number 0..7
+	DMA_Config_t DMAConfig;
+	void (*pEventCallback)(struct DMA_Handle *pDMAHandle, uint8_t AppEv);
+	void *pParent;					// owner of this stream (e.g. USART_Handle_t)
+} DMA_Handle_t;
+
+/****************************************************************************
+ * @DMA_CHANNEL
+ * Request channel selection (CHSEL), see DMA1/DMA2 request mapping tables
+ *****************************************************************************/
+#define DMA_CHANNEL_0				0
+#define DMA_CHANNEL_1				1
+#define DMA_CHANNEL_2				2
+#define DMA_CHANNEL_3				3
+#define DMA_CHANNEL_4				4
+#define DMA_CHANNEL_5				5
+#define DMA_CHANNEL_6				6
+#define DMA_CHANNEL_7				7
+
+/****************************************************************************
+ * @DMA_DIRECTION
+ *****************************************************************************/
+#define DMA_DIR_PERIPH_TO_MEM		0
+#define DMA_DIR_MEM_TO_PERIPH		1
+#define DMA_DIR_MEM_TO_MEM			2
+
+/****************************************************************************
+ * @DMA_DATA_SIZE
+ *****************************************************************************/
+#define DMA_SIZE_BYTE				0
+#define DMA_SIZE_HALFWORD			1
+#define DMA_SIZE_WORD				2
+
+/****************************************************************************
+ * @DMA_MODE
+ *****************************************************************************/
+#define DMA_MODE_NORMAL				0
+#define DMA_MODE_CIRCULAR			1
+#define DMA_MODE_DOUBLE_BUFFER		2 // circular mode with memory 0/memory 1 swap
+
+/****************************************************************************
+ * @DMA_PRIORITY
+ *****************************************************************************/
+#define DMA_PRIORITY_LOW			0
+#define DMA_PRIORITY_MEDIUM			1
+#define DMA_PRIORITY_HIGH			2
+#define DMA_PRIORITY_VERY_HIGH		3
+
+/****************************************************************************
+ * @DMA_FIFO_MODE
+ * Direct mode, or FIFO enabled with the given threshold.
+ *****************************************************************************/
+#define DMA_FIFO_DIRECT				0
+#define DMA_FIFO_1QUARTER			1
+#define DMA_FIFO_HALF				2
+#define DMA_FIFO_3QUARTERS			3
+#define DMA_FIFO_FULL				4
+
+/****************************************************************************
+ * Possible DMA application events
+ *****************************************************************************/
+#define DMA_EVENT_HALF_CMPLT		1
+#define DMA_EVENT_CMPLT				2
+#define DMA_EVENT_ERROR				3
+
+/****************************************************************************
+ * Returns the stream register block of a DMA handle
+ *****************************************************************************/
+#define DMA_STREAM(pDMAHandle)		(&(pDMAHandle)->pDMAx->STREAM[(pDMAHandle)->Stream])
+
+/****************************************************************************
+ *							APIs supported by this driver
+ * 		For more information about the APIs check the function definitions
+ ****************************************************************************/
+
+/***********************************************************************
+ * Peripheral Clock setup
+ ***********************************************************************/
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi);
+
+/***********************************************************************
+ * Init and De-init
+ ***********************************************************************/
+void DMA_Init(DMA_Handle_t *pDMAHandle);
+void DMA_DeInit(DMA_Handle_t *pDMAHandle);
+
+/***********************************************************************
+ * Transfer control
+ ***********************************************************************/
+void DMA_Start(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t MemAddr, uint16_t Len);
+void DMA_StartDoubleBuffer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t Mem0Addr, uint32_t Mem1Addr, uint16_t Len);
+void DMA_Stop(DMA_Handle_t *pDMAHandle);
+uint16_t DMA_GetRemaining(DMA_Handle_t *pDMAHandle);
+uint8_t DMA_GetCurrentTarget(DMA_Handle_t *pDMAHandle);
+uint8_t DMA_IsEnabled(DMA_Handle_t *pDMAHandle);
+void DMA_MemIncConfig(DMA_Handle_t *pDMAHandle, uint8_t EnOrDi);
+
+/***********************************************************************
+ * IRQ Configuration and ISR handling
+ ***********************************************************************/
+uint8_t DMA_GetIRQNumber(DMA_Handle_t *pDMAHandle);
+void DMA_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void DMA_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority);
+void DMA_IRQHandling(DMA_Handle_t *pDMAHandle);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void DMA_ApplicationEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_DMA_DRIVER_H_ */
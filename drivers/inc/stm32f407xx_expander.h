@@ -0,0 +1,139 @@
+#ifndef INC_STM32F407XX_EXPANDER_H_
+#define INC_STM32F407XX_EXPANDER_H_
+
+// Built on the SPI and GPIO drivers, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Shift register I/O expanders: 74HC595 output and 74HC165 input chains
+ *
+ * The driver keeps a RAM image of all the chained bits. The application
+ * sets and reads bits in the image only (Expander_SetOutput,
+ * Expander_GetInput...). Expander_Refresh clocks the whole chain in a
+ * single SPI DMA transfer: the output image goes out on MOSI and the input
+ * image comes back on MISO. When the transfer ends, one BSRR write pulls
+ * the latch pin low and one pulls it high. The rising edge moves the
+ * shifted bits to the 595 outputs. The CPU only starts the transfer and
+ * runs the completion interrupt, whatever the length of the chain.
+ *
+ * Bit numbers: output n is pin Q(n % 8) of the 595 number n / 8, counted
+ * from the MCU's MOSI. Input n is pin D(n % 8) (A = 0) of the 165 number
+ * n / 8, counted from the MCU's MISO. The chains may have different
+ * lengths: a refresh clocks the longer one.
+ *
+ * Input loading (74HC165 SH/LD, low: load, high: shift):
+ * - pLoadPort = 0: SH/LD is on the latch pin. The latch pulse at the end
+ *   of a refresh also loads the inputs, so the next refresh reads them.
+ *   The input image is one refresh old, and the first one is not valid.
+ * - SH/LD on its own pin: it is pulsed before the transfer, and the input
+ *   image holds the levels at the start of the refresh.
+ *
+ * The input image is double buffered. The DMA fills one buffer while the
+ * reads use the other, which holds the last complete refresh. A change
+ * from the previous refresh is reported with EXPANDER_EVENT_INPUT_CHANGED.
+ * Output bits set during a refresh reach the pins in that refresh or in
+ * the next one.
+ *
+ * Periodic refresh: call Expander_Refresh from any periodic interrupt, or
+ * let a timer do it: TIM_StartIT at the refresh rate, and
+ * Expander_TimerEventHandling called from TIM_ApplicationEventCallback. A
+ * refresh due while the previous one is still running (or while another
+ * driver is using the SPI) is skipped and counted in Skipped.
+ *
+ * The bus may be shared with other SPI devices. The 595s shift the other
+ * traffic too, but only the latch pulse reaches their outputs, and the
+ * next refresh shifts in the whole image again.
+ *
+ * The application
+ * - configures the SPI: master, mode 0, 8 bit frames, MSB first, SSM/SSI,
+ *   SPE, and the IRQs of its RX and TX DMA streams (DMA_IRQHandling),
+ * - calls Expander_EventHandling from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+
+/*
+ * Longest chain (bytes, one per 595 or 165)
+ */
+#ifndef EXPANDER_MAX_BYTES
+#define EXPANDER_MAX_BYTES			64
+#endif
+
+/****************************************************************************
+ * @EXPANDER_RETURN
+ * Return values of Expander_Init and Expander_Refresh
+ *****************************************************************************/
+#define EXPANDER_OK					0 // started
+#define EXPANDER_BUSY				1 // refresh in progress or SPI busy, skipped
+#define EXPANDER_ERR_PARAM			2 // no chain, or longer than EXPANDER_MAX_BYTES
+
+/****************************************************************************
+ * Possible expander application events
+ *****************************************************************************/
+#define EXPANDER_EVENT_REFRESH_CMPLT	1 // outputs latched, input image updated
+#define EXPANDER_EVENT_INPUT_CHANGED	2 // the input image differs from the previous refresh
+#define EXPANDER_EVENT_ERROR			3 // SPI/DMA error, the refresh is dropped
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	SPI_Handle_t *pSPIHandle;		/* SPI_Init done and enabled */
+	GPIO_RegDef_t *pLatchPort;		/* 595 RCLK, and 165 SH/LD if pLoadPort is 0 */
+	uint8_t LatchPin;
+	GPIO_RegDef_t *pLoadPort;		/* 165 SH/LD on its own pin, 0 if on the latch pin */
+	uint8_t LoadPin;
+	uint16_t OutBytes;				/* 595s in the chain */
+	uint16_t InBytes;				/* 165s in the chain */
+	TIM_Handle_t *pTIMHandle;		/* timer of Expander_TimerEventHandling, 0 if not used */
+} Expander_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Expander_Config_t Config;
+
+	/* precomputed from the pins */
+	__vo uint32_t *pLatchBsrr;
+	uint32_t LatchBit;				/* pin mask in the BSRR low half */
+	__vo uint32_t *pLoadBsrr;		/* 0 if on the latch pin */
+	uint32_t LoadBit;
+	uint16_t Len;					/* frames per refresh, the longer chain */
+
+	/* images */
+	uint8_t Out[EXPANDER_MAX_BYTES];	/* in shift order: the farthest 595 first */
+	uint8_t In[2][EXPANDER_MAX_BYTES];	/* the nearest 165 first */
+	uint8_t InCur;					/* buffer of the last complete refresh */
+
+	uint8_t Busy;
+	uint8_t ExpectedEv;				/* SPI event which ends the transfer */
+	uint32_t Refreshes;
+	uint32_t Skipped;
+} Expander_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Expander_Init(Expander_Handle_t *pExpander, Expander_Config_t *pConfig);
+
+void Expander_SetOutput(Expander_Handle_t *pExpander, uint16_t Bit, uint8_t Level);
+uint8_t Expander_GetOutput(Expander_Handle_t *pExpander, uint16_t Bit);
+void Expander_WriteOutputByte(Expander_Handle_t *pExpander, uint16_t Chip, uint8_t Value);
+uint8_t Expander_GetInput(Expander_Handle_t *pExpander, uint16_t Bit);
+uint8_t Expander_ReadInputByte(Expander_Handle_t *pExpander, uint16_t Chip);
+
+uint8_t Expander_Refresh(Expander_Handle_t *pExpander);
+uint8_t Expander_Busy(Expander_Handle_t *pExpander);
+
+// Call this from SPI_ApplicationEventCallback.
+void Expander_EventHandling(Expander_Handle_t *pExpander, SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+// Call this from TIM_ApplicationEventCallback for a timer paced refresh.
+void Expander_TimerEventHandling(Expander_Handle_t *pExpander, TIM_Handle_t *pTIMHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Expander_ApplicationEventCallback(Expander_Handle_t *pExpander, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_EXPANDER_H_ */
@@ -55,6 +55,11 @@ void GPIO_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
 void GPIO_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority);
 void GPIO_IRQHandling(uint8_t PinNumber);
 
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void GPIO_ApplicationEventCallback(uint8_t PinNumber);
+
 /****************************************************
  * @GPIO_PIN_MODES
  * GPIO pin possible modes (8.4.1 input register)
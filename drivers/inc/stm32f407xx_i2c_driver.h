@@ -0,0 +1,166 @@
+#ifndef INC_STM32F407XX_I2C_DRIVER_H_
+#define INC_STM32F407XX_I2C_DRIVER_H_
+
+// Every driver header should contain this device-specific header file.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	uint32_t I2C_SCLSpeed;			/* possible values from @I2C_SCLSpeed */
+	uint16_t I2C_DeviceAddress;		/* own address, only used when addressed as slave */
+	uint8_t I2C_AckControl;			/* possible values from @I2C_AckControl */
+	uint8_t I2C_FMDutyCycle;		/* possible values from @I2C_FMDutyCycle */
+	uint8_t I2C_AddrMode;			/* possible values from @I2C_AddrMode, used for own and slave addresses */
+} I2C_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ *
+ * The non-blocking APIs run an interrupt driven state machine from
+ * I2C_EV_IRQHandling and I2C_ER_IRQHandling. A write-then-read transaction
+ * (I2C_MasterWriteReadIT/DMA) uses a repeated START between the two phases,
+ * so a sensor register read is one bus transaction.
+ ****************************************************************************/
+typedef struct
+{
+	I2C_RegDef_t *pI2Cx;
+	I2C_Config_t I2C_Config;
+	uint8_t *pTxBuffer;				/* to store the app. Tx buffer address */
+	uint8_t *pRxBuffer;				/* to store the app. Rx buffer address */
+	uint32_t TxLen;					/* to store Tx len */
+	uint32_t RxLen;					/* to store Rx len */
+	uint8_t TxRxState;				/* possible values from @I2C_APP_STATES */
+	uint16_t DevAddr;				/* to store slave/device address */
+	uint32_t RxSize;				/* to store Rx size */
+	uint8_t Sr;						/* to store repeated start value */
+	uint8_t ReadAfterWrite;			/* SET while the read phase of a write-read is pending */
+	uint8_t Addr10ReadPhase;		/* 10-bit read: SET once the write direction header is done */
+	uint8_t UseDMA;					/* SET when the current transfer moves data with DMA */
+	DMA_Handle_t TxDMA;
+	DMA_Handle_t RxDMA;
+} I2C_Handle_t;
+
+/****************************************************************************
+ * @I2C_SCLSpeed
+ *****************************************************************************/
+#define I2C_SCL_SPEED_SM			100000
+#define I2C_SCL_SPEED_FM2K			200000
+#define I2C_SCL_SPEED_FM4K			400000
+
+/****************************************************************************
+ * @I2C_AckControl
+ *****************************************************************************/
+#define I2C_ACK_ENABLE				1
+#define I2C_ACK_DISABLE				0
+
+/****************************************************************************
+ * @I2C_FMDutyCycle
+ *****************************************************************************/
+#define I2C_FM_DUTY_2				0
+#define I2C_FM_DUTY_16_9			1
+
+/****************************************************************************
+ * @I2C_AddrMode
+ *****************************************************************************/
+#define I2C_ADDR_MODE_7BIT			0
+#define I2C_ADDR_MODE_10BIT			1
+
+/****************************************************************************
+ * @I2C_APP_STATES
+ *****************************************************************************/
+#define I2C_READY					0
+#define I2C_BUSY_IN_RX				1
+#define I2C_BUSY_IN_TX				2
+
+/****************************************************************************
+ * Repeated start
+ *****************************************************************************/
+#define I2C_DISABLE_SR				RESET
+#define I2C_ENABLE_SR				SET
+
+/****************************************************************************
+ * I2C related status flags definitions
+ *****************************************************************************/
+#define I2C_FLAG_SB					(1 << I2C_SR1_SB)
+#define I2C_FLAG_ADDR				(1 << I2C_SR1_ADDR)
+#define I2C_FLAG_BTF				(1 << I2C_SR1_BTF)
+#define I2C_FLAG_ADD10				(1 << I2C_SR1_ADD10)
+#define I2C_FLAG_STOPF				(1 << I2C_SR1_STOPF)
+#define I2C_FLAG_RXNE				(1 << I2C_SR1_RXNE)
+#define I2C_FLAG_TXE				(1 << I2C_SR1_TXE)
+#define I2C_FLAG_BERR				(1 << I2C_SR1_BERR)
+#define I2C_FLAG_ARLO				(1 << I2C_SR1_ARLO)
+#define I2C_FLAG_AF					(1 << I2C_SR1_AF)
+#define I2C_FLAG_OVR				(1 << I2C_SR1_OVR)
+#define I2C_FLAG_TIMEOUT			(1 << I2C_SR1_TIMEOUT)
+
+/****************************************************************************
+ * I2C application events macros
+ *****************************************************************************/
+#define I2C_EV_TX_CMPLT				0
+#define I2C_EV_RX_CMPLT				1
+#define I2C_ERROR_BERR				2 // transfer aborted
+#define I2C_ERROR_ARLO				3 // transfer aborted, bus lost to another master
+#define I2C_ERROR_AF				4 // NACK, transfer aborted with a STOP
+#define I2C_ERROR_OVR				5
+#define I2C_ERROR_TIMEOUT			6
+#define I2C_ERROR_DMA				7 // transfer aborted with a STOP
+
+/****************************************************************************
+ *							APIs supported by this driver
+ * 		For more information about the APIs check the function definitions
+ ****************************************************************************/
+
+/***********************************************************************
+ * Peripheral Clock setup
+ ***********************************************************************/
+void I2C_PeriClockControl(I2C_RegDef_t *pI2Cx, uint8_t EnorDi);
+
+/***********************************************************************
+ * Init and De-init
+ ***********************************************************************/
+void I2C_Init(I2C_Handle_t *pI2CHandle);
+void I2C_DeInit(I2C_RegDef_t *pI2Cx);
+
+/***********************************************************************
+ * Data Send and Receive
+ ***********************************************************************/
+// polling (blocking)
+void I2C_MasterSendData(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint16_t SlaveAddr, uint8_t Sr);
+void I2C_MasterReceiveData(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint16_t SlaveAddr, uint8_t Sr);
+// interrupt (non-blocking)
+uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint16_t SlaveAddr, uint8_t Sr);
+uint8_t I2C_MasterReceiveDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint16_t SlaveAddr, uint8_t Sr);
+uint8_t I2C_MasterWriteReadIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t TxLen, uint8_t *pRxBuffer, uint32_t RxLen, uint16_t SlaveAddr);
+// DMA (non-blocking)
+uint8_t I2C_MasterWriteReadDMA(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t TxLen, uint8_t *pRxBuffer, uint32_t RxLen, uint16_t SlaveAddr);
+
+void I2C_CloseReceiveData(I2C_Handle_t *pI2CHandle);
+void I2C_CloseSendData(I2C_Handle_t *pI2CHandle);
+
+/***********************************************************************
+ * IRQ Configuration and ISR handling
+ ***********************************************************************/
+void I2C_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void I2C_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority);
+void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle);
+void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle);
+// The DMA stream handlers call DMA_IRQHandling(&handle.TxDMA) / (&handle.RxDMA).
+
+/***********************************************************************
+ * Other Peripheral Control APIs
+ ***********************************************************************/
+void I2C_PeripheralControl(I2C_RegDef_t *pI2Cx, uint8_t EnOrDi);
+uint8_t I2C_GetFlagStatus(I2C_RegDef_t *pI2Cx, uint32_t FlagName);
+void I2C_ManageAcking(I2C_RegDef_t *pI2Cx, uint8_t EnorDi);
+void I2C_GenerateStopCondition(I2C_RegDef_t *pI2Cx);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void I2C_ApplicationEventCallback(I2C_Handle_t *pI2CHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_I2C_DRIVER_H_ */
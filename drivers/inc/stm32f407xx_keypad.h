@@ -0,0 +1,120 @@
+#ifndef INC_STM32F407XX_KEYPAD_H_
+#define INC_STM32F407XX_KEYPAD_H_
+
+// Built on the GPIO and timer drivers, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Key matrix scanner (up to 8 x 8), debounced, interrupt driven
+ *
+ * The rows are open-drain outputs, released (high) but the one being
+ * scanned, which is pulled low. The columns are consecutive pins of one
+ * port with pull-ups: a pressed key pulls its column low while its row is.
+ *
+ * Keypad_Scan does one row per call, from a timer interrupt at the row
+ * rate: it reads the columns of the row driven since the previous call
+ * (one IDR read, the row had the whole tick to settle), then drives the
+ * next row (two BSRR writes). No delays, nothing in main(). After the last
+ * row the raw bitmap of the scan goes through the debouncer: a 2 bit
+ * vertical counter per key, a key changes after KEYPAD_DEBOUNCE_SCANS
+ * scans in a row with the new level, all keys in a few 64 bit operations.
+ * Changes are reported with KEYPAD_EVENT_CHANGED, the keys in Changed.
+ *
+ * Rows = 0: buttons straight on the column pins (to ground), one IDR read
+ * per call, the same debouncing.
+ *
+ * Key numbers: Row * Cols + Col, bit n of the bitmaps. A pressed key is 1.
+ *
+ * The application runs a timer at the row rate (e.g. TIM_StartIT at 1 kHz
+ * for 4 rows: a scan every 4 ms, debounced in 16 ms) and calls
+ * Keypad_EventHandling from TIM_ApplicationEventCallback, or Keypad_Scan
+ * from any periodic interrupt.
+ ****************************************************************************/
+
+/*
+ * Largest matrix
+ */
+#define KEYPAD_MAX_ROWS				8
+#define KEYPAD_MAX_COLS				8
+
+/*
+ * Scans with the new level before a key changes (2 bit vertical counter)
+ */
+#define KEYPAD_DEBOUNCE_SCANS		4
+
+/****************************************************************************
+ * @KEYPAD_RETURN
+ * Return values of Keypad_Init
+ *****************************************************************************/
+#define KEYPAD_OK					0
+#define KEYPAD_ERR_PARAM			2 // too many rows or columns, columns past pin 15
+
+/****************************************************************************
+ * Possible keypad application events
+ *****************************************************************************/
+#define KEYPAD_EVENT_CHANGED		1 // keys in Changed were pressed or released
+
+/*
+ * Row pin
+ */
+typedef struct
+{
+	GPIO_RegDef_t *pGPIOx;
+	uint8_t PinNumber;
+} Keypad_Pin_t;
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	Keypad_Pin_t Row[KEYPAD_MAX_ROWS];
+	uint8_t Rows;					/* 0: no matrix, buttons on the column pins */
+	GPIO_RegDef_t *pColPort;
+	uint8_t ColPin;					/* first column pin, the others follow */
+	uint8_t Cols;
+	TIM_Handle_t *pTIMHandle;		/* timer of Keypad_EventHandling, 0 if Keypad_Scan is called directly */
+} Keypad_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Keypad_Config_t Config;
+
+	/* precomputed from the pins */
+	__vo uint32_t *pRowBsrr[KEYPAD_MAX_ROWS];
+	uint32_t RowBit[KEYPAD_MAX_ROWS];	/* pin mask of the row in the BSRR low half */
+	__vo uint32_t *pColIdr;
+	uint32_t ColMask;				/* Cols low bits */
+
+	uint8_t Row;					/* row driven now */
+	uint64_t Raw;					/* scan in progress */
+
+	/* debouncer */
+	uint64_t State;					/* debounced, 1: pressed */
+	uint64_t Count0;				/* vertical counter, low bits */
+	uint64_t Count1;				/* vertical counter, high bits */
+	uint64_t Changed;				/* keys changed by the last scan */
+	uint32_t Scans;
+} Keypad_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Keypad_Init(Keypad_Handle_t *pKeypad, Keypad_Config_t *pConfig);
+
+void Keypad_Scan(Keypad_Handle_t *pKeypad);
+uint64_t Keypad_GetState(Keypad_Handle_t *pKeypad);
+uint8_t Keypad_IsPressed(Keypad_Handle_t *pKeypad, uint8_t Key);
+
+// Call this from TIM_ApplicationEventCallback.
+void Keypad_EventHandling(Keypad_Handle_t *pKeypad, TIM_Handle_t *pTIMHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Keypad_ApplicationEventCallback(Keypad_Handle_t *pKeypad, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_KEYPAD_H_ */
@@ -0,0 +1,210 @@
+#ifndef INC_STM32F407XX_LCD_H_
+#define INC_STM32F407XX_LCD_H_
+
+// Built on the SPI driver and the scheduler, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * SPI display (ST7789, ILI9341 and other MIPI DCS controllers), RGB565
+ *
+ * The application draws into a RAM framebuffer (Width x Height pixels,
+ * row by row, one uint16_t per pixel) and tells the driver which parts
+ * changed (Lcd_Invalidate, or Lcd_FillRect which does both). Lcd_Flush
+ * then sends only those rectangles, each one as a window (CASET, RASET)
+ * and a RAMWR, in the background on the SPI DMA streams, and ends with
+ * LCD_EVENT_FLUSH_CMPLT. A status line or a counter costs its own pixels,
+ * not a frame.
+ *
+ * Dirty rectangles: up to LCD_MAX_DIRTY are kept. A new one is merged with
+ * an overlapping or near one when the union sends at most LCD_RECT_COST
+ * pixels more than the two (a window costs about that much), and into the
+ * one it grows the least when the list is full.
+ *
+ * The pixels go in 16 bit frames: the uint16_t values leave MSB first, as
+ * the panel wants them, with no byte swapping. Full width rectangles are
+ * contiguous in the framebuffer and are sent from there. The rows of the
+ * others are copied into two staging buffers in the handle: one is packed
+ * while the other one is on the bus.
+ *
+ * Drawing during a flush is allowed. Pixels drawn into a rectangle being
+ * sent may reach the panel in this flush or not; they are invalidated
+ * again for the next one anyway.
+ *
+ * Lcd_Init sends the controller's init sequence (8 bit frames, its delays
+ * on a Sched_Timer_t), then leaves the SPI in 16 bit frames: the SPI is
+ * the panel's alone.
+ *
+ * The application
+ * - configures the SPI: master, mode 0 (or 3), SSM/SSI, SPE, and the IRQs
+ *   of its RX and TX DMA streams (DMA_IRQHandling),
+ * - configures the chip select and data/command pins as push-pull outputs,
+ *   and resets the panel by its reset pin if it has one,
+ * - calls Lcd_EventHandling from SPI_ApplicationEventCallback,
+ * - runs the scheduler and calls Sched_Tick (init delays).
+ ****************************************************************************/
+
+/*
+ * Size of the dirty rectangle lists
+ */
+#ifndef LCD_MAX_DIRTY
+#define LCD_MAX_DIRTY				8
+#endif
+
+/*
+ * Size of each of the two staging buffers (pixels), at least one row
+ */
+#ifndef LCD_STAGE_PIXELS
+#define LCD_STAGE_PIXELS			1024
+#endif
+
+/*
+ * Pixels a window costs (commands and DMA starts), merge threshold
+ */
+#define LCD_RECT_COST				64
+
+/*
+ * Longest single DMA transfer from the framebuffer (pixels)
+ */
+#define LCD_DMA_CHUNK				0x8000
+
+/*
+ * Command set (MIPI DCS)
+ */
+#define LCD_CMD_NOP					0x00
+#define LCD_CMD_SWRESET				0x01
+#define LCD_CMD_SLPOUT				0x11
+#define LCD_CMD_NORON				0x13
+#define LCD_CMD_INVON				0x21
+#define LCD_CMD_DISPON				0x29
+#define LCD_CMD_CASET				0x2A
+#define LCD_CMD_RASET				0x2B
+#define LCD_CMD_RAMWR				0x2C
+#define LCD_CMD_MADCTL				0x36
+#define LCD_CMD_COLMOD				0x3A
+
+/*
+ * Init sequences: the number of commands, then per command its code, the
+ * number of parameter bytes (| LCD_INIT_DELAY if a delay in ms follows
+ * them), the parameters and the delay.
+ */
+#define LCD_INIT_DELAY				0x80
+
+extern const uint8_t Lcd_ST7789Init[];
+extern const uint8_t Lcd_ILI9341Init[];
+
+/*
+ * RGB565 colors
+ */
+#define LCD_RGB565(r, g, b)			((uint16_t)((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3)))
+#define LCD_BLACK					0x0000
+#define LCD_WHITE					0xFFFF
+#define LCD_RED						0xF800
+#define LCD_GREEN					0x07E0
+#define LCD_BLUE					0x001F
+
+/****************************************************************************
+ * @LCD_RETURN
+ * Return values of Lcd_Init and Lcd_Flush
+ *****************************************************************************/
+#define LCD_OK						0 // started
+#define LCD_BUSY					1 // init or a flush in progress
+#define LCD_ERR_PARAM				2 // no framebuffer or init sequence, or too wide
+
+/****************************************************************************
+ * Possible LCD application events
+ *****************************************************************************/
+#define LCD_EVENT_INIT_CMPLT		1
+#define LCD_EVENT_FLUSH_CMPLT		2
+#define LCD_EVENT_ERROR				3 // SPI/DMA error, or the SPI was busy
+
+/*
+ * Rectangle, in framebuffer pixels
+ */
+typedef struct
+{
+	uint16_t X;
+	uint16_t Y;
+	uint16_t W;
+	uint16_t H;
+} Lcd_Rect_t;
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	SPI_Handle_t *pSPIHandle;		/* SPI_Init done and enabled */
+	GPIO_RegDef_t *pCSPort;			/* chip select, active low */
+	uint8_t CSPin;
+	GPIO_RegDef_t *pDCPort;			/* data/command: low for commands */
+	uint8_t DCPin;
+	uint16_t *pFrameBuffer;			/* Width * Height RGB565 pixels */
+	uint16_t Width;
+	uint16_t Height;
+	uint16_t XOffset;				/* of the visible area in the controller's RAM */
+	uint16_t YOffset;
+	const uint8_t *pInitSeq;		/* Lcd_ST7789Init, Lcd_ILI9341Init or the application's */
+	uint8_t Lcd_MsPerTick;			/* scheduler tick period */
+	uint8_t Lcd_Priority;			/* @SCHED_PRIORITY of the driver's events */
+} Lcd_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Lcd_Config_t Config;
+	uint8_t Ready;					/* init sequence sent */
+
+	/* operation in progress */
+	uint8_t Op;
+	uint8_t Phase;
+	uint8_t ExpectedEv;				/* SPI event which ends the current transfer */
+	const uint8_t *pInit;			/* next init command */
+	uint8_t InitLeft;				/* init commands left */
+	uint8_t InitDelay;				/* ms after the current init command */
+	uint16_t Cmd;					/* command frame: NOP and the command in 16 bit frames */
+	uint8_t *pArgs;					/* its parameters */
+	uint16_t ArgLen;				/* bytes */
+	uint16_t Args[2];				/* window parameters */
+
+	/* rectangles */
+	Lcd_Rect_t Dirty[LCD_MAX_DIRTY];
+	uint8_t DirtyCount;
+	Lcd_Rect_t Flush[LCD_MAX_DIRTY];	/* being sent */
+	uint8_t FlushCount;
+	uint8_t FlushIndex;
+	uint8_t Step;					/* window command of the rectangle */
+	uint16_t Row;					/* next row of the rectangle to queue */
+
+	/* pixel blocks: one on the bus, the next one queued */
+	uint16_t Stage[2][LCD_STAGE_PIXELS];
+	uint16_t *pBlock[2];
+	uint32_t BlockLen[2];			/* pixels, 0 when nothing is queued */
+	uint8_t Cur;					/* block on the bus */
+
+	uint32_t PixelsSent;
+	uint32_t RectsSent;
+
+	Sched_Timer_t Timer;
+} Lcd_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Lcd_Init(Lcd_Handle_t *pLcd, Lcd_Config_t *pConfig);
+
+void Lcd_Invalidate(Lcd_Handle_t *pLcd, uint16_t X, uint16_t Y, uint16_t W, uint16_t H);
+void Lcd_FillRect(Lcd_Handle_t *pLcd, uint16_t X, uint16_t Y, uint16_t W, uint16_t H, uint16_t Color);
+uint8_t Lcd_Flush(Lcd_Handle_t *pLcd);
+uint8_t Lcd_Busy(Lcd_Handle_t *pLcd);
+
+// Call this from SPI_ApplicationEventCallback.
+void Lcd_EventHandling(Lcd_Handle_t *pLcd, SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Lcd_ApplicationEventCallback(Lcd_Handle_t *pLcd, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_LCD_H_ */
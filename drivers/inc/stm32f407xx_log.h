@@ -0,0 +1,81 @@
+#ifndef INC_STM32F407XX_LOG_H_
+#define INC_STM32F407XX_LOG_H_
+
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Buffered, non-blocking printf backend
+ *
+ * _write (newlib) only copies the message into a ring buffer and returns.
+ * The buffer is drained in the background by the selected backend:
+ *
+ * ITM:		SWO stimulus port 0. Log_Process() pushes words into the port
+ * 			while the ITM FIFO is ready and never waits for it.
+ * USART:	TX DMA of an already configured USART. The DMA transfer complete
+ * 			interrupt starts the next contiguous chunk.
+ *
+ * If a message does not fit, it is dropped as a whole (no torn lines) and
+ * counted in Log_Stats_t.
+ ****************************************************************************/
+
+/*
+ * Ring buffer size in bytes, must be a power of 2.
+ */
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE				1024
+#endif
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t Log_Backend;			/* possible values from @LOG_BACKEND */
+	uint8_t Log_ITMPort;			/* stimulus port number (ITM backend) */
+	USART_RegDef_t *pUSARTx;		/* USART with baud rate and TE already set up (USART backend) */
+	DMA_RegDef_t *pDMAx;			/* DMA controller of the USART TX request (USART backend) */
+	uint8_t DMA_Stream;				/* stream of the USART TX request, see @LOG_USART_TX_DMA */
+	uint8_t DMA_Channel;			/* channel of the USART TX request, see @LOG_USART_TX_DMA */
+} Log_Config_t;
+
+/****************************************************************************
+ * Drop statistics
+ ****************************************************************************/
+typedef struct
+{
+	uint32_t DroppedMsgs;			// number of _write calls which did not fit
+	uint32_t DroppedBytes;			// bytes of those calls
+	uint32_t HighWater;				// maximum buffer fill level seen
+} Log_Stats_t;
+
+/****************************************************************************
+ * @LOG_BACKEND
+ *****************************************************************************/
+#define LOG_BACKEND_NONE			0 // discard everything, _write never blocks
+#define LOG_BACKEND_ITM				1
+#define LOG_BACKEND_USART_DMA		2
+
+/****************************************************************************
+ * @LOG_USART_TX_DMA
+ * USART TX request mapping (RM0090 DMA1/DMA2 request mapping)
+ *
+ *	USART1_TX	DMA2 Stream 7 Channel 4
+ *	USART2_TX	DMA1 Stream 6 Channel 4
+ *	USART3_TX	DMA1 Stream 3 Channel 4
+ *	UART4_TX	DMA1 Stream 4 Channel 4
+ *	UART5_TX	DMA1 Stream 7 Channel 4
+ *	USART6_TX	DMA2 Stream 6 Channel 5
+ *****************************************************************************/
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+void Log_Init(Log_Config_t *pLogConfig);
+void Log_Process(void);
+uint32_t Log_Pending(void);
+void Log_GetStats(Log_Stats_t *pStats);
+
+// Call this from the DMAx_Streamy_IRQHandler of the USART TX stream.
+void Log_IRQHandling(void);
+
+#endif /* INC_STM32F407XX_LOG_H_ */
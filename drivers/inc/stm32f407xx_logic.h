@@ -0,0 +1,127 @@
+#ifndef INC_STM32F407XX_LOGIC_H_
+#define INC_STM32F407XX_LOGIC_H_
+
+// Built on the GPIO and timer drivers, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Logic analyzer: timer paced DMA samples of a GPIO port's IDR
+ *
+ * A TIM1 or TIM8 update DMA request copies the port's IDR into a circular
+ * buffer of 16 bit samples at Logic_SampleHz (only DMA2 reaches the GPIO
+ * ports). The CPU looks at the samples only on the half and full buffer
+ * interrupts: it searches the half just filled for the trigger, and once
+ * PostTrigger samples followed it, stops the DMA at the next boundary.
+ * The buffer then holds the samples around the trigger, oldest first from
+ * Logic_GetSample(0) on, the trigger at TriggerIndex.
+ *
+ * Triggers (on the pins of TrigMask, compared with the sample before, the
+ * first one with the GPIO_ReadFromInputPort value at the start):
+ * - LOGIC_TRIGGER_NONE: the first sample,
+ * - LOGIC_TRIGGER_PATTERN: the pins become equal to TrigValue,
+ * - LOGIC_TRIGGER_RISING / FALLING / EDGE: a pin goes high / low / either.
+ *
+ * PostTrigger must be below BufferLen / 2: at least BufferLen / 2 -
+ * PostTrigger samples before the trigger are kept (less the few the DMA
+ * takes while the interrupt stops it).
+ *
+ * Logic_Compress turns the capture into runs (levels of the pins of
+ * PinMask, number of samples), Logic_Export prints them, through printf
+ * and so the log module.
+ *
+ * The application enables the IRQ of the update DMA stream (TIM1: DMA2
+ * stream 5, TIM8: DMA2 stream 1, DMA_IRQHandling(&handle.UpDMA)) and calls
+ * Logic_EventHandling from TIM_ApplicationEventCallback.
+ ****************************************************************************/
+
+/****************************************************************************
+ * @LOGIC_TRIGGER
+ *****************************************************************************/
+#define LOGIC_TRIGGER_NONE			0
+#define LOGIC_TRIGGER_PATTERN		1
+#define LOGIC_TRIGGER_RISING		2
+#define LOGIC_TRIGGER_FALLING		3
+#define LOGIC_TRIGGER_EDGE			4
+
+/****************************************************************************
+ * @LOGIC_RETURN
+ * Return values of Logic_Init and Logic_Start
+ *****************************************************************************/
+#define LOGIC_OK					0 // started
+#define LOGIC_BUSY					1 // a capture is running
+#define LOGIC_ERR_PARAM				2 // not TIM1/TIM8, rate out of range, bad buffer or PostTrigger
+
+/****************************************************************************
+ * Possible logic analyzer application events
+ *****************************************************************************/
+#define LOGIC_EVENT_TRIGGERED		1 // the trigger was found, the capture goes on
+#define LOGIC_EVENT_CMPLT			2 // the capture is in the buffer
+#define LOGIC_EVENT_ERROR			3 // DMA error, the capture is stopped
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	TIM_Handle_t *pTIMHandle;		/* pTIMx: TIM1 or TIM8, the rest is set by Logic_Init */
+	GPIO_RegDef_t *pGPIOx;			/* port to sample, pins configured by the application */
+	uint16_t PinMask;				/* pins kept by Logic_Compress */
+	uint32_t Logic_SampleHz;		/* samples per second */
+	uint16_t *pBuffer;
+	uint16_t BufferLen;				/* samples, even */
+	uint8_t Logic_Trigger;			/* possible values from @LOGIC_TRIGGER */
+	uint16_t TrigMask;				/* pins the trigger looks at */
+	uint16_t TrigValue;				/* LOGIC_TRIGGER_PATTERN: their levels */
+	uint16_t PostTrigger;			/* samples after the trigger, below BufferLen / 2 */
+} Logic_Config_t;
+
+/*
+ * Run of equal samples, see Logic_Compress
+ */
+typedef struct
+{
+	uint16_t Levels;				/* pins of PinMask */
+	uint16_t Length;				/* samples */
+} Logic_Run_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Logic_Config_t Config;
+	uint32_t SampleHz;				/* the rate the timer really runs at */
+	uint8_t Busy;
+	uint8_t Triggered;
+	uint16_t Prev;					/* sample before the half to search */
+	uint32_t Boundary;				/* samples in the buffer at the last half boundary */
+	uint32_t TriggerSample;			/* since the start */
+
+	/* the capture, after LOGIC_EVENT_CMPLT */
+	uint16_t Oldest;				/* buffer index of the first sample */
+	uint16_t Count;					/* samples */
+	uint16_t TriggerIndex;			/* of the trigger, from the first sample */
+} Logic_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Logic_Init(Logic_Handle_t *pLogic, Logic_Config_t *pConfig);
+
+uint8_t Logic_Start(Logic_Handle_t *pLogic);
+void Logic_Stop(Logic_Handle_t *pLogic);
+uint8_t Logic_Busy(Logic_Handle_t *pLogic);
+
+uint16_t Logic_GetSample(Logic_Handle_t *pLogic, uint16_t Index);
+uint32_t Logic_Compress(Logic_Handle_t *pLogic, Logic_Run_t *pRuns, uint32_t MaxRuns);
+void Logic_Export(Logic_Handle_t *pLogic, const Logic_Run_t *pRuns, uint32_t NumRuns);
+
+// Call this from TIM_ApplicationEventCallback.
+void Logic_EventHandling(Logic_Handle_t *pLogic, TIM_Handle_t *pTIMHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Logic_ApplicationEventCallback(Logic_Handle_t *pLogic, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_LOGIC_H_ */
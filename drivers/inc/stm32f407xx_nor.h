@@ -0,0 +1,169 @@
+#ifndef INC_STM32F407XX_NOR_H_
+#define INC_STM32F407XX_NOR_H_
+
+// Built on the SPI driver and the scheduler, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * SPI NOR flash (W25Qxx and compatible 25-series chips)
+ *
+ * Every operation runs in the background on the SPI DMA streams
+ * (SPI_TransferDMA) and ends with a Nor_ApplicationEventCallback:
+ *
+ * - Nor_ReadId		JEDEC ID (0x9F), sets the capacity. Call it first.
+ * - Nor_Read		fast read (0x0B): one command, then the data streams
+ * 					straight into the caller's buffer, any length
+ * - Nor_Program	page program (0x02), split at the 256 byte page
+ * 					boundaries, each page with its own write enable
+ * - Nor_Erase		4 KB sector (0x20), 64 KB block (0xD8) or chip (0xC7)
+ *
+ * Busy polling (status register 1, WIP) follows each program and erase.
+ * A page is done within a millisecond, it is polled at once; an erase takes
+ * tens of milliseconds to seconds, its polls are a Sched_Timer_t, so the
+ * CPU can sleep meanwhile.
+ *
+ * Read-ahead: after a read, the next NOR_CACHE_SIZE bytes are fetched into
+ * the handle while the bus is free. A following sequential read is served
+ * from there (and the rest, if any, from the chip). Programs and erases
+ * drop the cached bytes they touch. One operation may be submitted while a
+ * read-ahead is running, it starts when the read-ahead is done.
+ *
+ * The application
+ * - configures the SPI: master, 8 bit frames, mode 0 or 3, SSM/SSI, SPE,
+ *   and the IRQs of its RX and TX DMA streams (DMA_IRQHandling),
+ * - configures the chip select pin as push-pull output,
+ * - calls Nor_EventHandling from SPI_ApplicationEventCallback,
+ * - runs the scheduler and calls Sched_Tick (erase polling, cache hits).
+ ****************************************************************************/
+
+/*
+ * Size of the read-ahead cache in the handle (bytes)
+ */
+#ifndef NOR_CACHE_SIZE
+#define NOR_CACHE_SIZE				256
+#endif
+
+/*
+ * Longest single DMA transfer of a read (frames)
+ */
+#define NOR_DMA_CHUNK				0x8000
+
+/*
+ * Geometry
+ */
+#define NOR_PAGE_SIZE				256
+#define NOR_SECTOR_SIZE				4096
+#define NOR_BLOCK_SIZE				65536
+
+/*
+ * Command set
+ */
+#define NOR_CMD_WRITE_ENABLE		0x06
+#define NOR_CMD_READ_STATUS1		0x05
+#define NOR_CMD_PAGE_PROGRAM		0x02
+#define NOR_CMD_FAST_READ			0x0B
+#define NOR_CMD_SECTOR_ERASE		0x20
+#define NOR_CMD_BLOCK_ERASE			0xD8
+#define NOR_CMD_CHIP_ERASE			0xC7
+#define NOR_CMD_JEDEC_ID			0x9F
+
+/*
+ * Status register 1
+ */
+#define NOR_SR1_WIP					0 // write in progress
+#define NOR_SR1_WEL					1 // write enable latch
+
+/****************************************************************************
+ * @NOR_ERASE
+ *****************************************************************************/
+#define NOR_ERASE_SECTOR			0
+#define NOR_ERASE_BLOCK				1
+#define NOR_ERASE_CHIP				2
+
+/****************************************************************************
+ * @NOR_RETURN
+ * Return values of the operations
+ *****************************************************************************/
+#define NOR_OK						0 // started (or queued behind the read-ahead)
+#define NOR_BUSY					1 // an operation is in progress
+#define NOR_ERR_PARAM				2 // out of the chip, misaligned, or no Nor_ReadId yet
+
+/****************************************************************************
+ * Possible NOR application events
+ *****************************************************************************/
+#define NOR_EVENT_ID_CMPLT			1
+#define NOR_EVENT_READ_CMPLT		2
+#define NOR_EVENT_PROGRAM_CMPLT		3
+#define NOR_EVENT_ERASE_CMPLT		4
+#define NOR_EVENT_ERROR				5 // SPI/DMA error, or no chip answered the ID
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	SPI_Handle_t *pSPIHandle;		/* SPI_Init done and enabled, 8 bit frames */
+	GPIO_RegDef_t *pCSPort;			/* chip select, active low */
+	uint8_t CSPin;
+	uint8_t Nor_PollTicks;			/* scheduler ticks between erase status polls */
+	uint8_t Nor_Priority;			/* @SCHED_PRIORITY of the driver's events */
+	uint8_t Nor_ReadAhead;			/* ENABLE or DISABLE */
+} Nor_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Nor_Config_t Config;
+	uint8_t JedecId[3];				/* manufacturer, memory type, capacity */
+	uint32_t Capacity;				/* bytes, 0 until Nor_ReadId */
+
+	/* operation in progress */
+	uint8_t Op;
+	uint8_t Phase;
+	uint8_t ExpectedEv;				/* SPI event which ends the current transfer */
+	uint32_t Addr;
+	uint8_t *pData;
+	uint32_t Len;
+	uint32_t Chunk;					/* bytes of the current transfer */
+	uint32_t ReadEnd;				/* end address of the read in progress */
+	uint8_t Tx[5];
+	uint8_t Rx[4];
+
+	/* operation waiting for the read-ahead */
+	uint8_t PendingOp;
+	uint32_t PendingAddr;
+	uint8_t *pPendingData;
+	uint32_t PendingLen;
+
+	/* read-ahead */
+	uint8_t Cache[NOR_CACHE_SIZE];
+	uint32_t CacheAddr;
+	uint32_t CacheLen;				/* valid bytes from CacheAddr */
+	uint32_t CacheHitBytes;			/* read bytes served from the cache */
+	uint32_t FlashReadBytes;		/* bytes read from the chip (read-ahead included) */
+
+	Sched_Timer_t Timer;
+} Nor_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+void Nor_Init(Nor_Handle_t *pNor, Nor_Config_t *pConfig);
+
+uint8_t Nor_ReadId(Nor_Handle_t *pNor);
+uint8_t Nor_Read(Nor_Handle_t *pNor, uint32_t Addr, uint8_t *pBuffer, uint32_t Len);
+uint8_t Nor_Program(Nor_Handle_t *pNor, uint32_t Addr, const uint8_t *pData, uint32_t Len);
+uint8_t Nor_Erase(Nor_Handle_t *pNor, uint32_t Addr, uint8_t EraseType);
+uint8_t Nor_Busy(Nor_Handle_t *pNor);
+
+// Call this from SPI_ApplicationEventCallback.
+void Nor_EventHandling(Nor_Handle_t *pNor, SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Nor_ApplicationEventCallback(Nor_Handle_t *pNor, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_NOR_H_ */
@@ -0,0 +1,101 @@
+#ifndef INC_STM32F407XX_PATTERN_H_
+#define INC_STM32F407XX_PATTERN_H_
+
+// Built on the GPIO and timer drivers, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Pattern generator: timer paced DMA writes to a GPIO port's BSRR
+ *
+ * Drives the pins of PinMask on one port through a list of steps at a fixed
+ * rate (stepper sequences, custom serial protocols, test signals). Each
+ * step is a BSRR word: the pins to set in the low half, the pins to reset
+ * in the high half, pins of other drivers on the port are not touched.
+ * Pattern_Word and Pattern_Fill build the words from pin levels.
+ *
+ * A TIM1 or TIM8 update DMA request writes the next word every step, so
+ * the edges come with the timer's accuracy, whatever the CPU does (only
+ * DMA2 reaches the GPIO ports). Modes:
+ * - PATTERN_MODE_ONESHOT: the buffer once, then PATTERN_EVENT_CMPLT,
+ * - PATTERN_MODE_CIRCULAR: the buffer over and over until Pattern_Stop,
+ *   with no interrupts (only PATTERN_EVENT_ERROR),
+ * - Pattern_StartStream: two buffers in turn (DMA double buffer mode).
+ *   PATTERN_EVENT_BUFFER0_FREE or PATTERN_EVENT_BUFFER1_FREE says which
+ *   one has been sent: refill it within the time of the other one.
+ *
+ * The pins keep the level of the last step. The first step goes out at the
+ * next update event, at most one step period after the start.
+ *
+ * The application enables the IRQ of the update DMA stream (TIM1: DMA2
+ * stream 5, TIM8: DMA2 stream 1, DMA_IRQHandling(&handle.UpDMA)) and calls
+ * Pattern_EventHandling from TIM_ApplicationEventCallback.
+ ****************************************************************************/
+
+/*
+ * Modes of Pattern_Start
+ */
+#define PATTERN_MODE_ONESHOT		0
+#define PATTERN_MODE_CIRCULAR		1
+#define PATTERN_MODE_STREAM			2 // set by Pattern_StartStream
+
+/****************************************************************************
+ * @PATTERN_RETURN
+ * Return values of Pattern_Init and the start functions
+ *****************************************************************************/
+#define PATTERN_OK					0 // started
+#define PATTERN_BUSY				1 // a pattern is running
+#define PATTERN_ERR_PARAM			2 // not TIM1/TIM8, rate out of range, no words
+
+/****************************************************************************
+ * Possible pattern application events
+ *****************************************************************************/
+#define PATTERN_EVENT_CMPLT			1 // one shot: the last step is out
+#define PATTERN_EVENT_BUFFER0_FREE	2 // stream: pBuffer0 was sent, refill it
+#define PATTERN_EVENT_BUFFER1_FREE	3 // stream: pBuffer1 was sent, refill it
+#define PATTERN_EVENT_ERROR			4 // DMA error, the pattern is stopped
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	TIM_Handle_t *pTIMHandle;		/* pTIMx: TIM1 or TIM8, the rest is set by Pattern_Init */
+	GPIO_RegDef_t *pGPIOx;
+	uint16_t PinMask;				/* pins driven by the pattern, push-pull outputs */
+	uint32_t Pattern_StepHz;		/* steps per second */
+} Pattern_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Pattern_Config_t Config;
+	uint32_t StepHz;				/* the rate the timer really runs at */
+	uint8_t Mode;					/* PATTERN_MODE_xxx */
+	uint8_t Busy;
+	uint32_t Buffers;				/* stream: buffers sent */
+} Pattern_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Pattern_Init(Pattern_Handle_t *pPattern, Pattern_Config_t *pConfig);
+
+uint32_t Pattern_Word(Pattern_Handle_t *pPattern, uint16_t Levels);
+void Pattern_Fill(Pattern_Handle_t *pPattern, uint32_t *pWords, const uint16_t *pLevels, uint32_t Len);
+
+uint8_t Pattern_Start(Pattern_Handle_t *pPattern, uint32_t *pWords, uint16_t Len, uint8_t Mode);
+uint8_t Pattern_StartStream(Pattern_Handle_t *pPattern, uint32_t *pBuffer0, uint32_t *pBuffer1, uint16_t Len);
+void Pattern_Stop(Pattern_Handle_t *pPattern);
+uint8_t Pattern_Busy(Pattern_Handle_t *pPattern);
+
+// Call this from TIM_ApplicationEventCallback.
+void Pattern_EventHandling(Pattern_Handle_t *pPattern, TIM_Handle_t *pTIMHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Pattern_ApplicationEventCallback(Pattern_Handle_t *pPattern, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_PATTERN_H_ */
@@ -0,0 +1,125 @@
+#ifndef INC_STM32F407XX_PERIPH_H_
+#define INC_STM32F407XX_PERIPH_H_
+
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Peripheral instance descriptors
+ *
+ * One row per peripheral instance: base address, RCC enable/reset bits,
+ * interrupt numbers and DMA request mapping. The drivers look their
+ * instance up by the register block pointer; the lookup is arithmetic
+ * (a slot map over the 1 KB peripheral address slots), so clock, reset,
+ * IRQ and DMA setup need no per-instance branches. A new instance is one
+ * new row (and slot map entry) in stm32f407xx_periph.c.
+ ****************************************************************************/
+
+/****************************************************************************
+ * @PERIPH_BUS
+ * Word offset of the bus registers from the AHB1 register in each RCC
+ * register group (xxxRSTR, xxxENR, xxxLPENR).
+ *****************************************************************************/
+#define PERIPH_BUS_AHB1				0
+#define PERIPH_BUS_AHB2				1
+#define PERIPH_BUS_AHB3				2
+#define PERIPH_BUS_APB1				4
+#define PERIPH_BUS_APB2				5
+
+#define PERIPH_NO_IRQ				0xFF
+
+/****************************************************************************
+ * @PERIPH_ID
+ * Instance numbers (index into the descriptor table)
+ *****************************************************************************/
+#define PERIPH_ID_GPIOA				0
+#define PERIPH_ID_GPIOB				1
+#define PERIPH_ID_GPIOC				2
+#define PERIPH_ID_GPIOD				3
+#define PERIPH_ID_GPIOE				4
+#define PERIPH_ID_GPIOF				5
+#define PERIPH_ID_GPIOG				6
+#define PERIPH_ID_GPIOH				7
+#define PERIPH_ID_GPIOI				8
+#define PERIPH_ID_SPI1				9
+#define PERIPH_ID_SPI2				10
+#define PERIPH_ID_SPI3				11
+#define PERIPH_ID_SPI4				12
+#define PERIPH_ID_I2C1				13
+#define PERIPH_ID_I2C2				14
+#define PERIPH_ID_I2C3				15
+#define PERIPH_ID_USART1			16
+#define PERIPH_ID_USART2			17
+#define PERIPH_ID_USART3			18
+#define PERIPH_ID_UART4				19
+#define PERIPH_ID_UART5				20
+#define PERIPH_ID_USART6			21
+#define PERIPH_ID_TIM1				22
+#define PERIPH_ID_TIM2				23
+#define PERIPH_ID_TIM3				24
+#define PERIPH_ID_TIM4				25
+#define PERIPH_ID_TIM5				26
+#define PERIPH_ID_TIM6				27
+#define PERIPH_ID_TIM7				28
+#define PERIPH_ID_TIM8				29
+#define PERIPH_ID_TIM9				30
+#define PERIPH_ID_TIM10				31
+#define PERIPH_ID_TIM11				32
+#define PERIPH_ID_TIM12				33
+#define PERIPH_ID_TIM13				34
+#define PERIPH_ID_TIM14				35
+#define PERIPH_ID_ADC1				36	// ADC1..3 must stay consecutive (0x100 apart)
+#define PERIPH_ID_ADC2				37
+#define PERIPH_ID_ADC3				38
+#define PERIPH_ID_DMA1				39
+#define PERIPH_ID_DMA2				40
+#define PERIPH_ID_SYSCFG			41
+#define PERIPH_ID_PWR				42
+
+#define PERIPH_NO_OF_INSTANCES		43
+#define PERIPH_NO_ID				0xFF
+
+/****************************************************************************
+ * DMA request of a peripheral (RM0090 DMA1/DMA2 request mapping)
+ ****************************************************************************/
+typedef struct
+{
+	DMA_RegDef_t *pDMAx;			/* DMA1 or DMA2, 0 if there is no request */
+	uint8_t Stream;					/* stream number 0..7 */
+	uint8_t Channel;				/* possible values from @DMA_CHANNEL */
+} Periph_DMARequest_t;
+
+/****************************************************************************
+ * Instance descriptor
+ ****************************************************************************/
+typedef struct
+{
+	uint32_t BaseAddr;
+	uint8_t Bus;					/* possible values from @PERIPH_BUS */
+	uint8_t EnBit;					/* bit in RCC xxxENR and xxxLPENR */
+	uint8_t RstBit;					/* bit in RCC xxxRSTR (ADC1..3 share one) */
+	uint8_t IRQNumber;				/* global interrupt (I2C: event, TIM1/8: update) */
+	uint8_t IRQNumber2;				/* I2C error, TIM1/8 capture compare, else PERIPH_NO_IRQ */
+	Periph_DMARequest_t DMARx;		/* peripheral to memory request (ADC: conversions) */
+	Periph_DMARequest_t DMATx;		/* memory to peripheral request */
+} Periph_Instance_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Periph_GetId(const __vo void *pRegs);
+const Periph_Instance_t *Periph_Get(const __vo void *pRegs);
+const Periph_Instance_t *Periph_GetById(uint8_t Id);
+
+/*
+ * Clock and reset control
+ */
+void Periph_ClockControl(const __vo void *pRegs, uint8_t EnorDi);
+void Periph_Reset(const __vo void *pRegs);
+
+/*
+ * NVIC, shared by the xxx_IRQInterruptConfig / xxx_IRQPriorityConfig APIs
+ */
+void NVIC_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void NVIC_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority);
+
+#endif /* INC_STM32F407XX_PERIPH_H_ */
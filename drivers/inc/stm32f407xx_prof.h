@@ -0,0 +1,139 @@
+#ifndef INC_STM32F407XX_PROF_H_
+#define INC_STM32F407XX_PROF_H_
+
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Function level profiler (DWT cycle counter)
+ *
+ * A zone is a piece of code between PROF_ZONE_BEGIN and PROF_ZONE_END. Each
+ * zone has a row in the zone table with its count and min/max/total cycles.
+ * Time spent in interrupt handlers which preempt a thread mode zone is not
+ * counted for it.
+ *
+ * The driver interrupt handling APIs (GPIO_IRQHandling, DMA_IRQHandling,
+ * USART_IRQHandling, ...) are zones of their own (PROF_ISR_BEGIN/END), one
+ * per function, and their entry and exit go into a small event trace.
+ * Handler zones start at the driver call, after the exception entry, and
+ * include the handlers which preempt them.
+ *
+ * Everything is compiled in only with PROF_ENABLE defined (e.g.
+ * -DPROF_ENABLE); otherwise the macros are empty and cost nothing.
+ *
+ *	void SPI2_Send(void)
+ *	{
+ *		PROF_ZONE_BEGIN(send);
+ *		SPI_SendData(SPI2, buffer, len);
+ *		PROF_ZONE_END("SPI2_Send", send);
+ *	}
+ *
+ * Prof_Report() prints the table through printf (syscalls / log module).
+ ****************************************************************************/
+
+#ifndef PROF_MAX_ZONES
+#define PROF_MAX_ZONES				32
+#endif
+
+/*
+ * ISR entry/exit events kept, must be a power of 2.
+ */
+#ifndef PROF_TRACE_SIZE
+#define PROF_TRACE_SIZE				64
+#endif
+
+#define PROF_NO_ZONE				0xFF
+
+/****************************************************************************
+ * Zone statistics
+ ****************************************************************************/
+typedef struct
+{
+	const char *pName;
+	uint32_t Count;
+	uint32_t Min;					// cycles
+	uint32_t Max;					// cycles
+	uint64_t Total;					// cycles
+} Prof_Zone_t;
+
+/*
+ * Start of a zone measurement: cycle counter and the interrupt handler
+ * cycles accumulated so far.
+ */
+typedef struct
+{
+	uint32_t Cycles;
+	uint32_t IsrCycles;
+} Prof_Stamp_t;
+
+/****************************************************************************
+ * ISR trace event
+ ****************************************************************************/
+typedef struct
+{
+	uint32_t Cycles;				// cycle counter at the event
+	uint8_t Zone;					// index in the zone table
+	uint8_t Event;					// @PROF_EVENT
+} Prof_Event_t;
+
+/****************************************************************************
+ * @PROF_EVENT
+ *****************************************************************************/
+#define PROF_EVENT_ISR_ENTER		0
+#define PROF_EVENT_ISR_EXIT			1
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+void Prof_Init(void);
+void Prof_Reset(void);
+void Prof_Report(void);
+void Prof_ReportTrace(void);
+
+uint8_t Prof_GetZoneCount(void);
+const Prof_Zone_t *Prof_GetZone(uint8_t Index);
+
+/*
+ * Used by the macros below
+ */
+extern __vo uint32_t prof_isr_cycles;
+
+// counter first: a handler in between is then counted, never subtracted twice
+static inline void Prof_Begin(Prof_Stamp_t *pStamp)
+{
+	pStamp->Cycles = *DWT_CYCCNT;
+	pStamp->IsrCycles = prof_isr_cycles;
+}
+
+void Prof_End(uint8_t *pZone, const char *pName, Prof_Stamp_t *pStamp);
+void Prof_IsrBegin(uint8_t *pZone, const char *pName, Prof_Stamp_t *pStamp);
+void Prof_IsrEnd(uint8_t Zone, Prof_Stamp_t *pStamp);
+
+/****************************************************************************
+ * Instrumentation macros
+ *
+ * Name must be a string which lives forever (a literal), the zone table
+ * keeps the pointer. The zone index is cached in a static variable of the
+ * call site, so only the first PROF_ZONE_END looks the name up.
+ ****************************************************************************/
+#ifdef PROF_ENABLE
+
+#define PROF_ZONE_BEGIN(Var)		Prof_Stamp_t Var; Prof_Begin(&Var)
+#define PROF_ZONE_END(Name, Var)	do { static uint8_t prof_zone = PROF_NO_ZONE; \
+										 Prof_End(&prof_zone, (Name), &(Var)); } while(0)
+
+// first and last statement of a driver IRQ handling function
+#define PROF_ISR_BEGIN()			static uint8_t prof_isr_zone = PROF_NO_ZONE; \
+									Prof_Stamp_t prof_isr_stamp; \
+									Prof_IsrBegin(&prof_isr_zone, __func__, &prof_isr_stamp)
+#define PROF_ISR_END()				Prof_IsrEnd(prof_isr_zone, &prof_isr_stamp)
+
+#else
+
+#define PROF_ZONE_BEGIN(Var)
+#define PROF_ZONE_END(Name, Var)
+#define PROF_ISR_BEGIN()
+#define PROF_ISR_END()
+
+#endif /* PROF_ENABLE */
+
+#endif /* INC_STM32F407XX_PROF_H_ */
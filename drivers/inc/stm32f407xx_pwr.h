@@ -0,0 +1,90 @@
+#ifndef INC_STM32F407XX_PWR_H_
+#define INC_STM32F407XX_PWR_H_
+
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Low-power mode manager
+ *
+ * Pwr_Idle is called from the main loop when there is nothing to do. It
+ * puts the CPU into the deepest mode which is allowed right now:
+ *
+ * - Sleep: WFI, the CPU clock stops, peripherals with a sleep clock
+ *   request (see stm32f407xx_clk.h) keep running. Any enabled interrupt
+ *   wakes the CPU up.
+ * - Stop: SLEEPDEEP + WFI, all 1.2 V domain clocks stop, the regulator
+ *   may go to low-power mode. Only EXTI lines wake the CPU up (GPIO pins
+ *   configured with GPIO_MODE_IT_xx, RTC alarm, ...). The CPU wakes up on
+ *   HSI; Pwr_Idle restores HSE, PLL and the system clock switch.
+ *
+ * A driver with a transfer in flight (SPI interrupt/DMA transfer, DMA
+ * stream) calls Pwr_VetoStop when it starts and Pwr_ReleaseStop when it
+ * is done: while one veto is held, Pwr_Idle only sleeps, and the clock of
+ * the peripheral keeps running in sleep mode.
+ *
+ * Wake latency is measured with the DWT cycle counter from the return of
+ * WFI to the end of Pwr_Idle (clock restore). The time the hardware needs
+ * before the first instruction (regulator, flash and HSI start-up, a few
+ * microseconds, see the datasheet) can not be seen by the cycle counter.
+ ****************************************************************************/
+
+/****************************************************************************
+ * Configuration
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t Pwr_StopRegulator;		/* possible values from @PWR_REGULATOR */
+	uint8_t Pwr_FlashPowerDown;		/* ENABLE: flash off in Stop mode (lower current, slower wake up) */
+	uint32_t Pwr_MaxWakeCycles;		/* Stop is not used once its wake latency exceeded this, 0: no bound */
+} Pwr_Config_t;
+
+/****************************************************************************
+ * Statistics
+ ****************************************************************************/
+typedef struct
+{
+	uint32_t Sleeps;				/* times entered sleep mode */
+	uint32_t Stops;					/* times entered stop mode */
+	uint32_t StopVetoed;			/* Stop asked for, but only slept */
+	uint32_t LastWakeCycles[2];		/* per mode (PWR_MODE_xx - 1) */
+	uint32_t MaxWakeCycles[2];
+} Pwr_Stats_t;
+
+/****************************************************************************
+ * @PWR_MODE
+ * Ordered by depth
+ *****************************************************************************/
+#define PWR_MODE_RUN				0
+#define PWR_MODE_SLEEP				1
+#define PWR_MODE_STOP				2
+
+/****************************************************************************
+ * @PWR_REGULATOR
+ * Voltage regulator in Stop mode
+ *****************************************************************************/
+#define PWR_REGULATOR_MAIN			0
+#define PWR_REGULATOR_LOW_POWER		1
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+void Pwr_Init(Pwr_Config_t *pPwrConfig);
+
+/*
+ * Driver activity
+ */
+void Pwr_VetoStop(const __vo void *pRegs);
+void Pwr_ReleaseStop(const __vo void *pRegs);
+uint8_t Pwr_GetAllowedMode(void);
+
+/*
+ * Idle
+ */
+uint8_t Pwr_Idle(uint8_t MaxMode);
+
+/*
+ * Statistics
+ */
+void Pwr_GetStats(Pwr_Stats_t *pStats);
+
+#endif /* INC_STM32F407XX_PWR_H_ */
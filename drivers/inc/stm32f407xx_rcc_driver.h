@@ -0,0 +1,26 @@
+#ifndef INC_STM32F407XX_RCC_DRIVER_H_
+#define INC_STM32F407XX_RCC_DRIVER_H_
+
+// Every driver header should contain this device-specific header file.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Oscillator frequencies
+ * HSE is the 8 MHz crystal of the STM32F4 Discovery board.
+ ****************************************************************************/
+#define RCC_HSI_VALUE				16000000U
+#ifndef RCC_HSE_VALUE
+#define RCC_HSE_VALUE				8000000U
+#endif
+
+/****************************************************************************
+ *							APIs supported by this driver
+ * 		For more information about the APIs check the function definitions
+ ****************************************************************************/
+uint32_t RCC_GetSYSCLKValue(void);
+uint32_t RCC_GetHCLKValue(void);
+uint32_t RCC_GetPCLK1Value(void);
+uint32_t RCC_GetPCLK2Value(void);
+uint32_t RCC_GetPLLOutputClock(void);
+
+#endif /* INC_STM32F407XX_RCC_DRIVER_H_ */
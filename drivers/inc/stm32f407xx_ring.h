@@ -0,0 +1,350 @@
+#ifndef INC_STM32F407XX_RING_H_
+#define INC_STM32F407XX_RING_H_
+
+#include <string.h>
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Lock-free byte ring buffer (header only)
+ *
+ * For data paths between interrupt handlers and the main loop (or between
+ * two handlers). The buffer size is a power of 2; Head and Tail are free
+ * running indexes (modulo RING_INDEX_MASK + 1), Head - Tail is the fill
+ * level, so all Size bytes can be used.
+ *
+ * Single producer / single consumer (SPSC): only the producer writes Head,
+ * only the consumer writes Tail, no lock and no masked interrupts.
+ *
+ *	producer (e.g. SPI RX ISR)			consumer (main loop)
+ *	Ring_Push(&Ring, pData, Len);		n = Ring_Pop(&Ring, Buf, sizeof(Buf));
+ *
+ * Zero-copy: Ring_WriteSpan / Ring_ReadSpan give the largest contiguous
+ * free / filled piece of the buffer (e.g. to start a DMA transfer on it),
+ * Ring_Commit / Ring_Release hand it over once it is written / read.
+ *
+ * Multiple producers / single consumer (MPSC): Ring_PushMP reserves space
+ * with an atomic compare and swap (LDREX/STREX on the Cortex-M4), so it may
+ * be called from any number of interrupt priorities and from thread mode at
+ * the same time. Reserved data becomes visible when the last producer in
+ * flight is done: a handler which preempts a producer publishes its data
+ * when the preempted producer returns. Do not mix Ring_Push / Ring_Commit
+ * and Ring_PushMP on one ring.
+ *
+ * All functions are interrupt safe for their role (producer or consumer)
+ * and never wait.
+ ****************************************************************************/
+
+/*
+ * Indexes are 24 bits wide, the top 8 bits of Reserve count the
+ * producers in flight (Ring_PushMP). Largest buffer: RING_MAX_SIZE bytes.
+ */
+#define RING_INDEX_MASK				0x00FFFFFFU
+#define RING_WRITER					0x01000000U
+#define RING_MAX_SIZE				0x00400000U
+
+typedef struct
+{
+	uint8_t *pBuffer;
+	uint32_t Size;					/* power of 2, at most RING_MAX_SIZE */
+	uint32_t Head;					/* published write index (producer) */
+	uint32_t Tail;					/* read index (consumer) */
+	uint32_t Reserve;				/* Ring_PushMP: producers in flight << 24 | reserved write index */
+} Ring_t;
+
+/*
+ * Helper functions
+ */
+static inline void Ring_CopyIn(Ring_t *pRing, uint32_t Index, const uint8_t *pData, uint32_t Len)
+{
+	uint32_t offset = Index & (pRing->Size - 1);
+	uint32_t first = pRing->Size - offset;
+
+	// at most two pieces (wrap around at the end of the buffer)
+	if(first > Len)
+		first = Len;
+	memcpy(&pRing->pBuffer[offset], pData, first);
+	memcpy(&pRing->pBuffer[0], pData + first, Len - first);
+}
+
+static inline void Ring_CopyOut(const Ring_t *pRing, uint32_t Index, uint8_t *pData, uint32_t Len)
+{
+	uint32_t offset = Index & (pRing->Size - 1);
+	uint32_t first = pRing->Size - offset;
+
+	if(first > Len)
+		first = Len;
+	memcpy(pData, &pRing->pBuffer[offset], first);
+	memcpy(pData + first, &pRing->pBuffer[0], Len - first);
+}
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+
+/**************************************************************************
+ * Initialize a ring buffer
+ * ************************************************************************
+ * @fn			- Ring_Init
+ *
+ * @brief		- Attaches the storage and empties the ring.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[in]	- storage
+ * @param[in]	- size of the storage in bytes, power of 2, <= RING_MAX_SIZE
+ *
+ * @return		- none
+ *
+ * @Note		- Neither the producer nor the consumer may be active.
+ ****************************************************************************/
+static inline void Ring_Init(Ring_t *pRing, uint8_t *pBuffer, uint32_t Size)
+{
+	pRing->pBuffer = pBuffer;
+	pRing->Size = Size;
+	pRing->Head = 0;
+	pRing->Tail = 0;
+	pRing->Reserve = 0;
+}
+
+/**************************************************************************
+ * Fill level
+ * ************************************************************************
+ * @fn			- Ring_Used
+ *
+ * @brief		- Bytes the consumer can read.
+ *
+ * @param[in]	- pointer to the ring
+ *
+ * @return		- number of bytes
+ ****************************************************************************/
+static inline uint32_t Ring_Used(const Ring_t *pRing)
+{
+	uint32_t head = __atomic_load_n(&pRing->Head, __ATOMIC_ACQUIRE);
+	uint32_t tail = __atomic_load_n(&pRing->Tail, __ATOMIC_ACQUIRE);
+
+	return (head - tail) & RING_INDEX_MASK;
+}
+
+/**************************************************************************
+ * @fn			- Ring_Free
+ *
+ * @brief		- Bytes the (single) producer can write.
+ *
+ * @param[in]	- pointer to the ring
+ *
+ * @return		- number of bytes
+ *
+ * @Note		- For the SPSC producer the free space only grows until it
+ * 				  writes, so Ring_Free >= Len guarantees that Ring_Push
+ * 				  takes all Len bytes.
+ ****************************************************************************/
+static inline uint32_t Ring_Free(const Ring_t *pRing)
+{
+	return pRing->Size - Ring_Used(pRing);
+}
+
+/**************************************************************************
+ * Single producer
+ * ************************************************************************
+ * @fn			- Ring_WriteSpan
+ *
+ * @brief		- Largest contiguous free piece at the write index.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[out]	- start of the piece
+ *
+ * @return		- length of the piece in bytes, 0 if the ring is full
+ *
+ * @Note		- Write into the piece, then call Ring_Commit.
+ ****************************************************************************/
+static inline uint32_t Ring_WriteSpan(Ring_t *pRing, uint8_t **ppSpan)
+{
+	uint32_t head = pRing->Head;
+	uint32_t offset = head & (pRing->Size - 1);
+	uint32_t free = Ring_Free(pRing);
+	uint32_t chunk = pRing->Size - offset;
+
+	*ppSpan = &pRing->pBuffer[offset];
+	return (chunk < free) ? chunk : free;
+}
+
+/**************************************************************************
+ * @fn			- Ring_Commit
+ *
+ * @brief		- Makes Len bytes written at the write index visible to
+ * 				  the consumer.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[in]	- number of bytes, at most Ring_Free
+ *
+ * @return		- none
+ ****************************************************************************/
+static inline void Ring_Commit(Ring_t *pRing, uint32_t Len)
+{
+	// the data must be visible before the consumer sees the new head
+	__atomic_store_n(&pRing->Head, (pRing->Head + Len) & RING_INDEX_MASK, __ATOMIC_RELEASE);
+}
+
+/**************************************************************************
+ * @fn			- Ring_Push
+ *
+ * @brief		- Copies as much of the data as fits into the ring.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[in]	- data
+ * @param[in]	- length of the data
+ *
+ * @return		- number of bytes copied
+ *
+ * @Note		- Check Ring_Free first to copy all or nothing.
+ ****************************************************************************/
+static inline uint32_t Ring_Push(Ring_t *pRing, const void *pData, uint32_t Len)
+{
+	uint32_t free = Ring_Free(pRing);
+
+	if(Len > free)
+		Len = free;
+
+	Ring_CopyIn(pRing, pRing->Head, (const uint8_t*)pData, Len);
+	Ring_Commit(pRing, Len);
+
+	return Len;
+}
+
+/**************************************************************************
+ * Single consumer
+ * ************************************************************************
+ * @fn			- Ring_ReadSpan
+ *
+ * @brief		- Largest contiguous filled piece at the read index.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[out]	- start of the piece
+ *
+ * @return		- length of the piece in bytes, 0 if the ring is empty
+ *
+ * @Note		- Read the piece, then call Ring_Release.
+ ****************************************************************************/
+static inline uint32_t Ring_ReadSpan(Ring_t *pRing, uint8_t **ppSpan)
+{
+	uint32_t offset = pRing->Tail & (pRing->Size - 1);
+	uint32_t used = Ring_Used(pRing);
+	uint32_t chunk = pRing->Size - offset;
+
+	*ppSpan = &pRing->pBuffer[offset];
+	return (chunk < used) ? chunk : used;
+}
+
+/**************************************************************************
+ * @fn			- Ring_Release
+ *
+ * @brief		- Gives Len bytes at the read index back to the producer.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[in]	- number of bytes, at most Ring_Used
+ *
+ * @return		- none
+ ****************************************************************************/
+static inline void Ring_Release(Ring_t *pRing, uint32_t Len)
+{
+	// the data must be read before the producer may overwrite it
+	__atomic_store_n(&pRing->Tail, (pRing->Tail + Len) & RING_INDEX_MASK, __ATOMIC_RELEASE);
+}
+
+/**************************************************************************
+ * @fn			- Ring_Peek
+ *
+ * @brief		- Copies up to MaxLen bytes out of the ring without
+ * 				  removing them.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[in]	- destination
+ * @param[in]	- size of the destination
+ *
+ * @return		- number of bytes copied
+ ****************************************************************************/
+static inline uint32_t Ring_Peek(Ring_t *pRing, void *pData, uint32_t MaxLen)
+{
+	uint32_t used = Ring_Used(pRing);
+
+	if(MaxLen > used)
+		MaxLen = used;
+
+	Ring_CopyOut(pRing, pRing->Tail, (uint8_t*)pData, MaxLen);
+
+	return MaxLen;
+}
+
+/**************************************************************************
+ * @fn			- Ring_Pop
+ *
+ * @brief		- Copies up to MaxLen bytes out of the ring and removes them.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[in]	- destination
+ * @param[in]	- size of the destination
+ *
+ * @return		- number of bytes copied
+ ****************************************************************************/
+static inline uint32_t Ring_Pop(Ring_t *pRing, void *pData, uint32_t MaxLen)
+{
+	uint32_t len = Ring_Peek(pRing, pData, MaxLen);
+
+	Ring_Release(pRing, len);
+
+	return len;
+}
+
+/**************************************************************************
+ * Multiple producers
+ * ************************************************************************
+ * @fn			- Ring_PushMP
+ *
+ * @brief		- Copies the data into the ring if all of it fits.
+ *
+ * @param[in]	- pointer to the ring
+ * @param[in]	- data
+ * @param[in]	- length of the data
+ *
+ * @return		- Len, or 0 if the data did not fit (nothing copied)
+ *
+ * @Note		- Any context, at most 255 producers in flight at once.
+ * 				  Space reserved by a producer which is still copying
+ * 				  counts as used.
+ ****************************************************************************/
+static inline uint32_t Ring_PushMP(Ring_t *pRing, const void *pData, uint32_t Len)
+{
+	uint32_t old, new, start, tail;
+
+	// 1. reserve Len bytes and register as a producer in flight
+	old = __atomic_load_n(&pRing->Reserve, __ATOMIC_RELAXED);
+	do
+	{
+		start = old & RING_INDEX_MASK;
+		tail = __atomic_load_n(&pRing->Tail, __ATOMIC_ACQUIRE);
+		if(((start - tail) & RING_INDEX_MASK) + Len > pRing->Size)
+			return 0;
+		new = ((old & ~RING_INDEX_MASK) + RING_WRITER) | ((start + Len) & RING_INDEX_MASK);
+	} while(!__atomic_compare_exchange_n(&pRing->Reserve, &old, new, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+	// 2. copy, the space is ours
+	Ring_CopyIn(pRing, start, (const uint8_t*)pData, Len);
+
+	// 3. unregister; the last producer out publishes everything reserved
+	new = __atomic_sub_fetch(&pRing->Reserve, RING_WRITER, __ATOMIC_ACQ_REL);
+	if((new & ~RING_INDEX_MASK) == 0)
+	{
+		uint32_t end = new & RING_INDEX_MASK;
+		uint32_t head = __atomic_load_n(&pRing->Head, __ATOMIC_RELAXED);
+
+		// Head only moves forward: a later producer may have published more already.
+		while(end != head && ((end - head) & RING_INDEX_MASK) <= pRing->Size)
+		{
+			if(__atomic_compare_exchange_n(&pRing->Head, &head, end, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+				break;
+		}
+	}
+
+	return Len;
+}
+
+#endif /* INC_STM32F407XX_RING_H_ */
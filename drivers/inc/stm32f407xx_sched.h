@@ -0,0 +1,123 @@
+#ifndef INC_STM32F407XX_SCHED_H_
+#define INC_STM32F407XX_SCHED_H_
+
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Run-to-completion event scheduler
+ *
+ * An event is a handler function and a 32-bit argument. Sched_Post puts it
+ * into the queue of its priority; it may be called from interrupt handlers
+ * (driver callbacks such as GPIO_ApplicationEventCallback or
+ * SPI_ApplicationEventCallback). Sched_Run takes the oldest event of the
+ * highest priority and calls its handler, which runs to completion: a
+ * handler never waits, it starts work (e.g. SPI_SendDataIT) and returns,
+ * the completion is another event. With all queues empty the CPU goes to
+ * low-power mode through Pwr_Idle.
+ *
+ *	void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+ *	{
+ *		Sched_Post(Proto_SpiDone, AppEv, SCHED_PRI_HIGH);
+ *	}
+ *
+ * Deferred calls: a Sched_Timer_t posts its event after a number of ticks,
+ * once or periodically. The application calls Sched_Tick from a periodic
+ * interrupt (e.g. the update interrupt of a basic timer); the tick
+ * interrupt also wakes the CPU up.
+ *
+ * Latency: an event waits for the handler which is running and for the
+ * events of higher priority. Sched_GetStats shows the worst case per
+ * priority (DWT cycles, time in sleep mode is not counted).
+ ****************************************************************************/
+
+/*
+ * Priority levels and events per level (power of 2)
+ */
+#ifndef SCHED_NO_OF_PRIORITIES
+#define SCHED_NO_OF_PRIORITIES		4
+#endif
+
+#ifndef SCHED_QUEUE_SIZE
+#define SCHED_QUEUE_SIZE			16
+#endif
+
+/****************************************************************************
+ * @SCHED_PRIORITY
+ * 0 is the highest priority
+ *****************************************************************************/
+#define SCHED_PRI_HIGHEST			0
+#define SCHED_PRI_HIGH				1
+#define SCHED_PRI_LOW				2
+#define SCHED_PRI_LOWEST			3
+
+typedef void (*Sched_Handler_t)(uint32_t Arg);
+
+/****************************************************************************
+ * Queued event
+ ****************************************************************************/
+typedef struct
+{
+	Sched_Handler_t Handler;
+	uint32_t Arg;
+	uint32_t PostCycles;			/* cycle counter when posted */
+} Sched_Event_t;
+
+/****************************************************************************
+ * Deferred call, owned by the application (keep it valid while running)
+ ****************************************************************************/
+typedef struct Sched_Timer
+{
+	Sched_Handler_t Handler;
+	uint32_t Arg;
+	uint8_t Priority;				/* possible values from @SCHED_PRIORITY */
+	uint32_t Expiry;				/* tick of the next event */
+	uint32_t Period;				/* ticks, 0 for a one-shot timer */
+	struct Sched_Timer *pNext;		/* running timers list */
+} Sched_Timer_t;
+
+/****************************************************************************
+ * Statistics
+ ****************************************************************************/
+typedef struct
+{
+	uint32_t Posted[SCHED_NO_OF_PRIORITIES];
+	uint32_t Dropped[SCHED_NO_OF_PRIORITIES];		/* queue was full */
+	uint32_t MaxDepth[SCHED_NO_OF_PRIORITIES];		/* events queued at once */
+	uint32_t MaxLatency[SCHED_NO_OF_PRIORITIES];	/* cycles from post to dispatch */
+	uint32_t MaxRunCycles[SCHED_NO_OF_PRIORITIES];	/* longest handler */
+	uint32_t TimerRetries[SCHED_NO_OF_PRIORITIES];	/* timer events put off, queue was full */
+	uint32_t Idles;									/* times the queues ran empty */
+} Sched_Stats_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+void Sched_Init(uint8_t IdleMode);
+
+/*
+ * Events (interrupt safe)
+ */
+uint8_t Sched_Post(Sched_Handler_t Handler, uint32_t Arg, uint8_t Priority);
+uint8_t Sched_Pending(void);
+
+/*
+ * Main loop (thread mode)
+ */
+uint8_t Sched_RunOnce(void);
+void Sched_Run(void);
+
+/*
+ * Deferred calls
+ */
+void Sched_Tick(void);
+uint32_t Sched_GetTicks(void);
+void Sched_TimerInit(Sched_Timer_t *pTimer, Sched_Handler_t Handler, uint32_t Arg, uint8_t Priority);
+void Sched_TimerStart(Sched_Timer_t *pTimer, uint32_t Delay, uint32_t Period);
+void Sched_TimerStop(Sched_Timer_t *pTimer);
+
+/*
+ * Statistics
+ */
+void Sched_GetStats(Sched_Stats_t *pStats);
+
+#endif /* INC_STM32F407XX_SCHED_H_ */
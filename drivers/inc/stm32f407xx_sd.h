@@ -0,0 +1,199 @@
+#ifndef INC_STM32F407XX_SD_H_
+#define INC_STM32F407XX_SD_H_
+
+// Built on the SPI driver and the scheduler, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * SD/SDHC card in SPI mode, block device
+ *
+ * Sd_Init brings the card up at <= 400 kHz (CMD0, CMD8, ACMD41, CMD58,
+ * CMD9), then switches the SPI to the fastest divider the card allows
+ * (25 MHz: DIV2 on APB1). It blocks, once, at startup.
+ *
+ * After that every operation runs in the background on the SPI DMA streams
+ * (SPI_TransferDMA) and ends with a Sd_ApplicationEventCallback:
+ *
+ * - Sd_Read		CMD17, or CMD18 ... CMD12 for more than one block:
+ * 					the blocks stream straight into the caller's buffer
+ * - Sd_Write		CMD24, or CMD25 ... stop token for more than one block
+ * - Sd_Flush		writes the cache back
+ *
+ * Write-back cache: writes shorter than SD_CACHE_BLOCKS blocks are copied
+ * into the handle and complete at once. Consecutive ones are collected and
+ * written back with one CMD25 when the cache is full, when an operation
+ * touches other blocks, or on Sd_Flush. A logger writing one block at a
+ * time thus streams SD_CACHE_BLOCKS blocks per command. One operation may
+ * be submitted while a write-back is running, it starts when it is done.
+ * Call Sd_Flush before the card is removed or the power goes.
+ *
+ * CRC: commands always carry their CRC7. With Sd_Crc ENABLE the card is
+ * switched to CRC checking (CMD59) and the data blocks carry a CRC16,
+ * checked on reads.
+ *
+ * Waits for the card (read access time, programming busy) are polled with
+ * one byte transfers at first, then every Sd_PollTicks scheduler ticks.
+ *
+ * The application
+ * - configures the SPI: master, 8 bit frames, mode 0, SSM/SSI, SPE,
+ *   and the IRQs of its RX and TX DMA streams (DMA_IRQHandling),
+ * - configures the chip select pin as push-pull output,
+ * - calls Sd_EventHandling from SPI_ApplicationEventCallback,
+ * - runs the scheduler and calls Sched_Tick (slow polls, cache hits).
+ ****************************************************************************/
+
+/*
+ * Block size (CMD16 sets it on byte addressed cards)
+ */
+#define SD_BLOCK_SIZE				512
+
+/*
+ * Size of the write-back cache in the handle (blocks)
+ */
+#ifndef SD_CACHE_BLOCKS
+#define SD_CACHE_BLOCKS				8
+#endif
+
+/*
+ * Polls by one byte transfers before the polling goes to the timer
+ */
+#define SD_FAST_POLLS				32
+
+/*
+ * Clock limits (Hz)
+ */
+#define SD_INIT_SCLK				400000
+#define SD_MAX_SCLK					25000000
+
+/*
+ * Command set (SPI mode)
+ */
+#define SD_CMD_GO_IDLE_STATE		0
+#define SD_CMD_SEND_IF_COND			8
+#define SD_CMD_SEND_CSD				9
+#define SD_CMD_STOP_TRANSMISSION	12
+#define SD_CMD_SET_BLOCKLEN			16
+#define SD_CMD_READ_SINGLE_BLOCK	17
+#define SD_CMD_READ_MULTIPLE_BLOCK	18
+#define SD_CMD_WRITE_BLOCK			24
+#define SD_CMD_WRITE_MULTIPLE_BLOCK	25
+#define SD_CMD_APP_CMD				55
+#define SD_CMD_READ_OCR				58
+#define SD_CMD_CRC_ON_OFF			59
+#define SD_ACMD_SD_SEND_OP_COND		41
+
+/*
+ * R1 response bits
+ */
+#define SD_R1_IDLE					0x01
+#define SD_R1_ILLEGAL_CMD			0x04
+#define SD_R1_CRC_ERROR				0x08
+
+/*
+ * Data tokens
+ */
+#define SD_TOKEN_START_BLOCK		0xFE // CMD17, CMD18, CMD24
+#define SD_TOKEN_START_MULTI		0xFC // CMD25
+#define SD_TOKEN_STOP_TRAN			0xFD // end of CMD25
+#define SD_DATA_RESP_MASK			0x1F
+#define SD_DATA_RESP_ACCEPTED		0x05
+
+/****************************************************************************
+ * @SD_TYPE
+ *****************************************************************************/
+#define SD_TYPE_NONE				0
+#define SD_TYPE_SDSC				1 // byte addressed (v1, or v2 up to 2 GB)
+#define SD_TYPE_SDHC				2 // block addressed (SDHC/SDXC)
+
+/****************************************************************************
+ * @SD_RETURN
+ * Return values of Sd_Init and the operations
+ *****************************************************************************/
+#define SD_OK						0 // started (or queued behind the write-back)
+#define SD_BUSY						1 // an operation is in progress
+#define SD_ERR_PARAM				2 // out of the card, or no Sd_Init
+#define SD_ERR_NO_CARD				3 // no answer to CMD0
+#define SD_ERR_CARD					4 // unusable card, or it did not leave the idle state
+
+/****************************************************************************
+ * Possible SD application events
+ *****************************************************************************/
+#define SD_EVENT_READ_CMPLT			1
+#define SD_EVENT_WRITE_CMPLT		2 // the blocks are on the card, or in the cache
+#define SD_EVENT_FLUSH_CMPLT		3
+#define SD_EVENT_ERROR				4 // SPI/DMA, R1, CRC, data response or timeout
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	SPI_Handle_t *pSPIHandle;		/* SPI_Init done and enabled, 8 bit frames */
+	GPIO_RegDef_t *pCSPort;			/* chip select, active low */
+	uint8_t CSPin;
+	uint8_t Sd_Crc;					/* ENABLE or DISABLE, data CRC16 */
+	uint8_t Sd_PollTicks;			/* scheduler ticks between slow polls */
+	uint8_t Sd_Priority;			/* @SCHED_PRIORITY of the driver's events */
+	uint16_t Sd_TimeoutTicks;		/* longest wait for the card */
+} Sd_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Sd_Config_t Config;
+	uint8_t Type;					/* possible values from @SD_TYPE */
+	uint32_t BlockCount;			/* card size in blocks, from the CSD */
+
+	/* operation in progress */
+	uint8_t Op;
+	uint8_t Phase;
+	uint8_t WaitPhase;				/* poll to repeat when the timer expires */
+	uint8_t ExpectedEv;				/* SPI event which ends the current transfer */
+	uint8_t Cmd;					/* data command of the operation */
+	uint8_t Stopping;				/* CMD12 or stop token sent */
+	uint32_t Lba;
+	uint8_t *pData;
+	uint32_t Count;					/* blocks left */
+	uint16_t Polls;
+	uint16_t WaitTicks;
+	uint8_t Tx[8];
+	uint8_t Rx[8];
+	uint16_t DataCrc;				/* CRC16 of the block being read */
+
+	/* operation waiting for the write-back */
+	uint8_t PendingOp;
+	uint32_t PendingLba;
+	uint8_t *pPendingData;
+	uint32_t PendingCount;
+
+	/* write-back cache */
+	uint8_t Cache[SD_CACHE_BLOCKS][SD_BLOCK_SIZE];
+	uint32_t CacheLba;
+	uint32_t CacheCount;			/* dirty blocks from CacheLba */
+	uint32_t CachedWrites;			/* writes taken by the cache */
+	uint32_t WriteCommands;			/* CMD24 and CMD25 sent */
+
+	Sched_Timer_t Timer;
+} Sd_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Sd_Init(Sd_Handle_t *pSd, Sd_Config_t *pConfig);
+
+uint8_t Sd_Read(Sd_Handle_t *pSd, uint32_t Lba, uint8_t *pBuffer, uint32_t Count);
+uint8_t Sd_Write(Sd_Handle_t *pSd, uint32_t Lba, const uint8_t *pData, uint32_t Count);
+uint8_t Sd_Flush(Sd_Handle_t *pSd);
+uint8_t Sd_Busy(Sd_Handle_t *pSd);
+
+// Call this from SPI_ApplicationEventCallback.
+void Sd_EventHandling(Sd_Handle_t *pSd, SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Sd_ApplicationEventCallback(Sd_Handle_t *pSd, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_SD_H_ */
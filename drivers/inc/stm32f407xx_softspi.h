@@ -0,0 +1,117 @@
+#ifndef INC_STM32F407XX_SOFTSPI_H_
+#define INC_STM32F407XX_SOFTSPI_H_
+
+// Built on the GPIO and timer drivers, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Software SPI master on any GPIO pins
+ *
+ * For buses on pins without a SPI peripheral. MSB first, 8 bit frames, the
+ * four clock modes of the SPI driver (@SPI_CPOL, @SPI_CPHA).
+ *
+ * SoftSpi_Init turns the mode into BSRR words once: per bit, the first
+ * word puts the data bit on MOSI together with the clock edge before it,
+ * the second one makes the sampling edge, and MISO is read right after
+ * it. All four modes run the same unrolled code, a bit costs two stores
+ * and one load when SCK and MOSI are on one port (one more store when
+ * they are not).
+ *
+ * SoftSpi_Transfer is blocking, at the fastest the CPU can go, or slower
+ * with SoftSpi_Delay. SoftSpi_SendDMA sends in the background instead: a
+ * timer update DMA request writes the precomputed words into BSRR, one
+ * per half clock period, and the CPU does nothing per bit. It is TX only
+ * (displays, shift registers, DACs), needs SCK and MOSI on one port, and
+ * TIM1 or TIM8: only DMA2 reaches the GPIO ports. The words take 64 bytes
+ * of RAM per byte sent; longer transfers go in pieces of the buffer's
+ * size, with the clock idle in between.
+ *
+ * The application
+ * - for SoftSpi_SendDMA: sets up the timer (TIM_Init, TIM_Period + 1 =
+ *   ticks per half clock period), enables the IRQ of its update DMA
+ *   stream (DMA_IRQHandling(&handle.UpDMA)) and calls
+ *   SoftSpi_EventHandling from TIM_ApplicationEventCallback,
+ * - drives the chip select itself.
+ ****************************************************************************/
+
+/*
+ * DMA words per byte (two per bit), and the buffer for Len bytes
+ */
+#define SOFTSPI_DMA_WORDS_PER_BYTE	16
+#define SOFTSPI_DMA_WORDS(Len)		((Len) * SOFTSPI_DMA_WORDS_PER_BYTE + 1)
+
+/****************************************************************************
+ * @SOFTSPI_RETURN
+ * Return values of SoftSpi_SendDMA
+ *****************************************************************************/
+#define SOFTSPI_OK					0 // started
+#define SOFTSPI_BUSY				1 // a DMA transfer is in progress
+#define SOFTSPI_ERR_PARAM			2 // no timer/buffer, not TIM1/TIM8, or SCK and MOSI on two ports
+
+/****************************************************************************
+ * Possible soft SPI application events
+ *****************************************************************************/
+#define SOFTSPI_EVENT_TX_CMPLT		1
+#define SOFTSPI_EVENT_ERROR			2 // DMA error
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	GPIO_RegDef_t *pSckPort;
+	uint8_t SckPin;
+	GPIO_RegDef_t *pMosiPort;
+	uint8_t MosiPin;
+	GPIO_RegDef_t *pMisoPort;		/* 0: no MISO, 0xFF is received */
+	uint8_t MisoPin;
+	uint8_t SoftSpi_CPOL;			/* possible values from @SPI_CPOL */
+	uint8_t SoftSpi_CPHA;			/* possible values from @SPI_CPHA */
+	uint16_t SoftSpi_Delay;			/* wait loops per half period, 0: full speed */
+	TIM_Handle_t *pTIMHandle;		/* SoftSpi_SendDMA only: TIM1 or TIM8, TIM_Init done */
+	uint32_t *pDMABuffer;			/* SoftSpi_SendDMA only: SOFTSPI_DMA_WORDS(n) words */
+	uint32_t DMABufferWords;
+} SoftSpi_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	SoftSpi_Config_t Config;
+
+	/* precomputed from the pins and the mode */
+	__vo uint32_t *pSckBsrr;
+	__vo uint32_t *pMosiBsrr;
+	__vo uint32_t *pMisoIdr;
+	uint8_t MisoPin;
+	uint32_t Lead[2];				/* data bit and the edge before it (one port) */
+	uint32_t MosiWord[2];			/* data bit alone (two ports) */
+	uint32_t SckFirst;				/* edge before the data bit (two ports) */
+	uint32_t SckSample;				/* sampling edge */
+	uint32_t SckIdle;				/* back to idle after the last bit */
+
+	/* DMA transfer in progress */
+	const uint8_t *pTxBuffer;
+	uint32_t TxLen;					/* bytes not yet in the DMA buffer */
+	uint8_t Busy;
+} SoftSpi_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+void SoftSpi_Init(SoftSpi_Handle_t *pSoftSpi, SoftSpi_Config_t *pConfig);
+
+void SoftSpi_Transfer(SoftSpi_Handle_t *pSoftSpi, const uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SoftSpi_SendDMA(SoftSpi_Handle_t *pSoftSpi, const uint8_t *pTxBuffer, uint32_t Len);
+uint8_t SoftSpi_Busy(SoftSpi_Handle_t *pSoftSpi);
+
+// Call this from TIM_ApplicationEventCallback.
+void SoftSpi_EventHandling(SoftSpi_Handle_t *pSoftSpi, TIM_Handle_t *pTIMHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void SoftSpi_ApplicationEventCallback(SoftSpi_Handle_t *pSoftSpi, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_SOFTSPI_H_ */
@@ -57,6 +57,14 @@ typedef struct
 	SPI_RegDef_t *pSPIx; // This holds base address of SPIx(x=0,1,2)
 	// pin configuration structure
 	SPI_PinConfig_t SPIConfig;
+	uint8_t *pTxBuffer;				/* application TX buffer (interrupt and DMA mode) */
+	uint8_t *pRxBuffer;				/* application RX buffer (interrupt and DMA mode) */
+	uint32_t TxLen;					/* bytes left to send */
+	uint32_t RxLen;					/* bytes left to receive */
+	uint8_t TxState;				/* possible values from @SPI_APP_STATES */
+	uint8_t RxState;				/* possible values from @SPI_APP_STATES */
+	DMA_Handle_t TxDMA;				/* TX stream, set up by the first DMA transfer */
+	DMA_Handle_t RxDMA;				/* RX stream */
 } SPI_Handle_t;
 
 /****************************************************************************
@@ -114,6 +122,23 @@ typedef struct
 #define SPI_SSM_EN 		1 // hardware management
 #define SPI_SSM_DI		0 // by default, 0. 0 means software management is disabled.
 
+/****************************************************************************
+ * @SPI_APP_STATES
+ * SPI application states
+ *****************************************************************************/
+#define SPI_READY					0
+#define SPI_BUSY_IN_RX				1
+#define SPI_BUSY_IN_TX				2
+
+/****************************************************************************
+ * Possible SPI application events
+ *****************************************************************************/
+#define SPI_EVENT_TX_CMPLT			1
+#define SPI_EVENT_RX_CMPLT			2
+#define SPI_EVENT_OVR_ERR			3
+#define SPI_EVENT_DMA_ERR			4
+#define SPI_EVENT_TX_BUFFER_FREE	5 // SPI_SendStreamDMA: the buffer just sent may be refilled
+
 /****************************************************************************
  * SPI related status flags definitions
  *
@@ -153,6 +178,15 @@ void SPI_DeInit(SPI_RegDef_t *pSPIx);
 void SPI_SendData(SPI_RegDef_t *pSPIx, uint8_t *pTxBuffer, uint32_t Len);
 void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len); // RX buffer
 
+uint8_t SPI_SendDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t SPI_ReceiveDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len);
+
+uint8_t SPI_TransferDMA(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_SendDataDMA(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t SPI_ReceiveDataDMA(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t SPI_SendStreamDMA(SPI_Handle_t *pSPIHandle, uint8_t *pBuffer0, uint8_t *pBuffer1, uint32_t Len);
+void SPI_StopStreamDMA(SPI_Handle_t *pSPIHandle);
+
 /***********************************************************************
  * IRQ Configuration and ISR handling
  ***********************************************************************/
@@ -166,5 +200,16 @@ void SPI_IRQHandling(SPI_Handle_t *pHandle);
 void SPI_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
 void SPI_SSIConfig(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
 void SPI_SSOEConfig(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
+void SPI_SclkSpeedConfig(SPI_Handle_t *pSPIHandle, uint8_t SclkSpeed);
+void SPI_DFFConfig(SPI_Handle_t *pSPIHandle, uint8_t DFF);
+uint8_t SPI_GetFlagStatus(SPI_RegDef_t *pSPIx, uint32_t FlagName);
+void SPI_ClearOVRFlag(SPI_RegDef_t *pSPIx);
+void SPI_CloseTransmission(SPI_Handle_t *pSPIHandle);
+void SPI_CloseReception(SPI_Handle_t *pSPIHandle);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle, uint8_t AppEv);
 
 #endif /* INC_STM32F407XX_SPI_DRIVER_H_ */
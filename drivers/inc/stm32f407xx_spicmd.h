@@ -0,0 +1,139 @@
+#ifndef INC_STM32F407XX_SPICMD_H_
+#define INC_STM32F407XX_SPICMD_H_
+
+// Built on the SPI driver and the scheduler, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * SPI command/response engine
+ *
+ * Talks to a SPI slave which understands "command, ACK, arguments,
+ * response" transactions, such as the Arduino sketch of the course
+ * (commands 0x50..0x54). Every transaction is described once in a table
+ * (SpiCmd_Desc_t), the application only submits requests:
+ *
+ *	master		<cmd>		<0xFF>		<args...>	(turnaround)	<0xFF...>
+ *	slave		 xx			 ACK/NACK	 xx...						<response...>
+ *
+ * SpiCmd_Submit queues the request and returns at once; requests are
+ * executed one after the other, in order, without waiting in between.
+ * The transfers run in SPI interrupt mode, the turnaround time of the
+ * slave (e.g. an ADC conversion before the response) is a Sched_Timer_t,
+ * so the CPU is free (or asleep) meanwhile. A NACK repeats the whole
+ * command up to SpiCmd_MaxRetries times.
+ *
+ * SPE is set for the duration of one request and cleared after it: with
+ * hardware NSS (SSOE) every request is framed by NSS.
+ *
+ * The application
+ * - configures the SPI (SPI_Init, SSOE or SSM/SSI) and its interrupt,
+ * - calls SpiCmd_EventHandling from SPI_ApplicationEventCallback,
+ * - runs the scheduler and calls Sched_Tick (turnaround times).
+ ****************************************************************************/
+
+/*
+ * Default ACK byte of the course's Arduino slave, any other byte is a NACK
+ */
+#define SPICMD_ACK					0xF5
+
+/*
+ * Descriptor ArgLen: the request gives the argument length
+ */
+#define SPICMD_LEN_VAR				0xFF
+
+/****************************************************************************
+ * @SPICMD_ARDUINO
+ * Command codes of the course's Arduino slave (SpiCmd_ArduinoCmds)
+ *
+ *	LED_CTRL	<pin> <value>			no response
+ *	SENSOR_READ	<analog pin>			1 byte (ADC value / 4)
+ *	LED_READ	<pin>					1 byte (pin level)
+ *	PRINT		<len> <len bytes>		no response
+ *	ID_READ								10 bytes (board id)
+ *****************************************************************************/
+#define SPICMD_LED_CTRL				0x50
+#define SPICMD_SENSOR_READ			0x51
+#define SPICMD_LED_READ				0x52
+#define SPICMD_PRINT				0x53
+#define SPICMD_ID_READ				0x54
+
+#define SPICMD_ARDUINO_NO_OF_CMDS	5
+
+/****************************************************************************
+ * Command descriptor
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t Opcode;
+	uint8_t ArgLen;					/* argument bytes after the ACK, SPICMD_LEN_VAR: from the request */
+	uint8_t RspLen;					/* response bytes */
+	uint8_t Ack;					/* byte the slave answers when it accepts the command */
+	uint16_t TurnaroundTicks;		/* scheduler ticks between the arguments and the response */
+} SpiCmd_Desc_t;
+
+/****************************************************************************
+ * Request, owned by the application (keep it valid until its callback)
+ ****************************************************************************/
+typedef struct SpiCmd_Request
+{
+	uint8_t Opcode;
+	const uint8_t *pArgs;			/* ArgLen bytes */
+	uint8_t ArgLen;					/* only used with SPICMD_LEN_VAR descriptors */
+	uint8_t *pRsp;					/* RspLen bytes of the descriptor */
+	void (*pCallback)(struct SpiCmd_Request *pReq);	/* completion, may be 0 */
+
+	/* filled in by the engine */
+	uint8_t Status;					/* possible values from @SPICMD_STATUS */
+	uint8_t Retries;				/* NACKs seen */
+	const SpiCmd_Desc_t *pDesc;
+	struct SpiCmd_Request *pNext;	/* request queue */
+} SpiCmd_Request_t;
+
+/****************************************************************************
+ * @SPICMD_STATUS
+ *****************************************************************************/
+#define SPICMD_STATUS_OK			0
+#define SPICMD_STATUS_PENDING		1 // queued or in progress
+#define SPICMD_STATUS_NACK			2 // still NACKed after the last retry
+#define SPICMD_STATUS_ERROR			3 // SPI overrun
+#define SPICMD_STATUS_UNKNOWN		4 // opcode not in the table
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	SPI_Handle_t *pSPIHandle;		/* SPI_Init done, SPE is handled by the engine */
+	const SpiCmd_Desc_t *pCmdTable;	/* e.g. SpiCmd_ArduinoCmds */
+	uint8_t CmdCount;
+	uint8_t SpiCmd_MaxRetries;		/* extra attempts after a NACK */
+	uint8_t SpiCmd_Priority;		/* @SCHED_PRIORITY of the turnaround timer events */
+} SpiCmd_Config_t;
+
+/****************************************************************************
+ * Engine
+ ****************************************************************************/
+typedef struct
+{
+	SpiCmd_Config_t Config;
+	SpiCmd_Request_t *pHead;		/* request in progress */
+	SpiCmd_Request_t *pTail;
+	uint8_t Phase;
+	uint8_t TxByte;
+	uint8_t RxByte;
+	Sched_Timer_t Timer;
+} SpiCmd_Engine_t;
+
+extern const SpiCmd_Desc_t SpiCmd_ArduinoCmds[SPICMD_ARDUINO_NO_OF_CMDS];
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+void SpiCmd_Init(SpiCmd_Engine_t *pEngine, SpiCmd_Config_t *pConfig);
+uint8_t SpiCmd_Submit(SpiCmd_Engine_t *pEngine, SpiCmd_Request_t *pReq);
+uint8_t SpiCmd_Busy(SpiCmd_Engine_t *pEngine);
+
+// Call this from SPI_ApplicationEventCallback.
+void SpiCmd_EventHandling(SpiCmd_Engine_t *pEngine, SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_SPICMD_H_ */
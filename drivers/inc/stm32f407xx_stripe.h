@@ -0,0 +1,112 @@
+#ifndef INC_STM32F407XX_STRIPE_H_
+#define INC_STM32F407XX_STRIPE_H_
+
+// Built on the SPI driver, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * SPI striping: one logical transfer over several SPI buses at once
+ *
+ * Stripe_Transfer cuts the buffers into one contiguous piece per leg (an
+ * SPI and the chip select of its device) and starts SPI_TransferDMA on all
+ * of them. The legs run concurrently on their own DMA streams, and
+ * STRIPE_EVENT_CMPLT comes when the last one is done. The throughput is
+ * the sum of the buses'.
+ *
+ * The pieces follow the SCLK of each leg (bus clock >> (SPI_SclkSpeed + 1),
+ * read at Stripe_Init): SPI1 and SPI4 on APB2 run twice as fast as SPI2
+ * and SPI3 on APB1 with the same divider, so they get twice the bytes, and
+ * all legs end together. Each piece is a multiple of Align bytes (e.g. a
+ * flash page), and the last leg takes what is left. Stripe_GetSpan tells
+ * where a leg's piece is in the logical buffer, for reading it back from
+ * the same device.
+ *
+ * The legs must not share a DMA stream (Stripe_Init checks it): SPI1 and
+ * SPI4 both receive on DMA2 stream 0 in stm32f407xx_periph.c.
+ *
+ * Commands (e.g. a flash page program and its address) are per device and
+ * are sent by the application or its device driver before the data; the
+ * striping layer moves the data.
+ *
+ * The application
+ * - configures each SPI: master, 8 bit frames, SSM/SSI, SPE, and the IRQs
+ *   of its RX and TX DMA streams (DMA_IRQHandling),
+ * - configures the chip selects as push-pull outputs,
+ * - calls Stripe_EventHandling from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+
+/*
+ * Most legs
+ */
+#define STRIPE_MAX_LEGS				4
+
+/****************************************************************************
+ * @STRIPE_RETURN
+ * Return values of Stripe_Init and Stripe_Transfer
+ *****************************************************************************/
+#define STRIPE_OK					0 // started
+#define STRIPE_BUSY					1 // a transfer is running, or one of the SPIs is busy
+#define STRIPE_ERR_PARAM			2 // no legs, shared DMA stream, a piece above 65535 bytes
+
+/****************************************************************************
+ * Possible striping application events
+ *****************************************************************************/
+#define STRIPE_EVENT_CMPLT			1 // all legs are done
+#define STRIPE_EVENT_ERROR			2 // all legs are done, one or more failed (see Failed)
+
+/*
+ * Leg: an SPI and the chip select of its device
+ */
+typedef struct
+{
+	SPI_Handle_t *pSPIHandle;		/* SPI_Init done and enabled */
+	GPIO_RegDef_t *pCSPort;			/* chip select, active low, 0 if none */
+	uint8_t CSPin;
+} Stripe_Leg_t;
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	Stripe_Leg_t Leg[STRIPE_MAX_LEGS];
+	uint8_t Legs;
+	uint16_t Align;					/* pieces in multiples of this, 0 or 1: any length */
+} Stripe_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Stripe_Config_t Config;
+	uint32_t SclkHz[STRIPE_MAX_LEGS];
+	uint32_t TotalHz;
+
+	/* transfer in progress */
+	uint8_t Busy;
+	uint8_t Pending;				/* bit per leg still running */
+	uint8_t Failed;					/* bit per leg which failed */
+	uint8_t ExpectedEv[STRIPE_MAX_LEGS];	/* SPI event which ends the leg */
+	uint32_t Len;					/* of the last transfer */
+	uint32_t Transfers;
+} Stripe_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Stripe_Init(Stripe_Handle_t *pStripe, Stripe_Config_t *pConfig);
+
+uint8_t Stripe_Transfer(Stripe_Handle_t *pStripe, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
+void Stripe_GetSpan(Stripe_Handle_t *pStripe, uint32_t Len, uint8_t Leg, uint32_t *pOffset, uint32_t *pLen);
+uint8_t Stripe_Busy(Stripe_Handle_t *pStripe);
+
+// Call this from SPI_ApplicationEventCallback.
+void Stripe_EventHandling(Stripe_Handle_t *pStripe, SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Stripe_ApplicationEventCallback(Stripe_Handle_t *pStripe, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_STRIPE_H_ */
@@ -0,0 +1,234 @@
+#ifndef INC_STM32F407XX_TIM_DRIVER_H_
+#define INC_STM32F407XX_TIM_DRIVER_H_
+
+// Every driver header should contain this device-specific header file.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Time base Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	uint16_t TIM_Prescaler;			/* counter clock = timer clock / (TIM_Prescaler + 1) */
+	uint32_t TIM_Period;			/* ARR, the counter counts 0..TIM_Period (16 bit, 32 bit on TIM2/5) */
+	uint8_t TIM_CounterMode;		/* possible values from @TIM_CounterMode */
+	uint8_t TIM_AutoReloadPreload;	/* ENABLE: a new period is taken at the next update event */
+	uint8_t TIM_RepetitionCounter;	/* TIM1/TIM8 only, update event every (RCR + 1) periods */
+} TIM_Config_t;
+
+/****************************************************************************
+ * Output compare / PWM channel Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t OC_Mode;				/* possible values from @TIM_OCMode */
+	uint32_t OC_Pulse;				/* CCR value (duty cycle in counter ticks for PWM) */
+	uint8_t OC_Polarity;			/* possible values from @TIM_OCPolarity */
+	uint8_t OC_Preload;				/* ENABLE: a new CCR value is taken at the next update event */
+} TIM_OC_Config_t;
+
+/****************************************************************************
+ * Input capture channel Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t IC_Polarity;			/* possible values from @TIM_ICPolarity */
+	uint8_t IC_Selection;			/* possible values from @TIM_ICSelection */
+	uint8_t IC_Prescaler;			/* possible values from @TIM_ICPrescaler */
+	uint8_t IC_Filter;				/* 0..15, see ICxF in RM0090 */
+} TIM_IC_Config_t;
+
+/****************************************************************************
+ * One pulse Configuration Settings
+ *
+ * The output goes active OP_Delay ticks after the trigger and stays
+ * active for OP_PulseWidth ticks. The counter then stops by itself.
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t OP_OutputChannel;		/* 1..4, must not be the trigger input channel */
+	uint32_t OP_Delay;				/* ticks from trigger to the active edge */
+	uint32_t OP_PulseWidth;			/* ticks, at least 1 */
+	uint8_t OP_Polarity;			/* possible values from @TIM_OCPolarity */
+	uint8_t OP_Trigger;				/* possible values from @TIM_OPTrigger */
+	uint8_t OP_TriggerPolarity;		/* possible values from @TIM_ICPolarity (rising or falling) */
+} TIM_OP_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ *
+ * UpDMA serves the update request (PWM duty cycles in DMA burst mode,
+ * words to any register such as a GPIO BSRR, or samples of a register such
+ * as a GPIO IDR),
+ * CCDMA serves the capture/compare request of one channel (input capture
+ * into a buffer). The streams are selected from the RM0090 request mapping
+ * when a DMA transfer is started.
+ ****************************************************************************/
+typedef struct
+{
+	TIM_RegDef_t *pTIMx;
+	TIM_Config_t TIM_Config;
+	DMA_Handle_t UpDMA;
+	DMA_Handle_t CCDMA;
+	uint8_t CCDMAChannel;			/* channel (1..4) which owns CCDMA, 0 when unused */
+} TIM_Handle_t;
+
+/****************************************************************************
+ * @TIM_CounterMode
+ *****************************************************************************/
+#define TIM_COUNTER_UP				0
+#define TIM_COUNTER_DOWN			1
+#define TIM_COUNTER_CENTER1			2 // compare flags set while counting down
+#define TIM_COUNTER_CENTER2			3 // compare flags set while counting up
+#define TIM_COUNTER_CENTER3			4 // compare flags set in both directions
+
+/****************************************************************************
+ * @TIM_Channel
+ *****************************************************************************/
+#define TIM_CHANNEL_1				1
+#define TIM_CHANNEL_2				2
+#define TIM_CHANNEL_3				3
+#define TIM_CHANNEL_4				4
+
+/****************************************************************************
+ * @TIM_OCMode
+ *****************************************************************************/
+#define TIM_OCMODE_FROZEN			0
+#define TIM_OCMODE_ACTIVE			1
+#define TIM_OCMODE_INACTIVE			2
+#define TIM_OCMODE_TOGGLE			3
+#define TIM_OCMODE_FORCE_INACTIVE	4
+#define TIM_OCMODE_FORCE_ACTIVE		5
+#define TIM_OCMODE_PWM1				6 // active while CNT < CCR (up counting)
+#define TIM_OCMODE_PWM2				7 // inactive while CNT < CCR (up counting)
+
+/****************************************************************************
+ * @TIM_OCPolarity
+ *****************************************************************************/
+#define TIM_OCPOLARITY_HIGH			0
+#define TIM_OCPOLARITY_LOW			1
+
+/****************************************************************************
+ * @TIM_ICPolarity
+ *****************************************************************************/
+#define TIM_ICPOLARITY_RISING		0
+#define TIM_ICPOLARITY_FALLING		1
+#define TIM_ICPOLARITY_BOTH			2
+
+/****************************************************************************
+ * @TIM_ICSelection
+ *****************************************************************************/
+#define TIM_ICSELECTION_DIRECT		1 // ICx mapped on TIx
+#define TIM_ICSELECTION_INDIRECT	2 // IC1 on TI2, IC2 on TI1, IC3 on TI4, IC4 on TI3
+#define TIM_ICSELECTION_TRC			3
+
+/****************************************************************************
+ * @TIM_ICPrescaler
+ *****************************************************************************/
+#define TIM_ICPSC_DIV1				0
+#define TIM_ICPSC_DIV2				1
+#define TIM_ICPSC_DIV4				2
+#define TIM_ICPSC_DIV8				3
+
+/****************************************************************************
+ * @TIM_OPTrigger
+ *****************************************************************************/
+#define TIM_OP_TRIGGER_SOFTWARE		0 // TIM_OnePulseTrigger starts the pulse
+#define TIM_OP_TRIGGER_TI1			1 // edge on channel 1 input (TI1FP1)
+#define TIM_OP_TRIGGER_TI2			2 // edge on channel 2 input (TI2FP2)
+
+/****************************************************************************
+ * @TIM_TRGO
+ * Master mode selection: event sent on TRGO to other timers, ADC and DAC
+ *****************************************************************************/
+#define TIM_TRGO_RESET				0
+#define TIM_TRGO_ENABLE				1
+#define TIM_TRGO_UPDATE				2 // one trigger per period, e.g. ADC sample rate
+#define TIM_TRGO_COMPARE_PULSE		3
+#define TIM_TRGO_OC1REF				4
+#define TIM_TRGO_OC2REF				5
+#define TIM_TRGO_OC3REF				6
+#define TIM_TRGO_OC4REF				7
+
+/****************************************************************************
+ * Possible TIM application events
+ *****************************************************************************/
+#define TIM_EVENT_UPDATE			0
+#define TIM_EVENT_CC1				1 // TIM_EVENT_CC1 + Channel - 1
+#define TIM_EVENT_CC2				2
+#define TIM_EVENT_CC3				3
+#define TIM_EVENT_CC4				4
+#define TIM_EVENT_TRIGGER			5
+#define TIM_EVENT_OVERCAPTURE		6 // a capture was lost, CCR was not read in time
+#define TIM_EVENT_DMA_HALF_CMPLT	7
+#define TIM_EVENT_DMA_CMPLT			8
+#define TIM_EVENT_DMA_ERROR			9
+
+/****************************************************************************
+ *							APIs supported by this driver
+ * 		For more information about the APIs check the function definitions
+ ****************************************************************************/
+
+/***********************************************************************
+ * Peripheral Clock setup
+ ***********************************************************************/
+void TIM_PeriClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi);
+uint32_t TIM_GetClockValue(TIM_RegDef_t *pTIMx);
+
+/***********************************************************************
+ * Init and De-init (time base)
+ ***********************************************************************/
+void TIM_Init(TIM_Handle_t *pTIMHandle);
+void TIM_DeInit(TIM_RegDef_t *pTIMx);
+void TIM_StartIT(TIM_Handle_t *pTIMHandle);
+void TIM_StopIT(TIM_Handle_t *pTIMHandle);
+
+/***********************************************************************
+ * Output compare / PWM
+ ***********************************************************************/
+void TIM_OCConfigChannel(TIM_Handle_t *pTIMHandle, uint8_t Channel, TIM_OC_Config_t *pOCConfig);
+void TIM_OCChannelControl(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t EnOrDi);
+void TIM_SetCompare(TIM_RegDef_t *pTIMx, uint8_t Channel, uint32_t Value);
+uint8_t TIM_PWMStartBurstDMA(TIM_Handle_t *pTIMHandle, uint8_t FirstChannel, uint8_t NoOfChannels, uint32_t *pBuffer, uint16_t NoOfUpdates, uint8_t Circular);
+void TIM_PWMStopBurstDMA(TIM_Handle_t *pTIMHandle);
+uint8_t TIM_UpdateStartDMA(TIM_Handle_t *pTIMHandle, uint32_t DestAddr, uint32_t *pBuffer, uint16_t Len, uint8_t Circular);
+uint8_t TIM_UpdateStartDMADoubleBuffer(TIM_Handle_t *pTIMHandle, uint32_t DestAddr, uint32_t *pBuffer0, uint32_t *pBuffer1, uint16_t Len);
+uint8_t TIM_UpdateStartReadDMA(TIM_Handle_t *pTIMHandle, uint32_t SrcAddr, uint16_t *pBuffer, uint16_t Len, uint8_t Circular);
+void TIM_UpdateStopDMA(TIM_Handle_t *pTIMHandle);
+
+/***********************************************************************
+ * Input capture
+ ***********************************************************************/
+void TIM_ICConfigChannel(TIM_Handle_t *pTIMHandle, uint8_t Channel, TIM_IC_Config_t *pICConfig);
+uint32_t TIM_GetCapture(TIM_RegDef_t *pTIMx, uint8_t Channel);
+void TIM_ICStartIT(TIM_Handle_t *pTIMHandle, uint8_t Channel);
+void TIM_ICStopIT(TIM_Handle_t *pTIMHandle, uint8_t Channel);
+uint8_t TIM_ICStartDMA(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint32_t *pBuffer, uint16_t Len, uint8_t Circular);
+void TIM_ICStopDMA(TIM_Handle_t *pTIMHandle);
+
+/***********************************************************************
+ * One pulse mode
+ ***********************************************************************/
+void TIM_OnePulseConfig(TIM_Handle_t *pTIMHandle, TIM_OP_Config_t *pOPConfig);
+void TIM_OnePulseTrigger(TIM_RegDef_t *pTIMx);
+
+/***********************************************************************
+ * IRQ Configuration and ISR handling
+ ***********************************************************************/
+void TIM_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void TIM_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority);
+void TIM_IRQHandling(TIM_Handle_t *pTIMHandle);
+// The DMA stream handlers call DMA_IRQHandling(&handle.UpDMA) / (&handle.CCDMA).
+
+/***********************************************************************
+ * Other Peripheral Control APIs
+ ***********************************************************************/
+void TIM_PeripheralControl(TIM_RegDef_t *pTIMx, uint8_t EnOrDi);
+void TIM_SetTriggerOutput(TIM_RegDef_t *pTIMx, uint8_t Trgo);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void TIM_ApplicationEventCallback(TIM_Handle_t *pTIMHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_TIM_DRIVER_H_ */
@@ -0,0 +1,207 @@
+#ifndef INC_STM32F407XX_USART_DRIVER_H_
+#define INC_STM32F407XX_USART_DRIVER_H_
+
+// Every driver header should contain this device-specific header file.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	uint8_t USART_Mode;				/* possible values from @USART_Mode */
+	uint32_t USART_Baud;			/* possible values from @USART_Baud */
+	uint8_t USART_NoOfStopBits;		/* possible values from @USART_NoOfStopBits */
+	uint8_t USART_WordLength;		/* possible values from @USART_WordLength */
+	uint8_t USART_ParityControl;	/* possible values from @USART_ParityControl */
+	uint8_t USART_HWFlowControl;	/* possible values from @USART_HWFlowControl */
+} USART_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ *
+ * Interrupt mode: pTxBuffer/pRxBuffer with TxLen/RxLen.
+ *
+ * Ring buffer mode (DMA): the application gives the driver two buffers with
+ * USART_SetRingBuffers.
+ * TX ring: USART_Write copies into it and the TX DMA drains it chunk by chunk.
+ * RX ring: the RX DMA writes into it in circular mode. IDLE line, half and
+ * full transfer interrupts publish the new write position, so variable
+ * length frames are seen as soon as the line goes idle.
+ ****************************************************************************/
+typedef struct
+{
+	USART_RegDef_t *pUSARTx;
+	USART_Config_t USART_Config;
+
+	// interrupt mode
+	uint8_t *pTxBuffer;
+	uint8_t *pRxBuffer;
+	uint32_t TxLen;
+	uint32_t RxLen;
+	uint8_t TxBusyState;			/* @USART_APP_STATES */
+	uint8_t RxBusyState;			/* @USART_APP_STATES */
+
+	// ring buffers (free running head/tail counters)
+	uint8_t *pTxRing;
+	uint16_t TxRingSize;			// power of 2
+	__vo uint32_t TxHead;			// written by USART_Write
+	__vo uint32_t TxTail;			// written by the TX DMA complete interrupt
+	__vo uint16_t TxDMALen;			// bytes owned by the TX DMA, 0 when idle
+
+	uint8_t *pRxRing;
+	uint16_t RxRingSize;			// power of 2
+	__vo uint32_t RxHead;			// written by the RX interrupts
+	__vo uint32_t RxTail;			// written by USART_Read
+	uint16_t RxLastPos;				// last DMA write offset seen by the driver
+	__vo uint32_t RxOverruns;		// bytes lost because USART_Read was too slow
+
+	DMA_Handle_t TxDMA;
+	DMA_Handle_t RxDMA;
+} USART_Handle_t;
+
+/****************************************************************************
+ * @USART_Mode
+ *****************************************************************************/
+#define USART_MODE_ONLY_TX			0
+#define USART_MODE_ONLY_RX			1
+#define USART_MODE_TXRX				2
+
+/****************************************************************************
+ * @USART_Baud
+ * Any value is accepted, these are the standard ones.
+ *****************************************************************************/
+#define USART_STD_BAUD_1200			1200
+#define USART_STD_BAUD_2400			2400
+#define USART_STD_BAUD_9600			9600
+#define USART_STD_BAUD_19200		19200
+#define USART_STD_BAUD_38400		38400
+#define USART_STD_BAUD_57600		57600
+#define USART_STD_BAUD_115200		115200
+#define USART_STD_BAUD_230400		230400
+#define USART_STD_BAUD_460800		460800
+#define USART_STD_BAUD_921600		921600
+#define USART_STD_BAUD_2M			2000000
+#define USART_STD_BAUD_3M			3000000
+
+/****************************************************************************
+ * @USART_ParityControl
+ *****************************************************************************/
+#define USART_PARITY_DISABLE		0
+#define USART_PARITY_EN_EVEN		1
+#define USART_PARITY_EN_ODD			2
+
+/****************************************************************************
+ * @USART_WordLength
+ *****************************************************************************/
+#define USART_WORDLEN_8BITS			0
+#define USART_WORDLEN_9BITS			1
+
+/****************************************************************************
+ * @USART_NoOfStopBits
+ *****************************************************************************/
+#define USART_STOPBITS_1			0
+#define USART_STOPBITS_0_5			1
+#define USART_STOPBITS_2			2
+#define USART_STOPBITS_1_5			3
+
+/****************************************************************************
+ * @USART_HWFlowControl
+ *****************************************************************************/
+#define USART_HW_FLOW_CTRL_NONE		0
+#define USART_HW_FLOW_CTRL_CTS		1
+#define USART_HW_FLOW_CTRL_RTS		2
+#define USART_HW_FLOW_CTRL_CTS_RTS	3
+
+/****************************************************************************
+ * @USART_APP_STATES
+ *****************************************************************************/
+#define USART_READY					0
+#define USART_BUSY_IN_RX			1
+#define USART_BUSY_IN_TX			2
+
+/****************************************************************************
+ * USART related status flags definitions
+ *****************************************************************************/
+#define USART_FLAG_TXE				(1 << USART_SR_TXE)
+#define USART_FLAG_RXNE				(1 << USART_SR_RXNE)
+#define USART_FLAG_TC				(1 << USART_SR_TC)
+#define USART_FLAG_IDLE				(1 << USART_SR_IDLE)
+#define USART_FLAG_ORE				(1 << USART_SR_ORE)
+
+/****************************************************************************
+ * Possible USART application events
+ *****************************************************************************/
+#define USART_EVENT_TX_CMPLT		0
+#define USART_EVENT_RX_CMPLT		1
+#define USART_EVENT_IDLE			2 // RX line idle, a frame has ended
+#define USART_EVENT_RX_DATA			3 // RX ring half/full, data is waiting
+#define USART_EVENT_CTS				4
+#define USART_EVENT_PE				5
+#define USART_ERR_FE				6
+#define USART_ERR_NE				7
+#define USART_ERR_ORE				8
+#define USART_EVENT_RX_OVERRUN		9 // RX ring overwritten before USART_Read
+#define USART_EVENT_DMA_ERROR		10
+
+/****************************************************************************
+ *							APIs supported by this driver
+ * 		For more information about the APIs check the function definitions
+ ****************************************************************************/
+
+/***********************************************************************
+ * Peripheral Clock setup
+ ***********************************************************************/
+void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi);
+
+/***********************************************************************
+ * Init and De-init
+ ***********************************************************************/
+void USART_Init(USART_Handle_t *pUSARTHandle);
+void USART_DeInit(USART_RegDef_t *pUSARTx);
+void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate);
+
+/***********************************************************************
+ * Data Send and Receive
+ ***********************************************************************/
+// polling (blocking)
+void USART_SendData(USART_RegDef_t *pUSARTx, uint8_t *pTxBuffer, uint32_t Len);
+void USART_ReceiveData(USART_RegDef_t *pUSARTx, uint8_t *pRxBuffer, uint32_t Len);
+// interrupt (non-blocking)
+uint8_t USART_SendDataIT(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t USART_ReceiveDataIT(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_t Len);
+// DMA (non-blocking)
+uint8_t USART_SendDataDMA(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint16_t Len);
+
+/***********************************************************************
+ * Ring buffer (DMA) API
+ ***********************************************************************/
+void USART_SetRingBuffers(USART_Handle_t *pUSARTHandle, uint8_t *pTxRing, uint16_t TxSize, uint8_t *pRxRing, uint16_t RxSize);
+uint32_t USART_Write(USART_Handle_t *pUSARTHandle, const uint8_t *pData, uint32_t Len);
+uint32_t USART_TxFree(USART_Handle_t *pUSARTHandle);
+void USART_StartRxDMA(USART_Handle_t *pUSARTHandle);
+void USART_StopRxDMA(USART_Handle_t *pUSARTHandle);
+uint32_t USART_Read(USART_Handle_t *pUSARTHandle, uint8_t *pData, uint32_t MaxLen);
+uint32_t USART_RxAvailable(USART_Handle_t *pUSARTHandle);
+
+/***********************************************************************
+ * IRQ Configuration and ISR handling
+ ***********************************************************************/
+void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void USART_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority);
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle);
+// The DMA stream handlers call DMA_IRQHandling(&handle.TxDMA) / (&handle.RxDMA).
+
+/***********************************************************************
+ * Other Peripheral Control APIs
+ ***********************************************************************/
+void USART_PeripheralControl(USART_RegDef_t *pUSARTx, uint8_t EnOrDi);
+uint8_t USART_GetFlagStatus(USART_RegDef_t *pUSARTx, uint32_t FlagName);
+void USART_ClearFlag(USART_RegDef_t *pUSARTx, uint16_t StatusFlagName);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_USART_DRIVER_H_ */
@@ -0,0 +1,125 @@
+#ifndef INC_STM32F407XX_WS2812_H_
+#define INC_STM32F407XX_WS2812_H_
+
+// Built on the SPI driver, not included by stm32f407xx.h.
+#include "stm32f407xx.h"
+
+/****************************************************************************
+ * Addressable LED strips (WS2812, WS2812B, SK6812 RGB and RGBW) on SPI MOSI
+ *
+ * Each bit of a color goes out as a symbol of 3 or 4 SPI bits, the high
+ * part as long as the LED wants for a 0 or a 1:
+ * - 3 bits: 0 = 100, 1 = 110, SPI bit of 325..475 ns (about 2.6 MHz),
+ * - 4 bits: 0 = 1000, 1 = 1110, SPI bit of 250..317 ns (about 3.5 MHz).
+ * Ws2812_Init picks the fastest divider of the SPI's bus clock which fits
+ * 3 bit symbols, else 4 bit ones, and sets it (SPI_SclkSpeedConfig).
+ * Encoding goes a nibble at a time through a 16 entry table.
+ *
+ * The application draws into a pixel buffer (Ws2812_SetPixel, bytes in
+ * the strip's order: G, R, B and W) and commits the frame. Ws2812_Commit
+ * streams it with SPI_SendStreamDMA through two small buffers of
+ * WS2812_CHUNK_BYTES in the handle: one is on the bus while the interrupt
+ * encodes the next LEDs into the other. RAM does not grow with the strip.
+ * The frame ends with the line low for ResetUs (zeros in the stream), then
+ * WS2812_EVENT_COMMIT_CMPLT. The LEDs show the frame by then.
+ *
+ * The timing comes from the SPI clock, not from the CPU: other interrupts
+ * may delay the encoder by up to a chunk's time (WS2812_CHUNK_BYTES SPI
+ * bytes, about 1 ms with the default) without a glitch. A later one
+ * repeats a chunk, and the frame is wrong until the next commit.
+ *
+ * With pFront, Ws2812_Commit copies the pixels and sends the copy, so the
+ * next frame may be drawn at once. Without, pPixels is sent: draw only
+ * after WS2812_EVENT_COMMIT_CMPLT, or pixels may change halfway.
+ *
+ * The application
+ * - configures the SPI: master, 8 bit frames, MSB first, SSM/SSI, SPE,
+ *   MOSI on the strip's data input (through a level shifter at 5 V), and
+ *   the IRQ of its TX DMA stream (DMA_IRQHandling(&handle.TxDMA)),
+ * - calls Ws2812_EventHandling from SPI_ApplicationEventCallback.
+ * The SPI is the strip's alone, the speed is changed.
+ ****************************************************************************/
+
+/*
+ * Size of each of the two encoding buffers (SPI bytes)
+ */
+#ifndef WS2812_CHUNK_BYTES
+#define WS2812_CHUNK_BYTES			384
+#endif
+
+/*
+ * Bit timing of the LEDs (datasheet values, ns)
+ */
+#define WS2812_T0H_NS				400
+#define WS2812_T1H_NS				800
+#define WS2812_TOL_NS				150
+#define WS2812_RESET_US				300 // WS2812B, older parts need 50
+
+/****************************************************************************
+ * @WS2812_RETURN
+ * Return values of Ws2812_Init and Ws2812_Commit
+ *****************************************************************************/
+#define WS2812_OK					0 // started
+#define WS2812_BUSY					1 // a commit is running, or the SPI is busy
+#define WS2812_ERR_PARAM			2 // no pixels, 3 or 4 channels, no SPI clock which fits
+
+/****************************************************************************
+ * Possible LED strip application events
+ *****************************************************************************/
+#define WS2812_EVENT_COMMIT_CMPLT	1 // the frame is shown
+#define WS2812_EVENT_ERROR			2 // DMA error, the frame is incomplete
+
+/****************************************************************************
+ * Configuration Settings
+ ****************************************************************************/
+typedef struct
+{
+	SPI_Handle_t *pSPIHandle;		/* SPI_Init done and enabled */
+	uint8_t *pPixels;				/* Leds * Channels bytes, drawn by the application */
+	uint8_t *pFront;				/* as large, copy being sent, 0 to send pPixels */
+	uint16_t Leds;
+	uint8_t Channels;				/* 3: GRB, 4: GRBW */
+	uint16_t Ws2812_ResetUs;		/* low time which ends a frame, 0: WS2812_RESET_US */
+} Ws2812_Config_t;
+
+/****************************************************************************
+ * Handle Structure
+ ****************************************************************************/
+typedef struct
+{
+	Ws2812_Config_t Config;
+	uint8_t SymbolBits;				/* SPI bits per LED bit, 3 or 4 */
+	uint32_t BitHz;					/* SPI bit rate */
+	uint16_t ChunkLeds;				/* LEDs per encoding buffer */
+	uint16_t ChunkLen;				/* bytes sent per buffer */
+
+	/* commit in progress */
+	uint8_t Busy;
+	const uint8_t *pSend;			/* pixels being sent */
+	uint16_t NextLed;				/* next one to encode */
+	uint32_t Chunks;				/* buffers of the frame, LEDs and reset */
+	uint32_t Sent;					/* buffers done */
+
+	uint8_t Chunk[2][WS2812_CHUNK_BYTES];
+	uint32_t Frames;
+} Ws2812_Handle_t;
+
+/****************************************************************************
+ *							APIs supported by this module
+ ****************************************************************************/
+uint8_t Ws2812_Init(Ws2812_Handle_t *pStrip, Ws2812_Config_t *pConfig);
+
+void Ws2812_SetPixel(Ws2812_Handle_t *pStrip, uint16_t Index, uint32_t Color);
+void Ws2812_Fill(Ws2812_Handle_t *pStrip, uint32_t Color);
+uint8_t Ws2812_Commit(Ws2812_Handle_t *pStrip);
+uint8_t Ws2812_Busy(Ws2812_Handle_t *pStrip);
+
+// Call this from SPI_ApplicationEventCallback.
+void Ws2812_EventHandling(Ws2812_Handle_t *pStrip, SPI_Handle_t *pSPIHandle, uint8_t AppEv);
+
+/***********************************************************************
+ * Application callback
+ ***********************************************************************/
+void Ws2812_ApplicationEventCallback(Ws2812_Handle_t *pStrip, uint8_t AppEv);
+
+#endif /* INC_STM32F407XX_WS2812_H_ */
@@ -0,0 +1,660 @@
+// In driver.c, you have to include respective peripheral's driver file.
+#include "stm32f407xx_adc_driver.h"
+
+/*
+ * Helper functions (private to this driver)
+ */
+static void ADC_DMAConfig(ADC_Handle_t *pADCHandle, uint8_t Mode, uint8_t DataSize);
+static void ADC_DMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+
+/**********************************************************************
+ * Peripheral Clock setup
+ * (Peripheral Control API)
+ * ********************************************************************
+ * @fn			- ADC_PeriClockControl
+ *
+ * @brief		- This function enables or disables peripheral clock
+ * 				  for the given ADC
+ *
+ * @param[in]	- base address of the ADC peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Reference counted by the clock manager: the clock goes
+ * 				  off with the last DISABLE, see stm32f407xx_clk.h
+ ***********************************************************************/
+void ADC_PeriClockControl(ADC_RegDef_t *pADCx, uint8_t EnorDi)
+{
+	Clk_Control(pADCx, EnorDi);
+}
+
+/**************************************************************************
+ * Initialize the common ADC settings
+ * ************************************************************************
+ * @fn			- ADC_CommonInit
+ *
+ * @brief		- To configure the ADC clock prescaler and the multi ADC
+ * 				  mode shared by ADC1, ADC2 and ADC3.
+ *
+ * 				  Triple interleaved example (7.2 MSPS on one channel):
+ * 				  PCLK2 = 72 MHz, ADC_PRESCALER_DIV2 (ADCCLK = 36 MHz),
+ * 				  12 bit, 3 cycle sampling (15 cycles per conversion),
+ * 				  ADC_MULTI_TRIPLE_INTERLEAVED, ADC_MULTI_DMA_MODE2,
+ * 				  delay 5 cycles: 36 MHz / 5 = 7.2 MSPS.
+ *
+ * @param[in]	- pointer to the common configuration
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Call while all ADCs are off (ADON = 0).
+ ****************************************************************************/
+void ADC_CommonInit(ADC_CommonConfig_t *pCommonConfig)
+{
+	uint32_t tempreg = 0;
+	uint8_t delay = pCommonConfig->ADC_TwoSamplingDelay;
+
+	// the common registers are clocked with ADC1
+	Clk_Ensure(ADC1);
+
+	if(delay < 5)
+		delay = 5;
+	if(delay > 20)
+		delay = 20;
+
+	tempreg |= ((uint32_t)pCommonConfig->ADC_Prescaler << ADC_CCR_ADCPRE);
+	tempreg |= ((uint32_t)(pCommonConfig->ADC_MultiMode & 0x1F) << ADC_CCR_MULTI);
+	tempreg |= ((uint32_t)(delay - 5) << ADC_CCR_DELAY);
+	tempreg |= ((uint32_t)pCommonConfig->ADC_MultiDMAMode << ADC_CCR_DMA);
+	if(pCommonConfig->ADC_MultiDMAMode != ADC_MULTI_DMA_DISABLED)
+	{
+		// keep issuing DMA requests after the last transfer (circular DMA)
+		tempreg |= (1 << ADC_CCR_DDS);
+	}
+
+	ADC_COMMON->CCR = tempreg;
+}
+
+/**************************************************************************
+ * Initialize ADC
+ * ************************************************************************
+ * @fn			- ADC_Init
+ *
+ * @brief		- To configure resolution, alignment, scan/continuous mode,
+ * 				  the external trigger and the length of the regular
+ * 				  sequence. The ranks are set with ADC_ConfigChannel.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- The ADC is left off, call ADC_PeripheralControl.
+ * 				  Timer trigger: set the timer TRGO to the update event
+ * 				  (TIM_SetTriggerOutput) and use ADC_EXTTRIG_TIMx_TRGO,
+ * 				  the sample rate is then the timer update rate.
+ ****************************************************************************/
+void ADC_Init(ADC_Handle_t *pADCHandle)
+{
+	ADC_RegDef_t *pADCx = pADCHandle->pADCx;
+	uint8_t n = pADCHandle->ADC_Config.ADC_NoOfConversions;
+	uint32_t tempreg = 0;
+
+	Clk_Ensure(pADCx);
+
+	if(n == 0)
+		n = 1;
+	if(n > 16)
+		n = 16;
+
+	/************************************************************************
+	 * 1. Configure CR1 (resolution, scan mode, overrun interrupt)
+	 ************************************************************************/
+	tempreg |= ((uint32_t)pADCHandle->ADC_Config.ADC_Resolution << ADC_CR1_RES);
+	if(n > 1)
+	{
+		tempreg |= (1 << ADC_CR1_SCAN);
+	}
+	pADCx->CR1 = tempreg;
+
+	/************************************************************************
+	 * 2. Configure CR2 (alignment, continuous mode, trigger)
+	 ************************************************************************/
+	tempreg = 0;
+	tempreg |= ((uint32_t)pADCHandle->ADC_Config.ADC_DataAlign << ADC_CR2_ALIGN);
+	if(pADCHandle->ADC_Config.ADC_ContinuousMode == ENABLE)
+	{
+		tempreg |= (1 << ADC_CR2_CONT);
+	}
+	// EOC after every conversion of the sequence (also enables overrun detection)
+	tempreg |= (1 << ADC_CR2_EOCS);
+	if(pADCHandle->ADC_Config.ADC_ExtTrigger != ADC_EXTTRIG_SOFTWARE)
+	{
+		tempreg |= ((uint32_t)(pADCHandle->ADC_Config.ADC_ExtTrigger & 0xF) << ADC_CR2_EXTSEL);
+		tempreg |= ((uint32_t)(pADCHandle->ADC_Config.ADC_ExtTriggerEdge & 0x3) << ADC_CR2_EXTEN);
+	}
+	pADCx->CR2 = tempreg;
+
+	/************************************************************************
+	 * 3. Length of the regular sequence
+	 ************************************************************************/
+	tempreg = pADCx->SQR1;
+	tempreg &= ~(0xF << ADC_SQR1_L);
+	tempreg |= ((uint32_t)(n - 1) << ADC_SQR1_L);
+	pADCx->SQR1 = tempreg;
+
+	pADCHandle->pBuffer0 = 0;
+	pADCHandle->pBuffer1 = 0;
+	pADCHandle->BufferLen = 0;
+}
+
+/**************************************************************************
+ * Deinitialize the ADCs
+ * ************************************************************************
+ * @fn			- ADC_DeInit
+ *
+ * @brief		- Resets ADC1, ADC2, ADC3 and the common registers with the
+ * 				  RCC reset register (there is one reset bit for all of them).
+ *
+ * @return		- none
+ ****************************************************************************/
+void ADC_DeInit(void)
+{
+	// one reset bit for all ADCs
+	Periph_Reset(ADC1);
+}
+
+/**************************************************************************
+ * Regular channel
+ * ************************************************************************
+ * @fn			- ADC_ConfigChannel
+ *
+ * @brief		- Puts a channel at a rank of the regular sequence and sets
+ * 				  its sampling time.
+ *
+ * @param[in]	- base address of the ADC peripheral
+ * @param[in]	- rank 1..16
+ * @param[in]	- channel 0..18 (@ADC_Channel)
+ * @param[in]	- possible values from @ADC_SampleTime
+ *
+ * @return		- none
+ *
+ * @Note		- The sampling time belongs to the channel, not the rank.
+ ****************************************************************************/
+void ADC_ConfigChannel(ADC_RegDef_t *pADCx, uint8_t Rank, uint8_t Channel, uint8_t SampleTime)
+{
+	uint32_t tempreg;
+	uint8_t shift;
+
+	// 1. Sequence: SQR3 ranks 1..6, SQR2 ranks 7..12, SQR1 ranks 13..16
+	if(Rank <= 6)
+	{
+		shift = 5 * (Rank - 1);
+		tempreg = pADCx->SQR3 & ~(0x1F << shift);
+		pADCx->SQR3 = tempreg | ((uint32_t)(Channel & 0x1F) << shift);
+	} else if(Rank <= 12)
+	{
+		shift = 5 * (Rank - 7);
+		tempreg = pADCx->SQR2 & ~(0x1F << shift);
+		pADCx->SQR2 = tempreg | ((uint32_t)(Channel & 0x1F) << shift);
+	} else
+	{
+		shift = 5 * (Rank - 13);
+		tempreg = pADCx->SQR1 & ~(0x1F << shift);
+		pADCx->SQR1 = tempreg | ((uint32_t)(Channel & 0x1F) << shift);
+	}
+
+	// 2. Sampling time: SMPR2 channels 0..9, SMPR1 channels 10..18
+	if(Channel < 10)
+	{
+		shift = 3 * Channel;
+		tempreg = pADCx->SMPR2 & ~(0x7 << shift);
+		pADCx->SMPR2 = tempreg | ((uint32_t)(SampleTime & 0x7) << shift);
+	} else
+	{
+		shift = 3 * (Channel - 10);
+		tempreg = pADCx->SMPR1 & ~(0x7 << shift);
+		pADCx->SMPR1 = tempreg | ((uint32_t)(SampleTime & 0x7) << shift);
+	}
+}
+
+/**************************************************************************
+ * Software start
+ * ************************************************************************
+ * @fn			- ADC_StartConversion
+ *
+ * @brief		- Starts the regular sequence by software (SWSTART).
+ *
+ * @param[in]	- base address of the ADC peripheral
+ *
+ * @Note		- With an external trigger the sequence starts on the
+ * 				  trigger edge instead, SWSTART is not needed.
+ ****************************************************************************/
+void ADC_StartConversion(ADC_RegDef_t *pADCx)
+{
+	pADCx->CR2 |= (1 << ADC_CR2_SWSTART);
+}
+
+/**************************************************************************
+ * @fn			- ADC_PollForConversion
+ *
+ * @brief		- Waits until EOC is set.
+ *
+ * @param[in]	- base address of the ADC peripheral
+ *
+ * @Note		- This is a blocking call.
+ ****************************************************************************/
+void ADC_PollForConversion(ADC_RegDef_t *pADCx)
+{
+	while(!ADC_GetFlagStatus(pADCx, ADC_FLAG_EOC));
+}
+
+/**************************************************************************
+ * @fn			- ADC_GetValue
+ *
+ * @brief		- Reads the regular data register. This clears EOC.
+ *
+ * @param[in]	- base address of the ADC peripheral
+ *
+ * @return		- last converted value
+ ****************************************************************************/
+uint16_t ADC_GetValue(ADC_RegDef_t *pADCx)
+{
+	return (uint16_t)pADCx->DR;
+}
+
+/**************************************************************************
+ * Interrupt mode
+ * ************************************************************************
+ * @fn			- ADC_StartIT
+ *
+ * @brief		- Enables the end of conversion and overrun interrupts and
+ * 				  starts the sequence (software trigger only).
+ * 				  ADC_EVENT_EOC is reported for every conversion.
+ *
+ * @param[in]	- pointer to the handle structure
+ *
+ * @Note		- Enable IRQ_NO_ADC with ADC_IRQInterruptConfig.
+ ****************************************************************************/
+void ADC_StartIT(ADC_Handle_t *pADCHandle)
+{
+	ADC_RegDef_t *pADCx = pADCHandle->pADCx;
+
+	pADCx->SR = ~((1 << ADC_SR_EOC) | (1 << ADC_SR_OVR));
+	pADCx->CR1 |= (1 << ADC_CR1_EOCIE) | (1 << ADC_CR1_OVRIE);
+
+	if(pADCHandle->ADC_Config.ADC_ExtTrigger == ADC_EXTTRIG_SOFTWARE)
+		ADC_StartConversion(pADCx);
+}
+
+/**************************************************************************
+ * @fn			- ADC_StopIT
+ *
+ * @brief		- Disables the end of conversion and overrun interrupts.
+ *
+ * @param[in]	- pointer to the handle structure
+ ****************************************************************************/
+void ADC_StopIT(ADC_Handle_t *pADCHandle)
+{
+	pADCHandle->pADCx->CR1 &= ~((1 << ADC_CR1_EOCIE) | (1 << ADC_CR1_OVRIE));
+}
+
+/**************************************************************************
+ * Circular DMA
+ * ************************************************************************
+ * @fn			- ADC_StartDMA
+ *
+ * @brief		- The DMA stores every conversion in pBuffer and wraps
+ * 				  around at the end. ADC_EVENT_HALF_CMPLT is reported when
+ * 				  the first half is filled (process it while the DMA fills
+ * 				  the second half), ADC_EVENT_CMPLT for the second half.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- buffer and its length in samples (a multiple of the
+ * 				  sequence length keeps the channels at fixed positions)
+ *
+ * @return		- none
+ *
+ * @Note		- Call after ADC_PeripheralControl(ENABLE). Enable the IRQ
+ * 				  of the ADC DMA stream (DMA2 stream 0/3/1 for ADC1/2/3).
+ ****************************************************************************/
+void ADC_StartDMA(ADC_Handle_t *pADCHandle, uint16_t *pBuffer, uint16_t Len)
+{
+	ADC_RegDef_t *pADCx = pADCHandle->pADCx;
+
+	pADCHandle->pBuffer0 = pBuffer;
+	pADCHandle->pBuffer1 = 0;
+	pADCHandle->BufferLen = Len;
+
+	ADC_DMAConfig(pADCHandle, DMA_MODE_CIRCULAR, DMA_SIZE_HALFWORD);
+	DMA_Start(&pADCHandle->DMA, (uint32_t)&pADCx->DR, (uint32_t)pBuffer, Len);
+
+	// DDS: keep requesting after the last transfer of the buffer
+	pADCx->SR = ~(1 << ADC_SR_OVR);
+	pADCx->CR1 |= (1 << ADC_CR1_OVRIE);
+	pADCx->CR2 |= (1 << ADC_CR2_DMA) | (1 << ADC_CR2_DDS);
+
+	if(pADCHandle->ADC_Config.ADC_ExtTrigger == ADC_EXTTRIG_SOFTWARE)
+		ADC_StartConversion(pADCx);
+}
+
+/**************************************************************************
+ * Double buffer DMA
+ * ************************************************************************
+ * @fn			- ADC_StartDMADoubleBuffer
+ *
+ * @brief		- The DMA fills pBuffer0, then pBuffer1, then pBuffer0
+ * 				  again (DMA double buffer mode). ADC_EVENT_BUFFER0_READY or
+ * 				  ADC_EVENT_BUFFER1_READY is reported for each filled
+ * 				  buffer; it stays untouched while the DMA fills the other.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- the two buffers
+ * @param[in]	- length of each buffer in samples
+ *
+ * @return		- none
+ *
+ * @Note		- Same prerequisites as ADC_StartDMA.
+ ****************************************************************************/
+void ADC_StartDMADoubleBuffer(ADC_Handle_t *pADCHandle, uint16_t *pBuffer0, uint16_t *pBuffer1, uint16_t Len)
+{
+	ADC_RegDef_t *pADCx = pADCHandle->pADCx;
+
+	pADCHandle->pBuffer0 = pBuffer0;
+	pADCHandle->pBuffer1 = pBuffer1;
+	pADCHandle->BufferLen = Len;
+
+	ADC_DMAConfig(pADCHandle, DMA_MODE_DOUBLE_BUFFER, DMA_SIZE_HALFWORD);
+	DMA_StartDoubleBuffer(&pADCHandle->DMA, (uint32_t)&pADCx->DR, (uint32_t)pBuffer0, (uint32_t)pBuffer1, Len);
+
+	pADCx->SR = ~(1 << ADC_SR_OVR);
+	pADCx->CR1 |= (1 << ADC_CR1_OVRIE);
+	pADCx->CR2 |= (1 << ADC_CR2_DMA) | (1 << ADC_CR2_DDS);
+
+	if(pADCHandle->ADC_Config.ADC_ExtTrigger == ADC_EXTTRIG_SOFTWARE)
+		ADC_StartConversion(pADCx);
+}
+
+/**************************************************************************
+ * Multi ADC (dual/triple) DMA
+ * ************************************************************************
+ * @fn			- ADC_MultiStartDMA
+ *
+ * @brief		- Circular DMA from the common data register (CDR) in dual
+ * 				  or triple mode. The samples land in pBuffer in conversion
+ * 				  order (ADC1, ADC2, ADC3, ADC1, ..), by DMA mode:
+ * 				  mode 1: one sample per element, a halfword per request,
+ * 				  mode 2: one sample per element, two of them (a word) per
+ * 				  request,
+ * 				  mode 3 (6/8 bit): two samples per element, the first one
+ * 				  in the low byte, a halfword per request.
+ * 				  Half/full events as for ADC_StartDMA.
+ *
+ * @param[in]	- handle of ADC1 (master), its DMA stream is used
+ * @param[in]	- buffer and its length in 16-bit elements; in mode 2 the
+ * 				  buffer must be word aligned and the length even
+ *
+ * @return		- SET if started, RESET if the DMA mode (ADC_CommonInit) or
+ * 				  the buffer does not fit
+ *
+ * @Note		- Configure ADC1..3 with the same sequence (ADC_Init,
+ * 				  ADC_ConfigChannel), set the multi mode with
+ * 				  ADC_CommonInit, switch all of them on, then call this.
+ * 				  Only the master is triggered.
+ ****************************************************************************/
+uint8_t ADC_MultiStartDMA(ADC_Handle_t *pMasterHandle, uint16_t *pBuffer, uint16_t Len)
+{
+	uint8_t dmamode = (ADC_COMMON->CCR >> ADC_CCR_DMA) & 0x3;
+	uint16_t items = Len;
+
+	if(Len == 0 || dmamode == ADC_MULTI_DMA_DISABLED)
+		return RESET;
+
+	if(dmamode == ADC_MULTI_DMA_MODE2)
+	{
+		// word transfers: an unaligned buffer would be written at the
+		// rounded down address (or fault)
+		if(((uintptr_t)pBuffer & 0x3) != 0 || (Len & 1) != 0)
+			return RESET;
+		ADC_DMAConfig(pMasterHandle, DMA_MODE_CIRCULAR, DMA_SIZE_WORD);
+		items = Len / 2;
+	} else
+	{
+		// mode 1: one sample, mode 3: two bytes per halfword
+		ADC_DMAConfig(pMasterHandle, DMA_MODE_CIRCULAR, DMA_SIZE_HALFWORD);
+	}
+
+	pMasterHandle->pBuffer0 = pBuffer;
+	pMasterHandle->pBuffer1 = 0;
+	pMasterHandle->BufferLen = Len;
+	DMA_Start(&pMasterHandle->DMA, (uint32_t)&ADC_COMMON->CDR, (uint32_t)pBuffer, items);
+
+	pMasterHandle->pADCx->SR = ~(1 << ADC_SR_OVR);
+	pMasterHandle->pADCx->CR1 |= (1 << ADC_CR1_OVRIE);
+
+	if(pMasterHandle->ADC_Config.ADC_ExtTrigger == ADC_EXTTRIG_SOFTWARE)
+		ADC_StartConversion(pMasterHandle->pADCx);
+
+	return SET;
+}
+
+/**************************************************************************
+ * @fn			- ADC_StopDMA
+ *
+ * @brief		- Stops the DMA requests and the DMA stream. A continuous
+ * 				  or triggered ADC keeps converting without storing.
+ *
+ * @param[in]	- pointer to the handle structure
+ ****************************************************************************/
+void ADC_StopDMA(ADC_Handle_t *pADCHandle)
+{
+	ADC_RegDef_t *pADCx = pADCHandle->pADCx;
+
+	pADCx->CR1 &= ~(1 << ADC_CR1_OVRIE);
+	pADCx->CR2 &= ~((1 << ADC_CR2_DMA) | (1 << ADC_CR2_DDS));
+	DMA_Stop(&pADCHandle->DMA);
+}
+
+/**************************************************************************
+ * IRQ Configuration
+ * ************************************************************************
+ * @fn			- ADC_IRQInterruptConfig
+ *
+ * @brief		- All of the configuration in this API is processor specific.
+ *
+ * @param[in]	- IRQ number (IRQ_NO_ADC)
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void ADC_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	NVIC_IRQInterruptConfig(IRQNumber, EnorDi);
+}
+
+/**************************************************************************
+ * Priority Configuration
+ * ************************************************************************
+ * @fn			- ADC_IRQPriorityConfig
+ *
+ * @brief		- Sets the priority field of the given IRQ number.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- priority (NVIC_IRQ_PRIx)
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void ADC_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority)
+{
+	NVIC_IRQPriorityConfig(IRQNumber, IRQPriority);
+}
+
+/**************************************************************************
+ * Interrupt Handling
+ * ************************************************************************
+ * @fn			- ADC_IRQHandling
+ *
+ * @brief		- Call this from ADC_IRQHandler, once for every ADC in use
+ * 				  (the three ADCs share one IRQ).
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- After ADC_ERROR_OVR the DMA requests are off, restart
+ * 				  with ADC_StopDMA and ADC_StartDMA.
+ ****************************************************************************/
+void ADC_IRQHandling(ADC_Handle_t *pADCHandle)
+{
+	PROF_ISR_BEGIN();
+
+	ADC_RegDef_t *pADCx = pADCHandle->pADCx;
+	uint32_t sr = pADCx->SR;
+	uint32_t cr1 = pADCx->CR1;
+
+	/*************************Check for EOC flag ********************************************/
+	if((sr & (1 << ADC_SR_EOC)) && (cr1 & (1 << ADC_CR1_EOCIE)))
+	{
+		ADC_ApplicationEventCallback(pADCHandle, ADC_EVENT_EOC);
+		// in case the application did not read DR
+		pADCx->SR = ~(1 << ADC_SR_EOC);
+	}
+
+	/*************************Check for OVR flag ********************************************/
+	if((sr & (1 << ADC_SR_OVR)) && (cr1 & (1 << ADC_CR1_OVRIE)))
+	{
+		pADCx->SR = ~(1 << ADC_SR_OVR);
+		pADCx->CR2 &= ~(1 << ADC_CR2_DMA);
+		ADC_ApplicationEventCallback(pADCHandle, ADC_ERROR_OVR);
+	}
+
+	PROF_ISR_END();
+}
+
+/**************************************************************************
+ * Switch the ADC on or off
+ * ************************************************************************
+ * @fn			- ADC_PeripheralControl
+ *
+ * @brief		- Sets or clears ADON.
+ *
+ * @param[in]	- base address of the ADC peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ *
+ * @Note		- The ADC needs t_STAB (3 us) after ADON before the first
+ * 				  conversion is started.
+ ****************************************************************************/
+void ADC_PeripheralControl(ADC_RegDef_t *pADCx, uint8_t EnOrDi)
+{
+	if(EnOrDi == ENABLE)
+	{
+		pADCx->CR2 |= (1 << ADC_CR2_ADON);
+	} else
+	{
+		pADCx->CR2 &= ~(1 << ADC_CR2_ADON);
+	}
+}
+
+/**************************************************************************
+ * Flag status
+ * ************************************************************************
+ * @fn			- ADC_GetFlagStatus
+ *
+ * @param[in]	- base address of the ADC peripheral
+ * @param[in]	- ADC_FLAG_xxx
+ *
+ * @return		- FLAG_SET or FLAG_RESET
+ ****************************************************************************/
+uint8_t ADC_GetFlagStatus(ADC_RegDef_t *pADCx, uint32_t FlagName)
+{
+	if(pADCx->SR & FlagName)
+	{
+		return FLAG_SET;
+	}
+	return FLAG_RESET;
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- ADC_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- ADC_EVENT_xxx or ADC_ERROR_xxx
+ ****************************************************************************/
+__attribute__((weak)) void ADC_ApplicationEventCallback(ADC_Handle_t *pADCHandle, uint8_t AppEv)
+{
+	(void)pADCHandle;
+	(void)AppEv;
+}
+
+/*
+ * Selects the DMA stream of the ADC (RM0090 DMA2 request mapping) and
+ * configures it. ADC1 and ADC3 can both use stream 0, so ADC3 takes its
+ * alternative stream 1, and ADC2 takes stream 3 (stream 2 is USART1 RX).
+ */
+static void ADC_DMAConfig(ADC_Handle_t *pADCHandle, uint8_t Mode, uint8_t DataSize)
+{
+	const Periph_Instance_t *pInst = Periph_Get(pADCHandle->pADCx);
+	DMA_Handle_t *pDMA = &pADCHandle->DMA;
+
+	if(pInst == 0)
+		return;
+
+	pDMA->pDMAx = pInst->DMARx.pDMAx;
+	pDMA->Stream = pInst->DMARx.Stream;
+	pDMA->DMAConfig.DMA_Channel = pInst->DMARx.Channel;
+
+	pDMA->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+	pDMA->DMAConfig.DMA_PeriphInc = DISABLE;
+	pDMA->DMAConfig.DMA_MemInc = ENABLE;
+	pDMA->DMAConfig.DMA_PeriphDataSize = DataSize;
+	pDMA->DMAConfig.DMA_MemDataSize = DataSize;
+	pDMA->DMAConfig.DMA_Mode = Mode;
+	pDMA->DMAConfig.DMA_Priority = DMA_PRIORITY_VERY_HIGH; // samples can not wait
+	pDMA->DMAConfig.DMA_FIFOMode = DMA_FIFO_DIRECT;
+	pDMA->pEventCallback = ADC_DMAEventCallback;
+	pDMA->pParent = pADCHandle;
+
+	DMA_Init(pDMA);
+}
+
+static void ADC_DMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	ADC_Handle_t *pADCHandle = (ADC_Handle_t*)pDMAHandle->pParent;
+
+	if(AppEv == DMA_EVENT_ERROR)
+	{
+		ADC_ApplicationEventCallback(pADCHandle, ADC_ERROR_DMA);
+	} else if(AppEv == DMA_EVENT_HALF_CMPLT)
+	{
+		ADC_ApplicationEventCallback(pADCHandle, ADC_EVENT_HALF_CMPLT);
+	} else if(AppEv == DMA_EVENT_CMPLT)
+	{
+		if(pDMAHandle->DMAConfig.DMA_Mode == DMA_MODE_DOUBLE_BUFFER)
+		{
+			// the hardware already works on the other buffer
+			if(DMA_GetCurrentTarget(pDMAHandle) == 1)
+				ADC_ApplicationEventCallback(pADCHandle, ADC_EVENT_BUFFER0_READY);
+			else
+				ADC_ApplicationEventCallback(pADCHandle, ADC_EVENT_BUFFER1_READY);
+		} else
+		{
+			ADC_ApplicationEventCallback(pADCHandle, ADC_EVENT_CMPLT);
+		}
+	}
+}
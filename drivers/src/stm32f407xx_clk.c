@@ -0,0 +1,402 @@
+/*
+ * stm32f407xx_clk.c
+ *
+ * Peripheral clock manager, see stm32f407xx_clk.h
+ */
+#include <stdio.h>
+#include <string.h>
+#include "stm32f407xx_clk.h"
+
+// a saturated count is never released again (the clock stays on)
+#define CLK_REF_MAX					0xFF
+
+#define CLK_ENR(pInst)				((&RCC->AHB1ENR)[(pInst)->Bus])
+#define CLK_LPENR(pInst)			((&RCC->AHB1LPENR)[(pInst)->Bus])
+
+static Clk_State_t clk_state[PERIPH_NO_OF_INSTANCES];
+static uint8_t clk_sleep_gating;
+
+// cycles since Clk_Init, for the share of time a clock was on
+static uint64_t clk_elapsed;
+static uint32_t clk_last;
+
+// in @PERIPH_ID order
+static const char *const clk_names[PERIPH_NO_OF_INSTANCES] =
+{
+	"GPIOA", "GPIOB", "GPIOC", "GPIOD", "GPIOE", "GPIOF", "GPIOG", "GPIOH", "GPIOI",
+	"SPI1", "SPI2", "SPI3", "SPI4",
+	"I2C1", "I2C2", "I2C3",
+	"USART1", "USART2", "USART3", "UART4", "UART5", "USART6",
+	"TIM1", "TIM2", "TIM3", "TIM4", "TIM5", "TIM6", "TIM7",
+	"TIM8", "TIM9", "TIM10", "TIM11", "TIM12", "TIM13", "TIM14",
+	"ADC1", "ADC2", "ADC3",
+	"DMA1", "DMA2",
+	"SYSCFG", "PWR",
+};
+
+/*
+ * Helper functions
+ */
+static void Clk_Fold(uint8_t Id, uint32_t Now);
+static void Clk_SwitchOn(uint8_t Id, const Periph_Instance_t *pInst);
+
+/**************************************************************************
+ * Initialize the clock manager
+ * ************************************************************************
+ * @fn			- Clk_Init
+ *
+ * @brief		- Starts the DWT cycle counter (if it is not running yet)
+ * 				  and clears the reference counts and statistics.
+ *
+ * @param[in]	- ENABLE: peripheral clocks are off in sleep mode unless
+ * 				  requested with Clk_SleepRequest (all xxxLPENR bits of the
+ * 				  known peripherals are cleared).
+ * 				  DISABLE: the xxxLPENR registers are not touched.
+ *
+ * @return		- none
+ *
+ * @Note		- Call once at startup, before the first driver Init.
+ * 				  Clocks which are already on stay on without an owner,
+ * 				  their on-time is counted from here.
+ ****************************************************************************/
+void Clk_Init(uint8_t SleepGating)
+{
+	uint32_t now;
+
+	*DEMCR |= (1 << DEMCR_TRCENA);
+	*DWT_CTRL |= (1 << DWT_CTRL_CYCCNTENA);
+	now = *DWT_CYCCNT;
+
+	memset(clk_state, 0, sizeof(clk_state));
+	clk_sleep_gating = SleepGating;
+	clk_elapsed = 0;
+	clk_last = now;
+
+	for(uint8_t id = 0; id < PERIPH_NO_OF_INSTANCES; id++)
+	{
+		const Periph_Instance_t *pInst = Periph_GetById(id);
+
+		clk_state[id].OnSince = now;
+		if(CLK_ENR(pInst) & (1 << pInst->EnBit))
+			clk_state[id].OnCount = 1;
+		if(SleepGating == ENABLE)
+			CLK_LPENR(pInst) &= ~(1 << pInst->EnBit);
+	}
+}
+
+/**************************************************************************
+ * Run mode clock
+ * ************************************************************************
+ * @fn			- Clk_Request
+ *
+ * @brief		- Adds a user of the peripheral clock. The first user turns
+ * 				  the clock on.
+ *
+ * @param[in]	- base address of the peripheral (SPI2, GPIOD, ...)
+ *
+ * @return		- none
+ *
+ * @Note		- May be called from interrupt handlers.
+ ****************************************************************************/
+void Clk_Request(const __vo void *pRegs)
+{
+	uint8_t id = Periph_GetId(pRegs);
+	const Periph_Instance_t *pInst = Periph_GetById(id);
+	uint32_t primask;
+
+	if(pInst == 0)
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	// may be on already without users (Clk_Ensure)
+	if(clk_state[id].RefCount == 0)
+		Clk_SwitchOn(id, pInst);
+	if(clk_state[id].RefCount < CLK_REF_MAX)
+		clk_state[id].RefCount++;
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Clk_Release
+ *
+ * @brief		- Removes a user of the peripheral clock. The last user
+ * 				  turns the clock off.
+ *
+ * @param[in]	- base address of the peripheral
+ *
+ * @return		- none
+ *
+ * @Note		- A release without a request is ignored. So is a release
+ * 				  after CLK_REF_MAX requests: the clock then stays on.
+ ****************************************************************************/
+void Clk_Release(const __vo void *pRegs)
+{
+	uint8_t id = Periph_GetId(pRegs);
+	const Periph_Instance_t *pInst = Periph_GetById(id);
+	uint32_t primask;
+
+	if(pInst == 0)
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if(clk_state[id].RefCount != 0 && clk_state[id].RefCount != CLK_REF_MAX)
+	{
+		if(--clk_state[id].RefCount == 0)
+		{
+			Clk_Fold(id, *DWT_CYCCNT);
+			CLK_ENR(pInst) &= ~(1 << pInst->EnBit);
+		}
+	}
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Clk_Control
+ *
+ * @brief		- Clk_Request for ENABLE, Clk_Release for DISABLE. Used by
+ * 				  the xxx_PeriClockControl APIs.
+ *
+ * @param[in]	- base address of the peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ *
+ * @return		- none
+ ****************************************************************************/
+void Clk_Control(const __vo void *pRegs, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+		Clk_Request(pRegs);
+	else
+		Clk_Release(pRegs);
+}
+
+/**************************************************************************
+ * @fn			- Clk_Ensure
+ *
+ * @brief		- Turns the peripheral clock on if it is off, without adding
+ * 				  a user. Used by the driver Inits for their register
+ * 				  writes.
+ *
+ * @param[in]	- base address of the peripheral
+ *
+ * @return		- none
+ *
+ * @Note		- The clock goes off with the last Clk_Release of the
+ * 				  users, if any: the owner of a clock is whoever requested
+ * 				  it (xxx_PeriClockControl), not the driver.
+ ****************************************************************************/
+void Clk_Ensure(const __vo void *pRegs)
+{
+	uint8_t id = Periph_GetId(pRegs);
+	const Periph_Instance_t *pInst = Periph_GetById(id);
+	uint32_t primask;
+
+	if(pInst == 0)
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	Clk_SwitchOn(id, pInst);
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * Sleep mode clock
+ * ************************************************************************
+ * @fn			- Clk_SleepRequest
+ *
+ * @brief		- Adds a user of the peripheral clock in sleep mode. The
+ * 				  first user sets the xxxLPENR bit.
+ *
+ * @param[in]	- base address of the peripheral
+ *
+ * @return		- none
+ *
+ * @Note		- The xxxLPENR bit is only written with sleep gating on
+ * 				  (Clk_Init(ENABLE)), otherwise every clock which is on
+ * 				  keeps running in sleep mode. The run mode clock must be
+ * 				  requested as well.
+ ****************************************************************************/
+void Clk_SleepRequest(const __vo void *pRegs)
+{
+	uint8_t id = Periph_GetId(pRegs);
+	const Periph_Instance_t *pInst = Periph_GetById(id);
+	uint32_t primask;
+
+	if(pInst == 0)
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if(clk_state[id].SleepRefCount == 0 && clk_sleep_gating == ENABLE)
+		CLK_LPENR(pInst) |= (1 << pInst->EnBit);
+	if(clk_state[id].SleepRefCount < CLK_REF_MAX)
+		clk_state[id].SleepRefCount++;
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Clk_SleepRelease
+ *
+ * @brief		- Removes a user of the peripheral clock in sleep mode. The
+ * 				  last user clears the xxxLPENR bit.
+ *
+ * @param[in]	- base address of the peripheral
+ *
+ * @return		- none
+ ****************************************************************************/
+void Clk_SleepRelease(const __vo void *pRegs)
+{
+	uint8_t id = Periph_GetId(pRegs);
+	const Periph_Instance_t *pInst = Periph_GetById(id);
+	uint32_t primask;
+
+	if(pInst == 0)
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if(clk_state[id].SleepRefCount != 0 && clk_state[id].SleepRefCount != CLK_REF_MAX)
+	{
+		if(--clk_state[id].SleepRefCount == 0 && clk_sleep_gating == ENABLE)
+			CLK_LPENR(pInst) &= ~(1 << pInst->EnBit);
+	}
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * Statistics
+ * ************************************************************************
+ * @fn			- Clk_Update
+ *
+ * @brief		- Adds the time since the last update to the on-time of
+ * 				  every clock which is on.
+ *
+ * @return		- none
+ *
+ * @Note		- The cycle counter wraps after 2^32 cycles: call it more
+ * 				  often than that (e.g. from a slow periodic timer).
+ ****************************************************************************/
+void Clk_Update(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint32_t now;
+
+	__disable_irq();
+	now = *DWT_CYCCNT;
+	for(uint8_t id = 0; id < PERIPH_NO_OF_INSTANCES; id++)
+	{
+		const Periph_Instance_t *pInst = Periph_GetById(id);
+
+		if(CLK_ENR(pInst) & (1 << pInst->EnBit))
+			Clk_Fold(id, now);
+	}
+	clk_elapsed += (uint32_t)(now - clk_last);
+	clk_last = now;
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Clk_GetRefCount
+ *
+ * @brief		- Number of users of the peripheral clock.
+ *
+ * @param[in]	- base address of the peripheral
+ *
+ * @return		- reference count, 0 for an unknown peripheral
+ ****************************************************************************/
+uint8_t Clk_GetRefCount(const __vo void *pRegs)
+{
+	uint8_t id = Periph_GetId(pRegs);
+
+	return (id < PERIPH_NO_OF_INSTANCES) ? clk_state[id].RefCount : 0;
+}
+
+/**************************************************************************
+ * @fn			- Clk_GetOnTime
+ *
+ * @brief		- Time the peripheral clock was on since Clk_Init.
+ *
+ * @param[in]	- base address of the peripheral
+ *
+ * @return		- HCLK cycles
+ ****************************************************************************/
+uint64_t Clk_GetOnTime(const __vo void *pRegs)
+{
+	uint8_t id = Periph_GetId(pRegs);
+	const Periph_Instance_t *pInst = Periph_GetById(id);
+	uint32_t primask;
+	uint64_t cycles;
+
+	if(pInst == 0)
+		return 0;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if(CLK_ENR(pInst) & (1 << pInst->EnBit))
+		Clk_Fold(id, *DWT_CYCCNT);
+	cycles = clk_state[id].OnCycles;
+	__set_PRIMASK(primask);
+
+	return cycles;
+}
+
+/**************************************************************************
+ * @fn			- Clk_Report
+ *
+ * @brief		- Prints one line per peripheral whose clock was on since
+ * 				  Clk_Init: periph,refs,sleep_refs,on,switch_ons,on_ms,on_percent
+ *
+ * @return		- none
+ *
+ * @Note		- Uses printf (syscalls / log module), thread mode only.
+ ****************************************************************************/
+void Clk_Report(void)
+{
+	uint32_t hclk_khz = RCC_GetHCLKValue() / 1000;
+	uint64_t elapsed;
+
+	Clk_Update();
+	elapsed = clk_elapsed;
+
+	printf("periph,refs,sleep_refs,on,switch_ons,on_ms,on_percent\n");
+	for(uint8_t id = 0; id < PERIPH_NO_OF_INSTANCES; id++)
+	{
+		const Periph_Instance_t *pInst = Periph_GetById(id);
+		Clk_State_t state;
+		uint32_t primask = __get_PRIMASK();
+
+		// consistent copy, handlers may request and release clocks
+		__disable_irq();
+		state = clk_state[id];
+		__set_PRIMASK(primask);
+
+		if(state.OnCount == 0)
+			continue;
+
+		printf("%s,%u,%u,%u,%lu,%lu,%lu\n", clk_names[id], state.RefCount, state.SleepRefCount,
+				(CLK_ENR(pInst) & (1 << pInst->EnBit)) ? 1 : 0, (unsigned long)state.OnCount,
+				(unsigned long)(state.OnCycles / hclk_khz),
+				(unsigned long)(elapsed ? state.OnCycles * 100 / elapsed : 0));
+	}
+}
+
+// adds the cycles since OnSince to the on-time, called with interrupts masked
+static void Clk_Fold(uint8_t Id, uint32_t Now)
+{
+	clk_state[Id].OnCycles += (uint32_t)(Now - clk_state[Id].OnSince);
+	clk_state[Id].OnSince = Now;
+}
+
+// turns the clock on if it is off, called with interrupts masked
+static void Clk_SwitchOn(uint8_t Id, const Periph_Instance_t *pInst)
+{
+	// a clock with users is on, no need to read RCC
+	if(clk_state[Id].RefCount != 0 || (CLK_ENR(pInst) & (1 << pInst->EnBit)))
+		return;
+
+	CLK_ENR(pInst) |= (1 << pInst->EnBit);
+	clk_state[Id].OnSince = *DWT_CYCCNT;
+	clk_state[Id].OnCount++;
+}
@@ -0,0 +1,519 @@
+// In driver.c, you have to include respective peripheral's driver file.
+#include "stm32f407xx_dma_driver.h"
+
+// Each stream owns 6 flag bits in LISR/HISR (streams 0-3 in LISR, 4-7 in HISR).
+// The flag groups are not evenly spaced: 0, 6, 16 and 22.
+static const uint8_t DMA_StreamFlagShift[4] = { 0, 6, 16, 22 };
+
+static const uint8_t DMA1_IRQNumbers[8] = {
+	IRQ_NO_DMA1_STREAM0, IRQ_NO_DMA1_STREAM1, IRQ_NO_DMA1_STREAM2, IRQ_NO_DMA1_STREAM3,
+	IRQ_NO_DMA1_STREAM4, IRQ_NO_DMA1_STREAM5, IRQ_NO_DMA1_STREAM6, IRQ_NO_DMA1_STREAM7
+};
+
+static const uint8_t DMA2_IRQNumbers[8] = {
+	IRQ_NO_DMA2_STREAM0, IRQ_NO_DMA2_STREAM1, IRQ_NO_DMA2_STREAM2, IRQ_NO_DMA2_STREAM3,
+	IRQ_NO_DMA2_STREAM4, IRQ_NO_DMA2_STREAM5, IRQ_NO_DMA2_STREAM6, IRQ_NO_DMA2_STREAM7
+};
+
+// Streams with a transfer in flight, bit (DMA2 ? 8 : 0) + stream.
+// Each one holds a Stop mode veto (see stm32f407xx_pwr.h).
+static uint16_t DMA_ActiveStreams;
+
+static void DMA_SetActive(DMA_Handle_t *pDMAHandle, uint8_t Active);
+
+/*
+ * Helper functions to read and clear the flag group of one stream
+ */
+static uint32_t DMA_GetStreamFlags(DMA_Handle_t *pDMAHandle)
+{
+	uint8_t shift = DMA_StreamFlagShift[pDMAHandle->Stream % 4];
+
+	if(pDMAHandle->Stream < 4)
+		return (pDMAHandle->pDMAx->LISR >> shift) & 0x3D;
+	else
+		return (pDMAHandle->pDMAx->HISR >> shift) & 0x3D;
+}
+
+static void DMA_ClearStreamFlags(DMA_Handle_t *pDMAHandle, uint32_t Flags)
+{
+	uint8_t shift = DMA_StreamFlagShift[pDMAHandle->Stream % 4];
+
+	// Flag clear registers are write 1 to clear, other bits are not affected.
+	if(pDMAHandle->Stream < 4)
+		pDMAHandle->pDMAx->LIFCR = (Flags << shift);
+	else
+		pDMAHandle->pDMAx->HIFCR = (Flags << shift);
+}
+
+/**********************************************************************
+ * Peripheral Clock setup
+ * (Peripheral Control API)
+ * ********************************************************************
+ * @fn			- DMA_PeriClockControl
+ *
+ * @brief		- This function enables or disables peripheral clock
+ * 				  for the given DMA controller
+ *
+ * @param[in]	- base address of the DMA controller
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Reference counted by the clock manager: the clock goes
+ * 				  off with the last DISABLE, see stm32f407xx_clk.h
+ ***********************************************************************/
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi)
+{
+	Clk_Control(pDMAx, EnorDi);
+}
+
+/**************************************************************************
+ * Initialize DMA stream
+ * ************************************************************************
+ * @fn			- DMA_Init
+ *
+ * @brief		- To configure the stream control and FIFO registers.
+ *
+ * 				  The stream is left disabled. It is enabled by DMA_Start or
+ * 				  DMA_StartDoubleBuffer once the addresses are known.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- The stream must not be in use by another driver.
+ ****************************************************************************/
+void DMA_Init(DMA_Handle_t *pDMAHandle)
+{
+	DMA_Stream_RegDef_t *pStream = DMA_STREAM(pDMAHandle);
+	DMA_Config_t *pConfig = &pDMAHandle->DMAConfig;
+	uint32_t tempreg = 0;
+
+	Clk_Ensure(pDMAHandle->pDMAx);
+
+	// Stream configuration can only be written while EN reads back 0.
+	DMA_Stop(pDMAHandle);
+	// Flags left by the previous user (stopping sets TCIF) would raise an
+	// interrupt as soon as it is enabled below.
+	DMA_ClearStreamFlags(pDMAHandle, 0x3D);
+
+	// 1. Request channel, direction and priority
+	tempreg |= (uint32_t)pConfig->DMA_Channel << DMA_SxCR_CHSEL;
+	tempreg |= (uint32_t)pConfig->DMA_Direction << DMA_SxCR_DIR;
+	tempreg |= (uint32_t)pConfig->DMA_Priority << DMA_SxCR_PL;
+
+	// 2. Address increment and data sizes
+	tempreg |= (uint32_t)pConfig->DMA_PeriphInc << DMA_SxCR_PINC;
+	tempreg |= (uint32_t)pConfig->DMA_MemInc << DMA_SxCR_MINC;
+	tempreg |= (uint32_t)pConfig->DMA_PeriphDataSize << DMA_SxCR_PSIZE;
+	tempreg |= (uint32_t)pConfig->DMA_MemDataSize << DMA_SxCR_MSIZE;
+
+	// 3. Mode. Double buffer mode always runs circular.
+	if(pConfig->DMA_Mode == DMA_MODE_CIRCULAR)
+	{
+		tempreg |= (1 << DMA_SxCR_CIRC);
+		tempreg |= (1 << DMA_SxCR_HTIE);
+	} else if(pConfig->DMA_Mode == DMA_MODE_DOUBLE_BUFFER)
+	{
+		tempreg |= (1 << DMA_SxCR_CIRC) | (1 << DMA_SxCR_DBM);
+	}
+
+	// 4. Transfer complete and error interrupts
+	tempreg |= (1 << DMA_SxCR_TCIE) | (1 << DMA_SxCR_TEIE) | (1 << DMA_SxCR_DMEIE);
+
+	pStream->CR = tempreg;
+
+	// 5. FIFO: direct mode or threshold
+	if(pConfig->DMA_FIFOMode == DMA_FIFO_DIRECT)
+	{
+		pStream->FCR = 0;
+	} else
+	{
+		pStream->FCR = (1 << DMA_SxFCR_DMDIS) | ((uint32_t)(pConfig->DMA_FIFOMode - 1) << DMA_SxFCR_FTH);
+	}
+}
+
+/**************************************************************************
+ * Deinitialize DMA stream
+ * ************************************************************************
+ * @fn			- DMA_DeInit
+ *
+ * @brief		- Disables the stream and returns its registers to reset values.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Other streams of the same controller are not affected,
+ * 				  so the RCC reset is not used here.
+ ****************************************************************************/
+void DMA_DeInit(DMA_Handle_t *pDMAHandle)
+{
+	DMA_Stream_RegDef_t *pStream = DMA_STREAM(pDMAHandle);
+
+	DMA_Stop(pDMAHandle);
+
+	pStream->CR = 0;
+	pStream->NDTR = 0;
+	pStream->PAR = 0;
+	pStream->M0AR = 0;
+	pStream->M1AR = 0;
+	pStream->FCR = (1 << 5); // reset value, FIFO empty
+
+	DMA_ClearStreamFlags(pDMAHandle, 0x3D);
+}
+
+/**************************************************************************
+ * Start a transfer
+ * ************************************************************************
+ * @fn			- DMA_Start
+ *
+ * @brief		- Loads the addresses and the item count and enables the stream.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- peripheral address (source for memory to memory)
+ * @param[in]	- memory address
+ * @param[in]	- number of data items (in peripheral data size units)
+ *
+ * @return		- none
+ *
+ * @Note		- This is a non-blocking call. Completion is reported by
+ * 				  DMA_IRQHandling through the event callback.
+ ****************************************************************************/
+void DMA_Start(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t MemAddr, uint16_t Len)
+{
+	DMA_Stream_RegDef_t *pStream = DMA_STREAM(pDMAHandle);
+
+	// Stale flags of the previous transfer would block the enable.
+	DMA_ClearStreamFlags(pDMAHandle, 0x3D);
+
+	pStream->PAR = PeriphAddr;
+	pStream->M0AR = MemAddr;
+	pStream->NDTR = Len;
+
+	DMA_SetActive(pDMAHandle, SET);
+	pStream->CR |= (1 << DMA_SxCR_EN);
+}
+
+/**************************************************************************
+ * Start a double buffer transfer
+ * ************************************************************************
+ * @fn			- DMA_StartDoubleBuffer
+ *
+ * @brief		- Like DMA_Start, but the stream swaps between memory 0 and
+ * 				  memory 1 after every Len items. A DMA_EVENT_CMPLT is
+ * 				  reported after each buffer; DMA_GetCurrentTarget tells
+ * 				  which buffer the hardware is working on now.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- peripheral address
+ * @param[in]	- memory 0 address and memory 1 address
+ * @param[in]	- number of data items per buffer
+ *
+ * @return		- none
+ *
+ * @Note		- The handle must be configured with DMA_MODE_DOUBLE_BUFFER.
+ ****************************************************************************/
+void DMA_StartDoubleBuffer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t Mem0Addr, uint32_t Mem1Addr, uint16_t Len)
+{
+	DMA_Stream_RegDef_t *pStream = DMA_STREAM(pDMAHandle);
+
+	DMA_ClearStreamFlags(pDMAHandle, 0x3D);
+
+	pStream->PAR = PeriphAddr;
+	pStream->M0AR = Mem0Addr;
+	pStream->M1AR = Mem1Addr;
+	pStream->NDTR = Len;
+
+	// Always start with memory 0
+	pStream->CR &= ~(1 << DMA_SxCR_CT);
+	DMA_SetActive(pDMAHandle, SET);
+	pStream->CR |= (1 << DMA_SxCR_EN);
+}
+
+/**************************************************************************
+ * Stop a transfer
+ * ************************************************************************
+ * @fn			- DMA_Stop
+ *
+ * @brief		- Disables the stream and waits until the hardware has
+ * 				  finished the current data item.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- NDTR keeps the number of items which were not transferred.
+ ****************************************************************************/
+void DMA_Stop(DMA_Handle_t *pDMAHandle)
+{
+	DMA_Stream_RegDef_t *pStream = DMA_STREAM(pDMAHandle);
+
+	pStream->CR &= ~(1 << DMA_SxCR_EN);
+	// EN stays set until the ongoing single transfer/burst has ended.
+	while(pStream->CR & (1 << DMA_SxCR_EN));
+
+	DMA_SetActive(pDMAHandle, RESET);
+}
+
+/**************************************************************************
+ * Number of items left
+ * ************************************************************************
+ * @fn			- DMA_GetRemaining
+ *
+ * @brief		- Returns NDTR of the stream.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- items left in the current (or stopped) transfer
+ *
+ * @Note		- In circular mode NDTR reloads, so Len - NDTR is the
+ * 				  current write position inside the buffer.
+ ****************************************************************************/
+uint16_t DMA_GetRemaining(DMA_Handle_t *pDMAHandle)
+{
+	return (uint16_t)DMA_STREAM(pDMAHandle)->NDTR;
+}
+
+/**************************************************************************
+ * Current double buffer target
+ * ************************************************************************
+ * @fn			- DMA_GetCurrentTarget
+ *
+ * @brief		- Returns the CT bit: 0 when the hardware uses memory 0,
+ * 				  1 when it uses memory 1.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- 0 or 1
+ *
+ * @Note		- The buffer which is NOT the current target is owned by the CPU.
+ ****************************************************************************/
+uint8_t DMA_GetCurrentTarget(DMA_Handle_t *pDMAHandle)
+{
+	return (uint8_t)((DMA_STREAM(pDMAHandle)->CR >> DMA_SxCR_CT) & 0x1);
+}
+
+/**************************************************************************
+ * Stream enable status
+ * ************************************************************************
+ * @fn			- DMA_IsEnabled
+ *
+ * @brief		- Returns SET while the stream is running.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- SET or RESET
+ *
+ * @Note		- The hardware clears EN at the end of a normal mode transfer.
+ ****************************************************************************/
+uint8_t DMA_IsEnabled(DMA_Handle_t *pDMAHandle)
+{
+	if(DMA_STREAM(pDMAHandle)->CR & (1 << DMA_SxCR_EN))
+		return SET;
+	return RESET;
+}
+
+/**************************************************************************
+ * Memory address increment
+ * ************************************************************************
+ * @fn			- DMA_MemIncConfig
+ *
+ * @brief		- Changes MINC of a configured stream, e.g. to send one
+ * 				  dummy item over and over or to drop received items.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- The stream must be stopped.
+ ****************************************************************************/
+void DMA_MemIncConfig(DMA_Handle_t *pDMAHandle, uint8_t EnOrDi)
+{
+	DMA_Stream_RegDef_t *pStream = DMA_STREAM(pDMAHandle);
+
+	pDMAHandle->DMAConfig.DMA_MemInc = EnOrDi;
+	if(EnOrDi == ENABLE)
+	{
+		pStream->CR |= (1 << DMA_SxCR_MINC);
+	} else
+	{
+		pStream->CR &= ~(1 << DMA_SxCR_MINC);
+	}
+}
+
+/**************************************************************************
+ * IRQ number of a stream
+ * ************************************************************************
+ * @fn			- DMA_GetIRQNumber
+ *
+ * @brief		- Returns the NVIC IRQ number of the handle's stream.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- IRQ number
+ *
+ * @Note		- none
+ ****************************************************************************/
+uint8_t DMA_GetIRQNumber(DMA_Handle_t *pDMAHandle)
+{
+	if(pDMAHandle->pDMAx == DMA1)
+		return DMA1_IRQNumbers[pDMAHandle->Stream];
+	return DMA2_IRQNumbers[pDMAHandle->Stream];
+}
+
+/**************************************************************************
+ * Interrupt Configuration
+ * ************************************************************************
+ * @fn			- DMA_IRQInterruptConfig
+ *
+ * @brief		- All of the configuration in this API is processor specific.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- DMA2 streams 5-7 are above IRQ 63, so ISER2/ICER2 are needed.
+ ****************************************************************************/
+void DMA_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	NVIC_IRQInterruptConfig(IRQNumber, EnorDi);
+}
+
+/**************************************************************************
+ * Priority Configuration
+ * ************************************************************************
+ * @fn			- DMA_IRQPriorityConfig
+ *
+ * @brief		- Sets the priority field of the given IRQ number.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- priority (NVIC_IRQ_PRIx)
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void DMA_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority)
+{
+	NVIC_IRQPriorityConfig(IRQNumber, IRQPriority);
+}
+
+/**************************************************************************
+ * Interrupt Handling
+ * ************************************************************************
+ * @fn			- DMA_IRQHandling
+ *
+ * @brief		- Call this from the DMAx_Streamy_IRQHandler of the stream.
+ * 				  Clears the stream flags and reports half transfer,
+ * 				  transfer complete and error events to the owner.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- A FIFO error alone is not reported, it only means the
+ * 				  FIFO ran empty/full for one cycle in direct mode.
+ ****************************************************************************/
+void DMA_IRQHandling(DMA_Handle_t *pDMAHandle)
+{
+	PROF_ISR_BEGIN();
+
+	uint32_t flags = DMA_GetStreamFlags(pDMAHandle);
+	void (*pCallback)(DMA_Handle_t *, uint8_t) = pDMAHandle->pEventCallback;
+
+	if(pCallback == 0)
+		pCallback = DMA_ApplicationEventCallback;
+
+	DMA_ClearStreamFlags(pDMAHandle, flags);
+
+	if(flags & ((1 << DMA_ISR_TEIF) | (1 << DMA_ISR_DMEIF)))
+	{
+		pCallback(pDMAHandle, DMA_EVENT_ERROR);
+	} else
+	{
+		if(flags & (1 << DMA_ISR_HTIF))
+		{
+			pCallback(pDMAHandle, DMA_EVENT_HALF_CMPLT);
+		}
+		if(flags & (1 << DMA_ISR_TCIF))
+		{
+			pCallback(pDMAHandle, DMA_EVENT_CMPLT);
+		}
+	}
+
+	// End of a normal mode transfer or stream disabled by an error,
+	// unless the callback has started the next transfer already.
+	if(!(DMA_STREAM(pDMAHandle)->CR & (1 << DMA_SxCR_EN)))
+		DMA_SetActive(pDMAHandle, RESET);
+
+	PROF_ISR_END();
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- DMA_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- DMA_EVENT_xxx
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Only called for handles without pEventCallback.
+ ****************************************************************************/
+__attribute__((weak)) void DMA_ApplicationEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	(void)pDMAHandle;
+	(void)AppEv;
+}
+
+// takes or drops the Stop mode veto of a stream, once per transfer
+static void DMA_SetActive(DMA_Handle_t *pDMAHandle, uint8_t Active)
+{
+	uint16_t bit = 1 << ((pDMAHandle->pDMAx == DMA2 ? 8 : 0) + pDMAHandle->Stream);
+	uint32_t primask = __get_PRIMASK();
+	uint8_t changed = 0;
+
+	__disable_irq();
+	if(Active == SET && !(DMA_ActiveStreams & bit))
+	{
+		DMA_ActiveStreams |= bit;
+		changed = 1;
+	} else if(Active == RESET && (DMA_ActiveStreams & bit))
+	{
+		DMA_ActiveStreams &= ~bit;
+		changed = 1;
+	}
+	__set_PRIMASK(primask);
+
+	if(changed && Active == SET)
+		Pwr_VetoStop(pDMAHandle->pDMAx);
+	else if(changed)
+		Pwr_ReleaseStop(pDMAHandle->pDMAx);
+}
@@ -0,0 +1,336 @@
+/*
+ * stm32f407xx_expander.c
+ *
+ * Shift register I/O expanders, see stm32f407xx_expander.h
+ */
+#include <string.h>
+#include "stm32f407xx_expander.h"
+
+/*
+ * Helper functions
+ */
+static void Expander_PinInit(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber);
+static void Expander_Pulse(__vo uint32_t *pBsrr, uint32_t Bit);
+static uint8_t Expander_Claim(Expander_Handle_t *pExpander);
+
+/**************************************************************************
+ * Initialize the expanders
+ * ************************************************************************
+ * @fn			- Expander_Init
+ *
+ * @brief		- Makes the latch (and load) pins push-pull outputs, high,
+ * 				  and clears the images.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- @EXPANDER_RETURN
+ *
+ * @Note		- The 595 outputs hold whatever they had until the first
+ * 				  refresh (keep their OE high until then if that matters).
+ ****************************************************************************/
+uint8_t Expander_Init(Expander_Handle_t *pExpander, Expander_Config_t *pConfig)
+{
+	if((pConfig->OutBytes == 0 && pConfig->InBytes == 0) ||
+	   pConfig->OutBytes > EXPANDER_MAX_BYTES || pConfig->InBytes > EXPANDER_MAX_BYTES)
+		return EXPANDER_ERR_PARAM;
+
+	memset(pExpander, 0, sizeof(*pExpander));
+	pExpander->Config = *pConfig;
+	pExpander->Len = (pConfig->OutBytes > pConfig->InBytes) ? pConfig->OutBytes : pConfig->InBytes;
+
+	pExpander->pLatchBsrr = &pConfig->pLatchPort->BSRR;
+	pExpander->LatchBit = 1U << pConfig->LatchPin;
+	Expander_PinInit(pConfig->pLatchPort, pConfig->LatchPin);
+
+	if(pConfig->pLoadPort != 0)
+	{
+		pExpander->pLoadBsrr = &pConfig->pLoadPort->BSRR;
+		pExpander->LoadBit = 1U << pConfig->LoadPin;
+		Expander_PinInit(pConfig->pLoadPort, pConfig->LoadPin);
+	}
+
+	return EXPANDER_OK;
+}
+
+/**************************************************************************
+ * @fn			- Expander_SetOutput
+ *
+ * @brief		- Sets one output bit in the image.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- output number, below OutBytes * 8 (not checked)
+ * @param[in]	- SET or RESET
+ *
+ * @return		- none
+ *
+ * @Note		- The pin follows at the end of the next refresh.
+ ****************************************************************************/
+void Expander_SetOutput(Expander_Handle_t *pExpander, uint16_t Bit, uint8_t Level)
+{
+	uint8_t *pByte = &pExpander->Out[pExpander->Len - 1 - (Bit >> 3)];
+	uint8_t mask = (uint8_t)(1U << (Bit & 7));
+	uint32_t primask = __get_PRIMASK();
+
+	// read-modify-write: the other bits of the byte may be set from an interrupt
+	__disable_irq();
+	if(Level == SET)
+		*pByte |= mask;
+	else
+		*pByte &= (uint8_t)~mask;
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Expander_GetOutput
+ *
+ * @brief		- Reads one output bit back from the image.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- output number, below OutBytes * 8 (not checked)
+ *
+ * @return		- 1 or 0
+ ****************************************************************************/
+uint8_t Expander_GetOutput(Expander_Handle_t *pExpander, uint16_t Bit)
+{
+	return (pExpander->Out[pExpander->Len - 1 - (Bit >> 3)] >> (Bit & 7)) & 1;
+}
+
+/**************************************************************************
+ * @fn			- Expander_WriteOutputByte
+ *
+ * @brief		- Sets the eight outputs of one 595 in the image.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- 595 number, below OutBytes (not checked)
+ * @param[in]	- levels, bit 0 for Q0
+ *
+ * @return		- none
+ ****************************************************************************/
+void Expander_WriteOutputByte(Expander_Handle_t *pExpander, uint16_t Chip, uint8_t Value)
+{
+	pExpander->Out[pExpander->Len - 1 - Chip] = Value;
+}
+
+/**************************************************************************
+ * @fn			- Expander_GetInput
+ *
+ * @brief		- Reads one input bit from the last complete refresh.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- input number, below InBytes * 8 (not checked)
+ *
+ * @return		- 1 or 0
+ ****************************************************************************/
+uint8_t Expander_GetInput(Expander_Handle_t *pExpander, uint16_t Bit)
+{
+	return (pExpander->In[pExpander->InCur][Bit >> 3] >> (Bit & 7)) & 1;
+}
+
+/**************************************************************************
+ * @fn			- Expander_ReadInputByte
+ *
+ * @brief		- Reads the eight inputs of one 165 from the last complete
+ * 				  refresh.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- 165 number, below InBytes (not checked)
+ *
+ * @return		- levels, bit 0 for input A
+ ****************************************************************************/
+uint8_t Expander_ReadInputByte(Expander_Handle_t *pExpander, uint16_t Chip)
+{
+	return pExpander->In[pExpander->InCur][Chip];
+}
+
+/**************************************************************************
+ * Refresh the chain
+ * ************************************************************************
+ * @fn			- Expander_Refresh
+ *
+ * @brief		- Loads the inputs if SH/LD has its own pin, then starts
+ * 				  the transfer of the whole chain. The latch pulse and
+ * 				  EXPANDER_EVENT_REFRESH_CMPLT follow from the interrupt.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- @EXPANDER_RETURN
+ *
+ * @Note		- May be called from an interrupt. A refresh which cannot
+ * 				  start is counted in Skipped.
+ ****************************************************************************/
+uint8_t Expander_Refresh(Expander_Handle_t *pExpander)
+{
+	uint8_t *pRx = 0;
+
+	if(!Expander_Claim(pExpander))
+	{
+		pExpander->Skipped++;
+		return EXPANDER_BUSY;
+	}
+
+	if(pExpander->pLoadBsrr != 0)
+		Expander_Pulse(pExpander->pLoadBsrr, pExpander->LoadBit);
+
+	if(pExpander->Config.InBytes != 0)
+		pRx = pExpander->In[pExpander->InCur ^ 1];
+	pExpander->ExpectedEv = pRx ? SPI_EVENT_RX_CMPLT : SPI_EVENT_TX_CMPLT;
+
+	if(SPI_TransferDMA(pExpander->Config.pSPIHandle, pExpander->Out, pRx, pExpander->Len) != SPI_READY)
+	{
+		// someone else is using the SPI
+		pExpander->Busy = 0;
+		pExpander->Skipped++;
+		return EXPANDER_BUSY;
+	}
+	return EXPANDER_OK;
+}
+
+/**************************************************************************
+ * @fn			- Expander_Busy
+ *
+ * @brief		- Tells whether a refresh is running.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if not
+ ****************************************************************************/
+uint8_t Expander_Busy(Expander_Handle_t *pExpander)
+{
+	return pExpander->Busy;
+}
+
+/**************************************************************************
+ * SPI events
+ * ************************************************************************
+ * @fn			- Expander_EventHandling
+ *
+ * @brief		- Ends a refresh: latches the outputs and switches the
+ * 				  input buffers. Events of other SPI handles are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- SPI handle of the event
+ * @param[in]	- SPI_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+void Expander_EventHandling(Expander_Handle_t *pExpander, SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	uint16_t inBytes = pExpander->Config.InBytes;
+	uint8_t changed = 0;
+
+	if(pSPIHandle != pExpander->Config.pSPIHandle || !pExpander->Busy)
+		return;
+
+	if(AppEv == SPI_EVENT_OVR_ERR || AppEv == SPI_EVENT_DMA_ERR)
+	{
+		pExpander->Busy = 0;
+		Expander_ApplicationEventCallback(pExpander, EXPANDER_EVENT_ERROR);
+		return;
+	}
+	if(AppEv != pExpander->ExpectedEv)
+		return;
+
+	// rising edge: the 595s show the image (and the 165s load, on a shared pin)
+	Expander_Pulse(pExpander->pLatchBsrr, pExpander->LatchBit);
+
+	if(inBytes != 0)
+	{
+		pExpander->InCur ^= 1;
+		changed = memcmp(pExpander->In[0], pExpander->In[1], inBytes) != 0;
+	}
+	pExpander->Refreshes++;
+
+	// free before the callbacks: they may start the next refresh
+	pExpander->Busy = 0;
+	Expander_ApplicationEventCallback(pExpander, EXPANDER_EVENT_REFRESH_CMPLT);
+	if(changed)
+		Expander_ApplicationEventCallback(pExpander, EXPANDER_EVENT_INPUT_CHANGED);
+}
+
+/**************************************************************************
+ * Timer events
+ * ************************************************************************
+ * @fn			- Expander_TimerEventHandling
+ *
+ * @brief		- Refreshes the chain on the update event of the
+ * 				  expander's timer. Other events and timers are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- timer handle of the event
+ * @param[in]	- TIM_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from TIM_ApplicationEventCallback.
+ ****************************************************************************/
+void Expander_TimerEventHandling(Expander_Handle_t *pExpander, TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	if(pTIMHandle == pExpander->Config.pTIMHandle && pTIMHandle != 0 && AppEv == TIM_EVENT_UPDATE)
+		Expander_Refresh(pExpander);
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Expander_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- EXPANDER_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler. The next refresh may
+ * 				  be started from here.
+ ****************************************************************************/
+__attribute__((weak)) void Expander_ApplicationEventCallback(Expander_Handle_t *pExpander, uint8_t AppEv)
+{
+	(void)pExpander;
+	(void)AppEv;
+}
+
+static void Expander_PinInit(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber)
+{
+	GPIO_Handle_t pin;
+
+	// high before it becomes an output: no edge on RCLK, SH/LD in shift mode
+	Clk_Ensure(pGPIOx);
+	pGPIOx->BSRR = 1U << PinNumber;
+
+	memset(&pin, 0, sizeof(pin));
+	pin.pGPIOx = pGPIOx;
+	pin.GPIO_PinConfig.GPIO_PinNumber = PinNumber;
+	pin.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	pin.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	pin.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	pin.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	GPIO_Init(&pin);
+}
+
+// Low, then high. The read in between waits for the first write to reach
+// the port: the pulse lasts a few AHB cycles, above the 74HC minimum.
+static void Expander_Pulse(__vo uint32_t *pBsrr, uint32_t Bit)
+{
+	*pBsrr = Bit << 16;
+	(void)*pBsrr;
+	*pBsrr = Bit;
+}
+
+static uint8_t Expander_Claim(Expander_Handle_t *pExpander)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t claimed = 0;
+
+	__disable_irq();
+	if(!pExpander->Busy)
+	{
+		pExpander->Busy = 1;
+		claimed = 1;
+	}
+	__set_PRIMASK(primask);
+	return claimed;
+}
@@ -15,55 +15,12 @@
  *
  * @return		- none
  *
- * @Note		- none
+ * @Note		- Reference counted by the clock manager: the clock goes
+ * 				  off with the last DISABLE, see stm32f407xx_clk.h
  ***********************************************************************/
 void GPIO_PeriClockControl(GPIO_RegDef_t *pGPIOx, uint8_t EnorDi)
 {
-	// check value of EnorDi parameter
-	if(EnorDi == ENABLE)
-	{
-		// enable clock for given GPIO port address
-		if (pGPIOx == GPIOA)
-			GPIOA_PCLK_EN();
-		else if (pGPIOx == GPIOB)
-			GPIOB_PCLK_EN();
-		else if (pGPIOx == GPIOC)
-			GPIOC_PCLK_EN();
-		else if (pGPIOx == GPIOD)
-			GPIOD_PCLK_EN();
-		else if (pGPIOx == GPIOE)
-			GPIOE_PCLK_EN();
-		else if (pGPIOx == GPIOF)
-			GPIOF_PCLK_EN();
-		else if (pGPIOx == GPIOG)
-			GPIOG_PCLK_EN();
-		else if (pGPIOx == GPIOH)
-			GPIOH_PCLK_EN();
-		else if (pGPIOx == GPIOI)
-			GPIOI_PCLK_EN();
-	}
-	else
-	{
-		// disable clock for given GPIO port address
-		if (pGPIOx == GPIOA)
-			GPIOA_PCLK_DI();
-		else if (pGPIOx == GPIOB)
-			GPIOB_PCLK_DI();
-		else if (pGPIOx == GPIOC)
-			GPIOC_PCLK_DI();
-		else if (pGPIOx == GPIOD)
-			GPIOD_PCLK_DI();
-		else if (pGPIOx == GPIOE)
-			GPIOE_PCLK_DI();
-		else if (pGPIOx == GPIOF)
-			GPIOF_PCLK_DI();
-		else if (pGPIOx == GPIOG)
-			GPIOG_PCLK_DI();
-		else if (pGPIOx == GPIOH)
-			GPIOH_PCLK_DI();
-		else if (pGPIOx == GPIOI)
-			GPIOI_PCLK_DI();
-	}
+	Clk_Control(pGPIOx, EnorDi);
 }
 
 /**************************************************************************
@@ -91,7 +48,8 @@ void GPIO_Init(GPIO_Handle_t *pGPIOHandle)
 
 	// In every peripheral initialization, enable the clock here itself.
 	// So that user does not need to it explicitly.
-	GPIO_PeriClockControl(pGPIOHandle->pGPIOx, ENABLE);
+	// Not a reference: GPIO_PeriClockControl(DISABLE) still gates it.
+	Clk_Ensure(pGPIOHandle->pGPIOx);
 
 	/************************************************************************
 	 * 1. Configure the mode of the GPIO pin (MODER)
@@ -135,12 +93,12 @@ void GPIO_Init(GPIO_Handle_t *pGPIOHandle)
 		// Send base address of GPIO peripheral and let macro return the GPIO port code.
 		uint8_t portcode = GPIO_BASEADDR_TO_CODE(pGPIOHandle->pGPIOx);
 		//Before configuring the SYSCFG register, you have to enable the clock.
-		SYSCFG_PCLK_EN();
+		Clk_Ensure(SYSCFG);
 		//Configure EXTI control register number and refer to section with port code.
 		SYSCFG->EXTICR[temp1] = portcode << (temp2 * 4);
 
-/*		//3. Enable the exti interrupt delivery (on EXTI line corresponding to pin number provided) using IMR
-		EXTI->IMR |= 1 << pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber;*/
+		//3. Enable the exti interrupt delivery (on EXTI line corresponding to pin number provided) using IMR
+		EXTI->IMR |= 1 << pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber;
 	}
 
 	temp = 0;
@@ -207,26 +165,7 @@ void GPIO_Init(GPIO_Handle_t *pGPIOHandle)
  ****************************************************************************/
 void GPIO_DeInit(GPIO_RegDef_t *pGPIOx)
 {
-
-	// reset for given GPIO port address
-	if (pGPIOx == GPIOA)
-		GPIOA_REG_RESET();
-	else if (pGPIOx == GPIOB)
-		GPIOB_REG_RESET();
-	else if (pGPIOx == GPIOC)
-		GPIOC_REG_RESET();
-	else if (pGPIOx == GPIOD)
-		GPIOD_REG_RESET();
-	else if (pGPIOx == GPIOE)
-		GPIOE_REG_RESET();
-	else if (pGPIOx == GPIOF)
-		GPIOF_REG_RESET();
-	else if (pGPIOx == GPIOG)
-		GPIOG_REG_RESET();
-	else if (pGPIOx == GPIOH)
-		GPIOH_REG_RESET();
-	else if (pGPIOx == GPIOI)
-		GPIOI_REG_RESET();
+	Periph_Reset(pGPIOx);
 }
 
 /**************************************************************************
@@ -372,24 +311,7 @@ void GPIO_ToggleOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber)
  ****************************************************************************/
 void GPIO_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
 {
-	if(EnorDi == ENABLE)
-	{
-		// find out in what range the IRM number actually lies
-		// There are 81 IRQ numbers implemented
-		if(IRQNumber <= 31)
-		{
-			//program ISER0 register
-			*NVIC_ICER0 |= (1 << IRQNumber); // dereference and put value
-		} else if(IRQNumber > 31 && IRQNumber < 64) // 32 to 63
-		{
-			//program ISER1 register
-			*NVIC_ICER1 |= (1 << IRQNumber % 32); // dereference and put value
-		} else if(IRQNumber >= 64 && IRQNumber < 96) // 64 to 95
-		{
-			//program ISER2 register
-			*NVIC_ICER2 |= (1 << IRQNumber % 64); // dereference and put value
-		}
-	}
+	NVIC_IRQInterruptConfig(IRQNumber, EnorDi);
 }
 /**************************************************************************
  * Priority Configuration
@@ -408,54 +330,62 @@ void GPIO_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
  ****************************************************************************/
 void GPIO_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority)
 {
-	// first lets find out the ipr register
-	uint8_t iprx = IRQNumber/4;
-	uint8_t iprx_section = IRQNumber%4;
-
-	// The whole register is 32 bits, so that's why the next register will be 404.
-	// So we multiply by 4.
-	// iprx * 4
-	//
-	// IPR1 -> xx404		IRQ3_PRI | IRQ2_PRI | IRQ1_PRI | IRQ0_PRI
-	// IPR0 -> xx400
-
-	// IRQ0_PRI is 8 bits
-	// lower 4 bits are not implemented for every priority field
-	// top 4 bits are implemented
-
-	// 8 multiplied by this section plus number of priority bits implemented
-	uint8_t shift_amount = (8 * iprx_section) + (8 - NO_PR_BITS_IMPLEMENTED);
-
-	// jumps to iprx's address
-	// shift priority value by shift amount
-	*(NVIC_PR_BASE_ADDR + (iprx *4)) |= (IRQPriority << shift_amount);
+	NVIC_IRQPriorityConfig(IRQNumber, IRQPriority);
 }
 
 /**************************************************************************
  * Interrupt Handling
  * ************************************************************************
- * @fn			- GPIO_IRQConfig
+ * @fn			- GPIO_IRQHandling
  *
- * @brief		- The ISRs for various IRQ numbers are already implemented.
- * 				- These ISRs are attributed as "weak ISRs". It is your responsibility
- * 				- to override the ISRs in your application.
+ * @brief		- Call this from the EXTIx_IRQHandler for each pin served by
+ * 				  the handler. Clears the pending bit of the EXTI line and
+ * 				  reports it through GPIO_ApplicationEventCallback.
  *
- * @param[in]	-
+ * @param[in]	- pin number (EXTI line)
  * @param[in]	-
  * @param[in]	-
  *
  * @return		- none
  *
- * @Note		- none
+ * @Note		- Only the line of this pin is cleared, the other lines of
+ * 				  a shared handler (EXTI9_5, EXTI15_10) stay pending.
  ****************************************************************************/
 void GPIO_IRQHandling(uint8_t PinNumber)
 {
+	PROF_ISR_BEGIN();
+
 	// clear the exti pr register corresponding to the pin number
 	// if the PR bit position corresponding to this pin number is set, then
 	// interrupt is pending
 	if(EXTI->PR & (1 << PinNumber))
 	{
-		// clear pending register by writing '1'
-		EXTI->PR |= (1 << PinNumber);
+		// clear pending register by writing '1' (writing 0 has no effect,
+		// a read-modify-write would clear every pending line)
+		EXTI->PR = (1 << PinNumber);
+		GPIO_ApplicationEventCallback(PinNumber);
 	}
+
+	PROF_ISR_END();
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- GPIO_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it,
+ * 				  e.g. to post an event to the scheduler.
+ *
+ * @param[in]	- pin number (EXTI line) which triggered
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Called from interrupt handlers.
+ ****************************************************************************/
+__attribute__((weak)) void GPIO_ApplicationEventCallback(uint8_t PinNumber)
+{
+	(void)PinNumber;
 }
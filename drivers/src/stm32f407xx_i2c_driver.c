@@ -0,0 +1,1146 @@
+// In driver.c, you have to include respective peripheral's driver file.
+#include <stddef.h>
+#include "stm32f407xx_i2c_driver.h"
+
+/*
+ * Helper functions (private to this driver)
+ */
+static void I2C_GenerateStartCondition(I2C_RegDef_t *pI2Cx);
+static void I2C_ClearADDRFlag(I2C_RegDef_t *pI2Cx);
+static uint8_t I2C_Header10Bit(uint16_t SlaveAddr, uint8_t Read);
+static void I2C_MasterAddressWrite(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr);
+static void I2C_MasterAddressRead(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr);
+static void I2C_MasterHandleSBInterrupt(I2C_Handle_t *pI2CHandle);
+static void I2C_MasterHandleADDRInterrupt(I2C_Handle_t *pI2CHandle);
+static void I2C_MasterHandleTXEInterrupt(I2C_Handle_t *pI2CHandle);
+static void I2C_MasterHandleRXNEInterrupt(I2C_Handle_t *pI2CHandle);
+static void I2C_MasterHandleBTFInterrupt(I2C_Handle_t *pI2CHandle);
+static void I2C_StartReadPhase(I2C_Handle_t *pI2CHandle);
+static void I2C_DMAConfig(I2C_Handle_t *pI2CHandle);
+static void I2C_TxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+static void I2C_RxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+
+/**********************************************************************
+ * Peripheral Clock setup
+ * (Peripheral Control API)
+ * ********************************************************************
+ * @fn			- I2C_PeriClockControl
+ *
+ * @brief		- This function enables or disables peripheral clock
+ * 				  for the given I2C
+ *
+ * @param[in]	- base address of the I2C peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Reference counted by the clock manager: the clock goes
+ * 				  off with the last DISABLE, see stm32f407xx_clk.h
+ ***********************************************************************/
+void I2C_PeriClockControl(I2C_RegDef_t *pI2Cx, uint8_t EnorDi)
+{
+	Clk_Control(pI2Cx, EnorDi);
+}
+
+/**************************************************************************
+ * Initialize I2C
+ * ************************************************************************
+ * @fn			- I2C_Init
+ *
+ * @brief		- To configure the bus timing from the APB1 clock, the own
+ * 				  address and the TX/RX DMA streams of the I2C.
+ *
+ * 				  Standard mode:	T_high = T_low = CCR * T_pclk1
+ * 				  Fast mode DUTY=0:	T_low = 2 * T_high = 2 * CCR * T_pclk1
+ * 				  Fast mode DUTY=1:	9 * T_low = 16 * T_high = 144 * CCR * T_pclk1
+ * 				  TRISE = max rise time (1000 ns SM, 300 ns FM) / T_pclk1 + 1
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- The I2C is left disabled, call I2C_PeripheralControl.
+ * 				  PCLK1 must be a whole number of MHz between 2 and 42
+ * 				  (4 MHz minimum for fast mode).
+ * 				  The SCL/SDA pins are GPIO_MODE_ALTFN, open drain.
+ ****************************************************************************/
+void I2C_Init(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint32_t tempreg = 0;
+	uint32_t pclk1, scl_div;
+	uint16_t ccr_value;
+
+	Clk_Ensure(pI2Cx);
+
+	// PE must be 0 while the timing registers are written
+	pI2Cx->CR1 &= ~(1 << I2C_CR1_PE);
+
+	/************************************************************************
+	 * 1. Configure CR2 (APB1 frequency in MHz)
+	 ************************************************************************/
+	pclk1 = RCC_GetPCLK1Value();
+	tempreg = (pclk1 / 1000000U) & 0x3F;
+	pI2Cx->CR2 = tempreg << I2C_CR2_FREQ;
+
+	/************************************************************************
+	 * 2. Configure OAR1 (own address, used when addressed as slave)
+	 ************************************************************************/
+	if(pI2CHandle->I2C_Config.I2C_AddrMode == I2C_ADDR_MODE_10BIT)
+	{
+		tempreg = (pI2CHandle->I2C_Config.I2C_DeviceAddress & 0x3FF) << I2C_OAR1_ADD0;
+		tempreg |= (1 << I2C_OAR1_ADDMODE);
+	} else
+	{
+		tempreg = (pI2CHandle->I2C_Config.I2C_DeviceAddress & 0x7F) << I2C_OAR1_ADD71;
+	}
+	// bit 14 should always be kept at 1 by software (RM0090)
+	tempreg |= (1 << 14);
+	pI2Cx->OAR1 = tempreg;
+
+	/************************************************************************
+	 * 3. Configure CCR (SCL speed)
+	 * CCR is rounded up: SCL may be slower than asked, never faster.
+	 ************************************************************************/
+	tempreg = 0;
+	if(pI2CHandle->I2C_Config.I2C_SCLSpeed <= I2C_SCL_SPEED_SM)
+	{
+		// standard mode
+		scl_div = 2 * pI2CHandle->I2C_Config.I2C_SCLSpeed;
+		ccr_value = ((pclk1 + scl_div - 1) / scl_div);
+		if(ccr_value < 4)
+			ccr_value = 4;
+		tempreg |= (ccr_value & 0xFFF);
+	} else
+	{
+		// fast mode
+		tempreg |= (1 << I2C_CCR_FS);
+		tempreg |= (pI2CHandle->I2C_Config.I2C_FMDutyCycle << I2C_CCR_DUTY);
+		if(pI2CHandle->I2C_Config.I2C_FMDutyCycle == I2C_FM_DUTY_2)
+		{
+			scl_div = 3 * pI2CHandle->I2C_Config.I2C_SCLSpeed;
+		} else
+		{
+			scl_div = 25 * pI2CHandle->I2C_Config.I2C_SCLSpeed;
+		}
+		ccr_value = ((pclk1 + scl_div - 1) / scl_div);
+		if(ccr_value < 1)
+			ccr_value = 1;
+		tempreg |= (ccr_value & 0xFFF);
+	}
+	pI2Cx->CCR = tempreg;
+
+	/************************************************************************
+	 * 4. Configure TRISE
+	 ************************************************************************/
+	if(pI2CHandle->I2C_Config.I2C_SCLSpeed <= I2C_SCL_SPEED_SM)
+	{
+		tempreg = (pclk1 / 1000000U) + 1;
+	} else
+	{
+		tempreg = (((pclk1 / 1000000U) * 300) / 1000U) + 1;
+	}
+	pI2Cx->TRISE = (tempreg & 0x3F);
+
+	/************************************************************************
+	 * 5. DMA streams of this I2C
+	 ************************************************************************/
+	pI2CHandle->TxRxState = I2C_READY;
+	pI2CHandle->UseDMA = RESET;
+	I2C_DMAConfig(pI2CHandle);
+}
+
+/**************************************************************************
+ * Deinitialize I2C
+ * ************************************************************************
+ * @fn			- I2C_DeInit
+ *
+ * @brief		- Resets all registers of the I2C with the RCC reset register.
+ *
+ * @param[in]	- base address of the I2C peripheral
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void I2C_DeInit(I2C_RegDef_t *pI2Cx)
+{
+	Periph_Reset(pI2Cx);
+}
+
+/**************************************************************************
+ * Master send data (blocking)
+ * ************************************************************************
+ * @fn			- I2C_MasterSendData
+ *
+ * @brief		- START, address (write), data bytes, then STOP unless a
+ * 				  repeated start is requested.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the data, number of bytes
+ * @param[in]	- slave address (7 or 10 bit, see I2C_AddrMode), I2C_ENABLE_SR
+ * 				  to keep the bus for a following transfer
+ *
+ * @return		- none
+ *
+ * @Note		- This is a blocking call. A NACK from the slave is not
+ * 				  detected here, use the IT/DMA APIs for that.
+ ****************************************************************************/
+void I2C_MasterSendData(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint16_t SlaveAddr, uint8_t Sr)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	// 1. Generate the START condition and confirm it (SB is cleared by the address write)
+	I2C_GenerateStartCondition(pI2Cx);
+	while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_SB));
+
+	// 2. Address phase with the r/w bit set to write (0)
+	I2C_MasterAddressWrite(pI2CHandle, SlaveAddr);
+
+	// 3. Address phase is completed when ADDR is set, clear it to release SCL
+	while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_ADDR));
+	I2C_ClearADDRFlag(pI2Cx);
+
+	// 4. Send the data until Len becomes 0
+	while(Len > 0)
+	{
+		while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_TXE));
+		pI2Cx->DR = *pTxBuffer;
+		pTxBuffer++;
+		Len--;
+	}
+
+	// 5. Wait for TXE=1 and BTF=1: the last byte is out, SCL is stretched
+	while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_TXE));
+	while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_BTF));
+
+	// 6. Generate the STOP condition (this also clears BTF)
+	if(Sr == I2C_DISABLE_SR)
+		I2C_GenerateStopCondition(pI2Cx);
+}
+
+/**************************************************************************
+ * Master receive data (blocking)
+ * ************************************************************************
+ * @fn			- I2C_MasterReceiveData
+ *
+ * @brief		- START, address (read), data bytes, then STOP unless a
+ * 				  repeated start is requested.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the receive buffer, number of bytes
+ * @param[in]	- slave address, I2C_ENABLE_SR to keep the bus
+ *
+ * @return		- none
+ *
+ * @Note		- This is a blocking call.
+ ****************************************************************************/
+void I2C_MasterReceiveData(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint16_t SlaveAddr, uint8_t Sr)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	if(Len == 0)
+		return;
+
+	// 1. Generate the START condition and confirm it
+	I2C_GenerateStartCondition(pI2Cx);
+	while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_SB));
+
+	// 2. Address phase with the r/w bit set to read (1)
+	I2C_MasterAddressRead(pI2CHandle, SlaveAddr);
+
+	// 3. Wait until the address phase is completed
+	while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_ADDR));
+
+	if(Len == 1)
+	{
+		// NACK the only byte before releasing SCL
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+		I2C_ClearADDRFlag(pI2Cx);
+
+		if(Sr == I2C_DISABLE_SR)
+			I2C_GenerateStopCondition(pI2Cx);
+
+		while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_RXNE));
+		*pRxBuffer = pI2Cx->DR;
+	} else
+	{
+		I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+		I2C_ClearADDRFlag(pI2Cx);
+
+		for(uint32_t i = Len; i > 0; i--)
+		{
+			while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_RXNE));
+
+			if(i == 2)
+			{
+				// last 2 bytes remaining: NACK the last one and stop after it
+				I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+				if(Sr == I2C_DISABLE_SR)
+					I2C_GenerateStopCondition(pI2Cx);
+			}
+
+			*pRxBuffer = pI2Cx->DR;
+			pRxBuffer++;
+		}
+	}
+
+	// re-enable ACKing
+	if(pI2CHandle->I2C_Config.I2C_AckControl == I2C_ACK_ENABLE)
+		I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+}
+
+/**************************************************************************
+ * Master send data (interrupt)
+ * ************************************************************************
+ * @fn			- I2C_MasterSendDataIT
+ *
+ * @brief		- Starts a write transfer and returns. The transfer is
+ * 				  completed by I2C_EV_IRQHandling, I2C_EV_TX_CMPLT is
+ * 				  reported to the application callback.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the data (must stay valid until complete), length
+ * @param[in]	- slave address, I2C_ENABLE_SR to keep the bus
+ *
+ * @return		- state before the call, I2C_READY means it was accepted
+ *
+ * @Note		- none
+ ****************************************************************************/
+uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint16_t SlaveAddr, uint8_t Sr)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if((busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
+	{
+		pI2CHandle->pTxBuffer = pTxBuffer;
+		pI2CHandle->TxLen = Len;
+		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = Sr;
+		pI2CHandle->ReadAfterWrite = RESET;
+		pI2CHandle->Addr10ReadPhase = RESET;
+		pI2CHandle->UseDMA = RESET;
+
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITBUFEN);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+/**************************************************************************
+ * Master receive data (interrupt)
+ * ************************************************************************
+ * @fn			- I2C_MasterReceiveDataIT
+ *
+ * @brief		- Starts a read transfer and returns. I2C_EV_RX_CMPLT is
+ * 				  reported when all bytes are in the buffer.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the receive buffer, number of bytes
+ * @param[in]	- slave address, I2C_ENABLE_SR to keep the bus
+ *
+ * @return		- state before the call, I2C_READY means it was accepted
+ *
+ * @Note		- none
+ ****************************************************************************/
+uint8_t I2C_MasterReceiveDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint16_t SlaveAddr, uint8_t Sr)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if((busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX) && Len > 0)
+	{
+		pI2CHandle->pRxBuffer = pRxBuffer;
+		pI2CHandle->RxLen = Len;
+		pI2CHandle->RxSize = Len;
+		pI2CHandle->TxRxState = I2C_BUSY_IN_RX;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = Sr;
+		pI2CHandle->ReadAfterWrite = RESET;
+		pI2CHandle->Addr10ReadPhase = RESET;
+		pI2CHandle->UseDMA = RESET;
+
+		I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_ENABLE);
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITBUFEN);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+/**************************************************************************
+ * Master write then read (interrupt)
+ * ************************************************************************
+ * @fn			- I2C_MasterWriteReadIT
+ *
+ * @brief		- One bus transaction:
+ * 				  START, address (W), TX bytes, repeated START,
+ * 				  address (R), RX bytes, STOP.
+ * 				  Typical use: register address in pTxBuffer, register
+ * 				  contents read into pRxBuffer.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- TX buffer and length (at least 1 byte)
+ * @param[in]	- RX buffer and length (at least 1 byte)
+ * @param[in]	- slave address
+ *
+ * @return		- state before the call, I2C_READY means it was accepted
+ *
+ * @Note		- Only I2C_EV_RX_CMPLT is reported, at the end of the read.
+ ****************************************************************************/
+uint8_t I2C_MasterWriteReadIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t TxLen, uint8_t *pRxBuffer, uint32_t RxLen, uint16_t SlaveAddr)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if((busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX) && TxLen > 0 && RxLen > 0)
+	{
+		pI2CHandle->pTxBuffer = pTxBuffer;
+		pI2CHandle->TxLen = TxLen;
+		pI2CHandle->pRxBuffer = pRxBuffer;
+		pI2CHandle->RxLen = RxLen;
+		pI2CHandle->RxSize = RxLen;
+		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = I2C_DISABLE_SR;
+		pI2CHandle->ReadAfterWrite = SET;
+		pI2CHandle->Addr10ReadPhase = RESET;
+		pI2CHandle->UseDMA = RESET;
+
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITBUFEN);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+/**************************************************************************
+ * Master write then read (DMA)
+ * ************************************************************************
+ * @fn			- I2C_MasterWriteReadDMA
+ *
+ * @brief		- Same transaction as I2C_MasterWriteReadIT, but the data
+ * 				  bytes are moved by the TX/RX DMA streams. The event
+ * 				  interrupt only runs for START, address and the phase
+ * 				  switch, not once per byte.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- TX buffer and length (1..65535)
+ * @param[in]	- RX buffer and length (1..65535)
+ * @param[in]	- slave address
+ *
+ * @return		- state before the call, I2C_READY means it was accepted
+ *
+ * @Note		- Enable the IRQs of both DMA streams and call
+ * 				  DMA_IRQHandling(&handle.TxDMA) / (&handle.RxDMA) from
+ * 				  their handlers. A 1 byte read is done in interrupt mode,
+ * 				  the DMA end of transfer (LAST) needs at least 2 bytes.
+ ****************************************************************************/
+uint8_t I2C_MasterWriteReadDMA(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t TxLen, uint8_t *pRxBuffer, uint32_t RxLen, uint16_t SlaveAddr)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if((busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX) && TxLen > 0 && TxLen <= 0xFFFF && RxLen > 0 && RxLen <= 0xFFFF)
+	{
+		pI2CHandle->pTxBuffer = pTxBuffer;
+		pI2CHandle->TxLen = TxLen;
+		pI2CHandle->pRxBuffer = pRxBuffer;
+		pI2CHandle->RxLen = RxLen;
+		pI2CHandle->RxSize = RxLen;
+		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = I2C_DISABLE_SR;
+		pI2CHandle->ReadAfterWrite = SET;
+		pI2CHandle->Addr10ReadPhase = RESET;
+		pI2CHandle->UseDMA = SET;
+
+		// The TX stream waits for the first TXE after the address phase.
+		DMA_Start(&pI2CHandle->TxDMA, (uint32_t)&pI2CHandle->pI2Cx->DR, (uint32_t)pTxBuffer, (uint16_t)TxLen);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_DMAEN);
+
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		// no ITBUFEN: TXE/RXNE are served by the DMA
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+/**************************************************************************
+ * Close the reception
+ * ************************************************************************
+ * @fn			- I2C_CloseReceiveData
+ *
+ * @brief		- Disables the event interrupts and the DMA requests, and
+ * 				  returns the handle to I2C_READY.
+ *
+ * @param[in]	- pointer to the handle structure
+ ****************************************************************************/
+void I2C_CloseReceiveData(I2C_Handle_t *pI2CHandle)
+{
+	pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITBUFEN);
+	pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITEVTEN);
+	pI2CHandle->pI2Cx->CR2 &= ~((1 << I2C_CR2_DMAEN) | (1 << I2C_CR2_LAST));
+
+	if(pI2CHandle->UseDMA && DMA_IsEnabled(&pI2CHandle->RxDMA))
+		DMA_Stop(&pI2CHandle->RxDMA);
+
+	pI2CHandle->TxRxState = I2C_READY;
+	pI2CHandle->pRxBuffer = NULL;
+	pI2CHandle->RxLen = 0;
+	pI2CHandle->RxSize = 0;
+	pI2CHandle->ReadAfterWrite = RESET;
+	pI2CHandle->UseDMA = RESET;
+
+	if(pI2CHandle->I2C_Config.I2C_AckControl == I2C_ACK_ENABLE)
+		I2C_ManageAcking(pI2CHandle->pI2Cx, ENABLE);
+}
+
+/**************************************************************************
+ * Close the transmission
+ * ************************************************************************
+ * @fn			- I2C_CloseSendData
+ *
+ * @brief		- Disables the event interrupts and the DMA requests, and
+ * 				  returns the handle to I2C_READY.
+ *
+ * @param[in]	- pointer to the handle structure
+ ****************************************************************************/
+void I2C_CloseSendData(I2C_Handle_t *pI2CHandle)
+{
+	pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITBUFEN);
+	pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITEVTEN);
+	pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_DMAEN);
+
+	if(pI2CHandle->UseDMA && DMA_IsEnabled(&pI2CHandle->TxDMA))
+		DMA_Stop(&pI2CHandle->TxDMA);
+
+	pI2CHandle->TxRxState = I2C_READY;
+	pI2CHandle->pTxBuffer = NULL;
+	pI2CHandle->TxLen = 0;
+	pI2CHandle->ReadAfterWrite = RESET;
+	pI2CHandle->UseDMA = RESET;
+}
+
+/**************************************************************************
+ * IRQ Configuration
+ * ************************************************************************
+ * @fn			- I2C_IRQInterruptConfig
+ *
+ * @brief		- All of the configuration in this API is processor specific.
+ *
+ * @param[in]	- IRQ number (IRQ_NO_I2Cx_EV and IRQ_NO_I2Cx_ER)
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void I2C_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	NVIC_IRQInterruptConfig(IRQNumber, EnorDi);
+}
+
+/**************************************************************************
+ * Priority Configuration
+ * ************************************************************************
+ * @fn			- I2C_IRQPriorityConfig
+ *
+ * @brief		- Sets the priority field of the given IRQ number.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- priority (NVIC_IRQ_PRIx)
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void I2C_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority)
+{
+	NVIC_IRQPriorityConfig(IRQNumber, IRQPriority);
+}
+
+/**************************************************************************
+ * Event Interrupt Handling
+ * ************************************************************************
+ * @fn			- I2C_EV_IRQHandling
+ *
+ * @brief		- Call this from the I2Cx_EV_IRQHandler.
+ * 				  Master state machine:
+ * 				  SB -> address (header for 10 bit) -> [ADD10 -> address
+ * 				  byte] -> ADDR -> TXE/RXNE data -> BTF -> STOP, or a
+ * 				  repeated START into the read phase of a write-read.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
+{
+	PROF_ISR_BEGIN();
+
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint32_t temp1, temp2, temp3;
+
+	temp1 = pI2Cx->CR2 & (1 << I2C_CR2_ITEVTEN);
+	temp2 = pI2Cx->CR2 & (1 << I2C_CR2_ITBUFEN);
+
+	// 1. Handle for interrupt generated by SB event (master mode only)
+	temp3 = pI2Cx->SR1 & (1 << I2C_SR1_SB);
+	if(temp1 && temp3)
+	{
+		I2C_MasterHandleSBInterrupt(pI2CHandle);
+	}
+
+	// 2. Handle for interrupt generated by ADD10 event (10-bit header sent)
+	temp3 = pI2Cx->SR1 & (1 << I2C_SR1_ADD10);
+	if(temp1 && temp3)
+	{
+		// writing the second address byte clears ADD10
+		pI2Cx->DR = (uint8_t)(pI2CHandle->DevAddr & 0xFF);
+	}
+
+	// 3. Handle for interrupt generated by ADDR event
+	temp3 = pI2Cx->SR1 & (1 << I2C_SR1_ADDR);
+	if(temp1 && temp3)
+	{
+		I2C_MasterHandleADDRInterrupt(pI2CHandle);
+	}
+
+	// 4. Handle for interrupt generated by BTF (Byte Transfer Finished) event
+	temp3 = pI2Cx->SR1 & (1 << I2C_SR1_BTF);
+	if(temp1 && temp3)
+	{
+		I2C_MasterHandleBTFInterrupt(pI2CHandle);
+	}
+
+	// 5. Handle for interrupt generated by TXE event
+	temp3 = pI2Cx->SR1 & (1 << I2C_SR1_TXE);
+	if(temp1 && temp2 && temp3)
+	{
+		if(pI2Cx->SR2 & (1 << I2C_SR2_MSL))
+			I2C_MasterHandleTXEInterrupt(pI2CHandle);
+	}
+
+	// 6. Handle for interrupt generated by RXNE event
+	temp3 = pI2Cx->SR1 & (1 << I2C_SR1_RXNE);
+	if(temp1 && temp2 && temp3)
+	{
+		if(pI2CHandle->TxRxState == I2C_BUSY_IN_RX)
+			I2C_MasterHandleRXNEInterrupt(pI2CHandle);
+	}
+
+	PROF_ISR_END();
+}
+
+/**************************************************************************
+ * Error Interrupt Handling
+ * ************************************************************************
+ * @fn			- I2C_ER_IRQHandling
+ *
+ * @brief		- Call this from the I2Cx_ER_IRQHandler.
+ * 				  Clears the error flags and reports them. Bus error,
+ * 				  arbitration lost and NACK abort the running transfer so
+ * 				  the handle is ready for the next one.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
+{
+	PROF_ISR_BEGIN();
+
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint32_t temp1, temp2;
+
+	// Know the status of ITERREN control bit in the CR2
+	temp2 = (pI2Cx->CR2) & (1 << I2C_CR2_ITERREN);
+
+	/***********************Check for Bus error************************************/
+	temp1 = (pI2Cx->SR1) & (1 << I2C_SR1_BERR);
+	if(temp1 && temp2)
+	{
+		// This is Bus error, clear the bus error flag
+		pI2Cx->SR1 &= ~(1 << I2C_SR1_BERR);
+		I2C_CloseSendData(pI2CHandle);
+		I2C_CloseReceiveData(pI2CHandle);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_ERROR_BERR);
+	}
+
+	/***********************Check for arbitration lost error************************************/
+	temp1 = (pI2Cx->SR1) & (1 << I2C_SR1_ARLO);
+	if(temp1 && temp2)
+	{
+		// the interface is back in slave mode, no STOP to send
+		pI2Cx->SR1 &= ~(1 << I2C_SR1_ARLO);
+		I2C_CloseSendData(pI2CHandle);
+		I2C_CloseReceiveData(pI2CHandle);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_ERROR_ARLO);
+	}
+
+	/***********************Check for ACK failure error************************************/
+	temp1 = (pI2Cx->SR1) & (1 << I2C_SR1_AF);
+	if(temp1 && temp2)
+	{
+		// address or data NACKed by the slave: release the bus
+		pI2Cx->SR1 &= ~(1 << I2C_SR1_AF);
+		I2C_GenerateStopCondition(pI2Cx);
+		I2C_CloseSendData(pI2CHandle);
+		I2C_CloseReceiveData(pI2CHandle);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_ERROR_AF);
+	}
+
+	/***********************Check for Overrun/underrun error************************************/
+	temp1 = (pI2Cx->SR1) & (1 << I2C_SR1_OVR);
+	if(temp1 && temp2)
+	{
+		pI2Cx->SR1 &= ~(1 << I2C_SR1_OVR);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_ERROR_OVR);
+	}
+
+	/***********************Check for Time out error************************************/
+	temp1 = (pI2Cx->SR1) & (1 << I2C_SR1_TIMEOUT);
+	if(temp1 && temp2)
+	{
+		pI2Cx->SR1 &= ~(1 << I2C_SR1_TIMEOUT);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_ERROR_TIMEOUT);
+	}
+
+	PROF_ISR_END();
+}
+
+/**************************************************************************
+ * Enable or disable the I2C
+ * ************************************************************************
+ * @fn			- I2C_PeripheralControl
+ *
+ * @brief		- Sets or clears PE.
+ *
+ * @param[in]	- base address of the I2C peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ *
+ * @Note		- ACK is cleared by hardware while PE=0, call
+ * 				  I2C_ManageAcking after enabling the peripheral.
+ ****************************************************************************/
+void I2C_PeripheralControl(I2C_RegDef_t *pI2Cx, uint8_t EnOrDi)
+{
+	if(EnOrDi == ENABLE)
+	{
+		pI2Cx->CR1 |= (1 << I2C_CR1_PE);
+	} else
+	{
+		pI2Cx->CR1 &= ~(1 << I2C_CR1_PE);
+	}
+}
+
+/**************************************************************************
+ * Flag status
+ * ************************************************************************
+ * @fn			- I2C_GetFlagStatus
+ *
+ * @param[in]	- base address of the I2C peripheral
+ * @param[in]	- I2C_FLAG_xxx (SR1 flags)
+ *
+ * @return		- FLAG_SET or FLAG_RESET
+ ****************************************************************************/
+uint8_t I2C_GetFlagStatus(I2C_RegDef_t *pI2Cx, uint32_t FlagName)
+{
+	if(pI2Cx->SR1 & FlagName)
+	{
+		return FLAG_SET;
+	}
+	return FLAG_RESET;
+}
+
+/**************************************************************************
+ * Acking
+ * ************************************************************************
+ * @fn			- I2C_ManageAcking
+ *
+ * @brief		- Sets or clears ACK (acknowledge of received bytes).
+ *
+ * @param[in]	- base address of the I2C peripheral
+ * @param[in]	- I2C_ACK_ENABLE or I2C_ACK_DISABLE
+ ****************************************************************************/
+void I2C_ManageAcking(I2C_RegDef_t *pI2Cx, uint8_t EnorDi)
+{
+	if(EnorDi == I2C_ACK_ENABLE)
+	{
+		pI2Cx->CR1 |= (1 << I2C_CR1_ACK);
+	} else
+	{
+		pI2Cx->CR1 &= ~(1 << I2C_CR1_ACK);
+	}
+}
+
+/**************************************************************************
+ * STOP condition
+ * ************************************************************************
+ * @fn			- I2C_GenerateStopCondition
+ *
+ * @brief		- Requests a STOP after the current byte.
+ *
+ * @param[in]	- base address of the I2C peripheral
+ ****************************************************************************/
+void I2C_GenerateStopCondition(I2C_RegDef_t *pI2Cx)
+{
+	pI2Cx->CR1 |= (1 << I2C_CR1_STOP);
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- I2C_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- I2C_EV_xxx or I2C_ERROR_xxx
+ ****************************************************************************/
+__attribute__((weak)) void I2C_ApplicationEventCallback(I2C_Handle_t *pI2CHandle, uint8_t AppEv)
+{
+	(void)pI2CHandle;
+	(void)AppEv;
+}
+
+static void I2C_GenerateStartCondition(I2C_RegDef_t *pI2Cx)
+{
+	pI2Cx->CR1 |= (1 << I2C_CR1_START);
+}
+
+/*
+ * ADDR is cleared by reading SR1 followed by reading SR2.
+ */
+static void I2C_ClearADDRFlag(I2C_RegDef_t *pI2Cx)
+{
+	uint32_t dummy_read;
+
+	dummy_read = pI2Cx->SR1;
+	dummy_read = pI2Cx->SR2;
+	(void)dummy_read;
+}
+
+/*
+ * 10-bit header: 11110 A9 A8 R/W
+ */
+static uint8_t I2C_Header10Bit(uint16_t SlaveAddr, uint8_t Read)
+{
+	return (uint8_t)(0xF0 | ((SlaveAddr >> 7) & 0x06) | (Read & 1));
+}
+
+/*
+ * Blocking address phase, write direction. Called after SB.
+ */
+static void I2C_MasterAddressWrite(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	if(pI2CHandle->I2C_Config.I2C_AddrMode == I2C_ADDR_MODE_10BIT)
+	{
+		pI2Cx->DR = I2C_Header10Bit(SlaveAddr, 0);
+		while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_ADD10));
+		pI2Cx->DR = (uint8_t)(SlaveAddr & 0xFF);
+	} else
+	{
+		pI2Cx->DR = (uint8_t)(SlaveAddr << 1);
+	}
+}
+
+/*
+ * Blocking address phase, read direction. Called after SB.
+ * A 10-bit read needs the full address in write direction first, then a
+ * repeated START with the header in read direction (RM0090 master receiver).
+ */
+static void I2C_MasterAddressRead(I2C_Handle_t *pI2CHandle, uint16_t SlaveAddr)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	if(pI2CHandle->I2C_Config.I2C_AddrMode == I2C_ADDR_MODE_10BIT)
+	{
+		I2C_MasterAddressWrite(pI2CHandle, SlaveAddr);
+		while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_ADDR));
+		I2C_ClearADDRFlag(pI2Cx);
+
+		I2C_GenerateStartCondition(pI2Cx);
+		while(!I2C_GetFlagStatus(pI2Cx, I2C_FLAG_SB));
+		pI2Cx->DR = I2C_Header10Bit(SlaveAddr, 1);
+	} else
+	{
+		pI2Cx->DR = (uint8_t)((SlaveAddr << 1) | 1);
+	}
+}
+
+/*
+ * START (or repeated START) done: send the address, or the 10-bit header.
+ */
+static void I2C_MasterHandleSBInterrupt(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint16_t addr = pI2CHandle->DevAddr;
+	uint8_t read = (pI2CHandle->TxRxState == I2C_BUSY_IN_RX);
+
+	if(pI2CHandle->I2C_Config.I2C_AddrMode == I2C_ADDR_MODE_10BIT)
+	{
+		// a 10-bit read starts with the write header, see I2C_MasterAddressRead
+		if(read && pI2CHandle->Addr10ReadPhase)
+			pI2Cx->DR = I2C_Header10Bit(addr, 1);
+		else
+			pI2Cx->DR = I2C_Header10Bit(addr, 0);
+	} else
+	{
+		pI2Cx->DR = (uint8_t)((addr << 1) | read);
+	}
+}
+
+static void I2C_MasterHandleADDRInterrupt(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	if(pI2CHandle->TxRxState != I2C_BUSY_IN_RX)
+	{
+		I2C_ClearADDRFlag(pI2Cx);
+		return;
+	}
+
+	if(pI2CHandle->I2C_Config.I2C_AddrMode == I2C_ADDR_MODE_10BIT && !pI2CHandle->Addr10ReadPhase)
+	{
+		// 10-bit address done in write direction, turn around with the read header
+		pI2CHandle->Addr10ReadPhase = SET;
+		I2C_ClearADDRFlag(pI2Cx);
+		I2C_GenerateStartCondition(pI2Cx);
+		return;
+	}
+
+	if(pI2CHandle->RxSize == 1)
+	{
+		// NACK the only byte, and STOP right after it
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+		I2C_ClearADDRFlag(pI2Cx);
+		if(pI2CHandle->Sr == I2C_DISABLE_SR)
+			I2C_GenerateStopCondition(pI2Cx);
+	} else
+	{
+		I2C_ClearADDRFlag(pI2Cx);
+	}
+}
+
+static void I2C_MasterHandleTXEInterrupt(I2C_Handle_t *pI2CHandle)
+{
+	if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX && pI2CHandle->TxLen > 0)
+	{
+		pI2CHandle->pI2Cx->DR = *(pI2CHandle->pTxBuffer);
+		pI2CHandle->TxLen--;
+		pI2CHandle->pTxBuffer++;
+
+		if(pI2CHandle->TxLen == 0)
+		{
+			// no more TXE interrupts, the end of the byte is signalled by BTF
+			pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITBUFEN);
+		}
+	}
+}
+
+static void I2C_MasterHandleRXNEInterrupt(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	if(pI2CHandle->RxLen == 0)
+		return;
+
+	if(pI2CHandle->RxLen == 2)
+	{
+		// byte N-1 is in DR and byte N is on the bus: NACK it and stop after it
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+		if(pI2CHandle->Sr == I2C_DISABLE_SR)
+			I2C_GenerateStopCondition(pI2Cx);
+	}
+
+	*pI2CHandle->pRxBuffer = pI2Cx->DR;
+	pI2CHandle->pRxBuffer++;
+	pI2CHandle->RxLen--;
+
+	if(pI2CHandle->RxLen == 0)
+	{
+		I2C_CloseReceiveData(pI2CHandle);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_RX_CMPLT);
+	}
+}
+
+static void I2C_MasterHandleBTFInterrupt(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	if(pI2CHandle->TxRxState != I2C_BUSY_IN_TX)
+	{
+		// reception: the bytes are taken by RXNE or the RX DMA
+		return;
+	}
+
+	if(pI2CHandle->UseDMA)
+	{
+		// the TX stream may finish before its own interrupt is served
+		pI2CHandle->TxLen = DMA_GetRemaining(&pI2CHandle->TxDMA);
+	}
+
+	// make sure that TXE is also set: the last byte has left the shift register
+	if(pI2CHandle->TxLen != 0 || !(pI2Cx->SR1 & (1 << I2C_SR1_TXE)))
+		return;
+
+	if(pI2CHandle->ReadAfterWrite)
+	{
+		I2C_StartReadPhase(pI2CHandle);
+	} else
+	{
+		// 1. generate the STOP condition (clears BTF)
+		if(pI2CHandle->Sr == I2C_DISABLE_SR)
+			I2C_GenerateStopCondition(pI2Cx);
+
+		// 2. reset all the member elements of the handle structure
+		I2C_CloseSendData(pI2CHandle);
+
+		// 3. notify the application about transmission complete
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_TX_CMPLT);
+	}
+}
+
+/*
+ * Write phase of a write-read is done (BTF): turn the bus around with a
+ * repeated START. The bus stays owned by this master in between.
+ */
+static void I2C_StartReadPhase(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	pI2CHandle->ReadAfterWrite = RESET;
+	pI2CHandle->TxRxState = I2C_BUSY_IN_RX;
+	pI2CHandle->pTxBuffer = NULL;
+
+	// The 10-bit slave is still addressed, the read header alone is enough.
+	pI2CHandle->Addr10ReadPhase = SET;
+
+	I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+
+	if(pI2CHandle->UseDMA && pI2CHandle->RxSize >= 2)
+	{
+		// LAST: the byte before the end of the DMA transfer is NACKed by hardware
+		pI2Cx->CR2 |= (1 << I2C_CR2_LAST);
+		pI2Cx->CR2 |= (1 << I2C_CR2_DMAEN);
+		DMA_Start(&pI2CHandle->RxDMA, (uint32_t)&pI2Cx->DR, (uint32_t)pI2CHandle->pRxBuffer, (uint16_t)pI2CHandle->RxLen);
+	} else
+	{
+		// one byte can not be ended by the DMA, finish in interrupt mode
+		pI2Cx->CR2 &= ~(1 << I2C_CR2_DMAEN);
+		pI2CHandle->UseDMA = RESET;
+		pI2Cx->CR2 |= (1 << I2C_CR2_ITBUFEN);
+	}
+
+	// repeated START, this also clears BTF
+	I2C_GenerateStartCondition(pI2Cx);
+}
+
+/*
+ * Selects the DMA streams of the I2C (RM0090 DMA1 request mapping).
+ * I2C1 TX uses stream 7 because stream 6 is the USART2 TX stream.
+ */
+static void I2C_DMAConfig(I2C_Handle_t *pI2CHandle)
+{
+	const Periph_Instance_t *pInst = Periph_Get(pI2CHandle->pI2Cx);
+	DMA_Handle_t *pTx = &pI2CHandle->TxDMA;
+	DMA_Handle_t *pRx = &pI2CHandle->RxDMA;
+
+	if(pInst == 0)
+		return;
+
+	pTx->pDMAx = pInst->DMATx.pDMAx;
+	pTx->Stream = pInst->DMATx.Stream;
+	pTx->DMAConfig.DMA_Channel = pInst->DMATx.Channel;
+	pRx->pDMAx = pInst->DMARx.pDMAx;
+	pRx->Stream = pInst->DMARx.Stream;
+	pRx->DMAConfig.DMA_Channel = pInst->DMARx.Channel;
+
+	pTx->DMAConfig.DMA_Direction = DMA_DIR_MEM_TO_PERIPH;
+	pTx->DMAConfig.DMA_PeriphInc = DISABLE;
+	pTx->DMAConfig.DMA_MemInc = ENABLE;
+	pTx->DMAConfig.DMA_PeriphDataSize = DMA_SIZE_BYTE;
+	pTx->DMAConfig.DMA_MemDataSize = DMA_SIZE_BYTE;
+	pTx->DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+	pTx->DMAConfig.DMA_Priority = DMA_PRIORITY_MEDIUM;
+	pTx->DMAConfig.DMA_FIFOMode = DMA_FIFO_DIRECT;
+	pTx->pEventCallback = I2C_TxDMAEventCallback;
+	pTx->pParent = pI2CHandle;
+
+	pRx->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+	pRx->DMAConfig.DMA_PeriphInc = DISABLE;
+	pRx->DMAConfig.DMA_MemInc = ENABLE;
+	pRx->DMAConfig.DMA_PeriphDataSize = DMA_SIZE_BYTE;
+	pRx->DMAConfig.DMA_MemDataSize = DMA_SIZE_BYTE;
+	pRx->DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+	pRx->DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH;
+	pRx->DMAConfig.DMA_FIFOMode = DMA_FIFO_DIRECT;
+	pRx->pEventCallback = I2C_RxDMAEventCallback;
+	pRx->pParent = pI2CHandle;
+
+	DMA_Init(pTx);
+	DMA_Init(pRx);
+}
+
+static void I2C_TxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	I2C_Handle_t *pI2CHandle = (I2C_Handle_t*)pDMAHandle->pParent;
+
+	if(AppEv == DMA_EVENT_ERROR)
+	{
+		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		I2C_CloseSendData(pI2CHandle);
+		I2C_CloseReceiveData(pI2CHandle);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_ERROR_DMA);
+	}
+	// DMA_EVENT_CMPLT: nothing to do, the write phase ends with BTF
+}
+
+static void I2C_RxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	I2C_Handle_t *pI2CHandle = (I2C_Handle_t*)pDMAHandle->pParent;
+
+	if(AppEv == DMA_EVENT_ERROR)
+	{
+		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		I2C_CloseReceiveData(pI2CHandle);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_ERROR_DMA);
+	} else if(AppEv == DMA_EVENT_CMPLT && pI2CHandle->TxRxState == I2C_BUSY_IN_RX)
+	{
+		// the last byte was NACKed (LAST), end the transaction
+		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		pI2CHandle->pRxBuffer += pI2CHandle->RxLen;
+		pI2CHandle->RxLen = 0;
+		I2C_CloseReceiveData(pI2CHandle);
+		I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_RX_CMPLT);
+	}
+}
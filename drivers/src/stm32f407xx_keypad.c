@@ -0,0 +1,218 @@
+/*
+ * stm32f407xx_keypad.c
+ *
+ * Key matrix scanner, see stm32f407xx_keypad.h
+ */
+#include <string.h>
+#include "stm32f407xx_keypad.h"
+
+/*
+ * Helper functions
+ */
+static void Keypad_PinInit(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t PinMode, uint8_t OPType, uint8_t PuPd);
+static void Keypad_Debounce(Keypad_Handle_t *pKeypad, uint64_t Raw);
+
+/**************************************************************************
+ * Initialize the scanner
+ * ************************************************************************
+ * @fn			- Keypad_Init
+ *
+ * @brief		- Configures the rows (open-drain, released) and the
+ * 				  columns (inputs with pull-ups) and drives the first row.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- @KEYPAD_RETURN
+ *
+ * @Note		- All keys start released. Start the timer afterwards.
+ ****************************************************************************/
+uint8_t Keypad_Init(Keypad_Handle_t *pKeypad, Keypad_Config_t *pConfig)
+{
+	if(pConfig->Rows > KEYPAD_MAX_ROWS || pConfig->Cols == 0 || pConfig->Cols > KEYPAD_MAX_COLS ||
+	   pConfig->ColPin + pConfig->Cols > 16)
+		return KEYPAD_ERR_PARAM;
+
+	memset(pKeypad, 0, sizeof(*pKeypad));
+	pKeypad->Config = *pConfig;
+	pKeypad->pColIdr = &pConfig->pColPort->IDR;
+	pKeypad->ColMask = (1U << pConfig->Cols) - 1;
+
+	for(uint8_t i = 0; i < pConfig->Cols; i++)
+		Keypad_PinInit(pConfig->pColPort, pConfig->ColPin + i, GPIO_MODE_IN, GPIO_OP_TYPE_PP, GPIO_PIN_PU);
+
+	for(uint8_t r = 0; r < pConfig->Rows; r++)
+	{
+		GPIO_RegDef_t *pGPIOx = pConfig->Row[r].pGPIOx;
+
+		pKeypad->pRowBsrr[r] = &pGPIOx->BSRR;
+		pKeypad->RowBit[r] = 1U << pConfig->Row[r].PinNumber;
+
+		// released before it becomes an output
+		Clk_Ensure(pGPIOx);
+		*pKeypad->pRowBsrr[r] = pKeypad->RowBit[r];
+		Keypad_PinInit(pGPIOx, pConfig->Row[r].PinNumber, GPIO_MODE_OUT, GPIO_OP_TYPE_OD, GPIO_NO_PUPD);
+	}
+	if(pConfig->Rows)
+		*pKeypad->pRowBsrr[0] = pKeypad->RowBit[0] << 16;
+
+	return KEYPAD_OK;
+}
+
+/**************************************************************************
+ * Scan one row
+ * ************************************************************************
+ * @fn			- Keypad_Scan
+ *
+ * @brief		- Reads the columns of the row driven since the last call
+ * 				  and drives the next row. After the last row, debounces
+ * 				  the scan and reports the changes.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- none
+ *
+ * @Note		- Call it at a fixed rate from an interrupt. Without rows
+ * 				  every call is a full scan.
+ ****************************************************************************/
+void Keypad_Scan(Keypad_Handle_t *pKeypad)
+{
+	Keypad_Config_t *pConfig = &pKeypad->Config;
+	uint8_t row = pKeypad->Row;
+	uint32_t cols = ~(*pKeypad->pColIdr >> pConfig->ColPin) & pKeypad->ColMask;
+
+	if(pConfig->Rows == 0)
+	{
+		Keypad_Debounce(pKeypad, cols);
+		return;
+	}
+
+	pKeypad->Raw |= (uint64_t)cols << (row * pConfig->Cols);
+
+	// release this row, drive the next one: it settles until the next call
+	*pKeypad->pRowBsrr[row] = pKeypad->RowBit[row];
+	if(++row == pConfig->Rows)
+		row = 0;
+	*pKeypad->pRowBsrr[row] = pKeypad->RowBit[row] << 16;
+	pKeypad->Row = row;
+
+	if(row == 0)
+	{
+		Keypad_Debounce(pKeypad, pKeypad->Raw);
+		pKeypad->Raw = 0;
+	}
+}
+
+/**************************************************************************
+ * @fn			- Keypad_GetState
+ *
+ * @brief		- Returns the debounced keys, bit Row * Cols + Col.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- bitmap, 1: pressed
+ ****************************************************************************/
+uint64_t Keypad_GetState(Keypad_Handle_t *pKeypad)
+{
+	uint64_t state;
+	uint32_t primask = __get_PRIMASK();
+
+	// 64 bit: two loads, the scan interrupt must not come in between
+	__disable_irq();
+	state = pKeypad->State;
+	__set_PRIMASK(primask);
+
+	return state;
+}
+
+/**************************************************************************
+ * @fn			- Keypad_IsPressed
+ *
+ * @brief		- Tells whether a key is pressed (debounced).
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- key number, Row * Cols + Col
+ *
+ * @return		- 1 if pressed, 0 if not
+ ****************************************************************************/
+uint8_t Keypad_IsPressed(Keypad_Handle_t *pKeypad, uint8_t Key)
+{
+	return (Keypad_GetState(pKeypad) >> Key) & 1;
+}
+
+/**************************************************************************
+ * Timer events
+ * ************************************************************************
+ * @fn			- Keypad_EventHandling
+ *
+ * @brief		- Scans one row on the update event of the keypad's timer.
+ * 				  Other events and timers are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- timer handle of the event
+ * @param[in]	- TIM_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from TIM_ApplicationEventCallback.
+ ****************************************************************************/
+void Keypad_EventHandling(Keypad_Handle_t *pKeypad, TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	if(pTIMHandle == pKeypad->Config.pTIMHandle && AppEv == TIM_EVENT_UPDATE)
+		Keypad_Scan(pKeypad);
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Keypad_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- KEYPAD_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the scan interrupt. Changed & State are the keys
+ * 				  just pressed, Changed & ~State the ones released.
+ ****************************************************************************/
+__attribute__((weak)) void Keypad_ApplicationEventCallback(Keypad_Handle_t *pKeypad, uint8_t AppEv)
+{
+	(void)pKeypad;
+	(void)AppEv;
+}
+
+static void Keypad_PinInit(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t PinMode, uint8_t OPType, uint8_t PuPd)
+{
+	GPIO_Handle_t pin;
+
+	memset(&pin, 0, sizeof(pin));
+	pin.pGPIOx = pGPIOx;
+	pin.GPIO_PinConfig.GPIO_PinNumber = PinNumber;
+	pin.GPIO_PinConfig.GPIO_PinMode = PinMode;
+	pin.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_LOW;
+	pin.GPIO_PinConfig.GPIO_PinOPType = OPType;
+	pin.GPIO_PinConfig.GPIO_PinPuPdControl = PuPd;
+	GPIO_Init(&pin);
+}
+
+/*
+ * Vertical counter: per key a 2 bit counter (Count1:Count0) of the scans
+ * which differ from State, cleared by a scan which does not. The scan
+ * after it reached 3 flips State.
+ */
+static void Keypad_Debounce(Keypad_Handle_t *pKeypad, uint64_t Raw)
+{
+	uint64_t delta = Raw ^ pKeypad->State;
+	uint64_t toggle = delta & pKeypad->Count0 & pKeypad->Count1;
+
+	pKeypad->Count1 = (pKeypad->Count1 ^ pKeypad->Count0) & delta;
+	pKeypad->Count0 = ~pKeypad->Count0 & delta;
+	pKeypad->State ^= toggle;
+	pKeypad->Changed = toggle;
+	pKeypad->Scans++;
+
+	if(toggle)
+		Keypad_ApplicationEventCallback(pKeypad, KEYPAD_EVENT_CHANGED);
+}
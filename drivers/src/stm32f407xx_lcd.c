@@ -0,0 +1,588 @@
+/*
+ * stm32f407xx_lcd.c
+ *
+ * SPI display driver, see stm32f407xx_lcd.h
+ */
+#include <string.h>
+#include "stm32f407xx_lcd.h"
+
+/*
+ * Operations
+ */
+#define LCD_OP_NONE					0
+#define LCD_OP_INIT					1
+#define LCD_OP_FLUSH				2
+
+/*
+ * Operation phases, each one is a DMA transfer (or a wait)
+ */
+#define LCD_PHASE_IDLE				0
+#define LCD_PHASE_CMD				1 // command frame, D/C low
+#define LCD_PHASE_ARGS				2 // its parameters, D/C high
+#define LCD_PHASE_WAIT				3 // init delay, timer running
+#define LCD_PHASE_PIXELS			4 // one pixel block
+
+/*
+ * Window commands of a rectangle
+ */
+#define LCD_STEP_CASET				0
+#define LCD_STEP_RASET				1
+#define LCD_STEP_RAMWR				2
+#define LCD_STEP_PIXELS				3
+
+/*
+ * Init sequences
+ */
+const uint8_t Lcd_ST7789Init[] =
+{
+	7,
+	LCD_CMD_SWRESET, LCD_INIT_DELAY, 150,
+	LCD_CMD_SLPOUT, LCD_INIT_DELAY, 10,
+	LCD_CMD_COLMOD, 1 | LCD_INIT_DELAY, 0x55, 10,		// 16 bit RGB565
+	LCD_CMD_MADCTL, 1, 0x00,
+	LCD_CMD_INVON, LCD_INIT_DELAY, 10,					// IPS panels are inverted
+	LCD_CMD_NORON, LCD_INIT_DELAY, 10,
+	LCD_CMD_DISPON, LCD_INIT_DELAY, 10,
+};
+
+const uint8_t Lcd_ILI9341Init[] =
+{
+	5,
+	LCD_CMD_SWRESET, LCD_INIT_DELAY, 150,
+	LCD_CMD_SLPOUT, LCD_INIT_DELAY, 120,
+	LCD_CMD_COLMOD, 1, 0x55,							// 16 bit RGB565
+	LCD_CMD_MADCTL, 1, 0x48,							// portrait, BGR
+	LCD_CMD_DISPON, LCD_INIT_DELAY, 20,
+};
+
+/*
+ * Helper functions
+ */
+static void Lcd_Select(Lcd_Handle_t *pLcd, uint8_t Selected);
+static void Lcd_DataMode(Lcd_Handle_t *pLcd, uint8_t Data);
+static void Lcd_Exchange(Lcd_Handle_t *pLcd, uint8_t *pTx, uint32_t Len);
+static void Lcd_Command(Lcd_Handle_t *pLcd, uint8_t Cmd, uint8_t *pArgs, uint16_t ArgLen);
+static void Lcd_InitNext(Lcd_Handle_t *pLcd);
+static void Lcd_StartRect(Lcd_Handle_t *pLcd);
+static void Lcd_WindowNext(Lcd_Handle_t *pLcd);
+static void Lcd_Queue(Lcd_Handle_t *pLcd, uint8_t Block);
+static void Lcd_SendBlock(Lcd_Handle_t *pLcd);
+static void Lcd_BlockDone(Lcd_Handle_t *pLcd);
+static uint8_t Lcd_Clip(Lcd_Handle_t *pLcd, Lcd_Rect_t *pRect);
+static void Lcd_AddRect(Lcd_Handle_t *pLcd, Lcd_Rect_t Rect);
+static Lcd_Rect_t Lcd_Union(const Lcd_Rect_t *pA, const Lcd_Rect_t *pB);
+static uint32_t Lcd_Area(const Lcd_Rect_t *pRect);
+static void Lcd_Finish(Lcd_Handle_t *pLcd, uint8_t AppEv);
+static void Lcd_TimerHandler(uint32_t Arg);
+static void Lcd_EmptyFlushHandler(uint32_t Arg);
+
+/**************************************************************************
+ * Initialize a display handle
+ * ************************************************************************
+ * @fn			- Lcd_Init
+ *
+ * @brief		- Copies the configuration, switches the SPI to 8 bit frames
+ * 				  and starts sending the init sequence.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- @LCD_RETURN
+ *
+ * @Note		- LCD_EVENT_INIT_CMPLT, the SPI is in 16 bit frames then.
+ * 				  Call after Sched_Init. The framebuffer is not cleared and
+ * 				  nothing is invalidated.
+ ****************************************************************************/
+uint8_t Lcd_Init(Lcd_Handle_t *pLcd, Lcd_Config_t *pConfig)
+{
+	if(pConfig->pFrameBuffer == 0 || pConfig->pInitSeq == 0 || pConfig->Width == 0 ||
+	   pConfig->Height == 0 || pConfig->Width > LCD_STAGE_PIXELS)
+		return LCD_ERR_PARAM;
+
+	memset(pLcd, 0, sizeof(*pLcd));
+	pLcd->Config = *pConfig;
+	if(pLcd->Config.Lcd_MsPerTick == 0)
+		pLcd->Config.Lcd_MsPerTick = 1;
+
+	Lcd_Select(pLcd, 0);
+	Lcd_DataMode(pLcd, 1);
+	Sched_TimerInit(&pLcd->Timer, Lcd_TimerHandler, (uint32_t)(uintptr_t)pLcd, pConfig->Lcd_Priority);
+	SPI_DFFConfig(pConfig->pSPIHandle, SPI_DFF_8BITS);
+
+	pLcd->Op = LCD_OP_INIT;
+	pLcd->pInit = &pConfig->pInitSeq[1];
+	pLcd->InitLeft = pConfig->pInitSeq[0];
+	Lcd_Select(pLcd, 1);
+	Lcd_InitNext(pLcd);
+	return LCD_OK;
+}
+
+/**************************************************************************
+ * Mark a rectangle as changed
+ * ************************************************************************
+ * @fn			- Lcd_Invalidate
+ *
+ * @brief		- Adds the rectangle to the dirty list, merged with the ones
+ * 				  there when that is cheaper to send.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- left column
+ * @param[in]	- top row
+ * @param[in]	- width
+ * @param[in]	- height
+ *
+ * @return		- none
+ *
+ * @Note		- Clipped to the panel. May be called during a flush (and
+ * 				  from interrupt handlers), it counts for the next one.
+ ****************************************************************************/
+void Lcd_Invalidate(Lcd_Handle_t *pLcd, uint16_t X, uint16_t Y, uint16_t W, uint16_t H)
+{
+	Lcd_Rect_t rect = { X, Y, W, H };
+	uint32_t primask;
+
+	if(!Lcd_Clip(pLcd, &rect))
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	Lcd_AddRect(pLcd, rect);
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Lcd_FillRect
+ *
+ * @brief		- Fills a rectangle of the framebuffer with one color and
+ * 				  invalidates it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- left column
+ * @param[in]	- top row
+ * @param[in]	- width
+ * @param[in]	- height
+ * @param[in]	- RGB565 color
+ *
+ * @return		- none
+ ****************************************************************************/
+void Lcd_FillRect(Lcd_Handle_t *pLcd, uint16_t X, uint16_t Y, uint16_t W, uint16_t H, uint16_t Color)
+{
+	Lcd_Rect_t rect = { X, Y, W, H };
+	uint16_t *pRow;
+
+	if(!Lcd_Clip(pLcd, &rect))
+		return;
+
+	pRow = &pLcd->Config.pFrameBuffer[(uint32_t)rect.Y * pLcd->Config.Width + rect.X];
+	for(uint32_t y = 0; y < rect.H; y++)
+	{
+		for(uint32_t x = 0; x < rect.W; x++)
+			pRow[x] = Color;
+		pRow += pLcd->Config.Width;
+	}
+	Lcd_Invalidate(pLcd, rect.X, rect.Y, rect.W, rect.H);
+}
+
+/**************************************************************************
+ * Send the changes
+ * ************************************************************************
+ * @fn			- Lcd_Flush
+ *
+ * @brief		- Takes the dirty list and sends its rectangles from the
+ * 				  framebuffer to the panel.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- @LCD_RETURN
+ *
+ * @Note		- LCD_EVENT_FLUSH_CMPLT, from the scheduler when nothing
+ * 				  had changed. On LCD_BUSY the changes wait for the next
+ * 				  call. A flush may be started from the callback.
+ ****************************************************************************/
+uint8_t Lcd_Flush(Lcd_Handle_t *pLcd)
+{
+	uint32_t primask;
+
+	if(!pLcd->Ready)
+		return (pLcd->Op == LCD_OP_INIT) ? LCD_BUSY : LCD_ERR_PARAM;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if(pLcd->Op != LCD_OP_NONE)
+	{
+		__set_PRIMASK(primask);
+		return LCD_BUSY;
+	}
+	pLcd->Op = LCD_OP_FLUSH;
+	memcpy(pLcd->Flush, pLcd->Dirty, pLcd->DirtyCount * sizeof(Lcd_Rect_t));
+	pLcd->FlushCount = pLcd->DirtyCount;
+	pLcd->DirtyCount = 0;
+	__set_PRIMASK(primask);
+
+	pLcd->FlushIndex = 0;
+	if(pLcd->FlushCount == 0)
+	{
+		if(!Sched_Post(Lcd_EmptyFlushHandler, (uint32_t)(uintptr_t)pLcd, pLcd->Config.Lcd_Priority))
+			Lcd_Finish(pLcd, LCD_EVENT_FLUSH_CMPLT);
+		return LCD_OK;
+	}
+	Lcd_Select(pLcd, 1);
+	Lcd_StartRect(pLcd);
+	return LCD_OK;
+}
+
+/**************************************************************************
+ * @fn			- Lcd_Busy
+ *
+ * @brief		- Tells whether the init sequence or a flush is in progress.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if Lcd_Flush would start
+ ****************************************************************************/
+uint8_t Lcd_Busy(Lcd_Handle_t *pLcd)
+{
+	return pLcd->Op != LCD_OP_NONE;
+}
+
+/**************************************************************************
+ * SPI events
+ * ************************************************************************
+ * @fn			- Lcd_EventHandling
+ *
+ * @brief		- Advances the operation in progress. Events of other SPI
+ * 				  handles are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- SPI handle of the event
+ * @param[in]	- SPI_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+void Lcd_EventHandling(Lcd_Handle_t *pLcd, SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	if(pSPIHandle != pLcd->Config.pSPIHandle || pLcd->Op == LCD_OP_NONE)
+		return;
+
+	if(AppEv == SPI_EVENT_OVR_ERR || AppEv == SPI_EVENT_DMA_ERR)
+	{
+		Lcd_Select(pLcd, 0);
+		Lcd_Finish(pLcd, LCD_EVENT_ERROR);
+		return;
+	}
+	if(AppEv != pLcd->ExpectedEv)
+		return;
+
+	switch(pLcd->Phase)
+	{
+	case LCD_PHASE_CMD:
+		if(pLcd->ArgLen != 0)
+		{
+			pLcd->Phase = LCD_PHASE_ARGS;
+			Lcd_DataMode(pLcd, 1);
+			Lcd_Exchange(pLcd, pLcd->pArgs, pLcd->ArgLen);
+			break;
+		}
+		// no parameters: go on as after them
+	case LCD_PHASE_ARGS:
+		if(pLcd->Op == LCD_OP_FLUSH)
+		{
+			Lcd_WindowNext(pLcd);
+		} else if(pLcd->InitDelay != 0)
+		{
+			pLcd->Phase = LCD_PHASE_WAIT;
+			Sched_TimerStart(&pLcd->Timer, pLcd->InitDelay / pLcd->Config.Lcd_MsPerTick + 1, 0);
+		} else
+		{
+			Lcd_InitNext(pLcd);
+		}
+		break;
+	case LCD_PHASE_PIXELS:
+		Lcd_BlockDone(pLcd);
+		break;
+	default:
+		break;
+	}
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Lcd_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- LCD_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler or in the scheduler.
+ * 				  The next flush may be started from here.
+ ****************************************************************************/
+__attribute__((weak)) void Lcd_ApplicationEventCallback(Lcd_Handle_t *pLcd, uint8_t AppEv)
+{
+	(void)pLcd;
+	(void)AppEv;
+}
+
+static void Lcd_Select(Lcd_Handle_t *pLcd, uint8_t Selected)
+{
+	GPIO_WriteToOutputPin(pLcd->Config.pCSPort, pLcd->Config.CSPin, Selected ? RESET : SET);
+}
+
+static void Lcd_DataMode(Lcd_Handle_t *pLcd, uint8_t Data)
+{
+	GPIO_WriteToOutputPin(pLcd->Config.pDCPort, pLcd->Config.DCPin, Data ? SET : RESET);
+}
+
+// DMA transfer, TX only: the phase ends with TX_CMPLT
+static void Lcd_Exchange(Lcd_Handle_t *pLcd, uint8_t *pTx, uint32_t Len)
+{
+	pLcd->ExpectedEv = SPI_EVENT_TX_CMPLT;
+
+	if(SPI_TransferDMA(pLcd->Config.pSPIHandle, pTx, 0, Len) != SPI_READY)
+	{
+		// someone else is using the SPI
+		Lcd_Select(pLcd, 0);
+		Lcd_Finish(pLcd, LCD_EVENT_ERROR);
+	}
+}
+
+// Command frame with D/C low, then the parameters (if any) with D/C high.
+// In 16 bit frames the command goes out as NOP, command.
+static void Lcd_Command(Lcd_Handle_t *pLcd, uint8_t Cmd, uint8_t *pArgs, uint16_t ArgLen)
+{
+	pLcd->Cmd = Cmd;
+	pLcd->pArgs = pArgs;
+	pLcd->ArgLen = ArgLen;
+	pLcd->Phase = LCD_PHASE_CMD;
+	Lcd_DataMode(pLcd, 0);
+	Lcd_Exchange(pLcd, (uint8_t*)&pLcd->Cmd, (pLcd->Config.pSPIHandle->SPIConfig.SPI_DFF == SPI_DFF_16BITS) ? 2 : 1);
+}
+
+// next command of the init sequence, or the end of it
+static void Lcd_InitNext(Lcd_Handle_t *pLcd)
+{
+	const uint8_t *p = pLcd->pInit;
+	uint8_t len;
+
+	if(pLcd->InitLeft == 0)
+	{
+		Lcd_Select(pLcd, 0);
+		Lcd_DataMode(pLcd, 1);
+		SPI_DFFConfig(pLcd->Config.pSPIHandle, SPI_DFF_16BITS);
+		pLcd->Ready = 1;
+		Lcd_Finish(pLcd, LCD_EVENT_INIT_CMPLT);
+		return;
+	}
+
+	len = p[1] & ~LCD_INIT_DELAY;
+	pLcd->InitDelay = (p[1] & LCD_INIT_DELAY) ? p[2 + len] : 0;
+	pLcd->pInit = &p[2 + len + ((p[1] & LCD_INIT_DELAY) ? 1 : 0)];
+	pLcd->InitLeft--;
+	Lcd_Command(pLcd, p[0], (uint8_t*)&p[2], len);
+}
+
+// window of the next rectangle, or the end of the flush
+static void Lcd_StartRect(Lcd_Handle_t *pLcd)
+{
+	if(pLcd->FlushIndex == pLcd->FlushCount)
+	{
+		Lcd_Select(pLcd, 0);
+		Lcd_Finish(pLcd, LCD_EVENT_FLUSH_CMPLT);
+		return;
+	}
+	pLcd->Step = LCD_STEP_CASET;
+	pLcd->Row = 0;
+	Lcd_WindowNext(pLcd);
+}
+
+// CASET, RASET, RAMWR, then the pixels
+static void Lcd_WindowNext(Lcd_Handle_t *pLcd)
+{
+	Lcd_Rect_t *pRect = &pLcd->Flush[pLcd->FlushIndex];
+
+	switch(pLcd->Step++)
+	{
+	case LCD_STEP_CASET:
+		pLcd->Args[0] = pRect->X + pLcd->Config.XOffset;
+		pLcd->Args[1] = pRect->X + pRect->W - 1 + pLcd->Config.XOffset;
+		Lcd_Command(pLcd, LCD_CMD_CASET, (uint8_t*)pLcd->Args, sizeof(pLcd->Args));
+		break;
+	case LCD_STEP_RASET:
+		pLcd->Args[0] = pRect->Y + pLcd->Config.YOffset;
+		pLcd->Args[1] = pRect->Y + pRect->H - 1 + pLcd->Config.YOffset;
+		Lcd_Command(pLcd, LCD_CMD_RASET, (uint8_t*)pLcd->Args, sizeof(pLcd->Args));
+		break;
+	case LCD_STEP_RAMWR:
+		Lcd_Command(pLcd, LCD_CMD_RAMWR, 0, 0);
+		break;
+	default:
+		pLcd->Cur = 0;
+		Lcd_DataMode(pLcd, 1);
+		Lcd_Queue(pLcd, 0);
+		Lcd_SendBlock(pLcd);
+		Lcd_Queue(pLcd, 1);
+		break;
+	}
+}
+
+// Next rows of the rectangle into a block: straight from the framebuffer
+// for full width rectangles, else packed into the block's staging buffer.
+static void Lcd_Queue(Lcd_Handle_t *pLcd, uint8_t Block)
+{
+	Lcd_Rect_t *pRect = &pLcd->Flush[pLcd->FlushIndex];
+	uint16_t *pSrc = &pLcd->Config.pFrameBuffer[(uint32_t)(pRect->Y + pLcd->Row) * pLcd->Config.Width + pRect->X];
+	uint32_t rows = pRect->H - pLcd->Row;
+
+	if(pRect->W == pLcd->Config.Width)
+	{
+		if(rows > LCD_DMA_CHUNK / pRect->W)
+			rows = LCD_DMA_CHUNK / pRect->W;
+		pLcd->pBlock[Block] = pSrc;
+	} else
+	{
+		if(rows > LCD_STAGE_PIXELS / pRect->W)
+			rows = LCD_STAGE_PIXELS / pRect->W;
+		for(uint32_t i = 0; i < rows; i++)
+		{
+			memcpy(&pLcd->Stage[Block][i * pRect->W], pSrc, pRect->W * sizeof(uint16_t));
+			pSrc += pLcd->Config.Width;
+		}
+		pLcd->pBlock[Block] = pLcd->Stage[Block];
+	}
+	pLcd->BlockLen[Block] = rows * pRect->W;
+	pLcd->Row += rows;
+}
+
+static void Lcd_SendBlock(Lcd_Handle_t *pLcd)
+{
+	pLcd->Phase = LCD_PHASE_PIXELS;
+	Lcd_Exchange(pLcd, (uint8_t*)pLcd->pBlock[pLcd->Cur], pLcd->BlockLen[pLcd->Cur] * sizeof(uint16_t));
+}
+
+// the other block goes on the bus, the free one takes the next rows
+static void Lcd_BlockDone(Lcd_Handle_t *pLcd)
+{
+	pLcd->PixelsSent += pLcd->BlockLen[pLcd->Cur];
+	pLcd->Cur ^= 1;
+	if(pLcd->BlockLen[pLcd->Cur] != 0)
+	{
+		Lcd_SendBlock(pLcd);
+		Lcd_Queue(pLcd, pLcd->Cur ^ 1);
+		return;
+	}
+	pLcd->RectsSent++;
+	pLcd->FlushIndex++;
+	Lcd_StartRect(pLcd);
+}
+
+// clips to the panel, 0 if nothing is left
+static uint8_t Lcd_Clip(Lcd_Handle_t *pLcd, Lcd_Rect_t *pRect)
+{
+	if(pRect->X >= pLcd->Config.Width || pRect->Y >= pLcd->Config.Height || pRect->W == 0 || pRect->H == 0)
+		return 0;
+	if(pRect->W > pLcd->Config.Width - pRect->X)
+		pRect->W = pLcd->Config.Width - pRect->X;
+	if(pRect->H > pLcd->Config.Height - pRect->Y)
+		pRect->H = pLcd->Config.Height - pRect->Y;
+	return 1;
+}
+
+// Merges the rectangle with every dirty one it is cheaper to send together
+// with, then adds it. A full list takes it into the one growing the least.
+// Called with the interrupts disabled.
+static void Lcd_AddRect(Lcd_Handle_t *pLcd, Lcd_Rect_t Rect)
+{
+	uint32_t best_growth = 0xFFFFFFFFU;
+	uint8_t best = 0;
+	uint8_t i = 0;
+
+	while(i < pLcd->DirtyCount)
+	{
+		Lcd_Rect_t u = Lcd_Union(&pLcd->Dirty[i], &Rect);
+
+		if(Lcd_Area(&u) <= Lcd_Area(&pLcd->Dirty[i]) + Lcd_Area(&Rect) + LCD_RECT_COST)
+		{
+			// the union may reach others now: start over
+			Rect = u;
+			pLcd->Dirty[i] = pLcd->Dirty[--pLcd->DirtyCount];
+			i = 0;
+			continue;
+		}
+		i++;
+	}
+	if(pLcd->DirtyCount < LCD_MAX_DIRTY)
+	{
+		pLcd->Dirty[pLcd->DirtyCount++] = Rect;
+		return;
+	}
+
+	for(i = 0; i < LCD_MAX_DIRTY; i++)
+	{
+		Lcd_Rect_t u = Lcd_Union(&pLcd->Dirty[i], &Rect);
+		uint32_t growth = Lcd_Area(&u) - Lcd_Area(&pLcd->Dirty[i]);
+
+		if(growth < best_growth)
+		{
+			best_growth = growth;
+			best = i;
+		}
+	}
+	pLcd->Dirty[best] = Lcd_Union(&pLcd->Dirty[best], &Rect);
+}
+
+static Lcd_Rect_t Lcd_Union(const Lcd_Rect_t *pA, const Lcd_Rect_t *pB)
+{
+	Lcd_Rect_t u;
+	uint16_t x1 = (pA->X + pA->W > pB->X + pB->W) ? pA->X + pA->W : pB->X + pB->W;
+	uint16_t y1 = (pA->Y + pA->H > pB->Y + pB->H) ? pA->Y + pA->H : pB->Y + pB->H;
+
+	u.X = (pA->X < pB->X) ? pA->X : pB->X;
+	u.Y = (pA->Y < pB->Y) ? pA->Y : pB->Y;
+	u.W = x1 - u.X;
+	u.H = y1 - u.Y;
+	return u;
+}
+
+static uint32_t Lcd_Area(const Lcd_Rect_t *pRect)
+{
+	return (uint32_t)pRect->W * pRect->H;
+}
+
+// ends the operation and reports it
+static void Lcd_Finish(Lcd_Handle_t *pLcd, uint8_t AppEv)
+{
+	uint8_t op = pLcd->Op;
+	uint32_t primask;
+
+	pLcd->Op = LCD_OP_NONE;
+	pLcd->Phase = LCD_PHASE_IDLE;
+
+	// what did not reach the panel goes with the next flush
+	if(op == LCD_OP_FLUSH && AppEv == LCD_EVENT_ERROR)
+	{
+		primask = __get_PRIMASK();
+		__disable_irq();
+		for(uint8_t i = pLcd->FlushIndex; i < pLcd->FlushCount; i++)
+			Lcd_AddRect(pLcd, pLcd->Flush[i]);
+		__set_PRIMASK(primask);
+	}
+	Lcd_ApplicationEventCallback(pLcd, AppEv);
+}
+
+static void Lcd_TimerHandler(uint32_t Arg)
+{
+	Lcd_Handle_t *pLcd = (Lcd_Handle_t*)(uintptr_t)Arg;
+
+	if(pLcd->Phase == LCD_PHASE_WAIT)
+		Lcd_InitNext(pLcd);
+}
+
+static void Lcd_EmptyFlushHandler(uint32_t Arg)
+{
+	Lcd_Finish((Lcd_Handle_t*)(uintptr_t)Arg, LCD_EVENT_FLUSH_CMPLT);
+}
@@ -0,0 +1,292 @@
+#include <string.h>
+#include "stm32f407xx_log.h"
+
+#if (LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) != 0
+#error "LOG_BUFFER_SIZE must be a power of 2"
+#endif
+
+/*
+ * Single producer (_write) / single consumer (backend) ring buffer,
+ * see stm32f407xx_ring.h.
+ */
+static uint8_t log_buffer[LOG_BUFFER_SIZE];
+static Ring_t log_ring;
+
+// Bytes currently owned by the TX DMA, 0 when the stream is idle.
+static __vo uint32_t log_dma_len;
+
+static Log_Config_t log_config;
+static DMA_Handle_t log_dma;
+static Log_Stats_t log_stats;
+
+/*
+ * Helper functions
+ */
+static void Log_DrainITM(void);
+static void Log_StartDMA(void);
+static void Log_DMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+
+/**************************************************************************
+ * Initialize the log backend
+ * ************************************************************************
+ * @fn			- Log_Init
+ *
+ * @brief		- Selects the backend which drains the printf ring buffer.
+ *
+ * @param[in]	- pointer to the configuration structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- USART backend: the USART itself (baud rate, TE, UE) must be
+ * 				  configured by the application (USART_Init and
+ * 				  USART_PeripheralControl). Route the stream IRQ
+ * 				  handler to Log_IRQHandling.
+ * 				- ITM backend: the debugger enables SWO. If the stimulus port
+ * 				  is not enabled, the buffered data is discarded.
+ ****************************************************************************/
+void Log_Init(Log_Config_t *pLogConfig)
+{
+	log_config = *pLogConfig;
+	Ring_Init(&log_ring, log_buffer, LOG_BUFFER_SIZE);
+	log_dma_len = 0;
+	memset(&log_stats, 0, sizeof(log_stats));
+
+	if(log_config.Log_Backend == LOG_BACKEND_USART_DMA)
+	{
+		log_dma.pDMAx = log_config.pDMAx;
+		log_dma.Stream = log_config.DMA_Stream;
+		log_dma.DMAConfig.DMA_Channel = log_config.DMA_Channel;
+		log_dma.DMAConfig.DMA_Direction = DMA_DIR_MEM_TO_PERIPH;
+		log_dma.DMAConfig.DMA_PeriphInc = DISABLE;
+		log_dma.DMAConfig.DMA_MemInc = ENABLE;
+		log_dma.DMAConfig.DMA_PeriphDataSize = DMA_SIZE_BYTE;
+		log_dma.DMAConfig.DMA_MemDataSize = DMA_SIZE_BYTE;
+		log_dma.DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+		log_dma.DMAConfig.DMA_Priority = DMA_PRIORITY_LOW;
+		log_dma.DMAConfig.DMA_FIFOMode = DMA_FIFO_DIRECT;
+		log_dma.pEventCallback = Log_DMAEventCallback;
+		log_dma.pParent = 0;
+		DMA_Init(&log_dma);
+
+		// Let the USART request a new byte from the DMA whenever TXE is set.
+		log_config.pUSARTx->CR3 |= (1 << USART_CR3_DMAT);
+
+		DMA_IRQInterruptConfig(DMA_GetIRQNumber(&log_dma), ENABLE);
+
+		// the buffer keeps draining while the CPU sleeps
+		Clk_SleepRequest(log_config.pUSARTx);
+		Clk_SleepRequest(log_config.pDMAx);
+	}
+}
+
+/**************************************************************************
+ * Drain the buffer
+ * ************************************************************************
+ * @fn			- Log_Process
+ *
+ * @brief		- Pushes buffered bytes into the ITM stimulus port as long as
+ * 				  the port can take them. Returns as soon as it would have to
+ * 				  wait. Nothing to do for the DMA backend.
+ *
+ * @param[in]	-
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Call from the main loop (thread context) only. _write also
+ * 				  calls it, so both run in the same context.
+ ****************************************************************************/
+void Log_Process(void)
+{
+	if(log_config.Log_Backend == LOG_BACKEND_ITM)
+	{
+		Log_DrainITM();
+	}
+}
+
+/**************************************************************************
+ * Buffer fill level
+ * ************************************************************************
+ * @fn			- Log_Pending
+ *
+ * @brief		- Returns the number of bytes which are not sent yet.
+ *
+ * @return		- bytes in the buffer (including bytes owned by the DMA)
+ ****************************************************************************/
+uint32_t Log_Pending(void)
+{
+	return Ring_Used(&log_ring);
+}
+
+/**************************************************************************
+ * Drop statistics
+ * ************************************************************************
+ * @fn			- Log_GetStats
+ *
+ * @brief		- Copies the drop counters.
+ *
+ * @param[in]	- pointer to the statistics structure to fill
+ ****************************************************************************/
+void Log_GetStats(Log_Stats_t *pStats)
+{
+	*pStats = log_stats;
+}
+
+/**************************************************************************
+ * Interrupt Handling
+ * ************************************************************************
+ * @fn			- Log_IRQHandling
+ *
+ * @brief		- Call from the IRQ handler of the USART TX DMA stream,
+ * 				  e.g. DMA1_Stream6_IRQHandler for USART2.
+ ****************************************************************************/
+void Log_IRQHandling(void)
+{
+	DMA_IRQHandling(&log_dma);
+}
+
+/*
+ * ITM consumer: one 32-bit stimulus write sends 4 bytes, so whole words are
+ * used as long as there are at least 4 bytes pending.
+ */
+static void Log_DrainITM(void)
+{
+	uint8_t port = log_config.Log_ITMPort;
+	uint8_t *pSpan;
+	uint32_t len = Ring_ReadSpan(&log_ring, &pSpan);
+	uint32_t sent = 0;
+
+	if(!(ITM->TCR & (1 << ITM_TCR_ITMENA)) || !(ITM->TER & (1 << port)))
+	{
+		// No debugger listening, do not let the buffer fill up.
+		Ring_Release(&log_ring, Ring_Used(&log_ring));
+		return;
+	}
+
+	while(len > 0)
+	{
+		while(sent < len)
+		{
+			// Port reads 1 when the stimulus FIFO can accept data.
+			if(!(ITM->PORT[port] & 1))
+				break;
+
+			if(len - sent >= 4)
+			{
+				uint32_t word = 0;
+				for(uint8_t i = 0; i < 4; i++)
+				{
+					word |= (uint32_t)pSpan[sent + i] << (8 * i);
+				}
+				ITM->PORT[port] = word;
+				sent += 4;
+			} else
+			{
+				*((__vo uint8_t*)&ITM->PORT[port]) = pSpan[sent];
+				sent++;
+			}
+		}
+
+		Ring_Release(&log_ring, sent);
+		if(sent < len)
+			break;
+
+		// the rest after the wrap around
+		len = Ring_ReadSpan(&log_ring, &pSpan);
+		sent = 0;
+	}
+}
+
+/*
+ * DMA consumer: hands the largest contiguous chunk to the stream.
+ * Must be called with the stream idle, either from the DMA ISR or with
+ * interrupts masked.
+ */
+static void Log_StartDMA(void)
+{
+	uint8_t *pSpan;
+	uint32_t chunk = Ring_ReadSpan(&log_ring, &pSpan);
+
+	if(chunk == 0)
+	{
+		log_dma_len = 0;
+		return;
+	}
+
+	if(chunk > 0xFFFF)
+		chunk = 0xFFFF;
+
+	log_dma_len = chunk;
+	DMA_Start(&log_dma, (uint32_t)&log_config.pUSARTx->DR, (uint32_t)pSpan, (uint16_t)chunk);
+}
+
+static void Log_DMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	(void)pDMAHandle;
+
+	if(AppEv == DMA_EVENT_CMPLT || AppEv == DMA_EVENT_ERROR)
+	{
+		// On error the chunk is given up, the next one is tried.
+		Ring_Release(&log_ring, log_dma_len);
+		Log_StartDMA();
+	}
+}
+
+/**************************************************************************
+ * newlib write system call
+ * ************************************************************************
+ * @fn			- _write
+ *
+ * @brief		- Overrides the weak _write in syscalls.c. Copies the data
+ * 				  into the ring buffer and returns without waiting for the
+ * 				  backend.
+ *
+ * @param[in]	- file descriptor (ignored, stdout and stderr are the same)
+ * @param[in]	- pointer to the data
+ * @param[in]	- length of the data
+ *
+ * @return		- len, also when the message was dropped, so newlib
+ * 				  does not retry
+ *
+ * @Note		- Single producer: do not printf from interrupt handlers.
+ ****************************************************************************/
+int _write(int file, char *ptr, int len)
+{
+	(void)file;
+	uint32_t used;
+
+	if(log_config.Log_Backend == LOG_BACKEND_NONE || len <= 0)
+		return len;
+
+	// whole messages only: the free space can only grow while we copy
+	if((uint32_t)len > Ring_Free(&log_ring))
+	{
+		log_stats.DroppedMsgs++;
+		log_stats.DroppedBytes += len;
+		return len;
+	}
+
+	Ring_Push(&log_ring, ptr, len);
+
+	used = Ring_Used(&log_ring);
+	if(used > log_stats.HighWater)
+		log_stats.HighWater = used;
+
+	if(log_config.Log_Backend == LOG_BACKEND_ITM)
+	{
+		Log_DrainITM();
+	} else if(log_config.Log_Backend == LOG_BACKEND_USART_DMA)
+	{
+		// Only start the stream if the ISR is not already chaining chunks.
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		if(log_dma_len == 0)
+			Log_StartDMA();
+		__set_PRIMASK(primask);
+	}
+
+	return len;
+}
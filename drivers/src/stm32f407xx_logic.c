@@ -0,0 +1,344 @@
+/*
+ * stm32f407xx_logic.c
+ *
+ * Logic analyzer, see stm32f407xx_logic.h
+ */
+#include <string.h>
+#include <stdio.h>
+#include "stm32f407xx_logic.h"
+
+/*
+ * Helper functions
+ */
+static void Logic_Search(Logic_Handle_t *pLogic, uint16_t First, uint16_t Len);
+static uint8_t Logic_IsTrigger(Logic_Config_t *pConfig, uint16_t Prev, uint16_t Sample);
+static void Logic_Finish(Logic_Handle_t *pLogic);
+
+/**************************************************************************
+ * Initialize the logic analyzer
+ * ************************************************************************
+ * @fn			- Logic_Init
+ *
+ * @brief		- Checks the configuration and sets the timer up for the
+ * 				  sample rate (TIM_Init).
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- @LOGIC_RETURN
+ *
+ * @Note		- The rate is rounded to whole timer ticks, SampleHz in the
+ * 				  handle is the real one. The pins are not configured.
+ ****************************************************************************/
+uint8_t Logic_Init(Logic_Handle_t *pLogic, Logic_Config_t *pConfig)
+{
+	TIM_Handle_t *pTIMHandle = pConfig->pTIMHandle;
+	uint32_t clk, ticks, prescaler;
+
+	if(pTIMHandle == 0 || (pTIMHandle->pTIMx != TIM1 && pTIMHandle->pTIMx != TIM8) ||
+	   pConfig->Logic_SampleHz == 0 || pConfig->pBuffer == 0 || pConfig->BufferLen < 2 ||
+	   (pConfig->BufferLen & 1) || pConfig->PostTrigger >= pConfig->BufferLen / 2 ||
+	   pConfig->Logic_Trigger > LOGIC_TRIGGER_EDGE)
+		return LOGIC_ERR_PARAM;
+
+	clk = TIM_GetClockValue(pTIMHandle->pTIMx);
+	ticks = clk / pConfig->Logic_SampleHz;
+	if(ticks < 2)
+		return LOGIC_ERR_PARAM;
+
+	memset(pLogic, 0, sizeof(*pLogic));
+	pLogic->Config = *pConfig;
+
+	// 16 bit ARR: the prescaler takes what does not fit
+	prescaler = (ticks - 1) / 0x10000;
+	memset(&pTIMHandle->TIM_Config, 0, sizeof(pTIMHandle->TIM_Config));
+	pTIMHandle->TIM_Config.TIM_Prescaler = (uint16_t)prescaler;
+	pTIMHandle->TIM_Config.TIM_Period = ticks / (prescaler + 1) - 1;
+	pTIMHandle->TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+	TIM_Init(pTIMHandle);
+	pLogic->SampleHz = clk / ((prescaler + 1) * (pTIMHandle->TIM_Config.TIM_Period + 1));
+
+	return LOGIC_OK;
+}
+
+/**************************************************************************
+ * Start a capture
+ * ************************************************************************
+ * @fn			- Logic_Start
+ *
+ * @brief		- Starts sampling and arms the trigger.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- @LOGIC_RETURN
+ *
+ * @Note		- LOGIC_EVENT_CMPLT when the capture is in the buffer. The
+ * 				  buffer must not be read before.
+ ****************************************************************************/
+uint8_t Logic_Start(Logic_Handle_t *pLogic)
+{
+	Logic_Config_t *pConfig = &pLogic->Config;
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if(pLogic->Busy)
+	{
+		__set_PRIMASK(primask);
+		return LOGIC_BUSY;
+	}
+	pLogic->Busy = 1;
+	__set_PRIMASK(primask);
+
+	pLogic->Triggered = (pConfig->Logic_Trigger == LOGIC_TRIGGER_NONE);
+	pLogic->TriggerSample = 0;
+	pLogic->Boundary = 0;
+	pLogic->Count = 0;
+	pLogic->Prev = GPIO_ReadFromInputPort(pConfig->pGPIOx);
+
+	if(TIM_UpdateStartReadDMA(pConfig->pTIMHandle, (uint32_t)&pConfig->pGPIOx->IDR, pConfig->pBuffer,
+			pConfig->BufferLen, ENABLE) == RESET)
+	{
+		pLogic->Busy = 0;
+		return LOGIC_ERR_PARAM;
+	}
+	return LOGIC_OK;
+}
+
+/**************************************************************************
+ * @fn			- Logic_Stop
+ *
+ * @brief		- Aborts a capture. No event, the buffer content is not
+ * 				  valid.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- none
+ ****************************************************************************/
+void Logic_Stop(Logic_Handle_t *pLogic)
+{
+	TIM_UpdateStopDMA(pLogic->Config.pTIMHandle);
+	TIM_PeripheralControl(pLogic->Config.pTIMHandle->pTIMx, DISABLE);
+	pLogic->Busy = 0;
+}
+
+/**************************************************************************
+ * @fn			- Logic_Busy
+ *
+ * @brief		- Tells whether a capture is running.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if not
+ ****************************************************************************/
+uint8_t Logic_Busy(Logic_Handle_t *pLogic)
+{
+	return pLogic->Busy;
+}
+
+/**************************************************************************
+ * @fn			- Logic_GetSample
+ *
+ * @brief		- Returns a sample of the capture, the port's IDR.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- 0 (the oldest) .. Count - 1, TriggerIndex for the trigger
+ *
+ * @return		- the sample
+ ****************************************************************************/
+uint16_t Logic_GetSample(Logic_Handle_t *pLogic, uint16_t Index)
+{
+	return pLogic->Config.pBuffer[((uint32_t)pLogic->Oldest + Index) % pLogic->Config.BufferLen];
+}
+
+/**************************************************************************
+ * Run-length compression
+ * ************************************************************************
+ * @fn			- Logic_Compress
+ *
+ * @brief		- Turns the capture into runs of equal samples, the pins of
+ * 				  PinMask only.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- the runs to fill
+ * @param[in]	- size of pRuns
+ *
+ * @return		- number of runs, MaxRuns if the capture did not fit
+ *
+ * @Note		- A bus idle most of the time takes a few runs per change.
+ ****************************************************************************/
+uint32_t Logic_Compress(Logic_Handle_t *pLogic, Logic_Run_t *pRuns, uint32_t MaxRuns)
+{
+	uint16_t mask = pLogic->Config.PinMask;
+	uint32_t runs = 0;
+
+	for(uint32_t i = 0; i < pLogic->Count; i++)
+	{
+		uint16_t levels = Logic_GetSample(pLogic, (uint16_t)i) & mask;
+
+		if(runs > 0 && pRuns[runs - 1].Levels == levels)
+		{
+			pRuns[runs - 1].Length++;
+			continue;
+		}
+		if(runs == MaxRuns)
+			break;
+		pRuns[runs].Levels = levels;
+		pRuns[runs].Length = 1;
+		runs++;
+	}
+	return runs;
+}
+
+/**************************************************************************
+ * @fn			- Logic_Export
+ *
+ * @brief		- Prints the runs: a comment line with the rate, the pins
+ * 				  and the trigger, then sample,levels per run (CSV).
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- runs from Logic_Compress
+ * @param[in]	- number of runs
+ *
+ * @return		- none
+ *
+ * @Note		- Uses printf (syscalls / log module), thread mode only.
+ ****************************************************************************/
+void Logic_Export(Logic_Handle_t *pLogic, const Logic_Run_t *pRuns, uint32_t NumRuns)
+{
+	uint32_t sample = 0;
+
+	printf("# logic %lu Hz, pins 0x%04X, %u samples, trigger at sample %u\n",
+			(unsigned long)pLogic->SampleHz, pLogic->Config.PinMask, pLogic->Count, pLogic->TriggerIndex);
+	printf("sample,levels\n");
+	for(uint32_t i = 0; i < NumRuns; i++)
+	{
+		printf("%lu,0x%04X\n", (unsigned long)sample, pRuns[i].Levels);
+		sample += pRuns[i].Length;
+	}
+}
+
+/**************************************************************************
+ * Timer events
+ * ************************************************************************
+ * @fn			- Logic_EventHandling
+ *
+ * @brief		- Searches the half buffer just filled for the trigger and
+ * 				  ends the capture. Events of other timers are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- timer handle of the event
+ * @param[in]	- TIM_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from TIM_ApplicationEventCallback.
+ ****************************************************************************/
+void Logic_EventHandling(Logic_Handle_t *pLogic, TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	uint16_t half = pLogic->Config.BufferLen / 2;
+
+	if(pTIMHandle != pLogic->Config.pTIMHandle || !pLogic->Busy)
+		return;
+
+	if(AppEv == TIM_EVENT_DMA_ERROR)
+	{
+		Logic_Stop(pLogic);
+		Logic_ApplicationEventCallback(pLogic, LOGIC_EVENT_ERROR);
+		return;
+	}
+	if(AppEv == TIM_EVENT_DMA_HALF_CMPLT)
+		Logic_Search(pLogic, 0, half);
+	else if(AppEv == TIM_EVENT_DMA_CMPLT)
+		Logic_Search(pLogic, half, half);
+	else
+		return;
+
+	// PostTrigger samples after the trigger: stop here
+	if(pLogic->Triggered && pLogic->Boundary - pLogic->TriggerSample > pLogic->Config.PostTrigger)
+		Logic_Finish(pLogic);
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Logic_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- LOGIC_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler.
+ ****************************************************************************/
+__attribute__((weak)) void Logic_ApplicationEventCallback(Logic_Handle_t *pLogic, uint8_t AppEv)
+{
+	(void)pLogic;
+	(void)AppEv;
+}
+
+// searches Len samples from buffer index First, the DMA is on the other half
+static void Logic_Search(Logic_Handle_t *pLogic, uint16_t First, uint16_t Len)
+{
+	const uint16_t *pSample = &pLogic->Config.pBuffer[First];
+
+	if(!pLogic->Triggered)
+	{
+		uint16_t prev = pLogic->Prev;
+
+		for(uint16_t i = 0; i < Len; i++)
+		{
+			if(Logic_IsTrigger(&pLogic->Config, prev, pSample[i]))
+			{
+				pLogic->Triggered = 1;
+				pLogic->TriggerSample = pLogic->Boundary + i;
+				Logic_ApplicationEventCallback(pLogic, LOGIC_EVENT_TRIGGERED);
+				break;
+			}
+			prev = pSample[i];
+		}
+	}
+	pLogic->Prev = pSample[Len - 1];
+	pLogic->Boundary += Len;
+}
+
+static uint8_t Logic_IsTrigger(Logic_Config_t *pConfig, uint16_t Prev, uint16_t Sample)
+{
+	uint16_t mask = pConfig->TrigMask;
+	uint16_t value = pConfig->TrigValue & mask;
+
+	switch(pConfig->Logic_Trigger)
+	{
+	case LOGIC_TRIGGER_PATTERN:
+		return (Sample & mask) == value && (Prev & mask) != value;
+	case LOGIC_TRIGGER_RISING:
+		return (~Prev & Sample & mask) != 0;
+	case LOGIC_TRIGGER_FALLING:
+		return (Prev & ~Sample & mask) != 0;
+	case LOGIC_TRIGGER_EDGE:
+		return ((Prev ^ Sample) & mask) != 0;
+	default:
+		return 1;
+	}
+}
+
+// stops the DMA and locates the capture in the buffer
+static void Logic_Finish(Logic_Handle_t *pLogic)
+{
+	uint16_t len = pLogic->Config.BufferLen;
+	uint32_t written, pos;
+
+	Logic_Stop(pLogic);
+
+	// samples taken since the boundary, while this interrupt ran
+	pos = (len - DMA_GetRemaining(&pLogic->Config.pTIMHandle->UpDMA)) % len;
+	written = pLogic->Boundary + (pos + len - pLogic->Boundary % len) % len;
+
+	pLogic->Count = (written < len) ? (uint16_t)written : len;
+	pLogic->Oldest = (written < len) ? 0 : (uint16_t)pos;
+	pLogic->TriggerIndex = (pLogic->TriggerSample >= written - pLogic->Count) ?
+			(uint16_t)(pLogic->TriggerSample - (written - pLogic->Count)) : 0;
+
+	Logic_ApplicationEventCallback(pLogic, LOGIC_EVENT_CMPLT);
+}
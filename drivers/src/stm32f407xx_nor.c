@@ -0,0 +1,577 @@
+/*
+ * stm32f407xx_nor.c
+ *
+ * SPI NOR flash driver, see stm32f407xx_nor.h
+ */
+#include <string.h>
+#include "stm32f407xx_nor.h"
+
+/*
+ * Operations
+ */
+#define NOR_OP_NONE					0
+#define NOR_OP_ID					1
+#define NOR_OP_READ					2
+#define NOR_OP_PROGRAM				3
+#define NOR_OP_ERASE				4
+#define NOR_OP_READ_AHEAD			5
+
+/*
+ * Operation phases, each one is a DMA transfer (or a wait)
+ */
+#define NOR_PHASE_IDLE				0
+#define NOR_PHASE_ID				1 // 0x9F and 3 ID bytes
+#define NOR_PHASE_READ_CMD			2 // 0x0B, address, dummy byte
+#define NOR_PHASE_READ_DATA			3 // data, NOR_DMA_CHUNK at a time
+#define NOR_PHASE_WREN				4 // write enable
+#define NOR_PHASE_PROG_CMD			5 // 0x02, address
+#define NOR_PHASE_PROG_DATA			6 // up to the end of the page
+#define NOR_PHASE_ERASE_CMD			7 // 0x20/0xD8 and address, or 0xC7
+#define NOR_PHASE_WAIT				8 // erase in progress, timer running
+#define NOR_PHASE_POLL				9 // status register 1
+
+/*
+ * Helper functions
+ */
+static uint8_t Nor_Submit(Nor_Handle_t *pNor, uint8_t Op, uint32_t Addr, uint8_t *pData, uint32_t Len);
+static void Nor_Begin(Nor_Handle_t *pNor, uint8_t Op, uint32_t Addr, uint8_t *pData, uint32_t Len);
+static void Nor_Select(Nor_Handle_t *pNor);
+static void Nor_Deselect(Nor_Handle_t *pNor);
+static void Nor_Exchange(Nor_Handle_t *pNor, uint8_t *pTx, uint8_t *pRx, uint32_t Len);
+static void Nor_StartRead(Nor_Handle_t *pNor);
+static void Nor_ReadChunk(Nor_Handle_t *pNor);
+static void Nor_WriteEnable(Nor_Handle_t *pNor);
+static void Nor_PollStatus(Nor_Handle_t *pNor);
+static void Nor_SetAddress(Nor_Handle_t *pNor, uint8_t Cmd, uint32_t Addr);
+static uint32_t Nor_EraseSize(Nor_Handle_t *pNor, uint8_t EraseType);
+static void Nor_Invalidate(Nor_Handle_t *pNor, uint32_t Addr, uint32_t Len);
+static void Nor_ReadAhead(Nor_Handle_t *pNor, uint32_t Addr);
+static void Nor_Finish(Nor_Handle_t *pNor, uint8_t AppEv);
+static void Nor_TimerHandler(uint32_t Arg);
+static void Nor_CacheHitHandler(uint32_t Arg);
+
+/**************************************************************************
+ * Initialize a flash handle
+ * ************************************************************************
+ * @fn			- Nor_Init
+ *
+ * @brief		- Copies the configuration, deselects the chip and empties
+ * 				  the read-ahead cache.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- none
+ *
+ * @Note		- Call after Sched_Init. The capacity is unknown (0) until
+ * 				  Nor_ReadId has completed.
+ ****************************************************************************/
+void Nor_Init(Nor_Handle_t *pNor, Nor_Config_t *pConfig)
+{
+	memset(pNor, 0, sizeof(*pNor));
+	pNor->Config = *pConfig;
+
+	Nor_Deselect(pNor);
+	Sched_TimerInit(&pNor->Timer, Nor_TimerHandler, (uint32_t)(uintptr_t)pNor, pConfig->Nor_Priority);
+}
+
+/**************************************************************************
+ * Probe
+ * ************************************************************************
+ * @fn			- Nor_ReadId
+ *
+ * @brief		- Reads the JEDEC ID (manufacturer, memory type, capacity
+ * 				  code) into JedecId and sets Capacity to 2^code bytes.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- @NOR_RETURN
+ *
+ * @Note		- NOR_EVENT_ID_CMPLT, or NOR_EVENT_ERROR when the
+ * 				  manufacturer byte is 0x00 or 0xFF (no chip on the bus).
+ ****************************************************************************/
+uint8_t Nor_ReadId(Nor_Handle_t *pNor)
+{
+	return Nor_Submit(pNor, NOR_OP_ID, 0, 0, 0);
+}
+
+/**************************************************************************
+ * Read
+ * ************************************************************************
+ * @fn			- Nor_Read
+ *
+ * @brief		- Fast read of Len bytes from Addr into pBuffer. The part
+ * 				  held by the read-ahead cache is copied, the rest streams
+ * 				  from the chip by DMA under one chip select.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- flash address
+ * @param[in]	- destination
+ * @param[in]	- number of bytes
+ *
+ * @return		- @NOR_RETURN
+ *
+ * @Note		- NOR_EVENT_READ_CMPLT. A read served from the cache alone
+ * 				  completes from the scheduler.
+ ****************************************************************************/
+uint8_t Nor_Read(Nor_Handle_t *pNor, uint32_t Addr, uint8_t *pBuffer, uint32_t Len)
+{
+	if(Len == 0 || Addr >= pNor->Capacity || Len > pNor->Capacity - Addr)
+		return NOR_ERR_PARAM;
+
+	return Nor_Submit(pNor, NOR_OP_READ, Addr, pBuffer, Len);
+}
+
+/**************************************************************************
+ * Program
+ * ************************************************************************
+ * @fn			- Nor_Program
+ *
+ * @brief		- Programs Len bytes at Addr, one page program per 256
+ * 				  byte page touched, so any address and length work.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- flash address
+ * @param[in]	- data, must stay valid until the event
+ * @param[in]	- number of bytes
+ *
+ * @return		- @NOR_RETURN
+ *
+ * @Note		- NOR_EVENT_PROGRAM_CMPLT. Programming only clears bits:
+ * 				  erase first.
+ ****************************************************************************/
+uint8_t Nor_Program(Nor_Handle_t *pNor, uint32_t Addr, const uint8_t *pData, uint32_t Len)
+{
+	if(Len == 0 || Addr >= pNor->Capacity || Len > pNor->Capacity - Addr)
+		return NOR_ERR_PARAM;
+
+	return Nor_Submit(pNor, NOR_OP_PROGRAM, Addr, (uint8_t*)pData, Len);
+}
+
+/**************************************************************************
+ * Erase
+ * ************************************************************************
+ * @fn			- Nor_Erase
+ *
+ * @brief		- Erases (sets to 0xFF) the sector, block or the whole chip.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- flash address, aligned to the erase size (0 for the chip)
+ * @param[in]	- @NOR_ERASE
+ *
+ * @return		- @NOR_RETURN
+ *
+ * @Note		- NOR_EVENT_ERASE_CMPLT. The chip is polled every
+ * 				  Nor_PollTicks scheduler ticks until it is done.
+ ****************************************************************************/
+uint8_t Nor_Erase(Nor_Handle_t *pNor, uint32_t Addr, uint8_t EraseType)
+{
+	uint32_t size = Nor_EraseSize(pNor, EraseType);
+
+	if(size == 0 || Addr >= pNor->Capacity || (Addr % size) != 0)
+		return NOR_ERR_PARAM;
+
+	return Nor_Submit(pNor, NOR_OP_ERASE, Addr, 0, EraseType);
+}
+
+/**************************************************************************
+ * @fn			- Nor_Busy
+ *
+ * @brief		- Tells whether an operation is in progress or queued.
+ * 				  A read-ahead alone does not count.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if a new operation would start
+ ****************************************************************************/
+uint8_t Nor_Busy(Nor_Handle_t *pNor)
+{
+	return (pNor->Op != NOR_OP_NONE && pNor->Op != NOR_OP_READ_AHEAD) || pNor->PendingOp != NOR_OP_NONE;
+}
+
+/**************************************************************************
+ * SPI events
+ * ************************************************************************
+ * @fn			- Nor_EventHandling
+ *
+ * @brief		- Advances the operation in progress. Events of other SPI
+ * 				  handles are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- SPI handle of the event
+ * @param[in]	- SPI_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+void Nor_EventHandling(Nor_Handle_t *pNor, SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	if(pSPIHandle != pNor->Config.pSPIHandle || pNor->Op == NOR_OP_NONE)
+		return;
+
+	if(AppEv == SPI_EVENT_OVR_ERR || AppEv == SPI_EVENT_DMA_ERR)
+	{
+		Nor_Deselect(pNor);
+		Nor_Finish(pNor, NOR_EVENT_ERROR);
+		return;
+	}
+	if(AppEv != pNor->ExpectedEv)
+		return;
+
+	switch(pNor->Phase)
+	{
+	case NOR_PHASE_ID:
+		Nor_Deselect(pNor);
+		memcpy(pNor->JedecId, &pNor->Rx[1], 3);
+		if(pNor->JedecId[0] == 0x00 || pNor->JedecId[0] == 0xFF || pNor->JedecId[2] >= 32)
+		{
+			pNor->Capacity = 0;
+			Nor_Finish(pNor, NOR_EVENT_ERROR);
+			break;
+		}
+		pNor->Capacity = 1U << pNor->JedecId[2];
+		Nor_Finish(pNor, NOR_EVENT_ID_CMPLT);
+		break;
+	case NOR_PHASE_READ_CMD:
+		pNor->Phase = NOR_PHASE_READ_DATA;
+		Nor_ReadChunk(pNor);
+		break;
+	case NOR_PHASE_READ_DATA:
+		pNor->FlashReadBytes += pNor->Chunk;
+		pNor->Addr += pNor->Chunk;
+		pNor->pData += pNor->Chunk;
+		pNor->Len -= pNor->Chunk;
+		if(pNor->Len != 0)
+		{
+			Nor_ReadChunk(pNor);
+			break;
+		}
+		Nor_Deselect(pNor);
+		Nor_Finish(pNor, NOR_EVENT_READ_CMPLT);
+		break;
+	case NOR_PHASE_WREN:
+		Nor_Deselect(pNor);
+		if(pNor->Op == NOR_OP_PROGRAM)
+		{
+			// up to the end of the page, the chip would wrap around in it
+			pNor->Chunk = NOR_PAGE_SIZE - (pNor->Addr % NOR_PAGE_SIZE);
+			if(pNor->Chunk > pNor->Len)
+				pNor->Chunk = pNor->Len;
+			Nor_SetAddress(pNor, NOR_CMD_PAGE_PROGRAM, pNor->Addr);
+			pNor->Phase = NOR_PHASE_PROG_CMD;
+			Nor_Select(pNor);
+			Nor_Exchange(pNor, pNor->Tx, 0, 4);
+		} else if(pNor->Len == NOR_ERASE_CHIP)
+		{
+			pNor->Tx[0] = NOR_CMD_CHIP_ERASE;
+			pNor->Phase = NOR_PHASE_ERASE_CMD;
+			Nor_Select(pNor);
+			Nor_Exchange(pNor, pNor->Tx, 0, 1);
+		} else
+		{
+			Nor_SetAddress(pNor, (pNor->Len == NOR_ERASE_SECTOR) ? NOR_CMD_SECTOR_ERASE : NOR_CMD_BLOCK_ERASE, pNor->Addr);
+			pNor->Phase = NOR_PHASE_ERASE_CMD;
+			Nor_Select(pNor);
+			Nor_Exchange(pNor, pNor->Tx, 0, 4);
+		}
+		break;
+	case NOR_PHASE_PROG_CMD:
+		pNor->Phase = NOR_PHASE_PROG_DATA;
+		Nor_Exchange(pNor, pNor->pData, 0, pNor->Chunk);
+		break;
+	case NOR_PHASE_PROG_DATA:
+		// the chip programs the page when chip select goes high
+		Nor_Deselect(pNor);
+		pNor->Addr += pNor->Chunk;
+		pNor->pData += pNor->Chunk;
+		pNor->Len -= pNor->Chunk;
+		Nor_PollStatus(pNor);
+		break;
+	case NOR_PHASE_ERASE_CMD:
+		Nor_Deselect(pNor);
+		pNor->Phase = NOR_PHASE_WAIT;
+		Sched_TimerStart(&pNor->Timer, pNor->Config.Nor_PollTicks, 0);
+		break;
+	case NOR_PHASE_POLL:
+		Nor_Deselect(pNor);
+		if(pNor->Rx[1] & (1 << NOR_SR1_WIP))
+		{
+			if(pNor->Op == NOR_OP_ERASE)
+			{
+				pNor->Phase = NOR_PHASE_WAIT;
+				Sched_TimerStart(&pNor->Timer, pNor->Config.Nor_PollTicks, 0);
+			} else
+			{
+				Nor_PollStatus(pNor);
+			}
+		} else if(pNor->Op == NOR_OP_PROGRAM && pNor->Len != 0)
+		{
+			Nor_WriteEnable(pNor);
+		} else
+		{
+			Nor_Finish(pNor, (pNor->Op == NOR_OP_PROGRAM) ? NOR_EVENT_PROGRAM_CMPLT : NOR_EVENT_ERASE_CMPLT);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Nor_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- NOR_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler or in the scheduler.
+ * 				  The next operation may be started from here.
+ ****************************************************************************/
+__attribute__((weak)) void Nor_ApplicationEventCallback(Nor_Handle_t *pNor, uint8_t AppEv)
+{
+	(void)pNor;
+	(void)AppEv;
+}
+
+// starts the operation, or queues it behind a read-ahead
+static uint8_t Nor_Submit(Nor_Handle_t *pNor, uint8_t Op, uint32_t Addr, uint8_t *pData, uint32_t Len)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if(pNor->Op == NOR_OP_READ_AHEAD && pNor->PendingOp == NOR_OP_NONE)
+	{
+		pNor->PendingOp = Op;
+		pNor->PendingAddr = Addr;
+		pNor->pPendingData = pData;
+		pNor->PendingLen = Len;
+		__set_PRIMASK(primask);
+		return NOR_OK;
+	}
+	if(pNor->Op != NOR_OP_NONE || pNor->PendingOp != NOR_OP_NONE)
+	{
+		__set_PRIMASK(primask);
+		return NOR_BUSY;
+	}
+	pNor->Op = Op;
+	__set_PRIMASK(primask);
+
+	Nor_Begin(pNor, Op, Addr, pData, Len);
+	return NOR_OK;
+}
+
+// first phase of an operation (Len is the erase type for erases)
+static void Nor_Begin(Nor_Handle_t *pNor, uint8_t Op, uint32_t Addr, uint8_t *pData, uint32_t Len)
+{
+	pNor->Op = Op;
+	pNor->Addr = Addr;
+	pNor->pData = pData;
+	pNor->Len = Len;
+
+	switch(Op)
+	{
+	case NOR_OP_ID:
+		memset(pNor->Tx, 0xFF, sizeof(pNor->Tx));
+		pNor->Tx[0] = NOR_CMD_JEDEC_ID;
+		pNor->Phase = NOR_PHASE_ID;
+		Nor_Select(pNor);
+		Nor_Exchange(pNor, pNor->Tx, pNor->Rx, 4);
+		break;
+	case NOR_OP_READ:
+	{
+		uint32_t cache_end = pNor->CacheAddr + pNor->CacheLen;
+
+		pNor->ReadEnd = Addr + Len;
+		if(Addr >= pNor->CacheAddr && Addr < cache_end)
+		{
+			uint32_t n = cache_end - Addr;
+
+			if(n > Len)
+				n = Len;
+			memcpy(pData, &pNor->Cache[Addr - pNor->CacheAddr], n);
+			pNor->CacheHitBytes += n;
+			pNor->Addr += n;
+			pNor->pData += n;
+			pNor->Len -= n;
+		}
+		if(pNor->Len != 0)
+		{
+			Nor_StartRead(pNor);
+		} else if(!Sched_Post(Nor_CacheHitHandler, (uint32_t)(uintptr_t)pNor, pNor->Config.Nor_Priority))
+		{
+			Nor_Finish(pNor, NOR_EVENT_READ_CMPLT);
+		}
+		break;
+	}
+	case NOR_OP_READ_AHEAD:
+		pNor->CacheAddr = Addr;
+		pNor->CacheLen = 0;
+		pNor->ReadEnd = Addr + Len;
+		Nor_StartRead(pNor);
+		break;
+	case NOR_OP_PROGRAM:
+		Nor_Invalidate(pNor, Addr, Len);
+		Nor_WriteEnable(pNor);
+		break;
+	case NOR_OP_ERASE:
+		Nor_Invalidate(pNor, Addr, Nor_EraseSize(pNor, (uint8_t)Len));
+		Nor_WriteEnable(pNor);
+		break;
+	default:
+		break;
+	}
+}
+
+static void Nor_Select(Nor_Handle_t *pNor)
+{
+	GPIO_WriteToOutputPin(pNor->Config.pCSPort, pNor->Config.CSPin, RESET);
+}
+
+static void Nor_Deselect(Nor_Handle_t *pNor)
+{
+	GPIO_WriteToOutputPin(pNor->Config.pCSPort, pNor->Config.CSPin, SET);
+}
+
+// DMA transfer, the phase ends with RX_CMPLT (RX buffer) or TX_CMPLT
+static void Nor_Exchange(Nor_Handle_t *pNor, uint8_t *pTx, uint8_t *pRx, uint32_t Len)
+{
+	pNor->ExpectedEv = pRx ? SPI_EVENT_RX_CMPLT : SPI_EVENT_TX_CMPLT;
+
+	if(SPI_TransferDMA(pNor->Config.pSPIHandle, pTx, pRx, Len) != SPI_READY)
+	{
+		// someone else is using the SPI
+		Nor_Deselect(pNor);
+		Nor_Finish(pNor, NOR_EVENT_ERROR);
+	}
+}
+
+static void Nor_StartRead(Nor_Handle_t *pNor)
+{
+	Nor_SetAddress(pNor, NOR_CMD_FAST_READ, pNor->Addr);
+	pNor->Tx[4] = 0xFF;					// dummy byte
+	pNor->Phase = NOR_PHASE_READ_CMD;
+	Nor_Select(pNor);
+	Nor_Exchange(pNor, pNor->Tx, 0, 5);
+}
+
+// next piece of a read: 0xFF frames out, data in
+static void Nor_ReadChunk(Nor_Handle_t *pNor)
+{
+	pNor->Chunk = (pNor->Len > NOR_DMA_CHUNK) ? NOR_DMA_CHUNK : pNor->Len;
+	Nor_Exchange(pNor, 0, pNor->pData, pNor->Chunk);
+}
+
+static void Nor_WriteEnable(Nor_Handle_t *pNor)
+{
+	pNor->Tx[0] = NOR_CMD_WRITE_ENABLE;
+	pNor->Phase = NOR_PHASE_WREN;
+	Nor_Select(pNor);
+	Nor_Exchange(pNor, pNor->Tx, 0, 1);
+}
+
+static void Nor_PollStatus(Nor_Handle_t *pNor)
+{
+	pNor->Tx[0] = NOR_CMD_READ_STATUS1;
+	pNor->Tx[1] = 0xFF;
+	pNor->Phase = NOR_PHASE_POLL;
+	Nor_Select(pNor);
+	Nor_Exchange(pNor, pNor->Tx, pNor->Rx, 2);
+}
+
+// command byte and 24 bit address, MSB first
+static void Nor_SetAddress(Nor_Handle_t *pNor, uint8_t Cmd, uint32_t Addr)
+{
+	pNor->Tx[0] = Cmd;
+	pNor->Tx[1] = (uint8_t)(Addr >> 16);
+	pNor->Tx[2] = (uint8_t)(Addr >> 8);
+	pNor->Tx[3] = (uint8_t)Addr;
+}
+
+static uint32_t Nor_EraseSize(Nor_Handle_t *pNor, uint8_t EraseType)
+{
+	if(EraseType == NOR_ERASE_SECTOR)
+		return NOR_SECTOR_SIZE;
+	if(EraseType == NOR_ERASE_BLOCK)
+		return NOR_BLOCK_SIZE;
+	if(EraseType == NOR_ERASE_CHIP)
+		return pNor->Capacity;
+	return 0;
+}
+
+// drops the cached bytes when [Addr, Addr + Len) touches them
+static void Nor_Invalidate(Nor_Handle_t *pNor, uint32_t Addr, uint32_t Len)
+{
+	if(Addr < pNor->CacheAddr + pNor->CacheLen && pNor->CacheAddr < Addr + Len)
+		pNor->CacheLen = 0;
+}
+
+// Starts fetching from Addr into the cache, unless at least half a cache
+// from there is held already. Called with no operation in progress.
+static void Nor_ReadAhead(Nor_Handle_t *pNor, uint32_t Addr)
+{
+	uint32_t len = NOR_CACHE_SIZE;
+
+	if(pNor->Config.Nor_ReadAhead != ENABLE || Addr >= pNor->Capacity)
+		return;
+	if(Addr >= pNor->CacheAddr && Addr + NOR_CACHE_SIZE / 2 <= pNor->CacheAddr + pNor->CacheLen)
+		return;
+
+	if(len > pNor->Capacity - Addr)
+		len = pNor->Capacity - Addr;
+	Nor_Begin(pNor, NOR_OP_READ_AHEAD, Addr, pNor->Cache, len);
+}
+
+// ends the operation, reports it and starts what was queued behind it
+static void Nor_Finish(Nor_Handle_t *pNor, uint8_t AppEv)
+{
+	uint8_t op = pNor->Op;
+	uint32_t primask;
+
+	pNor->Op = NOR_OP_NONE;
+	pNor->Phase = NOR_PHASE_IDLE;
+
+	if(op == NOR_OP_READ_AHEAD)
+	{
+		if(AppEv == NOR_EVENT_READ_CMPLT)
+			pNor->CacheLen = pNor->ReadEnd - pNor->CacheAddr;
+	} else
+	{
+		// read-ahead first: a read submitted by the callback waits for it
+		if(op == NOR_OP_READ && AppEv == NOR_EVENT_READ_CMPLT)
+			Nor_ReadAhead(pNor, pNor->ReadEnd);
+		Nor_ApplicationEventCallback(pNor, AppEv);
+	}
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	op = NOR_OP_NONE;
+	if(pNor->Op == NOR_OP_NONE && pNor->PendingOp != NOR_OP_NONE)
+	{
+		op = pNor->PendingOp;
+		pNor->PendingOp = NOR_OP_NONE;
+		pNor->Op = op;
+	}
+	__set_PRIMASK(primask);
+
+	if(op != NOR_OP_NONE)
+		Nor_Begin(pNor, op, pNor->PendingAddr, pNor->pPendingData, pNor->PendingLen);
+}
+
+static void Nor_TimerHandler(uint32_t Arg)
+{
+	Nor_Handle_t *pNor = (Nor_Handle_t*)(uintptr_t)Arg;
+
+	if(pNor->Phase == NOR_PHASE_WAIT)
+		Nor_PollStatus(pNor);
+}
+
+static void Nor_CacheHitHandler(uint32_t Arg)
+{
+	Nor_Finish((Nor_Handle_t*)(uintptr_t)Arg, NOR_EVENT_READ_CMPLT);
+}
@@ -0,0 +1,301 @@
+/*
+ * stm32f407xx_pattern.c
+ *
+ * Pattern generator, see stm32f407xx_pattern.h
+ */
+#include <string.h>
+#include "stm32f407xx_pattern.h"
+
+/*
+ * Helper functions
+ */
+static uint8_t Pattern_Claim(Pattern_Handle_t *pPattern);
+static void Pattern_Finish(Pattern_Handle_t *pPattern, uint8_t AppEv);
+
+/**************************************************************************
+ * Initialize the pattern generator
+ * ************************************************************************
+ * @fn			- Pattern_Init
+ *
+ * @brief		- Sets the timer up for the step rate (TIM_Init) and makes
+ * 				  the pins of PinMask push-pull outputs.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- @PATTERN_RETURN
+ *
+ * @Note		- The rate is rounded to whole timer ticks, StepHz in the
+ * 				  handle is the real one. The pins keep their levels.
+ ****************************************************************************/
+uint8_t Pattern_Init(Pattern_Handle_t *pPattern, Pattern_Config_t *pConfig)
+{
+	TIM_Handle_t *pTIMHandle = pConfig->pTIMHandle;
+	GPIO_Handle_t pin;
+	uint32_t clk, ticks, prescaler;
+
+	if(pTIMHandle == 0 || (pTIMHandle->pTIMx != TIM1 && pTIMHandle->pTIMx != TIM8) ||
+	   pConfig->Pattern_StepHz == 0 || pConfig->PinMask == 0)
+		return PATTERN_ERR_PARAM;
+
+	clk = TIM_GetClockValue(pTIMHandle->pTIMx);
+	ticks = clk / pConfig->Pattern_StepHz;
+	if(ticks < 2)
+		return PATTERN_ERR_PARAM;
+
+	memset(pPattern, 0, sizeof(*pPattern));
+	pPattern->Config = *pConfig;
+
+	// 16 bit ARR: the prescaler takes what does not fit
+	prescaler = (ticks - 1) / 0x10000;
+	memset(&pTIMHandle->TIM_Config, 0, sizeof(pTIMHandle->TIM_Config));
+	pTIMHandle->TIM_Config.TIM_Prescaler = (uint16_t)prescaler;
+	pTIMHandle->TIM_Config.TIM_Period = ticks / (prescaler + 1) - 1;
+	pTIMHandle->TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+	TIM_Init(pTIMHandle);
+	pPattern->StepHz = clk / ((prescaler + 1) * (pTIMHandle->TIM_Config.TIM_Period + 1));
+
+	memset(&pin, 0, sizeof(pin));
+	pin.pGPIOx = pConfig->pGPIOx;
+	pin.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	pin.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_HIGH;
+	pin.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	pin.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		if(pConfig->PinMask & (1U << i))
+		{
+			pin.GPIO_PinConfig.GPIO_PinNumber = i;
+			GPIO_Init(&pin);
+		}
+	}
+
+	return PATTERN_OK;
+}
+
+/**************************************************************************
+ * @fn			- Pattern_Word
+ *
+ * @brief		- BSRR word of one step: the pins of PinMask take the
+ * 				  levels of the same bits of Levels.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pin levels, as in IDR/ODR
+ *
+ * @return		- the BSRR word
+ ****************************************************************************/
+uint32_t Pattern_Word(Pattern_Handle_t *pPattern, uint16_t Levels)
+{
+	uint32_t mask = pPattern->Config.PinMask;
+
+	return (Levels & mask) | ((~Levels & mask) << 16);
+}
+
+/**************************************************************************
+ * @fn			- Pattern_Fill
+ *
+ * @brief		- Pattern_Word for Len steps.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- the words to fill
+ * @param[in]	- pin levels per step
+ * @param[in]	- number of steps
+ *
+ * @return		- none
+ *
+ * @Note		- Also for refilling a stream buffer from the callback.
+ ****************************************************************************/
+void Pattern_Fill(Pattern_Handle_t *pPattern, uint32_t *pWords, const uint16_t *pLevels, uint32_t Len)
+{
+	uint32_t mask = pPattern->Config.PinMask;
+
+	for(uint32_t i = 0; i < Len; i++)
+		pWords[i] = (pLevels[i] & mask) | ((~pLevels[i] & mask) << 16);
+}
+
+/**************************************************************************
+ * Start a pattern
+ * ************************************************************************
+ * @fn			- Pattern_Start
+ *
+ * @brief		- Sends the words once or over and over, one per step.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- BSRR words, must stay valid while the pattern runs
+ * @param[in]	- number of words
+ * @param[in]	- PATTERN_MODE_ONESHOT or PATTERN_MODE_CIRCULAR
+ *
+ * @return		- @PATTERN_RETURN
+ *
+ * @Note		- One shot: PATTERN_EVENT_CMPLT when the last word is out,
+ * 				  the timer is stopped then.
+ ****************************************************************************/
+uint8_t Pattern_Start(Pattern_Handle_t *pPattern, uint32_t *pWords, uint16_t Len, uint8_t Mode)
+{
+	uint8_t circular = (Mode == PATTERN_MODE_CIRCULAR) ? ENABLE : DISABLE;
+
+	if(Len == 0 || Mode > PATTERN_MODE_CIRCULAR)
+		return PATTERN_ERR_PARAM;
+	if(!Pattern_Claim(pPattern))
+		return PATTERN_BUSY;
+
+	pPattern->Mode = Mode;
+	if(TIM_UpdateStartDMA(pPattern->Config.pTIMHandle, (uint32_t)&pPattern->Config.pGPIOx->BSRR,
+			pWords, Len, circular) == RESET)
+	{
+		pPattern->Busy = 0;
+		return PATTERN_ERR_PARAM;
+	}
+	return PATTERN_OK;
+}
+
+/**************************************************************************
+ * Start a stream
+ * ************************************************************************
+ * @fn			- Pattern_StartStream
+ *
+ * @brief		- Sends pBuffer0, pBuffer1, pBuffer0 and so on until
+ * 				  Pattern_Stop. Both hold the first steps at the start.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- the two buffers of BSRR words
+ * @param[in]	- number of words of each
+ *
+ * @return		- @PATTERN_RETURN
+ *
+ * @Note		- PATTERN_EVENT_BUFFERx_FREE after each buffer. A buffer
+ * 				  not refilled in time is sent again.
+ ****************************************************************************/
+uint8_t Pattern_StartStream(Pattern_Handle_t *pPattern, uint32_t *pBuffer0, uint32_t *pBuffer1, uint16_t Len)
+{
+	if(Len == 0)
+		return PATTERN_ERR_PARAM;
+	if(!Pattern_Claim(pPattern))
+		return PATTERN_BUSY;
+
+	pPattern->Mode = PATTERN_MODE_STREAM;
+	pPattern->Buffers = 0;
+	if(TIM_UpdateStartDMADoubleBuffer(pPattern->Config.pTIMHandle, (uint32_t)&pPattern->Config.pGPIOx->BSRR,
+			pBuffer0, pBuffer1, Len) == RESET)
+	{
+		pPattern->Busy = 0;
+		return PATTERN_ERR_PARAM;
+	}
+	return PATTERN_OK;
+}
+
+/**************************************************************************
+ * @fn			- Pattern_Stop
+ *
+ * @brief		- Stops the DMA requests and the timer. The pins keep the
+ * 				  level of the last step sent.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- none
+ ****************************************************************************/
+void Pattern_Stop(Pattern_Handle_t *pPattern)
+{
+	TIM_UpdateStopDMA(pPattern->Config.pTIMHandle);
+	TIM_PeripheralControl(pPattern->Config.pTIMHandle->pTIMx, DISABLE);
+	pPattern->Busy = 0;
+}
+
+/**************************************************************************
+ * @fn			- Pattern_Busy
+ *
+ * @brief		- Tells whether a pattern is running.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if not
+ ****************************************************************************/
+uint8_t Pattern_Busy(Pattern_Handle_t *pPattern)
+{
+	return pPattern->Busy;
+}
+
+/**************************************************************************
+ * Timer events
+ * ************************************************************************
+ * @fn			- Pattern_EventHandling
+ *
+ * @brief		- Ends a one shot pattern, reports the stream buffers.
+ * 				  Events of other timers are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- timer handle of the event
+ * @param[in]	- TIM_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from TIM_ApplicationEventCallback.
+ ****************************************************************************/
+void Pattern_EventHandling(Pattern_Handle_t *pPattern, TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	if(pTIMHandle != pPattern->Config.pTIMHandle || !pPattern->Busy)
+		return;
+
+	if(AppEv == TIM_EVENT_DMA_ERROR)
+	{
+		Pattern_Stop(pPattern);
+		Pattern_ApplicationEventCallback(pPattern, PATTERN_EVENT_ERROR);
+	} else if(AppEv == TIM_EVENT_DMA_CMPLT)
+	{
+		if(pPattern->Mode == PATTERN_MODE_ONESHOT)
+		{
+			Pattern_Finish(pPattern, PATTERN_EVENT_CMPLT);
+		} else if(pPattern->Mode == PATTERN_MODE_STREAM)
+		{
+			// the DMA is on the other buffer now
+			pPattern->Buffers++;
+			if(DMA_GetCurrentTarget(&pTIMHandle->UpDMA) == 1)
+				Pattern_ApplicationEventCallback(pPattern, PATTERN_EVENT_BUFFER0_FREE);
+			else
+				Pattern_ApplicationEventCallback(pPattern, PATTERN_EVENT_BUFFER1_FREE);
+		}
+	}
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Pattern_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- PATTERN_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler. A stream buffer may be
+ * 				  refilled, or the next pattern started, from here.
+ ****************************************************************************/
+__attribute__((weak)) void Pattern_ApplicationEventCallback(Pattern_Handle_t *pPattern, uint8_t AppEv)
+{
+	(void)pPattern;
+	(void)AppEv;
+}
+
+static uint8_t Pattern_Claim(Pattern_Handle_t *pPattern)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t claimed = 0;
+
+	__disable_irq();
+	if(!pPattern->Busy)
+	{
+		pPattern->Busy = 1;
+		claimed = 1;
+	}
+	__set_PRIMASK(primask);
+	return claimed;
+}
+
+static void Pattern_Finish(Pattern_Handle_t *pPattern, uint8_t AppEv)
+{
+	TIM_PeripheralControl(pPattern->Config.pTIMHandle->pTIMx, DISABLE);
+	pPattern->Busy = 0;
+	Pattern_ApplicationEventCallback(pPattern, AppEv);
+}
@@ -0,0 +1,255 @@
+/*
+ * stm32f407xx_periph.c
+ *
+ * Peripheral instance descriptors, see stm32f407xx_periph.h
+ */
+#include "stm32f407xx_periph.h"
+
+/*
+ * The slot map covers APB1, APB2 and AHB1 (0x40000000 - 0x4002FFFF) in
+ * 1 KB slots. An entry is the instance number + 1 of the peripheral at the
+ * start of the slot, 0 for none. ADC1..3 share one slot, 0x100 apart: the
+ * address bits 8-9 select the instance (0 for every other peripheral).
+ */
+#define PERIPH_MAP_SIZE				0x30000U
+#define PERIPH_SLOT(BaseAddr)		(((BaseAddr) - PERIPH_BASEADDR) >> 10)
+#define PERIPH_SUB_SLOT(BaseAddr)	((((BaseAddr) - PERIPH_BASEADDR) >> 8) & 0x3)
+
+#define PERIPH_MAP(Name)			[PERIPH_SLOT(Name##_BASEADDR)] = PERIPH_ID_##Name + 1
+
+static const uint8_t Periph_SlotMap[PERIPH_MAP_SIZE >> 10] =
+{
+	PERIPH_MAP(GPIOA), PERIPH_MAP(GPIOB), PERIPH_MAP(GPIOC), PERIPH_MAP(GPIOD),
+	PERIPH_MAP(GPIOE), PERIPH_MAP(GPIOF), PERIPH_MAP(GPIOG), PERIPH_MAP(GPIOH),
+	PERIPH_MAP(GPIOI),
+	PERIPH_MAP(SPI1), PERIPH_MAP(SPI2), PERIPH_MAP(SPI3), PERIPH_MAP(SPI4),
+	PERIPH_MAP(I2C1), PERIPH_MAP(I2C2), PERIPH_MAP(I2C3),
+	PERIPH_MAP(USART1), PERIPH_MAP(USART2), PERIPH_MAP(USART3),
+	PERIPH_MAP(UART4), PERIPH_MAP(UART5), PERIPH_MAP(USART6),
+	PERIPH_MAP(TIM1), PERIPH_MAP(TIM2), PERIPH_MAP(TIM3), PERIPH_MAP(TIM4),
+	PERIPH_MAP(TIM5), PERIPH_MAP(TIM6), PERIPH_MAP(TIM7), PERIPH_MAP(TIM8),
+	PERIPH_MAP(TIM9), PERIPH_MAP(TIM10), PERIPH_MAP(TIM11), PERIPH_MAP(TIM12),
+	PERIPH_MAP(TIM13), PERIPH_MAP(TIM14),
+	PERIPH_MAP(ADC1),
+	PERIPH_MAP(DMA1), PERIPH_MAP(DMA2),
+	PERIPH_MAP(SYSCFG), PERIPH_MAP(PWR),
+};
+
+#define PERIPH_NO_DMA				{ 0, 0, 0 }
+
+/*
+ * Instance descriptors, in @PERIPH_ID order.
+ * DMA requests: where RM0090 offers two streams, the one used by this repo
+ * since the peripheral DMA support was added (no collisions between the
+ * USART, I2C, SPI and ADC defaults where avoidable).
+ */
+static const Periph_Instance_t Periph_Instances[PERIPH_NO_OF_INSTANCES] =
+{
+	//  base address		bus					en	rst	IRQ							IRQ2					RX (DMA, stream, channel)	TX (DMA, stream, channel)
+	{ GPIOA_BASEADDR,		PERIPH_BUS_AHB1,	0,	0,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ GPIOB_BASEADDR,		PERIPH_BUS_AHB1,	1,	1,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ GPIOC_BASEADDR,		PERIPH_BUS_AHB1,	2,	2,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ GPIOD_BASEADDR,		PERIPH_BUS_AHB1,	3,	3,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ GPIOE_BASEADDR,		PERIPH_BUS_AHB1,	4,	4,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ GPIOF_BASEADDR,		PERIPH_BUS_AHB1,	5,	5,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ GPIOG_BASEADDR,		PERIPH_BUS_AHB1,	6,	6,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ GPIOH_BASEADDR,		PERIPH_BUS_AHB1,	7,	7,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ GPIOI_BASEADDR,		PERIPH_BUS_AHB1,	8,	8,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+
+	{ SPI1_BASEADDR,		PERIPH_BUS_APB2,	12,	12,	IRQ_NO_SPI1,				PERIPH_NO_IRQ,			{ DMA2, 0, DMA_CHANNEL_3 },	{ DMA2, 3, DMA_CHANNEL_3 } },
+	{ SPI2_BASEADDR,		PERIPH_BUS_APB1,	14,	14,	IRQ_NO_SPI2,				PERIPH_NO_IRQ,			{ DMA1, 3, DMA_CHANNEL_0 },	{ DMA1, 4, DMA_CHANNEL_0 } },
+	{ SPI3_BASEADDR,		PERIPH_BUS_APB1,	15,	15,	IRQ_NO_SPI3,				PERIPH_NO_IRQ,			{ DMA1, 0, DMA_CHANNEL_0 },	{ DMA1, 5, DMA_CHANNEL_0 } },
+	{ SPI4_BASEADDR,		PERIPH_BUS_APB2,	13,	13,	IRQ_NO_SPI4,				PERIPH_NO_IRQ,			{ DMA2, 0, DMA_CHANNEL_4 },	{ DMA2, 1, DMA_CHANNEL_4 } },
+
+	{ I2C1_BASEADDR,		PERIPH_BUS_APB1,	21,	21,	IRQ_NO_I2C1_EV,				IRQ_NO_I2C1_ER,			{ DMA1, 0, DMA_CHANNEL_1 },	{ DMA1, 7, DMA_CHANNEL_1 } },
+	{ I2C2_BASEADDR,		PERIPH_BUS_APB1,	22,	22,	IRQ_NO_I2C2_EV,				IRQ_NO_I2C2_ER,			{ DMA1, 2, DMA_CHANNEL_7 },	{ DMA1, 7, DMA_CHANNEL_7 } },
+	{ I2C3_BASEADDR,		PERIPH_BUS_APB1,	23,	23,	IRQ_NO_I2C3_EV,				IRQ_NO_I2C3_ER,			{ DMA1, 2, DMA_CHANNEL_3 },	{ DMA1, 4, DMA_CHANNEL_3 } },
+
+	{ USART1_BASEADDR,		PERIPH_BUS_APB2,	4,	4,	IRQ_NO_USART1,				PERIPH_NO_IRQ,			{ DMA2, 2, DMA_CHANNEL_4 },	{ DMA2, 7, DMA_CHANNEL_4 } },
+	{ USART2_BASEADDR,		PERIPH_BUS_APB1,	17,	17,	IRQ_NO_USART2,				PERIPH_NO_IRQ,			{ DMA1, 5, DMA_CHANNEL_4 },	{ DMA1, 6, DMA_CHANNEL_4 } },
+	{ USART3_BASEADDR,		PERIPH_BUS_APB1,	18,	18,	IRQ_NO_USART3,				PERIPH_NO_IRQ,			{ DMA1, 1, DMA_CHANNEL_4 },	{ DMA1, 3, DMA_CHANNEL_4 } },
+	{ UART4_BASEADDR,		PERIPH_BUS_APB1,	19,	19,	IRQ_NO_UART4,				PERIPH_NO_IRQ,			{ DMA1, 2, DMA_CHANNEL_4 },	{ DMA1, 4, DMA_CHANNEL_4 } },
+	{ UART5_BASEADDR,		PERIPH_BUS_APB1,	20,	20,	IRQ_NO_UART5,				PERIPH_NO_IRQ,			{ DMA1, 0, DMA_CHANNEL_4 },	{ DMA1, 7, DMA_CHANNEL_4 } },
+	{ USART6_BASEADDR,		PERIPH_BUS_APB2,	5,	5,	IRQ_NO_USART6,				PERIPH_NO_IRQ,			{ DMA2, 1, DMA_CHANNEL_5 },	{ DMA2, 6, DMA_CHANNEL_5 } },
+
+	// timer DMA requests (update and capture/compare) are mapped in the TIM driver
+	{ TIM1_BASEADDR,		PERIPH_BUS_APB2,	0,	0,	IRQ_NO_TIM1_UP_TIM10,		IRQ_NO_TIM1_CC,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM2_BASEADDR,		PERIPH_BUS_APB1,	0,	0,	IRQ_NO_TIM2,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM3_BASEADDR,		PERIPH_BUS_APB1,	1,	1,	IRQ_NO_TIM3,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM4_BASEADDR,		PERIPH_BUS_APB1,	2,	2,	IRQ_NO_TIM4,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM5_BASEADDR,		PERIPH_BUS_APB1,	3,	3,	IRQ_NO_TIM5,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM6_BASEADDR,		PERIPH_BUS_APB1,	4,	4,	IRQ_NO_TIM6_DAC,			PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM7_BASEADDR,		PERIPH_BUS_APB1,	5,	5,	IRQ_NO_TIM7,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM8_BASEADDR,		PERIPH_BUS_APB2,	1,	1,	IRQ_NO_TIM8_UP_TIM13,		IRQ_NO_TIM8_CC,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM9_BASEADDR,		PERIPH_BUS_APB2,	16,	16,	IRQ_NO_TIM1_BRK_TIM9,		PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM10_BASEADDR,		PERIPH_BUS_APB2,	17,	17,	IRQ_NO_TIM1_UP_TIM10,		PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM11_BASEADDR,		PERIPH_BUS_APB2,	18,	18,	IRQ_NO_TIM1_TRG_COM_TIM11,	PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM12_BASEADDR,		PERIPH_BUS_APB1,	6,	6,	IRQ_NO_TIM8_BRK_TIM12,		PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM13_BASEADDR,		PERIPH_BUS_APB1,	7,	7,	IRQ_NO_TIM8_UP_TIM13,		PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ TIM14_BASEADDR,		PERIPH_BUS_APB1,	8,	8,	IRQ_NO_TIM8_TRG_COM_TIM14,	PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+
+	// one reset bit (ADCRST) for all ADCs
+	{ ADC1_BASEADDR,		PERIPH_BUS_APB2,	8,	8,	IRQ_NO_ADC,					PERIPH_NO_IRQ,			{ DMA2, 0, DMA_CHANNEL_0 },	PERIPH_NO_DMA },
+	{ ADC2_BASEADDR,		PERIPH_BUS_APB2,	9,	8,	IRQ_NO_ADC,					PERIPH_NO_IRQ,			{ DMA2, 3, DMA_CHANNEL_1 },	PERIPH_NO_DMA },
+	{ ADC3_BASEADDR,		PERIPH_BUS_APB2,	10,	8,	IRQ_NO_ADC,					PERIPH_NO_IRQ,			{ DMA2, 1, DMA_CHANNEL_2 },	PERIPH_NO_DMA },
+
+	// DMA interrupts are per stream, see DMA_GetIRQNumber
+	{ DMA1_BASEADDR,		PERIPH_BUS_AHB1,	21,	21,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ DMA2_BASEADDR,		PERIPH_BUS_AHB1,	22,	22,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+
+	{ SYSCFG_BASEADDR,		PERIPH_BUS_APB2,	14,	14,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+	{ PWR_BASEADDR,			PERIPH_BUS_APB1,	28,	28,	PERIPH_NO_IRQ,				PERIPH_NO_IRQ,			PERIPH_NO_DMA,				PERIPH_NO_DMA },
+};
+
+/**************************************************************************
+ * Instance lookup
+ * ************************************************************************
+ * @fn			- Periph_GetId
+ *
+ * @brief		- Instance number of a peripheral register block.
+ *
+ * @param[in]	- base address of the peripheral (SPI2, GPIOD, ...)
+ *
+ * @return		- @PERIPH_ID, PERIPH_NO_ID for an unknown address
+ *
+ * @Note		- Constant time: one slot map read and one compare.
+ ****************************************************************************/
+uint8_t Periph_GetId(const __vo void *pRegs)
+{
+	uint32_t addr = (uint32_t)pRegs;
+	uint8_t id;
+
+	if(addr - PERIPH_BASEADDR >= PERIPH_MAP_SIZE)
+		return PERIPH_NO_ID;
+
+	id = Periph_SlotMap[PERIPH_SLOT(addr)];
+	if(id == 0)
+		return PERIPH_NO_ID;
+
+	id = id - 1 + PERIPH_SUB_SLOT(addr);
+	if(id >= PERIPH_NO_OF_INSTANCES || Periph_Instances[id].BaseAddr != addr)
+		return PERIPH_NO_ID;
+
+	return id;
+}
+
+/**************************************************************************
+ * @fn			- Periph_Get
+ *
+ * @brief		- Descriptor of a peripheral register block.
+ *
+ * @param[in]	- base address of the peripheral (SPI2, GPIOD, ...)
+ *
+ * @return		- descriptor, 0 for an unknown address
+ ****************************************************************************/
+const Periph_Instance_t *Periph_Get(const __vo void *pRegs)
+{
+	return Periph_GetById(Periph_GetId(pRegs));
+}
+
+const Periph_Instance_t *Periph_GetById(uint8_t Id)
+{
+	return (Id < PERIPH_NO_OF_INSTANCES) ? &Periph_Instances[Id] : 0;
+}
+
+/**************************************************************************
+ * Peripheral Clock setup
+ * ************************************************************************
+ * @fn			- Periph_ClockControl
+ *
+ * @brief		- Enables or disables the peripheral clock (RCC xxxENR).
+ *
+ * @param[in]	- base address of the peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ *
+ * @return		- none
+ *
+ * @Note		- Unknown addresses are ignored.
+ ****************************************************************************/
+void Periph_ClockControl(const __vo void *pRegs, uint8_t EnorDi)
+{
+	const Periph_Instance_t *pInst = Periph_Get(pRegs);
+
+	if(pInst == 0)
+		return;
+
+	if(EnorDi == ENABLE)
+		(&RCC->AHB1ENR)[pInst->Bus] |= (1 << pInst->EnBit);
+	else
+		(&RCC->AHB1ENR)[pInst->Bus] &= ~(1 << pInst->EnBit);
+}
+
+/**************************************************************************
+ * Peripheral reset
+ * ************************************************************************
+ * @fn			- Periph_Reset
+ *
+ * @brief		- Resets all registers of the peripheral (RCC xxxRSTR
+ * 				  pulse).
+ *
+ * @param[in]	- base address of the peripheral
+ *
+ * @return		- none
+ *
+ * @Note		- ADC1..3 have one common reset: it resets all of them.
+ ****************************************************************************/
+void Periph_Reset(const __vo void *pRegs)
+{
+	const Periph_Instance_t *pInst = Periph_Get(pRegs);
+
+	if(pInst == 0)
+		return;
+
+	(&RCC->AHB1RSTR)[pInst->Bus] |= (1 << pInst->RstBit);
+	(&RCC->AHB1RSTR)[pInst->Bus] &= ~(1 << pInst->RstBit);
+}
+
+/**************************************************************************
+ * IRQ Configuration and ISR handling
+ * ************************************************************************
+ * @fn			- NVIC_IRQInterruptConfig
+ *
+ * @brief		- Enables or disables an interrupt in the NVIC.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- ENABLE or DISABLE macros
+ *
+ * @return		- none
+ *
+ * @Note		- ISER/ICER are write 1 to set/clear, other bits are not
+ * 				  affected (no read-modify-write needed).
+ ****************************************************************************/
+void NVIC_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	if(IRQNumber >= 96)
+		return;
+
+	if(EnorDi == ENABLE)
+		NVIC_ISER0[IRQNumber / 32] = (1 << (IRQNumber % 32));
+	else
+		NVIC_ICER0[IRQNumber / 32] = (1 << (IRQNumber % 32));
+}
+
+/**************************************************************************
+ * Priority Configuration
+ * ************************************************************************
+ * @fn			- NVIC_IRQPriorityConfig
+ *
+ * @brief		- Sets the priority of an interrupt.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- priority 0 (highest) .. 15, see @NVIC_IRQ_PRI
+ *
+ * @return		- none
+ *
+ * @Note		- Each IRQ has its own byte in the IPR registers; only the
+ * 				  upper NO_PR_BITS_IMPLEMENTED bits exist. A byte write
+ * 				  leaves the neighbouring IRQs alone.
+ ****************************************************************************/
+void NVIC_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority)
+{
+	if(IRQNumber >= 96)
+		return;
+
+	((__vo uint8_t*)NVIC_PR_BASE_ADDR)[IRQNumber] = (uint8_t)(IRQPriority << (8 - NO_PR_BITS_IMPLEMENTED));
+}
@@ -0,0 +1,304 @@
+/*
+ * stm32f407xx_prof.c
+ *
+ * Function level profiler, see stm32f407xx_prof.h
+ */
+#include <stdio.h>
+#include <string.h>
+#include "stm32f407xx_prof.h"
+
+#if (PROF_TRACE_SIZE & (PROF_TRACE_SIZE - 1)) != 0
+#error "PROF_TRACE_SIZE must be a power of 2"
+#endif
+
+#define PROF_TRACE_MASK				(PROF_TRACE_SIZE - 1)
+
+static Prof_Zone_t prof_zones[PROF_MAX_ZONES];
+static uint8_t prof_no_of_zones;
+
+static Prof_Event_t prof_trace[PROF_TRACE_SIZE];
+static uint32_t prof_trace_head;				// free running, events written
+
+// cycles of the counter read itself, subtracted from every measurement
+static uint32_t prof_overhead;
+
+// handler nesting depth and the counter at the outermost handler entry
+static __vo uint32_t prof_isr_nesting;
+static uint32_t prof_isr_start;
+
+// cycles spent in outermost driver handlers since Prof_Init
+__vo uint32_t prof_isr_cycles;
+
+/*
+ * Helper functions
+ */
+static uint8_t Prof_Register(const char *pName);
+static void Prof_Account(uint8_t Zone, uint32_t Cycles);
+static void Prof_TraceAdd(uint8_t Zone, uint8_t Event, uint32_t Cycles);
+static char *Prof_FormatU64(char *pBuffer, uint64_t Value);
+
+/**************************************************************************
+ * Initialize the profiler
+ * ************************************************************************
+ * @fn			- Prof_Init
+ *
+ * @brief		- Starts the DWT cycle counter and clears the zone table
+ * 				  and the trace.
+ *
+ * @return		- none
+ *
+ * @Note		- Call once before the first zone. The cycle counter runs
+ * 				  at HCLK and wraps after 2^32 cycles, longer zones are
+ * 				  not measured correctly.
+ ****************************************************************************/
+void Prof_Init(void)
+{
+	uint32_t start;
+
+	*DEMCR |= (1 << DEMCR_TRCENA);
+	*DWT_CYCCNT = 0;
+	*DWT_CTRL |= (1 << DWT_CTRL_CYCCNTENA);
+
+	start = *DWT_CYCCNT;
+	prof_overhead = *DWT_CYCCNT - start;
+
+	memset(prof_zones, 0, sizeof(prof_zones));
+	prof_no_of_zones = 0;
+	prof_trace_head = 0;
+	prof_isr_nesting = 0;
+	prof_isr_cycles = 0;
+}
+
+/**************************************************************************
+ * @fn			- Prof_Reset
+ *
+ * @brief		- Clears the statistics and the trace. The zones stay
+ * 				  registered (the call sites keep their index).
+ ****************************************************************************/
+void Prof_Reset(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	for(uint8_t i = 0; i < prof_no_of_zones; i++)
+	{
+		prof_zones[i].Count = 0;
+		prof_zones[i].Min = 0;
+		prof_zones[i].Max = 0;
+		prof_zones[i].Total = 0;
+	}
+	prof_trace_head = 0;
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Prof_End
+ *
+ * @brief		- End of a thread mode zone (PROF_ZONE_END). Registers the
+ * 				  zone on its first use.
+ *
+ * @param[in]	- zone index cache of the call site
+ * @param[in]	- zone name
+ * @param[in]	- stamp taken by PROF_ZONE_BEGIN
+ *
+ * @return		- none
+ ****************************************************************************/
+void Prof_End(uint8_t *pZone, const char *pName, Prof_Stamp_t *pStamp)
+{
+	uint32_t isr_cycles = prof_isr_cycles;
+	uint32_t cycles = *DWT_CYCCNT - pStamp->Cycles - (isr_cycles - pStamp->IsrCycles) - prof_overhead;
+
+	if(*pZone == PROF_NO_ZONE)
+		*pZone = Prof_Register(pName);
+	Prof_Account(*pZone, cycles);
+}
+
+/**************************************************************************
+ * @fn			- Prof_IsrBegin
+ *
+ * @brief		- Entry of a driver IRQ handling function (PROF_ISR_BEGIN).
+ *
+ * @param[in]	- zone index cache of the handler
+ * @param[in]	- zone name (function name)
+ * @param[in]	- stamp to fill
+ *
+ * @return		- none
+ ****************************************************************************/
+void Prof_IsrBegin(uint8_t *pZone, const char *pName, Prof_Stamp_t *pStamp)
+{
+	Prof_Begin(pStamp);
+
+	// a preempting handler returns before this one continues, so the
+	// increment and decrement pairs never interleave
+	if(prof_isr_nesting++ == 0)
+		prof_isr_start = pStamp->Cycles;
+
+	if(*pZone == PROF_NO_ZONE)
+		*pZone = Prof_Register(pName);
+	Prof_TraceAdd(*pZone, PROF_EVENT_ISR_ENTER, pStamp->Cycles);
+}
+
+/**************************************************************************
+ * @fn			- Prof_IsrEnd
+ *
+ * @brief		- Exit of a driver IRQ handling function (PROF_ISR_END).
+ *
+ * @param[in]	- zone index
+ * @param[in]	- stamp of Prof_IsrBegin
+ *
+ * @return		- none
+ ****************************************************************************/
+void Prof_IsrEnd(uint8_t Zone, Prof_Stamp_t *pStamp)
+{
+	uint32_t now = *DWT_CYCCNT;
+
+	Prof_Account(Zone, now - pStamp->Cycles - prof_overhead);
+	Prof_TraceAdd(Zone, PROF_EVENT_ISR_EXIT, now);
+
+	if(--prof_isr_nesting == 0)
+		prof_isr_cycles += now - prof_isr_start;
+}
+
+uint8_t Prof_GetZoneCount(void)
+{
+	return prof_no_of_zones;
+}
+
+const Prof_Zone_t *Prof_GetZone(uint8_t Index)
+{
+	return (Index < prof_no_of_zones) ? &prof_zones[Index] : 0;
+}
+
+/**************************************************************************
+ * Export
+ * ************************************************************************
+ * @fn			- Prof_Report
+ *
+ * @brief		- Prints the zone table as CSV through printf:
+ * 				  zone,count,min,max,avg,total (cycles)
+ *
+ * @return		- none
+ *
+ * @Note		- With the log module the report has to fit into the log
+ * 				  ring buffer (about 50 bytes per zone), or call
+ * 				  Log_Process in between.
+ ****************************************************************************/
+void Prof_Report(void)
+{
+	char total[21];
+
+	printf("zone,count,min,max,avg,total\n");
+	for(uint8_t i = 0; i < prof_no_of_zones; i++)
+	{
+		Prof_Zone_t zone;
+		uint32_t primask = __get_PRIMASK();
+
+		// consistent copy, handlers may update the row
+		__disable_irq();
+		zone = prof_zones[i];
+		__set_PRIMASK(primask);
+
+		printf("%s,%lu,%lu,%lu,%lu,%s\n", zone.pName, (unsigned long)zone.Count,
+				(unsigned long)zone.Min, (unsigned long)zone.Max,
+				(unsigned long)(zone.Count ? zone.Total / zone.Count : 0),
+				Prof_FormatU64(total, zone.Total));
+	}
+}
+
+/**************************************************************************
+ * @fn			- Prof_ReportTrace
+ *
+ * @brief		- Prints the last PROF_TRACE_SIZE handler entries and exits,
+ * 				  oldest first: cycles,event,zone
+ ****************************************************************************/
+void Prof_ReportTrace(void)
+{
+	uint32_t head = prof_trace_head;
+	uint32_t first = (head > PROF_TRACE_SIZE) ? head - PROF_TRACE_SIZE : 0;
+
+	printf("cycles,event,zone\n");
+	for(uint32_t i = first; i < head; i++)
+	{
+		Prof_Event_t *pEvent = &prof_trace[i & PROF_TRACE_MASK];
+
+		printf("%lu,%s,%s\n", (unsigned long)pEvent->Cycles,
+				(pEvent->Event == PROF_EVENT_ISR_ENTER) ? "enter" : "exit",
+				(pEvent->Zone < prof_no_of_zones) ? prof_zones[pEvent->Zone].pName : "?");
+	}
+}
+
+/*
+ * Zone table row of a name. The first call of a call site adds the row,
+ * PROF_NO_ZONE when the table is full (the zone is then not measured).
+ */
+static uint8_t Prof_Register(const char *pName)
+{
+	uint8_t zone = PROF_NO_ZONE;
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	for(uint8_t i = 0; i < prof_no_of_zones; i++)
+	{
+		if(strcmp(prof_zones[i].pName, pName) == 0)
+		{
+			zone = i;
+			break;
+		}
+	}
+	if(zone == PROF_NO_ZONE && prof_no_of_zones < PROF_MAX_ZONES)
+	{
+		zone = prof_no_of_zones++;
+		prof_zones[zone].pName = pName;
+	}
+	__set_PRIMASK(primask);
+
+	return zone;
+}
+
+static void Prof_Account(uint8_t Zone, uint32_t Cycles)
+{
+	Prof_Zone_t *pZone;
+	uint32_t primask;
+
+	if(Zone >= prof_no_of_zones)
+		return;
+
+	pZone = &prof_zones[Zone];
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if(pZone->Count == 0 || Cycles < pZone->Min)
+		pZone->Min = Cycles;
+	if(Cycles > pZone->Max)
+		pZone->Max = Cycles;
+	pZone->Total += Cycles;
+	pZone->Count++;
+	__set_PRIMASK(primask);
+}
+
+static void Prof_TraceAdd(uint8_t Zone, uint8_t Event, uint32_t Cycles)
+{
+	Prof_Event_t *pEvent;
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	pEvent = &prof_trace[prof_trace_head++ & PROF_TRACE_MASK];
+	pEvent->Cycles = Cycles;
+	pEvent->Zone = Zone;
+	pEvent->Event = Event;
+	__set_PRIMASK(primask);
+}
+
+// decimal string of a 64-bit value (newlib-nano printf has no %llu)
+static char *Prof_FormatU64(char *pBuffer, uint64_t Value)
+{
+	char *p = pBuffer + 20;
+
+	*p = '\0';
+	do
+	{
+		*--p = '0' + (Value % 10);
+		Value /= 10;
+	} while(Value);
+
+	return p;
+}
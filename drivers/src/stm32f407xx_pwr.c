@@ -0,0 +1,256 @@
+/*
+ * stm32f407xx_pwr.c
+ *
+ * Low-power mode manager, see stm32f407xx_pwr.h
+ */
+#include <string.h>
+#include "stm32f407xx_pwr.h"
+
+static Pwr_Config_t pwr_config;
+static Pwr_Stats_t pwr_stats;
+
+// drivers with a transfer in flight
+static uint32_t pwr_stop_vetoes;
+
+/*
+ * Helper functions
+ */
+static uint8_t Pwr_StopAllowed(void);
+static void Pwr_RestoreClocks(uint32_t RccCr, uint32_t RccCfgr);
+
+/**************************************************************************
+ * Initialize the power manager
+ * ************************************************************************
+ * @fn			- Pwr_Init
+ *
+ * @brief		- Turns on the PWR interface clock, starts the DWT cycle
+ * 				  counter (wake latency) and clears the statistics.
+ *
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- none
+ *
+ * @Note		- Vetoes taken before Pwr_Init are kept.
+ ****************************************************************************/
+void Pwr_Init(Pwr_Config_t *pPwrConfig)
+{
+	Clk_Request(PWR);
+
+	*DEMCR |= (1 << DEMCR_TRCENA);
+	*DWT_CTRL |= (1 << DWT_CTRL_CYCCNTENA);
+
+	pwr_config = *pPwrConfig;
+	memset(&pwr_stats, 0, sizeof(pwr_stats));
+
+	// never power down in deep sleep, Stop is the deepest mode used
+	PWR->CR &= ~(1 << PWR_CR_PDDS);
+}
+
+/**************************************************************************
+ * Driver activity
+ * ************************************************************************
+ * @fn			- Pwr_VetoStop
+ *
+ * @brief		- Called by a driver when a transfer starts: Stop mode is
+ * 				  not used until the matching Pwr_ReleaseStop, and the
+ * 				  peripheral clock keeps running in sleep mode.
+ *
+ * @param[in]	- base address of the peripheral (SPI2, DMA1, ...) or 0
+ *
+ * @return		- none
+ *
+ * @Note		- May be called from interrupt handlers.
+ ****************************************************************************/
+void Pwr_VetoStop(const __vo void *pRegs)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	pwr_stop_vetoes++;
+	__set_PRIMASK(primask);
+
+	Clk_SleepRequest(pRegs);
+}
+
+/**************************************************************************
+ * @fn			- Pwr_ReleaseStop
+ *
+ * @brief		- Called by a driver when its transfer is complete (or
+ * 				  aborted). Undoes one Pwr_VetoStop.
+ *
+ * @param[in]	- base address of the peripheral or 0, as for Pwr_VetoStop
+ *
+ * @return		- none
+ *
+ * @Note		- A release without a veto is ignored.
+ ****************************************************************************/
+void Pwr_ReleaseStop(const __vo void *pRegs)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t held = 0;
+
+	__disable_irq();
+	if(pwr_stop_vetoes != 0)
+	{
+		pwr_stop_vetoes--;
+		held = 1;
+	}
+	__set_PRIMASK(primask);
+
+	if(held)
+		Clk_SleepRelease(pRegs);
+}
+
+/**************************************************************************
+ * @fn			- Pwr_GetAllowedMode
+ *
+ * @brief		- Deepest mode Pwr_Idle would use right now.
+ *
+ * @return		- @PWR_MODE
+ ****************************************************************************/
+uint8_t Pwr_GetAllowedMode(void)
+{
+	return Pwr_StopAllowed() ? PWR_MODE_STOP : PWR_MODE_SLEEP;
+}
+
+/**************************************************************************
+ * Idle
+ * ************************************************************************
+ * @fn			- Pwr_Idle
+ *
+ * @brief		- Enters the deepest allowed mode, not deeper than MaxMode,
+ * 				  and returns after the next interrupt (Sleep) or EXTI
+ * 				  event (Stop). The interrupt handler runs before Pwr_Idle
+ * 				  returns.
+ *
+ * 				  Stop is not used (the CPU only sleeps) while a driver
+ * 				  holds a veto, when no EXTI line is unmasked (nothing
+ * 				  could wake the CPU up) or when Stop already took longer
+ * 				  to wake up than Pwr_MaxWakeCycles.
+ *
+ * @param[in]	- deepest mode the caller accepts, @PWR_MODE
+ *
+ * @return		- mode entered, @PWR_MODE
+ *
+ * @Note		- Thread mode only. The check and the WFI run with
+ * 				  interrupts masked, so an interrupt which sets up new work
+ * 				  just before can not be slept through: WFI returns at once.
+ ****************************************************************************/
+uint8_t Pwr_Idle(uint8_t MaxMode)
+{
+	uint32_t primask;
+	uint32_t rcc_cr = 0, rcc_cfgr = 0;
+	uint32_t wake, cycles;
+	uint8_t mode = MaxMode;
+
+	if(mode == PWR_MODE_RUN)
+		return PWR_MODE_RUN;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(mode == PWR_MODE_STOP && !Pwr_StopAllowed())
+	{
+		mode = PWR_MODE_SLEEP;
+		pwr_stats.StopVetoed++;
+	}
+
+	if(mode == PWR_MODE_STOP)
+	{
+		uint32_t tempreg = PWR->CR;
+
+		// the CPU wakes up on HSI
+		rcc_cr = RCC->CR;
+		rcc_cfgr = RCC->CFGR;
+
+		tempreg &= ~((1 << PWR_CR_PDDS) | (1 << PWR_CR_LPDS) | (1 << PWR_CR_FPDS));
+		tempreg |= (uint32_t)pwr_config.Pwr_StopRegulator << PWR_CR_LPDS;
+		if(pwr_config.Pwr_FlashPowerDown == ENABLE)
+			tempreg |= (1 << PWR_CR_FPDS);
+		PWR->CR = tempreg | (1 << PWR_CR_CWUF);
+
+		*SCB_SCR |= (1 << SCB_SCR_SLEEPDEEP);
+		pwr_stats.Stops++;
+	} else
+	{
+		*SCB_SCR &= ~(1 << SCB_SCR_SLEEPDEEP);
+		pwr_stats.Sleeps++;
+	}
+
+	__DSB();
+	__WFI();
+	wake = *DWT_CYCCNT;
+
+	if(mode == PWR_MODE_STOP)
+	{
+		*SCB_SCR &= ~(1 << SCB_SCR_SLEEPDEEP);
+		Pwr_RestoreClocks(rcc_cr, rcc_cfgr);
+	}
+
+	cycles = *DWT_CYCCNT - wake;
+	pwr_stats.LastWakeCycles[mode - 1] = cycles;
+	if(cycles > pwr_stats.MaxWakeCycles[mode - 1])
+		pwr_stats.MaxWakeCycles[mode - 1] = cycles;
+
+	// the pending interrupt is taken here
+	__set_PRIMASK(primask);
+
+	return mode;
+}
+
+/**************************************************************************
+ * Statistics
+ * ************************************************************************
+ * @fn			- Pwr_GetStats
+ *
+ * @brief		- Copies the mode counters and wake latencies.
+ *
+ * @param[in]	- destination
+ *
+ * @return		- none
+ ****************************************************************************/
+void Pwr_GetStats(Pwr_Stats_t *pStats)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*pStats = pwr_stats;
+	__set_PRIMASK(primask);
+}
+
+static uint8_t Pwr_StopAllowed(void)
+{
+	if(pwr_stop_vetoes != 0)
+		return 0;
+
+	// Stop needs a wake up source
+	if((EXTI->IMR | EXTI->EMR) == 0)
+		return 0;
+
+	if(pwr_config.Pwr_MaxWakeCycles != 0 && pwr_stats.MaxWakeCycles[PWR_MODE_STOP - 1] > pwr_config.Pwr_MaxWakeCycles)
+		return 0;
+
+	return 1;
+}
+
+// restarts HSE and the main PLL and switches the system clock back after Stop
+static void Pwr_RestoreClocks(uint32_t RccCr, uint32_t RccCfgr)
+{
+	uint32_t sw = (RccCfgr >> RCC_CFGR_SW) & 0x3;
+
+	if(RccCr & (1 << RCC_CR_HSEON))
+	{
+		RCC->CR |= (1 << RCC_CR_HSEON);
+		while(!(RCC->CR & (1 << RCC_CR_HSERDY)));
+	}
+	if(RccCr & (1 << RCC_CR_PLLON))
+	{
+		RCC->CR |= (1 << RCC_CR_PLLON);
+		while(!(RCC->CR & (1 << RCC_CR_PLLRDY)));
+	}
+	if(((RCC->CFGR >> RCC_CFGR_SWS) & 0x3) != sw)
+	{
+		RCC->CFGR = (RCC->CFGR & ~(0x3 << RCC_CFGR_SW)) | (sw << RCC_CFGR_SW);
+		while(((RCC->CFGR >> RCC_CFGR_SWS) & 0x3) != sw);
+	}
+}
@@ -0,0 +1,121 @@
+// In driver.c, you have to include respective peripheral's driver file.
+#include "stm32f407xx_rcc_driver.h"
+
+// HPRE field 8..15 -> divide by 2..512 (divide by 32 does not exist)
+static const uint16_t AHB_PreScaler[8] = { 2, 4, 8, 16, 64, 128, 256, 512 };
+// PPREx field 4..7 -> divide by 2..16
+static const uint8_t APB_PreScaler[4] = { 2, 4, 8, 16 };
+
+/**************************************************************************
+ * PLL output clock
+ * ************************************************************************
+ * @fn			- RCC_GetPLLOutputClock
+ *
+ * @brief		- Calculates the main PLL output from PLLCFGR:
+ * 				  f(PLL) = f(source) / PLLM * PLLN / PLLP
+ *
+ * @return		- PLL output clock in Hz
+ *
+ * @Note		- none
+ ****************************************************************************/
+uint32_t RCC_GetPLLOutputClock(void)
+{
+	uint32_t pllcfgr = RCC->PLLCFGR;
+	uint32_t source, pllm, plln, pllp;
+
+	source = (pllcfgr & (1 << RCC_PLLCFGR_PLLSRC)) ? RCC_HSE_VALUE : RCC_HSI_VALUE;
+	pllm = (pllcfgr >> RCC_PLLCFGR_PLLM) & 0x3F;
+	plln = (pllcfgr >> RCC_PLLCFGR_PLLN) & 0x1FF;
+	pllp = (((pllcfgr >> RCC_PLLCFGR_PLLP) & 0x3) + 1) * 2;
+
+	if(pllm == 0)
+		return 0;
+
+	// Divide first, VCO input is 1..2 MHz so no precision is lost.
+	return ((source / pllm) * plln) / pllp;
+}
+
+/**************************************************************************
+ * System clock
+ * ************************************************************************
+ * @fn			- RCC_GetSYSCLKValue
+ *
+ * @brief		- Reads which clock is used as system clock (SWS).
+ *
+ * @return		- SYSCLK in Hz
+ *
+ * @Note		- none
+ ****************************************************************************/
+uint32_t RCC_GetSYSCLKValue(void)
+{
+	uint8_t clksrc = (RCC->CFGR >> RCC_CFGR_SWS) & 0x3;
+
+	if(clksrc == 0)
+		return RCC_HSI_VALUE;
+	else if(clksrc == 1)
+		return RCC_HSE_VALUE;
+	else
+		return RCC_GetPLLOutputClock();
+}
+
+/**************************************************************************
+ * AHB clock
+ * ************************************************************************
+ * @fn			- RCC_GetHCLKValue
+ *
+ * @brief		- SYSCLK divided by the AHB prescaler.
+ *
+ * @return		- HCLK in Hz
+ ****************************************************************************/
+uint32_t RCC_GetHCLKValue(void)
+{
+	uint8_t temp = (RCC->CFGR >> RCC_CFGR_HPRE) & 0xF;
+	uint16_t ahbp = 1;
+
+	if(temp >= 8)
+		ahbp = AHB_PreScaler[temp - 8];
+
+	return RCC_GetSYSCLKValue() / ahbp;
+}
+
+/**************************************************************************
+ * APB1 clock
+ * ************************************************************************
+ * @fn			- RCC_GetPCLK1Value
+ *
+ * @brief		- HCLK divided by the APB1 prescaler.
+ * 				  (I2Cx, SPI2/3, USART2/3, UART4/5, TIM2-7/12-14)
+ *
+ * @return		- PCLK1 in Hz
+ ****************************************************************************/
+uint32_t RCC_GetPCLK1Value(void)
+{
+	uint8_t temp = (RCC->CFGR >> RCC_CFGR_PPRE1) & 0x7;
+	uint8_t apb1p = 1;
+
+	if(temp >= 4)
+		apb1p = APB_PreScaler[temp - 4];
+
+	return RCC_GetHCLKValue() / apb1p;
+}
+
+/**************************************************************************
+ * APB2 clock
+ * ************************************************************************
+ * @fn			- RCC_GetPCLK2Value
+ *
+ * @brief		- HCLK divided by the APB2 prescaler.
+ * 				  (SPI1/4, USART1/6, ADCx, TIM1/8-11)
+ *
+ * @return		- PCLK2 in Hz
+ ****************************************************************************/
+uint32_t RCC_GetPCLK2Value(void)
+{
+	uint8_t temp = (RCC->CFGR >> RCC_CFGR_PPRE2) & 0x7;
+	uint8_t apb2p = 1;
+
+	if(temp >= 4)
+		apb2p = APB_PreScaler[temp - 4];
+
+	return RCC_GetHCLKValue() / apb2p;
+}
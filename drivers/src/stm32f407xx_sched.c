@@ -0,0 +1,377 @@
+/*
+ * stm32f407xx_sched.c
+ *
+ * Run-to-completion event scheduler, see stm32f407xx_sched.h
+ */
+#include <string.h>
+#include "stm32f407xx_sched.h"
+
+#if (SCHED_QUEUE_SIZE & (SCHED_QUEUE_SIZE - 1)) != 0
+#error "SCHED_QUEUE_SIZE must be a power of 2"
+#endif
+
+typedef struct
+{
+	Sched_Event_t Events[SCHED_QUEUE_SIZE];
+	uint32_t Head;					/* written by Sched_Post */
+	uint32_t Tail;					/* written by the dispatcher */
+} Sched_Queue_t;
+
+static Sched_Queue_t sched_queues[SCHED_NO_OF_PRIORITIES];
+static Sched_Stats_t sched_stats;
+static uint8_t sched_idle_mode;
+
+static __vo uint32_t sched_ticks;
+static Sched_Timer_t *sched_timers;
+
+/*
+ * Helper functions
+ */
+static uint8_t Sched_Take(Sched_Event_t *pEvent);
+static void Sched_Idle(void);
+static void Sched_TimerUnlink(Sched_Timer_t *pTimer);
+
+/**************************************************************************
+ * Initialize the scheduler
+ * ************************************************************************
+ * @fn			- Sched_Init
+ *
+ * @brief		- Empties the queues and the timer list, clears the
+ * 				  statistics and starts the DWT cycle counter.
+ *
+ * @param[in]	- deepest mode while idle, @PWR_MODE (PWR_MODE_RUN: spin)
+ *
+ * @return		- none
+ *
+ * @Note		- With PWR_MODE_SLEEP/STOP call Pwr_Init first.
+ ****************************************************************************/
+void Sched_Init(uint8_t IdleMode)
+{
+	*DEMCR |= (1 << DEMCR_TRCENA);
+	*DWT_CTRL |= (1 << DWT_CTRL_CYCCNTENA);
+
+	memset(sched_queues, 0, sizeof(sched_queues));
+	memset(&sched_stats, 0, sizeof(sched_stats));
+	sched_idle_mode = IdleMode;
+	sched_ticks = 0;
+	sched_timers = 0;
+}
+
+/**************************************************************************
+ * Events
+ * ************************************************************************
+ * @fn			- Sched_Post
+ *
+ * @brief		- Queues a call of Handler(Arg) at the given priority.
+ *
+ * @param[in]	- handler
+ * @param[in]	- argument passed to the handler
+ * @param[in]	- @SCHED_PRIORITY
+ *
+ * @return		- 1 if queued, 0 if the queue of the priority was full
+ *
+ * @Note		- May be called from interrupt handlers. Events of one
+ * 				  priority are dispatched in the order they were posted.
+ ****************************************************************************/
+uint8_t Sched_Post(Sched_Handler_t Handler, uint32_t Arg, uint8_t Priority)
+{
+	Sched_Queue_t *pQueue;
+	Sched_Event_t *pEvent;
+	uint32_t primask, depth;
+
+	if(Priority >= SCHED_NO_OF_PRIORITIES)
+		Priority = SCHED_NO_OF_PRIORITIES - 1;
+	pQueue = &sched_queues[Priority];
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	depth = pQueue->Head - pQueue->Tail;
+	if(depth == SCHED_QUEUE_SIZE)
+	{
+		sched_stats.Dropped[Priority]++;
+		__set_PRIMASK(primask);
+		return 0;
+	}
+
+	pEvent = &pQueue->Events[pQueue->Head & (SCHED_QUEUE_SIZE - 1)];
+	pEvent->Handler = Handler;
+	pEvent->Arg = Arg;
+	pEvent->PostCycles = *DWT_CYCCNT;
+	pQueue->Head++;
+
+	sched_stats.Posted[Priority]++;
+	if(depth + 1 > sched_stats.MaxDepth[Priority])
+		sched_stats.MaxDepth[Priority] = depth + 1;
+
+	__set_PRIMASK(primask);
+	return 1;
+}
+
+/**************************************************************************
+ * @fn			- Sched_Pending
+ *
+ * @brief		- Tells whether an event is waiting.
+ *
+ * @return		- 1 if at least one queue is not empty, else 0
+ ****************************************************************************/
+uint8_t Sched_Pending(void)
+{
+	for(uint8_t prio = 0; prio < SCHED_NO_OF_PRIORITIES; prio++)
+	{
+		if(sched_queues[prio].Head != sched_queues[prio].Tail)
+			return 1;
+	}
+	return 0;
+}
+
+/**************************************************************************
+ * Main loop
+ * ************************************************************************
+ * @fn			- Sched_RunOnce
+ *
+ * @brief		- Dispatches the oldest event of the highest priority.
+ *
+ * @return		- 1 if a handler ran, 0 if all queues were empty
+ *
+ * @Note		- Thread mode only. For main loops which do more than
+ * 				  Sched_Run.
+ ****************************************************************************/
+uint8_t Sched_RunOnce(void)
+{
+	Sched_Event_t event;
+	uint32_t start, run;
+	uint8_t prio = Sched_Take(&event);
+
+	if(prio == SCHED_NO_OF_PRIORITIES)
+		return 0;
+
+	start = *DWT_CYCCNT;
+	event.Handler(event.Arg);
+	run = *DWT_CYCCNT - start;
+
+	if(start - event.PostCycles > sched_stats.MaxLatency[prio])
+		sched_stats.MaxLatency[prio] = start - event.PostCycles;
+	if(run > sched_stats.MaxRunCycles[prio])
+		sched_stats.MaxRunCycles[prio] = run;
+
+	return 1;
+}
+
+/**************************************************************************
+ * @fn			- Sched_Run
+ *
+ * @brief		- Dispatches events forever, idles in low-power mode when
+ * 				  there are none.
+ *
+ * @return		- does not return
+ ****************************************************************************/
+void Sched_Run(void)
+{
+	while(1)
+	{
+		if(!Sched_RunOnce())
+			Sched_Idle();
+	}
+}
+
+/**************************************************************************
+ * Deferred calls
+ * ************************************************************************
+ * @fn			- Sched_Tick
+ *
+ * @brief		- Advances the scheduler time by one tick and posts the
+ * 				  events of the timers which expired.
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from a periodic interrupt handler. The timer
+ * 				  handlers run later, from Sched_Run. A timer whose queue
+ * 				  is full stays expired and is posted on a later tick
+ * 				  (TimerRetries), its event is late but not lost.
+ ****************************************************************************/
+void Sched_Tick(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	Sched_Timer_t *pTimer, *pNext;
+	uint32_t now;
+
+	__disable_irq();
+	now = ++sched_ticks;
+
+	for(pTimer = sched_timers; pTimer != 0; pTimer = pNext)
+	{
+		pNext = pTimer->pNext;
+		if((int32_t)(now - pTimer->Expiry) < 0)
+			continue;
+
+		// queue full: the timer stays expired and posts on the next tick
+		if(!Sched_Post(pTimer->Handler, pTimer->Arg, pTimer->Priority))
+		{
+			sched_stats.TimerRetries[pTimer->Priority]++;
+			continue;
+		}
+		if(pTimer->Period != 0)
+			pTimer->Expiry += pTimer->Period;
+		else
+			Sched_TimerUnlink(pTimer);
+	}
+
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Sched_GetTicks
+ *
+ * @brief		- Number of Sched_Tick calls since Sched_Init.
+ *
+ * @return		- ticks (wraps around)
+ ****************************************************************************/
+uint32_t Sched_GetTicks(void)
+{
+	return sched_ticks;
+}
+
+/**************************************************************************
+ * @fn			- Sched_TimerInit
+ *
+ * @brief		- Sets the event a timer posts. The timer is stopped.
+ *
+ * @param[in]	- pointer to the timer
+ * @param[in]	- handler
+ * @param[in]	- argument passed to the handler
+ * @param[in]	- @SCHED_PRIORITY
+ *
+ * @return		- none
+ ****************************************************************************/
+void Sched_TimerInit(Sched_Timer_t *pTimer, Sched_Handler_t Handler, uint32_t Arg, uint8_t Priority)
+{
+	Sched_TimerStop(pTimer);
+
+	pTimer->Handler = Handler;
+	pTimer->Arg = Arg;
+	pTimer->Priority = (Priority < SCHED_NO_OF_PRIORITIES) ? Priority : SCHED_NO_OF_PRIORITIES - 1;
+	pTimer->Period = 0;
+}
+
+/**************************************************************************
+ * @fn			- Sched_TimerStart
+ *
+ * @brief		- (Re)starts a timer: its event is posted Delay ticks from
+ * 				  now, then every Period ticks.
+ *
+ * @param[in]	- pointer to the timer
+ * @param[in]	- ticks until the first event (0 and 1: next tick)
+ * @param[in]	- ticks between the following events, 0 for one shot
+ *
+ * @return		- none
+ *
+ * @Note		- May be called from interrupt handlers and timer handlers.
+ ****************************************************************************/
+void Sched_TimerStart(Sched_Timer_t *pTimer, uint32_t Delay, uint32_t Period)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	Sched_TimerUnlink(pTimer);
+
+	pTimer->Expiry = sched_ticks + (Delay ? Delay : 1);
+	pTimer->Period = Period;
+	pTimer->pNext = sched_timers;
+	sched_timers = pTimer;
+
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * @fn			- Sched_TimerStop
+ *
+ * @brief		- Stops a timer. An event it has posted already still runs.
+ *
+ * @param[in]	- pointer to the timer
+ *
+ * @return		- none
+ ****************************************************************************/
+void Sched_TimerStop(Sched_Timer_t *pTimer)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	Sched_TimerUnlink(pTimer);
+	__set_PRIMASK(primask);
+}
+
+/**************************************************************************
+ * Statistics
+ * ************************************************************************
+ * @fn			- Sched_GetStats
+ *
+ * @brief		- Copies the per priority counters and worst cases.
+ *
+ * @param[in]	- destination
+ *
+ * @return		- none
+ ****************************************************************************/
+void Sched_GetStats(Sched_Stats_t *pStats)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*pStats = sched_stats;
+	__set_PRIMASK(primask);
+}
+
+// removes the oldest event of the highest priority, returns its priority
+// (SCHED_NO_OF_PRIORITIES if there was none)
+static uint8_t Sched_Take(Sched_Event_t *pEvent)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t prio;
+
+	__disable_irq();
+	for(prio = 0; prio < SCHED_NO_OF_PRIORITIES; prio++)
+	{
+		Sched_Queue_t *pQueue = &sched_queues[prio];
+
+		if(pQueue->Head != pQueue->Tail)
+		{
+			*pEvent = pQueue->Events[pQueue->Tail & (SCHED_QUEUE_SIZE - 1)];
+			pQueue->Tail++;
+			break;
+		}
+	}
+	__set_PRIMASK(primask);
+
+	return prio;
+}
+
+// Low-power wait. The queues are checked with interrupts masked: an event
+// posted after the check leaves its interrupt pending, so WFI returns.
+static void Sched_Idle(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if(!Sched_Pending())
+	{
+		sched_stats.Idles++;
+		Pwr_Idle(sched_idle_mode);
+	}
+	__set_PRIMASK(primask);
+}
+
+// takes a timer out of the running list, called with interrupts masked
+static void Sched_TimerUnlink(Sched_Timer_t *pTimer)
+{
+	Sched_Timer_t **ppLink;
+
+	for(ppLink = &sched_timers; *ppLink != 0; ppLink = &(*ppLink)->pNext)
+	{
+		if(*ppLink == pTimer)
+		{
+			*ppLink = pTimer->pNext;
+			break;
+		}
+	}
+	pTimer->pNext = 0;
+}
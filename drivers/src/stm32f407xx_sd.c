@@ -0,0 +1,906 @@
+/*
+ * stm32f407xx_sd.c
+ *
+ * SD card (SPI mode) driver, see stm32f407xx_sd.h
+ */
+#include <string.h>
+#include "stm32f407xx_sd.h"
+
+/*
+ * Operations
+ */
+#define SD_OP_NONE					0
+#define SD_OP_READ					1
+#define SD_OP_WRITE					2
+#define SD_OP_FLUSH					3
+#define SD_OP_WRITE_BACK			4 // cache full or in the way, not reported
+
+/*
+ * Operation phases, each one is a DMA transfer (or a wait)
+ */
+#define SD_PHASE_IDLE				0
+#define SD_PHASE_CMD				1 // command frame and the first response byte
+#define SD_PHASE_R1					2 // R1 poll
+#define SD_PHASE_TOKEN				3 // read data token poll
+#define SD_PHASE_READ_DATA			4 // one block
+#define SD_PHASE_READ_CRC			5
+#define SD_PHASE_WRITE_TOKEN		6 // gap byte and start token
+#define SD_PHASE_WRITE_DATA			7 // one block
+#define SD_PHASE_WRITE_RESP			8 // CRC16 and data response
+#define SD_PHASE_BUSY				9 // programming busy poll
+#define SD_PHASE_STOP				10 // CMD12 and R1, or the stop token
+#define SD_PHASE_RELEASE			11 // 8 clocks after chip select: the card lets MISO go
+#define SD_PHASE_WAIT				12 // slow poll, timer running
+
+#define SD_NCR_MAX					8 // bytes until R1
+#define SD_BUSY_POLL_LEN			4 // ready when the last one reads 0xFF
+#define SD_INIT_TRIES				2000 // ACMD41 attempts, about a second at 400 kHz
+
+/*
+ * CRC16-CCITT (x^16 + x^12 + x^5 + 1) of the data blocks
+ */
+static const uint16_t Sd_Crc16Table[256] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+	0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+	0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+	0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+	0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+	0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+	0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+	0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+	0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+	0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+	0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+	0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+	0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+	0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+	0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+	0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+	0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+	0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+	0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+	0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+	0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+	0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+/*
+ * Helper functions
+ */
+static uint8_t Sd_Submit(Sd_Handle_t *pSd, uint8_t Op, uint32_t Lba, uint8_t *pData, uint32_t Count);
+static void Sd_Begin(Sd_Handle_t *pSd, uint8_t Op, uint32_t Lba, uint8_t *pData, uint32_t Count);
+static void Sd_Defer(Sd_Handle_t *pSd, uint8_t Op, uint32_t Lba, uint8_t *pData, uint32_t Count);
+static uint8_t Sd_CacheWrite(Sd_Handle_t *pSd, uint32_t Lba, uint8_t *pData, uint32_t Count);
+static uint8_t Sd_CacheOverlap(Sd_Handle_t *pSd, uint32_t Lba, uint32_t Count);
+static void Sd_Select(Sd_Handle_t *pSd);
+static void Sd_Deselect(Sd_Handle_t *pSd);
+static void Sd_Exchange(Sd_Handle_t *pSd, uint8_t *pTx, uint8_t *pRx, uint32_t Len);
+static void Sd_SetCommand(Sd_Handle_t *pSd, uint8_t Cmd, uint32_t Arg);
+static void Sd_StartCommand(Sd_Handle_t *pSd, uint8_t Cmd);
+static void Sd_Response(Sd_Handle_t *pSd, uint8_t R1);
+static void Sd_StartWait(Sd_Handle_t *pSd, uint8_t Phase);
+static void Sd_Poll(Sd_Handle_t *pSd, uint8_t Phase);
+static void Sd_PollNow(Sd_Handle_t *pSd, uint8_t Phase);
+static void Sd_WriteToken(Sd_Handle_t *pSd);
+static void Sd_Stop(Sd_Handle_t *pSd);
+static void Sd_Release(Sd_Handle_t *pSd);
+static void Sd_Fail(Sd_Handle_t *pSd);
+static uint8_t Sd_OpEvent(uint8_t Op);
+static void Sd_Finish(Sd_Handle_t *pSd, uint8_t AppEv);
+static void Sd_TimerHandler(uint32_t Arg);
+static void Sd_DoneHandler(uint32_t Arg);
+static uint8_t Sd_Crc7(const uint8_t *pData, uint32_t Len);
+static uint16_t Sd_Crc16(const uint8_t *pData, uint32_t Len);
+static uint8_t Sd_SclkSpeed(Sd_Handle_t *pSd, uint32_t MaxHz);
+static uint8_t Sd_Byte(Sd_Handle_t *pSd, uint8_t Out);
+static uint8_t Sd_CommandStart(Sd_Handle_t *pSd, uint8_t Cmd, uint32_t Arg);
+static void Sd_CommandEnd(Sd_Handle_t *pSd);
+static uint8_t Sd_Command(Sd_Handle_t *pSd, uint8_t Cmd, uint32_t Arg, uint8_t *pResp, uint32_t Len);
+static uint32_t Sd_ReadBlockCount(Sd_Handle_t *pSd);
+
+/**************************************************************************
+ * Initialize a card
+ * ************************************************************************
+ * @fn			- Sd_Init
+ *
+ * @brief		- Copies the configuration and brings the card into SPI
+ * 				  mode: 80 clocks, CMD0, CMD8, CMD59 (Sd_Crc), ACMD41 until
+ * 				  ready, CMD58 (addressing), CMD16 (byte addressed cards),
+ * 				  CMD9 (size). The SPI runs at <= 400 kHz meanwhile and
+ * 				  at <= 25 MHz afterwards.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- @SD_RETURN
+ *
+ * @Note		- Blocking (up to about a second while the card powers up),
+ * 				  call it after Sched_Init. The handle is unusable (Type
+ * 				  SD_TYPE_NONE) unless SD_OK is returned.
+ ****************************************************************************/
+uint8_t Sd_Init(Sd_Handle_t *pSd, Sd_Config_t *pConfig)
+{
+	SPI_Handle_t *pSPIHandle = pConfig->pSPIHandle;
+	uint8_t resp[4];
+	uint8_t r1, type, v2 = 0;
+	uint32_t tries, blocks;
+
+	memset(pSd, 0, sizeof(*pSd));
+	pSd->Config = *pConfig;
+	Sched_TimerInit(&pSd->Timer, Sd_TimerHandler, (uint32_t)(uintptr_t)pSd, pConfig->Sd_Priority);
+
+	// at least 74 clocks with chip select high
+	Sd_Deselect(pSd);
+	SPI_SclkSpeedConfig(pSPIHandle, Sd_SclkSpeed(pSd, SD_INIT_SCLK));
+	SPI_ClearOVRFlag(pSPIHandle->pSPIx);
+	for(uint8_t i = 0; i < 10; i++)
+		Sd_Byte(pSd, 0xFF);
+
+	// CMD0 with chip select low puts the card into SPI mode
+	tries = 0;
+	do
+	{
+		r1 = Sd_Command(pSd, SD_CMD_GO_IDLE_STATE, 0, 0, 0);
+	} while(r1 != SD_R1_IDLE && ++tries < 10);
+	if(r1 != SD_R1_IDLE)
+		return SD_ERR_NO_CARD;
+
+	// version 2 cards echo the voltage range and the check pattern
+	r1 = Sd_Command(pSd, SD_CMD_SEND_IF_COND, 0x1AA, resp, 4);
+	if(!(r1 & SD_R1_ILLEGAL_CMD))
+	{
+		if(r1 != SD_R1_IDLE || (resp[2] & 0x0F) != 0x01 || resp[3] != 0xAA)
+			return SD_ERR_CARD;
+		v2 = 1;
+	}
+
+	if(pConfig->Sd_Crc == ENABLE && Sd_Command(pSd, SD_CMD_CRC_ON_OFF, 1, 0, 0) != SD_R1_IDLE)
+		return SD_ERR_CARD;
+
+	// ACMD41 until the card has left the idle state (HCS: we take SDHC)
+	tries = 0;
+	do
+	{
+		r1 = Sd_Command(pSd, SD_CMD_APP_CMD, 0, 0, 0);
+		if(r1 <= SD_R1_IDLE)
+			r1 = Sd_Command(pSd, SD_ACMD_SD_SEND_OP_COND, v2 ? (1U << 30) : 0, 0, 0);
+	} while(r1 == SD_R1_IDLE && ++tries < SD_INIT_TRIES);
+	if(r1 != 0)
+		return SD_ERR_CARD;
+
+	type = SD_TYPE_SDSC;
+	if(v2)
+	{
+		// OCR bit 30 (CCS): block addressed
+		if(Sd_Command(pSd, SD_CMD_READ_OCR, 0, resp, 4) != 0)
+			return SD_ERR_CARD;
+		if(resp[0] & 0x40)
+			type = SD_TYPE_SDHC;
+	}
+	if(type == SD_TYPE_SDSC && Sd_Command(pSd, SD_CMD_SET_BLOCKLEN, SD_BLOCK_SIZE, 0, 0) != 0)
+		return SD_ERR_CARD;
+
+	blocks = Sd_ReadBlockCount(pSd);
+	if(blocks == 0)
+		return SD_ERR_CARD;
+
+	SPI_SclkSpeedConfig(pSPIHandle, Sd_SclkSpeed(pSd, SD_MAX_SCLK));
+	pSd->BlockCount = blocks;
+	pSd->Type = type;
+	return SD_OK;
+}
+
+/**************************************************************************
+ * Read blocks
+ * ************************************************************************
+ * @fn			- Sd_Read
+ *
+ * @brief		- Reads Count blocks from Lba into pBuffer: CMD17 for one
+ * 				  block, CMD18 and CMD12 for more. The blocks stream by DMA
+ * 				  under one chip select. Blocks still in the cache are
+ * 				  copied from there.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- first block
+ * @param[in]	- destination, Count * SD_BLOCK_SIZE bytes
+ * @param[in]	- number of blocks
+ *
+ * @return		- @SD_RETURN
+ *
+ * @Note		- SD_EVENT_READ_CMPLT
+ ****************************************************************************/
+uint8_t Sd_Read(Sd_Handle_t *pSd, uint32_t Lba, uint8_t *pBuffer, uint32_t Count)
+{
+	if(Count == 0 || Lba >= pSd->BlockCount || Count > pSd->BlockCount - Lba)
+		return SD_ERR_PARAM;
+
+	return Sd_Submit(pSd, SD_OP_READ, Lba, pBuffer, Count);
+}
+
+/**************************************************************************
+ * Write blocks
+ * ************************************************************************
+ * @fn			- Sd_Write
+ *
+ * @brief		- Writes Count blocks at Lba. Less than SD_CACHE_BLOCKS
+ * 				  blocks go into the write-back cache when they extend or
+ * 				  overwrite the blocks held there; the others are written
+ * 				  with CMD24 (one block) or CMD25 (more).
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- first block
+ * @param[in]	- data, Count * SD_BLOCK_SIZE bytes, valid until the event
+ * @param[in]	- number of blocks
+ *
+ * @return		- @SD_RETURN
+ *
+ * @Note		- SD_EVENT_WRITE_CMPLT. A cached write completes from the
+ * 				  scheduler, its data may be reused from then on.
+ ****************************************************************************/
+uint8_t Sd_Write(Sd_Handle_t *pSd, uint32_t Lba, const uint8_t *pData, uint32_t Count)
+{
+	if(Count == 0 || Lba >= pSd->BlockCount || Count > pSd->BlockCount - Lba)
+		return SD_ERR_PARAM;
+
+	return Sd_Submit(pSd, SD_OP_WRITE, Lba, (uint8_t*)pData, Count);
+}
+
+/**************************************************************************
+ * @fn			- Sd_Flush
+ *
+ * @brief		- Writes the cached blocks to the card.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- @SD_RETURN
+ *
+ * @Note		- SD_EVENT_FLUSH_CMPLT, from the scheduler if the cache
+ * 				  was empty.
+ ****************************************************************************/
+uint8_t Sd_Flush(Sd_Handle_t *pSd)
+{
+	if(pSd->Type == SD_TYPE_NONE)
+		return SD_ERR_PARAM;
+
+	return Sd_Submit(pSd, SD_OP_FLUSH, 0, 0, 0);
+}
+
+/**************************************************************************
+ * @fn			- Sd_Busy
+ *
+ * @brief		- Tells whether an operation is in progress or queued.
+ * 				  A write-back alone does not count.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if a new operation would start
+ ****************************************************************************/
+uint8_t Sd_Busy(Sd_Handle_t *pSd)
+{
+	return (pSd->Op != SD_OP_NONE && pSd->Op != SD_OP_WRITE_BACK) || pSd->PendingOp != SD_OP_NONE;
+}
+
+/**************************************************************************
+ * SPI events
+ * ************************************************************************
+ * @fn			- Sd_EventHandling
+ *
+ * @brief		- Advances the operation in progress. Events of other SPI
+ * 				  handles are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- SPI handle of the event
+ * @param[in]	- SPI_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+void Sd_EventHandling(Sd_Handle_t *pSd, SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	if(pSPIHandle != pSd->Config.pSPIHandle || pSd->Op == SD_OP_NONE)
+		return;
+
+	if(AppEv == SPI_EVENT_OVR_ERR || AppEv == SPI_EVENT_DMA_ERR)
+	{
+		Sd_Fail(pSd);
+		return;
+	}
+	if(AppEv != pSd->ExpectedEv)
+		return;
+
+	switch(pSd->Phase)
+	{
+	case SD_PHASE_CMD:
+		Sd_Response(pSd, pSd->Rx[6]);
+		break;
+	case SD_PHASE_R1:
+		Sd_Response(pSd, pSd->Rx[0]);
+		break;
+	case SD_PHASE_TOKEN:
+		if(pSd->Rx[0] == 0xFF)
+		{
+			Sd_Poll(pSd, SD_PHASE_TOKEN);
+		} else if(pSd->Rx[0] == SD_TOKEN_START_BLOCK)
+		{
+			pSd->Phase = SD_PHASE_READ_DATA;
+			Sd_Exchange(pSd, 0, pSd->pData, SD_BLOCK_SIZE);
+		} else
+		{
+			// data error token
+			Sd_Fail(pSd);
+		}
+		break;
+	case SD_PHASE_READ_DATA:
+		// the CRC of the block is computed while its CRC bytes come in
+		pSd->Phase = SD_PHASE_READ_CRC;
+		Sd_Exchange(pSd, 0, pSd->Rx, 2);
+		if(pSd->Config.Sd_Crc == ENABLE)
+			pSd->DataCrc = Sd_Crc16(pSd->pData, SD_BLOCK_SIZE);
+		break;
+	case SD_PHASE_READ_CRC:
+		if(pSd->Config.Sd_Crc == ENABLE && pSd->DataCrc != (uint16_t)((pSd->Rx[0] << 8) | pSd->Rx[1]))
+		{
+			Sd_Fail(pSd);
+			break;
+		}
+		pSd->Lba++;
+		pSd->pData += SD_BLOCK_SIZE;
+		pSd->Count--;
+		if(pSd->Count != 0)
+			Sd_StartWait(pSd, SD_PHASE_TOKEN);
+		else if(pSd->Cmd == SD_CMD_READ_MULTIPLE_BLOCK)
+			Sd_Stop(pSd);
+		else
+			Sd_Release(pSd);
+		break;
+	case SD_PHASE_WRITE_TOKEN:
+		// the CRC of the block is computed while the block goes out
+		pSd->Phase = SD_PHASE_WRITE_DATA;
+		Sd_Exchange(pSd, pSd->pData, 0, SD_BLOCK_SIZE);
+		if(pSd->Config.Sd_Crc == ENABLE)
+		{
+			uint16_t crc = Sd_Crc16(pSd->pData, SD_BLOCK_SIZE);
+
+			pSd->Tx[0] = (uint8_t)(crc >> 8);
+			pSd->Tx[1] = (uint8_t)crc;
+		} else
+		{
+			pSd->Tx[0] = 0xFF;
+			pSd->Tx[1] = 0xFF;
+		}
+		break;
+	case SD_PHASE_WRITE_DATA:
+		pSd->Tx[2] = 0xFF;
+		pSd->Phase = SD_PHASE_WRITE_RESP;
+		Sd_Exchange(pSd, pSd->Tx, pSd->Rx, 3);
+		break;
+	case SD_PHASE_WRITE_RESP:
+		if((pSd->Rx[2] & SD_DATA_RESP_MASK) != SD_DATA_RESP_ACCEPTED)
+		{
+			Sd_Fail(pSd);
+			break;
+		}
+		pSd->Lba++;
+		pSd->pData += SD_BLOCK_SIZE;
+		pSd->Count--;
+		Sd_StartWait(pSd, SD_PHASE_BUSY);
+		break;
+	case SD_PHASE_BUSY:
+		if(pSd->Rx[SD_BUSY_POLL_LEN - 1] != 0xFF)
+			Sd_Poll(pSd, SD_PHASE_BUSY);
+		else if(pSd->Count != 0)
+			Sd_WriteToken(pSd);
+		else if(pSd->Cmd == SD_CMD_WRITE_MULTIPLE_BLOCK && !pSd->Stopping)
+			Sd_Stop(pSd);
+		else
+			Sd_Release(pSd);
+		break;
+	case SD_PHASE_STOP:
+		if(pSd->Cmd == SD_CMD_WRITE_MULTIPLE_BLOCK)
+			Sd_StartWait(pSd, SD_PHASE_BUSY);
+		else
+			Sd_Response(pSd, pSd->Rx[7]);		// after the stuff byte
+		break;
+	case SD_PHASE_RELEASE:
+		Sd_Finish(pSd, Sd_OpEvent(pSd->Op));
+		break;
+	default:
+		break;
+	}
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Sd_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- SD_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler or in the scheduler.
+ * 				  The next operation may be started from here.
+ ****************************************************************************/
+__attribute__((weak)) void Sd_ApplicationEventCallback(Sd_Handle_t *pSd, uint8_t AppEv)
+{
+	(void)pSd;
+	(void)AppEv;
+}
+
+// starts the operation, or queues it behind a write-back
+static uint8_t Sd_Submit(Sd_Handle_t *pSd, uint8_t Op, uint32_t Lba, uint8_t *pData, uint32_t Count)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if(pSd->Op == SD_OP_WRITE_BACK && pSd->PendingOp == SD_OP_NONE)
+	{
+		pSd->PendingOp = Op;
+		pSd->PendingLba = Lba;
+		pSd->pPendingData = pData;
+		pSd->PendingCount = Count;
+		__set_PRIMASK(primask);
+		return SD_OK;
+	}
+	if(pSd->Op != SD_OP_NONE || pSd->PendingOp != SD_OP_NONE)
+	{
+		__set_PRIMASK(primask);
+		return SD_BUSY;
+	}
+	pSd->Op = Op;
+	__set_PRIMASK(primask);
+
+	Sd_Begin(pSd, Op, Lba, pData, Count);
+	return SD_OK;
+}
+
+// first phase of an operation
+static void Sd_Begin(Sd_Handle_t *pSd, uint8_t Op, uint32_t Lba, uint8_t *pData, uint32_t Count)
+{
+	pSd->Op = Op;
+	pSd->Lba = Lba;
+	pSd->pData = pData;
+	pSd->Count = Count;
+
+	switch(Op)
+	{
+	case SD_OP_READ:
+		if(!Sd_CacheOverlap(pSd, Lba, Count))
+		{
+			Sd_StartCommand(pSd, (Count == 1) ? SD_CMD_READ_SINGLE_BLOCK : SD_CMD_READ_MULTIPLE_BLOCK);
+		} else if(Lba >= pSd->CacheLba && Lba + Count <= pSd->CacheLba + pSd->CacheCount)
+		{
+			memcpy(pData, pSd->Cache[Lba - pSd->CacheLba], Count * SD_BLOCK_SIZE);
+			if(!Sched_Post(Sd_DoneHandler, (uint32_t)(uintptr_t)pSd, pSd->Config.Sd_Priority))
+				Sd_Finish(pSd, SD_EVENT_READ_CMPLT);
+		} else
+		{
+			Sd_Defer(pSd, Op, Lba, pData, Count);
+		}
+		break;
+	case SD_OP_WRITE:
+		if(Sd_CacheWrite(pSd, Lba, pData, Count))
+		{
+			if(!Sched_Post(Sd_DoneHandler, (uint32_t)(uintptr_t)pSd, pSd->Config.Sd_Priority))
+				Sd_Finish(pSd, SD_EVENT_WRITE_CMPLT);
+		} else if(pSd->CacheCount != 0)
+		{
+			Sd_Defer(pSd, Op, Lba, pData, Count);
+		} else
+		{
+			Sd_StartCommand(pSd, (Count == 1) ? SD_CMD_WRITE_BLOCK : SD_CMD_WRITE_MULTIPLE_BLOCK);
+		}
+		break;
+	case SD_OP_FLUSH:
+	case SD_OP_WRITE_BACK:
+		if(pSd->CacheCount == 0)
+		{
+			if(!Sched_Post(Sd_DoneHandler, (uint32_t)(uintptr_t)pSd, pSd->Config.Sd_Priority))
+				Sd_Finish(pSd, Sd_OpEvent(Op));
+			break;
+		}
+		pSd->Lba = pSd->CacheLba;
+		pSd->pData = pSd->Cache[0];
+		pSd->Count = pSd->CacheCount;
+		Sd_StartCommand(pSd, (pSd->Count == 1) ? SD_CMD_WRITE_BLOCK : SD_CMD_WRITE_MULTIPLE_BLOCK);
+		break;
+	default:
+		break;
+	}
+}
+
+// the cache is in the way: write it back first, the operation waits
+static void Sd_Defer(Sd_Handle_t *pSd, uint8_t Op, uint32_t Lba, uint8_t *pData, uint32_t Count)
+{
+	pSd->PendingOp = Op;
+	pSd->PendingLba = Lba;
+	pSd->pPendingData = pData;
+	pSd->PendingCount = Count;
+	Sd_Begin(pSd, SD_OP_WRITE_BACK, 0, 0, 0);
+}
+
+// takes a short write which extends or overwrites the cached run
+static uint8_t Sd_CacheWrite(Sd_Handle_t *pSd, uint32_t Lba, uint8_t *pData, uint32_t Count)
+{
+	uint32_t end;
+
+	if(Count >= SD_CACHE_BLOCKS)
+		return 0;
+	if(pSd->CacheCount == 0)
+		pSd->CacheLba = Lba;
+	else if(Lba < pSd->CacheLba || Lba > pSd->CacheLba + pSd->CacheCount ||
+			Lba + Count > pSd->CacheLba + SD_CACHE_BLOCKS)
+		return 0;
+
+	memcpy(pSd->Cache[Lba - pSd->CacheLba], pData, Count * SD_BLOCK_SIZE);
+	end = Lba + Count - pSd->CacheLba;
+	if(end > pSd->CacheCount)
+		pSd->CacheCount = end;
+	pSd->CachedWrites++;
+	return 1;
+}
+
+static uint8_t Sd_CacheOverlap(Sd_Handle_t *pSd, uint32_t Lba, uint32_t Count)
+{
+	return pSd->CacheCount != 0 && Lba < pSd->CacheLba + pSd->CacheCount && pSd->CacheLba < Lba + Count;
+}
+
+static void Sd_Select(Sd_Handle_t *pSd)
+{
+	GPIO_WriteToOutputPin(pSd->Config.pCSPort, pSd->Config.CSPin, RESET);
+}
+
+static void Sd_Deselect(Sd_Handle_t *pSd)
+{
+	GPIO_WriteToOutputPin(pSd->Config.pCSPort, pSd->Config.CSPin, SET);
+}
+
+static void Sd_Exchange(Sd_Handle_t *pSd, uint8_t *pTx, uint8_t *pRx, uint32_t Len)
+{
+	pSd->ExpectedEv = pRx ? SPI_EVENT_RX_CMPLT : SPI_EVENT_TX_CMPLT;
+
+	if(SPI_TransferDMA(pSd->Config.pSPIHandle, pTx, pRx, Len) != SPI_READY)
+	{
+		// someone else is using the SPI
+		Sd_Deselect(pSd);
+		Sd_Finish(pSd, SD_EVENT_ERROR);
+	}
+}
+
+// command frame: 01 index, 32 bit argument, CRC7 and end bit
+static void Sd_SetCommand(Sd_Handle_t *pSd, uint8_t Cmd, uint32_t Arg)
+{
+	pSd->Tx[0] = 0x40 | Cmd;
+	pSd->Tx[1] = (uint8_t)(Arg >> 24);
+	pSd->Tx[2] = (uint8_t)(Arg >> 16);
+	pSd->Tx[3] = (uint8_t)(Arg >> 8);
+	pSd->Tx[4] = (uint8_t)Arg;
+	pSd->Tx[5] = (uint8_t)((Sd_Crc7(pSd->Tx, 5) << 1) | 1);
+}
+
+// data command of the operation, with the first byte of the response
+static void Sd_StartCommand(Sd_Handle_t *pSd, uint8_t Cmd)
+{
+	uint32_t arg = (pSd->Type == SD_TYPE_SDHC) ? pSd->Lba : pSd->Lba * SD_BLOCK_SIZE;
+
+	pSd->Cmd = Cmd;
+	pSd->Stopping = 0;
+	pSd->Polls = 0;
+	if(Cmd == SD_CMD_WRITE_BLOCK || Cmd == SD_CMD_WRITE_MULTIPLE_BLOCK)
+		pSd->WriteCommands++;
+
+	Sd_SetCommand(pSd, Cmd, arg);
+	pSd->Tx[6] = 0xFF;
+	pSd->Phase = SD_PHASE_CMD;
+	Sd_Select(pSd);
+	Sd_Exchange(pSd, pSd->Tx, pSd->Rx, 7);
+}
+
+// R1 of the data command or of CMD12 (0xFF: not there yet)
+static void Sd_Response(Sd_Handle_t *pSd, uint8_t R1)
+{
+	if(R1 & 0x80)
+	{
+		if(++pSd->Polls > SD_NCR_MAX)
+		{
+			Sd_Fail(pSd);
+			return;
+		}
+		pSd->Phase = SD_PHASE_R1;
+		Sd_Exchange(pSd, 0, pSd->Rx, 1);
+		return;
+	}
+	if(R1 != 0)
+		Sd_Fail(pSd);
+	else if(pSd->Stopping)
+		Sd_StartWait(pSd, SD_PHASE_BUSY);		// CMD12 has an R1b response
+	else if(pSd->Cmd == SD_CMD_READ_SINGLE_BLOCK || pSd->Cmd == SD_CMD_READ_MULTIPLE_BLOCK)
+		Sd_StartWait(pSd, SD_PHASE_TOKEN);
+	else
+		Sd_WriteToken(pSd);
+}
+
+static void Sd_StartWait(Sd_Handle_t *pSd, uint8_t Phase)
+{
+	pSd->Polls = 0;
+	pSd->WaitTicks = 0;
+	Sd_Poll(pSd, Phase);
+}
+
+// next poll: at once for the first SD_FAST_POLLS, then by the timer
+static void Sd_Poll(Sd_Handle_t *pSd, uint8_t Phase)
+{
+	if(pSd->Polls < SD_FAST_POLLS)
+	{
+		pSd->Polls++;
+		Sd_PollNow(pSd, Phase);
+		return;
+	}
+	if(pSd->WaitTicks >= pSd->Config.Sd_TimeoutTicks)
+	{
+		Sd_Fail(pSd);
+		return;
+	}
+	pSd->WaitTicks += pSd->Config.Sd_PollTicks;
+	pSd->WaitPhase = Phase;
+	pSd->Phase = SD_PHASE_WAIT;
+	Sched_TimerStart(&pSd->Timer, pSd->Config.Sd_PollTicks, 0);
+}
+
+static void Sd_PollNow(Sd_Handle_t *pSd, uint8_t Phase)
+{
+	pSd->Phase = Phase;
+	Sd_Exchange(pSd, 0, pSd->Rx, (Phase == SD_PHASE_BUSY) ? SD_BUSY_POLL_LEN : 1);
+}
+
+static void Sd_WriteToken(Sd_Handle_t *pSd)
+{
+	pSd->Tx[0] = 0xFF;
+	pSd->Tx[1] = (pSd->Cmd == SD_CMD_WRITE_MULTIPLE_BLOCK) ? SD_TOKEN_START_MULTI : SD_TOKEN_START_BLOCK;
+	pSd->Phase = SD_PHASE_WRITE_TOKEN;
+	Sd_Exchange(pSd, pSd->Tx, 0, 2);
+}
+
+// end of a multiple block command: CMD12 after reads, the stop token after writes
+static void Sd_Stop(Sd_Handle_t *pSd)
+{
+	pSd->Stopping = 1;
+	pSd->Polls = 0;
+	pSd->Phase = SD_PHASE_STOP;
+	if(pSd->Cmd == SD_CMD_WRITE_MULTIPLE_BLOCK)
+	{
+		pSd->Tx[0] = SD_TOKEN_STOP_TRAN;
+		pSd->Tx[1] = 0xFF;
+		Sd_Exchange(pSd, pSd->Tx, 0, 2);
+	} else
+	{
+		Sd_SetCommand(pSd, SD_CMD_STOP_TRANSMISSION, 0);
+		pSd->Tx[6] = 0xFF;
+		pSd->Tx[7] = 0xFF;
+		Sd_Exchange(pSd, pSd->Tx, pSd->Rx, 8);
+	}
+}
+
+static void Sd_Release(Sd_Handle_t *pSd)
+{
+	Sd_Deselect(pSd);
+	pSd->Tx[0] = 0xFF;
+	pSd->Phase = SD_PHASE_RELEASE;
+	Sd_Exchange(pSd, pSd->Tx, 0, 1);
+}
+
+static void Sd_Fail(Sd_Handle_t *pSd)
+{
+	Sd_Deselect(pSd);
+	Sd_Finish(pSd, SD_EVENT_ERROR);
+}
+
+static uint8_t Sd_OpEvent(uint8_t Op)
+{
+	if(Op == SD_OP_READ)
+		return SD_EVENT_READ_CMPLT;
+	if(Op == SD_OP_WRITE)
+		return SD_EVENT_WRITE_CMPLT;
+	return SD_EVENT_FLUSH_CMPLT;
+}
+
+// ends the operation, reports it and starts what was queued behind it
+static void Sd_Finish(Sd_Handle_t *pSd, uint8_t AppEv)
+{
+	uint8_t op = pSd->Op;
+	uint32_t primask;
+
+	pSd->Op = SD_OP_NONE;
+	pSd->Phase = SD_PHASE_IDLE;
+
+	if((op == SD_OP_FLUSH || op == SD_OP_WRITE_BACK) && AppEv != SD_EVENT_ERROR)
+		pSd->CacheCount = 0;
+
+	if(op == SD_OP_WRITE_BACK)
+	{
+		if(AppEv == SD_EVENT_ERROR)
+		{
+			// the blocks stay cached, the operation behind is dropped
+			pSd->PendingOp = SD_OP_NONE;
+			Sd_ApplicationEventCallback(pSd, SD_EVENT_ERROR);
+			return;
+		}
+	} else
+	{
+		// write-back first: a write submitted by the callback waits for it
+		if(op == SD_OP_WRITE && AppEv == SD_EVENT_WRITE_CMPLT && pSd->CacheCount == SD_CACHE_BLOCKS)
+			Sd_Begin(pSd, SD_OP_WRITE_BACK, 0, 0, 0);
+		Sd_ApplicationEventCallback(pSd, AppEv);
+	}
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	op = SD_OP_NONE;
+	if(pSd->Op == SD_OP_NONE && pSd->PendingOp != SD_OP_NONE)
+	{
+		op = pSd->PendingOp;
+		pSd->PendingOp = SD_OP_NONE;
+		pSd->Op = op;
+	}
+	__set_PRIMASK(primask);
+
+	if(op != SD_OP_NONE)
+		Sd_Begin(pSd, op, pSd->PendingLba, pSd->pPendingData, pSd->PendingCount);
+}
+
+static void Sd_TimerHandler(uint32_t Arg)
+{
+	Sd_Handle_t *pSd = (Sd_Handle_t*)(uintptr_t)Arg;
+
+	if(pSd->Phase == SD_PHASE_WAIT)
+		Sd_PollNow(pSd, pSd->WaitPhase);
+}
+
+// operations served by the cache complete here
+static void Sd_DoneHandler(uint32_t Arg)
+{
+	Sd_Handle_t *pSd = (Sd_Handle_t*)(uintptr_t)Arg;
+
+	Sd_Finish(pSd, Sd_OpEvent(pSd->Op));
+}
+
+// CRC7 (x^7 + x^3 + 1) of a command frame
+static uint8_t Sd_Crc7(const uint8_t *pData, uint32_t Len)
+{
+	uint8_t crc = 0;
+
+	while(Len--)
+	{
+		uint8_t data = *pData++;
+
+		for(uint8_t i = 0; i < 8; i++)
+		{
+			crc <<= 1;
+			if((data ^ crc) & 0x80)
+				crc ^= 0x09;
+			data <<= 1;
+		}
+	}
+	return crc & 0x7F;
+}
+
+static uint16_t Sd_Crc16(const uint8_t *pData, uint32_t Len)
+{
+	uint16_t crc = 0;
+
+	while(Len--)
+		crc = (uint16_t)((crc << 8) ^ Sd_Crc16Table[(uint8_t)(crc >> 8) ^ *pData++]);
+	return crc;
+}
+
+// fastest @SPI_SclkSpeed not above MaxHz, from the clock of the SPI's bus
+static uint8_t Sd_SclkSpeed(Sd_Handle_t *pSd, uint32_t MaxHz)
+{
+	const Periph_Instance_t *pInst = Periph_Get(pSd->Config.pSPIHandle->pSPIx);
+	uint32_t pclk = (pInst != 0 && pInst->Bus == PERIPH_BUS_APB2) ? RCC_GetPCLK2Value() : RCC_GetPCLK1Value();
+	uint8_t speed = SPI_SCLK_SPEED_DIV2;
+
+	while(speed < SPI_SCLK_SPEED_DIV256 && (pclk >> (speed + 1)) > MaxHz)
+		speed++;
+	return speed;
+}
+
+/*
+ * Blocking transfers of Sd_Init
+ */
+static uint8_t Sd_Byte(Sd_Handle_t *pSd, uint8_t Out)
+{
+	SPI_RegDef_t *pSPIx = pSd->Config.pSPIHandle->pSPIx;
+	uint8_t in;
+
+	SPI_SendData(pSPIx, &Out, 1);
+	SPI_ReceiveData(pSPIx, &in, 1);
+	return in;
+}
+
+// selects the card, sends the command and returns R1 (0xFF: no answer)
+static uint8_t Sd_CommandStart(Sd_Handle_t *pSd, uint8_t Cmd, uint32_t Arg)
+{
+	uint8_t r1 = 0xFF;
+
+	Sd_Select(pSd);
+	Sd_SetCommand(pSd, Cmd, Arg);
+	for(uint8_t i = 0; i < 6; i++)
+		Sd_Byte(pSd, pSd->Tx[i]);
+	for(uint8_t i = 0; i < SD_NCR_MAX && (r1 & 0x80); i++)
+		r1 = Sd_Byte(pSd, 0xFF);
+	return r1;
+}
+
+static void Sd_CommandEnd(Sd_Handle_t *pSd)
+{
+	Sd_Deselect(pSd);
+	Sd_Byte(pSd, 0xFF);
+}
+
+// command with Len response bytes after R1 (R3, R7)
+static uint8_t Sd_Command(Sd_Handle_t *pSd, uint8_t Cmd, uint32_t Arg, uint8_t *pResp, uint32_t Len)
+{
+	uint8_t r1 = Sd_CommandStart(pSd, Cmd, Arg);
+
+	for(uint32_t i = 0; i < Len; i++)
+		pResp[i] = Sd_Byte(pSd, 0xFF);
+	Sd_CommandEnd(pSd);
+	return r1;
+}
+
+// card size in blocks from the CSD register (0 on error)
+static uint32_t Sd_ReadBlockCount(Sd_Handle_t *pSd)
+{
+	uint8_t csd[16];
+	uint8_t token = 0xFF;
+	uint16_t crc;
+	uint32_t c_size, blocks = 0;
+
+	if(Sd_CommandStart(pSd, SD_CMD_SEND_CSD, 0) == 0)
+	{
+		for(uint32_t i = 0; i < SD_INIT_TRIES && token == 0xFF; i++)
+			token = Sd_Byte(pSd, 0xFF);
+		if(token == SD_TOKEN_START_BLOCK)
+		{
+			for(uint8_t i = 0; i < 16; i++)
+				csd[i] = Sd_Byte(pSd, 0xFF);
+			crc = (uint16_t)(Sd_Byte(pSd, 0xFF) << 8);
+			crc |= Sd_Byte(pSd, 0xFF);
+
+			if(pSd->Config.Sd_Crc != ENABLE || crc == Sd_Crc16(csd, 16))
+			{
+				if((csd[0] >> 6) == 1)
+				{
+					// CSD 2.0: (C_SIZE + 1) * 512 KB
+					c_size = ((uint32_t)(csd[7] & 0x3F) << 16) | ((uint32_t)csd[8] << 8) | csd[9];
+					blocks = (c_size + 1) << 10;
+				} else
+				{
+					// CSD 1.0: (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) * 2^READ_BL_LEN bytes
+					uint8_t mult = (uint8_t)(((csd[9] & 0x03) << 1) | (csd[10] >> 7));
+
+					c_size = ((uint32_t)(csd[6] & 0x03) << 10) | ((uint32_t)csd[7] << 2) | (csd[8] >> 6);
+					blocks = (c_size + 1) << (mult + 2 + (csd[5] & 0x0F) - 9);
+				}
+			}
+		}
+	}
+	Sd_CommandEnd(pSd);
+	return blocks;
+}
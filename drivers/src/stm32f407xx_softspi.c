@@ -0,0 +1,361 @@
+/*
+ * stm32f407xx_softspi.c
+ *
+ * Software SPI master, see stm32f407xx_softspi.h
+ */
+#include <string.h>
+#include "stm32f407xx_softspi.h"
+
+/*
+ * One bit, SCK and MOSI on one port: data bit with the edge before it,
+ * sampling edge, MISO.
+ */
+#define SOFTSPI_BIT_ONE_PORT(Bit)										\
+	do {																\
+		*pBsrr = pLead[(Out >> (Bit)) & 1];								\
+		*pBsrr = sample;												\
+		in = (in << 1) | ((*pIdr >> miso) & 1);							\
+	} while(0)
+
+/*
+ * One bit, SCK and MOSI on two ports: edge, data bit, sampling edge, MISO.
+ */
+#define SOFTSPI_BIT_TWO_PORTS(Bit)										\
+	do {																\
+		*pSck = first;													\
+		*pMosi = pMosiWord[(Out >> (Bit)) & 1];							\
+		*pSck = sample;													\
+		in = (in << 1) | ((*pIdr >> miso) & 1);							\
+	} while(0)
+
+// read in place of MISO when there is none
+static __vo uint32_t SoftSpi_NoMiso = 0xFFFFFFFF;
+
+/*
+ * Helper functions
+ */
+static void SoftSpi_PinInit(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t PinMode);
+static uint8_t SoftSpi_ByteOnePort(SoftSpi_Handle_t *pSoftSpi, uint8_t Out);
+static uint8_t SoftSpi_ByteTwoPorts(SoftSpi_Handle_t *pSoftSpi, uint8_t Out);
+static uint8_t SoftSpi_ByteSlow(SoftSpi_Handle_t *pSoftSpi, uint8_t Out);
+static void SoftSpi_Wait(uint32_t Loops);
+static uint8_t SoftSpi_DMAChunk(SoftSpi_Handle_t *pSoftSpi);
+static void SoftSpi_DMAFinish(SoftSpi_Handle_t *pSoftSpi, uint8_t AppEv);
+
+/**************************************************************************
+ * Initialize a soft SPI handle
+ * ************************************************************************
+ * @fn			- SoftSpi_Init
+ *
+ * @brief		- Configures the pins (SCK at its idle level first) and
+ * 				  computes the BSRR words of the clock mode.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- none
+ *
+ * @Note		- SCK and MOSI: push-pull outputs, high speed. MISO: input.
+ * 				  Enables the SCK port clock first, to set the idle level.
+ ****************************************************************************/
+void SoftSpi_Init(SoftSpi_Handle_t *pSoftSpi, SoftSpi_Config_t *pConfig)
+{
+	uint32_t sck = 1U << pConfig->SckPin;
+	uint32_t mosi = 1U << pConfig->MosiPin;
+	uint32_t idle = (pConfig->SoftSpi_CPOL == SPI_CPOL_HIGH) ? sck : sck << 16;
+	uint32_t active = (pConfig->SoftSpi_CPOL == SPI_CPOL_HIGH) ? sck << 16 : sck;
+
+	memset(pSoftSpi, 0, sizeof(*pSoftSpi));
+	pSoftSpi->Config = *pConfig;
+
+	pSoftSpi->pSckBsrr = &pConfig->pSckPort->BSRR;
+	pSoftSpi->pMosiBsrr = &pConfig->pMosiPort->BSRR;
+	pSoftSpi->pMisoIdr = pConfig->pMisoPort ? &pConfig->pMisoPort->IDR : &SoftSpi_NoMiso;
+	pSoftSpi->MisoPin = pConfig->pMisoPort ? pConfig->MisoPin : 0;
+
+	// CPHA 0: the data bit follows the trailing edge of the previous bit,
+	// the leading edge samples. CPHA 1: the data bit goes with the leading
+	// edge, the trailing edge samples.
+	pSoftSpi->MosiWord[0] = mosi << 16;
+	pSoftSpi->MosiWord[1] = mosi;
+	pSoftSpi->SckFirst = (pConfig->SoftSpi_CPHA == SPI_CPHA_HIGH) ? active : idle;
+	pSoftSpi->SckSample = (pConfig->SoftSpi_CPHA == SPI_CPHA_HIGH) ? idle : active;
+	pSoftSpi->SckIdle = idle;
+	pSoftSpi->Lead[0] = pSoftSpi->SckFirst | pSoftSpi->MosiWord[0];
+	pSoftSpi->Lead[1] = pSoftSpi->SckFirst | pSoftSpi->MosiWord[1];
+
+	Clk_Ensure(pConfig->pSckPort);
+	*pSoftSpi->pSckBsrr = idle;
+	SoftSpi_PinInit(pConfig->pSckPort, pConfig->SckPin, GPIO_MODE_OUT);
+	SoftSpi_PinInit(pConfig->pMosiPort, pConfig->MosiPin, GPIO_MODE_OUT);
+	if(pConfig->pMisoPort)
+		SoftSpi_PinInit(pConfig->pMisoPort, pConfig->MisoPin, GPIO_MODE_IN);
+}
+
+/**************************************************************************
+ * Blocking transfer
+ * ************************************************************************
+ * @fn			- SoftSpi_Transfer
+ *
+ * @brief		- Sends and receives Len bytes, MSB first.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the TX buffer, 0 to send 0xFF
+ * @param[in]	- pointer to the RX buffer, 0 to drop the received bytes
+ * @param[in]	- number of bytes
+ *
+ * @return		- none
+ *
+ * @Note		- SCK is left idle. Interrupts may stretch the clock, the
+ * 				  slave does not mind. Not during a SoftSpi_SendDMA.
+ ****************************************************************************/
+void SoftSpi_Transfer(SoftSpi_Handle_t *pSoftSpi, const uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t (*pByte)(SoftSpi_Handle_t*, uint8_t) = SoftSpi_ByteSlow;
+	uint8_t in;
+
+	if(pSoftSpi->Config.SoftSpi_Delay == 0)
+		pByte = (pSoftSpi->Config.pSckPort == pSoftSpi->Config.pMosiPort) ? SoftSpi_ByteOnePort : SoftSpi_ByteTwoPorts;
+
+	for(uint32_t i = 0; i < Len; i++)
+	{
+		in = pByte(pSoftSpi, pTxBuffer ? pTxBuffer[i] : 0xFF);
+		if(pRxBuffer)
+			pRxBuffer[i] = in;
+	}
+	*pSoftSpi->pSckBsrr = pSoftSpi->SckIdle;
+}
+
+/**************************************************************************
+ * Background transfer
+ * ************************************************************************
+ * @fn			- SoftSpi_SendDMA
+ *
+ * @brief		- Sends Len bytes, clocked by the timer's update DMA
+ * 				  requests into BSRR. Nothing is received.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the TX buffer, must stay valid until the event
+ * @param[in]	- number of bytes
+ *
+ * @return		- @SOFTSPI_RETURN
+ *
+ * @Note		- SOFTSPI_EVENT_TX_CMPLT, the timer is stopped then. One
+ * 				  bit takes two timer periods.
+ ****************************************************************************/
+uint8_t SoftSpi_SendDMA(SoftSpi_Handle_t *pSoftSpi, const uint8_t *pTxBuffer, uint32_t Len)
+{
+	SoftSpi_Config_t *pConfig = &pSoftSpi->Config;
+	uint32_t primask;
+
+	if(Len == 0 || pConfig->pTIMHandle == 0 || pConfig->pDMABuffer == 0 ||
+	   pConfig->DMABufferWords < SOFTSPI_DMA_WORDS(1) || pConfig->pSckPort != pConfig->pMosiPort ||
+	   (pConfig->pTIMHandle->pTIMx != TIM1 && pConfig->pTIMHandle->pTIMx != TIM8))
+		return SOFTSPI_ERR_PARAM;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if(pSoftSpi->Busy)
+	{
+		__set_PRIMASK(primask);
+		return SOFTSPI_BUSY;
+	}
+	pSoftSpi->Busy = 1;
+	__set_PRIMASK(primask);
+
+	pSoftSpi->pTxBuffer = pTxBuffer;
+	pSoftSpi->TxLen = Len;
+	if(!SoftSpi_DMAChunk(pSoftSpi))
+	{
+		pSoftSpi->Busy = 0;
+		return SOFTSPI_ERR_PARAM;
+	}
+	return SOFTSPI_OK;
+}
+
+/**************************************************************************
+ * @fn			- SoftSpi_Busy
+ *
+ * @brief		- Tells whether a SoftSpi_SendDMA is in progress.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if not
+ ****************************************************************************/
+uint8_t SoftSpi_Busy(SoftSpi_Handle_t *pSoftSpi)
+{
+	return pSoftSpi->Busy;
+}
+
+/**************************************************************************
+ * Timer events
+ * ************************************************************************
+ * @fn			- SoftSpi_EventHandling
+ *
+ * @brief		- Sends the next piece, or ends the transfer. Events of
+ * 				  other timers are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- timer handle of the event
+ * @param[in]	- TIM_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from TIM_ApplicationEventCallback.
+ ****************************************************************************/
+void SoftSpi_EventHandling(SoftSpi_Handle_t *pSoftSpi, TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	if(pTIMHandle != pSoftSpi->Config.pTIMHandle || !pSoftSpi->Busy)
+		return;
+
+	if(AppEv == TIM_EVENT_DMA_ERROR)
+	{
+		TIM_UpdateStopDMA(pTIMHandle);
+		SoftSpi_DMAFinish(pSoftSpi, SOFTSPI_EVENT_ERROR);
+	} else if(AppEv == TIM_EVENT_DMA_CMPLT)
+	{
+		// the last word (SCK idle) is written: the bus is idle
+		if(pSoftSpi->TxLen == 0)
+			SoftSpi_DMAFinish(pSoftSpi, SOFTSPI_EVENT_TX_CMPLT);
+		else if(!SoftSpi_DMAChunk(pSoftSpi))
+			SoftSpi_DMAFinish(pSoftSpi, SOFTSPI_EVENT_ERROR);
+	}
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- SoftSpi_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- SOFTSPI_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler. The next transfer may
+ * 				  be started from here.
+ ****************************************************************************/
+__attribute__((weak)) void SoftSpi_ApplicationEventCallback(SoftSpi_Handle_t *pSoftSpi, uint8_t AppEv)
+{
+	(void)pSoftSpi;
+	(void)AppEv;
+}
+
+static void SoftSpi_PinInit(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t PinMode)
+{
+	GPIO_Handle_t pin;
+
+	memset(&pin, 0, sizeof(pin));
+	pin.pGPIOx = pGPIOx;
+	pin.GPIO_PinConfig.GPIO_PinNumber = PinNumber;
+	pin.GPIO_PinConfig.GPIO_PinMode = PinMode;
+	pin.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_HIGH;
+	pin.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	pin.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	GPIO_Init(&pin);
+}
+
+// 8 bits unrolled, two stores and a load each
+static uint8_t SoftSpi_ByteOnePort(SoftSpi_Handle_t *pSoftSpi, uint8_t Out)
+{
+	__vo uint32_t *pBsrr = pSoftSpi->pSckBsrr;
+	__vo uint32_t *pIdr = pSoftSpi->pMisoIdr;
+	const uint32_t *pLead = pSoftSpi->Lead;
+	uint32_t sample = pSoftSpi->SckSample;
+	uint8_t miso = pSoftSpi->MisoPin;
+	uint32_t in = 0;
+
+	SOFTSPI_BIT_ONE_PORT(7);
+	SOFTSPI_BIT_ONE_PORT(6);
+	SOFTSPI_BIT_ONE_PORT(5);
+	SOFTSPI_BIT_ONE_PORT(4);
+	SOFTSPI_BIT_ONE_PORT(3);
+	SOFTSPI_BIT_ONE_PORT(2);
+	SOFTSPI_BIT_ONE_PORT(1);
+	SOFTSPI_BIT_ONE_PORT(0);
+	return (uint8_t)in;
+}
+
+static uint8_t SoftSpi_ByteTwoPorts(SoftSpi_Handle_t *pSoftSpi, uint8_t Out)
+{
+	__vo uint32_t *pSck = pSoftSpi->pSckBsrr;
+	__vo uint32_t *pMosi = pSoftSpi->pMosiBsrr;
+	__vo uint32_t *pIdr = pSoftSpi->pMisoIdr;
+	const uint32_t *pMosiWord = pSoftSpi->MosiWord;
+	uint32_t first = pSoftSpi->SckFirst;
+	uint32_t sample = pSoftSpi->SckSample;
+	uint8_t miso = pSoftSpi->MisoPin;
+	uint32_t in = 0;
+
+	SOFTSPI_BIT_TWO_PORTS(7);
+	SOFTSPI_BIT_TWO_PORTS(6);
+	SOFTSPI_BIT_TWO_PORTS(5);
+	SOFTSPI_BIT_TWO_PORTS(4);
+	SOFTSPI_BIT_TWO_PORTS(3);
+	SOFTSPI_BIT_TWO_PORTS(2);
+	SOFTSPI_BIT_TWO_PORTS(1);
+	SOFTSPI_BIT_TWO_PORTS(0);
+	return (uint8_t)in;
+}
+
+// SoftSpi_Delay wait loops after each edge
+static uint8_t SoftSpi_ByteSlow(SoftSpi_Handle_t *pSoftSpi, uint8_t Out)
+{
+	uint32_t delay = pSoftSpi->Config.SoftSpi_Delay;
+	uint32_t in = 0;
+
+	for(int8_t bit = 7; bit >= 0; bit--)
+	{
+		*pSoftSpi->pSckBsrr = pSoftSpi->SckFirst;
+		*pSoftSpi->pMosiBsrr = pSoftSpi->MosiWord[(Out >> bit) & 1];
+		SoftSpi_Wait(delay);
+		*pSoftSpi->pSckBsrr = pSoftSpi->SckSample;
+		in = (in << 1) | ((*pSoftSpi->pMisoIdr >> pSoftSpi->MisoPin) & 1);
+		SoftSpi_Wait(delay);
+	}
+	return (uint8_t)in;
+}
+
+static void SoftSpi_Wait(uint32_t Loops)
+{
+	for(__vo uint32_t i = 0; i < Loops; i++);
+}
+
+// fills the DMA buffer with the next bytes and starts the timer requests
+static uint8_t SoftSpi_DMAChunk(SoftSpi_Handle_t *pSoftSpi)
+{
+	uint32_t *pWord = pSoftSpi->Config.pDMABuffer;
+	uint32_t n = (pSoftSpi->Config.DMABufferWords - 1) / SOFTSPI_DMA_WORDS_PER_BYTE;
+
+	// NDTR is 16 bit
+	if(n > 0xFFFF / SOFTSPI_DMA_WORDS_PER_BYTE)
+		n = 0xFFFF / SOFTSPI_DMA_WORDS_PER_BYTE;
+	if(n > pSoftSpi->TxLen)
+		n = pSoftSpi->TxLen;
+
+	for(uint32_t i = 0; i < n; i++)
+	{
+		uint8_t out = pSoftSpi->pTxBuffer[i];
+
+		for(int8_t bit = 7; bit >= 0; bit--)
+		{
+			*pWord++ = pSoftSpi->Lead[(out >> bit) & 1];
+			*pWord++ = pSoftSpi->SckSample;
+		}
+	}
+	*pWord++ = pSoftSpi->SckIdle;
+	pSoftSpi->pTxBuffer += n;
+	pSoftSpi->TxLen -= n;
+
+	return TIM_UpdateStartDMA(pSoftSpi->Config.pTIMHandle, (uint32_t)pSoftSpi->pSckBsrr, pSoftSpi->Config.pDMABuffer,
+			(uint16_t)(pWord - pSoftSpi->Config.pDMABuffer), DISABLE);
+}
+
+static void SoftSpi_DMAFinish(SoftSpi_Handle_t *pSoftSpi, uint8_t AppEv)
+{
+	TIM_PeripheralControl(pSoftSpi->Config.pTIMHandle->pTIMx, DISABLE);
+	pSoftSpi->Busy = 0;
+	SoftSpi_ApplicationEventCallback(pSoftSpi, AppEv);
+}
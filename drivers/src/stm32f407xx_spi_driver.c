@@ -1,5 +1,21 @@
 // In driver.c, you have to include respective peripheral's driver file.
 #include "stm32f407xx_spi_driver.h"
+
+// DMA transfers without a TX buffer send this, without an RX buffer the
+// received frames go to SPI_DMASink.
+static const uint16_t SPI_DMADummy = 0xFFFF;
+static uint16_t SPI_DMASink;
+
+/*
+ * Helper functions (private to this driver)
+ */
+static void SPI_TxeInterruptHandle(SPI_Handle_t *pSPIHandle);
+static void SPI_RxneInterruptHandle(SPI_Handle_t *pSPIHandle);
+static void SPI_OvrErrInterruptHandle(SPI_Handle_t *pSPIHandle);
+static void SPI_DMAConfig(SPI_Handle_t *pSPIHandle);
+static void SPI_DMAFinish(SPI_Handle_t *pSPIHandle);
+static void SPI_TxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+static void SPI_RxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
 /**********************************************************************
  * Peripheral Clock setup
  * (Peripheral Control API)
@@ -15,35 +31,12 @@
  *
  * @return		- none
  *
- * @Note		- none
+ * @Note		- Reference counted by the clock manager: the clock goes
+ * 				  off with the last DISABLE, see stm32f407xx_clk.h
  ***********************************************************************/
 void SPI_PeriClockControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi)
 {
-	// check value of EnorDi parameter
-	if(EnorDi == ENABLE)
-	{
-		// enable clock for given GPIO port address
-		if (pSPIx == SPI1)
-			SPI1_PCLK_EN();
-		else if (pSPIx == SPI2)
-			SPI2_PCLK_EN();
-		else if (pSPIx == SPI3)
-			SPI3_PCLK_EN();
-		else if (pSPIx == SPI4)
-			SPI4_PCLK_EN();
-	}
-	else
-	{
-		// disable clock for given SPI port address
-		if (pSPIx == SPI1)
-			SPI1_PCLK_DI();
-		else if (pSPIx == SPI2)
-			SPI2_PCLK_DI();
-		else if (pSPIx == SPI3)
-			SPI3_PCLK_DI();
-		else if (pSPIx == SPI4)
-			SPI4_PCLK_DI();
-	}
+	Clk_Control(pSPIx, EnorDi);
 }
 
 /**************************************************************************
@@ -68,7 +61,7 @@ void SPI_PeriClockControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi)
 void SPI_Init(SPI_Handle_t *pSPIHandle)
 {
 	// Peripheral clock enable
-	SPI_PeriClockControl(pSPIHandle->pSPIx, ENABLE);
+	Clk_Ensure(pSPIHandle->pSPIx);
 
 	// There are two control registers where you have to store configurable parameters.
 	// The control register controls the peripheral.
@@ -121,6 +114,13 @@ void SPI_Init(SPI_Handle_t *pSPIHandle)
 	// All initialization is done and we can save the value of tempreg variable to CR1 register.c
 	pSPIHandle->pSPIx->SPI_CR1 = tempreg;
 	// Here we can use assignment operator b/c we freshly initialize the CR1 register.
+
+	pSPIHandle->TxState = SPI_READY;
+	pSPIHandle->RxState = SPI_READY;
+
+	// The DMA streams follow the DFF: set them up again with the next DMA transfer.
+	pSPIHandle->TxDMA.pParent = 0;
+	pSPIHandle->RxDMA.pParent = 0;
 }
 
 /**************************************************************************
@@ -142,36 +142,30 @@ void SPI_Init(SPI_Handle_t *pSPIHandle)
  ****************************************************************************/
 void SPI_DeInit(SPI_RegDef_t *pSPIx)
 {
-	// reset for given SPI port address
-	if (pSPIx == SPI1)
-		SPI1_REG_RESET();
-	else if (pSPIx == SPI2)
-		SPI2_REG_RESET();
-	else if (pSPIx == SPI3)
-		SPI3_REG_RESET();
-	else if (pSPIx == SPI4)
-		SPI4_REG_RESET();
+	Periph_Reset(pSPIx);
 }
 
 
 /**************************************************************************
- * Return flag reset (for transmitting data)
+ * Return flag status
  * ************************************************************************
- * @fn			- SPI_SendData
+ * @fn			- SPI_GetFlagStatus
  *
- * @brief		- send data to TX buffer
+ * @brief		- Checks a flag in the SPI status register.
  * 				-
  *				-
  * @param[in]	- peripheral base address
- * @param[in]	- requested flag
- * @return		- true or false
+ * @param[in]	- requested flag (SPI_xxx_FLAG)
+ * @return		- FLAG_SET or FLAG_RESET
  *
  * @Note		- none
  ****************************************************************************/
 uint8_t SPI_GetFlagStatus(SPI_RegDef_t *pSPIx, uint32_t FlagName)
 {
-	//while( ! (pSPIx->SPI_SR & (1 << SPI_SR_TXE) ) );
-
+	if(pSPIx->SPI_SR & FlagName)
+	{
+		return FLAG_SET;
+	}
 	return FLAG_RESET;
 }
 
@@ -223,9 +217,8 @@ void SPI_SendData(SPI_RegDef_t *pSPIx, uint8_t *pTxBuffer, uint32_t Len)
 
 			// Increment pTxBuffer to make it point to next data item.
 			// You transferred 2 bytes into it, so that's why buffer has to be incremented by 2.
-			// I am typecasting this pointer to uint16_t type and then incrementing
-			// (which should be incremented by 2).
-			(uint16_t*)pTxBuffer++;
+			// (A cast on the left of ++ does not change the step: it would be 1.)
+			pTxBuffer += 2;
 		} else
 		{
 			// 8 bit DFF
@@ -283,11 +276,9 @@ void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len)
 
 			// Increment pTxBuffer to make it point to next data item.
 			// You transferred 2 bytes into it, so that's why buffer has to be incremented by 2.
-			// I am typecasting this pointer to uint16_t type and then incrementing
-			// (which should be incremented by 2).
 
 			// Increment the Rxbuffer to point to the next free memory address.
-			(uint16_t*)pRxBuffer++;
+			pRxBuffer += 2;
 		} else
 		{
 			// 8 bit DFF
@@ -300,6 +291,262 @@ void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len)
 	}
 }
 
+/**************************************************************************
+ * Send data (interrupt)
+ * ************************************************************************
+ * @fn			- SPI_SendDataIT
+ *
+ * @brief		- Saves the buffer in the handle and enables the TXE
+ * 				  interrupt. SPI_IRQHandling writes the data register.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the TX buffer (must stay valid until complete)
+ * @param[in]	- number of bytes
+ *
+ * @return		- state before the call, SPI_READY means it was accepted
+ *
+ * @Note		- SPI_EVENT_TX_CMPLT is reported when the last frame was
+ * 				  written to the data register: wait for BSY to clear before
+ * 				  the slave is deselected. Stop mode is vetoed meanwhile.
+ ****************************************************************************/
+uint8_t SPI_SendDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint32_t Len)
+{
+	uint8_t state = pSPIHandle->TxState;
+
+	if(state != SPI_BUSY_IN_TX)
+	{
+		// 1. Save the TX buffer address and length information in the handle
+		pSPIHandle->pTxBuffer = pTxBuffer;
+		pSPIHandle->TxLen = Len;
+
+		// 2. Mark the SPI state as busy in transmission so that no other code
+		// can take over the same SPI peripheral until transmission is over
+		pSPIHandle->TxState = SPI_BUSY_IN_TX;
+		Pwr_VetoStop(pSPIHandle->pSPIx);
+
+		// 3. Enable the TXEIE control bit to get interrupt whenever TXE flag is set in SR
+		pSPIHandle->pSPIx->SPI_CR2 |= (1 << SPI_CR2_TXEIE);
+	}
+
+	return state;
+}
+
+/**************************************************************************
+ * Receive data (interrupt)
+ * ************************************************************************
+ * @fn			- SPI_ReceiveDataIT
+ *
+ * @brief		- Saves the buffer in the handle and enables the RXNE and
+ * 				  error interrupts. SPI_IRQHandling reads the data register.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the RX buffer, 0 to drop the received frames
+ * @param[in]	- number of bytes
+ *
+ * @return		- state before the call, SPI_READY means it was accepted
+ *
+ * @Note		- A master only receives while it sends: start a
+ * 				  SPI_SendDataIT of the same length as well.
+ ****************************************************************************/
+uint8_t SPI_ReceiveDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t state = pSPIHandle->RxState;
+
+	if(state != SPI_BUSY_IN_RX)
+	{
+		pSPIHandle->pRxBuffer = pRxBuffer;
+		pSPIHandle->RxLen = Len;
+
+		pSPIHandle->RxState = SPI_BUSY_IN_RX;
+		Pwr_VetoStop(pSPIHandle->pSPIx);
+
+		pSPIHandle->pSPIx->SPI_CR2 |= (1 << SPI_CR2_RXNEIE) | (1 << SPI_CR2_ERRIE);
+	}
+
+	return state;
+}
+
+/**************************************************************************
+ * Full duplex transfer (DMA)
+ * ************************************************************************
+ * @fn			- SPI_TransferDMA
+ *
+ * @brief		- Sends pTxBuffer and receives into pRxBuffer at the same
+ * 				  time, with the RX and TX DMA streams of the SPI (see
+ * 				  stm32f407xx_periph.c). The streams are set up with the
+ * 				  first transfer after SPI_Init.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the TX buffer, 0 to send 0xFF frames
+ * @param[in]	- pointer to the RX buffer, 0 to drop the received frames
+ * @param[in]	- number of bytes (up to 65535 frames)
+ *
+ * @return		- SPI_READY if it was accepted, else the busy state
+ *
+ * @Note		- Completion comes from the RX stream: call
+ * 				  DMA_IRQHandling(&handle.RxDMA) from its IRQ handler (and
+ * 				  the TX stream's one for error reports). SPI_EVENT_TX_CMPLT
+ * 				  and/or SPI_EVENT_RX_CMPLT are reported once every frame
+ * 				  has been received, so the bus is idle by then.
+ ****************************************************************************/
+uint8_t SPI_TransferDMA(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint16_t items;
+
+	if(pSPIHandle->TxState != SPI_READY)
+		return pSPIHandle->TxState;
+	if(pSPIHandle->RxState != SPI_READY)
+		return pSPIHandle->RxState;
+
+	if(pSPIHandle->RxDMA.pParent != pSPIHandle)
+		SPI_DMAConfig(pSPIHandle);
+
+	items = (pSPIx->SPI_CR1 & (1 << SPI_CR1_DFF)) ? Len / 2 : Len;
+
+	// Both directions are busy: the TX stream clocks the RX frames in.
+	pSPIHandle->pTxBuffer = pTxBuffer;
+	pSPIHandle->pRxBuffer = pRxBuffer;
+	pSPIHandle->TxLen = Len;
+	pSPIHandle->RxLen = Len;
+	pSPIHandle->TxState = SPI_BUSY_IN_TX;
+	pSPIHandle->RxState = SPI_BUSY_IN_RX;
+	Pwr_VetoStop(pSPIx);
+
+	// A frame left in DR from before would shift the received data.
+	SPI_ClearOVRFlag(pSPIx);
+
+	DMA_MemIncConfig(&pSPIHandle->RxDMA, pRxBuffer ? ENABLE : DISABLE);
+	DMA_MemIncConfig(&pSPIHandle->TxDMA, pTxBuffer ? ENABLE : DISABLE);
+
+	// RX first, so that no received frame can be missed
+	DMA_Start(&pSPIHandle->RxDMA, (uint32_t)&pSPIx->SPI_DR,
+			pRxBuffer ? (uint32_t)pRxBuffer : (uint32_t)&SPI_DMASink, items);
+	pSPIx->SPI_CR2 |= (1 << SPI_CR2_RXDMAEN);
+
+	DMA_Start(&pSPIHandle->TxDMA, (uint32_t)&pSPIx->SPI_DR,
+			pTxBuffer ? (uint32_t)pTxBuffer : (uint32_t)&SPI_DMADummy, items);
+	pSPIx->SPI_CR2 |= (1 << SPI_CR2_TXDMAEN);
+
+	return SPI_READY;
+}
+
+/**************************************************************************
+ * Send a stream (DMA, double buffered)
+ * ************************************************************************
+ * @fn			- SPI_SendStreamDMA
+ *
+ * @brief		- Sends pBuffer0, pBuffer1, pBuffer0 and so on, with no gap
+ * 				  between them, until SPI_StopStreamDMA. Only the TX stream
+ * 				  runs: the received frames are dropped.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- the two buffers
+ * @param[in]	- number of bytes of each (up to 65535 frames)
+ *
+ * @return		- SPI_READY if it was accepted, else the busy state
+ *
+ * @Note		- SPI_EVENT_TX_BUFFER_FREE each time the TX stream is done
+ * 				  with a buffer, starting with pBuffer0: it may be refilled
+ * 				  while the other one goes out. Call
+ * 				  DMA_IRQHandling(&handle.TxDMA) from the TX stream's IRQ
+ * 				  handler. A buffer not refilled in time is sent again.
+ ****************************************************************************/
+uint8_t SPI_SendStreamDMA(SPI_Handle_t *pSPIHandle, uint8_t *pBuffer0, uint8_t *pBuffer1, uint32_t Len)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint16_t items;
+
+	if(pSPIHandle->TxState != SPI_READY)
+		return pSPIHandle->TxState;
+	if(pSPIHandle->RxState != SPI_READY)
+		return pSPIHandle->RxState;
+
+	// the RX stream stays off, the TX stream swaps buffers
+	SPI_DMAConfig(pSPIHandle);
+	pSPIHandle->TxDMA.DMAConfig.DMA_Mode = DMA_MODE_DOUBLE_BUFFER;
+	DMA_Init(&pSPIHandle->TxDMA);
+
+	items = (pSPIx->SPI_CR1 & (1 << SPI_CR1_DFF)) ? Len / 2 : Len;
+
+	pSPIHandle->pTxBuffer = pBuffer0;
+	pSPIHandle->TxLen = Len;
+	pSPIHandle->TxState = SPI_BUSY_IN_TX;
+	Pwr_VetoStop(pSPIx);
+
+	DMA_StartDoubleBuffer(&pSPIHandle->TxDMA, (uint32_t)&pSPIx->SPI_DR, (uint32_t)pBuffer0, (uint32_t)pBuffer1, items);
+	pSPIx->SPI_CR2 |= (1 << SPI_CR2_TXDMAEN);
+
+	return SPI_READY;
+}
+
+/**************************************************************************
+ * @fn			- SPI_StopStreamDMA
+ *
+ * @brief		- Stops the stream of SPI_SendStreamDMA.
+ *
+ * @param[in]	- pointer to the handle structure
+ *
+ * @return		- none
+ *
+ * @Note		- The frames already in DR and in the shift register still
+ * 				  go out. The next DMA transfer sets the streams up again.
+ ****************************************************************************/
+void SPI_StopStreamDMA(SPI_Handle_t *pSPIHandle)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+
+	if(pSPIHandle->TxState != SPI_BUSY_IN_TX || pSPIHandle->TxDMA.DMAConfig.DMA_Mode != DMA_MODE_DOUBLE_BUFFER)
+		return;
+
+	DMA_Stop(&pSPIHandle->TxDMA);
+	pSPIx->SPI_CR2 &= ~(1 << SPI_CR2_TXDMAEN);
+	SPI_ClearOVRFlag(pSPIx);
+
+	// TransferDMA sets both streams up again (a late TX stream event still
+	// finds its parent)
+	pSPIHandle->RxDMA.pParent = 0;
+	pSPIHandle->TxLen = 0;
+	pSPIHandle->TxState = SPI_READY;
+	Pwr_ReleaseStop(pSPIx);
+}
+
+/**************************************************************************
+ * Send data (DMA)
+ * ************************************************************************
+ * @fn			- SPI_SendDataDMA
+ *
+ * @brief		- SPI_TransferDMA without RX buffer.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the TX buffer (must stay valid until complete)
+ * @param[in]	- number of bytes
+ *
+ * @return		- SPI_READY if it was accepted, else the busy state
+ ****************************************************************************/
+uint8_t SPI_SendDataDMA(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint32_t Len)
+{
+	return SPI_TransferDMA(pSPIHandle, pTxBuffer, 0, Len);
+}
+
+/**************************************************************************
+ * Receive data (DMA)
+ * ************************************************************************
+ * @fn			- SPI_ReceiveDataDMA
+ *
+ * @brief		- SPI_TransferDMA without TX buffer (0xFF frames are sent).
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the RX buffer
+ * @param[in]	- number of bytes
+ *
+ * @return		- SPI_READY if it was accepted, else the busy state
+ ****************************************************************************/
+uint8_t SPI_ReceiveDataDMA(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len)
+{
+	return SPI_TransferDMA(pSPIHandle, 0, pRxBuffer, Len);
+}
+
 /**************************************************************************
  * Enable or disable the SPI peripheral
  * ************************************************************************
@@ -380,64 +627,435 @@ void SPI_SSOEConfig(SPI_RegDef_t *pSPIx, uint8_t EnOrDi)
 	}
 }
 /**************************************************************************
- * Interrupt Configuration
+ * Change the SCLK speed
  * ************************************************************************
- * @fn			- GPIO_IRQConfig
+ * @fn			- SPI_SclkSpeedConfig
  *
- * @brief		- All of the configuration in this API is processor specific.
+ * @brief		- Writes a new baud rate divider into CR1 and the handle's
+ * 				  configuration. The other CR1 bits (SPE, SSI, ...) are kept,
+ * 				  unlike with SPI_Init.
  *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- possible values from @SPI_SclkSpeed
  * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Only between transfers: the baud rate must not change
+ * 				  while a frame is shifted (RM0090 SPI_CR1 BR).
+ ****************************************************************************/
+void SPI_SclkSpeedConfig(SPI_Handle_t *pSPIHandle, uint8_t SclkSpeed)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint32_t tempreg = pSPIx->SPI_CR1;
+
+	tempreg &= ~(0x7 << SPI_CR1_BR);
+	tempreg |= (SclkSpeed & 0x7) << SPI_CR1_BR;
+	pSPIx->SPI_CR1 = tempreg;
+
+	pSPIHandle->SPIConfig.SPI_SclkSpeed = SclkSpeed;
+}
+/**************************************************************************
+ * Change the data frame format
+ * ************************************************************************
+ * @fn			- SPI_DFFConfig
+ *
+ * @brief		- Switches between 8 and 16 bit frames. SPE is cleared for
+ * 				  the change and restored, the other CR1 bits are kept.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- possible values from @SPI_DFF
  * @param[in]	-
- * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Only between transfers. Waits for the last frame to be
+ * 				  shifted out (BSY). The DMA streams are set up again for
+ * 				  the new item size with the next DMA transfer.
+ ****************************************************************************/
+void SPI_DFFConfig(SPI_Handle_t *pSPIHandle, uint8_t DFF)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint32_t spe = pSPIx->SPI_CR1 & (1 << SPI_CR1_SPE);
+
+	// DFF must only be written with the SPI disabled (RM0090 SPI_CR1)
+	while(SPI_GetFlagStatus(pSPIx, SPI_BUSY_FLAG));
+	pSPIx->SPI_CR1 &= ~(1 << SPI_CR1_SPE);
+	if(DFF == SPI_DFF_16BITS)
+		pSPIx->SPI_CR1 |= (1 << SPI_CR1_DFF);
+	else
+		pSPIx->SPI_CR1 &= ~(1 << SPI_CR1_DFF);
+	pSPIx->SPI_CR1 |= spe;
+
+	pSPIHandle->SPIConfig.SPI_DFF = DFF;
+	pSPIHandle->TxDMA.pParent = 0;
+	pSPIHandle->RxDMA.pParent = 0;
+}
+/**************************************************************************
+ * Interrupt Configuration
+ * ************************************************************************
+ * @fn			- SPI_IRQInterruptConfig
+ *
+ * @brief		- Enables or disables the SPI interrupt in the NVIC.
+ *
+ * @param[in]	- IRQ number (IRQ_NO_SPI1..)
+ * @param[in]	- ENABLE or DISABLE macros
  *
  * @return		- none
  *
  * @Note		- none
  ****************************************************************************/
+void SPI_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	NVIC_IRQInterruptConfig(IRQNumber, EnorDi);
+}
 
+/**************************************************************************
+ * Priority Configuration
+ * ************************************************************************
+ * @fn			- SPI_IRQPriorityConfig
+ *
+ * @brief		- Sets the priority of the SPI interrupt.
+ *
+ * @param[in]	- IRQ number (IRQ_NO_SPI1..)
+ * @param[in]	- priority, see @NVIC_IRQ_PRI
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void SPI_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority)
+{
+	NVIC_IRQPriorityConfig(IRQNumber, IRQPriority);
+}
 
 /**************************************************************************
+ * Interrupt Handling
+ * ************************************************************************
+ * @fn			- SPI_IRQHandling
  *
+ * @brief		- Call this from the SPIx_IRQHandler. Serves TXE, RXNE
+ * 				  and overrun of SPI_SendDataIT / SPI_ReceiveDataIT.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void SPI_IRQHandling(SPI_Handle_t *pSPIHandle)
+{
+	PROF_ISR_BEGIN();
+
+	uint32_t sr = pSPIHandle->pSPIx->SPI_SR;
+	uint32_t cr2 = pSPIHandle->pSPIx->SPI_CR2;
+
+	// 1. Check for TXE
+	if((sr & (1 << SPI_SR_TXE)) && (cr2 & (1 << SPI_CR2_TXEIE)))
+	{
+		SPI_TxeInterruptHandle(pSPIHandle);
+	}
+
+	// 2. Check for RXNE
+	if((sr & (1 << SPI_SR_RXNE)) && (cr2 & (1 << SPI_CR2_RXNEIE)))
+	{
+		SPI_RxneInterruptHandle(pSPIHandle);
+	}
+
+	// 3. Check for overrun
+	if((sr & (1 << SPI_SR_OVR)) && (cr2 & (1 << SPI_CR2_ERRIE)))
+	{
+		SPI_OvrErrInterruptHandle(pSPIHandle);
+	}
+
+	PROF_ISR_END();
+}
+
+/**************************************************************************
+ * Clear the overrun flag
  * ************************************************************************
- * @fn			-
+ * @fn			- SPI_ClearOVRFlag
  *
- * @brief		-
+ * @brief		- Reads DR and SR, which clears OVR (and RXNE).
  *
+ * @param[in]	- pointer to the SPI peripheral register structure
+ * @param[in]	-
  * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- The frame in DR is lost.
+ ****************************************************************************/
+void SPI_ClearOVRFlag(SPI_RegDef_t *pSPIx)
+{
+	uint32_t temp;
+
+	temp = pSPIx->SPI_DR;
+	temp = pSPIx->SPI_SR;
+	(void)temp;
+}
+
+/**************************************************************************
+ * Abort or finish an interrupt transmission
+ * ************************************************************************
+ * @fn			- SPI_CloseTransmission
+ *
+ * @brief		- Disables the TXE interrupt and makes the TX side ready.
+ *
+ * @param[in]	- pointer to the handle structure
  * @param[in]	-
  * @param[in]	-
  *
  * @return		- none
  *
- * @Note		- none
+ * @Note		- Also used by the application to abort a SPI_SendDataIT.
  ****************************************************************************/
+void SPI_CloseTransmission(SPI_Handle_t *pSPIHandle)
+{
+	pSPIHandle->pSPIx->SPI_CR2 &= ~(1 << SPI_CR2_TXEIE);
+	pSPIHandle->pTxBuffer = 0;
+	pSPIHandle->TxLen = 0;
+
+	if(pSPIHandle->TxState == SPI_BUSY_IN_TX)
+	{
+		pSPIHandle->TxState = SPI_READY;
+		Pwr_ReleaseStop(pSPIHandle->pSPIx);
+	}
+}
 
 /**************************************************************************
- * Interrupt Handling
+ * Abort or finish an interrupt reception
  * ************************************************************************
- * @fn			- GPIO_IRQConfig
+ * @fn			- SPI_CloseReception
  *
- * @brief		- The ISRs for various IRQ numbers are already implemented.
- * 				- These ISRs are attributed as "weak ISRs". It is your responsibility
- * 				- to override the ISRs in your application.
+ * @brief		- Disables the RXNE and error interrupts and makes the RX
+ * 				  side ready.
  *
+ * @param[in]	- pointer to the handle structure
  * @param[in]	-
  * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Also used by the application to abort a SPI_ReceiveDataIT.
+ ****************************************************************************/
+void SPI_CloseReception(SPI_Handle_t *pSPIHandle)
+{
+	pSPIHandle->pSPIx->SPI_CR2 &= ~((1 << SPI_CR2_RXNEIE) | (1 << SPI_CR2_ERRIE));
+	pSPIHandle->pRxBuffer = 0;
+	pSPIHandle->RxLen = 0;
+
+	if(pSPIHandle->RxState == SPI_BUSY_IN_RX)
+	{
+		pSPIHandle->RxState = SPI_READY;
+		Pwr_ReleaseStop(pSPIHandle->pSPIx);
+	}
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- SPI_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- SPI_EVENT_xxx
  * @param[in]	-
  *
  * @return		- none
  *
- * @Note		- none
+ * @Note		- Called from interrupt handlers.
  ****************************************************************************/
-/*void GPIO_IRQHandling(uint8_t PinNumber)
+__attribute__((weak)) void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle, uint8_t AppEv)
 {
-	// clear the exti pr register corresponding to the pin number
-	// if the PR bit position corresponding to this pin number is set, then
-	// interrupt is pending
-	if(EXTI->PR & (1 << PinNumber))
+	(void)pSPIHandle;
+	(void)AppEv;
+}
+
+static void SPI_TxeInterruptHandle(SPI_Handle_t *pSPIHandle)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+
+	if(pSPIx->SPI_CR1 & (1 << SPI_CR1_DFF))
+	{
+		// 16 bit DFF
+		pSPIx->SPI_DR = *((uint16_t*)pSPIHandle->pTxBuffer);
+		pSPIHandle->TxLen -= 2;
+		pSPIHandle->pTxBuffer += 2;
+	} else
 	{
-		// clear pending register by writing '1'
-		EXTI->PR |= (1 << PinNumber);
+		// 8 bit DFF
+		pSPIx->SPI_DR = *pSPIHandle->pTxBuffer;
+		pSPIHandle->TxLen--;
+		pSPIHandle->pTxBuffer++;
 	}
+
+	if(pSPIHandle->TxLen == 0)
+	{
+		// TX is over: close the transmission and inform the application
+		SPI_CloseTransmission(pSPIHandle);
+		SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_TX_CMPLT);
+	}
+}
+
+static void SPI_RxneInterruptHandle(SPI_Handle_t *pSPIHandle)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+
+	uint16_t frame = (uint16_t)pSPIx->SPI_DR;
+
+	if(pSPIx->SPI_CR1 & (1 << SPI_CR1_DFF))
+	{
+		// 16 bit DFF
+		if(pSPIHandle->pRxBuffer != 0)
+		{
+			*((uint16_t*)pSPIHandle->pRxBuffer) = frame;
+			pSPIHandle->pRxBuffer += 2;
+		}
+		pSPIHandle->RxLen -= 2;
+	} else
+	{
+		// 8 bit DFF
+		if(pSPIHandle->pRxBuffer != 0)
+		{
+			*pSPIHandle->pRxBuffer = (uint8_t)frame;
+			pSPIHandle->pRxBuffer++;
+		}
+		pSPIHandle->RxLen--;
+	}
+
+	if(pSPIHandle->RxLen == 0)
+	{
+		SPI_CloseReception(pSPIHandle);
+		SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_RX_CMPLT);
+	}
+}
+
+static void SPI_OvrErrInterruptHandle(SPI_Handle_t *pSPIHandle)
+{
+	// A transmission in progress reads nothing: leave the flag to the
+	// application, it clears it with SPI_ClearOVRFlag.
+	if(pSPIHandle->TxState != SPI_BUSY_IN_TX)
+	{
+		SPI_ClearOVRFlag(pSPIHandle->pSPIx);
+	}
+	SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_OVR_ERR);
+}
+
+/*
+ * Sets up the RX and TX DMA streams of the SPI (RM0090 DMA request
+ * mapping), normal mode, in frames of the configured DFF.
+ */
+static void SPI_DMAConfig(SPI_Handle_t *pSPIHandle)
+{
+	const Periph_Instance_t *pInst = Periph_Get(pSPIHandle->pSPIx);
+	DMA_Handle_t *pTx = &pSPIHandle->TxDMA;
+	DMA_Handle_t *pRx = &pSPIHandle->RxDMA;
+	uint8_t size = DMA_SIZE_BYTE;
+
+	if(pInst == 0)
+		return;
+
+	if(pSPIHandle->pSPIx->SPI_CR1 & (1 << SPI_CR1_DFF))
+		size = DMA_SIZE_HALFWORD;
+
+	pTx->pDMAx = pInst->DMATx.pDMAx;
+	pTx->Stream = pInst->DMATx.Stream;
+	pTx->DMAConfig.DMA_Channel = pInst->DMATx.Channel;
+
+	pTx->DMAConfig.DMA_Direction = DMA_DIR_MEM_TO_PERIPH;
+	pTx->DMAConfig.DMA_PeriphInc = DISABLE;
+	pTx->DMAConfig.DMA_MemInc = ENABLE;
+	pTx->DMAConfig.DMA_PeriphDataSize = size;
+	pTx->DMAConfig.DMA_MemDataSize = size;
+	pTx->DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+	pTx->DMAConfig.DMA_Priority = DMA_PRIORITY_MEDIUM;
+	pTx->DMAConfig.DMA_FIFOMode = DMA_FIFO_DIRECT;
+	pTx->pEventCallback = SPI_TxDMAEventCallback;
+	pTx->pParent = pSPIHandle;
+
+	pRx->DMAConfig = pTx->DMAConfig;
+	pRx->pDMAx = pInst->DMARx.pDMAx;
+	pRx->Stream = pInst->DMARx.Stream;
+	pRx->DMAConfig.DMA_Channel = pInst->DMARx.Channel;
+	pRx->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+	pRx->DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH; // RX must never overrun DR
+	pRx->pEventCallback = SPI_RxDMAEventCallback;
+	pRx->pParent = pSPIHandle;
+
+	DMA_Init(pTx);
+	DMA_Init(pRx);
+}
+
+// end of a DMA transfer (complete or error): streams off, both sides ready
+static void SPI_DMAFinish(SPI_Handle_t *pSPIHandle)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+
+	DMA_Stop(&pSPIHandle->TxDMA);
+	DMA_Stop(&pSPIHandle->RxDMA);
+	pSPIx->SPI_CR2 &= ~((1 << SPI_CR2_TXDMAEN) | (1 << SPI_CR2_RXDMAEN));
+
+	pSPIHandle->TxLen = 0;
+	pSPIHandle->RxLen = 0;
+	pSPIHandle->TxState = SPI_READY;
+	pSPIHandle->RxState = SPI_READY;
+	Pwr_ReleaseStop(pSPIx);
+}
+
+static void SPI_TxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	SPI_Handle_t *pSPIHandle = (SPI_Handle_t*)pDMAHandle->pParent;
+
+	if(pDMAHandle->DMAConfig.DMA_Mode == DMA_MODE_DOUBLE_BUFFER)
+	{
+		// SPI_SendStreamDMA: no RX stream, the TX stream reports
+		if(pSPIHandle->TxState != SPI_BUSY_IN_TX)
+			return;
+		if(AppEv == DMA_EVENT_CMPLT)
+		{
+			SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_TX_BUFFER_FREE);
+		} else if(AppEv == DMA_EVENT_ERROR)
+		{
+			SPI_StopStreamDMA(pSPIHandle);
+			SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_DMA_ERR);
+		}
+		return;
+	}
+
+	// completion is reported by the RX stream
+	if(AppEv == DMA_EVENT_ERROR && pSPIHandle->TxState == SPI_BUSY_IN_TX)
+	{
+		SPI_DMAFinish(pSPIHandle);
+		SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_DMA_ERR);
+	}
+}
+
+static void SPI_RxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	SPI_Handle_t *pSPIHandle = (SPI_Handle_t*)pDMAHandle->pParent;
+	uint8_t *pTxBuffer = pSPIHandle->pTxBuffer;
+	uint8_t *pRxBuffer = pSPIHandle->pRxBuffer;
+
+	// HTIF is set in normal mode too, only the end counts
+	if(pSPIHandle->RxState != SPI_BUSY_IN_RX || AppEv == DMA_EVENT_HALF_CMPLT)
+		return;
+
+	SPI_DMAFinish(pSPIHandle);
+
+	if(AppEv == DMA_EVENT_ERROR)
+	{
+		SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_DMA_ERR);
+		return;
+	}
+
+	// The buffers were taken before the callbacks: the TX_CMPLT callback
+	// may start the next transfer already.
+	if(pTxBuffer)
+		SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_TX_CMPLT);
+	if(pRxBuffer)
+		SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_RX_CMPLT);
 }
-*/
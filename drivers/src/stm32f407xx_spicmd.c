@@ -0,0 +1,340 @@
+/*
+ * stm32f407xx_spicmd.c
+ *
+ * SPI command/response engine, see stm32f407xx_spicmd.h
+ */
+#include <string.h>
+#include "stm32f407xx_spicmd.h"
+
+/*
+ * Engine phases
+ */
+#define SPICMD_PHASE_IDLE			0
+#define SPICMD_PHASE_CMD			1 // command byte
+#define SPICMD_PHASE_ACK			2 // dummy byte, ACK/NACK comes back
+#define SPICMD_PHASE_ARGS			3 // arguments, the received frames are dropped
+#define SPICMD_PHASE_WAIT			4 // turnaround before the response
+#define SPICMD_PHASE_RSP			5 // dummy bytes, response comes back
+#define SPICMD_PHASE_RETRY			6 // NACKed, waiting to repeat the command
+
+/*
+ * The Arduino slave of the course: it needs a moment (ADC conversion,
+ * digitalRead) before it can answer, one 1 ms tick is plenty.
+ */
+const SpiCmd_Desc_t SpiCmd_ArduinoCmds[SPICMD_ARDUINO_NO_OF_CMDS] =
+{
+	{ SPICMD_LED_CTRL,		2,				0,	SPICMD_ACK,	0 },
+	{ SPICMD_SENSOR_READ,	1,				1,	SPICMD_ACK,	1 },
+	{ SPICMD_LED_READ,		1,				1,	SPICMD_ACK,	1 },
+	{ SPICMD_PRINT,			SPICMD_LEN_VAR,	0,	SPICMD_ACK,	0 },
+	{ SPICMD_ID_READ,		0,				10,	SPICMD_ACK,	1 },
+};
+
+/*
+ * Helper functions
+ */
+static const SpiCmd_Desc_t *SpiCmd_Lookup(SpiCmd_Engine_t *pEngine, uint8_t Opcode);
+static void SpiCmd_Start(SpiCmd_Engine_t *pEngine);
+static void SpiCmd_Exchange(SpiCmd_Engine_t *pEngine, uint8_t *pTx, uint8_t *pRx, uint32_t Len);
+static void SpiCmd_AckReceived(SpiCmd_Engine_t *pEngine);
+static void SpiCmd_ArgsSent(SpiCmd_Engine_t *pEngine);
+static void SpiCmd_ReadResponse(SpiCmd_Engine_t *pEngine);
+static void SpiCmd_EndFrame(SpiCmd_Engine_t *pEngine);
+static void SpiCmd_Finish(SpiCmd_Engine_t *pEngine, uint8_t Status);
+static void SpiCmd_TimerHandler(uint32_t Arg);
+
+/**************************************************************************
+ * Initialize an engine
+ * ************************************************************************
+ * @fn			- SpiCmd_Init
+ *
+ * @brief		- Copies the configuration and empties the request queue.
+ *
+ * @param[in]	- pointer to the engine
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- none
+ *
+ * @Note		- Call after Sched_Init: the turnaround timer is set up
+ * 				  here.
+ ****************************************************************************/
+void SpiCmd_Init(SpiCmd_Engine_t *pEngine, SpiCmd_Config_t *pConfig)
+{
+	memset(pEngine, 0, sizeof(*pEngine));
+	pEngine->Config = *pConfig;
+	pEngine->Phase = SPICMD_PHASE_IDLE;
+
+	Sched_TimerInit(&pEngine->Timer, SpiCmd_TimerHandler, (uint32_t)(uintptr_t)pEngine, pConfig->SpiCmd_Priority);
+}
+
+/**************************************************************************
+ * Queue a command
+ * ************************************************************************
+ * @fn			- SpiCmd_Submit
+ *
+ * @brief		- Appends the request to the queue and returns. The command
+ * 				  starts at once if the engine is idle, else after the
+ * 				  requests queued before it.
+ *
+ * @param[in]	- pointer to the engine
+ * @param[in]	- pointer to the request (Opcode, pArgs, pRsp, pCallback)
+ *
+ * @return		- 1 if queued, 0 if the opcode is not in the table
+ *
+ * @Note		- May be called from interrupt handlers and from the
+ * 				  completion callback. The callback runs in the SPI
+ * 				  interrupt handler (or in the scheduler), Status tells the
+ * 				  result; the request may be submitted again from there.
+ ****************************************************************************/
+uint8_t SpiCmd_Submit(SpiCmd_Engine_t *pEngine, SpiCmd_Request_t *pReq)
+{
+	uint32_t primask;
+	uint8_t idle;
+
+	pReq->pDesc = SpiCmd_Lookup(pEngine, pReq->Opcode);
+	if(pReq->pDesc == 0)
+	{
+		pReq->Status = SPICMD_STATUS_UNKNOWN;
+		return 0;
+	}
+
+	pReq->Status = SPICMD_STATUS_PENDING;
+	pReq->Retries = 0;
+	pReq->pNext = 0;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	idle = (pEngine->pHead == 0);
+	if(idle)
+		pEngine->pHead = pReq;
+	else
+		pEngine->pTail->pNext = pReq;
+	pEngine->pTail = pReq;
+	__set_PRIMASK(primask);
+
+	if(idle)
+		SpiCmd_Start(pEngine);
+
+	return 1;
+}
+
+/**************************************************************************
+ * @fn			- SpiCmd_Busy
+ *
+ * @brief		- Tells whether requests are queued or in progress.
+ *
+ * @param[in]	- pointer to the engine
+ *
+ * @return		- 1 if busy, 0 if idle
+ ****************************************************************************/
+uint8_t SpiCmd_Busy(SpiCmd_Engine_t *pEngine)
+{
+	return pEngine->pHead != 0;
+}
+
+/**************************************************************************
+ * SPI events
+ * ************************************************************************
+ * @fn			- SpiCmd_EventHandling
+ *
+ * @brief		- Advances the request in progress. Events of other SPI
+ * 				  handles are ignored.
+ *
+ * @param[in]	- pointer to the engine
+ * @param[in]	- SPI handle of the event
+ * @param[in]	- SPI_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+void SpiCmd_EventHandling(SpiCmd_Engine_t *pEngine, SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	if(pSPIHandle != pEngine->Config.pSPIHandle || pEngine->pHead == 0)
+		return;
+
+	if(AppEv == SPI_EVENT_OVR_ERR)
+	{
+		SPI_CloseTransmission(pSPIHandle);
+		SPI_CloseReception(pSPIHandle);
+		SpiCmd_Finish(pEngine, SPICMD_STATUS_ERROR);
+		return;
+	}
+
+	switch(pEngine->Phase)
+	{
+	case SPICMD_PHASE_CMD:
+		// the byte clocked in with the command is meaningless
+		if(AppEv == SPI_EVENT_RX_CMPLT)
+		{
+			pEngine->Phase = SPICMD_PHASE_ACK;
+			pEngine->TxByte = 0xFF;
+			SpiCmd_Exchange(pEngine, &pEngine->TxByte, &pEngine->RxByte, 1);
+		}
+		break;
+	case SPICMD_PHASE_ACK:
+		if(AppEv == SPI_EVENT_RX_CMPLT)
+			SpiCmd_AckReceived(pEngine);
+		break;
+	case SPICMD_PHASE_ARGS:
+		if(AppEv == SPI_EVENT_RX_CMPLT)
+			SpiCmd_ArgsSent(pEngine);
+		break;
+	case SPICMD_PHASE_RSP:
+		if(AppEv == SPI_EVENT_RX_CMPLT)
+			SpiCmd_Finish(pEngine, SPICMD_STATUS_OK);
+		break;
+	default:
+		break;
+	}
+}
+
+static const SpiCmd_Desc_t *SpiCmd_Lookup(SpiCmd_Engine_t *pEngine, uint8_t Opcode)
+{
+	for(uint8_t i = 0; i < pEngine->Config.CmdCount; i++)
+	{
+		if(pEngine->Config.pCmdTable[i].Opcode == Opcode)
+			return &pEngine->Config.pCmdTable[i];
+	}
+	return 0;
+}
+
+// first phase of the request at the head of the queue
+static void SpiCmd_Start(SpiCmd_Engine_t *pEngine)
+{
+	SPI_RegDef_t *pSPIx = pEngine->Config.pSPIHandle->pSPIx;
+
+	// a frame left over by an earlier user of the SPI (e.g. a TX only
+	// transfer) would shift the data
+	SPI_ClearOVRFlag(pSPIx);
+	SPI_PeripheralControl(pSPIx, ENABLE);
+
+	pEngine->Phase = SPICMD_PHASE_CMD;
+	pEngine->TxByte = pEngine->pHead->Opcode;
+	SpiCmd_Exchange(pEngine, &pEngine->TxByte, &pEngine->RxByte, 1);
+}
+
+// Full duplex interrupt transfer (pRx 0 drops the received frames).
+// Every phase is one: its completion, SPI_EVENT_RX_CMPLT, comes after the
+// last frame was shifted in, so no frame is left over for the next phase.
+static void SpiCmd_Exchange(SpiCmd_Engine_t *pEngine, uint8_t *pTx, uint8_t *pRx, uint32_t Len)
+{
+	SPI_Handle_t *pSPIHandle = pEngine->Config.pSPIHandle;
+
+	SPI_ReceiveDataIT(pSPIHandle, pRx, Len);
+	SPI_SendDataIT(pSPIHandle, pTx, Len);
+}
+
+static void SpiCmd_AckReceived(SpiCmd_Engine_t *pEngine)
+{
+	SpiCmd_Request_t *pReq = pEngine->pHead;
+	const SpiCmd_Desc_t *pDesc = pReq->pDesc;
+	uint8_t len = (pDesc->ArgLen == SPICMD_LEN_VAR) ? pReq->ArgLen : pDesc->ArgLen;
+
+	if(pEngine->RxByte != pDesc->Ack)
+	{
+		pReq->Retries++;
+		if(pReq->Retries > pEngine->Config.SpiCmd_MaxRetries)
+		{
+			SpiCmd_Finish(pEngine, SPICMD_STATUS_NACK);
+			return;
+		}
+
+		// NSS goes high: the slave starts over with the next command byte
+		SpiCmd_EndFrame(pEngine);
+		pEngine->Phase = SPICMD_PHASE_RETRY;
+		Sched_TimerStart(&pEngine->Timer, pDesc->TurnaroundTicks, 0);
+		return;
+	}
+
+	if(len == 0)
+	{
+		SpiCmd_ArgsSent(pEngine);
+		return;
+	}
+
+	pEngine->Phase = SPICMD_PHASE_ARGS;
+	SpiCmd_Exchange(pEngine, (uint8_t*)pReq->pArgs, 0, len);
+}
+
+static void SpiCmd_ArgsSent(SpiCmd_Engine_t *pEngine)
+{
+	const SpiCmd_Desc_t *pDesc = pEngine->pHead->pDesc;
+
+	if(pDesc->RspLen == 0)
+	{
+		SpiCmd_Finish(pEngine, SPICMD_STATUS_OK);
+	} else if(pDesc->TurnaroundTicks != 0)
+	{
+		pEngine->Phase = SPICMD_PHASE_WAIT;
+		Sched_TimerStart(&pEngine->Timer, pDesc->TurnaroundTicks, 0);
+	} else
+	{
+		SpiCmd_ReadResponse(pEngine);
+	}
+}
+
+static void SpiCmd_ReadResponse(SpiCmd_Engine_t *pEngine)
+{
+	SpiCmd_Request_t *pReq = pEngine->pHead;
+	uint8_t len = pReq->pDesc->RspLen;
+
+	// The response buffer also holds the 0xFF dummy bytes: frame i is
+	// loaded into DR before frame i is received, so nothing is overwritten
+	// before it was sent.
+	pEngine->Phase = SPICMD_PHASE_RSP;
+	memset(pReq->pRsp, 0xFF, len);
+	SpiCmd_Exchange(pEngine, pReq->pRsp, pReq->pRsp, len);
+}
+
+// Disables the SPI (NSS high with SSOE). It runs in the SPI interrupt
+// handler once the last frame was received: nothing is shifting any more,
+// BSY only covers the last half SCK period (RM0090 disabling procedure).
+static void SpiCmd_EndFrame(SpiCmd_Engine_t *pEngine)
+{
+	SPI_RegDef_t *pSPIx = pEngine->Config.pSPIHandle->pSPIx;
+
+	while(SPI_GetFlagStatus(pSPIx, SPI_BUSY_FLAG));
+	SPI_ClearOVRFlag(pSPIx);
+	SPI_PeripheralControl(pSPIx, DISABLE);
+}
+
+// completes the request at the head and starts the next one
+static void SpiCmd_Finish(SpiCmd_Engine_t *pEngine, uint8_t Status)
+{
+	SpiCmd_Request_t *pReq = pEngine->pHead;
+	SpiCmd_Request_t *pNext;
+	uint32_t primask;
+
+	SpiCmd_EndFrame(pEngine);
+	pEngine->Phase = SPICMD_PHASE_IDLE;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	pNext = pReq->pNext;
+	pEngine->pHead = pNext;
+	if(pNext == 0)
+		pEngine->pTail = 0;
+	__set_PRIMASK(primask);
+
+	// next first: a request submitted by the callback is queued behind it
+	if(pNext != 0)
+		SpiCmd_Start(pEngine);
+
+	pReq->Status = Status;
+	if(pReq->pCallback)
+		pReq->pCallback(pReq);
+}
+
+static void SpiCmd_TimerHandler(uint32_t Arg)
+{
+	SpiCmd_Engine_t *pEngine = (SpiCmd_Engine_t*)(uintptr_t)Arg;
+
+	if(pEngine->Phase == SPICMD_PHASE_WAIT)
+	{
+		SpiCmd_ReadResponse(pEngine);
+	} else if(pEngine->Phase == SPICMD_PHASE_RETRY)
+	{
+		SpiCmd_Start(pEngine);
+	}
+}
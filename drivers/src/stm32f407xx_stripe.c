@@ -0,0 +1,298 @@
+/*
+ * stm32f407xx_stripe.c
+ *
+ * SPI striping, see stm32f407xx_stripe.h
+ */
+#include <string.h>
+#include "stm32f407xx_stripe.h"
+
+/*
+ * Helper functions
+ */
+static uint8_t Stripe_SharesStream(const Periph_DMARequest_t *pA, const Periph_DMARequest_t *pB);
+static void Stripe_Select(Stripe_Leg_t *pLeg, uint8_t Selected);
+static void Stripe_LegDone(Stripe_Handle_t *pStripe, uint8_t Leg, uint8_t Failed);
+static uint8_t Stripe_Claim(Stripe_Handle_t *pStripe);
+
+/**************************************************************************
+ * Initialize the striping
+ * ************************************************************************
+ * @fn			- Stripe_Init
+ *
+ * @brief		- Checks the legs' DMA streams and reads the SCLK of each
+ * 				  leg, which sets its share of the transfers.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- @STRIPE_RETURN
+ *
+ * @Note		- Call it again after changing the speed of an SPI.
+ ****************************************************************************/
+uint8_t Stripe_Init(Stripe_Handle_t *pStripe, Stripe_Config_t *pConfig)
+{
+	const Periph_Instance_t *pInst[STRIPE_MAX_LEGS];
+
+	if(pConfig->Legs == 0 || pConfig->Legs > STRIPE_MAX_LEGS)
+		return STRIPE_ERR_PARAM;
+
+	for(uint8_t i = 0; i < pConfig->Legs; i++)
+	{
+		pInst[i] = Periph_Get(pConfig->Leg[i].pSPIHandle->pSPIx);
+		if(pInst[i] == 0)
+			return STRIPE_ERR_PARAM;
+
+		// concurrent legs need streams of their own
+		for(uint8_t j = 0; j < i; j++)
+		{
+			if(Stripe_SharesStream(&pInst[i]->DMARx, &pInst[j]->DMARx) ||
+			   Stripe_SharesStream(&pInst[i]->DMARx, &pInst[j]->DMATx) ||
+			   Stripe_SharesStream(&pInst[i]->DMATx, &pInst[j]->DMARx) ||
+			   Stripe_SharesStream(&pInst[i]->DMATx, &pInst[j]->DMATx))
+				return STRIPE_ERR_PARAM;
+		}
+	}
+
+	memset(pStripe, 0, sizeof(*pStripe));
+	pStripe->Config = *pConfig;
+	if(pStripe->Config.Align == 0)
+		pStripe->Config.Align = 1;
+
+	for(uint8_t i = 0; i < pConfig->Legs; i++)
+	{
+		uint32_t pclk = (pInst[i]->Bus == PERIPH_BUS_APB2) ? RCC_GetPCLK2Value() : RCC_GetPCLK1Value();
+
+		pStripe->SclkHz[i] = pclk >> (pConfig->Leg[i].pSPIHandle->SPIConfig.SPI_SclkSpeed + 1);
+		pStripe->TotalHz += pStripe->SclkHz[i];
+	}
+
+	return STRIPE_OK;
+}
+
+/**************************************************************************
+ * Striped transfer
+ * ************************************************************************
+ * @fn			- Stripe_Transfer
+ *
+ * @brief		- Selects each leg's device and starts its piece of the
+ * 				  buffers on its SPI, all legs at once.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the TX buffer, 0 to send 0xFF frames
+ * @param[in]	- pointer to the RX buffer, 0 to drop the received frames
+ * @param[in]	- number of bytes
+ *
+ * @return		- @STRIPE_RETURN
+ *
+ * @Note		- STRIPE_EVENT_CMPLT (or ERROR) when the last leg is done.
+ * 				  Nothing is started if one of the SPIs is busy.
+ ****************************************************************************/
+uint8_t Stripe_Transfer(Stripe_Handle_t *pStripe, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t legs = pStripe->Config.Legs;
+	uint32_t offset[STRIPE_MAX_LEGS], len[STRIPE_MAX_LEGS];
+	uint8_t pending = 0;
+
+	if(Len == 0)
+		return STRIPE_ERR_PARAM;
+	for(uint8_t i = 0; i < legs; i++)
+	{
+		Stripe_GetSpan(pStripe, Len, i, &offset[i], &len[i]);
+		if(len[i] > 0xFFFF)
+			return STRIPE_ERR_PARAM;
+		if(len[i] != 0)
+			pending |= (uint8_t)(1U << i);
+	}
+
+	if(!Stripe_Claim(pStripe))
+		return STRIPE_BUSY;
+	for(uint8_t i = 0; i < legs; i++)
+	{
+		SPI_Handle_t *pSPIHandle = pStripe->Config.Leg[i].pSPIHandle;
+
+		if(pSPIHandle->TxState != SPI_READY || pSPIHandle->RxState != SPI_READY)
+		{
+			pStripe->Busy = 0;
+			return STRIPE_BUSY;
+		}
+	}
+
+	// all legs pending before the first one starts: a quick leg must not
+	// end the transfer
+	pStripe->Len = Len;
+	pStripe->Failed = 0;
+	pStripe->Pending = pending;
+
+	for(uint8_t i = 0; i < legs; i++)
+	{
+		if(len[i] == 0)
+			continue;
+
+		pStripe->ExpectedEv[i] = pRxBuffer ? SPI_EVENT_RX_CMPLT : SPI_EVENT_TX_CMPLT;
+		Stripe_Select(&pStripe->Config.Leg[i], 1);
+		if(SPI_TransferDMA(pStripe->Config.Leg[i].pSPIHandle, pTxBuffer ? pTxBuffer + offset[i] : 0,
+				pRxBuffer ? pRxBuffer + offset[i] : 0, len[i]) != SPI_READY)
+			Stripe_LegDone(pStripe, i, 1);
+	}
+	return STRIPE_OK;
+}
+
+/**************************************************************************
+ * @fn			- Stripe_GetSpan
+ *
+ * @brief		- Tells which bytes of a transfer of Len bytes go over a
+ * 				  leg.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- length of the transfer
+ * @param[in]	- leg number
+ * @param[out]	- offset of the leg's piece in the buffers
+ * @param[out]	- length of the leg's piece, may be 0
+ *
+ * @return		- none
+ *
+ * @Note		- The same for every transfer of that length, until the
+ * 				  next Stripe_Init.
+ ****************************************************************************/
+void Stripe_GetSpan(Stripe_Handle_t *pStripe, uint32_t Len, uint8_t Leg, uint32_t *pOffset, uint32_t *pLen)
+{
+	uint32_t align = pStripe->Config.Align;
+	uint32_t offset = 0, piece = 0;
+
+	for(uint8_t i = 0; i <= Leg; i++)
+	{
+		offset += piece;
+		if(i == pStripe->Config.Legs - 1)
+		{
+			// the last leg takes the rounding
+			piece = Len - offset;
+		} else
+		{
+			piece = (uint32_t)((uint64_t)Len * pStripe->SclkHz[i] / pStripe->TotalHz);
+			piece -= piece % align;
+			if(piece > Len - offset)
+				piece = Len - offset;
+		}
+	}
+
+	*pOffset = offset;
+	*pLen = piece;
+}
+
+/**************************************************************************
+ * @fn			- Stripe_Busy
+ *
+ * @brief		- Tells whether a transfer is running.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if not
+ ****************************************************************************/
+uint8_t Stripe_Busy(Stripe_Handle_t *pStripe)
+{
+	return pStripe->Busy;
+}
+
+/**************************************************************************
+ * SPI events
+ * ************************************************************************
+ * @fn			- Stripe_EventHandling
+ *
+ * @brief		- Ends the leg of the SPI of the event. Events of other
+ * 				  SPI handles are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- SPI handle of the event
+ * @param[in]	- SPI_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+void Stripe_EventHandling(Stripe_Handle_t *pStripe, SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	if(!pStripe->Busy)
+		return;
+
+	for(uint8_t i = 0; i < pStripe->Config.Legs; i++)
+	{
+		if(pStripe->Config.Leg[i].pSPIHandle != pSPIHandle || !(pStripe->Pending & (1U << i)))
+			continue;
+
+		if(AppEv == SPI_EVENT_OVR_ERR || AppEv == SPI_EVENT_DMA_ERR)
+			Stripe_LegDone(pStripe, i, 1);
+		else if(AppEv == pStripe->ExpectedEv[i])
+			Stripe_LegDone(pStripe, i, 0);
+		return;
+	}
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Stripe_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- STRIPE_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler of the last leg. The
+ * 				  next transfer may be started from here.
+ ****************************************************************************/
+__attribute__((weak)) void Stripe_ApplicationEventCallback(Stripe_Handle_t *pStripe, uint8_t AppEv)
+{
+	(void)pStripe;
+	(void)AppEv;
+}
+
+static uint8_t Stripe_SharesStream(const Periph_DMARequest_t *pA, const Periph_DMARequest_t *pB)
+{
+	return pA->pDMAx != 0 && pA->pDMAx == pB->pDMAx && pA->Stream == pB->Stream;
+}
+
+static void Stripe_Select(Stripe_Leg_t *pLeg, uint8_t Selected)
+{
+	if(pLeg->pCSPort != 0)
+		GPIO_WriteToOutputPin(pLeg->pCSPort, pLeg->CSPin, Selected ? RESET : SET);
+}
+
+// the legs end in their own DMA interrupts, maybe nested
+static void Stripe_LegDone(Stripe_Handle_t *pStripe, uint8_t Leg, uint8_t Failed)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t last;
+
+	Stripe_Select(&pStripe->Config.Leg[Leg], 0);
+
+	__disable_irq();
+	pStripe->Pending &= (uint8_t)~(1U << Leg);
+	if(Failed)
+		pStripe->Failed |= (uint8_t)(1U << Leg);
+	last = (pStripe->Pending == 0);
+	__set_PRIMASK(primask);
+
+	if(!last)
+		return;
+
+	pStripe->Transfers++;
+	pStripe->Busy = 0;
+	Stripe_ApplicationEventCallback(pStripe, pStripe->Failed ? STRIPE_EVENT_ERROR : STRIPE_EVENT_CMPLT);
+}
+
+static uint8_t Stripe_Claim(Stripe_Handle_t *pStripe)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t claimed = 0;
+
+	__disable_irq();
+	if(!pStripe->Busy)
+	{
+		pStripe->Busy = 1;
+		claimed = 1;
+	}
+	__set_PRIMASK(primask);
+	return claimed;
+}
@@ -0,0 +1,970 @@
+// In driver.c, you have to include respective peripheral's driver file.
+#include "stm32f407xx_tim_driver.h"
+
+/*
+ * DMA request mapping of the timers (RM0090 DMA1/DMA2 request mapping).
+ * Request 0 is the update request, 1..4 the capture/compare requests.
+ * Where RM0090 offers two streams for one request, the one which does not
+ * collide with the USART/I2C defaults of this repo is used.
+ */
+#define TIM_DMA_REQ_UP				0
+#define TIM_DMA_NONE				0xFF
+
+typedef struct
+{
+	TIM_RegDef_t *pTIMx;
+	DMA_RegDef_t *pDMAx;
+	uint8_t Stream[5];
+	uint8_t Channel[5];
+} TIM_DMAMap_t;
+
+// indexed by the instance number: rows in @PERIPH_ID order from TIM1
+static const TIM_DMAMap_t TIM_DMAMap[] =
+{
+	//   timer  DMA     UP  CC1 CC2 CC3 CC4			UP  CC1 CC2 CC3 CC4
+	{ TIM1, DMA2, { 5,  1,  2,  6,  4 }, { 6,  6,  6,  6,  6 } },
+	{ TIM2, DMA1, { 7,  5,  6,  1,  6 }, { 3,  3,  3,  3,  3 } },
+	{ TIM3, DMA1, { 2,  4,  5,  7,  2 }, { 5,  5,  5,  5,  5 } },
+	{ TIM4, DMA1, { 6,  0,  3,  7,  TIM_DMA_NONE }, { 2,  2,  2,  2,  0 } },
+	{ TIM5, DMA1, { 6,  2,  4,  0,  1 }, { 6,  6,  6,  6,  6 } },
+	{ TIM6, DMA1, { 1,  TIM_DMA_NONE, TIM_DMA_NONE, TIM_DMA_NONE, TIM_DMA_NONE }, { 7, 0, 0, 0, 0 } },
+	{ TIM7, DMA1, { 2,  TIM_DMA_NONE, TIM_DMA_NONE, TIM_DMA_NONE, TIM_DMA_NONE }, { 1, 0, 0, 0, 0 } },
+	{ TIM8, DMA2, { 1,  2,  3,  4,  7 }, { 7,  7,  7,  7,  7 } },
+};
+
+/*
+ * Helper functions (private to this driver)
+ */
+static uint8_t TIM_IsAdvanced(TIM_RegDef_t *pTIMx);
+static uint8_t TIM_SetupDMA(TIM_Handle_t *pTIMHandle, DMA_Handle_t *pDMAHandle, uint8_t Request, uint8_t Direction,
+		uint8_t Mode, uint8_t Size);
+static void TIM_DMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+
+/**********************************************************************
+ * Peripheral Clock setup
+ * (Peripheral Control API)
+ * ********************************************************************
+ * @fn			- TIM_PeriClockControl
+ *
+ * @brief		- This function enables or disables peripheral clock
+ * 				  for the given timer
+ *
+ * @param[in]	- base address of the TIM peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Reference counted by the clock manager: the clock goes
+ * 				  off with the last DISABLE, see stm32f407xx_clk.h
+ ***********************************************************************/
+void TIM_PeriClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi)
+{
+	Clk_Control(pTIMx, EnorDi);
+}
+
+/**************************************************************************
+ * Timer clock
+ * ************************************************************************
+ * @fn			- TIM_GetClockValue
+ *
+ * @brief		- Returns the clock of the timer counter before the
+ * 				  prescaler. The timers run at PCLKx when the APB prescaler
+ * 				  is 1, and at 2 x PCLKx otherwise.
+ *
+ * @param[in]	- base address of the TIM peripheral
+ *
+ * @return		- clock in Hz
+ *
+ * @Note		- TIM1/8/9/10/11 are on APB2, the others on APB1.
+ ****************************************************************************/
+uint32_t TIM_GetClockValue(TIM_RegDef_t *pTIMx)
+{
+	uint32_t pclk;
+	uint8_t ppre;
+
+	if(pTIMx == TIM1 || pTIMx == TIM8 || pTIMx == TIM9 || pTIMx == TIM10 || pTIMx == TIM11)
+	{
+		pclk = RCC_GetPCLK2Value();
+		ppre = (RCC->CFGR >> RCC_CFGR_PPRE2) & 0x7;
+	} else
+	{
+		pclk = RCC_GetPCLK1Value();
+		ppre = (RCC->CFGR >> RCC_CFGR_PPRE1) & 0x7;
+	}
+
+	// PPREx < 4: APB clock not divided
+	if(ppre < 4)
+		return pclk;
+
+	return 2 * pclk;
+}
+
+/**************************************************************************
+ * Initialize the time base
+ * ************************************************************************
+ * @fn			- TIM_Init
+ *
+ * @brief		- To configure counter mode, prescaler, period and
+ * 				  repetition counter. The prescaler is loaded at once with
+ * 				  an update event.
+ *
+ * 				  update frequency = timer clock / ((PSC + 1) * (ARR + 1))
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- The counter is left stopped, call TIM_PeripheralControl
+ * 				  or TIM_StartIT. Basic timers (TIM6/7) only count up.
+ ****************************************************************************/
+void TIM_Init(TIM_Handle_t *pTIMHandle)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+	uint32_t tempreg = 0;
+
+	Clk_Ensure(pTIMx);
+
+	/************************************************************************
+	 * 1. Configure CR1 (counter mode and auto-reload preload)
+	 ************************************************************************/
+	if(pTIMHandle->TIM_Config.TIM_CounterMode == TIM_COUNTER_DOWN)
+	{
+		tempreg |= (1 << TIM_CR1_DIR);
+	} else if(pTIMHandle->TIM_Config.TIM_CounterMode >= TIM_COUNTER_CENTER1)
+	{
+		tempreg |= ((pTIMHandle->TIM_Config.TIM_CounterMode - TIM_COUNTER_CENTER1 + 1) << TIM_CR1_CMS);
+	}
+
+	if(pTIMHandle->TIM_Config.TIM_AutoReloadPreload == ENABLE)
+	{
+		tempreg |= (1 << TIM_CR1_ARPE);
+	}
+	pTIMx->CR1 = tempreg;
+
+	/************************************************************************
+	 * 2. Prescaler, period and repetition counter
+	 ************************************************************************/
+	pTIMx->PSC = pTIMHandle->TIM_Config.TIM_Prescaler;
+	pTIMx->ARR = pTIMHandle->TIM_Config.TIM_Period;
+	if(TIM_IsAdvanced(pTIMx))
+	{
+		pTIMx->RCR = pTIMHandle->TIM_Config.TIM_RepetitionCounter;
+	}
+
+	/************************************************************************
+	 * 3. Update event to load PSC (it is always preloaded), then drop the
+	 *    UIF which this update sets, so no interrupt is seen at start.
+	 ************************************************************************/
+	pTIMx->EGR = (1 << TIM_EGR_UG);
+	pTIMx->SR = ~(1 << TIM_SR_UIF);
+
+	pTIMHandle->CCDMAChannel = 0;
+}
+
+/**************************************************************************
+ * Deinitialize TIM
+ * ************************************************************************
+ * @fn			- TIM_DeInit
+ *
+ * @brief		- Resets all registers of the timer with the RCC reset register.
+ *
+ * @param[in]	- base address of the TIM peripheral
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void TIM_DeInit(TIM_RegDef_t *pTIMx)
+{
+	Periph_Reset(pTIMx);
+}
+
+/**************************************************************************
+ * Time base interrupt
+ * ************************************************************************
+ * @fn			- TIM_StartIT
+ *
+ * @brief		- Enables the update interrupt and starts the counter.
+ * 				  TIM_EVENT_UPDATE is reported once per period.
+ *
+ * @param[in]	- pointer to the handle structure
+ *
+ * @return		- none
+ *
+ * @Note		- The timer IRQ must be enabled with TIM_IRQInterruptConfig.
+ ****************************************************************************/
+void TIM_StartIT(TIM_Handle_t *pTIMHandle)
+{
+	pTIMHandle->pTIMx->DIER |= (1 << TIM_DIER_UIE);
+	pTIMHandle->pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+}
+
+/**************************************************************************
+ * @fn			- TIM_StopIT
+ *
+ * @brief		- Stops the counter and disables the update interrupt.
+ *
+ * @param[in]	- pointer to the handle structure
+ ****************************************************************************/
+void TIM_StopIT(TIM_Handle_t *pTIMHandle)
+{
+	pTIMHandle->pTIMx->CR1 &= ~(1 << TIM_CR1_CEN);
+	pTIMHandle->pTIMx->DIER &= ~(1 << TIM_DIER_UIE);
+}
+
+/**************************************************************************
+ * Output compare / PWM channel
+ * ************************************************************************
+ * @fn			- TIM_OCConfigChannel
+ *
+ * @brief		- Configures a channel as output: mode, polarity, CCR
+ * 				  preload and the compare value.
+ *
+ * 				  PWM1, up counting: duty = OC_Pulse / (ARR + 1)
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- channel, possible values from @TIM_Channel
+ * @param[in]	- pointer to the channel configuration
+ *
+ * @return		- none
+ *
+ * @Note		- The output is left disabled, call TIM_OCChannelControl.
+ * 				  The pin is GPIO_MODE_ALTFN with the AF of the timer.
+ ****************************************************************************/
+void TIM_OCConfigChannel(TIM_Handle_t *pTIMHandle, uint8_t Channel, TIM_OC_Config_t *pOCConfig)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+	uint8_t ccmr = (Channel - 1) / 2;
+	uint8_t shift = ((Channel - 1) % 2) * 8;
+	uint32_t tempreg;
+
+	// CCxS (and the mode fields) can only be written while CCxE = 0
+	pTIMx->CCER &= ~(1 << (TIM_CCER_CCE + 4 * (Channel - 1)));
+
+	// 1. CCMR: output (CCxS = 00), mode and preload
+	tempreg = pTIMx->CCMR[ccmr];
+	tempreg &= ~(0xFF << shift);
+	tempreg |= ((uint32_t)pOCConfig->OC_Mode << (TIM_CCMR_OCM + shift));
+	if(pOCConfig->OC_Preload == ENABLE)
+	{
+		tempreg |= (1 << (TIM_CCMR_OCPE + shift));
+	}
+	pTIMx->CCMR[ccmr] = tempreg;
+
+	// 2. CCER: polarity
+	tempreg = pTIMx->CCER;
+	tempreg &= ~(0xF << (4 * (Channel - 1)));
+	tempreg |= ((uint32_t)pOCConfig->OC_Polarity << (TIM_CCER_CCP + 4 * (Channel - 1)));
+	pTIMx->CCER = tempreg;
+
+	// 3. Compare value
+	pTIMx->CCR[Channel - 1] = pOCConfig->OC_Pulse;
+}
+
+/**************************************************************************
+ * @fn			- TIM_OCChannelControl
+ *
+ * @brief		- Enables or disables the output of a channel. On TIM1/8
+ * 				  the main output enable (MOE) is also set.
+ *
+ * @param[in]	- base address of the TIM peripheral
+ * @param[in]	- channel, possible values from @TIM_Channel
+ * @param[in]	- ENABLE or DISABLE macros
+ ****************************************************************************/
+void TIM_OCChannelControl(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t EnOrDi)
+{
+	if(EnOrDi == ENABLE)
+	{
+		pTIMx->CCER |= (1 << (TIM_CCER_CCE + 4 * (Channel - 1)));
+		if(TIM_IsAdvanced(pTIMx))
+			pTIMx->BDTR |= (1 << TIM_BDTR_MOE);
+	} else
+	{
+		pTIMx->CCER &= ~(1 << (TIM_CCER_CCE + 4 * (Channel - 1)));
+	}
+}
+
+/**************************************************************************
+ * @fn			- TIM_SetCompare
+ *
+ * @brief		- Writes the compare value (PWM duty) of a channel.
+ *
+ * @param[in]	- base address of the TIM peripheral
+ * @param[in]	- channel, possible values from @TIM_Channel
+ * @param[in]	- new CCR value
+ *
+ * @Note		- With OC_Preload the value is taken at the next update.
+ ****************************************************************************/
+void TIM_SetCompare(TIM_RegDef_t *pTIMx, uint8_t Channel, uint32_t Value)
+{
+	pTIMx->CCR[Channel - 1] = Value;
+}
+
+/**************************************************************************
+ * PWM with DMA burst
+ * ************************************************************************
+ * @fn			- TIM_PWMStartBurstDMA
+ *
+ * @brief		- On every update event the DMA writes NoOfChannels words
+ * 				  from pBuffer into CCR[FirstChannel]..CCR[FirstChannel +
+ * 				  NoOfChannels - 1] through DMAR (burst mode). The duty
+ * 				  cycles of several channels follow the buffer without any
+ * 				  CPU work.
+ *
+ * 				  pBuffer layout: { CCRa, CCRb, .. } per update, NoOfUpdates
+ * 				  times, i.e. NoOfChannels * NoOfUpdates words.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- first channel and number of channels (1..4)
+ * @param[in]	- buffer and number of update periods it covers
+ * @param[in]	- ENABLE to repeat the buffer forever (circular DMA)
+ *
+ * @return		- SET if started, RESET if the timer has no update DMA request
+ *
+ * @Note		- Configure the channels with TIM_OCConfigChannel (with
+ * 				  OC_Preload) first. The counter is started here.
+ ****************************************************************************/
+uint8_t TIM_PWMStartBurstDMA(TIM_Handle_t *pTIMHandle, uint8_t FirstChannel, uint8_t NoOfChannels, uint32_t *pBuffer, uint16_t NoOfUpdates, uint8_t Circular)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+	uint32_t len = (uint32_t)NoOfChannels * NoOfUpdates;
+
+	if(len == 0 || len > 0xFFFF || FirstChannel + NoOfChannels > 5)
+		return RESET;
+
+	if(TIM_SetupDMA(pTIMHandle, &pTIMHandle->UpDMA, TIM_DMA_REQ_UP, DMA_DIR_MEM_TO_PERIPH,
+			(Circular == ENABLE) ? DMA_MODE_CIRCULAR : DMA_MODE_NORMAL, DMA_SIZE_WORD) == RESET)
+		return RESET;
+
+	// 1. DBA: word offset of CCRx from the start of the timer, DBL: transfers per burst
+	pTIMx->DCR = (((uint32_t)(&pTIMx->CCR[FirstChannel - 1] - &pTIMx->CR1)) << TIM_DCR_DBA) |
+				 ((uint32_t)(NoOfChannels - 1) << TIM_DCR_DBL);
+
+	// 2. Stream and update DMA request
+	DMA_Start(&pTIMHandle->UpDMA, (uint32_t)&pTIMx->DMAR, (uint32_t)pBuffer, (uint16_t)len);
+	pTIMx->DIER |= (1 << TIM_DIER_UDE);
+
+	// 3. Outputs on, counter on
+	for(uint8_t ch = FirstChannel; ch < FirstChannel + NoOfChannels; ch++)
+	{
+		TIM_OCChannelControl(pTIMx, ch, ENABLE);
+	}
+	pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+
+	return SET;
+}
+
+/**************************************************************************
+ * @fn			- TIM_PWMStopBurstDMA
+ *
+ * @brief		- Stops the update DMA requests. The counter and the
+ * 				  outputs keep running with the last duty cycles.
+ *
+ * @param[in]	- pointer to the handle structure
+ ****************************************************************************/
+void TIM_PWMStopBurstDMA(TIM_Handle_t *pTIMHandle)
+{
+	// never started: no stream to stop
+	if(pTIMHandle->UpDMA.pDMAx == 0)
+		return;
+
+	pTIMHandle->pTIMx->DIER &= ~(1 << TIM_DIER_UDE);
+	DMA_Stop(&pTIMHandle->UpDMA);
+}
+
+/**************************************************************************
+ * Update DMA to any register
+ * ************************************************************************
+ * @fn			- TIM_UpdateStartDMA
+ *
+ * @brief		- On every update event the DMA writes the next word of
+ * 				  pBuffer to DestAddr, e.g. a GPIO BSRR: the timer clocks
+ * 				  out a pin pattern without any CPU work.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- address of the destination register
+ * @param[in]	- buffer and number of words (one per update)
+ * @param[in]	- ENABLE to repeat the buffer forever (circular DMA)
+ *
+ * @return		- SET if started, RESET if the timer has no update DMA request
+ *
+ * @Note		- The first word goes out one period after the start. Only
+ * 				  DMA2 (TIM1, TIM8) reaches the AHB1 GPIO ports, DMA1's
+ * 				  peripheral port is on APB1 only. TIM_EVENT_DMA_CMPLT at
+ * 				  the end of a normal transfer, the counter keeps running.
+ * 				  A circular buffer runs without interrupts, only
+ * 				  TIM_EVENT_DMA_ERROR is reported.
+ ****************************************************************************/
+uint8_t TIM_UpdateStartDMA(TIM_Handle_t *pTIMHandle, uint32_t DestAddr, uint32_t *pBuffer, uint16_t Len, uint8_t Circular)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+
+	if(Len == 0)
+		return RESET;
+
+	if(TIM_SetupDMA(pTIMHandle, &pTIMHandle->UpDMA, TIM_DMA_REQ_UP, DMA_DIR_MEM_TO_PERIPH,
+			(Circular == ENABLE) ? DMA_MODE_CIRCULAR : DMA_MODE_NORMAL, DMA_SIZE_WORD) == RESET)
+		return RESET;
+
+	// A repeating buffer has nothing to refill: an interrupt at every half
+	// and full wrap would only load the CPU. The error interrupts stay.
+	if(Circular == ENABLE)
+		DMA_STREAM(&pTIMHandle->UpDMA)->CR &= ~((1 << DMA_SxCR_HTIE) | (1 << DMA_SxCR_TCIE));
+
+	DMA_Start(&pTIMHandle->UpDMA, DestAddr, (uint32_t)pBuffer, Len);
+	pTIMx->DIER |= (1 << TIM_DIER_UDE);
+	pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+
+	return SET;
+}
+
+/**************************************************************************
+ * Update DMA to any register, double buffered
+ * ************************************************************************
+ * @fn			- TIM_UpdateStartDMADoubleBuffer
+ *
+ * @brief		- Like TIM_UpdateStartDMA, but the DMA takes the words
+ * 				  from pBuffer0, then pBuffer1, then pBuffer0 again, for
+ * 				  streams longer than a buffer.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- address of the destination register
+ * @param[in]	- the two buffers and the number of words of each
+ *
+ * @return		- SET if started, RESET if the timer has no update DMA request
+ *
+ * @Note		- TIM_EVENT_DMA_CMPLT after each buffer; the one the DMA
+ * 				  is not on (DMA_GetCurrentTarget(&UpDMA)) may be refilled.
+ ****************************************************************************/
+uint8_t TIM_UpdateStartDMADoubleBuffer(TIM_Handle_t *pTIMHandle, uint32_t DestAddr, uint32_t *pBuffer0, uint32_t *pBuffer1, uint16_t Len)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+
+	if(Len == 0)
+		return RESET;
+
+	if(TIM_SetupDMA(pTIMHandle, &pTIMHandle->UpDMA, TIM_DMA_REQ_UP, DMA_DIR_MEM_TO_PERIPH,
+			DMA_MODE_DOUBLE_BUFFER, DMA_SIZE_WORD) == RESET)
+		return RESET;
+
+	DMA_StartDoubleBuffer(&pTIMHandle->UpDMA, DestAddr, (uint32_t)pBuffer0, (uint32_t)pBuffer1, Len);
+	pTIMx->DIER |= (1 << TIM_DIER_UDE);
+	pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+
+	return SET;
+}
+
+/**************************************************************************
+ * Update DMA from any register
+ * ************************************************************************
+ * @fn			- TIM_UpdateStartReadDMA
+ *
+ * @brief		- On every update event the DMA reads the 16 bit register
+ * 				  at SrcAddr into the next halfword of pBuffer, e.g. a GPIO
+ * 				  IDR: the pins are sampled at the timer's rate.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- address of the source register
+ * @param[in]	- buffer and number of halfwords (one per update)
+ * @param[in]	- ENABLE to wrap around at the end of the buffer
+ *
+ * @return		- SET if started, RESET if the timer has no update DMA request
+ *
+ * @Note		- GPIO ports: TIM1 or TIM8 (DMA2) only, as for
+ * 				  TIM_UpdateStartDMA. TIM_EVENT_DMA_HALF_CMPLT and
+ * 				  TIM_EVENT_DMA_CMPLT as the buffer fills.
+ ****************************************************************************/
+uint8_t TIM_UpdateStartReadDMA(TIM_Handle_t *pTIMHandle, uint32_t SrcAddr, uint16_t *pBuffer, uint16_t Len, uint8_t Circular)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+
+	if(Len == 0)
+		return RESET;
+
+	if(TIM_SetupDMA(pTIMHandle, &pTIMHandle->UpDMA, TIM_DMA_REQ_UP, DMA_DIR_PERIPH_TO_MEM,
+			(Circular == ENABLE) ? DMA_MODE_CIRCULAR : DMA_MODE_NORMAL, DMA_SIZE_HALFWORD) == RESET)
+		return RESET;
+
+	DMA_Start(&pTIMHandle->UpDMA, SrcAddr, (uint32_t)pBuffer, Len);
+	pTIMx->DIER |= (1 << TIM_DIER_UDE);
+	pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+
+	return SET;
+}
+
+/**************************************************************************
+ * @fn			- TIM_UpdateStopDMA
+ *
+ * @brief		- Stops the update DMA requests. The counter keeps running.
+ *
+ * @param[in]	- pointer to the handle structure
+ ****************************************************************************/
+void TIM_UpdateStopDMA(TIM_Handle_t *pTIMHandle)
+{
+	// never started: no stream to stop
+	if(pTIMHandle->UpDMA.pDMAx == 0)
+		return;
+
+	pTIMHandle->pTIMx->DIER &= ~(1 << TIM_DIER_UDE);
+	DMA_Stop(&pTIMHandle->UpDMA);
+}
+
+/**************************************************************************
+ * Input capture channel
+ * ************************************************************************
+ * @fn			- TIM_ICConfigChannel
+ *
+ * @brief		- Configures a channel as input capture: input selection,
+ * 				  edge, prescaler and filter, and enables the capture.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- channel, possible values from @TIM_Channel
+ * @param[in]	- pointer to the channel configuration
+ *
+ * @return		- none
+ *
+ * @Note		- The counter must be started with TIM_PeripheralControl,
+ * 				  TIM_ICStartIT or TIM_ICStartDMA. Period measurement:
+ * 				  difference of two captures, modulo (ARR + 1).
+ ****************************************************************************/
+void TIM_ICConfigChannel(TIM_Handle_t *pTIMHandle, uint8_t Channel, TIM_IC_Config_t *pICConfig)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+	uint8_t ccmr = (Channel - 1) / 2;
+	uint8_t shift = ((Channel - 1) % 2) * 8;
+	uint8_t ccer_shift = 4 * (Channel - 1);
+	uint32_t tempreg;
+
+	pTIMx->CCER &= ~(1 << (TIM_CCER_CCE + ccer_shift));
+
+	// 1. CCMR: input selection, prescaler, filter
+	tempreg = pTIMx->CCMR[ccmr];
+	tempreg &= ~(0xFF << shift);
+	tempreg |= ((uint32_t)pICConfig->IC_Selection << (TIM_CCMR_CCS + shift));
+	tempreg |= ((uint32_t)pICConfig->IC_Prescaler << (TIM_CCMR_ICPSC + shift));
+	tempreg |= ((uint32_t)(pICConfig->IC_Filter & 0xF) << (TIM_CCMR_ICF + shift));
+	pTIMx->CCMR[ccmr] = tempreg;
+
+	// 2. CCER: edge (CCxNP:CCxP = 00 rising, 01 falling, 11 both) and enable
+	tempreg = pTIMx->CCER;
+	tempreg &= ~(0xF << ccer_shift);
+	if(pICConfig->IC_Polarity == TIM_ICPOLARITY_FALLING)
+	{
+		tempreg |= (1 << (TIM_CCER_CCP + ccer_shift));
+	} else if(pICConfig->IC_Polarity == TIM_ICPOLARITY_BOTH)
+	{
+		tempreg |= (1 << (TIM_CCER_CCP + ccer_shift));
+		tempreg |= (1 << (TIM_CCER_CCNP + ccer_shift));
+	}
+	tempreg |= (1 << (TIM_CCER_CCE + ccer_shift));
+	pTIMx->CCER = tempreg;
+}
+
+/**************************************************************************
+ * @fn			- TIM_GetCapture
+ *
+ * @brief		- Returns the last captured counter value of a channel.
+ * 				  Reading it clears CCxIF.
+ *
+ * @param[in]	- base address of the TIM peripheral
+ * @param[in]	- channel, possible values from @TIM_Channel
+ *
+ * @return		- captured counter value
+ ****************************************************************************/
+uint32_t TIM_GetCapture(TIM_RegDef_t *pTIMx, uint8_t Channel)
+{
+	return pTIMx->CCR[Channel - 1];
+}
+
+/**************************************************************************
+ * @fn			- TIM_ICStartIT
+ *
+ * @brief		- Enables the capture interrupt of a channel and starts the
+ * 				  counter. TIM_EVENT_CCx is reported for each capture.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- channel, possible values from @TIM_Channel
+ ****************************************************************************/
+void TIM_ICStartIT(TIM_Handle_t *pTIMHandle, uint8_t Channel)
+{
+	pTIMHandle->pTIMx->DIER |= (1 << (TIM_DIER_CC1IE + Channel - 1));
+	pTIMHandle->pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+}
+
+/**************************************************************************
+ * @fn			- TIM_ICStopIT
+ *
+ * @brief		- Disables the capture interrupt of a channel. The counter
+ * 				  keeps running, other channels may use it.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- channel, possible values from @TIM_Channel
+ ****************************************************************************/
+void TIM_ICStopIT(TIM_Handle_t *pTIMHandle, uint8_t Channel)
+{
+	pTIMHandle->pTIMx->DIER &= ~(1 << (TIM_DIER_CC1IE + Channel - 1));
+}
+
+/**************************************************************************
+ * Input capture with DMA
+ * ************************************************************************
+ * @fn			- TIM_ICStartDMA
+ *
+ * @brief		- Every capture of the channel is copied by the DMA from
+ * 				  CCRx into pBuffer (one word per capture). The CPU only
+ * 				  sees TIM_EVENT_DMA_HALF_CMPLT / TIM_EVENT_DMA_CMPLT.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- channel, possible values from @TIM_Channel
+ * @param[in]	- buffer and number of captures (words)
+ * @param[in]	- ENABLE to wrap around at the end of the buffer
+ *
+ * @return		- SET if started, RESET if the channel has no DMA request
+ *
+ * @Note		- Configure the channel with TIM_ICConfigChannel first.
+ * 				  Only one channel per timer can use CCDMA at a time.
+ ****************************************************************************/
+uint8_t TIM_ICStartDMA(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint32_t *pBuffer, uint16_t Len, uint8_t Circular)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+
+	if(Len == 0 || pTIMHandle->CCDMAChannel != 0)
+		return RESET;
+
+	if(TIM_SetupDMA(pTIMHandle, &pTIMHandle->CCDMA, Channel, DMA_DIR_PERIPH_TO_MEM,
+			(Circular == ENABLE) ? DMA_MODE_CIRCULAR : DMA_MODE_NORMAL, DMA_SIZE_WORD) == RESET)
+		return RESET;
+
+	pTIMHandle->CCDMAChannel = Channel;
+
+	DMA_Start(&pTIMHandle->CCDMA, (uint32_t)&pTIMx->CCR[Channel - 1], (uint32_t)pBuffer, Len);
+	pTIMx->DIER |= (1 << (TIM_DIER_CC1DE + Channel - 1));
+	pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+
+	return SET;
+}
+
+/**************************************************************************
+ * @fn			- TIM_ICStopDMA
+ *
+ * @brief		- Stops the capture DMA requests of the CCDMA channel.
+ *
+ * @param[in]	- pointer to the handle structure
+ ****************************************************************************/
+void TIM_ICStopDMA(TIM_Handle_t *pTIMHandle)
+{
+	uint8_t ch = pTIMHandle->CCDMAChannel;
+
+	if(ch == 0)
+		return;
+
+	pTIMHandle->pTIMx->DIER &= ~(1 << (TIM_DIER_CC1DE + ch - 1));
+	DMA_Stop(&pTIMHandle->CCDMA);
+	pTIMHandle->CCDMAChannel = 0;
+}
+
+/**************************************************************************
+ * One pulse mode
+ * ************************************************************************
+ * @fn			- TIM_OnePulseConfig
+ *
+ * @brief		- Configures the timer to output a single pulse after a
+ * 				  trigger: the counter runs from 0 to ARR once and stops
+ * 				  (OPM). The output channel runs in PWM2 mode, so it is
+ * 				  inactive up to CCR = OP_Delay and active up to
+ * 				  ARR = OP_Delay + OP_PulseWidth - 1.
+ *
+ * 				  With an input trigger the timer is in slave trigger mode:
+ * 				  an edge on TI1/TI2 starts the counter, no CPU involved.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the one pulse configuration
+ *
+ * @return		- none
+ *
+ * @Note		- Call after TIM_Init, which sets the prescaler (tick).
+ * 				  Not available on the basic timers TIM6/7.
+ ****************************************************************************/
+void TIM_OnePulseConfig(TIM_Handle_t *pTIMHandle, TIM_OP_Config_t *pOPConfig)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+	TIM_OC_Config_t oc;
+	TIM_IC_Config_t ic;
+	uint32_t tempreg;
+
+	// 1. Stop and select one pulse mode
+	pTIMx->CR1 &= ~(1 << TIM_CR1_CEN);
+	pTIMx->CR1 |= (1 << TIM_CR1_OPM);
+
+	// 2. Output channel: PWM2, delay in CCR, delay + width in ARR
+	oc.OC_Mode = TIM_OCMODE_PWM2;
+	oc.OC_Pulse = pOPConfig->OP_Delay;
+	oc.OC_Polarity = pOPConfig->OP_Polarity;
+	oc.OC_Preload = DISABLE;
+	TIM_OCConfigChannel(pTIMHandle, pOPConfig->OP_OutputChannel, &oc);
+	pTIMx->ARR = pOPConfig->OP_Delay + pOPConfig->OP_PulseWidth - 1;
+
+	// 3. Trigger input: channel 1 or 2 as direct input, slave mode trigger
+	tempreg = pTIMx->SMCR;
+	tempreg &= ~((0x7 << TIM_SMCR_SMS) | (0x7 << TIM_SMCR_TS));
+	if(pOPConfig->OP_Trigger != TIM_OP_TRIGGER_SOFTWARE)
+	{
+		ic.IC_Polarity = pOPConfig->OP_TriggerPolarity;
+		ic.IC_Selection = TIM_ICSELECTION_DIRECT;
+		ic.IC_Prescaler = TIM_ICPSC_DIV1;
+		ic.IC_Filter = 0;
+		TIM_ICConfigChannel(pTIMHandle, pOPConfig->OP_Trigger, &ic);
+
+		// TS = 101 TI1FP1, 110 TI2FP2; SMS = 110 trigger mode
+		tempreg |= ((uint32_t)(4 + pOPConfig->OP_Trigger) << TIM_SMCR_TS);
+		tempreg |= (0x6 << TIM_SMCR_SMS);
+	}
+	pTIMx->SMCR = tempreg;
+
+	// 4. Counter at 0, output enabled (idle level until the trigger)
+	pTIMx->CNT = 0;
+	TIM_OCChannelControl(pTIMx, pOPConfig->OP_OutputChannel, ENABLE);
+}
+
+/**************************************************************************
+ * @fn			- TIM_OnePulseTrigger
+ *
+ * @brief		- Starts one pulse by software (TIM_OP_TRIGGER_SOFTWARE).
+ *
+ * @param[in]	- base address of the TIM peripheral
+ *
+ * @Note		- CEN is cleared by hardware at the end of the pulse.
+ ****************************************************************************/
+void TIM_OnePulseTrigger(TIM_RegDef_t *pTIMx)
+{
+	pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+}
+
+/**************************************************************************
+ * IRQ Configuration
+ * ************************************************************************
+ * @fn			- TIM_IRQInterruptConfig
+ *
+ * @brief		- All of the configuration in this API is processor specific.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void TIM_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	NVIC_IRQInterruptConfig(IRQNumber, EnorDi);
+}
+
+/**************************************************************************
+ * Priority Configuration
+ * ************************************************************************
+ * @fn			- TIM_IRQPriorityConfig
+ *
+ * @brief		- Sets the priority field of the given IRQ number.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- priority (NVIC_IRQ_PRIx)
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void TIM_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority)
+{
+	NVIC_IRQPriorityConfig(IRQNumber, IRQPriority);
+}
+
+/**************************************************************************
+ * Interrupt Handling
+ * ************************************************************************
+ * @fn			- TIM_IRQHandling
+ *
+ * @brief		- Call this from the TIMx IRQ handler. Clears and reports
+ * 				  update, capture/compare and trigger events.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- TIM1/TIM8 events are split over several IRQ lines, all
+ * 				  of them may call this function.
+ ****************************************************************************/
+void TIM_IRQHandling(TIM_Handle_t *pTIMHandle)
+{
+	PROF_ISR_BEGIN();
+
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+	uint32_t sr = pTIMx->SR;
+	uint32_t dier = pTIMx->DIER;
+
+	/*************************Check for update event ********************************************/
+	if((sr & (1 << TIM_SR_UIF)) && (dier & (1 << TIM_DIER_UIE)))
+	{
+		// rc_w0: write 0 to the flag, 1 to the others (no read-modify-write race)
+		pTIMx->SR = ~(1 << TIM_SR_UIF);
+		TIM_ApplicationEventCallback(pTIMHandle, TIM_EVENT_UPDATE);
+	}
+
+	/*************************Check for capture/compare events ********************************************/
+	for(uint8_t ch = 1; ch <= 4; ch++)
+	{
+		if((sr & (1 << (TIM_SR_CC1IF + ch - 1))) && (dier & (1 << (TIM_DIER_CC1IE + ch - 1))))
+		{
+			if(sr & (1 << (TIM_SR_CC1OF + ch - 1)))
+			{
+				pTIMx->SR = ~(1 << (TIM_SR_CC1OF + ch - 1));
+				TIM_ApplicationEventCallback(pTIMHandle, TIM_EVENT_OVERCAPTURE);
+			}
+			pTIMx->SR = ~(1 << (TIM_SR_CC1IF + ch - 1));
+			TIM_ApplicationEventCallback(pTIMHandle, TIM_EVENT_CC1 + ch - 1);
+		}
+	}
+
+	/*************************Check for trigger event ********************************************/
+	if((sr & (1 << TIM_SR_TIF)) && (dier & (1 << TIM_DIER_TIE)))
+	{
+		pTIMx->SR = ~(1 << TIM_SR_TIF);
+		TIM_ApplicationEventCallback(pTIMHandle, TIM_EVENT_TRIGGER);
+	}
+
+	PROF_ISR_END();
+}
+
+/**************************************************************************
+ * Enable or disable the counter
+ * ************************************************************************
+ * @fn			- TIM_PeripheralControl
+ *
+ * @brief		- Sets or clears CEN.
+ *
+ * @param[in]	- base address of the TIM peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ ****************************************************************************/
+void TIM_PeripheralControl(TIM_RegDef_t *pTIMx, uint8_t EnOrDi)
+{
+	if(EnOrDi == ENABLE)
+	{
+		pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+	} else
+	{
+		pTIMx->CR1 &= ~(1 << TIM_CR1_CEN);
+	}
+}
+
+/**************************************************************************
+ * Trigger output
+ * ************************************************************************
+ * @fn			- TIM_SetTriggerOutput
+ *
+ * @brief		- Selects the event which the timer sends on TRGO (MMS).
+ *
+ * @param[in]	- base address of the TIM peripheral
+ * @param[in]	- possible values from @TIM_TRGO
+ *
+ * @Note		- TIM_TRGO_UPDATE paces ADC conversions at the timer
+ * 				  update rate (ADC_EXTSEL_TIMx_TRGO).
+ ****************************************************************************/
+void TIM_SetTriggerOutput(TIM_RegDef_t *pTIMx, uint8_t Trgo)
+{
+	uint32_t tempreg = pTIMx->CR2;
+
+	tempreg &= ~(0x7 << TIM_CR2_MMS);
+	tempreg |= ((uint32_t)(Trgo & 0x7) << TIM_CR2_MMS);
+	pTIMx->CR2 = tempreg;
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- TIM_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- TIM_EVENT_xxx
+ ****************************************************************************/
+__attribute__((weak)) void TIM_ApplicationEventCallback(TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	(void)pTIMHandle;
+	(void)AppEv;
+}
+
+static uint8_t TIM_IsAdvanced(TIM_RegDef_t *pTIMx)
+{
+	return (pTIMx == TIM1 || pTIMx == TIM8);
+}
+
+/*
+ * Looks up the stream of a timer DMA request and configures it for
+ * transfers between a register and memory: Direction from @DMA_DIRECTION,
+ * Mode from @DMA_MODE, Size (both sides) from @DMA_DATA_SIZE.
+ */
+static uint8_t TIM_SetupDMA(TIM_Handle_t *pTIMHandle, DMA_Handle_t *pDMAHandle, uint8_t Request, uint8_t Direction,
+		uint8_t Mode, uint8_t Size)
+{
+	uint8_t index = Periph_GetId(pTIMHandle->pTIMx) - PERIPH_ID_TIM1;
+	const TIM_DMAMap_t *pMap;
+
+	// TIM9..TIM14 have no DMA requests (unsigned: PERIPH_NO_ID is out of range too)
+	if(index >= sizeof(TIM_DMAMap) / sizeof(TIM_DMAMap[0]))
+		return RESET;
+
+	pMap = &TIM_DMAMap[index];
+	if(pMap->Stream[Request] == TIM_DMA_NONE)
+		return RESET;
+
+	pDMAHandle->pDMAx = pMap->pDMAx;
+	pDMAHandle->Stream = pMap->Stream[Request];
+	pDMAHandle->DMAConfig.DMA_Channel = pMap->Channel[Request];
+	pDMAHandle->DMAConfig.DMA_Direction = Direction;
+	pDMAHandle->DMAConfig.DMA_PeriphInc = DISABLE;
+	pDMAHandle->DMAConfig.DMA_MemInc = ENABLE;
+	pDMAHandle->DMAConfig.DMA_PeriphDataSize = Size;
+	pDMAHandle->DMAConfig.DMA_MemDataSize = Size;
+	pDMAHandle->DMAConfig.DMA_Mode = Mode;
+	pDMAHandle->DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH;
+	pDMAHandle->DMAConfig.DMA_FIFOMode = DMA_FIFO_DIRECT;
+	pDMAHandle->pEventCallback = TIM_DMAEventCallback;
+	pDMAHandle->pParent = pTIMHandle;
+
+	DMA_Init(pDMAHandle);
+
+	return SET;
+}
+
+static void TIM_DMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	TIM_Handle_t *pTIMHandle = (TIM_Handle_t*)pDMAHandle->pParent;
+
+	if(AppEv == DMA_EVENT_HALF_CMPLT)
+	{
+		TIM_ApplicationEventCallback(pTIMHandle, TIM_EVENT_DMA_HALF_CMPLT);
+	} else if(AppEv == DMA_EVENT_CMPLT)
+	{
+		// normal mode: the stream is done, stop the requests
+		if(pDMAHandle->DMAConfig.DMA_Mode == DMA_MODE_NORMAL)
+		{
+			if(pDMAHandle == &pTIMHandle->UpDMA)
+				pTIMHandle->pTIMx->DIER &= ~(1 << TIM_DIER_UDE);
+			else
+				TIM_ICStopDMA(pTIMHandle);
+		}
+		TIM_ApplicationEventCallback(pTIMHandle, TIM_EVENT_DMA_CMPLT);
+	} else if(AppEv == DMA_EVENT_ERROR)
+	{
+		TIM_ApplicationEventCallback(pTIMHandle, TIM_EVENT_DMA_ERROR);
+	}
+}
@@ -0,0 +1,984 @@
+// In driver.c, you have to include respective peripheral's driver file.
+#include <string.h>
+#include "stm32f407xx_usart_driver.h"
+
+/*
+ * Helper functions (private to this driver)
+ */
+static void USART_DMAConfig(USART_Handle_t *pUSARTHandle);
+static void USART_StartTxRing(USART_Handle_t *pUSARTHandle);
+static void USART_RxUpdateHead(USART_Handle_t *pUSARTHandle);
+static void USART_TxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+static void USART_RxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv);
+
+/**********************************************************************
+ * Peripheral Clock setup
+ * (Peripheral Control API)
+ * ********************************************************************
+ * @fn			- USART_PeriClockControl
+ *
+ * @brief		- This function enables or disables peripheral clock
+ * 				  for the given USART
+ *
+ * @param[in]	- base address of the USART peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Reference counted by the clock manager: the clock goes
+ * 				  off with the last DISABLE, see stm32f407xx_clk.h
+ ***********************************************************************/
+void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi)
+{
+	Clk_Control(pUSARTx, EnorDi);
+}
+
+/**************************************************************************
+ * Initialize USART
+ * ************************************************************************
+ * @fn			- USART_Init
+ *
+ * @brief		- To configure mode, frame format, flow control and baud
+ * 				  rate of the USART, and to prepare its TX/RX DMA streams.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- The USART is left disabled, call USART_PeripheralControl.
+ ****************************************************************************/
+void USART_Init(USART_Handle_t *pUSARTHandle)
+{
+	uint32_t tempreg = 0;
+
+	Clk_Ensure(pUSARTHandle->pUSARTx);
+
+	/************************************************************************
+	 * 1. Configure CR1
+	 ************************************************************************/
+	// Enable USART TX and RX engines according to the USART_Mode configuration item
+	if(pUSARTHandle->USART_Config.USART_Mode == USART_MODE_ONLY_RX)
+	{
+		tempreg |= (1 << USART_CR1_RE);
+	} else if(pUSARTHandle->USART_Config.USART_Mode == USART_MODE_ONLY_TX)
+	{
+		tempreg |= (1 << USART_CR1_TE);
+	} else if(pUSARTHandle->USART_Config.USART_Mode == USART_MODE_TXRX)
+	{
+		tempreg |= ((1 << USART_CR1_RE) | (1 << USART_CR1_TE));
+	}
+
+	// Word length
+	tempreg |= pUSARTHandle->USART_Config.USART_WordLength << USART_CR1_M;
+
+	// Parity control bit fields
+	if(pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_EN_EVEN)
+	{
+		// Even parity is selected by default (PS = 0)
+		tempreg |= (1 << USART_CR1_PCE);
+	} else if(pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_EN_ODD)
+	{
+		tempreg |= (1 << USART_CR1_PCE);
+		tempreg |= (1 << USART_CR1_PS);
+	}
+
+	pUSARTHandle->pUSARTx->CR1 = tempreg;
+
+	/************************************************************************
+	 * 2. Configure CR2 (number of stop bits)
+	 ************************************************************************/
+	tempreg = 0;
+	tempreg |= pUSARTHandle->USART_Config.USART_NoOfStopBits << USART_CR2_STOP;
+	pUSARTHandle->pUSARTx->CR2 = tempreg;
+
+	/************************************************************************
+	 * 3. Configure CR3 (hardware flow control)
+	 ************************************************************************/
+	tempreg = 0;
+	if(pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_CTS)
+	{
+		tempreg |= (1 << USART_CR3_CTSE);
+	} else if(pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_RTS)
+	{
+		tempreg |= (1 << USART_CR3_RTSE);
+	} else if(pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_CTS_RTS)
+	{
+		tempreg |= (1 << USART_CR3_CTSE);
+		tempreg |= (1 << USART_CR3_RTSE);
+	}
+	pUSARTHandle->pUSARTx->CR3 = tempreg;
+
+	/************************************************************************
+	 * 4. Configure BRR (baud rate register)
+	 ************************************************************************/
+	USART_SetBaudRate(pUSARTHandle->pUSARTx, pUSARTHandle->USART_Config.USART_Baud);
+
+	/************************************************************************
+	 * 5. DMA streams of this USART
+	 ************************************************************************/
+	pUSARTHandle->TxBusyState = USART_READY;
+	pUSARTHandle->RxBusyState = USART_READY;
+	pUSARTHandle->TxDMALen = 0;
+	USART_DMAConfig(pUSARTHandle);
+}
+
+/**************************************************************************
+ * Deinitialize USART
+ * ************************************************************************
+ * @fn			- USART_DeInit
+ *
+ * @brief		- Resets all registers of the USART with the RCC reset register.
+ *
+ * @param[in]	- base address of the USART peripheral
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void USART_DeInit(USART_RegDef_t *pUSARTx)
+{
+	Periph_Reset(pUSARTx);
+}
+
+/**************************************************************************
+ * Baud rate
+ * ************************************************************************
+ * @fn			- USART_SetBaudRate
+ *
+ * @brief		- Computes USARTDIV from the APB clock of the USART and
+ * 				  programs mantissa and fraction into BRR.
+ *
+ * 				  USARTDIV = PCLK / (8 * (2 - OVER8) * baud)
+ * 				  It is calculated in 1/16 (1/8 for OVER8) and rounded to
+ * 				  the nearest step, so BRR is the closest possible divider.
+ *
+ * @param[in]	- base address of the USART peripheral
+ * @param[in]	- baud rate in bit/s
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- USART1/6 are on APB2, the others on APB1.
+ ****************************************************************************/
+void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate)
+{
+	uint32_t PCLKx;
+	uint32_t usartdiv;
+	uint32_t tempreg = 0;
+
+	if(pUSARTx == USART1 || pUSARTx == USART6)
+	{
+		PCLKx = RCC_GetPCLK2Value();
+	} else
+	{
+		PCLKx = RCC_GetPCLK1Value();
+	}
+
+	// USARTDIV * 16 (* 8 for OVER8) is PCLK / baud, rounded
+	usartdiv = (PCLKx + (BaudRate / 2)) / BaudRate;
+
+	if(pUSARTx->CR1 & (1 << USART_CR1_OVER8))
+	{
+		// over sampling by 8: 3 fraction bits, BRR[3] stays 0
+		tempreg |= (usartdiv >> 3) << 4;
+		tempreg |= usartdiv & 0x7;
+	} else
+	{
+		// over sampling by 16: mantissa and fraction are USARTDIV * 16
+		tempreg = usartdiv & 0xFFFF;
+	}
+
+	pUSARTx->BRR = tempreg;
+}
+
+/**************************************************************************
+ * Send data (blocking)
+ * ************************************************************************
+ * @fn			- USART_SendData
+ *
+ * @brief		- Writes Len bytes into DR, waiting for TXE before each one
+ * 				  and for TC at the end.
+ *
+ * @param[in]	- base address of the USART peripheral
+ * @param[in]	- pointer to the TX buffer
+ * @param[in]	- number of bytes (9 bit frames without parity take 2 bytes)
+ *
+ * @return		- none
+ *
+ * @Note		- This is a blocking call.
+ ****************************************************************************/
+void USART_SendData(USART_RegDef_t *pUSARTx, uint8_t *pTxBuffer, uint32_t Len)
+{
+	// 9 bit data without parity: the frame is taken from 2 buffer bytes
+	uint8_t ninebits = ((pUSARTx->CR1 & (1 << USART_CR1_M)) && !(pUSARTx->CR1 & (1 << USART_CR1_PCE)));
+
+	while(Len > 0)
+	{
+		while(USART_GetFlagStatus(pUSARTx, USART_FLAG_TXE) == FLAG_RESET);
+
+		if(ninebits && Len > 1)
+		{
+			pUSARTx->DR = (*((uint16_t*)pTxBuffer) & (uint16_t)0x01FF);
+			pTxBuffer += 2;
+			Len -= 2;
+		} else
+		{
+			pUSARTx->DR = *pTxBuffer;
+			pTxBuffer++;
+			Len--;
+		}
+	}
+
+	// wait until the last frame has left the shift register
+	while(USART_GetFlagStatus(pUSARTx, USART_FLAG_TC) == FLAG_RESET);
+}
+
+/**************************************************************************
+ * Receive data (blocking)
+ * ************************************************************************
+ * @fn			- USART_ReceiveData
+ *
+ * @brief		- Reads Len bytes from DR, waiting for RXNE before each one.
+ *
+ * @param[in]	- base address of the USART peripheral
+ * @param[in]	- pointer to the RX buffer
+ * @param[in]	- number of bytes
+ *
+ * @return		- none
+ *
+ * @Note		- This is a blocking call. With parity enabled the parity
+ * 				  bit is masked off.
+ ****************************************************************************/
+void USART_ReceiveData(USART_RegDef_t *pUSARTx, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t ninebits = ((pUSARTx->CR1 & (1 << USART_CR1_M)) && !(pUSARTx->CR1 & (1 << USART_CR1_PCE)));
+	uint8_t mask = (pUSARTx->CR1 & (1 << USART_CR1_M)) ? 0xFF : 0x7F;
+
+	if(!(pUSARTx->CR1 & (1 << USART_CR1_PCE)))
+		mask = 0xFF;
+
+	while(Len > 0)
+	{
+		while(USART_GetFlagStatus(pUSARTx, USART_FLAG_RXNE) == FLAG_RESET);
+
+		if(ninebits && Len > 1)
+		{
+			*((uint16_t*)pRxBuffer) = (uint16_t)(pUSARTx->DR & 0x01FF);
+			pRxBuffer += 2;
+			Len -= 2;
+		} else
+		{
+			*pRxBuffer = (uint8_t)(pUSARTx->DR & mask);
+			pRxBuffer++;
+			Len--;
+		}
+	}
+}
+
+/**************************************************************************
+ * Send data (interrupt)
+ * ************************************************************************
+ * @fn			- USART_SendDataIT
+ *
+ * @brief		- Saves the buffer in the handle and enables the TXE and TC
+ * 				  interrupts. USART_IRQHandling sends the bytes.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the TX buffer
+ * @param[in]	- number of bytes
+ *
+ * @return		- state before the call, USART_READY means it was accepted
+ *
+ * @Note		- USART_EVENT_TX_CMPLT is reported when TC is set.
+ ****************************************************************************/
+uint8_t USART_SendDataIT(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t Len)
+{
+	uint8_t txstate = pUSARTHandle->TxBusyState;
+
+	if(txstate != USART_BUSY_IN_TX)
+	{
+		pUSARTHandle->TxLen = Len;
+		pUSARTHandle->pTxBuffer = pTxBuffer;
+		pUSARTHandle->TxBusyState = USART_BUSY_IN_TX;
+
+		pUSARTHandle->pUSARTx->CR1 |= (1 << USART_CR1_TXEIE);
+		pUSARTHandle->pUSARTx->CR1 |= (1 << USART_CR1_TCIE);
+	}
+
+	return txstate;
+}
+
+/**************************************************************************
+ * Receive data (interrupt)
+ * ************************************************************************
+ * @fn			- USART_ReceiveDataIT
+ *
+ * @brief		- Saves the buffer in the handle and enables the RXNE
+ * 				  interrupt. USART_IRQHandling stores the bytes.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the RX buffer
+ * @param[in]	- number of bytes
+ *
+ * @return		- state before the call, USART_READY means it was accepted
+ *
+ * @Note		- USART_EVENT_RX_CMPLT is reported after Len bytes.
+ ****************************************************************************/
+uint8_t USART_ReceiveDataIT(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t rxstate = pUSARTHandle->RxBusyState;
+
+	if(rxstate != USART_BUSY_IN_RX)
+	{
+		pUSARTHandle->RxLen = Len;
+		pUSARTHandle->pRxBuffer = pRxBuffer;
+		pUSARTHandle->RxBusyState = USART_BUSY_IN_RX;
+
+		// a stale byte in DR would be taken as the first byte
+		(void)pUSARTHandle->pUSARTx->DR;
+
+		pUSARTHandle->pUSARTx->CR1 |= (1 << USART_CR1_RXNEIE);
+	}
+
+	return rxstate;
+}
+
+/**************************************************************************
+ * Send data (DMA)
+ * ************************************************************************
+ * @fn			- USART_SendDataDMA
+ *
+ * @brief		- Starts the TX DMA stream on the given buffer.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the TX buffer (must stay valid until complete)
+ * @param[in]	- number of bytes
+ *
+ * @return		- state before the call, USART_READY means it was accepted
+ *
+ * @Note		- Not available while the TX ring is in use (USART_Write).
+ ****************************************************************************/
+uint8_t USART_SendDataDMA(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint16_t Len)
+{
+	uint8_t txstate = pUSARTHandle->TxBusyState;
+
+	if(txstate != USART_BUSY_IN_TX && pUSARTHandle->TxDMALen == 0)
+	{
+		pUSARTHandle->TxBusyState = USART_BUSY_IN_TX;
+
+		// TC is rc_w0: writing 0 clears it, writing 1 has no effect
+		pUSARTHandle->pUSARTx->SR &= ~(1 << USART_SR_TC);
+		pUSARTHandle->pUSARTx->CR3 |= (1 << USART_CR3_DMAT);
+
+		DMA_Start(&pUSARTHandle->TxDMA, (uint32_t)&pUSARTHandle->pUSARTx->DR, (uint32_t)pTxBuffer, Len);
+	}
+
+	return txstate;
+}
+
+/**************************************************************************
+ * Ring buffers
+ * ************************************************************************
+ * @fn			- USART_SetRingBuffers
+ *
+ * @brief		- Hands the TX and RX ring buffers to the driver.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- TX ring and its size (power of 2, or 0 for no TX ring)
+ * @param[in]	- RX ring and its size (power of 2, or 0 for no RX ring)
+ *
+ * @return		- none
+ *
+ * @Note		- Sizes are limited to 32 KB (DMA NDTR is 16 bit and the
+ * 				  RX ring is mapped 1:1 on one circular transfer).
+ ****************************************************************************/
+void USART_SetRingBuffers(USART_Handle_t *pUSARTHandle, uint8_t *pTxRing, uint16_t TxSize, uint8_t *pRxRing, uint16_t RxSize)
+{
+	pUSARTHandle->pTxRing = pTxRing;
+	pUSARTHandle->TxRingSize = TxSize;
+	pUSARTHandle->TxHead = 0;
+	pUSARTHandle->TxTail = 0;
+	pUSARTHandle->TxDMALen = 0;
+
+	pUSARTHandle->pRxRing = pRxRing;
+	pUSARTHandle->RxRingSize = RxSize;
+	pUSARTHandle->RxHead = 0;
+	pUSARTHandle->RxTail = 0;
+	pUSARTHandle->RxLastPos = 0;
+	pUSARTHandle->RxOverruns = 0;
+}
+
+/**************************************************************************
+ * Write into the TX ring
+ * ************************************************************************
+ * @fn			- USART_Write
+ *
+ * @brief		- Copies as much of the data as fits into the TX ring and
+ * 				  starts the TX DMA if it is idle.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- pointer to the data
+ * @param[in]	- number of bytes
+ *
+ * @return		- number of bytes accepted
+ *
+ * @Note		- Single writer: call from one context only.
+ ****************************************************************************/
+uint32_t USART_Write(USART_Handle_t *pUSARTHandle, const uint8_t *pData, uint32_t Len)
+{
+	uint32_t size = pUSARTHandle->TxRingSize;
+	uint32_t head = pUSARTHandle->TxHead;
+	uint32_t free = size - (head - pUSARTHandle->TxTail);
+	uint32_t offset, first;
+	uint32_t primask;
+
+	if(Len > free)
+		Len = free;
+	if(Len == 0)
+		return 0;
+
+	offset = head & (size - 1);
+	first = size - offset;
+	if(first > Len)
+		first = Len;
+	memcpy(&pUSARTHandle->pTxRing[offset], pData, first);
+	memcpy(&pUSARTHandle->pTxRing[0], pData + first, Len - first);
+
+	__DMB();
+	pUSARTHandle->TxHead = head + Len;
+
+	// The DMA complete interrupt chains the chunks, only kick it when idle.
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if(pUSARTHandle->TxDMALen == 0 && pUSARTHandle->TxBusyState != USART_BUSY_IN_TX)
+		USART_StartTxRing(pUSARTHandle);
+	__set_PRIMASK(primask);
+
+	return Len;
+}
+
+/**************************************************************************
+ * Free space in the TX ring
+ * ************************************************************************
+ * @fn			- USART_TxFree
+ *
+ * @return		- number of bytes USART_Write can take right now
+ ****************************************************************************/
+uint32_t USART_TxFree(USART_Handle_t *pUSARTHandle)
+{
+	return pUSARTHandle->TxRingSize - (pUSARTHandle->TxHead - pUSARTHandle->TxTail);
+}
+
+/**************************************************************************
+ * Start circular RX DMA
+ * ************************************************************************
+ * @fn			- USART_StartRxDMA
+ *
+ * @brief		- Starts the RX DMA in circular mode over the RX ring and
+ * 				  enables the IDLE line interrupt.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- Enable the USART IRQ and the RX stream IRQ in the NVIC.
+ ****************************************************************************/
+void USART_StartRxDMA(USART_Handle_t *pUSARTHandle)
+{
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+
+	pUSARTHandle->RxHead = 0;
+	pUSARTHandle->RxTail = 0;
+	pUSARTHandle->RxLastPos = 0;
+
+	// IDLE is cleared by reading SR followed by DR
+	(void)pUSARTx->SR;
+	(void)pUSARTx->DR;
+
+	pUSARTx->CR3 |= (1 << USART_CR3_DMAR) | (1 << USART_CR3_EIE);
+	pUSARTx->CR1 |= (1 << USART_CR1_IDLEIE);
+
+	DMA_Start(&pUSARTHandle->RxDMA, (uint32_t)&pUSARTx->DR, (uint32_t)pUSARTHandle->pRxRing, pUSARTHandle->RxRingSize);
+}
+
+/**************************************************************************
+ * Stop circular RX DMA
+ * ************************************************************************
+ * @fn			- USART_StopRxDMA
+ *
+ * @brief		- Stops the RX stream and the IDLE interrupt. Data already
+ * 				  in the ring can still be read.
+ ****************************************************************************/
+void USART_StopRxDMA(USART_Handle_t *pUSARTHandle)
+{
+	pUSARTHandle->pUSARTx->CR1 &= ~(1 << USART_CR1_IDLEIE);
+	DMA_Stop(&pUSARTHandle->RxDMA);
+	pUSARTHandle->pUSARTx->CR3 &= ~(1 << USART_CR3_DMAR);
+	USART_RxUpdateHead(pUSARTHandle);
+}
+
+/**************************************************************************
+ * Read from the RX ring
+ * ************************************************************************
+ * @fn			- USART_Read
+ *
+ * @brief		- Copies up to MaxLen received bytes out of the RX ring.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- destination buffer
+ * @param[in]	- size of the destination buffer
+ *
+ * @return		- number of bytes copied
+ *
+ * @Note		- If the DMA has lapped the reader, the oldest data is lost,
+ * 				  it is counted in RxOverruns and skipped.
+ ****************************************************************************/
+uint32_t USART_Read(USART_Handle_t *pUSARTHandle, uint8_t *pData, uint32_t MaxLen)
+{
+	uint32_t size = pUSARTHandle->RxRingSize;
+	uint32_t head = pUSARTHandle->RxHead;
+	uint32_t tail = pUSARTHandle->RxTail;
+	uint32_t avail = head - tail;
+	uint32_t offset, first;
+
+	if(avail > size)
+	{
+		pUSARTHandle->RxOverruns += avail - size;
+		tail = head - size;
+		avail = size;
+	}
+
+	if(MaxLen > avail)
+		MaxLen = avail;
+
+	offset = tail & (size - 1);
+	first = size - offset;
+	if(first > MaxLen)
+		first = MaxLen;
+	memcpy(pData, &pUSARTHandle->pRxRing[offset], first);
+	memcpy(pData + first, &pUSARTHandle->pRxRing[0], MaxLen - first);
+
+	pUSARTHandle->RxTail = tail + MaxLen;
+
+	return MaxLen;
+}
+
+/**************************************************************************
+ * Bytes waiting in the RX ring
+ * ************************************************************************
+ * @fn			- USART_RxAvailable
+ *
+ * @return		- number of bytes USART_Read would return
+ ****************************************************************************/
+uint32_t USART_RxAvailable(USART_Handle_t *pUSARTHandle)
+{
+	uint32_t avail = pUSARTHandle->RxHead - pUSARTHandle->RxTail;
+
+	if(avail > pUSARTHandle->RxRingSize)
+		avail = pUSARTHandle->RxRingSize;
+	return avail;
+}
+
+/**************************************************************************
+ * Interrupt Configuration
+ * ************************************************************************
+ * @fn			- USART_IRQInterruptConfig
+ *
+ * @brief		- All of the configuration in this API is processor specific.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- ENABLE or DISABLE macros
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	NVIC_IRQInterruptConfig(IRQNumber, EnorDi);
+}
+
+/**************************************************************************
+ * Priority Configuration
+ * ************************************************************************
+ * @fn			- USART_IRQPriorityConfig
+ *
+ * @brief		- Sets the priority field of the given IRQ number.
+ *
+ * @param[in]	- IRQ number
+ * @param[in]	- priority (NVIC_IRQ_PRIx)
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void USART_IRQPriorityConfig(uint8_t IRQNumber, uint8_t IRQPriority)
+{
+	NVIC_IRQPriorityConfig(IRQNumber, IRQPriority);
+}
+
+/**************************************************************************
+ * Interrupt Handling
+ * ************************************************************************
+ * @fn			- USART_IRQHandling
+ *
+ * @brief		- Call this from the USARTx_IRQHandler.
+ * 				  Handles TC, TXE and RXNE of the interrupt mode APIs, the
+ * 				  IDLE line of the circular RX DMA and the error flags.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	-
+ * @param[in]	-
+ *
+ * @return		- none
+ *
+ * @Note		- none
+ ****************************************************************************/
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
+{
+	PROF_ISR_BEGIN();
+
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+	uint32_t sr = pUSARTx->SR;
+	uint32_t cr1 = pUSARTx->CR1;
+	uint32_t cr3 = pUSARTx->CR3;
+	uint8_t dr_read = 0;
+
+	/*************************Check for TC flag ********************************************/
+	if((sr & (1 << USART_SR_TC)) && (cr1 & (1 << USART_CR1_TCIE)))
+	{
+		// close transmission only when all bytes are out
+		if(pUSARTHandle->TxBusyState == USART_BUSY_IN_TX && pUSARTHandle->TxLen == 0)
+		{
+			pUSARTx->SR &= ~(1 << USART_SR_TC);
+			pUSARTx->CR1 &= ~(1 << USART_CR1_TCIE);
+
+			pUSARTHandle->TxBusyState = USART_READY;
+			pUSARTHandle->pTxBuffer = 0;
+			USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_TX_CMPLT);
+		}
+	}
+
+	/*************************Check for TXE flag ********************************************/
+	if((sr & (1 << USART_SR_TXE)) && (cr1 & (1 << USART_CR1_TXEIE)))
+	{
+		if(pUSARTHandle->TxBusyState == USART_BUSY_IN_TX && pUSARTHandle->TxLen > 0)
+		{
+			if((cr1 & (1 << USART_CR1_M)) && !(cr1 & (1 << USART_CR1_PCE)) && pUSARTHandle->TxLen > 1)
+			{
+				pUSARTx->DR = (*((uint16_t*)pUSARTHandle->pTxBuffer) & (uint16_t)0x01FF);
+				pUSARTHandle->pTxBuffer += 2;
+				pUSARTHandle->TxLen -= 2;
+			} else
+			{
+				pUSARTx->DR = *pUSARTHandle->pTxBuffer;
+				pUSARTHandle->pTxBuffer++;
+				pUSARTHandle->TxLen--;
+			}
+		}
+		if(pUSARTHandle->TxLen == 0)
+		{
+			// nothing left for DR, TC will end the transmission
+			pUSARTx->CR1 &= ~(1 << USART_CR1_TXEIE);
+		}
+	}
+
+	/*************************Check for RXNE flag ********************************************/
+	if((sr & (1 << USART_SR_RXNE)) && (cr1 & (1 << USART_CR1_RXNEIE)))
+	{
+		if(pUSARTHandle->RxBusyState == USART_BUSY_IN_RX && pUSARTHandle->RxLen > 0)
+		{
+			if((cr1 & (1 << USART_CR1_M)) && !(cr1 & (1 << USART_CR1_PCE)) && pUSARTHandle->RxLen > 1)
+			{
+				*((uint16_t*)pUSARTHandle->pRxBuffer) = (uint16_t)(pUSARTx->DR & 0x01FF);
+				pUSARTHandle->pRxBuffer += 2;
+				pUSARTHandle->RxLen -= 2;
+			} else if(cr1 & (1 << USART_CR1_PCE))
+			{
+				// strip the parity bit
+				*pUSARTHandle->pRxBuffer = (uint8_t)(pUSARTx->DR & ((cr1 & (1 << USART_CR1_M)) ? 0xFF : 0x7F));
+				pUSARTHandle->pRxBuffer++;
+				pUSARTHandle->RxLen--;
+			} else
+			{
+				*pUSARTHandle->pRxBuffer = (uint8_t)pUSARTx->DR;
+				pUSARTHandle->pRxBuffer++;
+				pUSARTHandle->RxLen--;
+			}
+			dr_read = 1;
+		}
+		if(pUSARTHandle->RxLen == 0)
+		{
+			pUSARTx->CR1 &= ~(1 << USART_CR1_RXNEIE);
+			pUSARTHandle->RxBusyState = USART_READY;
+			USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_CMPLT);
+		}
+	}
+
+	/*************************Check for IDLE flag ********************************************/
+	if((sr & (1 << USART_SR_IDLE)) && (cr1 & (1 << USART_CR1_IDLEIE)))
+	{
+		// SR was read above, reading DR completes the clear sequence.
+		// In DMA mode DR is already empty, so no data is lost.
+		(void)pUSARTx->DR;
+		dr_read = 1;
+
+		USART_RxUpdateHead(pUSARTHandle);
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_IDLE);
+	}
+
+	/*************************Check for CTS flag ********************************************/
+	if((sr & (1 << USART_SR_CTS)) && (cr3 & (1 << USART_CR3_CTSIE)))
+	{
+		pUSARTx->SR &= ~(1 << USART_SR_CTS);
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_CTS);
+	}
+
+	/*************************Check for error flags ********************************************/
+	// Noise, overrun and framing errors need EIE (multi-buffer / DMA reception)
+	// or RXNEIE, and are cleared by the SR then DR read sequence.
+	if((cr3 & (1 << USART_CR3_EIE)) || (cr1 & (1 << USART_CR1_RXNEIE)))
+	{
+		if(sr & ((1 << USART_SR_ORE) | (1 << USART_SR_FE) | (1 << USART_SR_NF)))
+		{
+			// All three stay set (and keep EIE firing) until DR is read after
+			// SR. In DMA mode the DMA has already taken the frame.
+			if(!dr_read)
+				(void)pUSARTx->DR;
+		}
+		if(sr & (1 << USART_SR_ORE))
+		{
+			USART_ApplicationEventCallback(pUSARTHandle, USART_ERR_ORE);
+		}
+		if(sr & (1 << USART_SR_FE))
+		{
+			USART_ApplicationEventCallback(pUSARTHandle, USART_ERR_FE);
+		}
+		if(sr & (1 << USART_SR_NF))
+		{
+			USART_ApplicationEventCallback(pUSARTHandle, USART_ERR_NE);
+		}
+	}
+
+	if((sr & (1 << USART_SR_PE)) && (cr1 & (1 << USART_CR1_PEIE)))
+	{
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_PE);
+	}
+
+	PROF_ISR_END();
+}
+
+/**************************************************************************
+ * Enable or disable the USART
+ * ************************************************************************
+ * @fn			- USART_PeripheralControl
+ *
+ * @brief		- Sets or clears UE.
+ *
+ * @param[in]	- base address of the USART peripheral
+ * @param[in]	- ENABLE or DISABLE macros
+ ****************************************************************************/
+void USART_PeripheralControl(USART_RegDef_t *pUSARTx, uint8_t EnOrDi)
+{
+	if(EnOrDi == ENABLE)
+	{
+		pUSARTx->CR1 |= (1 << USART_CR1_UE);
+	} else
+	{
+		pUSARTx->CR1 &= ~(1 << USART_CR1_UE);
+	}
+}
+
+/**************************************************************************
+ * Flag status
+ * ************************************************************************
+ * @fn			- USART_GetFlagStatus
+ *
+ * @param[in]	- base address of the USART peripheral
+ * @param[in]	- USART_FLAG_xxx
+ *
+ * @return		- FLAG_SET or FLAG_RESET
+ ****************************************************************************/
+uint8_t USART_GetFlagStatus(USART_RegDef_t *pUSARTx, uint32_t FlagName)
+{
+	if(pUSARTx->SR & FlagName)
+	{
+		return FLAG_SET;
+	}
+	return FLAG_RESET;
+}
+
+/**************************************************************************
+ * Clear flag
+ * ************************************************************************
+ * @fn			- USART_ClearFlag
+ *
+ * @brief		- Clears rc_w0 flags (CTS, LBD, TC, RXNE) by writing 0.
+ *
+ * @param[in]	- base address of the USART peripheral
+ * @param[in]	- USART_FLAG_xxx
+ ****************************************************************************/
+void USART_ClearFlag(USART_RegDef_t *pUSARTx, uint16_t StatusFlagName)
+{
+	pUSARTx->SR &= ~(StatusFlagName);
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- USART_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle structure
+ * @param[in]	- USART_EVENT_xxx or USART_ERR_xxx
+ ****************************************************************************/
+__attribute__((weak)) void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle, uint8_t AppEv)
+{
+	(void)pUSARTHandle;
+	(void)AppEv;
+}
+
+/*
+ * Selects the DMA streams of the USART (RM0090 DMA request mapping) and
+ * configures them: TX normal mode, RX circular mode.
+ */
+static void USART_DMAConfig(USART_Handle_t *pUSARTHandle)
+{
+	const Periph_Instance_t *pInst = Periph_Get(pUSARTHandle->pUSARTx);
+	DMA_Handle_t *pTx = &pUSARTHandle->TxDMA;
+	DMA_Handle_t *pRx = &pUSARTHandle->RxDMA;
+
+	if(pInst == 0)
+		return;
+
+	pTx->pDMAx = pInst->DMATx.pDMAx;
+	pTx->Stream = pInst->DMATx.Stream;
+	pTx->DMAConfig.DMA_Channel = pInst->DMATx.Channel;
+
+	pTx->DMAConfig.DMA_Direction = DMA_DIR_MEM_TO_PERIPH;
+	pTx->DMAConfig.DMA_PeriphInc = DISABLE;
+	pTx->DMAConfig.DMA_MemInc = ENABLE;
+	pTx->DMAConfig.DMA_PeriphDataSize = DMA_SIZE_BYTE;
+	pTx->DMAConfig.DMA_MemDataSize = DMA_SIZE_BYTE;
+	pTx->DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+	pTx->DMAConfig.DMA_Priority = DMA_PRIORITY_MEDIUM;
+	pTx->DMAConfig.DMA_FIFOMode = DMA_FIFO_DIRECT;
+	pTx->pEventCallback = USART_TxDMAEventCallback;
+	pTx->pParent = pUSARTHandle;
+
+	pRx->DMAConfig = pTx->DMAConfig;
+	pRx->pDMAx = pInst->DMARx.pDMAx;
+	pRx->Stream = pInst->DMARx.Stream;
+	pRx->DMAConfig.DMA_Channel = pInst->DMARx.Channel;
+	pRx->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+	pRx->DMAConfig.DMA_Mode = DMA_MODE_CIRCULAR;
+	pRx->DMAConfig.DMA_Priority = DMA_PRIORITY_HIGH; // RX must never overrun DR
+	pRx->pEventCallback = USART_RxDMAEventCallback;
+	pRx->pParent = pUSARTHandle;
+
+	if(pUSARTHandle->USART_Config.USART_Mode != USART_MODE_ONLY_RX)
+		DMA_Init(pTx);
+	if(pUSARTHandle->USART_Config.USART_Mode != USART_MODE_ONLY_TX)
+		DMA_Init(pRx);
+}
+
+/*
+ * Hands the largest contiguous part of the TX ring to the TX DMA.
+ * Called with the TX stream idle (DMA ISR or interrupts masked).
+ */
+static void USART_StartTxRing(USART_Handle_t *pUSARTHandle)
+{
+	uint32_t size = pUSARTHandle->TxRingSize;
+	uint32_t tail = pUSARTHandle->TxTail;
+	uint32_t used = pUSARTHandle->TxHead - tail;
+	uint32_t offset = tail & (size - 1);
+	uint32_t chunk = size - offset;
+
+	if(used == 0)
+	{
+		pUSARTHandle->TxDMALen = 0;
+		return;
+	}
+	if(chunk > used)
+		chunk = used;
+
+	pUSARTHandle->TxDMALen = (uint16_t)chunk;
+	pUSARTHandle->pUSARTx->CR3 |= (1 << USART_CR3_DMAT);
+	DMA_Start(&pUSARTHandle->TxDMA, (uint32_t)&pUSARTHandle->pUSARTx->DR, (uint32_t)&pUSARTHandle->pTxRing[offset], (uint16_t)chunk);
+}
+
+/*
+ * Publishes the RX DMA write position as RxHead.
+ * NDTR counts down from the ring size and reloads at the end.
+ */
+static void USART_RxUpdateHead(USART_Handle_t *pUSARTHandle)
+{
+	uint16_t size = pUSARTHandle->RxRingSize;
+	uint16_t pos = size - DMA_GetRemaining(&pUSARTHandle->RxDMA);
+	uint16_t delta;
+
+	if(pos == size)
+		pos = 0;
+
+	delta = (uint16_t)(pos - pUSARTHandle->RxLastPos) & (size - 1);
+	pUSARTHandle->RxLastPos = pos;
+	pUSARTHandle->RxHead = pUSARTHandle->RxHead + delta;
+
+	if(pUSARTHandle->RxHead - pUSARTHandle->RxTail > size)
+	{
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_OVERRUN);
+	}
+}
+
+static void USART_TxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	USART_Handle_t *pUSARTHandle = (USART_Handle_t*)pDMAHandle->pParent;
+
+	if(AppEv == DMA_EVENT_ERROR)
+	{
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_DMA_ERROR);
+	}
+
+	if(pUSARTHandle->TxDMALen)
+	{
+		// ring mode: release the chunk and chain the next one
+		pUSARTHandle->TxTail = pUSARTHandle->TxTail + pUSARTHandle->TxDMALen;
+		USART_StartTxRing(pUSARTHandle);
+		if(pUSARTHandle->TxDMALen == 0)
+			USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_TX_CMPLT);
+	} else if(pUSARTHandle->TxBusyState == USART_BUSY_IN_TX)
+	{
+		// USART_SendDataDMA
+		pUSARTHandle->TxBusyState = USART_READY;
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_TX_CMPLT);
+
+		// USART_Write may have queued data meanwhile
+		if(pUSARTHandle->pTxRing)
+			USART_StartTxRing(pUSARTHandle);
+	}
+}
+
+static void USART_RxDMAEventCallback(DMA_Handle_t *pDMAHandle, uint8_t AppEv)
+{
+	USART_Handle_t *pUSARTHandle = (USART_Handle_t*)pDMAHandle->pParent;
+
+	if(AppEv == DMA_EVENT_ERROR)
+	{
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_DMA_ERROR);
+		return;
+	}
+
+	// half and full ring: publish so the reader can keep up with long frames
+	USART_RxUpdateHead(pUSARTHandle);
+	USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_DATA);
+}
@@ -0,0 +1,325 @@
+/*
+ * stm32f407xx_ws2812.c
+ *
+ * Addressable LED strips, see stm32f407xx_ws2812.h
+ */
+#include <string.h>
+#include "stm32f407xx_ws2812.h"
+
+/*
+ * Symbols of a nibble, MSB first: 3 bits (12 bits) and 4 bits (16 bits)
+ * per LED bit
+ */
+static const uint16_t Ws2812_Nibble3[16] =
+{
+	0x924, 0x926, 0x934, 0x936, 0x9A4, 0x9A6, 0x9B4, 0x9B6,
+	0xD24, 0xD26, 0xD34, 0xD36, 0xDA4, 0xDA6, 0xDB4, 0xDB6
+};
+
+static const uint16_t Ws2812_Nibble4[16] =
+{
+	0x8888, 0x888E, 0x88E8, 0x88EE, 0x8E88, 0x8E8E, 0x8EE8, 0x8EEE,
+	0xE888, 0xE88E, 0xE8E8, 0xE8EE, 0xEE88, 0xEE8E, 0xEEE8, 0xEEEE
+};
+
+/*
+ * Helper functions
+ */
+static uint8_t Ws2812_Timing(Ws2812_Handle_t *pStrip);
+static void Ws2812_Encode(Ws2812_Handle_t *pStrip, uint8_t *pOut);
+static uint8_t Ws2812_Claim(Ws2812_Handle_t *pStrip);
+
+/**************************************************************************
+ * Initialize the strip
+ * ************************************************************************
+ * @fn			- Ws2812_Init
+ *
+ * @brief		- Picks the symbol length and the SPI speed for the LED
+ * 				  timing and sets the speed.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- pointer to the configuration
+ *
+ * @return		- @WS2812_RETURN
+ *
+ * @Note		- The pixels are not cleared: Ws2812_Fill(pStrip, 0) and a
+ * 				  commit switch the strip off.
+ ****************************************************************************/
+uint8_t Ws2812_Init(Ws2812_Handle_t *pStrip, Ws2812_Config_t *pConfig)
+{
+	uint8_t ledBytes;
+
+	if(pConfig->pPixels == 0 || pConfig->Leds == 0 || (pConfig->Channels != 3 && pConfig->Channels != 4))
+		return WS2812_ERR_PARAM;
+
+	memset(pStrip, 0, sizeof(*pStrip));
+	pStrip->Config = *pConfig;
+	if(pStrip->Config.Ws2812_ResetUs == 0)
+		pStrip->Config.Ws2812_ResetUs = WS2812_RESET_US;
+
+	if(!Ws2812_Timing(pStrip))
+		return WS2812_ERR_PARAM;
+
+	// whole LEDs per buffer
+	ledBytes = pConfig->Channels * pStrip->SymbolBits;
+	pStrip->ChunkLeds = WS2812_CHUNK_BYTES / ledBytes;
+	pStrip->ChunkLen = pStrip->ChunkLeds * ledBytes;
+
+	return WS2812_OK;
+}
+
+/**************************************************************************
+ * @fn			- Ws2812_SetPixel
+ *
+ * @brief		- Sets the color of one LED in the pixel buffer.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- LED number from the data input, below Leds (not checked)
+ * @param[in]	- 0xWWRRGGBB (W only with 4 channels)
+ *
+ * @return		- none
+ ****************************************************************************/
+void Ws2812_SetPixel(Ws2812_Handle_t *pStrip, uint16_t Index, uint32_t Color)
+{
+	uint8_t *pPixel = &pStrip->Config.pPixels[Index * pStrip->Config.Channels];
+
+	pPixel[0] = (uint8_t)(Color >> 8);
+	pPixel[1] = (uint8_t)(Color >> 16);
+	pPixel[2] = (uint8_t)Color;
+	if(pStrip->Config.Channels == 4)
+		pPixel[3] = (uint8_t)(Color >> 24);
+}
+
+/**************************************************************************
+ * @fn			- Ws2812_Fill
+ *
+ * @brief		- Sets all LEDs to one color.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- 0xWWRRGGBB (W only with 4 channels)
+ *
+ * @return		- none
+ ****************************************************************************/
+void Ws2812_Fill(Ws2812_Handle_t *pStrip, uint32_t Color)
+{
+	for(uint16_t i = 0; i < pStrip->Config.Leds; i++)
+		Ws2812_SetPixel(pStrip, i, Color);
+}
+
+/**************************************************************************
+ * Commit a frame
+ * ************************************************************************
+ * @fn			- Ws2812_Commit
+ *
+ * @brief		- Encodes the first LEDs into both buffers and starts the
+ * 				  stream. The interrupt encodes the rest and ends the frame.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- @WS2812_RETURN
+ *
+ * @Note		- WS2812_EVENT_COMMIT_CMPLT after the reset time.
+ ****************************************************************************/
+uint8_t Ws2812_Commit(Ws2812_Handle_t *pStrip)
+{
+	Ws2812_Config_t *pConfig = &pStrip->Config;
+	uint32_t bytes;
+
+	if(!Ws2812_Claim(pStrip))
+		return WS2812_BUSY;
+
+	pStrip->pSend = pConfig->pPixels;
+	if(pConfig->pFront != 0)
+	{
+		memcpy(pConfig->pFront, pConfig->pPixels, (uint32_t)pConfig->Leds * pConfig->Channels);
+		pStrip->pSend = pConfig->pFront;
+	}
+
+	// the LEDs, then the reset as zeros, in whole buffers
+	bytes = (uint32_t)pConfig->Leds * pConfig->Channels * pStrip->SymbolBits;
+	bytes += (uint32_t)pConfig->Ws2812_ResetUs * (pStrip->BitHz / 1000U) / 8000U + 1;
+	pStrip->Chunks = (bytes + pStrip->ChunkLen - 1) / pStrip->ChunkLen;
+	pStrip->Sent = 0;
+	pStrip->NextLed = 0;
+	Ws2812_Encode(pStrip, pStrip->Chunk[0]);
+	Ws2812_Encode(pStrip, pStrip->Chunk[1]);
+
+	if(SPI_SendStreamDMA(pConfig->pSPIHandle, pStrip->Chunk[0], pStrip->Chunk[1], pStrip->ChunkLen) != SPI_READY)
+	{
+		// someone else is using the SPI
+		pStrip->Busy = 0;
+		return WS2812_BUSY;
+	}
+	return WS2812_OK;
+}
+
+/**************************************************************************
+ * @fn			- Ws2812_Busy
+ *
+ * @brief		- Tells whether a commit is running.
+ *
+ * @param[in]	- pointer to the handle
+ *
+ * @return		- 1 if busy, 0 if not
+ ****************************************************************************/
+uint8_t Ws2812_Busy(Ws2812_Handle_t *pStrip)
+{
+	return pStrip->Busy;
+}
+
+/**************************************************************************
+ * SPI events
+ * ************************************************************************
+ * @fn			- Ws2812_EventHandling
+ *
+ * @brief		- Refills the buffer just sent, ends the frame after the
+ * 				  last one. Events of other SPI handles are ignored.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- SPI handle of the event
+ * @param[in]	- SPI_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Call it from SPI_ApplicationEventCallback.
+ ****************************************************************************/
+void Ws2812_EventHandling(Ws2812_Handle_t *pStrip, SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	if(pSPIHandle != pStrip->Config.pSPIHandle || !pStrip->Busy)
+		return;
+
+	if(AppEv == SPI_EVENT_DMA_ERR)
+	{
+		// the SPI driver has stopped the stream
+		pStrip->Busy = 0;
+		Ws2812_ApplicationEventCallback(pStrip, WS2812_EVENT_ERROR);
+		return;
+	}
+	if(AppEv != SPI_EVENT_TX_BUFFER_FREE)
+		return;
+
+	if(++pStrip->Sent == pStrip->Chunks)
+	{
+		// the other buffer holds zeros: the line stays low
+		SPI_StopStreamDMA(pSPIHandle);
+		pStrip->Frames++;
+		pStrip->Busy = 0;
+		Ws2812_ApplicationEventCallback(pStrip, WS2812_EVENT_COMMIT_CMPLT);
+		return;
+	}
+
+	// buffers alternate, starting with Chunk[0]
+	Ws2812_Encode(pStrip, pStrip->Chunk[(pStrip->Sent - 1) & 1]);
+}
+
+/**************************************************************************
+ * Application callback
+ * ************************************************************************
+ * @fn			- Ws2812_ApplicationEventCallback
+ *
+ * @brief		- Weak implementation. The application may override it.
+ *
+ * @param[in]	- pointer to the handle
+ * @param[in]	- WS2812_EVENT_xxx
+ *
+ * @return		- none
+ *
+ * @Note		- Runs in the DMA interrupt handler. The next frame may be
+ * 				  committed from here.
+ ****************************************************************************/
+__attribute__((weak)) void Ws2812_ApplicationEventCallback(Ws2812_Handle_t *pStrip, uint8_t AppEv)
+{
+	(void)pStrip;
+	(void)AppEv;
+}
+
+// fastest @SPI_SclkSpeed for 3 bit symbols, else for 4 bit ones
+static uint8_t Ws2812_Timing(Ws2812_Handle_t *pStrip)
+{
+	SPI_Handle_t *pSPIHandle = pStrip->Config.pSPIHandle;
+	const Periph_Instance_t *pInst = Periph_Get(pSPIHandle->pSPIx);
+	uint32_t pclk = (pInst != 0 && pInst->Bus == PERIPH_BUS_APB2) ? RCC_GetPCLK2Value() : RCC_GetPCLK1Value();
+
+	for(uint8_t bits = 3; bits <= 4; bits++)
+	{
+		for(uint8_t speed = SPI_SCLK_SPEED_DIV2; speed <= SPI_SCLK_SPEED_DIV256; speed++)
+		{
+			uint32_t hz = pclk >> (speed + 1);
+			uint32_t ns = 1000000000U / hz;
+
+			// a 0 is high for one SPI bit, a 1 for SymbolBits - 1
+			if(ns < WS2812_T0H_NS - WS2812_TOL_NS || ns > WS2812_T0H_NS + WS2812_TOL_NS ||
+			   ns * (bits - 1) < WS2812_T1H_NS - WS2812_TOL_NS || ns * (bits - 1) > WS2812_T1H_NS + WS2812_TOL_NS)
+				continue;
+
+			SPI_SclkSpeedConfig(pSPIHandle, speed);
+			pStrip->SymbolBits = bits;
+			pStrip->BitHz = hz;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// next buffer of the frame: the next LEDs, zeros after the last one
+static void Ws2812_Encode(Ws2812_Handle_t *pStrip, uint8_t *pOut)
+{
+	uint8_t channels = pStrip->Config.Channels;
+	uint32_t leds = pStrip->Config.Leds - pStrip->NextLed;
+	const uint8_t *pIn = &pStrip->pSend[pStrip->NextLed * channels];
+	uint8_t *pEnd = pOut + pStrip->ChunkLen;
+	uint32_t n;
+
+	if(leds > pStrip->ChunkLeds)
+		leds = pStrip->ChunkLeds;
+	pStrip->NextLed += leds;
+	n = leds * channels;
+
+	if(pStrip->SymbolBits == 3)
+	{
+		// a byte: 24 bits, 3 SPI bytes
+		while(n--)
+		{
+			uint32_t sym = ((uint32_t)Ws2812_Nibble3[*pIn >> 4] << 12) | Ws2812_Nibble3[*pIn & 0xF];
+
+			pOut[0] = (uint8_t)(sym >> 16);
+			pOut[1] = (uint8_t)(sym >> 8);
+			pOut[2] = (uint8_t)sym;
+			pOut += 3;
+			pIn++;
+		}
+	} else
+	{
+		// a byte: 32 bits, 4 SPI bytes
+		while(n--)
+		{
+			uint16_t hi = Ws2812_Nibble4[*pIn >> 4];
+			uint16_t lo = Ws2812_Nibble4[*pIn & 0xF];
+
+			pOut[0] = (uint8_t)(hi >> 8);
+			pOut[1] = (uint8_t)hi;
+			pOut[2] = (uint8_t)(lo >> 8);
+			pOut[3] = (uint8_t)lo;
+			pOut += 4;
+			pIn++;
+		}
+	}
+
+	if(pOut < pEnd)
+		memset(pOut, 0, pEnd - pOut);
+}
+
+static uint8_t Ws2812_Claim(Ws2812_Handle_t *pStrip)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint8_t claimed = 0;
+
+	__disable_irq();
+	if(!pStrip->Busy)
+	{
+		pStrip->Busy = 1;
+		claimed = 1;
+	}
+	__set_PRIMASK(primask);
+	return claimed;
+}
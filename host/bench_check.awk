@@ -0,0 +1,50 @@
+# Compares benchmark results with a baseline (both "benchmark,cycles" CSV,
+# as printed by Src/009driver_benchmarks.c).
+#
+#   awk -v TOLERANCE=5 -f bench_check.awk <baseline.csv> <results.csv>
+#
+# Fails (exit 1) when a benchmark takes more than TOLERANCE percent longer
+# than its baseline or when a baseline benchmark is missing. Faster results
+# and new benchmarks are only reported.
+
+BEGIN {
+	FS = ","
+	if(TOLERANCE == "")
+		TOLERANCE = 5
+}
+
+/^#/ || $1 == "benchmark" || NF < 2 {
+	next
+}
+
+FNR == NR {
+	baseline[$1] = $2
+	next
+}
+
+{
+	seen[$1] = 1
+	if(!($1 in baseline)) {
+		printf("new         %-36s %8d\n", $1, $2)
+		next
+	}
+	limit = baseline[$1] * (1 + TOLERANCE / 100)
+	if($2 > limit) {
+		printf("REGRESSION  %-36s %8d (baseline %d, +%.1f%%)\n", $1, $2, baseline[$1], 100 * ($2 - baseline[$1]) / baseline[$1])
+		failed++
+	} else if($2 < baseline[$1] * (1 - TOLERANCE / 100)) {
+		printf("faster      %-36s %8d (baseline %d)\n", $1, $2, baseline[$1])
+	}
+	checked++
+}
+
+END {
+	for(name in baseline) {
+		if(!(name in seen)) {
+			printf("MISSING     %s\n", name)
+			failed++
+		}
+	}
+	printf("%d benchmarks checked, %d failed (tolerance %s%%)\n", checked, failed, TOLERANCE)
+	exit failed ? 1 : 0
+}
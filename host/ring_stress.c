@@ -0,0 +1,390 @@
+/*
+ * Multi-threaded stress test of the lock-free ring (stm32f407xx_ring.h).
+ *
+ *   make -C host ring-stress
+ *
+ * The threads stand in for the interrupt handlers and the main loop of the
+ * target. On several cores they run truly in parallel, which is harder on
+ * the ring than preemption; on one core the scheduler preempts them at any
+ * instruction, like interrupts. A side which cannot make progress yields:
+ *
+ *   SPSC	one producer (Ring_Push and Ring_WriteSpan/Ring_Commit) and one
+ *			consumer (Ring_Pop and Ring_ReadSpan/Ring_Release). The bytes
+ *			follow a function of their position in the stream, so a lost,
+ *			repeated or reordered byte is seen.
+ *   MPSC	RING_STRESS_PRODUCERS producers with Ring_PushMP and one
+ *			consumer. A timer signal interrupts the producers and pushes
+ *			records too, also in the middle of their Ring_PushMP. Each
+ *			record carries its producer, a per producer sequence number
+ *			and a checksum.
+ *
+ * Both runs start the indexes just below the 24-bit wrap and move more
+ * than 2^24 bytes, so Head, Tail and Reserve wrap around several times.
+ * The producers in flight (top 8 bits of Reserve) are sampled: a signal
+ * must have pushed while another producer was in flight, and the count
+ * must be back to 0 at the end.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stm32f407xx_ring.h"
+
+#define RING_STRESS_SIZE			4096
+#define RING_STRESS_SPSC_BYTES		(48U << 20)
+#define RING_STRESS_PRODUCERS		8
+#define RING_STRESS_RECORDS			200000		// per producer
+#define RING_STRESS_START			(RING_INDEX_MASK + 1 - 1000)
+#define RING_STRESS_ISR_NS			20000		// timer signal period
+#define RING_STRESS_ISR_WAIT_NS		20000		// nested handler runs this long
+#define RING_STRESS_TIMEOUT_S		120
+
+// record: length, producer, sequence (4 bytes), payload, checksum
+#define RECORD_MIN					8
+#define RECORD_MAX					64
+
+static uint8_t stress_storage[RING_STRESS_SIZE];
+static Ring_t stress_ring;
+
+static uint64_t stress_pushed_sum[RING_STRESS_PRODUCERS];
+static uint32_t stress_done;				// producers finished
+static uint32_t stress_isr_pushes;
+static uint32_t stress_isr_nested;			// pushed while a producer was in flight
+static uint32_t stress_in_flight;			// most producers in flight seen
+
+/*
+ * Helper functions
+ */
+static void stress_start(void);
+static uint32_t stress_wraps(uint32_t Before, uint32_t After, uint32_t *pWraps);
+
+// the SPSC stream: byte n of the stream
+static inline uint8_t spsc_byte(uint32_t n)
+{
+	return (uint8_t)(n * 131 + (n >> 9) + (n >> 17));
+}
+
+static void *spsc_producer(void *pArg)
+{
+	uint32_t n = 0, step = 0;
+	uint8_t chunk[300];
+
+	(void)pArg;
+	while(n < RING_STRESS_SPSC_BYTES)
+	{
+		uint32_t len = (step * 37) % 257 + 1;
+
+		if(len > RING_STRESS_SPSC_BYTES - n)
+			len = RING_STRESS_SPSC_BYTES - n;
+
+		if(step++ & 1)
+		{
+			uint8_t *pSpan;
+			uint32_t span = Ring_WriteSpan(&stress_ring, &pSpan);
+
+			if(len > span)
+				len = span;
+			for(uint32_t i = 0; i < len; i++)
+				pSpan[i] = spsc_byte(n + i);
+			Ring_Commit(&stress_ring, len);
+		} else
+		{
+			for(uint32_t i = 0; i < len; i++)
+				chunk[i] = spsc_byte(n + i);
+			len = Ring_Push(&stress_ring, chunk, len);
+		}
+		if(len == 0)
+			sched_yield();
+		n += len;
+	}
+	return 0;
+}
+
+static int stress_spsc(void)
+{
+	pthread_t producer;
+	uint32_t n = 0, step = 0, bad = 0, wraps = 0, tail = 0;
+	uint64_t sum_in = 0, sum_out = 0;
+	uint8_t chunk[300];
+
+	stress_start();
+	tail = stress_ring.Tail;
+	pthread_create(&producer, 0, spsc_producer, 0);
+
+	while(n < RING_STRESS_SPSC_BYTES)
+	{
+		uint32_t len;
+
+		if(step++ & 1)
+		{
+			uint8_t *pSpan;
+
+			len = Ring_ReadSpan(&stress_ring, &pSpan);
+			if(len > (step * 53) % 300 + 1)
+				len = (step * 53) % 300 + 1;
+			for(uint32_t i = 0; i < len; i++)
+			{
+				bad += (pSpan[i] != spsc_byte(n + i));
+				sum_out += pSpan[i];
+			}
+			Ring_Release(&stress_ring, len);
+		} else
+		{
+			len = Ring_Pop(&stress_ring, chunk, (step * 53) % 300 + 1);
+			for(uint32_t i = 0; i < len; i++)
+			{
+				bad += (chunk[i] != spsc_byte(n + i));
+				sum_out += chunk[i];
+			}
+		}
+		if(len == 0)
+			sched_yield();
+		n += len;
+		tail = stress_wraps(tail, stress_ring.Tail, &wraps);
+	}
+	pthread_join(producer, 0);
+
+	for(uint32_t i = 0; i < RING_STRESS_SPSC_BYTES; i++)
+		sum_in += spsc_byte(i);
+
+	if(bad || sum_in != sum_out || Ring_Used(&stress_ring) != 0 || wraps == 0)
+	{
+		printf("Ring SPSC: %lu bad bytes, checksum %llu/%llu, %lu left, %lu index wraps\n",
+				(unsigned long)bad, (unsigned long long)sum_out, (unsigned long long)sum_in,
+				(unsigned long)Ring_Used(&stress_ring), (unsigned long)wraps);
+		return 1;
+	}
+	printf("Ring SPSC: %u MiB through %u bytes, sequence and checksum ok, indexes wrapped %lu times\n",
+			RING_STRESS_SPSC_BYTES >> 20, RING_STRESS_SIZE, (unsigned long)wraps);
+	return 0;
+}
+
+// builds record Seq of producer Id, returns its length
+static uint8_t mpsc_record(uint8_t *pRecord, uint8_t Id, uint32_t Seq)
+{
+	uint8_t len = RECORD_MIN + (Seq * 13 + Id * 7) % (RECORD_MAX - RECORD_MIN + 1);
+	uint8_t check = 0;
+
+	pRecord[0] = len;
+	pRecord[1] = Id;
+	memcpy(&pRecord[2], &Seq, sizeof(Seq));
+	for(uint8_t i = 6; i < len - 1; i++)
+		pRecord[i] = (uint8_t)(Seq * 7 + i + Id);
+	for(uint8_t i = 0; i < len - 1; i++)
+		check += pRecord[i];
+	pRecord[len - 1] = check;
+	return len;
+}
+
+static uint64_t mpsc_sum(const uint8_t *pRecord, uint8_t Len)
+{
+	uint64_t sum = 0;
+
+	for(uint8_t i = 0; i < Len; i++)
+		sum += pRecord[i];
+	return sum;
+}
+
+/*
+ * The "interrupt": a timer signal lands in one of the producer threads,
+ * maybe in the middle of its Ring_PushMP, and pushes a record of its own
+ * (producer Id + RING_STRESS_PRODUCERS). Like a handler it never waits:
+ * a record which does not fit is dropped and not counted.
+ */
+static __thread uint8_t isr_id;
+static __thread uint32_t isr_seq;
+static __thread uint64_t isr_sum;
+
+static void mpsc_isr(int Signal)
+{
+	uint32_t writers = __atomic_load_n(&stress_ring.Reserve, __ATOMIC_RELAXED) / RING_WRITER;
+	uint8_t record[RECORD_MAX];
+	uint8_t len = mpsc_record(record, isr_id, isr_seq);
+
+	(void)Signal;
+	if(Ring_PushMP(&stress_ring, record, len) == 0)
+		return;
+	isr_seq++;
+	isr_sum += mpsc_sum(record, len);
+	__atomic_add_fetch(&stress_isr_pushes, 1, __ATOMIC_RELAXED);
+	if(writers != 0)
+	{
+		struct timespec wait = { 0, RING_STRESS_ISR_WAIT_NS };
+
+		// a long handler: the consumer runs while the interrupted producer
+		// has not copied its record, which must not be published yet
+		__atomic_add_fetch(&stress_isr_nested, 1, __ATOMIC_RELAXED);
+		nanosleep(&wait, 0);
+	}
+	if(writers + 1 > __atomic_load_n(&stress_in_flight, __ATOMIC_RELAXED))
+		__atomic_store_n(&stress_in_flight, writers + 1, __ATOMIC_RELAXED);
+}
+
+static void *mpsc_producer(void *pArg)
+{
+	uint8_t id = (uint8_t)(uintptr_t)pArg;
+	uint8_t record[RECORD_MAX];
+	uint64_t sum = 0;
+	sigset_t isr;
+
+	isr_id = id + RING_STRESS_PRODUCERS;
+	sigemptyset(&isr);
+	sigaddset(&isr, SIGUSR1);
+	pthread_sigmask(SIG_UNBLOCK, &isr, 0);
+
+	for(uint32_t seq = 0; seq < RING_STRESS_RECORDS; seq++)
+	{
+		uint8_t len = mpsc_record(record, id, seq);
+
+		// all or nothing: retry until there is room
+		while(Ring_PushMP(&stress_ring, record, len) == 0)
+			sched_yield();
+		sum += mpsc_sum(record, len);
+	}
+
+	pthread_sigmask(SIG_BLOCK, &isr, 0);
+	stress_pushed_sum[id] = sum + isr_sum;
+	__atomic_add_fetch(&stress_done, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int stress_mpsc(void)
+{
+	pthread_t producers[RING_STRESS_PRODUCERS];
+	uint32_t next_seq[2 * RING_STRESS_PRODUCERS] = { 0 };
+	uint32_t records = 0, bad = 0, wraps = 0, tail, in_flight;
+	uint64_t sum_in = 0, sum_out = 0, bytes = 0;
+	uint8_t record[RECORD_MAX];
+	struct sigaction action;
+	struct sigevent event;
+	struct itimerspec period;
+	timer_t timer;
+	sigset_t isr;
+
+	stress_start();
+	tail = stress_ring.Tail;
+
+	// the consumer (this thread) is never interrupted, the producers are
+	sigemptyset(&isr);
+	sigaddset(&isr, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &isr, 0);
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = mpsc_isr;
+	sigaction(SIGUSR1, &action, 0);
+
+	for(uintptr_t id = 0; id < RING_STRESS_PRODUCERS; id++)
+		pthread_create(&producers[id], 0, mpsc_producer, (void*)id);
+
+	memset(&event, 0, sizeof(event));
+	event.sigev_notify = SIGEV_SIGNAL;
+	event.sigev_signo = SIGUSR1;
+	timer_create(CLOCK_MONOTONIC, &event, &timer);
+	memset(&period, 0, sizeof(period));
+	period.it_value.tv_nsec = RING_STRESS_ISR_NS;
+	period.it_interval.tv_nsec = RING_STRESS_ISR_NS;
+	timer_settime(timer, 0, &period, 0);
+
+	while(1)
+	{
+		uint32_t writers = __atomic_load_n(&stress_ring.Reserve, __ATOMIC_RELAXED) / RING_WRITER;
+		uint32_t seq;
+		uint8_t len, check = 0;
+
+		if(writers > __atomic_load_n(&stress_in_flight, __ATOMIC_RELAXED))
+			__atomic_store_n(&stress_in_flight, writers, __ATOMIC_RELAXED);
+
+		// Head only ever moves to the end of a record: the first byte
+		// visible means the whole record is
+		if(Ring_Peek(&stress_ring, &len, 1) == 0)
+		{
+			// the producers are done and published everything
+			if(__atomic_load_n(&stress_done, __ATOMIC_ACQUIRE) == RING_STRESS_PRODUCERS &&
+			   Ring_Used(&stress_ring) == 0)
+				break;
+			sched_yield();
+			continue;
+		}
+		if(len < RECORD_MIN || len > RECORD_MAX || Ring_Used(&stress_ring) < len)
+		{
+			printf("Ring MPSC: record length %u with %lu bytes published\n", len,
+					(unsigned long)Ring_Used(&stress_ring));
+			return 1;
+		}
+		Ring_Pop(&stress_ring, record, len);
+		tail = stress_wraps(tail, stress_ring.Tail, &wraps);
+
+		for(uint8_t i = 0; i < len - 1; i++)
+			check += record[i];
+		memcpy(&seq, &record[2], sizeof(seq));
+		if(check != record[len - 1] || record[1] >= 2 * RING_STRESS_PRODUCERS || seq != next_seq[record[1]])
+		{
+			bad++;
+		} else
+		{
+			next_seq[record[1]]++;
+			for(uint8_t i = 6; i < len - 1; i++)
+				bad += (record[i] != (uint8_t)(seq * 7 + i + record[1]));
+		}
+		sum_out += mpsc_sum(record, len);
+		bytes += len;
+		records++;
+	}
+	timer_delete(timer);
+
+	for(uint8_t id = 0; id < RING_STRESS_PRODUCERS; id++)
+	{
+		pthread_join(producers[id], 0);
+		sum_in += stress_pushed_sum[id];
+	}
+	in_flight = stress_in_flight;
+
+	if(bad || sum_in != sum_out || records != RING_STRESS_PRODUCERS * RING_STRESS_RECORDS + stress_isr_pushes ||
+	   wraps == 0 || stress_ring.Reserve != stress_ring.Head || stress_isr_nested == 0 || in_flight < 2)
+	{
+		printf("Ring MPSC: %lu bad of %lu records, checksum %llu/%llu, Reserve %06lX Head %06lX, "
+				"%lu index wraps, %lu nested pushes, %lu producers in flight at most\n", (unsigned long)bad,
+				(unsigned long)records, (unsigned long long)sum_out, (unsigned long long)sum_in,
+				(unsigned long)stress_ring.Reserve, (unsigned long)stress_ring.Head, (unsigned long)wraps,
+				(unsigned long)stress_isr_nested, (unsigned long)in_flight);
+		return 1;
+	}
+	printf("Ring MPSC: %u producers x %u records + %lu from a timer signal (%llu MiB), sequences and "
+			"checksums ok, indexes wrapped %lu times, %lu pushes nested in another, up to %lu in flight\n",
+			RING_STRESS_PRODUCERS, RING_STRESS_RECORDS, (unsigned long)stress_isr_pushes,
+			(unsigned long long)(bytes >> 20), (unsigned long)wraps, (unsigned long)stress_isr_nested,
+			(unsigned long)in_flight);
+	return 0;
+}
+
+int main(void)
+{
+	int errors = 0;
+
+	// a lost publish hangs the consumer: fail instead
+	alarm(RING_STRESS_TIMEOUT_S);
+
+	errors += stress_spsc();
+	errors += stress_mpsc();
+	return errors ? 1 : 0;
+}
+
+// empty ring with all indexes just below the 24-bit wrap
+static void stress_start(void)
+{
+	Ring_Init(&stress_ring, stress_storage, sizeof(stress_storage));
+	stress_ring.Head = RING_STRESS_START;
+	stress_ring.Tail = RING_STRESS_START;
+	stress_ring.Reserve = RING_STRESS_START;
+}
+
+static uint32_t stress_wraps(uint32_t Before, uint32_t After, uint32_t *pWraps)
+{
+	if(After < Before)
+		(*pWraps)++;
+	return After;
+}
@@ -0,0 +1,3469 @@
+/*
+ * Host demo: drives GPIOD and SPI2 through the unchanged drivers on the
+ * peripheral simulator. SPI2 talks to a simulated slave which records the
+ * bytes, the demo checks them and prints the simulated throughput.
+ *
+ * make -C host run
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f407xx.h"
+#include "stm32f407xx_spicmd.h"
+#include "stm32f407xx_nor.h"
+#include "stm32f407xx_sd.h"
+#include "stm32f407xx_lcd.h"
+#include "stm32f407xx_softspi.h"
+#include "stm32f407xx_pattern.h"
+#include "stm32f407xx_logic.h"
+#include "stm32f407xx_keypad.h"
+#include "stm32f407xx_expander.h"
+#include "stm32f407xx_ws2812.h"
+#include "stm32f407xx_stripe.h"
+#include "stm32_sim.h"
+
+#define DEMO_LEN		256
+
+typedef struct
+{
+	uint8_t Data[DEMO_LEN];
+	uint32_t Count;
+} demo_slave_t;
+
+static uint16_t demo_slave_xfer(void *pContext, uint16_t Mosi)
+{
+	demo_slave_t *pSlave = (demo_slave_t*)pContext;
+
+	if(pSlave->Count < DEMO_LEN)
+		pSlave->Data[pSlave->Count++] = (uint8_t)Mosi;
+	return (uint16_t)(~Mosi & 0xFF);
+}
+
+static int demo_gpio(void)
+{
+	GPIO_Handle_t led;
+
+	memset(&led, 0, sizeof(led));
+	led.pGPIOx = GPIOD;
+	led.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_12;
+	led.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	led.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	led.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	led.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+
+	GPIO_PeriClockControl(GPIOD, ENABLE);
+	GPIO_Init(&led);
+
+	GPIO_WriteToOutputPin(GPIOD, GPIO_PIN_NO_12, GPIO_PIN_SET);
+	if(sim_gpio_get_pin(GPIOD, GPIO_PIN_NO_12) != 1)
+		return 1;
+	GPIO_ToggleOutputPin(GPIOD, GPIO_PIN_NO_12);
+	if(sim_gpio_get_pin(GPIOD, GPIO_PIN_NO_12) != 0)
+		return 1;
+
+	GPIO_PeriClockControl(GPIOD, DISABLE);
+	printf("GPIOD: PD12 follows the driver\n");
+	return 0;
+}
+
+static int demo_spi(uint8_t SclkSpeed)
+{
+	static demo_slave_t slave;
+	SPI_Handle_t spi2;
+	uint8_t tx[DEMO_LEN];
+	uint64_t start, cycles;
+
+	for(uint32_t i = 0; i < DEMO_LEN; i++)
+		tx[i] = (uint8_t)(i * 7 + 1);
+	memset(&slave, 0, sizeof(slave));
+	sim_spi_attach(SPI2, demo_slave_xfer, &slave);
+
+	memset(&spi2, 0, sizeof(spi2));
+	spi2.pSPIx = SPI2;
+	spi2.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	spi2.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	spi2.SPIConfig.SPI_SclkSpeed = SclkSpeed;
+	spi2.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	spi2.SPIConfig.SPI_CPOL = SPI_CPOL_LOW;
+	spi2.SPIConfig.SPI_CPHA = SPI_CPHA_LOW;
+	spi2.SPIConfig.SPI_SSM = SPI_SSM_EN;
+
+	SPI_DeInit(SPI2);
+	SPI_Init(&spi2);
+	SPI_SSIConfig(SPI2, ENABLE);
+
+	// clock held for the burst only, as in Src/006
+	SPI_PeriClockControl(SPI2, ENABLE);
+	SPI_PeripheralControl(SPI2, ENABLE);
+
+	start = sim_get_cycles();
+	SPI_SendData(SPI2, tx, DEMO_LEN);
+	while(SPI_GetFlagStatus(SPI2, SPI_BUSY_FLAG));
+	cycles = sim_get_cycles() - start;
+
+	SPI_PeripheralControl(SPI2, DISABLE);
+	SPI_PeriClockControl(SPI2, DISABLE);
+
+	if(slave.Count != DEMO_LEN || memcmp(slave.Data, tx, DEMO_LEN) != 0)
+	{
+		printf("SPI2 DIV%u: slave got %u bytes, data mismatch\n", 2U << SclkSpeed, (unsigned)slave.Count);
+		return 1;
+	}
+	printf("SPI2 DIV%-3u: %u bytes in %llu cycles (%.1f cycles/byte, %.0f kB/s at %u MHz)\n",
+			2U << SclkSpeed, DEMO_LEN, (unsigned long long)cycles, (double)cycles / DEMO_LEN,
+			(double)DEMO_LEN * sim_get_hclk() / cycles / 1000.0, (unsigned)(sim_get_hclk() / 1000000U));
+	return 0;
+}
+
+/*
+ * Two users of the SPI3 clock: the clock stays on until both released it.
+ * The driver Inits hold no clock: after demo_gpio and demo_spi released
+ * theirs, GPIOD and SPI2 are off, and Inits of EXTI pins leave SYSCFG
+ * without users.
+ */
+static int demo_clk(void)
+{
+	GPIO_Handle_t btn;
+
+	memset(&btn, 0, sizeof(btn));
+	btn.pGPIOx = GPIOD;
+	btn.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_5;
+	btn.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IT_FT;
+	btn.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+	for(uint16_t i = 0; i < 300; i++)
+		GPIO_Init(&btn);
+	GPIO_DeInit(GPIOD);
+
+	if(Clk_GetRefCount(GPIOD) || Clk_GetRefCount(SPI2) || Clk_GetRefCount(SYSCFG) || (RCC->APB1ENR & (1 << 14)))
+	{
+		printf("Clocks: driver Inits hold GPIOD %u, SPI2 %u, SYSCFG %u\n", Clk_GetRefCount(GPIOD),
+				Clk_GetRefCount(SPI2), Clk_GetRefCount(SYSCFG));
+		return 1;
+	}
+	GPIO_PeriClockControl(GPIOD, ENABLE);
+	GPIO_PeriClockControl(GPIOD, DISABLE);
+	if(RCC->AHB1ENR & (1 << 3))
+	{
+		printf("Clocks: GPIOD on after its last user\n");
+		return 1;
+	}
+
+	SPI_PeriClockControl(SPI3, ENABLE);
+	SPI_PeriClockControl(SPI3, ENABLE);
+	SPI_PeriClockControl(SPI3, DISABLE);
+	if(!(RCC->APB1ENR & (1 << 15)) || Clk_GetRefCount(SPI3) != 1)
+	{
+		printf("Clocks: SPI3 gated with a user left\n");
+		return 1;
+	}
+	SPI_PeriClockControl(SPI3, DISABLE);
+	if(RCC->APB1ENR & (1 << 15))
+	{
+		printf("Clocks: SPI3 still on without users\n");
+		return 1;
+	}
+
+	printf("Clocks: SPI3 gated by its last user, on for %llu cycles, GPIOD/SPI2/SYSCFG without users after 300 Inits\n",
+			(unsigned long long)Clk_GetOnTime(SPI3));
+	Clk_Report();
+	return 0;
+}
+
+/*
+ * Power manager: an interrupt driven SPI3 transfer vetoes Stop, so the
+ * CPU only sleeps until it is done. Then Stop is entered (EXTI5 from a
+ * GPIO_MODE_IT_FT pin is the wake up source).
+ */
+static SPI_Handle_t demo_spi3;
+static volatile uint8_t demo_spi3_done;
+
+static uint64_t demo_spi3_isr_max;			// cycles, demo_spicmd
+
+void SPI3_IRQHandler(void)
+{
+	uint64_t start = sim_get_cycles();
+
+	SPI_IRQHandling(&demo_spi3);
+	if(sim_get_cycles() - start > demo_spi3_isr_max)
+		demo_spi3_isr_max = sim_get_cycles() - start;
+}
+
+static SpiCmd_Engine_t demo_cmd;
+static Nor_Handle_t demo_nor;
+static Sd_Handle_t demo_sd;
+static Expander_Handle_t demo_expander;
+static Ws2812_Handle_t demo_strip;
+static Stripe_Handle_t demo_stripe;
+static Lcd_Handle_t demo_lcd;
+
+void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle, uint8_t AppEv)
+{
+	if(pSPIHandle == &demo_spi3 && AppEv == SPI_EVENT_TX_CMPLT)
+		demo_spi3_done = 1;
+	SpiCmd_EventHandling(&demo_cmd, pSPIHandle, AppEv);
+	Nor_EventHandling(&demo_nor, pSPIHandle, AppEv);
+	Sd_EventHandling(&demo_sd, pSPIHandle, AppEv);
+	Lcd_EventHandling(&demo_lcd, pSPIHandle, AppEv);
+	Expander_EventHandling(&demo_expander, pSPIHandle, AppEv);
+	Ws2812_EventHandling(&demo_strip, pSPIHandle, AppEv);
+	Stripe_EventHandling(&demo_stripe, pSPIHandle, AppEv);
+}
+
+static int demo_pwr(void)
+{
+	static demo_slave_t slave;
+	static uint8_t tx[DEMO_LEN];
+	GPIO_Handle_t btn;
+	Pwr_Config_t pwr;
+	Pwr_Stats_t stats;
+	uint32_t stopped = 0;
+
+	memset(&btn, 0, sizeof(btn));
+	btn.pGPIOx = GPIOD;
+	btn.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_5;
+	btn.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_IT_FT;
+	btn.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
+	GPIO_Init(&btn);
+
+	memset(&pwr, 0, sizeof(pwr));
+	pwr.Pwr_StopRegulator = PWR_REGULATOR_LOW_POWER;
+	Pwr_Init(&pwr);
+
+	memset(&slave, 0, sizeof(slave));
+	sim_spi_attach(SPI3, demo_slave_xfer, &slave);
+	memset(&demo_spi3, 0, sizeof(demo_spi3));
+	demo_spi3.pSPIx = SPI3;
+	demo_spi3.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	demo_spi3.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	demo_spi3.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV32;
+	demo_spi3.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI_Init(&demo_spi3);
+	SPI_SSIConfig(SPI3, ENABLE);
+	SPI_PeripheralControl(SPI3, ENABLE);
+	SPI_IRQInterruptConfig(IRQ_NO_SPI3, ENABLE);
+
+	demo_spi3_done = 0;
+	SPI_SendDataIT(&demo_spi3, tx, DEMO_LEN);
+	if(Pwr_GetAllowedMode() != PWR_MODE_SLEEP)
+	{
+		printf("Power: Stop allowed during a SPI3 transfer\n");
+		return 1;
+	}
+	while(!demo_spi3_done)
+	{
+		if(Pwr_Idle(PWR_MODE_STOP) != PWR_MODE_SLEEP)
+			stopped++;
+	}
+	while(SPI_GetFlagStatus(SPI3, SPI_BUSY_FLAG));
+	SPI_PeripheralControl(SPI3, DISABLE);
+	SPI_IRQInterruptConfig(IRQ_NO_SPI3, DISABLE);
+
+	if(stopped != 0 || slave.Count != DEMO_LEN)
+	{
+		printf("Power: %u stops during the transfer, slave got %u bytes\n", (unsigned)stopped, (unsigned)slave.Count);
+		return 1;
+	}
+	if(Pwr_Idle(PWR_MODE_STOP) != PWR_MODE_STOP)
+	{
+		printf("Power: no Stop after the transfer\n");
+		return 1;
+	}
+
+	Pwr_GetStats(&stats);
+	printf("Power: %lu sleeps during SPI3 IT transfer (%lu Stop vetoed), %lu stop, wake %lu cycles\n",
+			(unsigned long)stats.Sleeps, (unsigned long)stats.StopVetoed, (unsigned long)stats.Stops,
+			(unsigned long)stats.LastWakeCycles[PWR_MODE_STOP - 1]);
+	return 0;
+}
+
+/*
+ * Scheduler: priority order, deferred calls and an EXTI event posted from
+ * the interrupt handler (PD5 is still set up by demo_pwr).
+ */
+static char demo_order[8];
+static uint8_t demo_order_len;
+static uint32_t demo_timer_runs[2];
+
+static void demo_record(uint32_t Arg)
+{
+	if(demo_order_len < sizeof(demo_order) - 1)
+		demo_order[demo_order_len++] = (char)Arg;
+}
+
+static void demo_timer(uint32_t Arg)
+{
+	demo_timer_runs[Arg]++;
+}
+
+static void demo_nothing(uint32_t Arg)
+{
+	(void)Arg;
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+	GPIO_IRQHandling(GPIO_PIN_NO_5);
+}
+
+void GPIO_ApplicationEventCallback(uint8_t PinNumber)
+{
+	Sched_Post(demo_record, '0' + PinNumber, SCHED_PRI_HIGHEST);
+}
+
+static int demo_sched(void)
+{
+	Sched_Timer_t once, periodic;
+	Sched_Stats_t stats;
+
+	Sched_Init(PWR_MODE_SLEEP);
+	demo_order_len = 0;
+
+	Sched_Post(demo_record, 'L', SCHED_PRI_LOW);
+	Sched_Post(demo_record, 'H', SCHED_PRI_HIGH);
+	Sched_Post(demo_record, 'T', SCHED_PRI_HIGHEST);
+	Sched_Post(demo_record, 'h', SCHED_PRI_HIGH);
+	while(Sched_RunOnce());
+
+	Sched_TimerInit(&once, demo_timer, 0, SCHED_PRI_LOW);
+	Sched_TimerInit(&periodic, demo_timer, 1, SCHED_PRI_LOW);
+	Sched_TimerStart(&once, 3, 0);
+	Sched_TimerStart(&periodic, 2, 2);
+	for(uint8_t tick = 0; tick < 6; tick++)
+	{
+		Sched_Tick();
+		while(Sched_RunOnce());
+	}
+	Sched_TimerStop(&periodic);
+
+	GPIO_IRQInterruptConfig(IRQ_NO_EXTI9_5, ENABLE);
+	sim_gpio_set_input(GPIOD, GPIO_PIN_NO_5, 0);
+	while(!Sched_RunOnce())
+		__WFI();
+	GPIO_IRQInterruptConfig(IRQ_NO_EXTI9_5, DISABLE);
+	sim_gpio_release_input(GPIOD, GPIO_PIN_NO_5);
+
+	demo_order[demo_order_len] = 0;
+	if(strcmp(demo_order, "THhL5") != 0 || demo_timer_runs[0] != 1 || demo_timer_runs[1] != 3)
+	{
+		printf("Scheduler: order %s, timers %u/%u\n", demo_order,
+				(unsigned)demo_timer_runs[0], (unsigned)demo_timer_runs[1]);
+		return 1;
+	}
+
+	// a one-shot timer expiring into a full queue is posted once there is room
+	for(uint8_t i = 0; i < SCHED_QUEUE_SIZE; i++)
+		Sched_Post(demo_nothing, 0, SCHED_PRI_LOWEST);
+	Sched_TimerInit(&once, demo_timer, 0, SCHED_PRI_LOWEST);
+	Sched_TimerStart(&once, 1, 0);
+	Sched_Tick();
+	Sched_Tick();
+	while(Sched_RunOnce());
+	Sched_GetStats(&stats);
+	if(demo_timer_runs[0] != 1 || stats.TimerRetries[SCHED_PRI_LOWEST] != 2)
+	{
+		printf("Scheduler: timer expiry lost in a full queue (%lu retries)\n",
+				(unsigned long)stats.TimerRetries[SCHED_PRI_LOWEST]);
+		return 1;
+	}
+	Sched_Tick();
+	while(Sched_RunOnce());
+	if(demo_timer_runs[0] != 2)
+	{
+		printf("Scheduler: timer expiry lost in a full queue\n");
+		return 1;
+	}
+
+	Sched_GetStats(&stats);
+	printf("Scheduler: events ran in order %s, worst latency %lu cycles (highest priority), "
+			"full queue put a timer off %lu ticks\n", demo_order,
+			(unsigned long)stats.MaxLatency[SCHED_PRI_HIGHEST], (unsigned long)stats.TimerRetries[SCHED_PRI_LOWEST]);
+	return 0;
+}
+
+/*
+ * Ring buffer: a byte stream through a small ring, many times around the
+ * wrap, with the zero-copy producer and the copying consumer, then the
+ * multiple producer push until the ring is full.
+ */
+static int demo_ring(void)
+{
+	static uint8_t storage[16];
+	Ring_t ring;
+	uint8_t out[8], record[5];
+	uint32_t written = 0, read = 0, pushed = 0;
+	int errors = 0;
+
+	Ring_Init(&ring, storage, sizeof(storage));
+	while(read < 1000)
+	{
+		uint8_t *pSpan;
+		uint32_t len = Ring_WriteSpan(&ring, &pSpan);
+
+		if(len > written % 7 + 1)
+			len = written % 7 + 1;
+		for(uint32_t i = 0; i < len; i++)
+			pSpan[i] = (uint8_t)(written + i);
+		Ring_Commit(&ring, len);
+		written += len;
+
+		len = Ring_Pop(&ring, out, read % 5 + 1);
+		for(uint32_t i = 0; i < len; i++)
+		{
+			if(out[i] != (uint8_t)(read + i))
+				errors++;
+		}
+		read += len;
+	}
+
+	Ring_Init(&ring, storage, sizeof(storage));
+	memset(record, 0xA5, sizeof(record));
+	while(Ring_PushMP(&ring, record, sizeof(record)))
+		pushed++;
+	if(errors || pushed != sizeof(storage) / sizeof(record) || Ring_Used(&ring) != pushed * sizeof(record))
+	{
+		printf("Ring: %d bad bytes, %lu records pushed\n", errors, (unsigned long)pushed);
+		return 1;
+	}
+
+	printf("Ring: %lu bytes through a %u byte ring, %lu records until full\n",
+			(unsigned long)read, (unsigned)sizeof(storage), (unsigned long)pushed);
+	return 0;
+}
+
+/*
+ * SPI command engine against a model of the course's Arduino slave on
+ * SPI3. The slave answers in the frame after the one which asked: it
+ * keeps the next MISO byte. The first SENSOR_READ is NACKed once.
+ */
+typedef struct
+{
+	uint8_t State;
+	uint8_t Cmd;
+	uint8_t Next;					// MISO of the next frame
+	uint8_t ArgsLeft;
+	uint8_t Args[32];
+	uint8_t ArgCount;
+	const uint8_t *pRsp;
+	uint8_t RspLeft;
+	uint8_t Nacks;					// NACK this many commands
+	uint8_t Led;
+	char Printed[32];
+} demo_arduino_t;
+
+static uint16_t demo_arduino_xfer(void *pContext, uint16_t Mosi)
+{
+	static const uint8_t id[] = "ARDUINOUNO";
+	static const uint8_t analog = 170;
+	demo_arduino_t *pSlave = (demo_arduino_t*)pContext;
+	uint8_t miso = pSlave->Next;
+
+	pSlave->Next = 0;
+	switch(pSlave->State)
+	{
+	case 0:		// command
+		pSlave->Cmd = (uint8_t)Mosi;
+		pSlave->Next = (Mosi >= SPICMD_LED_CTRL && Mosi <= SPICMD_ID_READ && pSlave->Nacks == 0) ? SPICMD_ACK : 0xA5;
+		if(pSlave->Next != SPICMD_ACK && pSlave->Nacks)
+			pSlave->Nacks--;
+		pSlave->State = 1;
+		break;
+	case 1:		// ACK clocked out
+		pSlave->State = 0;
+		pSlave->ArgCount = 0;
+		if(miso != SPICMD_ACK)
+			break;
+		pSlave->ArgsLeft = (pSlave->Cmd == SPICMD_LED_CTRL) ? 2 : (pSlave->Cmd == SPICMD_ID_READ) ? 0 : 1;
+		pSlave->pRsp = (pSlave->Cmd == SPICMD_ID_READ) ? id : (pSlave->Cmd == SPICMD_SENSOR_READ) ? &analog : &pSlave->Led;
+		pSlave->RspLeft = (pSlave->Cmd == SPICMD_ID_READ) ? 10 : (pSlave->Cmd == SPICMD_SENSOR_READ || pSlave->Cmd == SPICMD_LED_READ) ? 1 : 0;
+		pSlave->State = pSlave->ArgsLeft ? 2 : 3;
+		break;
+	case 2:		// arguments
+		pSlave->Args[pSlave->ArgCount++ & 31] = (uint8_t)Mosi;
+		if(pSlave->Cmd == SPICMD_PRINT && pSlave->ArgCount == 1)
+			pSlave->ArgsLeft += (uint8_t)Mosi;
+		if(--pSlave->ArgsLeft == 0)
+		{
+			if(pSlave->Cmd == SPICMD_LED_CTRL)
+				pSlave->Led = pSlave->Args[1];
+			if(pSlave->Cmd == SPICMD_PRINT)
+				memcpy(pSlave->Printed, &pSlave->Args[1], pSlave->Args[0] & 31);
+			pSlave->State = 3;
+		}
+		break;
+	}
+
+	// response: one byte per dummy frame
+	if(pSlave->State == 3)
+	{
+		if(pSlave->RspLeft)
+		{
+			pSlave->Next = *pSlave->pRsp++;
+			pSlave->RspLeft--;
+		} else
+		{
+			pSlave->State = 0;
+		}
+	}
+	return miso;
+}
+
+static int demo_spicmd(void)
+{
+	static demo_arduino_t slave;
+	static const uint8_t led[2] = { 9, 1 }, pin[1] = { 9 }, analog[1] = { 0 };
+	static const uint8_t print[6] = { 5, 'H', 'e', 'l', 'l', 'o' };
+	uint8_t sensor = 0, state = 0, id[11] = { 0 };
+	SpiCmd_Request_t req[5];
+	SpiCmd_Config_t config;
+	uint64_t frames = sim_get_stats()->SpiFrames;
+
+	memset(&slave, 0, sizeof(slave));
+	slave.Nacks = 1;
+	sim_spi_attach(SPI3, demo_arduino_xfer, &slave);
+	SPI_Init(&demo_spi3);
+	SPI_SSIConfig(SPI3, ENABLE);
+	SPI_IRQInterruptConfig(IRQ_NO_SPI3, ENABLE);
+
+	memset(&config, 0, sizeof(config));
+	config.pSPIHandle = &demo_spi3;
+	config.pCmdTable = SpiCmd_ArduinoCmds;
+	config.CmdCount = SPICMD_ARDUINO_NO_OF_CMDS;
+	config.SpiCmd_MaxRetries = 2;
+	config.SpiCmd_Priority = SCHED_PRI_HIGH;
+	SpiCmd_Init(&demo_cmd, &config);
+	demo_spi3_isr_max = 0;
+
+	memset(req, 0, sizeof(req));
+	req[0].Opcode = SPICMD_SENSOR_READ;
+	req[0].pArgs = analog;
+	req[0].pRsp = &sensor;
+	req[1].Opcode = SPICMD_LED_CTRL;
+	req[1].pArgs = led;
+	req[2].Opcode = SPICMD_LED_READ;
+	req[2].pArgs = pin;
+	req[2].pRsp = &state;
+	req[3].Opcode = SPICMD_PRINT;
+	req[3].pArgs = print;
+	req[3].ArgLen = sizeof(print);
+	req[4].Opcode = SPICMD_ID_READ;
+	req[4].pRsp = id;
+	for(uint8_t i = 0; i < 5; i++)
+		SpiCmd_Submit(&demo_cmd, &req[i]);
+
+	// one scheduler tick per idle pass drives the turnaround timers
+	while(SpiCmd_Busy(&demo_cmd))
+	{
+		if(!Sched_RunOnce())
+		{
+			Sched_Tick();
+			__WFI();
+		}
+	}
+	SPI_IRQInterruptConfig(IRQ_NO_SPI3, DISABLE);
+
+	for(uint8_t i = 0; i < 5; i++)
+	{
+		if(req[i].Status != SPICMD_STATUS_OK)
+		{
+			printf("SPI commands: 0x%02X status %u\n", req[i].Opcode, req[i].Status);
+			return 1;
+		}
+	}
+	if(sensor != 170 || state != 1 || strcmp((char*)id, "ARDUINOUNO") != 0 ||
+			strcmp(slave.Printed, "Hello") != 0 || req[0].Retries != 1)
+	{
+		printf("SPI commands: sensor %u, led %u, id %s, printed %s, retries %u\n",
+				sensor, state, (char*)id, slave.Printed, req[0].Retries);
+		return 1;
+	}
+
+	// the interrupt handler never waits for frames to shift out
+	if(demo_spi3_isr_max >= 8U * (2U << demo_spi3.SPIConfig.SPI_SclkSpeed))
+	{
+		printf("SPI commands: SPI3 interrupt took %llu cycles, longer than a frame\n",
+				(unsigned long long)demo_spi3_isr_max);
+		return 1;
+	}
+
+	printf("SPI commands: 5 commands queued at once, %u NACK retried, %lu frames, id %s, longest SPI3 interrupt %llu cycles\n",
+			req[0].Retries, (unsigned long)(sim_get_stats()->SpiFrames - frames), (char*)id,
+			(unsigned long long)demo_spi3_isr_max);
+	return 0;
+}
+
+/*
+ * W25Q80 (1 MB) on SPI1, chip select PA4: JEDEC ID, status register 1,
+ * fast read, page program (wraps inside the page), sector/block/chip
+ * erase, with the datasheet's typical program and erase times.
+ */
+#define DEMO_FLASH_SIZE		(1U << 20)
+#define DEMO_FLASH_CS		GPIO_PIN_NO_4
+
+typedef struct
+{
+	uint8_t Mem[DEMO_FLASH_SIZE];
+	uint8_t Selected;
+	uint8_t Cmd;
+	uint32_t Frames;				// since chip select went low
+	uint32_t Addr;
+	uint8_t Wel;
+	uint64_t BusyUntil;
+	uint32_t Programs;
+	uint32_t Erases;
+	uint32_t Polls;
+} demo_flash_t;
+
+static SPI_Handle_t demo_spi1;
+static TIM_Handle_t demo_tim6;
+static TIM_Handle_t demo_tim1;
+static SoftSpi_Handle_t demo_soft;
+static TIM_Handle_t demo_tim8;
+static Pattern_Handle_t demo_pattern;
+static Logic_Handle_t demo_logic;
+static TIM_Handle_t demo_tim7;
+static Keypad_Handle_t demo_keypad;
+static TIM_Handle_t demo_tim2;
+static volatile uint8_t demo_nor_event;
+
+static uint8_t demo_flash_busy(demo_flash_t *pFlash)
+{
+	return sim_get_cycles() < pFlash->BusyUntil;
+}
+
+static void demo_flash_busy_for(demo_flash_t *pFlash, uint32_t Us)
+{
+	pFlash->BusyUntil = sim_get_cycles() + (uint64_t)sim_get_hclk() / 1000000U * Us;
+	pFlash->Wel = 0;
+}
+
+// chip select edges: a command starts on the falling edge, program and
+// erase commands are executed on the rising edge
+static void demo_flash_cs(void *pContext, uint16_t OldIdr, uint16_t NewIdr)
+{
+	demo_flash_t *pFlash = (demo_flash_t*)pContext;
+	uint32_t size;
+
+	if(!((OldIdr ^ NewIdr) & (1U << DEMO_FLASH_CS)))
+		return;
+	if(!(NewIdr & (1U << DEMO_FLASH_CS)))
+	{
+		pFlash->Selected = 1;
+		pFlash->Frames = 0;
+		return;
+	}
+
+	pFlash->Selected = 0;
+	if(pFlash->Frames == 0 || demo_flash_busy(pFlash))
+		return;
+
+	switch(pFlash->Cmd)
+	{
+	case NOR_CMD_WRITE_ENABLE:
+		pFlash->Wel = 1;
+		break;
+	case NOR_CMD_PAGE_PROGRAM:
+		if(pFlash->Wel && pFlash->Frames > 4)
+		{
+			pFlash->Programs++;
+			demo_flash_busy_for(pFlash, 700);
+		}
+		break;
+	case NOR_CMD_SECTOR_ERASE:
+	case NOR_CMD_BLOCK_ERASE:
+	case NOR_CMD_CHIP_ERASE:
+		// chip select must rise right after the command (and address)
+		if(!pFlash->Wel || pFlash->Frames != ((pFlash->Cmd == NOR_CMD_CHIP_ERASE) ? 1U : 4U))
+			break;
+		size = (pFlash->Cmd == NOR_CMD_SECTOR_ERASE) ? NOR_SECTOR_SIZE : (pFlash->Cmd == NOR_CMD_BLOCK_ERASE) ? NOR_BLOCK_SIZE : DEMO_FLASH_SIZE;
+		memset(&pFlash->Mem[pFlash->Addr & (DEMO_FLASH_SIZE - size)], 0xFF, size);
+		pFlash->Erases++;
+		demo_flash_busy_for(pFlash, (pFlash->Cmd == NOR_CMD_SECTOR_ERASE) ? 45000 : 150000);
+		break;
+	}
+}
+
+static uint16_t demo_flash_xfer(void *pContext, uint16_t Mosi)
+{
+	static const uint8_t id[3] = { 0xEF, 0x40, 0x14 };
+	demo_flash_t *pFlash = (demo_flash_t*)pContext;
+	uint32_t frame;
+
+	if(!pFlash->Selected)
+		return 0xFF;
+
+	frame = pFlash->Frames++;
+	if(frame == 0)
+	{
+		pFlash->Cmd = (uint8_t)Mosi;
+		pFlash->Addr = 0;
+		return 0xFF;
+	}
+	if(pFlash->Cmd == NOR_CMD_READ_STATUS1)
+	{
+		pFlash->Polls++;
+		return (demo_flash_busy(pFlash) << NOR_SR1_WIP) | (pFlash->Wel << NOR_SR1_WEL);
+	}
+	if(demo_flash_busy(pFlash))
+		return 0xFF;
+	if(pFlash->Cmd == NOR_CMD_JEDEC_ID)
+		return (frame <= 3) ? id[frame - 1] : 0xFF;
+	if(frame <= 3)
+	{
+		// 24 bit address, MSB first
+		pFlash->Addr = ((pFlash->Addr << 8) | (Mosi & 0xFF)) & (DEMO_FLASH_SIZE - 1);
+		return 0xFF;
+	}
+
+	if(pFlash->Cmd == NOR_CMD_FAST_READ && frame >= 5)
+		return pFlash->Mem[(pFlash->Addr + frame - 5) & (DEMO_FLASH_SIZE - 1)];
+	if(pFlash->Cmd == NOR_CMD_PAGE_PROGRAM && pFlash->Wel)
+	{
+		uint32_t addr = (pFlash->Addr & ~(NOR_PAGE_SIZE - 1U)) | ((pFlash->Addr + frame - 4) & (NOR_PAGE_SIZE - 1U));
+
+		pFlash->Mem[addr] &= (uint8_t)Mosi;
+	}
+	return 0xFF;
+}
+
+void DMA2_Stream0_IRQHandler(void)
+{
+	DMA_IRQHandling(&demo_spi1.RxDMA);
+}
+
+void DMA2_Stream3_IRQHandler(void)
+{
+	DMA_IRQHandling(&demo_spi1.TxDMA);
+}
+
+void TIM6_DAC_IRQHandler(void)
+{
+	TIM_IRQHandling(&demo_tim6);
+}
+
+void TIM_ApplicationEventCallback(TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	if(pTIMHandle == &demo_tim6 && AppEv == TIM_EVENT_UPDATE)
+		Sched_Tick();
+	SoftSpi_EventHandling(&demo_soft, pTIMHandle, AppEv);
+	Pattern_EventHandling(&demo_pattern, pTIMHandle, AppEv);
+	Logic_EventHandling(&demo_logic, pTIMHandle, AppEv);
+	Keypad_EventHandling(&demo_keypad, pTIMHandle, AppEv);
+	Expander_TimerEventHandling(&demo_expander, pTIMHandle, AppEv);
+}
+
+// 1 ms scheduler tick from TIM6
+static void demo_tick(uint8_t EnOrDi)
+{
+	if(EnOrDi == DISABLE)
+	{
+		TIM_StopIT(&demo_tim6);
+		TIM_IRQInterruptConfig(IRQ_NO_TIM6_DAC, DISABLE);
+		return;
+	}
+	memset(&demo_tim6, 0, sizeof(demo_tim6));
+	demo_tim6.pTIMx = TIM6;
+	demo_tim6.TIM_Config.TIM_Prescaler = (uint16_t)(TIM_GetClockValue(TIM6) / 1000000U - 1);
+	demo_tim6.TIM_Config.TIM_Period = 999;
+	demo_tim6.TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+	TIM_Init(&demo_tim6);
+	TIM_IRQInterruptConfig(IRQ_NO_TIM6_DAC, ENABLE);
+	TIM_StartIT(&demo_tim6);
+}
+
+void Nor_ApplicationEventCallback(Nor_Handle_t *pNor, uint8_t AppEv)
+{
+	(void)pNor;
+	demo_nor_event = AppEv;
+}
+
+// runs the scheduler (sleeping in between) until the operation has ended
+static uint8_t demo_nor_wait(uint8_t Started)
+{
+	if(Started != NOR_OK)
+		return NOR_EVENT_ERROR;
+	while(Nor_Busy(&demo_nor))
+	{
+		if(!Sched_RunOnce())
+			__WFI();
+	}
+	return demo_nor_event;
+}
+
+static int demo_norflash(void)
+{
+	static demo_flash_t flash;
+	static uint8_t data[600], buf[600];
+	GPIO_Handle_t cs;
+	Nor_Config_t config;
+	uint32_t polls, addr;
+	uint64_t items = sim_get_stats()->DmaItems;
+
+	memset(flash.Mem, 0x00, sizeof(flash.Mem));
+	sim_spi_attach(SPI1, demo_flash_xfer, &flash);
+	sim_gpio_watch(GPIOA, demo_flash_cs, &flash);
+
+	memset(&cs, 0, sizeof(cs));
+	cs.pGPIOx = GPIOA;
+	cs.GPIO_PinConfig.GPIO_PinNumber = DEMO_FLASH_CS;
+	cs.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	cs.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	cs.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	GPIO_PeriClockControl(GPIOA, ENABLE);
+	GPIO_WriteToOutputPin(GPIOA, DEMO_FLASH_CS, SET);
+	GPIO_Init(&cs);
+
+	memset(&demo_spi1, 0, sizeof(demo_spi1));
+	demo_spi1.pSPIx = SPI1;
+	demo_spi1.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	demo_spi1.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	demo_spi1.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV4;
+	demo_spi1.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	demo_spi1.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI_Init(&demo_spi1);
+	SPI_SSIConfig(SPI1, ENABLE);
+	SPI_PeripheralControl(SPI1, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM0, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM3, ENABLE);
+
+	// 1 ms scheduler tick for the erase polling
+	demo_tick(ENABLE);
+
+	memset(&config, 0, sizeof(config));
+	config.pSPIHandle = &demo_spi1;
+	config.pCSPort = GPIOA;
+	config.CSPin = DEMO_FLASH_CS;
+	config.Nor_PollTicks = 5;
+	config.Nor_Priority = SCHED_PRI_HIGH;
+	config.Nor_ReadAhead = ENABLE;
+	Nor_Init(&demo_nor, &config);
+
+	if(demo_nor_wait(Nor_ReadId(&demo_nor)) != NOR_EVENT_ID_CMPLT || demo_nor.Capacity != DEMO_FLASH_SIZE)
+	{
+		printf("NOR flash: no W25Q80, capacity %lu\n", (unsigned long)demo_nor.Capacity);
+		return 1;
+	}
+
+	// erase, then 600 bytes from 0x10F0: 16 + 256 + 256 + 72 byte pages
+	if(demo_nor_wait(Nor_Erase(&demo_nor, 0x1000, NOR_ERASE_SECTOR)) != NOR_EVENT_ERASE_CMPLT)
+		return 1;
+	polls = flash.Polls;
+	for(uint32_t i = 0; i < sizeof(data); i++)
+		data[i] = (uint8_t)(i * 7 + 3);
+	if(demo_nor_wait(Nor_Program(&demo_nor, 0x10F0, data, sizeof(data))) != NOR_EVENT_PROGRAM_CMPLT ||
+	   demo_nor_wait(Nor_Read(&demo_nor, 0x10F0, buf, sizeof(buf))) != NOR_EVENT_READ_CMPLT)
+		return 1;
+	if(memcmp(buf, data, sizeof(data)) != 0 || flash.Programs != 4 || flash.Erases != 1 ||
+	   flash.Mem[0x10EF] != 0xFF || flash.Mem[0x0FFF] != 0x00)
+	{
+		printf("NOR flash: read back failed, %lu page programs\n", (unsigned long)flash.Programs);
+		return 1;
+	}
+
+	// sequential 64 byte reads: the read-ahead serves most of them
+	demo_nor.CacheHitBytes = 0;
+	for(addr = 0x10F0; addr < 0x10F0 + 512; addr += 64)
+	{
+		if(demo_nor_wait(Nor_Read(&demo_nor, addr, buf, 64)) != NOR_EVENT_READ_CMPLT ||
+		   memcmp(buf, &data[addr - 0x10F0], 64) != 0)
+		{
+			printf("NOR flash: sequential read at 0x%lX failed\n", (unsigned long)addr);
+			return 1;
+		}
+	}
+	while(demo_spi1.RxState != SPI_READY)
+		__WFI();
+
+	// outside the chip, misaligned, empty
+	if(Nor_Read(&demo_nor, DEMO_FLASH_SIZE - 4, buf, 8) != NOR_ERR_PARAM ||
+	   Nor_Program(&demo_nor, 0x1400, data, 0) != NOR_ERR_PARAM ||
+	   Nor_Erase(&demo_nor, 0x1001, NOR_ERASE_SECTOR) != NOR_ERR_PARAM ||
+	   Nor_Erase(&demo_nor, 0x8000, NOR_ERASE_BLOCK) != NOR_ERR_PARAM ||
+	   Nor_Erase(&demo_nor, DEMO_FLASH_SIZE, NOR_ERASE_SECTOR) != NOR_ERR_PARAM)
+	{
+		printf("NOR flash: bad parameters accepted\n");
+		return 1;
+	}
+
+	// one operation at a time
+	if(Nor_Erase(&demo_nor, 0x2000, NOR_ERASE_SECTOR) != NOR_OK ||
+	   Nor_Read(&demo_nor, 0x2000, buf, 16) != NOR_BUSY ||
+	   Nor_Program(&demo_nor, 0x2000, data, 16) != NOR_BUSY ||
+	   demo_nor_wait(NOR_OK) != NOR_EVENT_ERASE_CMPLT)
+	{
+		printf("NOR flash: second operation accepted during an erase\n");
+		return 1;
+	}
+
+	// A program submitted while the read-ahead fetches the bytes it
+	// changes waits for it and drops them: the next read sees the chip.
+	if(demo_nor_wait(Nor_Read(&demo_nor, 0x1400, buf, 64)) != NOR_EVENT_READ_CMPLT ||
+	   Nor_Busy(&demo_nor) || demo_spi1.RxState == SPI_READY ||
+	   demo_nor_wait(Nor_Program(&demo_nor, 0x1480, data, 16)) != NOR_EVENT_PROGRAM_CMPLT ||
+	   demo_nor_wait(Nor_Read(&demo_nor, 0x1440, buf, 128)) != NOR_EVENT_READ_CMPLT)
+		return 1;
+	for(uint32_t i = 0; i < 128; i++)
+	{
+		if(buf[i] != ((i >= 0x40 && i < 0x50) ? data[i - 0x40] : 0xFF))
+		{
+			printf("NOR flash: stale read-ahead at 0x%lX after a program\n", (unsigned long)(0x1440 + i));
+			return 1;
+		}
+	}
+
+	// the same for an erase of cached bytes
+	while(demo_spi1.RxState != SPI_READY)
+		__WFI();
+	if(demo_nor.CacheLen == 0 || demo_nor.CacheAddr >= 0x2000 ||
+	   demo_nor_wait(Nor_Erase(&demo_nor, 0x1000, NOR_ERASE_SECTOR)) != NOR_EVENT_ERASE_CMPLT)
+		return 1;
+	if(demo_nor.CacheLen != 0)
+	{
+		printf("NOR flash: read-ahead of 0x%lX kept over an erase\n", (unsigned long)demo_nor.CacheAddr);
+		return 1;
+	}
+	if(demo_nor_wait(Nor_Read(&demo_nor, 0x14C0, buf, 64)) != NOR_EVENT_READ_CMPLT)
+		return 1;
+	for(uint32_t i = 0; i < 64; i++)
+	{
+		if(buf[i] != 0xFF)
+		{
+			printf("NOR flash: stale read-ahead at 0x%lX after an erase\n", (unsigned long)(0x14C0 + i));
+			return 1;
+		}
+	}
+	while(demo_spi1.RxState != SPI_READY)
+		__WFI();
+
+	// no chip on the bus: the ID is all ones, the handle refuses to work
+	sim_spi_attach(SPI1, 0, 0);
+	if(demo_nor_wait(Nor_ReadId(&demo_nor)) != NOR_EVENT_ERROR || demo_nor.Capacity != 0 ||
+	   Nor_Read(&demo_nor, 0, buf, 1) != NOR_ERR_PARAM || sim_gpio_get_pin(GPIOA, DEMO_FLASH_CS) != 1)
+	{
+		printf("NOR flash: missing chip not reported\n");
+		return 1;
+	}
+	sim_spi_attach(SPI1, demo_flash_xfer, &flash);
+	if(demo_nor_wait(Nor_ReadId(&demo_nor)) != NOR_EVENT_ID_CMPLT || demo_nor.Capacity != DEMO_FLASH_SIZE)
+		return 1;
+
+	demo_tick(DISABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM0, DISABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM3, DISABLE);
+
+	printf("NOR flash: JEDEC %02X%02X%02X %lu KB, erase polled %lu times, %lu page programs, "
+			"%lu of 512 sequential bytes read ahead, %lu DMA items, read-ahead dropped by program/erase, "
+			"bad parameters, busy and missing chip refused\n",
+			demo_nor.JedecId[0], demo_nor.JedecId[1], demo_nor.JedecId[2], (unsigned long)(demo_nor.Capacity >> 10),
+			(unsigned long)polls, (unsigned long)flash.Programs, (unsigned long)demo_nor.CacheHitBytes,
+			(unsigned long)(sim_get_stats()->DmaItems - items));
+	return 0;
+}
+
+/*
+ * SDHC card (16 MB, the first DEMO_SD_STORE blocks kept) on SPI2, chip
+ * select PB12: SPI mode initialization, CSD, single and multiple block
+ * reads and writes, CRC7/CRC16 checks once CMD59 has switched them on,
+ * and programming busy times.
+ */
+#define DEMO_SD_CS			GPIO_PIN_NO_12
+#define DEMO_SD_BLOCKS		32768U
+#define DEMO_SD_STORE		256U
+#define DEMO_SD_NAC			2			// 0xFF bytes before a read data token
+
+#define DEMO_SD_CMD			0
+#define DEMO_SD_READ		1
+#define DEMO_SD_WRITE		2
+
+#define DEMO_SD_FAULT_NONE	0
+#define DEMO_SD_FAULT_DATA	1			// one bit of the next block flipped (read or write)
+#define DEMO_SD_FAULT_TOKEN	2			// data error token instead of the next read block
+#define DEMO_SD_FAULT_HANG	3			// no read data token at all
+
+typedef struct
+{
+	uint8_t Mem[DEMO_SD_STORE][SD_BLOCK_SIZE];
+	uint8_t Selected;
+	uint8_t Idle;
+	uint8_t AppCmd;
+	uint8_t CrcOn;
+	uint8_t Inits;					// ACMD41s answered "idle"
+	uint8_t Frame[6];
+	uint8_t FrameLen;
+	uint8_t Out[24];				// response bytes to shift out
+	uint8_t OutLen;
+	uint8_t OutPos;
+	uint8_t State;
+	uint8_t Multi;
+	uint32_t Lba;
+	int32_t Pos;					// byte of the block (write: -1 waiting for the token)
+	uint8_t Block[SD_BLOCK_SIZE + 2];
+	uint64_t BusyUntil;
+	uint8_t Fault;					// DEMO_SD_FAULT_xxx, once
+	uint32_t Errors;
+	uint32_t Cmd17, Cmd18, Cmd24, Cmd25;
+} demo_sd_t;
+
+static SPI_Handle_t demo_spi2;
+static volatile uint8_t demo_sd_event;
+
+static uint8_t demo_crc7(const uint8_t *pData, uint32_t Len)
+{
+	uint8_t crc = 0;
+
+	while(Len--)
+	{
+		uint8_t data = *pData++;
+
+		for(uint8_t i = 0; i < 8; i++)
+		{
+			uint8_t feedback = ((data >> 7) ^ (crc >> 6)) & 1;
+
+			crc = (uint8_t)((crc << 1) & 0x7F);
+			if(feedback)
+				crc ^= 0x09;
+			data <<= 1;
+		}
+	}
+	return (uint8_t)((crc << 1) | 1);
+}
+
+static uint16_t demo_crc16(const uint8_t *pData, uint32_t Len)
+{
+	uint16_t crc = 0;
+
+	while(Len--)
+	{
+		crc ^= (uint16_t)(*pData++ << 8);
+		for(uint8_t i = 0; i < 8; i++)
+			crc = (uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+	}
+	return crc;
+}
+
+static void demo_sd_respond(demo_sd_t *pCard, const uint8_t *pBytes, uint8_t Len)
+{
+	memcpy(pCard->Out, pBytes, Len);
+	pCard->OutLen = Len;
+	pCard->OutPos = 0;
+}
+
+static void demo_sd_busy_for(demo_sd_t *pCard, uint32_t Us)
+{
+	pCard->BusyUntil = sim_get_cycles() + (uint64_t)sim_get_hclk() / 1000000U * Us;
+}
+
+static void demo_sd_cs(void *pContext, uint16_t OldIdr, uint16_t NewIdr)
+{
+	demo_sd_t *pCard = (demo_sd_t*)pContext;
+
+	if(!((OldIdr ^ NewIdr) & (1U << DEMO_SD_CS)))
+		return;
+	pCard->Selected = !(NewIdr & (1U << DEMO_SD_CS));
+	pCard->FrameLen = 0;
+	pCard->OutLen = 0;
+}
+
+// a complete command frame
+static void demo_sd_command(demo_sd_t *pCard)
+{
+	static const uint8_t csd[16] = { 0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00, 0x00,
+									 0x00, 0x1F, 0x7F, 0x80, 0x0A, 0x40, 0x00, 0x01 };	// C_SIZE 31
+	uint8_t cmd = pCard->Frame[0] & 0x3F;
+	uint32_t arg = ((uint32_t)pCard->Frame[1] << 24) | ((uint32_t)pCard->Frame[2] << 16) |
+				   ((uint32_t)pCard->Frame[3] << 8) | pCard->Frame[4];
+	uint8_t app = pCard->AppCmd;
+	uint8_t r[24];
+	uint16_t crc;
+
+	pCard->AppCmd = 0;
+	r[0] = pCard->Idle;
+
+	// CMD0 and CMD8 are always checked
+	if((pCard->CrcOn || cmd == 0 || cmd == 8) && pCard->Frame[5] != demo_crc7(pCard->Frame, 5))
+	{
+		pCard->Errors++;
+		r[0] |= SD_R1_CRC_ERROR;
+		demo_sd_respond(pCard, r, 1);
+		return;
+	}
+
+	switch(cmd)
+	{
+	case SD_CMD_GO_IDLE_STATE:
+		pCard->Idle = 1;
+		pCard->CrcOn = 0;
+		r[0] = SD_R1_IDLE;
+		demo_sd_respond(pCard, r, 1);
+		break;
+	case SD_CMD_SEND_IF_COND:
+		r[1] = 0x00;
+		r[2] = 0x00;
+		r[3] = (uint8_t)((arg >> 8) & 0x0F);
+		r[4] = (uint8_t)arg;
+		demo_sd_respond(pCard, r, 5);
+		break;
+	case SD_CMD_CRC_ON_OFF:
+		pCard->CrcOn = arg & 1;
+		demo_sd_respond(pCard, r, 1);
+		break;
+	case SD_CMD_APP_CMD:
+		pCard->AppCmd = 1;
+		demo_sd_respond(pCard, r, 1);
+		break;
+	case SD_ACMD_SD_SEND_OP_COND:
+		if(!app)
+		{
+			r[0] |= SD_R1_ILLEGAL_CMD;
+		} else if(++pCard->Inits > 3)
+		{
+			pCard->Idle = 0;
+			r[0] = 0;
+		}
+		demo_sd_respond(pCard, r, 1);
+		break;
+	case SD_CMD_READ_OCR:
+		r[1] = 0xC0;			// powered up, CCS
+		r[2] = 0xFF;
+		r[3] = 0x80;
+		r[4] = 0x00;
+		demo_sd_respond(pCard, r, 5);
+		break;
+	case SD_CMD_SEND_CSD:
+		r[1] = 0xFF;
+		r[2] = SD_TOKEN_START_BLOCK;
+		memcpy(&r[3], csd, 16);
+		crc = demo_crc16(csd, 16);
+		r[19] = (uint8_t)(crc >> 8);
+		r[20] = (uint8_t)crc;
+		demo_sd_respond(pCard, r, 21);
+		break;
+	case SD_CMD_SET_BLOCKLEN:
+	case SD_CMD_STOP_TRANSMISSION:
+		demo_sd_respond(pCard, r, 1);
+		break;
+	case SD_CMD_READ_SINGLE_BLOCK:
+	case SD_CMD_READ_MULTIPLE_BLOCK:
+	case SD_CMD_WRITE_BLOCK:
+	case SD_CMD_WRITE_MULTIPLE_BLOCK:
+		if(pCard->Idle || arg >= DEMO_SD_BLOCKS)
+		{
+			r[0] |= SD_R1_ILLEGAL_CMD;
+			demo_sd_respond(pCard, r, 1);
+			break;
+		}
+		demo_sd_respond(pCard, r, 1);
+		pCard->Lba = arg;
+		pCard->Multi = (cmd == SD_CMD_READ_MULTIPLE_BLOCK || cmd == SD_CMD_WRITE_MULTIPLE_BLOCK);
+		if(cmd == SD_CMD_READ_SINGLE_BLOCK || cmd == SD_CMD_READ_MULTIPLE_BLOCK)
+		{
+			pCard->State = DEMO_SD_READ;
+			pCard->Pos = 0;
+			*(pCard->Multi ? &pCard->Cmd18 : &pCard->Cmd17) += 1;
+		} else
+		{
+			pCard->State = DEMO_SD_WRITE;
+			pCard->Pos = -1;
+			*(pCard->Multi ? &pCard->Cmd25 : &pCard->Cmd24) += 1;
+		}
+		break;
+	default:
+		r[0] |= SD_R1_ILLEGAL_CMD;
+		demo_sd_respond(pCard, r, 1);
+		break;
+	}
+}
+
+// next byte of a read: access time, token, block, CRC16
+static uint8_t demo_sd_read(demo_sd_t *pCard)
+{
+	int32_t pos = pCard->Pos++;
+
+	if(pos < DEMO_SD_NAC || pCard->Fault == DEMO_SD_FAULT_HANG)
+		return 0xFF;
+	if(pos == DEMO_SD_NAC)
+	{
+		uint16_t crc;
+
+		if(pCard->Fault == DEMO_SD_FAULT_TOKEN)
+		{
+			pCard->Fault = DEMO_SD_FAULT_NONE;
+			pCard->State = DEMO_SD_CMD;
+			return 0x08;			// error token: out of range
+		}
+
+		if(pCard->Lba < DEMO_SD_STORE)
+			memcpy(pCard->Block, pCard->Mem[pCard->Lba], SD_BLOCK_SIZE);
+		else
+			memset(pCard->Block, 0, SD_BLOCK_SIZE);
+		crc = demo_crc16(pCard->Block, SD_BLOCK_SIZE);
+		pCard->Block[SD_BLOCK_SIZE] = (uint8_t)(crc >> 8);
+		pCard->Block[SD_BLOCK_SIZE + 1] = (uint8_t)crc;
+		if(pCard->Fault == DEMO_SD_FAULT_DATA)
+		{
+			pCard->Fault = DEMO_SD_FAULT_NONE;
+			pCard->Block[SD_BLOCK_SIZE / 2] ^= 0x10;
+		}
+		return SD_TOKEN_START_BLOCK;
+	}
+	pos -= DEMO_SD_NAC + 1;
+	if(pos == SD_BLOCK_SIZE + 1)
+	{
+		// block done
+		pCard->Pos = 0;
+		pCard->Lba++;
+		if(!pCard->Multi)
+			pCard->State = DEMO_SD_CMD;
+	}
+	return pCard->Block[pos];
+}
+
+// next byte of a write: token, block, CRC16, then the data response
+static void demo_sd_write(demo_sd_t *pCard, uint8_t In)
+{
+	uint8_t resp = SD_DATA_RESP_ACCEPTED;
+
+	if(pCard->Pos < 0)
+	{
+		if(In == SD_TOKEN_STOP_TRAN && pCard->Multi)
+		{
+			pCard->State = DEMO_SD_CMD;
+			demo_sd_busy_for(pCard, 250);
+		} else if(In == (pCard->Multi ? SD_TOKEN_START_MULTI : SD_TOKEN_START_BLOCK))
+		{
+			pCard->Pos = 0;
+		}
+		return;
+	}
+
+	pCard->Block[pCard->Pos++] = In;
+	if(pCard->Pos < SD_BLOCK_SIZE + 2)
+		return;
+	if(pCard->Fault == DEMO_SD_FAULT_DATA)
+	{
+		pCard->Fault = DEMO_SD_FAULT_NONE;
+		pCard->Block[SD_BLOCK_SIZE / 2] ^= 0x10;
+	}
+
+	if(pCard->CrcOn && demo_crc16(pCard->Block, SD_BLOCK_SIZE) !=
+	   (uint16_t)((pCard->Block[SD_BLOCK_SIZE] << 8) | pCard->Block[SD_BLOCK_SIZE + 1]))
+	{
+		pCard->Errors++;
+		resp = 0x0B;			// CRC error
+	} else if(pCard->Lba < DEMO_SD_STORE)
+	{
+		memcpy(pCard->Mem[pCard->Lba], pCard->Block, SD_BLOCK_SIZE);
+	}
+	pCard->Lba++;
+	demo_sd_respond(pCard, &resp, 1);
+	// the card buffers a multiple block write, a single block is programmed at once
+	demo_sd_busy_for(pCard, pCard->Multi ? 20 : 250);
+	pCard->Pos = -1;
+	if(!pCard->Multi)
+		pCard->State = DEMO_SD_CMD;
+}
+
+static uint16_t demo_sd_xfer(void *pContext, uint16_t Mosi)
+{
+	demo_sd_t *pCard = (demo_sd_t*)pContext;
+	uint8_t in = (uint8_t)Mosi;
+	uint8_t miso = 0xFF;
+
+	if(!pCard->Selected)
+		return 0xFF;
+
+	if(pCard->OutPos < pCard->OutLen)
+		miso = pCard->Out[pCard->OutPos++];
+	else if(sim_get_cycles() < pCard->BusyUntil)
+		miso = 0x00;
+	else if(pCard->State == DEMO_SD_READ)
+		miso = demo_sd_read(pCard);
+
+	if(pCard->State == DEMO_SD_WRITE)
+	{
+		demo_sd_write(pCard, in);
+	} else if(pCard->FrameLen != 0 || (in & 0xC0) == 0x40)
+	{
+		pCard->Frame[pCard->FrameLen++] = in;
+		if(pCard->FrameLen == sizeof(pCard->Frame))
+		{
+			pCard->FrameLen = 0;
+			if(pCard->State == DEMO_SD_READ && (pCard->Frame[0] & 0x3F) == SD_CMD_STOP_TRANSMISSION)
+			{
+				// stuff byte, R1, then a short busy
+				static const uint8_t stop[2] = { 0xFF, 0x00 };
+
+				pCard->State = DEMO_SD_CMD;
+				demo_sd_respond(pCard, stop, 2);
+				demo_sd_busy_for(pCard, 5);
+			} else
+			{
+				demo_sd_command(pCard);
+			}
+		}
+	}
+	return miso;
+}
+
+void DMA1_Stream3_IRQHandler(void)
+{
+	DMA_IRQHandling(&demo_spi2.RxDMA);
+}
+
+void DMA1_Stream4_IRQHandler(void)
+{
+	DMA_IRQHandling(&demo_spi2.TxDMA);
+}
+
+void Sd_ApplicationEventCallback(Sd_Handle_t *pSd, uint8_t AppEv)
+{
+	(void)pSd;
+	demo_sd_event = AppEv;
+}
+
+static uint8_t demo_sd_wait(uint8_t Started)
+{
+	if(Started != SD_OK)
+		return SD_EVENT_ERROR;
+	while(Sd_Busy(&demo_sd))
+	{
+		if(!Sched_RunOnce())
+			__WFI();
+	}
+	return demo_sd_event;
+}
+
+// share of the time the SPI clock was moving data bits
+static uint32_t demo_sd_efficiency(uint32_t Bytes, uint64_t Cycles)
+{
+	uint32_t sclk = RCC_GetPCLK1Value() >> (demo_spi2.SPIConfig.SPI_SclkSpeed + 1);
+
+	return (uint32_t)((uint64_t)Bytes * 8U * sim_get_hclk() / sclk * 100U / Cycles);
+}
+
+static int demo_sdcard(void)
+{
+	static demo_sd_t card;
+	static uint8_t data[64][SD_BLOCK_SIZE], buf[64][SD_BLOCK_SIZE];
+	GPIO_Handle_t cs;
+	Sd_Config_t config;
+	uint64_t start, cached, single;
+	uint32_t cmd25, errors;
+
+	memset(&card, 0, sizeof(card));
+	sim_spi_attach(SPI2, demo_sd_xfer, &card);
+	sim_gpio_watch(GPIOB, demo_sd_cs, &card);
+
+	memset(&cs, 0, sizeof(cs));
+	cs.pGPIOx = GPIOB;
+	cs.GPIO_PinConfig.GPIO_PinNumber = DEMO_SD_CS;
+	cs.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	cs.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	cs.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	GPIO_PeriClockControl(GPIOB, ENABLE);
+	GPIO_WriteToOutputPin(GPIOB, DEMO_SD_CS, SET);
+	GPIO_Init(&cs);
+
+	memset(&demo_spi2, 0, sizeof(demo_spi2));
+	demo_spi2.pSPIx = SPI2;
+	demo_spi2.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	demo_spi2.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	demo_spi2.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV256;
+	demo_spi2.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	demo_spi2.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI_Init(&demo_spi2);
+	SPI_SSIConfig(SPI2, ENABLE);
+	SPI_PeripheralControl(SPI2, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM3, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM4, ENABLE);
+	demo_tick(ENABLE);
+
+	memset(&config, 0, sizeof(config));
+	config.pSPIHandle = &demo_spi2;
+	config.pCSPort = GPIOB;
+	config.CSPin = DEMO_SD_CS;
+	config.Sd_Crc = ENABLE;
+	config.Sd_PollTicks = 1;
+	config.Sd_Priority = SCHED_PRI_HIGH;
+	config.Sd_TimeoutTicks = 500;
+
+	// nobody answers CMD0: the handle refuses to work
+	sim_spi_attach(SPI2, 0, 0);
+	if(Sd_Init(&demo_sd, &config) != SD_ERR_NO_CARD || demo_sd.Type != SD_TYPE_NONE ||
+	   Sd_Read(&demo_sd, 0, buf[0], 1) != SD_ERR_PARAM || Sd_Flush(&demo_sd) != SD_ERR_PARAM ||
+	   sim_gpio_get_pin(GPIOB, DEMO_SD_CS) != 1)
+	{
+		printf("SD card: missing card not reported\n");
+		return 1;
+	}
+	sim_spi_attach(SPI2, demo_sd_xfer, &card);
+
+	if(Sd_Init(&demo_sd, &config) != SD_OK || demo_sd.Type != SD_TYPE_SDHC || demo_sd.BlockCount != DEMO_SD_BLOCKS)
+	{
+		printf("SD card: init failed, type %u, %lu blocks\n", demo_sd.Type, (unsigned long)demo_sd.BlockCount);
+		return 1;
+	}
+
+	// a logger: one block at a time, through the cache
+	for(uint32_t i = 0; i < 64; i++)
+		for(uint32_t j = 0; j < SD_BLOCK_SIZE; j++)
+			data[i][j] = (uint8_t)(i * 31 + j);
+	start = sim_get_cycles();
+	for(uint32_t i = 0; i < 64; i++)
+	{
+		if(demo_sd_wait(Sd_Write(&demo_sd, 100 + i, data[i], 1)) != SD_EVENT_WRITE_CMPLT)
+			return 1;
+	}
+	if(demo_sd_wait(Sd_Flush(&demo_sd)) != SD_EVENT_FLUSH_CMPLT)
+		return 1;
+	cached = sim_get_cycles() - start;
+	cmd25 = card.Cmd25;
+
+	// the same, flushed after every block: one CMD24 each
+	start = sim_get_cycles();
+	for(uint32_t i = 0; i < 16; i++)
+	{
+		if(demo_sd_wait(Sd_Write(&demo_sd, 200 + i, data[i], 1)) != SD_EVENT_WRITE_CMPLT ||
+		   demo_sd_wait(Sd_Flush(&demo_sd)) != SD_EVENT_FLUSH_CMPLT)
+			return 1;
+	}
+	single = sim_get_cycles() - start;
+
+	// read back: one CMD18, and one CMD17
+	if(demo_sd_wait(Sd_Read(&demo_sd, 100, buf[0], 64)) != SD_EVENT_READ_CMPLT ||
+	   memcmp(buf, data, sizeof(data)) != 0 ||
+	   demo_sd_wait(Sd_Read(&demo_sd, 215, buf[0], 1)) != SD_EVENT_READ_CMPLT ||
+	   memcmp(buf[0], data[15], SD_BLOCK_SIZE) != 0 ||
+	   memcmp(card.Mem[100], data[0], SD_BLOCK_SIZE) != 0)
+	{
+		printf("SD card: read back failed\n");
+		return 1;
+	}
+	while(demo_spi2.RxState != SPI_READY)
+		__WFI();
+	errors = card.Errors;
+
+	// outside the card, empty, one operation at a time
+	if(Sd_Read(&demo_sd, DEMO_SD_BLOCKS, buf[0], 1) != SD_ERR_PARAM ||
+	   Sd_Write(&demo_sd, DEMO_SD_BLOCKS - 1, data[0], 2) != SD_ERR_PARAM ||
+	   Sd_Read(&demo_sd, 0, buf[0], 0) != SD_ERR_PARAM ||
+	   Sd_Read(&demo_sd, 100, buf[0], 8) != SD_OK ||
+	   Sd_Read(&demo_sd, 100, buf[8], 1) != SD_BUSY || Sd_Write(&demo_sd, 100, data[0], 1) != SD_BUSY ||
+	   demo_sd_wait(SD_OK) != SD_EVENT_READ_CMPLT)
+	{
+		printf("SD card: bad or overlapping request accepted\n");
+		return 1;
+	}
+
+	// a bit flipped on the wire, a data error token, no token at all: each
+	// fails the read with chip select released, the next read works
+	for(uint8_t fault = DEMO_SD_FAULT_DATA; fault <= DEMO_SD_FAULT_HANG; fault++)
+	{
+		uint32_t ticks = Sched_GetTicks();
+		uint8_t ev;
+
+		card.Fault = fault;
+		demo_sd.Config.Sd_TimeoutTicks = 10;
+		ev = demo_sd_wait(Sd_Read(&demo_sd, 101, buf[0], 1));
+		demo_sd.Config.Sd_TimeoutTicks = config.Sd_TimeoutTicks;
+		if(fault == DEMO_SD_FAULT_HANG)
+		{
+			// the card is reset
+			card.Fault = DEMO_SD_FAULT_NONE;
+			card.State = DEMO_SD_CMD;
+			ticks = Sched_GetTicks() - ticks;
+		}
+		if(ev != SD_EVENT_ERROR || sim_gpio_get_pin(GPIOB, DEMO_SD_CS) != 1 ||
+		   (fault == DEMO_SD_FAULT_HANG && ticks < 10))
+		{
+			printf("SD card: read fault %u not reported\n", fault);
+			return 1;
+		}
+		if(demo_sd_wait(Sd_Read(&demo_sd, 101, buf[0], 1)) != SD_EVENT_READ_CMPLT ||
+		   memcmp(buf[0], data[1], SD_BLOCK_SIZE) != 0)
+		{
+			printf("SD card: no recovery from read fault %u\n", fault);
+			return 1;
+		}
+	}
+
+	// a block rejected by the card stays cached, the next flush writes it
+	if(demo_sd_wait(Sd_Write(&demo_sd, 250, data[5], 1)) != SD_EVENT_WRITE_CMPLT)
+		return 1;
+	card.Fault = DEMO_SD_FAULT_DATA;
+	if(demo_sd_wait(Sd_Flush(&demo_sd)) != SD_EVENT_ERROR || card.Errors != errors + 1 ||
+	   demo_sd.CacheCount != 1 || memcmp(card.Mem[250], data[5], SD_BLOCK_SIZE) == 0 ||
+	   demo_sd_wait(Sd_Flush(&demo_sd)) != SD_EVENT_FLUSH_CMPLT || demo_sd.CacheCount != 0 ||
+	   memcmp(card.Mem[250], data[5], SD_BLOCK_SIZE) != 0)
+	{
+		printf("SD card: rejected block lost\n");
+		return 1;
+	}
+	while(demo_spi2.RxState != SPI_READY)
+		__WFI();
+
+	demo_tick(DISABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM3, DISABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA1_STREAM4, DISABLE);
+
+	if(errors != 0 || cmd25 != 64 / SD_CACHE_BLOCKS || card.Cmd24 != 16 + 2 || card.Cmd18 != 2 || card.Cmd17 != 1 + 6)
+	{
+		printf("SD card: %lu CRC errors, %lu CMD25, %lu CMD24\n",
+				(unsigned long)errors, (unsigned long)cmd25, (unsigned long)card.Cmd24);
+		return 1;
+	}
+
+	printf("SD card: SDHC %lu MB, 64 one block writes as %lu CMD25 at %lu%% of the SPI clock "
+			"(%lu%% with a CMD24 each), CRC checked, read back by CMD18; missing card, bad requests, "
+			"corrupt data, error token, timeout and rejected block reported\n",
+			(unsigned long)(demo_sd.BlockCount >> 11), (unsigned long)cmd25,
+			(unsigned long)demo_sd_efficiency(64 * SD_BLOCK_SIZE, cached),
+			(unsigned long)demo_sd_efficiency(16 * SD_BLOCK_SIZE, single));
+	return 0;
+}
+
+/*
+ * ST7789 with a 240x135 panel on SPI1 (the flash's bus, its chip select
+ * stays high), chip select PC4, data/command PC5: the MIPI DCS commands
+ * the driver uses and the controller RAM behind them, in landscape
+ * (MADCTL MV: 320 columns, 240 rows).
+ */
+#define DEMO_LCD_CS			GPIO_PIN_NO_4
+#define DEMO_LCD_DC			GPIO_PIN_NO_5
+#define DEMO_LCD_W			240
+#define DEMO_LCD_H			135
+#define DEMO_LCD_XOFF		40
+#define DEMO_LCD_YOFF		53
+
+typedef struct
+{
+	uint16_t Gram[240][320];
+	uint8_t Cmd;
+	uint8_t Args[4];
+	uint8_t ArgCount;
+	uint16_t Xs, Xe, Ys, Ye;
+	uint16_t X, Y;
+	uint8_t Hi;
+	uint8_t HaveHi;
+	uint8_t SleepOut;
+	uint8_t Colmod;
+	uint8_t Madctl;
+	uint8_t DisplayOn;
+	uint32_t Windows;
+	uint32_t Errors;				// pixels outside the window
+} demo_panel_t;
+
+static volatile uint8_t demo_lcd_event;
+
+// Lcd_ST7789Init turned to landscape: MADCTL MV and MX
+static const uint8_t demo_lcd_init[] =
+{
+	7,
+	LCD_CMD_SWRESET, LCD_INIT_DELAY, 150,
+	LCD_CMD_SLPOUT, LCD_INIT_DELAY, 10,
+	LCD_CMD_COLMOD, 1 | LCD_INIT_DELAY, 0x55, 10,
+	LCD_CMD_MADCTL, 1, 0x60,
+	LCD_CMD_INVON, LCD_INIT_DELAY, 10,
+	LCD_CMD_NORON, LCD_INIT_DELAY, 10,
+	LCD_CMD_DISPON, LCD_INIT_DELAY, 10,
+};
+
+static void demo_panel_byte(demo_panel_t *pPanel, uint8_t Dc, uint8_t Byte)
+{
+	if(!Dc)
+	{
+		if(Byte == LCD_CMD_NOP)
+			return;
+		pPanel->Cmd = Byte;
+		pPanel->ArgCount = 0;
+		pPanel->HaveHi = 0;
+		if(Byte == LCD_CMD_SLPOUT)
+			pPanel->SleepOut = 1;
+		else if(Byte == LCD_CMD_DISPON)
+			pPanel->DisplayOn = 1;
+		else if(Byte == LCD_CMD_RAMWR)
+		{
+			pPanel->X = pPanel->Xs;
+			pPanel->Y = pPanel->Ys;
+			pPanel->Windows++;
+		}
+		return;
+	}
+
+	switch(pPanel->Cmd)
+	{
+	case LCD_CMD_CASET:
+	case LCD_CMD_RASET:
+		if(pPanel->ArgCount < 4)
+			pPanel->Args[pPanel->ArgCount++] = Byte;
+		if(pPanel->ArgCount == 4 && pPanel->Cmd == LCD_CMD_CASET)
+		{
+			pPanel->Xs = (uint16_t)(pPanel->Args[0] << 8 | pPanel->Args[1]);
+			pPanel->Xe = (uint16_t)(pPanel->Args[2] << 8 | pPanel->Args[3]);
+		} else if(pPanel->ArgCount == 4)
+		{
+			pPanel->Ys = (uint16_t)(pPanel->Args[0] << 8 | pPanel->Args[1]);
+			pPanel->Ye = (uint16_t)(pPanel->Args[2] << 8 | pPanel->Args[3]);
+		}
+		break;
+	case LCD_CMD_COLMOD:
+		pPanel->Colmod = Byte;
+		break;
+	case LCD_CMD_MADCTL:
+		pPanel->Madctl = Byte;
+		break;
+	case LCD_CMD_RAMWR:
+		if(!pPanel->HaveHi)
+		{
+			pPanel->Hi = Byte;
+			pPanel->HaveHi = 1;
+			break;
+		}
+		pPanel->HaveHi = 0;
+		if(pPanel->Y > pPanel->Ye || pPanel->Y >= 240 || pPanel->X >= 320)
+		{
+			pPanel->Errors++;
+			break;
+		}
+		pPanel->Gram[pPanel->Y][pPanel->X] = (uint16_t)(pPanel->Hi << 8 | Byte);
+		if(++pPanel->X > pPanel->Xe)
+		{
+			pPanel->X = pPanel->Xs;
+			pPanel->Y++;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+// a 16 bit frame is two bytes for the panel, MSB first
+static uint16_t demo_panel_xfer(void *pContext, uint16_t Mosi)
+{
+	demo_panel_t *pPanel = (demo_panel_t*)pContext;
+	uint8_t dc = sim_gpio_get_pin(GPIOC, DEMO_LCD_DC);
+
+	if(sim_gpio_get_pin(GPIOC, DEMO_LCD_CS))
+		return 0xFF;
+	if(demo_spi1.SPIConfig.SPI_DFF == SPI_DFF_16BITS)
+		demo_panel_byte(pPanel, dc, (uint8_t)(Mosi >> 8));
+	demo_panel_byte(pPanel, dc, (uint8_t)Mosi);
+	return 0xFF;
+}
+
+void Lcd_ApplicationEventCallback(Lcd_Handle_t *pLcd, uint8_t AppEv)
+{
+	(void)pLcd;
+	demo_lcd_event = AppEv;
+}
+
+static uint8_t demo_lcd_wait(uint8_t Started)
+{
+	if(Started != LCD_OK)
+		return LCD_EVENT_ERROR;
+	while(Lcd_Busy(&demo_lcd))
+	{
+		if(!Sched_RunOnce())
+			__WFI();
+	}
+	return demo_lcd_event;
+}
+
+// the visible part of the controller RAM against the framebuffer
+static uint8_t demo_panel_matches(demo_panel_t *pPanel, uint16_t (*pFrame)[DEMO_LCD_W])
+{
+	for(uint32_t y = 0; y < DEMO_LCD_H; y++)
+	{
+		if(memcmp(&pPanel->Gram[y + DEMO_LCD_YOFF][DEMO_LCD_XOFF], pFrame[y], DEMO_LCD_W * sizeof(uint16_t)) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+static uint32_t demo_us(uint64_t Cycles)
+{
+	return (uint32_t)(Cycles / (sim_get_hclk() / 1000000U));
+}
+
+static int demo_display(void)
+{
+	static demo_panel_t panel;
+	static uint16_t frame[DEMO_LCD_H][DEMO_LCD_W];
+	static Lcd_Handle_t unused;
+	GPIO_Handle_t pin;
+	Lcd_Config_t config, bad;
+	uint64_t start, full, widgets;
+	uint32_t pixels, rects, sent;
+
+	memset(&panel, 0, sizeof(panel));
+	sim_spi_attach(SPI1, demo_panel_xfer, &panel);
+
+	memset(&pin, 0, sizeof(pin));
+	pin.pGPIOx = GPIOC;
+	pin.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	pin.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	pin.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	GPIO_PeriClockControl(GPIOC, ENABLE);
+	GPIO_WriteToOutputPin(GPIOC, DEMO_LCD_CS, SET);
+	pin.GPIO_PinConfig.GPIO_PinNumber = DEMO_LCD_CS;
+	GPIO_Init(&pin);
+	pin.GPIO_PinConfig.GPIO_PinNumber = DEMO_LCD_DC;
+	GPIO_Init(&pin);
+
+	memset(&demo_spi1, 0, sizeof(demo_spi1));
+	demo_spi1.pSPIx = SPI1;
+	demo_spi1.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	demo_spi1.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	demo_spi1.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV2;
+	demo_spi1.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	demo_spi1.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI_Init(&demo_spi1);
+	SPI_SSIConfig(SPI1, ENABLE);
+	SPI_PeripheralControl(SPI1, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM0, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM3, ENABLE);
+	demo_tick(ENABLE);
+
+	memset(&config, 0, sizeof(config));
+	config.pSPIHandle = &demo_spi1;
+	config.pCSPort = GPIOC;
+	config.CSPin = DEMO_LCD_CS;
+	config.pDCPort = GPIOC;
+	config.DCPin = DEMO_LCD_DC;
+	config.pFrameBuffer = &frame[0][0];
+	config.Width = DEMO_LCD_W;
+	config.Height = DEMO_LCD_H;
+	config.XOffset = DEMO_LCD_XOFF;
+	config.YOffset = DEMO_LCD_YOFF;
+	config.pInitSeq = demo_lcd_init;
+	config.Lcd_MsPerTick = 1;
+	config.Lcd_Priority = SCHED_PRI_HIGH;
+
+	// no framebuffer, rows wider than a staging buffer, no Lcd_Init
+	bad = config;
+	bad.pFrameBuffer = 0;
+	if(Lcd_Init(&demo_lcd, &bad) != LCD_ERR_PARAM)
+		return 1;
+	bad = config;
+	bad.Width = LCD_STAGE_PIXELS + 1;
+	memset(&unused, 0, sizeof(unused));
+	if(Lcd_Init(&demo_lcd, &bad) != LCD_ERR_PARAM || Lcd_Flush(&unused) != LCD_ERR_PARAM)
+	{
+		printf("LCD: bad configuration accepted\n");
+		return 1;
+	}
+
+	if(Lcd_Init(&demo_lcd, &config) != LCD_OK || Lcd_Flush(&demo_lcd) != LCD_BUSY ||
+	   demo_lcd_wait(LCD_OK) != LCD_EVENT_INIT_CMPLT ||
+	   !panel.SleepOut || panel.Colmod != 0x55 || panel.Madctl != 0x60 || !panel.DisplayOn)
+	{
+		printf("LCD: init failed, sleep out %u, COLMOD 0x%02X, display on %u\n",
+				panel.SleepOut, panel.Colmod, panel.DisplayOn);
+		return 1;
+	}
+
+	// the whole frame once
+	for(uint32_t y = 0; y < DEMO_LCD_H; y++)
+		for(uint32_t x = 0; x < DEMO_LCD_W; x++)
+			frame[y][x] = LCD_RGB565(x, y * 2, 255 - x);
+	Lcd_Invalidate(&demo_lcd, 0, 0, DEMO_LCD_W, DEMO_LCD_H);
+	start = sim_get_cycles();
+	if(demo_lcd_wait(Lcd_Flush(&demo_lcd)) != LCD_EVENT_FLUSH_CMPLT || !demo_panel_matches(&panel, frame))
+	{
+		printf("LCD: full frame flush failed\n");
+		return 1;
+	}
+	full = sim_get_cycles() - start;
+
+	// widgets: two counter digits (side by side: one window), a progress
+	// bar step and a blinking icon, 8 updates
+	pixels = demo_lcd.PixelsSent;
+	rects = demo_lcd.RectsSent;
+	start = sim_get_cycles();
+	for(uint32_t i = 0; i < 8; i++)
+	{
+		Lcd_FillRect(&demo_lcd, 10, 10, 12, 20, (uint16_t)(LCD_WHITE - i));
+		Lcd_FillRect(&demo_lcd, 22, 10, 12, 20, (uint16_t)(LCD_BLUE + i));
+		Lcd_FillRect(&demo_lcd, (uint16_t)(20 + i * 4), 110, 4, 8, LCD_GREEN);
+		Lcd_FillRect(&demo_lcd, 220, 4, 16, 16, (i & 1) ? LCD_RED : LCD_BLACK);
+		if(demo_lcd_wait(Lcd_Flush(&demo_lcd)) != LCD_EVENT_FLUSH_CMPLT)
+			return 1;
+	}
+	widgets = (sim_get_cycles() - start) / 8;
+	pixels = (demo_lcd.PixelsSent - pixels) / 8;
+	rects = demo_lcd.RectsSent - rects;
+	if(!demo_panel_matches(&panel, frame) || panel.Errors != 0 || rects != 8 * 3)
+	{
+		printf("LCD: controller RAM differs, %lu pixels outside the window, %lu windows\n",
+				(unsigned long)panel.Errors, (unsigned long)rects);
+		return 1;
+	}
+
+	// A rectangle narrower than the panel and larger than both staging
+	// buffers, with a square drawn into it during the flush: the square
+	// goes again with the next one.
+	for(uint32_t y = 10; y < 110; y++)
+		for(uint32_t x = 20; x < 220; x++)
+			frame[y][x] = (uint16_t)(x * 3 + y * 7);
+	Lcd_Invalidate(&demo_lcd, 20, 10, 200, 100);
+	if(Lcd_Flush(&demo_lcd) != LCD_OK || !Lcd_Busy(&demo_lcd))
+		return 1;
+	Lcd_FillRect(&demo_lcd, 100, 50, 20, 20, LCD_RED);
+	if(demo_lcd_wait(LCD_OK) != LCD_EVENT_FLUSH_CMPLT || demo_lcd.DirtyCount != 1 ||
+	   demo_lcd_wait(Lcd_Flush(&demo_lcd)) != LCD_EVENT_FLUSH_CMPLT || !demo_panel_matches(&panel, frame))
+	{
+		printf("LCD: staged rectangle or drawing during a flush lost\n");
+		return 1;
+	}
+
+	// clipped to the panel: 10x5 pixels sent, nothing for the others
+	sent = demo_lcd.PixelsSent;
+	Lcd_FillRect(&demo_lcd, DEMO_LCD_W - 10, DEMO_LCD_H - 5, 50, 50, LCD_WHITE);
+	Lcd_Invalidate(&demo_lcd, DEMO_LCD_W, 0, 10, 10);
+	Lcd_Invalidate(&demo_lcd, 0, DEMO_LCD_H, 10, 10);
+	Lcd_Invalidate(&demo_lcd, 0, 0, 0, 10);
+	if(demo_lcd.DirtyCount != 1 || demo_lcd_wait(Lcd_Flush(&demo_lcd)) != LCD_EVENT_FLUSH_CMPLT ||
+	   demo_lcd.PixelsSent - sent != 10 * 5 || !demo_panel_matches(&panel, frame))
+	{
+		printf("LCD: clipping failed, %lu pixels sent\n", (unsigned long)(demo_lcd.PixelsSent - sent));
+		return 1;
+	}
+
+	// more scattered changes than dirty rectangles
+	for(uint32_t i = 0; i < 12; i++)
+		Lcd_FillRect(&demo_lcd, (uint16_t)((i % 4) * 60 + 5), (uint16_t)((i / 4) * 45 + 5), 8, 8, (uint16_t)(LCD_GREEN + i));
+	if(demo_lcd.DirtyCount > LCD_MAX_DIRTY || demo_lcd_wait(Lcd_Flush(&demo_lcd)) != LCD_EVENT_FLUSH_CMPLT ||
+	   !demo_panel_matches(&panel, frame))
+	{
+		printf("LCD: changes lost with a full dirty list\n");
+		return 1;
+	}
+
+	// the SPI taken by someone else: the flush fails, its rectangles stay dirty
+	demo_spi1.TxState = SPI_BUSY_IN_TX;
+	Lcd_FillRect(&demo_lcd, 5, 120, 30, 10, LCD_BLUE);
+	if(demo_lcd_wait(Lcd_Flush(&demo_lcd)) != LCD_EVENT_ERROR || demo_lcd.DirtyCount != 1 ||
+	   sim_gpio_get_pin(GPIOC, DEMO_LCD_CS) != 1)
+	{
+		printf("LCD: SPI busy not reported\n");
+		return 1;
+	}
+	demo_spi1.TxState = SPI_READY;
+	if(demo_lcd_wait(Lcd_Flush(&demo_lcd)) != LCD_EVENT_FLUSH_CMPLT || !demo_panel_matches(&panel, frame) ||
+	   panel.Errors != 0)
+	{
+		printf("LCD: no recovery after an SPI error\n");
+		return 1;
+	}
+
+	demo_tick(DISABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM0, DISABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM3, DISABLE);
+
+	printf("LCD: ST7789 240x135 in 16 bit frames, full frame %lu us, widget update %lu us "
+			"(%lu pixels, %lu%% of the frame, 3 windows), controller RAM matches after staged, clipped, "
+			"concurrent and failed flushes\n",
+			(unsigned long)demo_us(full), (unsigned long)demo_us(widgets), (unsigned long)pixels,
+			(unsigned long)(pixels * 100U / (DEMO_LCD_W * DEMO_LCD_H)));
+	return 0;
+}
+
+/*
+ * Software SPI: a shift register slave on the GPIOE pins (SCK PE2, MOSI PE3
+ * or PC6, MISO PE4), which answers each byte with the previous one.
+ */
+#define DEMO_SOFT_SCK		GPIO_PIN_NO_2
+#define DEMO_SOFT_MOSI		GPIO_PIN_NO_3
+#define DEMO_SOFT_MISO		GPIO_PIN_NO_4
+#define DEMO_SOFT_MOSI_C	GPIO_PIN_NO_6
+#define DEMO_SOFT_LEN		64
+
+typedef struct
+{
+	uint8_t Cpol;
+	uint8_t Cpha;
+	GPIO_RegDef_t *pMosiPort;
+	uint8_t MosiPin;
+	uint8_t Out;					/* byte being shifted out */
+	uint8_t In;
+	uint8_t Bits;					/* of the current byte */
+	uint8_t Data[DEMO_LEN];
+	uint32_t Count;
+} demo_shift_slave_t;
+
+static void demo_shift_edge(void *pContext, uint16_t OldIdr, uint16_t NewIdr)
+{
+	demo_shift_slave_t *pSlave = (demo_shift_slave_t*)pContext;
+	uint8_t sck = (NewIdr >> DEMO_SOFT_SCK) & 1;
+	uint8_t leading = (sck != pSlave->Cpol);
+
+	if(((OldIdr ^ NewIdr) & (1 << DEMO_SOFT_SCK)) == 0)
+		return;
+
+	// CPHA 0 samples on the leading edge, CPHA 1 on the trailing one; the
+	// other edge shifts the next bit out
+	if(leading == (pSlave->Cpha == SPI_CPHA_LOW))
+	{
+		pSlave->In = (uint8_t)((pSlave->In << 1) | sim_gpio_get_pin(pSlave->pMosiPort, pSlave->MosiPin));
+		if(++pSlave->Bits == 8)
+		{
+			if(pSlave->Count < DEMO_LEN)
+				pSlave->Data[pSlave->Count++] = pSlave->In;
+			pSlave->Out = pSlave->In;
+			pSlave->Bits = 0;
+		}
+	} else
+	{
+		sim_gpio_set_input(GPIOE, DEMO_SOFT_MISO, (pSlave->Out >> (7 - pSlave->Bits)) & 1);
+	}
+}
+
+static void demo_shift_reset(demo_shift_slave_t *pSlave, uint8_t Cpol, uint8_t Cpha, GPIO_RegDef_t *pMosiPort, uint8_t MosiPin)
+{
+	memset(pSlave, 0, sizeof(*pSlave));
+	pSlave->Cpol = Cpol;
+	pSlave->Cpha = Cpha;
+	pSlave->pMosiPort = pMosiPort;
+	pSlave->MosiPin = MosiPin;
+	pSlave->Out = 0xA5;
+	sim_gpio_set_input(GPIOE, DEMO_SOFT_MISO, 1);
+}
+
+static void demo_softspi_config(SoftSpi_Config_t *pConfig, uint8_t Mode, GPIO_RegDef_t *pMosiPort, uint8_t MosiPin)
+{
+	memset(pConfig, 0, sizeof(*pConfig));
+	pConfig->pSckPort = GPIOE;
+	pConfig->SckPin = DEMO_SOFT_SCK;
+	pConfig->pMosiPort = pMosiPort;
+	pConfig->MosiPin = MosiPin;
+	pConfig->pMisoPort = GPIOE;
+	pConfig->MisoPin = DEMO_SOFT_MISO;
+	pConfig->SoftSpi_CPOL = (Mode >> 1) & 1;
+	pConfig->SoftSpi_CPHA = Mode & 1;
+}
+
+static double demo_mbps(uint32_t Bytes, uint64_t Cycles)
+{
+	return (double)Bytes * 8 * sim_get_hclk() / Cycles / 1e6;
+}
+
+void DMA2_Stream5_IRQHandler(void)
+{
+	DMA_IRQHandling(&demo_tim1.UpDMA);
+}
+
+static int demo_softspi_run(uint8_t Mode, GPIO_RegDef_t *pMosiPort, uint8_t MosiPin, const uint8_t *pTx, uint64_t *pCycles)
+{
+	static demo_shift_slave_t slave;
+	SoftSpi_Config_t config;
+	uint8_t rx[DEMO_SOFT_LEN];
+	uint64_t start;
+
+	demo_softspi_config(&config, Mode, pMosiPort, MosiPin);
+	SoftSpi_Init(&demo_soft, &config);
+	demo_shift_reset(&slave, config.SoftSpi_CPOL, config.SoftSpi_CPHA, pMosiPort, MosiPin);
+	sim_gpio_watch(GPIOE, demo_shift_edge, &slave);
+
+	start = sim_get_cycles();
+	SoftSpi_Transfer(&demo_soft, pTx, rx, DEMO_SOFT_LEN);
+	*pCycles = sim_get_cycles() - start;
+
+	sim_gpio_watch(GPIOE, 0, 0);
+	if(slave.Count != DEMO_SOFT_LEN || memcmp(slave.Data, pTx, DEMO_SOFT_LEN) != 0 ||
+	   rx[0] != 0xA5 || memcmp(&rx[1], pTx, DEMO_SOFT_LEN - 1) != 0 ||
+	   sim_gpio_get_pin(GPIOE, DEMO_SOFT_SCK) != config.SoftSpi_CPOL)
+	{
+		printf("Soft SPI: mode %u (MOSI on GPIO%c) failed, slave got %lu bytes\n", Mode,
+				(pMosiPort == GPIOE) ? 'E' : 'C', (unsigned long)slave.Count);
+		return 1;
+	}
+	return 0;
+}
+
+static int demo_softspi(void)
+{
+	static demo_shift_slave_t slave;
+	static demo_slave_t hw;
+	static uint32_t words[SOFTSPI_DMA_WORDS(DEMO_SOFT_LEN / 4)];
+	SoftSpi_Config_t config;
+	SPI_Handle_t spi2;
+	uint8_t tx[DEMO_SOFT_LEN];
+	uint64_t one, two, dma, spi, start;
+
+	for(uint32_t i = 0; i < DEMO_SOFT_LEN; i++)
+		tx[i] = (uint8_t)(i * 29 + 3);
+
+	for(uint8_t mode = 0; mode < 4; mode++)
+	{
+		if(demo_softspi_run(mode, GPIOE, DEMO_SOFT_MOSI, tx, &one) ||
+		   demo_softspi_run(mode, GPIOC, DEMO_SOFT_MOSI_C, tx, &two))
+			return 1;
+	}
+
+	// background: TIM1 update DMA into GPIOE BSRR, 4 ticks per half period,
+	// the transfer in four pieces of the buffer
+	memset(&demo_tim1, 0, sizeof(demo_tim1));
+	demo_tim1.pTIMx = TIM1;
+	demo_tim1.TIM_Config.TIM_Prescaler = 0;
+	demo_tim1.TIM_Config.TIM_Period = 3;
+	demo_tim1.TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+	TIM_Init(&demo_tim1);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM5, ENABLE);
+
+	demo_softspi_config(&config, 0, GPIOE, DEMO_SOFT_MOSI);
+	config.pTIMHandle = &demo_tim1;
+	config.pDMABuffer = words;
+	config.DMABufferWords = sizeof(words) / sizeof(words[0]);
+	SoftSpi_Init(&demo_soft, &config);
+	demo_shift_reset(&slave, SPI_CPOL_LOW, SPI_CPHA_LOW, GPIOE, DEMO_SOFT_MOSI);
+	sim_gpio_watch(GPIOE, demo_shift_edge, &slave);
+
+	start = sim_get_cycles();
+	if(SoftSpi_SendDMA(&demo_soft, tx, DEMO_SOFT_LEN) != SOFTSPI_OK)
+	{
+		printf("Soft SPI: DMA transfer not started\n");
+		return 1;
+	}
+	while(SoftSpi_Busy(&demo_soft))
+		__WFI();
+	dma = sim_get_cycles() - start;
+
+	sim_gpio_watch(GPIOE, 0, 0);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM5, DISABLE);
+	if(slave.Count != DEMO_SOFT_LEN || memcmp(slave.Data, tx, DEMO_SOFT_LEN) != 0 ||
+	   sim_gpio_get_pin(GPIOE, DEMO_SOFT_SCK) != 0)
+	{
+		printf("Soft SPI: DMA transfer failed, slave got %lu bytes\n", (unsigned long)slave.Count);
+		return 1;
+	}
+
+	// the hardware SPI at its fastest, same bytes
+	memset(&hw, 0, sizeof(hw));
+	sim_spi_attach(SPI2, demo_slave_xfer, &hw);
+	memset(&spi2, 0, sizeof(spi2));
+	spi2.pSPIx = SPI2;
+	spi2.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	spi2.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	spi2.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV2;
+	spi2.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	spi2.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI_DeInit(SPI2);
+	SPI_Init(&spi2);
+	SPI_SSIConfig(SPI2, ENABLE);
+	SPI_PeripheralControl(SPI2, ENABLE);
+	start = sim_get_cycles();
+	SPI_SendData(SPI2, tx, DEMO_SOFT_LEN);
+	while(SPI_GetFlagStatus(SPI2, SPI_BUSY_FLAG));
+	spi = sim_get_cycles() - start;
+	SPI_PeripheralControl(SPI2, DISABLE);
+
+	printf("Soft SPI: modes 0-3 ok, %.2f Mbit/s (SCK and MOSI on one port), %.2f Mbit/s (two ports), "
+			"%.2f Mbit/s timer+DMA, hardware SPI2 DIV2 %.2f Mbit/s\n",
+			demo_mbps(DEMO_SOFT_LEN, one), demo_mbps(DEMO_SOFT_LEN, two),
+			demo_mbps(DEMO_SOFT_LEN, dma), demo_mbps(DEMO_SOFT_LEN, spi));
+	return 0;
+}
+
+/*
+ * Pattern generator on PE8..PE11 from TIM8: the pin changes are logged with
+ * their cycle count, to check the order and the step period.
+ */
+#define DEMO_PAT_SHIFT		8
+#define DEMO_PAT_LOG		512
+#define DEMO_PAT_STREAM		32
+
+typedef struct
+{
+	uint8_t Levels[DEMO_PAT_LOG];
+	uint64_t Cycle[DEMO_PAT_LOG];
+	uint32_t Count;
+} demo_pat_log_t;
+
+static demo_pat_log_t demo_pat_log;
+static uint32_t demo_pat_stream[2][DEMO_PAT_STREAM];
+static uint32_t demo_pat_next;			// next stream step to fill
+
+static void demo_pat_watch(void *pContext, uint16_t OldIdr, uint16_t NewIdr)
+{
+	demo_pat_log_t *pLog = (demo_pat_log_t*)pContext;
+
+	if(((OldIdr ^ NewIdr) >> DEMO_PAT_SHIFT & 0xF) == 0 || pLog->Count >= DEMO_PAT_LOG)
+		return;
+	pLog->Levels[pLog->Count] = (NewIdr >> DEMO_PAT_SHIFT) & 0xF;
+	pLog->Cycle[pLog->Count++] = sim_get_cycles();
+}
+
+static uint16_t demo_gray(uint32_t Step)
+{
+	Step &= 0xF;
+	return (uint16_t)((Step ^ (Step >> 1)) << DEMO_PAT_SHIFT);
+}
+
+static void demo_pat_refill(uint32_t *pWords)
+{
+	for(uint32_t i = 0; i < DEMO_PAT_STREAM; i++)
+		pWords[i] = Pattern_Word(&demo_pattern, demo_gray(demo_pat_next++));
+}
+
+void Pattern_ApplicationEventCallback(Pattern_Handle_t *pPattern, uint8_t AppEv)
+{
+	if(AppEv != PATTERN_EVENT_BUFFER0_FREE && AppEv != PATTERN_EVENT_BUFFER1_FREE)
+		return;
+	if(pPattern->Buffers >= 8)
+		Pattern_Stop(pPattern);
+	else
+		demo_pat_refill(demo_pat_stream[AppEv - PATTERN_EVENT_BUFFER0_FREE]);
+}
+
+static uint32_t demo_pat_irqs;
+
+void DMA2_Stream1_IRQHandler(void)
+{
+	demo_pat_irqs++;
+	DMA_IRQHandling(&demo_tim8.UpDMA);
+}
+
+// logged levels follow Expected from step First on
+static uint8_t demo_pat_check(const uint8_t *pExpected, uint32_t Period, uint32_t First, uint32_t Count)
+{
+	for(uint32_t i = 0; i < demo_pat_log.Count; i++)
+	{
+		if(demo_pat_log.Levels[i] != pExpected[(First + i) % Period])
+			return 0;
+	}
+	return demo_pat_log.Count >= Count;
+}
+
+static void demo_pat_reset(uint16_t Levels)
+{
+	GPIOE->BSRR = Pattern_Word(&demo_pattern, Levels);
+	memset(&demo_pat_log, 0, sizeof(demo_pat_log));
+}
+
+static int demo_patterngen(void)
+{
+	static const uint8_t stepper[4] = { 0x3, 0x6, 0xC, 0x9 };
+	static uint32_t words[16];
+	uint8_t gray[16];
+	Pattern_Config_t config;
+	uint16_t levels[16];
+	uint32_t circular;
+	double period;
+
+	memset(&demo_tim8, 0, sizeof(demo_tim8));
+	demo_tim8.pTIMx = TIM8;
+	memset(&config, 0, sizeof(config));
+	config.pTIMHandle = &demo_tim8;
+	config.pGPIOx = GPIOE;
+	config.PinMask = 0xF << DEMO_PAT_SHIFT;
+	config.Pattern_StepHz = 1000000;
+	if(Pattern_Init(&demo_pattern, &config) != PATTERN_OK)
+	{
+		printf("Pattern: init failed\n");
+		return 1;
+	}
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM1, ENABLE);
+	sim_gpio_watch(GPIOE, demo_pat_watch, &demo_pat_log);
+
+	// one shot: a Gray code sequence, one pin changes per step
+	for(uint32_t i = 0; i < 16; i++)
+	{
+		levels[i] = demo_gray(i + 1);
+		gray[i] = (uint8_t)(demo_gray(i) >> DEMO_PAT_SHIFT);
+	}
+	Pattern_Fill(&demo_pattern, words, levels, 16);
+	demo_pat_reset(demo_gray(0));
+	if(Pattern_Start(&demo_pattern, words, 16, PATTERN_MODE_ONESHOT) != PATTERN_OK)
+		return 1;
+	while(Pattern_Busy(&demo_pattern))
+		__WFI();
+	if(!demo_pat_check(gray, 16, 1, 16))
+	{
+		printf("Pattern: one shot sent %lu steps out of order\n", (unsigned long)demo_pat_log.Count);
+		return 1;
+	}
+
+	// circular: a full step stepper sequence, stopped after 100 steps
+	for(uint32_t i = 0; i < 4; i++)
+		levels[i] = (uint16_t)(stepper[i] << DEMO_PAT_SHIFT);
+	Pattern_Fill(&demo_pattern, words, levels, 4);
+	demo_pat_reset(levels[3]);
+	demo_pat_irqs = 0;
+	if(Pattern_Start(&demo_pattern, words, 4, PATTERN_MODE_CIRCULAR) != PATTERN_OK)
+		return 1;
+	while(demo_pat_log.Count < 100)
+		__WFI();
+	Pattern_Stop(&demo_pattern);
+	circular = demo_pat_log.Count;
+	if(!demo_pat_check(stepper, 4, 0, 100))
+	{
+		printf("Pattern: stepper sequence broken after %lu steps\n", (unsigned long)demo_pat_log.Count);
+		return 1;
+	}
+	// the CPU is not involved
+	if(demo_pat_irqs != 0)
+	{
+		printf("Pattern: %lu DMA interrupts in circular mode\n", (unsigned long)demo_pat_irqs);
+		return 1;
+	}
+
+	// stream: the Gray code from two buffers refilled in the callback
+	demo_pat_reset(demo_gray(0));
+	demo_pat_next = 1;
+	demo_pat_refill(demo_pat_stream[0]);
+	demo_pat_refill(demo_pat_stream[1]);
+	if(Pattern_StartStream(&demo_pattern, demo_pat_stream[0], demo_pat_stream[1], DEMO_PAT_STREAM) != PATTERN_OK)
+		return 1;
+	while(Pattern_Busy(&demo_pattern))
+		__WFI();
+
+	sim_gpio_watch(GPIOE, 0, 0);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM1, DISABLE);
+	// the log sees the pins when the simulator catches up, the average
+	// over the stream is exact
+	period = (double)(demo_pat_log.Cycle[demo_pat_log.Count - 1] - demo_pat_log.Cycle[0]) / (demo_pat_log.Count - 1);
+	if(!demo_pat_check(gray, 16, 1, 8 * DEMO_PAT_STREAM) || period > 1.01 * sim_get_hclk() / demo_pattern.StepHz)
+	{
+		printf("Pattern: stream broken after %lu steps\n", (unsigned long)demo_pat_log.Count);
+		return 1;
+	}
+
+	printf("Pattern: 4 pins at %lu kHz from TIM8 DMA, one shot 16 steps, circular stepper %lu steps, "
+			"stream of %lu steps from 2 x %u words at %.2f cycles per step, no gaps\n",
+			(unsigned long)(demo_pattern.StepHz / 1000U), (unsigned long)circular,
+			(unsigned long)demo_pat_log.Count, DEMO_PAT_STREAM, period);
+	return 0;
+}
+
+/*
+ * Logic analyzer: TIM1 samples GPIOE at 1 MHz while the pattern generator
+ * runs the Gray code on PE8..PE11 at 250 kHz, trigger on code 10.
+ */
+#define DEMO_LOGIC_LEN		256
+
+static int demo_logic_capture(void)
+{
+	static uint16_t samples[DEMO_LOGIC_LEN];
+	static uint32_t words[16];
+	static Logic_Run_t runs[DEMO_LOGIC_LEN];
+	Pattern_Config_t pattern;
+	Logic_Config_t config;
+	uint16_t levels[16], code, trig = demo_gray(10);
+	uint32_t n;
+
+	memset(&pattern, 0, sizeof(pattern));
+	pattern.pTIMHandle = &demo_tim8;
+	pattern.pGPIOx = GPIOE;
+	pattern.PinMask = 0xF << DEMO_PAT_SHIFT;
+	pattern.Pattern_StepHz = 250000;
+	memset(&config, 0, sizeof(config));
+	config.pTIMHandle = &demo_tim1;
+	config.pGPIOx = GPIOE;
+	config.PinMask = 0xF << DEMO_PAT_SHIFT;
+	config.Logic_SampleHz = 1000000;
+	config.pBuffer = samples;
+	config.BufferLen = DEMO_LOGIC_LEN;
+	config.Logic_Trigger = LOGIC_TRIGGER_PATTERN;
+	config.TrigMask = 0xF << DEMO_PAT_SHIFT;
+	config.TrigValue = trig;
+	config.PostTrigger = 120;
+	if(Pattern_Init(&demo_pattern, &pattern) != PATTERN_OK || Logic_Init(&demo_logic, &config) != LOGIC_OK)
+	{
+		printf("Logic: init failed\n");
+		return 1;
+	}
+
+	for(uint32_t i = 0; i < 16; i++)
+		levels[i] = demo_gray(i);
+	Pattern_Fill(&demo_pattern, words, levels, 16);
+	demo_pat_reset(demo_gray(15));
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM1, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM5, ENABLE);
+	if(Logic_Start(&demo_logic) != LOGIC_OK ||
+	   Pattern_Start(&demo_pattern, words, 16, PATTERN_MODE_CIRCULAR) != PATTERN_OK)
+		return 1;
+	while(Logic_Busy(&demo_logic))
+		__WFI();
+	Pattern_Stop(&demo_pattern);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM1, DISABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM5, DISABLE);
+
+	// the trigger sample starts code 10, the runs follow the Gray code,
+	// 4 samples each but the first and the last one
+	n = Logic_Compress(&demo_logic, runs, DEMO_LOGIC_LEN);
+	code = 0;
+	while(code < 16 && demo_gray(code) != runs[0].Levels)
+		code++;
+	for(uint32_t i = 0; i < n; i++)
+	{
+		if(runs[i].Levels != demo_gray(code + i) || (i > 0 && i < n - 1 && runs[i].Length != 4))
+			code = 0xFFFF;
+	}
+	if(demo_logic.Count <= demo_logic.TriggerIndex + config.PostTrigger || code > 15 ||
+	   (Logic_GetSample(&demo_logic, demo_logic.TriggerIndex) & config.TrigMask) != trig ||
+	   (Logic_GetSample(&demo_logic, demo_logic.TriggerIndex - 1) & config.TrigMask) == trig)
+	{
+		printf("Logic: capture of %u samples, trigger at %u, %lu runs out of order\n",
+				demo_logic.Count, demo_logic.TriggerIndex, (unsigned long)n);
+		return 1;
+	}
+
+	printf("Logic: %u samples of PE8..PE11 at %lu kHz, trigger at sample %u, %lu runs of 4 samples "
+			"follow the Gray code; first runs:\n", demo_logic.Count, (unsigned long)(demo_logic.SampleHz / 1000U),
+			demo_logic.TriggerIndex, (unsigned long)n);
+	Logic_Export(&demo_logic, runs, 3);
+	return 0;
+}
+
+/*
+ * 4 x 4 key matrix: rows PD0..PD3, columns PE12..PE15. The model pulls a
+ * column low while the row of one of its closed keys is low.
+ */
+#define DEMO_KEY_COL		GPIO_PIN_NO_12
+
+typedef struct
+{
+	uint16_t Closed;				/* contacts, bit Row * 4 + Col */
+	uint8_t Presses[16];
+	uint8_t Releases[16];
+	uint64_t PressCycle;			/* of the last press event */
+} demo_matrix_t;
+
+static demo_matrix_t demo_matrix;
+
+static void demo_matrix_update(void)
+{
+	uint8_t rows = ~GPIOD->ODR & 0xF;
+
+	for(uint8_t c = 0; c < 4; c++)
+	{
+		uint8_t low = 0;
+
+		for(uint8_t r = 0; r < 4; r++)
+			low |= ((rows >> r) & 1) && ((demo_matrix.Closed >> (r * 4 + c)) & 1);
+		if(low)
+			sim_gpio_set_input(GPIOE, DEMO_KEY_COL + c, 0);
+		else
+			sim_gpio_release_input(GPIOE, DEMO_KEY_COL + c);
+	}
+}
+
+static void demo_matrix_watch(void *pContext, uint16_t OldIdr, uint16_t NewIdr)
+{
+	(void)pContext;
+	if((OldIdr ^ NewIdr) & 0xF)
+		demo_matrix_update();
+}
+
+void Keypad_ApplicationEventCallback(Keypad_Handle_t *pKeypad, uint8_t AppEv)
+{
+	(void)AppEv;
+	for(uint8_t key = 0; key < 16; key++)
+	{
+		if(!((pKeypad->Changed >> key) & 1))
+			continue;
+		if((pKeypad->State >> key) & 1)
+		{
+			demo_matrix.Presses[key]++;
+			demo_matrix.PressCycle = sim_get_cycles();
+		} else
+		{
+			demo_matrix.Releases[key]++;
+		}
+	}
+}
+
+void TIM7_IRQHandler(void)
+{
+	TIM_IRQHandling(&demo_tim7);
+}
+
+// lets the simulated time run, the scanner works in the background
+static void demo_run_us(uint32_t Us)
+{
+	uint64_t end = sim_get_cycles() + (uint64_t)Us * (sim_get_hclk() / 1000000U);
+
+	while(sim_get_cycles() < end)
+		__WFI();
+}
+
+static void demo_contact(uint8_t Key, uint8_t Closed)
+{
+	if(Closed)
+		demo_matrix.Closed |= (uint16_t)(1U << Key);
+	else
+		demo_matrix.Closed &= (uint16_t)~(1U << Key);
+	demo_matrix_update();
+}
+
+static int demo_keypad_scan(void)
+{
+	static const uint16_t bounce[] = { 120, 310, 90, 450, 200, 170, 380, 260 };
+	Keypad_Config_t config;
+	uint64_t pressed, start;
+	uint32_t scans, latency;
+
+	memset(&demo_matrix, 0, sizeof(demo_matrix));
+	memset(&config, 0, sizeof(config));
+	for(uint8_t r = 0; r < 4; r++)
+	{
+		config.Row[r].pGPIOx = GPIOD;
+		config.Row[r].PinNumber = r;
+	}
+	config.Rows = 4;
+	config.pColPort = GPIOE;
+	config.ColPin = DEMO_KEY_COL;
+	config.Cols = 4;
+	config.pTIMHandle = &demo_tim7;
+	sim_gpio_watch(GPIOD, demo_matrix_watch, 0);
+	if(Keypad_Init(&demo_keypad, &config) != KEYPAD_OK)
+		return 1;
+
+	// one row every 250 us: a scan per ms
+	memset(&demo_tim7, 0, sizeof(demo_tim7));
+	demo_tim7.pTIMx = TIM7;
+	demo_tim7.TIM_Config.TIM_Prescaler = (uint16_t)(TIM_GetClockValue(TIM7) / 1000000U - 1);
+	demo_tim7.TIM_Config.TIM_Period = 249;
+	demo_tim7.TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+	TIM_Init(&demo_tim7);
+	TIM_IRQInterruptConfig(IRQ_NO_TIM7, ENABLE);
+	TIM_StartIT(&demo_tim7);
+	demo_run_us(5000);
+
+	// key 6 bounces for 2 ms, then stays closed
+	for(uint32_t i = 0; i < sizeof(bounce) / sizeof(bounce[0]); i++)
+	{
+		demo_contact(6, !(i & 1));
+		demo_run_us(bounce[i]);
+	}
+	demo_contact(6, 1);
+	start = sim_get_cycles();
+	demo_run_us(20000);
+	latency = (demo_matrix.PressCycle > start) ? demo_us(demo_matrix.PressCycle - start) : 0;
+
+	// a short glitch on key 9, then keys 0 and 15 together
+	demo_contact(9, 1);
+	demo_run_us(1500);
+	demo_contact(9, 0);
+	demo_contact(0, 1);
+	demo_contact(15, 1);
+	demo_run_us(20000);
+	pressed = Keypad_GetState(&demo_keypad);
+
+	demo_contact(0, 0);
+	demo_contact(6, 0);
+	demo_contact(15, 0);
+	demo_run_us(20000);
+	scans = demo_keypad.Scans;
+
+	TIM_StopIT(&demo_tim7);
+	TIM_IRQInterruptConfig(IRQ_NO_TIM7, DISABLE);
+	sim_gpio_watch(GPIOD, 0, 0);
+
+	if(pressed != ((1U << 0) | (1U << 6) | (1U << 15)) || Keypad_GetState(&demo_keypad) != 0 ||
+	   demo_matrix.Presses[6] != 1 || demo_matrix.Presses[0] != 1 || demo_matrix.Presses[15] != 1 ||
+	   demo_matrix.Presses[9] != 0 || demo_matrix.Releases[6] != 1 || latency == 0)
+	{
+		printf("Keypad: keys 0x%04lX, key 6 pressed %u times, key 9 %u times\n",
+				(unsigned long)pressed, demo_matrix.Presses[6], demo_matrix.Presses[9]);
+		return 1;
+	}
+
+	printf("Keypad: 4x4 matrix, %lu scans from TIM7, bouncing key pressed once (%lu us after it settled), "
+			"1.5 ms glitch ignored, 3 keys at once\n", (unsigned long)scans, (unsigned long)latency);
+	return 0;
+}
+
+/*
+ * Shift register chain on SPI1: 64 74HC595 and 32 74HC165, RCLK and SH/LD
+ * both on PC8.
+ */
+#define DEMO_EXP_LATCH		GPIO_PIN_NO_8
+#define DEMO_EXP_OUT		64
+#define DEMO_EXP_IN			32
+
+typedef struct
+{
+	uint8_t Shift595[DEMO_EXP_OUT];	/* [0]: the one on MOSI */
+	uint8_t Out595[DEMO_EXP_OUT];
+	uint8_t Shift165[DEMO_EXP_IN];	/* [0]: the one on MISO */
+	uint8_t Pins165[DEMO_EXP_IN];
+	uint32_t Latches;
+} demo_chain_t;
+
+static demo_chain_t demo_chain;
+static uint32_t demo_exp_changes;
+
+static uint16_t demo_chain_xfer(void *pContext, uint16_t Mosi)
+{
+	demo_chain_t *pChain = pContext;
+	uint8_t miso = pChain->Shift165[0];
+
+	// the first 165 shifts out, the last one shifts in its grounded SER
+	memmove(&pChain->Shift165[0], &pChain->Shift165[1], DEMO_EXP_IN - 1);
+	pChain->Shift165[DEMO_EXP_IN - 1] = 0;
+	memmove(&pChain->Shift595[1], &pChain->Shift595[0], DEMO_EXP_OUT - 1);
+	pChain->Shift595[0] = (uint8_t)Mosi;
+	return miso;
+}
+
+static void demo_chain_latch(void *pContext, uint16_t OldIdr, uint16_t NewIdr)
+{
+	demo_chain_t *pChain = pContext;
+	uint16_t bit = 1U << DEMO_EXP_LATCH;
+
+	if((OldIdr & bit) && !(NewIdr & bit))
+	{
+		memcpy(pChain->Shift165, pChain->Pins165, DEMO_EXP_IN);
+	} else if(!(OldIdr & bit) && (NewIdr & bit))
+	{
+		memcpy(pChain->Out595, pChain->Shift595, DEMO_EXP_OUT);
+		pChain->Latches++;
+	}
+}
+
+void TIM2_IRQHandler(void)
+{
+	TIM_IRQHandling(&demo_tim2);
+}
+
+void Expander_ApplicationEventCallback(Expander_Handle_t *pExpander, uint8_t AppEv)
+{
+	(void)pExpander;
+	if(AppEv == EXPANDER_EVENT_INPUT_CHANGED)
+		demo_exp_changes++;
+}
+
+static uint8_t demo_exp_expected(uint16_t Bit)
+{
+	return (Bit % 7 == 0) || (Bit >= 8 * 40 && Bit < 8 * 41 && (0xA5 >> (Bit & 7)) & 1);
+}
+
+static void demo_exp_wait(void)
+{
+	while(Expander_Busy(&demo_expander))
+		__WFI();
+}
+
+static int demo_expanders(void)
+{
+	Expander_Config_t config;
+	uint64_t start, refresh;
+	uint32_t refreshes, latches, errors = 0;
+
+	memset(&demo_chain, 0, sizeof(demo_chain));
+	for(uint32_t i = 0; i < DEMO_EXP_IN; i++)
+		demo_chain.Pins165[i] = (uint8_t)(i * 37 + 1);
+	sim_spi_attach(SPI1, demo_chain_xfer, &demo_chain);
+	sim_gpio_watch(GPIOC, demo_chain_latch, &demo_chain);
+
+	// back to 8 bit frames after the display
+	memset(&demo_spi1, 0, sizeof(demo_spi1));
+	demo_spi1.pSPIx = SPI1;
+	demo_spi1.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	demo_spi1.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	demo_spi1.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV2;
+	demo_spi1.SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	demo_spi1.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI_Init(&demo_spi1);
+	SPI_SSIConfig(SPI1, ENABLE);
+	SPI_PeripheralControl(SPI1, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM0, ENABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM3, ENABLE);
+
+	memset(&config, 0, sizeof(config));
+	config.pSPIHandle = &demo_spi1;
+	config.pLatchPort = GPIOC;
+	config.LatchPin = DEMO_EXP_LATCH;
+	config.OutBytes = DEMO_EXP_OUT;
+	config.InBytes = DEMO_EXP_IN;
+	config.pTIMHandle = &demo_tim2;
+	if(Expander_Init(&demo_expander, &config) != EXPANDER_OK)
+		return 1;
+
+	for(uint16_t bit = 0; bit < DEMO_EXP_OUT * 8; bit += 7)
+		Expander_SetOutput(&demo_expander, bit, SET);
+	Expander_WriteOutputByte(&demo_expander, 40, 0xA5);
+
+	// shared latch pin: the first refresh loads the inputs, the second reads them
+	start = sim_get_cycles();
+	if(Expander_Refresh(&demo_expander) != EXPANDER_OK)
+		return 1;
+	demo_exp_wait();
+	refresh = sim_get_cycles() - start;
+	Expander_Refresh(&demo_expander);
+	demo_exp_wait();
+
+	for(uint16_t bit = 0; bit < DEMO_EXP_OUT * 8; bit++)
+	{
+		if(((demo_chain.Out595[bit / 8] >> (bit % 8)) & 1) != demo_exp_expected(bit) ||
+		   Expander_GetOutput(&demo_expander, bit) != demo_exp_expected(bit))
+			errors++;
+	}
+	for(uint16_t bit = 0; bit < DEMO_EXP_IN * 8; bit++)
+	{
+		if(Expander_GetInput(&demo_expander, bit) != ((demo_chain.Pins165[bit / 8] >> (bit % 8)) & 1))
+			errors++;
+	}
+	if(errors != 0 || Expander_ReadInputByte(&demo_expander, 5) != demo_chain.Pins165[5])
+	{
+		printf("Expander: %lu bits differ\n", (unsigned long)errors);
+		return 1;
+	}
+
+	// 1 kHz from TIM2: an output changes, then an input
+	memset(&demo_tim2, 0, sizeof(demo_tim2));
+	demo_tim2.pTIMx = TIM2;
+	demo_tim2.TIM_Config.TIM_Prescaler = (uint16_t)(TIM_GetClockValue(TIM2) / 1000000U - 1);
+	demo_tim2.TIM_Config.TIM_Period = 999;
+	demo_tim2.TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+	TIM_Init(&demo_tim2);
+	TIM_IRQInterruptConfig(IRQ_NO_TIM2, ENABLE);
+	refreshes = demo_expander.Refreshes;
+	latches = demo_chain.Latches;
+	demo_exp_changes = 0;
+	TIM_StartIT(&demo_tim2);
+	demo_run_us(5500);
+	Expander_SetOutput(&demo_expander, 511, SET);
+	Expander_SetOutput(&demo_expander, 0, RESET);
+	demo_run_us(5000);
+	demo_chain.Pins165[31] ^= 0x80;
+	demo_run_us(10000);
+	TIM_StopIT(&demo_tim2);
+	TIM_IRQInterruptConfig(IRQ_NO_TIM2, DISABLE);
+	demo_exp_wait();
+	refreshes = demo_expander.Refreshes - refreshes;
+	latches = demo_chain.Latches - latches;
+
+	sim_gpio_watch(GPIOC, 0, 0);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM0, DISABLE);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM3, DISABLE);
+
+	if(refreshes < 19 || latches != refreshes || demo_expander.Skipped != 0 || demo_exp_changes != 1 ||
+	   !(demo_chain.Out595[63] & 0x80) || (demo_chain.Out595[0] & 1) ||
+	   Expander_GetInput(&demo_expander, 31 * 8 + 7) != (demo_chain.Pins165[31] >> 7))
+	{
+		printf("Expander: %lu refreshes, %lu latches, %lu skipped, %lu input changes\n",
+				(unsigned long)refreshes, (unsigned long)latches, (unsigned long)demo_expander.Skipped,
+				(unsigned long)demo_exp_changes);
+		return 1;
+	}
+
+	printf("Expander: 64 x 74HC595 + 32 x 74HC165 (512 outputs, 256 inputs) in one %lu us DMA transfer, "
+			"%lu refreshes at 1 kHz from TIM2, outputs latched, input change seen\n",
+			(unsigned long)demo_us(refresh), (unsigned long)refreshes);
+	return 0;
+}
+
+/*
+ * LED strip on SPI1 MOSI: decodes the line by the length of its high
+ * pulses, like the LEDs do, and checks them against the datasheet.
+ */
+#define DEMO_LEDS			300
+
+typedef struct
+{
+	uint32_t BitNs;					/* SPI bit */
+	uint32_t High;					/* SPI bits of the pulse in progress */
+	uint32_t Low;					/* SPI bits low since the last pulse */
+	uint32_t Bits;					/* LED bits of the frame */
+	uint8_t Data[DEMO_LEDS * 3];
+	uint8_t Shown[DEMO_LEDS * 3];	/* latched by the reset */
+	uint32_t Frames;
+	uint32_t BadPulses;
+	uint64_t LastCycle;
+	uint64_t MaxGap;				/* cycles between bytes inside a frame */
+} demo_strip_t;
+
+static demo_strip_t demo_leds;
+
+static void demo_strip_bit(demo_strip_t *pStrip, uint8_t Level)
+{
+	if(Level)
+	{
+		pStrip->High++;
+		pStrip->Low = 0;
+		return;
+	}
+	if(pStrip->High != 0)
+	{
+		uint32_t ns = pStrip->High * pStrip->BitNs;
+		uint8_t one = ns > (WS2812_T0H_NS + WS2812_T1H_NS) / 2;
+		uint32_t nominal = one ? WS2812_T1H_NS : WS2812_T0H_NS;
+
+		if(ns + WS2812_TOL_NS < nominal || ns > nominal + WS2812_TOL_NS)
+			pStrip->BadPulses++;
+		if(pStrip->Bits < DEMO_LEDS * 24)
+			pStrip->Data[pStrip->Bits / 8] |= (uint8_t)(one << (7 - pStrip->Bits % 8));
+		pStrip->Bits++;
+		pStrip->High = 0;
+	}
+	// 280 us low: the LEDs show what they got
+	if(++pStrip->Low * pStrip->BitNs >= 280000U && pStrip->Bits != 0)
+	{
+		memcpy(pStrip->Shown, pStrip->Data, sizeof(pStrip->Shown));
+		memset(pStrip->Data, 0, sizeof(pStrip->Data));
+		pStrip->Bits = 0;
+		pStrip->Frames++;
+	}
+}
+
+static uint16_t demo_strip_xfer(void *pContext, uint16_t Mosi)
+{
+	demo_strip_t *pStrip = pContext;
+	uint64_t now = sim_get_cycles();
+
+	if(pStrip->Bits != 0 && now - pStrip->LastCycle > pStrip->MaxGap)
+		pStrip->MaxGap = now - pStrip->LastCycle;
+	pStrip->LastCycle = now;
+
+	for(int8_t i = 7; i >= 0; i--)
+		demo_strip_bit(pStrip, (Mosi >> i) & 1);
+	return 0;
+}
+
+static uint32_t demo_wheel(uint32_t Pos)
+{
+	uint8_t p = (uint8_t)Pos;
+
+	if(p < 85)
+		return ((uint32_t)(255 - p * 3) << 16) | ((uint32_t)(p * 3) << 8);
+	if(p < 170)
+	{
+		p -= 85;
+		return ((uint32_t)(255 - p * 3) << 8) | (p * 3);
+	}
+	p -= 170;
+	return ((uint32_t)(p * 3) << 16) | (255 - p * 3);
+}
+
+// the frame ends with the reset time: the model has latched it by then
+static void demo_strip_wait(void)
+{
+	while(Ws2812_Busy(&demo_strip))
+		__WFI();
+}
+
+static int demo_ledstrip(void)
+{
+	static uint8_t pixels[DEMO_LEDS * 3];
+	static uint8_t front[DEMO_LEDS * 3];
+	static uint8_t expected[DEMO_LEDS * 3];
+	Ws2812_Config_t config;
+	uint64_t start, frame, end;
+	uint32_t byteCycles;
+
+	memset(&demo_leds, 0, sizeof(demo_leds));
+	sim_spi_attach(SPI1, demo_strip_xfer, &demo_leds);
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM3, ENABLE);
+
+	memset(&config, 0, sizeof(config));
+	config.pSPIHandle = &demo_spi1;
+	config.pPixels = pixels;
+	config.pFront = front;
+	config.Leds = DEMO_LEDS;
+	config.Channels = 3;
+	if(Ws2812_Init(&demo_strip, &config) != WS2812_OK)
+	{
+		printf("WS2812: no SPI speed fits\n");
+		return 1;
+	}
+	demo_leds.BitNs = 1000000000U / demo_strip.BitHz;
+	byteCycles = 8 * demo_leds.BitNs * (sim_get_hclk() / 1000000U) / 1000U;
+
+	// a rainbow
+	for(uint16_t i = 0; i < DEMO_LEDS; i++)
+		Ws2812_SetPixel(&demo_strip, i, demo_wheel(i * 256U / DEMO_LEDS));
+	memcpy(expected, pixels, sizeof(expected));
+	start = sim_get_cycles();
+	if(Ws2812_Commit(&demo_strip) != WS2812_OK)
+		return 1;
+	demo_strip_wait();
+	frame = sim_get_cycles() - start;
+	if(demo_leds.Frames != 1 || memcmp(demo_leds.Shown, expected, sizeof(expected)) != 0)
+	{
+		printf("WS2812: first frame wrong, %lu frames\n", (unsigned long)demo_leds.Frames);
+		return 1;
+	}
+
+	// the next frame: drawing goes on during the commit, and the
+	// interrupts are masked for 500 us in the middle of it
+	for(uint16_t i = 0; i < DEMO_LEDS; i++)
+		Ws2812_SetPixel(&demo_strip, i, 0x010203U * i);
+	memcpy(expected, pixels, sizeof(expected));
+	Ws2812_Commit(&demo_strip);
+	Ws2812_Fill(&demo_strip, 0);
+	demo_run_us(2000);
+	__disable_irq();
+	end = sim_get_cycles() + 500U * (sim_get_hclk() / 1000000U);
+	while(sim_get_cycles() < end)
+		(void)GPIOD->IDR;
+	__enable_irq();
+	demo_strip_wait();
+
+	DMA_IRQInterruptConfig(IRQ_NO_DMA2_STREAM3, DISABLE);
+
+	if(demo_leds.Frames != 2 || memcmp(demo_leds.Shown, expected, sizeof(expected)) != 0 ||
+	   demo_leds.BadPulses != 0 || demo_leds.MaxGap > byteCycles + 8)
+	{
+		printf("WS2812: %lu frames, %lu pulses out of spec, %lu cycles gap\n", (unsigned long)demo_leds.Frames,
+				(unsigned long)demo_leds.BadPulses, (unsigned long)demo_leds.MaxGap);
+		return 1;
+	}
+
+	printf("WS2812: %u LEDs, %u bit symbols at %lu kbit/s, frame %lu us through 2 x %u byte buffers, "
+			"no gap with interrupts masked for 500 us\n", DEMO_LEDS, demo_strip.SymbolBits,
+			(unsigned long)(demo_strip.BitHz / 1000U), (unsigned long)demo_us(frame), demo_strip.ChunkLen);
+	return 0;
+}
+
+/*
+ * Striping over SPI1, SPI2 and SPI3: a device per bus which answers each
+ * byte with its complement, chip selects on PC9..PC11.
+ */
+#define DEMO_STRIPE_CS		GPIO_PIN_NO_9
+#define DEMO_STRIPE_LEN		(24 * 1024)
+
+typedef struct
+{
+	uint8_t Selected;
+	uint8_t Got[DEMO_STRIPE_LEN];
+	uint32_t Count;
+	uint32_t Unselected;			/* frames while not selected */
+} demo_leg_t;
+
+static demo_leg_t demo_legs[3];
+
+static uint16_t demo_leg_xfer(void *pContext, uint16_t Mosi)
+{
+	demo_leg_t *pLeg = pContext;
+
+	if(!pLeg->Selected)
+		pLeg->Unselected++;
+	else if(pLeg->Count < DEMO_STRIPE_LEN)
+		pLeg->Got[pLeg->Count++] = (uint8_t)Mosi;
+	return (uint8_t)~Mosi;
+}
+
+static void demo_leg_cs(void *pContext, uint16_t OldIdr, uint16_t NewIdr)
+{
+	(void)pContext;
+	(void)OldIdr;
+	for(uint8_t i = 0; i < 3; i++)
+		demo_legs[i].Selected = !(NewIdr & (1U << (DEMO_STRIPE_CS + i)));
+}
+
+void DMA1_Stream0_IRQHandler(void)
+{
+	DMA_IRQHandling(&demo_spi3.RxDMA);
+}
+
+void DMA1_Stream5_IRQHandler(void)
+{
+	DMA_IRQHandling(&demo_spi3.TxDMA);
+}
+
+static void demo_stripe_spi(SPI_Handle_t *pSPIHandle, SPI_RegDef_t *pSPIx, uint8_t SclkSpeed)
+{
+	memset(pSPIHandle, 0, sizeof(*pSPIHandle));
+	pSPIHandle->pSPIx = pSPIx;
+	pSPIHandle->SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	pSPIHandle->SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	pSPIHandle->SPIConfig.SPI_SclkSpeed = SclkSpeed;
+	pSPIHandle->SPIConfig.SPI_DFF = SPI_DFF_8BITS;
+	pSPIHandle->SPIConfig.SPI_SSM = SPI_SSM_EN;
+	SPI_Init(pSPIHandle);
+	SPI_SSIConfig(pSPIx, ENABLE);
+	SPI_PeripheralControl(pSPIx, ENABLE);
+}
+
+// one striped transfer, cycles until STRIPE_EVENT_xxx
+static uint64_t demo_stripe_run(Stripe_Config_t *pConfig, uint8_t *pTx, uint8_t *pRx)
+{
+	uint64_t start;
+
+	memset(demo_legs, 0, sizeof(demo_legs));
+	if(Stripe_Init(&demo_stripe, pConfig) != STRIPE_OK)
+		return 0;
+	start = sim_get_cycles();
+	if(Stripe_Transfer(&demo_stripe, pTx, pRx, DEMO_STRIPE_LEN) != STRIPE_OK)
+		return 0;
+	while(Stripe_Busy(&demo_stripe))
+		__WFI();
+	return sim_get_cycles() - start;
+}
+
+static int demo_striping(void)
+{
+	static const uint8_t irqs[] = { IRQ_NO_DMA2_STREAM0, IRQ_NO_DMA2_STREAM3, IRQ_NO_DMA1_STREAM3,
+			IRQ_NO_DMA1_STREAM4, IRQ_NO_DMA1_STREAM0, IRQ_NO_DMA1_STREAM5 };
+	static SPI_Handle_t *const spis[] = { &demo_spi1, &demo_spi2, &demo_spi3 };
+	static uint8_t tx[DEMO_STRIPE_LEN], rx[DEMO_STRIPE_LEN];
+	Stripe_Config_t config;
+	GPIO_Handle_t pin;
+	uint64_t single, striped;
+	uint32_t offset, len, span[3];
+	uint32_t errors = 0;
+
+	for(uint32_t i = 0; i < DEMO_STRIPE_LEN; i++)
+		tx[i] = (uint8_t)(i * 7 + (i >> 8));
+
+	sim_spi_attach(SPI1, demo_leg_xfer, &demo_legs[0]);
+	sim_spi_attach(SPI2, demo_leg_xfer, &demo_legs[1]);
+	sim_spi_attach(SPI3, demo_leg_xfer, &demo_legs[2]);
+	// SPI3 a divider slower: a smaller share
+	demo_stripe_spi(&demo_spi1, SPI1, SPI_SCLK_SPEED_DIV2);
+	demo_stripe_spi(&demo_spi2, SPI2, SPI_SCLK_SPEED_DIV2);
+	demo_stripe_spi(&demo_spi3, SPI3, SPI_SCLK_SPEED_DIV4);
+	for(uint8_t i = 0; i < sizeof(irqs); i++)
+		DMA_IRQInterruptConfig(irqs[i], ENABLE);
+
+	memset(&pin, 0, sizeof(pin));
+	pin.pGPIOx = GPIOC;
+	pin.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	pin.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
+	pin.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	GPIO_PeriClockControl(GPIOC, ENABLE);
+	memset(&config, 0, sizeof(config));
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		GPIO_WriteToOutputPin(GPIOC, DEMO_STRIPE_CS + i, SET);
+		pin.GPIO_PinConfig.GPIO_PinNumber = DEMO_STRIPE_CS + i;
+		GPIO_Init(&pin);
+		config.Leg[i].pSPIHandle = spis[i];
+		config.Leg[i].pCSPort = GPIOC;
+		config.Leg[i].CSPin = DEMO_STRIPE_CS + i;
+	}
+	config.Align = 256;
+	sim_gpio_watch(GPIOC, demo_leg_cs, 0);
+
+	// SPI1 alone, then the three buses
+	config.Legs = 1;
+	single = demo_stripe_run(&config, tx, rx);
+	if(single == 0 || demo_legs[0].Count != DEMO_STRIPE_LEN || memcmp(demo_legs[0].Got, tx, DEMO_STRIPE_LEN) != 0)
+		errors++;
+
+	config.Legs = 3;
+	memset(rx, 0, sizeof(rx));
+	striped = demo_stripe_run(&config, tx, rx);
+	if(striped == 0)
+		errors++;
+	for(uint8_t i = 0; i < 3 && errors == 0; i++)
+	{
+		Stripe_GetSpan(&demo_stripe, DEMO_STRIPE_LEN, i, &offset, &len);
+		span[i] = len;
+		if(demo_legs[i].Count != len || demo_legs[i].Unselected != 0 || len % 256 != 0 ||
+		   memcmp(demo_legs[i].Got, &tx[offset], len) != 0)
+			errors++;
+	}
+	for(uint32_t i = 0; i < DEMO_STRIPE_LEN && errors == 0; i++)
+	{
+		if(rx[i] != (uint8_t)~tx[i])
+			errors++;
+	}
+
+	sim_gpio_watch(GPIOC, 0, 0);
+	for(uint8_t i = 0; i < sizeof(irqs); i++)
+		DMA_IRQInterruptConfig(irqs[i], DISABLE);
+
+	// a leg sharing a DMA stream is refused
+	config.Leg[2].pSPIHandle = &demo_spi1;
+	if(errors != 0 || demo_stripe.Failed != 0 || Stripe_Init(&demo_stripe, &config) != STRIPE_ERR_PARAM)
+	{
+		printf("Stripe: %lu errors, failed legs 0x%X\n", (unsigned long)errors, demo_stripe.Failed);
+		return 1;
+	}
+
+	printf("Stripe: %u KiB over SPI1 + SPI2 + SPI3 (%lu/%lu/%lu bytes by SCLK) in %lu us, "
+			"SPI1 alone %lu us, %.2fx\n", DEMO_STRIPE_LEN / 1024, (unsigned long)span[0], (unsigned long)span[1],
+			(unsigned long)span[2], (unsigned long)demo_us(striped), (unsigned long)demo_us(single),
+			(double)single / (double)striped);
+	return 0;
+}
+
+/*
+ * Clock trees for the divider checks: the 16 MHz HSI with undivided APBs
+ * and 168 MHz from the PLL (HSI / 8 * 168 / 2) with PCLK1 42 MHz and
+ * PCLK2 84 MHz.
+ */
+#define DEMO_CFGR_HSI		0
+#define DEMO_CFGR_PLL168	((2U << RCC_CFGR_SW) | (5U << RCC_CFGR_PPRE1) | (4U << RCC_CFGR_PPRE2))
+
+static void demo_set_clocks(uint32_t Cfgr)
+{
+	RCC->PLLCFGR = (8U << RCC_PLLCFGR_PLLM) | (168U << RCC_PLLCFGR_PLLN) | (7U << RCC_PLLCFGR_PLLQ);
+	RCC->CFGR = Cfgr;
+}
+
+/*
+ * USART BRR: the closest divider, by oversampling and APB bus. The 42/84
+ * MHz rows need the fraction rounded from PCLK / baud, not from USARTDIV
+ * cut to 2 decimals.
+ */
+static int demo_usart_brr(void)
+{
+	static const struct
+	{
+		USART_RegDef_t *pUSARTx;
+		uint32_t Cfgr;
+		uint8_t Over8;
+		uint32_t Baud;
+		uint16_t Brr;
+	} rows[] = {
+		{ USART2, DEMO_CFGR_HSI, 0, USART_STD_BAUD_9600, 0x0683 },
+		{ USART2, DEMO_CFGR_HSI, 0, USART_STD_BAUD_115200, 0x008B },
+		{ USART2, DEMO_CFGR_HSI, 1, USART_STD_BAUD_115200, 0x0113 },
+		{ USART6, DEMO_CFGR_HSI, 1, USART_STD_BAUD_2M, 0x0010 },
+		{ USART2, DEMO_CFGR_PLL168, 0, USART_STD_BAUD_115200, 0x016D },
+		{ USART3, DEMO_CFGR_PLL168, 1, USART_STD_BAUD_921600, 0x0056 },
+		{ USART1, DEMO_CFGR_PLL168, 0, USART_STD_BAUD_230400, 0x016D },
+		{ USART1, DEMO_CFGR_PLL168, 1, USART_STD_BAUD_38400, 0x1114 },
+		{ USART6, DEMO_CFGR_PLL168, 0, USART_STD_BAUD_9600, 0x222E },
+	};
+	USART_Handle_t usart2;
+	int errors = 0;
+
+	for(uint8_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+	{
+		demo_set_clocks(rows[i].Cfgr);
+		USART_PeriClockControl(rows[i].pUSARTx, ENABLE);
+		rows[i].pUSARTx->CR1 = rows[i].Over8 ? (1 << USART_CR1_OVER8) : 0;
+		USART_SetBaudRate(rows[i].pUSARTx, rows[i].Baud);
+		if(rows[i].pUSARTx->BRR != rows[i].Brr)
+		{
+			printf("USART: %lu baud OVER%u at %lu Hz: BRR 0x%04lX, expected 0x%04X\n", (unsigned long)rows[i].Baud,
+					rows[i].Over8 ? 8 : 16, (unsigned long)((rows[i].pUSARTx == USART1 || rows[i].pUSARTx == USART6) ?
+					RCC_GetPCLK2Value() : RCC_GetPCLK1Value()), (unsigned long)rows[i].pUSARTx->BRR, rows[i].Brr);
+			errors++;
+		}
+		USART_PeriClockControl(rows[i].pUSARTx, DISABLE);
+	}
+
+	// and through USART_Init, PCLK1 42 MHz
+	demo_set_clocks(DEMO_CFGR_PLL168);
+	memset(&usart2, 0, sizeof(usart2));
+	usart2.pUSARTx = USART2;
+	usart2.USART_Config.USART_Mode = USART_MODE_TXRX;
+	usart2.USART_Config.USART_Baud = USART_STD_BAUD_57600;
+	USART_PeriClockControl(USART2, ENABLE);
+	USART_Init(&usart2);
+	if(USART2->BRR != 0x02D9)
+	{
+		printf("USART: USART_Init at 57600 baud: BRR 0x%04lX\n", (unsigned long)USART2->BRR);
+		errors++;
+	}
+	USART_PeriClockControl(USART2, DISABLE);
+	demo_set_clocks(DEMO_CFGR_HSI);
+
+	if(errors != 0)
+		return 1;
+	printf("USART: BRR of %u baud rates at 16/42/84 MHz\n", (unsigned)(sizeof(rows) / sizeof(rows[0]) + 1));
+	return 0;
+}
+
+/*
+ * USART receive errors: a framing error in the middle of a circular RX
+ * DMA. FE (EIE) must be cleared by the handler's SR then DR read and
+ * reported once, without taking the frame from the DMA. A flag that
+ * stays set keeps the interrupt firing: the handler gives up after
+ * DEMO_USART_IRQ_LIMIT entries so that the check fails instead of hanging.
+ */
+#define DEMO_USART_IRQ_LIMIT		100
+
+static USART_Handle_t demo_usart3;
+static uint32_t demo_usart_irqs;
+static uint32_t demo_usart_fe;
+
+void USART3_IRQHandler(void)
+{
+	if(++demo_usart_irqs > DEMO_USART_IRQ_LIMIT)
+	{
+		USART_IRQInterruptConfig(39, DISABLE);
+		return;
+	}
+	USART_IRQHandling(&demo_usart3);
+}
+
+void DMA1_Stream1_IRQHandler(void)
+{
+	DMA_IRQHandling(&demo_usart3.RxDMA);
+}
+
+void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle, uint8_t AppEv)
+{
+	if(pUSARTHandle == &demo_usart3 && AppEv == USART_ERR_FE)
+		demo_usart_fe++;
+}
+
+static int demo_usart_errors(void)
+{
+	static const uint8_t line[] = "data";
+	static const uint8_t bad = 2;			// index of the frame with FE
+	static uint8_t tx_ring[16], rx_ring[16];
+	uint8_t got[8];
+	uint32_t n;
+	int errors = 0;
+
+	memset(&demo_usart3, 0, sizeof(demo_usart3));
+	demo_usart3.pUSARTx = USART3;
+	demo_usart3.USART_Config.USART_Mode = USART_MODE_TXRX;
+	demo_usart3.USART_Config.USART_Baud = USART_STD_BAUD_115200;
+	USART_PeriClockControl(USART3, ENABLE);
+	USART_Init(&demo_usart3);
+	USART_SetRingBuffers(&demo_usart3, tx_ring, sizeof(tx_ring), rx_ring, sizeof(rx_ring));
+	USART_PeripheralControl(USART3, ENABLE);
+	USART_StartRxDMA(&demo_usart3);
+
+	demo_usart_irqs = 0;
+	demo_usart_fe = 0;
+	USART_IRQInterruptConfig(12, ENABLE);	// DMA1 stream 1
+	USART_IRQInterruptConfig(39, ENABLE);
+
+	for(uint8_t i = 0; i < sizeof(line) - 1; i++)
+	{
+		sim_usart_receive(USART3, line[i], (i == bad) ? (1 << USART_SR_FE) : 0);
+		for(uint8_t w = 0; w < 4; w++)
+			__WFI();
+	}
+	sim_usart_idle(USART3);
+	__WFI();
+
+	n = USART_Read(&demo_usart3, got, sizeof(got));
+	if(demo_usart_fe != 1 || demo_usart_irqs > 4)
+	{
+		printf("USART: %lu FE callbacks in %lu interrupts\n", (unsigned long)demo_usart_fe, (unsigned long)demo_usart_irqs);
+		errors++;
+	}
+	if(USART3->SR & ((1 << USART_SR_FE) | (1 << USART_SR_IDLE)))
+	{
+		printf("USART: SR 0x%04lX after the handler\n", (unsigned long)USART3->SR);
+		errors++;
+	}
+	if(n != sizeof(line) - 1 || memcmp(got, line, n) != 0)
+	{
+		printf("USART: %lu bytes through the RX DMA\n", (unsigned long)n);
+		errors++;
+	}
+
+	USART_IRQInterruptConfig(39, DISABLE);
+	USART_IRQInterruptConfig(12, DISABLE);
+	USART_StopRxDMA(&demo_usart3);
+	USART_PeripheralControl(USART3, DISABLE);
+	USART_PeriClockControl(USART3, DISABLE);
+
+	if(errors != 0)
+		return 1;
+	printf("USART: framing error in a DMA receive reported once (%lu interrupts)\n", (unsigned long)demo_usart_irqs);
+	return 0;
+}
+
+/*
+ * I2C timing: CR2 FREQ, CCR and TRISE for standard mode and both fast
+ * mode duty cycles. The 8 MHz standard mode row is the CCR example of
+ * RM0090, and no row may run SCL faster than asked.
+ */
+static int demo_i2c_timing(void)
+{
+	static const struct
+	{
+		uint32_t Cfgr;
+		uint32_t Speed;
+		uint8_t Duty;
+		uint16_t Ccr;
+		uint8_t Trise;
+	} rows[] = {
+		{ DEMO_CFGR_HSI, I2C_SCL_SPEED_SM, I2C_FM_DUTY_2, 0x0050, 17 },
+		{ DEMO_CFGR_HSI, I2C_SCL_SPEED_FM4K, I2C_FM_DUTY_2, 0x800E, 5 },
+		{ DEMO_CFGR_HSI, I2C_SCL_SPEED_FM4K, I2C_FM_DUTY_16_9, 0xC002, 5 },
+		{ DEMO_CFGR_HSI, 10000, I2C_FM_DUTY_2, 0x0320, 17 },
+		{ 4U << RCC_CFGR_PPRE1, I2C_SCL_SPEED_SM, I2C_FM_DUTY_2, 0x0028, 9 },
+		{ 4U << RCC_CFGR_PPRE1, I2C_SCL_SPEED_FM4K, I2C_FM_DUTY_2, 0x8007, 3 },
+		{ DEMO_CFGR_PLL168, I2C_SCL_SPEED_SM, I2C_FM_DUTY_2, 0x00D2, 43 },
+		{ DEMO_CFGR_PLL168, I2C_SCL_SPEED_FM2K, I2C_FM_DUTY_2, 0x8046, 13 },
+		{ DEMO_CFGR_PLL168, I2C_SCL_SPEED_FM4K, I2C_FM_DUTY_2, 0x8023, 13 },
+		{ DEMO_CFGR_PLL168, I2C_SCL_SPEED_FM4K, I2C_FM_DUTY_16_9, 0xC005, 13 },
+	};
+	I2C_Handle_t i2c1;
+	int errors = 0;
+
+	for(uint8_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+	{
+		uint32_t pclk1, ccr, period;
+
+		demo_set_clocks(rows[i].Cfgr);
+		pclk1 = RCC_GetPCLK1Value();
+
+		memset(&i2c1, 0, sizeof(i2c1));
+		i2c1.pI2Cx = I2C1;
+		i2c1.I2C_Config.I2C_SCLSpeed = rows[i].Speed;
+		i2c1.I2C_Config.I2C_FMDutyCycle = rows[i].Duty;
+		I2C_PeriClockControl(I2C1, ENABLE);
+		I2C_Init(&i2c1);
+
+		ccr = I2C1->CCR;
+		if(!(ccr & (1 << I2C_CCR_FS)))
+			period = 2 * (ccr & 0xFFF);
+		else if(!(ccr & (1 << I2C_CCR_DUTY)))
+			period = 3 * (ccr & 0xFFF);
+		else
+			period = 25 * (ccr & 0xFFF);
+
+		if(ccr != rows[i].Ccr || I2C1->TRISE != rows[i].Trise ||
+		   (I2C1->CR2 & 0x3F) != pclk1 / 1000000U || pclk1 / period > rows[i].Speed)
+		{
+			printf("I2C: %lu Hz duty %u at %lu Hz: CCR 0x%04lX TRISE %lu FREQ %lu, expected 0x%04X %u\n",
+					(unsigned long)rows[i].Speed, rows[i].Duty, (unsigned long)pclk1, (unsigned long)ccr,
+					(unsigned long)I2C1->TRISE, (unsigned long)(I2C1->CR2 & 0x3F), rows[i].Ccr, rows[i].Trise);
+			errors++;
+		}
+		I2C_PeriClockControl(I2C1, DISABLE);
+	}
+	demo_set_clocks(DEMO_CFGR_HSI);
+
+	if(errors != 0)
+		return 1;
+	printf("I2C: CCR/TRISE of %u speeds at 8/16/42 MHz, SCL never above the asked speed\n",
+			(unsigned)(sizeof(rows) / sizeof(rows[0])));
+	return 0;
+}
+
+/*
+ * Timer DMA requests (RM0090 DMA1/DMA2 request mapping): the stream and
+ * channel picked for the update request and the capture/compare request
+ * of each channel, as seen on the running stream. TIM9..TIM14 (rows in
+ * timer order) have none.
+ * The counters run at PCLK / 65536 with ARR 65535, no request comes.
+ */
+#define DEMO_TIM_NONE		0xFF
+
+static int demo_tim_dma_map(void)
+{
+	static const struct
+	{
+		TIM_RegDef_t *pTIMx;
+		DMA_RegDef_t *pDMAx;
+		uint8_t Stream[5];			/* UP, CC1..CC4 */
+		uint8_t Channel;
+	} rows[] = {
+		{ TIM1, DMA2, { 5, 1, 2, 6, 4 }, 6 },
+		{ TIM2, DMA1, { 7, 5, 6, 1, 6 }, 3 },
+		{ TIM3, DMA1, { 2, 4, 5, 7, 2 }, 5 },
+		{ TIM4, DMA1, { 6, 0, 3, 7, DEMO_TIM_NONE }, 2 },
+		{ TIM5, DMA1, { 6, 2, 4, 0, 1 }, 6 },
+		{ TIM6, DMA1, { 1, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE }, 7 },
+		{ TIM7, DMA1, { 2, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE }, 1 },
+		{ TIM8, DMA2, { 1, 2, 3, 4, 7 }, 7 },
+		{ TIM9, 0, { DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE }, 0 },
+		{ TIM10, 0, { DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE }, 0 },
+		{ TIM11, 0, { DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE }, 0 },
+		{ TIM12, 0, { DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE }, 0 },
+		{ TIM13, 0, { DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE }, 0 },
+		{ TIM14, 0, { DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE, DEMO_TIM_NONE }, 0 },
+	};
+	static uint32_t words[8];
+	static uint32_t sink;
+	TIM_Handle_t tim;
+	uint32_t checked = 0;
+	int errors = 0;
+
+	for(uint8_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+	{
+		TIM_RegDef_t *pTIMx = rows[i].pTIMx;
+
+		memset(&tim, 0, sizeof(tim));
+		tim.pTIMx = pTIMx;
+		tim.TIM_Config.TIM_Prescaler = 0xFFFF;
+		tim.TIM_Config.TIM_Period = 0xFFFF;
+		tim.TIM_Config.TIM_CounterMode = TIM_COUNTER_UP;
+		TIM_PeriClockControl(pTIMx, ENABLE);
+		TIM_Init(&tim);
+
+		for(uint8_t req = 0; req < 5; req++)
+		{
+			DMA_Handle_t *pDMAHandle = (req == 0) ? &tim.UpDMA : &tim.CCDMA;
+			uint8_t started, stream = rows[i].Stream[req];
+			uint32_t cr = 0;
+
+			if(req == 0)
+				started = TIM_UpdateStartDMA(&tim, (uint32_t)&sink, words, 8, DISABLE);
+			else
+				started = TIM_ICStartDMA(&tim, req, words, 8, DISABLE);
+			if(started == SET)
+				cr = pDMAHandle->pDMAx->STREAM[pDMAHandle->Stream].CR;
+
+			if((started == SET) != (stream != DEMO_TIM_NONE) ||
+			   (started == SET && (pDMAHandle->pDMAx != rows[i].pDMAx || pDMAHandle->Stream != stream ||
+			   !(cr & (1 << DMA_SxCR_EN)) || ((cr >> DMA_SxCR_CHSEL) & 0x7) != rows[i].Channel)))
+			{
+				printf("TIM DMA: TIM%u %s: %s, stream %u channel %lu\n", i + 1,
+						(req == 0) ? "UP" : "CCx", started ? "started" : "not started", pDMAHandle->Stream,
+						(unsigned long)((cr >> DMA_SxCR_CHSEL) & 0x7));
+				errors++;
+			}
+
+			if(req == 0)
+				TIM_UpdateStopDMA(&tim);
+			else
+				TIM_ICStopDMA(&tim);
+			if(started == SET && (pDMAHandle->pDMAx->STREAM[pDMAHandle->Stream].CR & (1 << DMA_SxCR_EN)))
+			{
+				printf("TIM DMA: TIM%u stream %u still on after stop\n", i + 1, pDMAHandle->Stream);
+				errors++;
+			}
+			checked++;
+		}
+
+		// PWM burst from CCR2: DBA 14 (word offset of CCR2), DBL 2 (3 transfers)
+		if(rows[i].Stream[1] != DEMO_TIM_NONE)
+		{
+			if(TIM_PWMStartBurstDMA(&tim, TIM_CHANNEL_2, 3, words, 2, DISABLE) != SET || pTIMx->DCR != 0x020E)
+			{
+				printf("TIM DMA: TIM%u burst DCR 0x%04lX\n", i + 1, (unsigned long)pTIMx->DCR);
+				errors++;
+			}
+			TIM_PWMStopBurstDMA(&tim);
+			for(uint8_t ch = TIM_CHANNEL_2; ch <= TIM_CHANNEL_4; ch++)
+				TIM_OCChannelControl(pTIMx, ch, DISABLE);
+		}
+
+		TIM_PeripheralControl(pTIMx, DISABLE);
+		TIM_PeriClockControl(pTIMx, DISABLE);
+	}
+
+	if(errors != 0)
+		return 1;
+	printf("TIM DMA: %lu requests of TIM1..TIM14 on their RM0090 streams, burst DCR from CCR2\n",
+			(unsigned long)checked);
+	return 0;
+}
+
+/*
+ * ADC common settings: the CCR of ADC_CommonInit (prescaler, multi mode,
+ * delay clamped to 5..20 cycles, DMA mode with DDS), and how the multi
+ * ADC DMA moves the samples of each DMA mode into a 16-bit buffer. No
+ * conversion is simulated, the stream only waits for requests.
+ */
+static int demo_adc_common(void)
+{
+	static const struct
+	{
+		ADC_CommonConfig_t Config;
+		uint32_t Ccr;
+	} rows[] = {
+		{ { ADC_PRESCALER_DIV2, ADC_MULTI_TRIPLE_INTERLEAVED, ADC_MULTI_DMA_MODE2, 5 }, 0x0000A017 },
+		{ { ADC_PRESCALER_DIV4, ADC_MULTI_DUAL_INTERLEAVED, ADC_MULTI_DMA_MODE1, 8 }, 0x00016307 },
+		{ { ADC_PRESCALER_DIV6, ADC_MULTI_DUAL_INTERLEAVED, ADC_MULTI_DMA_MODE3, 25 }, 0x0002EF07 },
+		{ { ADC_PRESCALER_DIV8, ADC_MULTI_INDEPENDENT, ADC_MULTI_DMA_DISABLED, 3 }, 0x00030000 },
+	};
+	static const struct
+	{
+		uint8_t DMAMode;
+		uint8_t Offset;				/* in half-words from a word aligned buffer */
+		uint16_t Len;
+		uint8_t Started;
+		uint16_t Items;
+		uint8_t Size;
+	} starts[] = {
+		{ ADC_MULTI_DMA_MODE1, 1, 8, SET, 8, DMA_SIZE_HALFWORD },
+		{ ADC_MULTI_DMA_MODE2, 0, 8, SET, 4, DMA_SIZE_WORD },
+		{ ADC_MULTI_DMA_MODE2, 1, 8, RESET, 0, 0 },
+		{ ADC_MULTI_DMA_MODE2, 0, 7, RESET, 0, 0 },
+		{ ADC_MULTI_DMA_MODE3, 1, 8, SET, 8, DMA_SIZE_HALFWORD },
+		{ ADC_MULTI_DMA_DISABLED, 0, 8, RESET, 0, 0 },
+	};
+	static uint32_t samples[8];
+	ADC_CommonConfig_t common;
+	ADC_Handle_t adc1;
+	int errors = 0;
+
+	ADC_PeriClockControl(ADC1, ENABLE);
+	for(uint8_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+	{
+		common = rows[i].Config;
+		ADC_CommonInit(&common);
+		if(ADC_COMMON->CCR != rows[i].Ccr)
+		{
+			printf("ADC: CCR 0x%08lX, expected 0x%08lX\n", (unsigned long)ADC_COMMON->CCR, (unsigned long)rows[i].Ccr);
+			errors++;
+		}
+	}
+
+	memset(&adc1, 0, sizeof(adc1));
+	adc1.pADCx = ADC1;
+	adc1.ADC_Config.ADC_NoOfConversions = 1;
+	adc1.ADC_Config.ADC_ExtTrigger = ADC_EXTTRIG_TIM2_TRGO;
+	adc1.ADC_Config.ADC_ExtTriggerEdge = ADC_EXTTRIG_EDGE_RISING;
+	ADC_Init(&adc1);
+	for(uint8_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++)
+	{
+		uint16_t *pBuffer = (uint16_t*)samples + starts[i].Offset;
+		uint8_t started;
+		uint32_t cr = 0, ndtr = 0;
+
+		common.ADC_Prescaler = ADC_PRESCALER_DIV4;
+		common.ADC_MultiMode = ADC_MULTI_DUAL_INTERLEAVED;
+		common.ADC_MultiDMAMode = starts[i].DMAMode;
+		common.ADC_TwoSamplingDelay = 5;
+		ADC_CommonInit(&common);
+
+		started = ADC_MultiStartDMA(&adc1, pBuffer, starts[i].Len);
+		if(started == SET)
+		{
+			cr = adc1.DMA.pDMAx->STREAM[adc1.DMA.Stream].CR;
+			ndtr = adc1.DMA.pDMAx->STREAM[adc1.DMA.Stream].NDTR;
+		}
+		if(started != starts[i].Started || (started == SET && (ndtr != starts[i].Items ||
+		   ((cr >> DMA_SxCR_PSIZE) & 0x3) != starts[i].Size || ((cr >> DMA_SxCR_MSIZE) & 0x3) != starts[i].Size ||
+		   adc1.BufferLen != starts[i].Len)))
+		{
+			printf("ADC: DMA mode %u, buffer +%u half-words, %u elements: %s, %lu items of size %lu\n",
+					starts[i].DMAMode, starts[i].Offset, starts[i].Len, started ? "started" : "refused",
+					(unsigned long)ndtr, (unsigned long)((cr >> DMA_SxCR_PSIZE) & 0x3));
+			errors++;
+		}
+		if(started == SET)
+			ADC_StopDMA(&adc1);
+	}
+	ADC_PeriClockControl(ADC1, DISABLE);
+
+	if(errors != 0)
+		return 1;
+	printf("ADC: CCR of %u common settings, multi DMA layout of modes 1-3, unaligned mode 2 buffer refused\n",
+			(unsigned)(sizeof(rows) / sizeof(rows[0])));
+	return 0;
+}
+
+int main(void)
+{
+	int errors = 0;
+
+	Clk_Init(ENABLE);
+
+	errors += demo_gpio();
+	errors += demo_spi(SPI_SCLK_SPEED_DIV2);
+	errors += demo_spi(SPI_SCLK_SPEED_DIV8);
+	errors += demo_spi(SPI_SCLK_SPEED_DIV64);
+	errors += demo_clk();
+	errors += demo_pwr();
+	errors += demo_sched();
+	errors += demo_ring();
+	errors += demo_spicmd();
+	errors += demo_norflash();
+	errors += demo_sdcard();
+	errors += demo_display();
+	errors += demo_softspi();
+	errors += demo_patterngen();
+	errors += demo_logic_capture();
+	errors += demo_keypad_scan();
+	errors += demo_expanders();
+	errors += demo_ledstrip();
+	errors += demo_striping();
+	errors += demo_usart_brr();
+	errors += demo_usart_errors();
+	errors += demo_i2c_timing();
+	errors += demo_tim_dma_map();
+	errors += demo_adc_common();
+
+	printf("%llu register accesses, %llu SPI frames\n",
+			(unsigned long long)sim_get_stats()->Accesses, (unsigned long long)sim_get_stats()->SpiFrames);
+	return errors ? 1 : 0;
+}
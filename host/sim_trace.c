@@ -0,0 +1,464 @@
+/*
+ * Trace decoder for the register access traces of the simulator.
+ *
+ *   sim_trace dump    <trace> [<program>]	one line per record
+ *   sim_trace summary <trace> [<program>]	register traffic per API call
+ *   sim_trace replay  <trace>				run the accesses against the models
+ *
+ * <program> is the traced executable, its symbols name the driver functions
+ * (read with nm). API calls are only visible when the drivers were built
+ * with TRACE=1; otherwise all accesses count as "(application)".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32_sim_internal.h"
+
+#define TRACE_MAX_SYMBOLS			8192
+#define TRACE_MAX_DEPTH				64
+#define TRACE_MAX_OWNERS			512
+#define TRACE_REG_SLOTS				4096		// power of 2
+#define TRACE_OWNER_APP				0xFFFFFFFFU
+#define TRACE_OWNER_IRQ				0xFFFF0000U	// | IRQ number
+
+typedef struct
+{
+	uint32_t Addr;
+	char Name[64];
+} trace_symbol_t;
+
+typedef struct
+{
+	uint32_t Base;
+	uint32_t Size;
+	const char *pName;
+} trace_region_t;
+
+typedef struct
+{
+	uint32_t Key;					/* function address or TRACE_OWNER_xxx */
+	uint64_t Calls;
+	uint64_t Reads;
+	uint64_t Writes;
+	uint64_t ReadModifyWrites;		/* write right after a read of the same register */
+	uint64_t SameValueWrites;		/* write of the value the register already had */
+	uint64_t Cycles;
+} trace_owner_t;
+
+typedef struct
+{
+	uint32_t Key;
+	uint32_t EnterCycle;
+	uint8_t IsIrq;
+	uint8_t IsOwner;
+} trace_frame_t;
+
+static const trace_region_t trace_regions[] =
+{
+	{ GPIOA_BASEADDR, 0x400, "GPIOA" }, { GPIOB_BASEADDR, 0x400, "GPIOB" },
+	{ GPIOC_BASEADDR, 0x400, "GPIOC" }, { GPIOD_BASEADDR, 0x400, "GPIOD" },
+	{ GPIOE_BASEADDR, 0x400, "GPIOE" }, { GPIOF_BASEADDR, 0x400, "GPIOF" },
+	{ GPIOG_BASEADDR, 0x400, "GPIOG" }, { GPIOH_BASEADDR, 0x400, "GPIOH" },
+	{ GPIOI_BASEADDR, 0x400, "GPIOI" }, { RCC_BASEADDR, 0x400, "RCC" },
+	{ DMA1_BASEADDR, 0x400, "DMA1" }, { DMA2_BASEADDR, 0x400, "DMA2" },
+	{ EXTI_BASEADDR, 0x400, "EXTI" }, { SYSCFG_BASEADDR, 0x400, "SYSCFG" },
+	{ SPI1_BASEADDR, 0x400, "SPI1" }, { SPI2_BASEADDR, 0x400, "SPI2" },
+	{ SPI3_BASEADDR, 0x400, "SPI3" }, { SPI4_BASEADDR, 0x400, "SPI4" },
+	{ I2C1_BASEADDR, 0x400, "I2C1" }, { I2C2_BASEADDR, 0x400, "I2C2" },
+	{ I2C3_BASEADDR, 0x400, "I2C3" },
+	{ USART1_BASEADDR, 0x400, "USART1" }, { USART2_BASEADDR, 0x400, "USART2" },
+	{ USART3_BASEADDR, 0x400, "USART3" }, { UART4_BASEADDR, 0x400, "UART4" },
+	{ UART5_BASEADDR, 0x400, "UART5" }, { USART6_BASEADDR, 0x400, "USART6" },
+	{ TIM1_BASEADDR, 0x400, "TIM1" }, { TIM2_BASEADDR, 0x400, "TIM2" },
+	{ TIM3_BASEADDR, 0x400, "TIM3" }, { TIM4_BASEADDR, 0x400, "TIM4" },
+	{ TIM5_BASEADDR, 0x400, "TIM5" }, { TIM6_BASEADDR, 0x400, "TIM6" },
+	{ TIM7_BASEADDR, 0x400, "TIM7" }, { TIM8_BASEADDR, 0x400, "TIM8" },
+	{ TIM9_BASEADDR, 0x400, "TIM9" }, { TIM10_BASEADDR, 0x400, "TIM10" },
+	{ TIM11_BASEADDR, 0x400, "TIM11" }, { TIM12_BASEADDR, 0x400, "TIM12" },
+	{ TIM13_BASEADDR, 0x400, "TIM13" }, { TIM14_BASEADDR, 0x400, "TIM14" },
+	{ ADC1_BASEADDR, 0x100, "ADC1" }, { ADC2_BASEADDR, 0x100, "ADC2" },
+	{ ADC3_BASEADDR, 0x100, "ADC3" }, { ADC_COMMON_BASEADDR, 0x100, "ADC" },
+	{ ITM_BASEADDR, 0x1000, "ITM" }, { 0xE0001000U, 0x1000, "DWT" },
+	{ 0xE000E010U, 0x10, "SysTick" }, { SIM_NVIC_BASE, 0x400, "NVIC" },
+	{ 0xE000ED00U, 0x100, "SCB" },
+};
+
+static trace_symbol_t trace_symbols[TRACE_MAX_SYMBOLS];
+static uint32_t trace_no_of_symbols;
+static trace_owner_t trace_owners[TRACE_MAX_OWNERS];
+static uint32_t trace_no_of_owners;
+
+static sim_trace_header_t trace_header;
+static sim_trace_record_t *trace_records;
+
+static int trace_load(const char *pPath)
+{
+	FILE *pFile = fopen(pPath, "rb");
+
+	if(!pFile)
+	{
+		perror(pPath);
+		return -1;
+	}
+	if(fread(&trace_header, sizeof(trace_header), 1, pFile) != 1 ||
+	   memcmp(trace_header.Magic, SIM_TRACE_MAGIC, sizeof(trace_header.Magic)) != 0 ||
+	   trace_header.Version != SIM_TRACE_VERSION || trace_header.RecordSize != sizeof(sim_trace_record_t))
+	{
+		fprintf(stderr, "%s: not a trace of this simulator version\n", pPath);
+		fclose(pFile);
+		return -1;
+	}
+	trace_records = malloc((size_t)trace_header.Count * sizeof(sim_trace_record_t) + 1);
+	if(!trace_records || fread(trace_records, sizeof(sim_trace_record_t), trace_header.Count, pFile) != trace_header.Count)
+	{
+		fprintf(stderr, "%s: truncated trace\n", pPath);
+		fclose(pFile);
+		return -1;
+	}
+	fclose(pFile);
+	if(trace_header.Dropped)
+		fprintf(stderr, "warning: %u records were dropped while recording\n", (unsigned)trace_header.Dropped);
+	return 0;
+}
+
+// function symbols of the traced program, sorted by address (nm -n)
+static void trace_load_symbols(const char *pProgram)
+{
+	char cmd[512];
+	char line[256];
+	FILE *pPipe;
+
+	snprintf(cmd, sizeof(cmd), "nm -n --defined-only '%s'", pProgram);
+	pPipe = popen(cmd, "r");
+	if(!pPipe)
+		return;
+	while(fgets(line, sizeof(line), pPipe) && trace_no_of_symbols < TRACE_MAX_SYMBOLS)
+	{
+		unsigned long long addr;
+		char type;
+		char name[64];
+
+		if(sscanf(line, "%llx %c %63s", &addr, &type, name) == 3 && (type == 't' || type == 'T' || type == 'w' || type == 'W'))
+		{
+			trace_symbols[trace_no_of_symbols].Addr = (uint32_t)addr;
+			strcpy(trace_symbols[trace_no_of_symbols].Name, name);
+			trace_no_of_symbols++;
+		}
+	}
+	pclose(pPipe);
+}
+
+static const char *trace_symbol_name(uint32_t Addr)
+{
+	static char unknown[16];
+	int lo = 0, hi = (int)trace_no_of_symbols - 1, found = -1;
+
+	while(lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+
+		if(trace_symbols[mid].Addr <= Addr)
+		{
+			found = mid;
+			lo = mid + 1;
+		} else
+		{
+			hi = mid - 1;
+		}
+	}
+	if(found >= 0)
+		return trace_symbols[found].Name;
+	snprintf(unknown, sizeof(unknown), "0x%08X", (unsigned)Addr);
+	return unknown;
+}
+
+static const char *trace_register_name(uint32_t Addr)
+{
+	static char name[32];
+
+	for(size_t i = 0; i < sizeof(trace_regions) / sizeof(trace_regions[0]); i++)
+	{
+		if(Addr >= trace_regions[i].Base && Addr < trace_regions[i].Base + trace_regions[i].Size)
+		{
+			snprintf(name, sizeof(name), "%s+0x%03X", trace_regions[i].pName, (unsigned)(Addr - trace_regions[i].Base));
+			return name;
+		}
+	}
+	snprintf(name, sizeof(name), "0x%08X", (unsigned)Addr);
+	return name;
+}
+
+static const char *trace_owner_name(uint32_t Key)
+{
+	static char name[16];
+
+	if(Key == TRACE_OWNER_APP)
+		return "(application)";
+	if((Key & TRACE_OWNER_IRQ) == TRACE_OWNER_IRQ)
+	{
+		snprintf(name, sizeof(name), "(IRQ %u)", (unsigned)(Key & 0xFFFF));
+		return name;
+	}
+	return trace_symbol_name(Key);
+}
+
+static trace_owner_t *trace_owner(uint32_t Key)
+{
+	for(uint32_t i = 0; i < trace_no_of_owners; i++)
+	{
+		if(trace_owners[i].Key == Key)
+			return &trace_owners[i];
+	}
+	if(trace_no_of_owners == TRACE_MAX_OWNERS)
+	{
+		fprintf(stderr, "too many API functions\n");
+		exit(1);
+	}
+	memset(&trace_owners[trace_no_of_owners], 0, sizeof(trace_owner_t));
+	trace_owners[trace_no_of_owners].Key = Key;
+	return &trace_owners[trace_no_of_owners++];
+}
+
+/**************************************************************************
+ * dump
+ ****************************************************************************/
+static int trace_dump(void)
+{
+	int depth = 0;
+
+	for(uint32_t i = 0; i < trace_header.Count; i++)
+	{
+		sim_trace_record_t *pRecord = &trace_records[i];
+
+		if(pRecord->Type == SIM_TRACE_EXIT || pRecord->Type == SIM_TRACE_IRQ_EXIT)
+			depth = depth ? depth - 1 : 0;
+
+		printf("%10u %*s", (unsigned)pRecord->Cycle, 2 * depth, "");
+		switch(pRecord->Type)
+		{
+		case SIM_TRACE_READ:
+			printf("R %-12s 0x%08X\n", trace_register_name(pRecord->Addr), (unsigned)pRecord->Value);
+			break;
+		case SIM_TRACE_WRITE:
+			printf("W %-12s 0x%08X\n", trace_register_name(pRecord->Addr), (unsigned)pRecord->Value);
+			break;
+		case SIM_TRACE_ENTER:
+			printf("> %s\n", trace_symbol_name(pRecord->Addr));
+			break;
+		case SIM_TRACE_EXIT:
+			printf("< %s\n", trace_symbol_name(pRecord->Addr));
+			break;
+		case SIM_TRACE_IRQ_ENTER:
+			printf("> IRQ %u\n", (unsigned)pRecord->Value);
+			break;
+		case SIM_TRACE_IRQ_EXIT:
+			printf("< IRQ %u\n", (unsigned)pRecord->Value);
+			break;
+		}
+
+		if(pRecord->Type == SIM_TRACE_ENTER || pRecord->Type == SIM_TRACE_IRQ_ENTER)
+			depth++;
+	}
+	return 0;
+}
+
+/**************************************************************************
+ * summary
+ * ************************************************************************
+ * Accesses belong to the outermost driver function (the API call) of the
+ * thread or of the interrupt handler they happen in.
+ ****************************************************************************/
+static int trace_summary(void)
+{
+	static uint32_t reg_addr[TRACE_REG_SLOTS];
+	static uint32_t reg_value[TRACE_REG_SLOTS];
+	static uint8_t reg_known[TRACE_REG_SLOTS];
+	trace_frame_t stack[TRACE_MAX_DEPTH];
+	int depth = 0;
+	uint32_t last_read = 0;
+	uint8_t last_was_read = 0;
+	uint64_t total_reads = 0, total_writes = 0;
+
+	for(uint32_t i = 0; i < trace_header.Count; i++)
+	{
+		sim_trace_record_t *pRecord = &trace_records[i];
+		int base = 0;
+
+		// frames above the innermost interrupt belong to that interrupt
+		for(int d = depth - 1; d >= 0; d--)
+		{
+			if(stack[d].IsIrq)
+			{
+				base = d + 1;
+				break;
+			}
+		}
+
+		if(pRecord->Type == SIM_TRACE_ENTER || pRecord->Type == SIM_TRACE_IRQ_ENTER)
+		{
+			uint8_t is_irq = (pRecord->Type == SIM_TRACE_IRQ_ENTER);
+			uint32_t key = is_irq ? (TRACE_OWNER_IRQ | pRecord->Value) : pRecord->Addr;
+
+			if(depth == TRACE_MAX_DEPTH)
+			{
+				fprintf(stderr, "call depth exceeds %d\n", TRACE_MAX_DEPTH);
+				return 1;
+			}
+			stack[depth].Key = key;
+			stack[depth].EnterCycle = pRecord->Cycle;
+			stack[depth].IsIrq = is_irq;
+			stack[depth].IsOwner = is_irq || depth == base;
+			if(stack[depth].IsOwner)
+				trace_owner(key)->Calls++;
+			depth++;
+			last_was_read = 0;
+		} else if(pRecord->Type == SIM_TRACE_EXIT || pRecord->Type == SIM_TRACE_IRQ_EXIT)
+		{
+			uint32_t key = (pRecord->Type == SIM_TRACE_IRQ_EXIT) ? (TRACE_OWNER_IRQ | pRecord->Value) : pRecord->Addr;
+
+			// unwind to the matching entry (longjmp or a lost record)
+			while(depth > 0)
+			{
+				trace_frame_t *pFrame = &stack[--depth];
+
+				if(pFrame->IsOwner)
+					trace_owner(pFrame->Key)->Cycles += (uint32_t)(pRecord->Cycle - pFrame->EnterCycle);
+				if(pFrame->Key == key)
+					break;
+			}
+			last_was_read = 0;
+		} else
+		{
+			uint32_t owner_key;
+			trace_owner_t *pOwner;
+			uint32_t slot = (pRecord->Addr >> 2) & (TRACE_REG_SLOTS - 1);
+
+			if(depth > base)
+				owner_key = stack[base].Key;
+			else if(base > 0)
+				owner_key = stack[base - 1].Key;		// handler code outside the drivers
+			else
+				owner_key = TRACE_OWNER_APP;
+			pOwner = trace_owner(owner_key);
+			if(owner_key == TRACE_OWNER_APP)
+				pOwner->Calls = 1;
+
+			if(pRecord->Type == SIM_TRACE_READ)
+			{
+				pOwner->Reads++;
+				total_reads++;
+				last_read = pRecord->Addr;
+				last_was_read = 1;
+			} else
+			{
+				pOwner->Writes++;
+				total_writes++;
+				if(last_was_read && last_read == pRecord->Addr)
+					pOwner->ReadModifyWrites++;
+				if(reg_known[slot] && reg_addr[slot] == pRecord->Addr && reg_value[slot] == pRecord->Value)
+					pOwner->SameValueWrites++;
+				last_was_read = 0;
+			}
+			reg_addr[slot] = pRecord->Addr;
+			reg_value[slot] = pRecord->Value;
+			reg_known[slot] = 1;
+		}
+	}
+
+	printf("%-32s %8s %9s %9s %7s %7s %9s %11s\n",
+			"API call", "calls", "reads", "writes", "rmw", "same", "acc/call", "cycles/call");
+	for(uint32_t i = 0; i < trace_no_of_owners; i++)
+	{
+		trace_owner_t *pOwner = &trace_owners[i];
+		uint64_t calls = pOwner->Calls ? pOwner->Calls : 1;
+
+		printf("%-32s %8llu %9llu %9llu %7llu %7llu %9.1f %11.1f\n",
+				trace_owner_name(pOwner->Key), (unsigned long long)pOwner->Calls,
+				(unsigned long long)pOwner->Reads, (unsigned long long)pOwner->Writes,
+				(unsigned long long)pOwner->ReadModifyWrites, (unsigned long long)pOwner->SameValueWrites,
+				(double)(pOwner->Reads + pOwner->Writes) / calls,
+				pOwner->Key == TRACE_OWNER_APP ? 0.0 : (double)pOwner->Cycles / calls);
+	}
+	printf("\n%llu reads, %llu writes, %u cycles, %u access cycles, HCLK %u Hz\n",
+			(unsigned long long)total_reads, (unsigned long long)total_writes,
+			trace_header.Count ? (unsigned)trace_records[trace_header.Count - 1].Cycle : 0,
+			(unsigned)trace_header.AccessCycles, (unsigned)trace_header.Hclk);
+	printf("rmw: write after a read of the same register, same: write of an unchanged value\n");
+	return 0;
+}
+
+/**************************************************************************
+ * replay
+ * ************************************************************************
+ * Repeats the register accesses against the models of this process, with
+ * the simulated time following the trace, and reports reads which give a
+ * different value than recorded (a model or driver behaviour change).
+ * Interrupts are not taken: the handler accesses are in the trace.
+ ****************************************************************************/
+static int trace_replay(void)
+{
+	uint64_t cycle = 0;
+	uint32_t accesses = 0, mismatches = 0;
+
+	sim_set_access_cycles(trace_header.AccessCycles);
+	sim_set_primask(1);
+
+	for(uint32_t i = 0; i < trace_header.Count; i++)
+	{
+		sim_trace_record_t *pRecord = &trace_records[i];
+		volatile uint32_t *pReg = (volatile uint32_t*)(uintptr_t)pRecord->Addr;
+
+		if(pRecord->Type != SIM_TRACE_READ && pRecord->Type != SIM_TRACE_WRITE)
+			continue;
+
+		// 64 bit cycle of the record, then wait like the traced program did
+		cycle += (uint32_t)(pRecord->Cycle - (uint32_t)cycle);
+		if(sim_now + trace_header.AccessCycles < cycle)
+			sim_now = cycle - trace_header.AccessCycles;
+		accesses++;
+
+		if(pRecord->Type == SIM_TRACE_WRITE)
+		{
+			*pReg = pRecord->Value;
+		} else
+		{
+			uint32_t value = *pReg;
+
+			if(value != pRecord->Value)
+			{
+				if(mismatches < 20)
+					printf("record %u, cycle %u: R %-12s 0x%08X, trace has 0x%08X\n", (unsigned)i,
+							(unsigned)pRecord->Cycle, trace_register_name(pRecord->Addr),
+							(unsigned)value, (unsigned)pRecord->Value);
+				mismatches++;
+			}
+		}
+	}
+
+	printf("%u accesses replayed, %u reads differ\n", (unsigned)accesses, (unsigned)mismatches);
+	return mismatches ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "usage: %s dump|summary|replay <trace> [<program>]\n", argv[0]);
+		return 2;
+	}
+	if(trace_load(argv[2]) != 0)
+		return 2;
+	if(argc > 3)
+		trace_load_symbols(argv[3]);
+
+	if(strcmp(argv[1], "dump") == 0)
+		return trace_dump();
+	if(strcmp(argv[1], "summary") == 0)
+		return trace_summary();
+	if(strcmp(argv[1], "replay") == 0)
+		return trace_replay();
+
+	fprintf(stderr, "unknown command %s\n", argv[1]);
+	return 2;
+}
@@ -0,0 +1,423 @@
+/*
+ * Simulator core: register memory, access trapping, simulated time and the
+ * NVIC. See stm32_sim.h for the overview.
+ */
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "stm32_sim_internal.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE			0x100000
+#endif
+
+#define SIM_PAGE_SIZE				4096U
+#define SIM_EFLAGS_TF				(1 << 8)	// x86 trap flag (single step)
+#define SIM_PF_WRITE				(1 << 1)	// page fault error code: write access
+#define SIM_MAX_PENDING				4			// faulting addresses of one instruction
+
+#define SIM_THREAD_PRIORITY			0x100		// lower than any IRQ priority
+
+typedef struct
+{
+	uint32_t Addr;
+	uint8_t IsWrite;
+	uint32_t Old;
+} sim_access_t;
+
+uint64_t sim_now;
+sim_stats_t sim_stats;
+
+static uint8_t *sim_alias;					// RW view of the register memory
+static uint8_t sim_initialized;
+static uint32_t sim_access_cycles = SIM_ACCESS_CYCLES;
+
+static sim_access_t sim_pending[SIM_MAX_PENDING];
+static uint8_t sim_no_of_pending;
+
+// NVIC state
+static uint32_t nvic_enabled[3];
+static uint32_t nvic_pending[3];
+static uint32_t nvic_active[3];
+static uint32_t sim_primask;
+static uint32_t sim_running_priority = SIM_THREAD_PRIORITY;
+static int sim_current_irq = -1;
+
+/*
+ * Helper functions (private to this file)
+ */
+static void sim_segv_handler(int sig, siginfo_t *si, void *pContext);
+static void sim_trap_handler(int sig, siginfo_t *si, void *pContext);
+static void sim_access_begin(uint32_t Addr, uint8_t IsWrite);
+static void sim_access_end(sim_access_t *pAccess);
+static void sim_nvic_after(uint32_t Addr, uint8_t IsWrite, uint32_t Old);
+static void sim_nvic_sync(void);
+static void sim_irq_update(void);
+static uint8_t sim_irq_priority(uint8_t IRQNumber);
+static int sim_irq_next(void);
+
+/**************************************************************************
+ * @fn			- sim_reg
+ *
+ * @brief		- Address of a register in the RW view used by the models.
+ ****************************************************************************/
+volatile uint32_t *sim_reg(uint32_t Addr)
+{
+	if(Addr >= SIM_CORE_BASE)
+		return (volatile uint32_t*)(sim_alias + SIM_PERIPH_SIZE + (Addr - SIM_CORE_BASE));
+	return (volatile uint32_t*)(sim_alias + (Addr - SIM_PERIPH_BASE));
+}
+
+void sim_fatal(const char *pMsg, uint32_t Value)
+{
+	fprintf(stderr, "stm32 sim: %s (0x%08X) at cycle %llu\n", pMsg, (unsigned)Value, (unsigned long long)sim_now);
+	abort();
+}
+
+/**************************************************************************
+ * @fn			- sim_init
+ *
+ * @brief		- Maps the register memory and installs the trap handlers.
+ * 				  Runs automatically before main, later calls do nothing.
+ ****************************************************************************/
+void sim_init(void)
+{
+	struct sigaction sa;
+	int fd;
+
+	if(sim_initialized)
+		return;
+	sim_initialized = 1;
+
+	fd = memfd_create("stm32f407", 0);
+	if(fd < 0 || ftruncate(fd, SIM_PERIPH_SIZE + SIM_CORE_SIZE) < 0)
+		sim_fatal("memfd_create failed", 0);
+
+	sim_alias = mmap(NULL, SIM_PERIPH_SIZE + SIM_CORE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(sim_alias == MAP_FAILED)
+		sim_fatal("alias mapping failed", 0);
+
+	// the driver view: same memory at the real addresses, every access traps
+	if(mmap((void*)(uintptr_t)SIM_PERIPH_BASE, SIM_PERIPH_SIZE, PROT_NONE,
+			MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0) != (void*)(uintptr_t)SIM_PERIPH_BASE)
+		sim_fatal("can not map the peripheral range", SIM_PERIPH_BASE);
+	if(mmap((void*)(uintptr_t)SIM_CORE_BASE, SIM_CORE_SIZE, PROT_NONE,
+			MAP_SHARED | MAP_FIXED_NOREPLACE, fd, SIM_PERIPH_SIZE) != (void*)(uintptr_t)SIM_CORE_BASE)
+		sim_fatal("can not map the Cortex-M private range", SIM_CORE_BASE);
+	close(fd);
+
+	/*
+	 * SA_NODEFER: an interrupt handler runs from the trap handler and its own
+	 * register accesses trap again.
+	 */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sa.sa_sigaction = sim_segv_handler;
+	sigaction(SIGSEGV, &sa, NULL);
+	sa.sa_sigaction = sim_trap_handler;
+	sigaction(SIGTRAP, &sa, NULL);
+
+	sim_periph_reset_all();
+	sim_nvic_sync();
+}
+
+__attribute__((constructor)) static void sim_constructor(void)
+{
+	sim_init();
+}
+
+uint64_t sim_get_cycles(void)
+{
+	return sim_now;
+}
+
+void sim_set_access_cycles(uint32_t Cycles)
+{
+	sim_access_cycles = Cycles;
+}
+
+uint32_t sim_get_access_cycles(void)
+{
+	return sim_access_cycles;
+}
+
+const sim_stats_t *sim_get_stats(void)
+{
+	return &sim_stats;
+}
+
+void sim_reset_stats(void)
+{
+	memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+/**************************************************************************
+ * Access trapping
+ * ************************************************************************
+ * 1. SIGSEGV: note the address, refresh registers with read side effects,
+ *    open the page and set the trap flag.
+ * 2. The instruction runs against the register memory.
+ * 3. SIGTRAP: close the page(s), run the model for the access, deliver
+ *    interrupts which became pending.
+ ****************************************************************************/
+static void sim_segv_handler(int sig, siginfo_t *si, void *pContext)
+{
+	ucontext_t *uc = (ucontext_t*)pContext;
+	uintptr_t addr = (uintptr_t)si->si_addr;
+	uint8_t is_write = (uc->uc_mcontext.gregs[REG_ERR] & SIM_PF_WRITE) ? 1 : 0;
+	(void)sig;
+
+	if(!((addr >= SIM_PERIPH_BASE && addr < SIM_PERIPH_BASE + SIM_PERIPH_SIZE) ||
+		 (addr >= SIM_CORE_BASE && addr < SIM_CORE_BASE + SIM_CORE_SIZE)))
+	{
+		// a real crash, let it happen
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+	if(sim_no_of_pending == SIM_MAX_PENDING)
+		sim_fatal("too many register accesses in one instruction", (uint32_t)addr);
+
+	sim_access_begin((uint32_t)addr & ~3U, is_write);
+	mprotect((void*)(addr & ~(uintptr_t)(SIM_PAGE_SIZE - 1)), SIM_PAGE_SIZE, PROT_READ | PROT_WRITE);
+	uc->uc_mcontext.gregs[REG_EFL] |= SIM_EFLAGS_TF;
+}
+
+static void sim_trap_handler(int sig, siginfo_t *si, void *pContext)
+{
+	ucontext_t *uc = (ucontext_t*)pContext;
+	uint8_t n = sim_no_of_pending;
+	sim_access_t done[SIM_MAX_PENDING];
+	(void)sig;
+	(void)si;
+
+	if(n == 0)
+		sim_fatal("unexpected SIGTRAP", (uint32_t)uc->uc_mcontext.gregs[REG_RIP]);
+
+	uc->uc_mcontext.gregs[REG_EFL] &= ~SIM_EFLAGS_TF;
+	memcpy(done, sim_pending, n * sizeof(sim_access_t));
+	sim_no_of_pending = 0;
+
+	for(uint8_t i = 0; i < n; i++)
+	{
+		mprotect((void*)(uintptr_t)(done[i].Addr & ~(SIM_PAGE_SIZE - 1)), SIM_PAGE_SIZE, PROT_NONE);
+	}
+	for(uint8_t i = 0; i < n; i++)
+	{
+		sim_access_end(&done[i]);
+	}
+
+	// the interrupted instruction is complete: take pending interrupts here
+	sim_irq_poll();
+}
+
+static void sim_access_begin(uint32_t Addr, uint8_t IsWrite)
+{
+	sim_access_t *pAccess = &sim_pending[sim_no_of_pending++];
+
+	sim_now += sim_access_cycles;
+	sim_stats.Accesses++;
+	sim_periph_advance(sim_now);
+
+	sim_periph_before(Addr, IsWrite);
+	pAccess->Addr = Addr;
+	pAccess->IsWrite = IsWrite;
+	pAccess->Old = *sim_reg(Addr);
+}
+
+static void sim_access_end(sim_access_t *pAccess)
+{
+	// the register still holds the value read or written, the model runs next
+	if(sim_tracing)
+		sim_trace_add(pAccess->IsWrite ? SIM_TRACE_WRITE : SIM_TRACE_READ, pAccess->Addr, *sim_reg(pAccess->Addr));
+
+	if(pAccess->Addr >= SIM_NVIC_BASE && pAccess->Addr < SIM_NVIC_END)
+		sim_nvic_after(pAccess->Addr, pAccess->IsWrite, pAccess->Old);
+	else
+		sim_periph_after(pAccess->Addr, pAccess->IsWrite, pAccess->Old);
+}
+
+/**************************************************************************
+ * NVIC
+ * ************************************************************************
+ * Peripheral interrupt lines are level sensitive: an asserted line sets
+ * the pending bit unless the interrupt is active; when the handler returns
+ * with the line still asserted it runs again.
+ ****************************************************************************/
+static void sim_nvic_after(uint32_t Addr, uint8_t IsWrite, uint32_t Old)
+{
+	uint32_t offset = Addr - SIM_NVIC_BASE;
+	uint32_t value = *sim_reg(Addr);
+	uint8_t n = (offset & 0x7F) / 4;
+
+	if(!IsWrite || offset >= 0x300)
+		return;								// IPR is plain memory
+	if(offset >= 0x200 || n >= 3)
+	{
+		*sim_reg(Addr) = Old;				// IABR is read only
+		sim_nvic_sync();
+		return;
+	}
+
+	if(offset < 0x80)
+		nvic_enabled[n] |= value;			// ISER
+	else if(offset < 0x100)
+		nvic_enabled[n] &= ~value;			// ICER
+	else if(offset < 0x180)
+		nvic_pending[n] |= value;			// ISPR
+	else
+		nvic_pending[n] &= ~value;			// ICPR
+
+	sim_nvic_sync();
+}
+
+// registers show the state: ISER/ICER the enabled bits, ISPR/ICPR the pending bits
+static void sim_nvic_sync(void)
+{
+	for(uint8_t n = 0; n < 3; n++)
+	{
+		*sim_reg(SIM_NVIC_BASE + 0x000 + 4 * n) = nvic_enabled[n];
+		*sim_reg(SIM_NVIC_BASE + 0x080 + 4 * n) = nvic_enabled[n];
+		*sim_reg(SIM_NVIC_BASE + 0x100 + 4 * n) = nvic_pending[n];
+		*sim_reg(SIM_NVIC_BASE + 0x180 + 4 * n) = nvic_pending[n];
+		*sim_reg(SIM_NVIC_BASE + 0x200 + 4 * n) = nvic_active[n];
+	}
+}
+
+static void sim_irq_update(void)
+{
+	uint32_t lines[3] = {0, 0, 0};
+
+	sim_periph_irq_lines(lines);
+	for(uint8_t n = 0; n < 3; n++)
+	{
+		nvic_pending[n] |= lines[n] & ~nvic_active[n];
+	}
+	sim_nvic_sync();
+}
+
+static uint8_t sim_irq_priority(uint8_t IRQNumber)
+{
+	volatile uint8_t *pIPR = (volatile uint8_t*)sim_reg(0xE000E400U);
+
+	return pIPR[IRQNumber] >> (8 - NO_PR_BITS_IMPLEMENTED);
+}
+
+// highest priority pending and enabled IRQ which may preempt, -1 if none
+static int sim_irq_next(void)
+{
+	int best = -1;
+	uint32_t best_priority = sim_running_priority;
+
+	for(int irq = 0; irq < SIM_NO_OF_IRQS; irq++)
+	{
+		uint32_t bit = 1U << (irq % 32);
+
+		if((nvic_pending[irq / 32] & nvic_enabled[irq / 32] & bit) && !(nvic_active[irq / 32] & bit))
+		{
+			if(sim_irq_priority(irq) < best_priority)
+			{
+				best = irq;
+				best_priority = sim_irq_priority(irq);
+			}
+		}
+	}
+	return best;
+}
+
+/**************************************************************************
+ * @fn			- sim_irq_poll
+ *
+ * @brief		- Runs the handlers of all pending interrupts which may
+ * 				  preempt the current priority (nothing while PRIMASK is
+ * 				  set). Called after every register access; call it after
+ * 				  sim_gpio_set_input to take EXTI interrupts right away.
+ ****************************************************************************/
+void sim_irq_poll(void)
+{
+	for(;;)
+	{
+		int irq;
+		uint32_t saved_priority;
+		int saved_irq;
+
+		sim_irq_update();
+		if(sim_primask)
+			return;
+		irq = sim_irq_next();
+		if(irq < 0)
+			return;
+
+		nvic_pending[irq / 32] &= ~(1U << (irq % 32));
+		nvic_active[irq / 32] |= (1U << (irq % 32));
+		sim_nvic_sync();
+
+		saved_priority = sim_running_priority;
+		saved_irq = sim_current_irq;
+		sim_running_priority = sim_irq_priority(irq);
+		sim_current_irq = irq;
+		sim_now += SIM_IRQ_ENTRY_CYCLES;
+		sim_stats.Irqs++;
+
+		if(sim_tracing)
+			sim_trace_add(SIM_TRACE_IRQ_ENTER, 0, irq);
+		sim_vectors[irq]();
+		if(sim_tracing)
+			sim_trace_add(SIM_TRACE_IRQ_EXIT, 0, irq);
+
+		sim_current_irq = saved_irq;
+		sim_running_priority = saved_priority;
+		nvic_active[irq / 32] &= ~(1U << (irq % 32));
+	}
+}
+
+// sim_default_handler: the startup code loops forever there
+void sim_unhandled_irq(void)
+{
+	sim_fatal("unhandled interrupt, IRQ number", (uint32_t)sim_current_irq);
+}
+
+uint32_t sim_get_primask(void)
+{
+	return sim_primask;
+}
+
+void sim_set_primask(uint32_t primask)
+{
+	sim_primask = primask & 1;
+	if(!sim_primask)
+		sim_irq_poll();
+}
+
+/**************************************************************************
+ * @fn			- sim_wfi
+ *
+ * @brief		- Wait for interrupt: if nothing is pending, time jumps to
+ * 				  the next event of a peripheral model. With nothing
+ * 				  scheduled it returns at once (the chip would sleep forever).
+ ****************************************************************************/
+void sim_wfi(void)
+{
+	int pending = 0;
+
+	sim_irq_update();
+	for(uint8_t n = 0; n < 3; n++)
+	{
+		if(nvic_pending[n] & nvic_enabled[n])
+			pending = 1;
+	}
+	if(!pending)
+	{
+		uint64_t next = sim_periph_next_event();
+
+		if(next != UINT64_MAX && next > sim_now)
+			sim_now = next;
+		sim_periph_advance(sim_now);
+	}
+	sim_irq_poll();
+}
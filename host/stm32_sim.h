@@ -0,0 +1,153 @@
+#ifndef HOST_STM32_SIM_H_
+#define HOST_STM32_SIM_H_
+
+/****************************************************************************
+ * STM32F407 peripheral simulator for host (Linux x86-64) builds
+ *
+ * The drivers are compiled unchanged with -DSTM32_HOST_SIM. The peripheral
+ * (0x40000000) and Cortex-M private (0xE0000000) address ranges are mapped
+ * at their real addresses without access rights. Every register access
+ * faults, the simulator lets the single instruction run against the register
+ * memory (trap flag) and then runs the behavioural model of the peripheral:
+ *
+ * - RCC: ready flags follow the enable bits, SWS follows SW, reset pulses
+ *   on AHB1RSTR/APB1RSTR/APB2RSTR reset GPIO, DMA, SPI, TIM and SYSCFG, writes to a
+ *   peripheral with its clock off are dropped (like on the chip)
+ * - GPIOA..I: IDR from ODR (outputs) or the level set by sim_gpio_set_input
+ *   (inputs, pull-up/down otherwise), BSRR
+ * - EXTI/SYSCFG: edge detection on the pin selected by EXTICR, PR latching,
+ *   SWIER, pending bit clearing
+ * - SPI1..4 (master): TX buffer + shift register, TXE/RXNE/BSY/OVR/MODF,
+ *   frame time from BR, DFF and the APB prescaler; the slave is a callback
+ * - USART1..6: receiver with RXNE, IDLE and the error flags (cleared by an
+ *   SR read followed by a DR read), RX DMA request and interrupts; frames
+ *   come from sim_usart_receive and the idle line from sim_usart_idle, the
+ *   transmitter is always ready
+ * - TIM1..8: time base only (up counting, update interrupt and update DMA
+ *   request, UG, OPM), the counter clock follows PSC and the APB prescaler
+ * - DMA1/DMA2: the 16 streams with the SPI, USART RX and timer update
+ *   requests of the request mapping, NDTR, HT/TC flags and interrupts,
+ *   circular and double buffer mode, memory to memory; data moves take no
+ *   simulated time
+ * - NVIC: ISER/ICER/ISPR/ICPR/IABR/IPR, priorities, PRIMASK; the IRQ
+ *   handlers are the usual xxx_IRQHandler functions of the application
+ * - DWT CYCCNT counts simulated CPU cycles, ITM stimulus ports are always
+ *   ready
+ * - optional trace of every register access (see below)
+ *
+ * Any other register is plain memory (no behaviour).
+ *
+ * Time is simulated: each register access costs SIM_ACCESS_CYCLES CPU
+ * cycles, an interrupt entry SIM_IRQ_ENTRY_CYCLES. So cycle counts measure
+ * the bus traffic and the waiting of a driver, not the instructions in
+ * between. The CPU clock follows RCC (16 MHz HSI after reset).
+ *
+ * The simulator starts before main (constructor). Build with host/Makefile
+ * (non-PIE, so buffer addresses fit the 32-bit DMA registers).
+ ****************************************************************************/
+
+#include <stdint.h>
+#include "stm32f407xx.h"
+
+#define SIM_ACCESS_CYCLES			4	// default cost of one register access
+#define SIM_IRQ_ENTRY_CYCLES		12	// Cortex-M4 exception entry
+
+/*
+ * SPI slave model: called once per frame with the MOSI frame (8 or 16 bit),
+ * returns the MISO frame.
+ */
+typedef uint16_t (*sim_spi_xfer_t)(void *pContext, uint16_t Mosi);
+
+/*
+ * Outside world watching a GPIO port: called with the old and the new IDR
+ * whenever a pin of the port changes level (e.g. a chip select).
+ */
+typedef void (*sim_gpio_watch_t)(void *pContext, uint16_t OldIdr, uint16_t NewIdr);
+
+typedef struct
+{
+	uint64_t Accesses;				/* trapped register accesses */
+	uint64_t Irqs;					/* interrupt handlers run */
+	uint64_t UnclockedWrites;		/* writes dropped because the clock was off */
+	uint64_t SpiFrames;				/* frames shifted on all SPIs */
+	uint64_t DmaItems;				/* data items moved by DMA1/DMA2 */
+} sim_stats_t;
+
+/***********************************************************************
+ * Simulator control
+ ***********************************************************************/
+void sim_init(void);
+uint64_t sim_get_cycles(void);
+uint32_t sim_get_hclk(void);
+void sim_set_access_cycles(uint32_t Cycles);
+uint32_t sim_get_access_cycles(void);
+const sim_stats_t *sim_get_stats(void);
+void sim_reset_stats(void);
+
+/***********************************************************************
+ * CPU (used by the device header intrinsics)
+ ***********************************************************************/
+uint32_t sim_get_primask(void);
+void sim_set_primask(uint32_t primask);
+void sim_irq_poll(void);
+void sim_wfi(void);
+
+/***********************************************************************
+ * Register access trace (stm32_sim_trace.c)
+ *
+ * Every trapped access, and with the drivers built with TRACE=1
+ * (-finstrument-functions) every driver function entry and exit, is
+ * appended to an in-memory buffer. STM32_SIM_TRACE=<file> in the
+ * environment traces the whole run and saves it at exit. build/sim_trace
+ * decodes, summarises per API call and replays a saved trace.
+ ***********************************************************************/
+#define SIM_TRACE_READ				0	// Addr = register, Value = value read
+#define SIM_TRACE_WRITE				1	// Addr = register, Value = value written
+#define SIM_TRACE_ENTER				2	// Addr = driver function
+#define SIM_TRACE_EXIT				3	// Addr = driver function
+#define SIM_TRACE_IRQ_ENTER			4	// Value = IRQ number
+#define SIM_TRACE_IRQ_EXIT			5	// Value = IRQ number
+
+#define SIM_TRACE_MAGIC				"STM32TRC"
+#define SIM_TRACE_VERSION			1
+
+typedef struct
+{
+	uint32_t Cycle;					/* simulated cycle, low 32 bits */
+	uint32_t Addr;
+	uint32_t Value;
+	uint8_t Type;					/* SIM_TRACE_xxx */
+	uint8_t Reserved[3];
+} sim_trace_record_t;
+
+// trace file: this header, then Count records
+typedef struct
+{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t RecordSize;
+	uint32_t Count;
+	uint32_t Dropped;				/* records lost because the buffer was full */
+	uint32_t Hclk;
+	uint32_t AccessCycles;
+} sim_trace_header_t;
+
+void sim_trace_start(uint32_t MaxRecords);
+void sim_trace_stop(void);
+int sim_trace_save(const char *pPath);
+uint32_t sim_trace_count(void);
+const sim_trace_record_t *sim_trace_records(void);
+
+/***********************************************************************
+ * Outside world
+ ***********************************************************************/
+void sim_spi_attach(SPI_RegDef_t *pSPIx, sim_spi_xfer_t Xfer, void *pContext);
+// Errors: USART_SR_PE/FE/NF bits of the frame; a frame while RXNE is set sets ORE
+void sim_usart_receive(USART_RegDef_t *pUSARTx, uint16_t Data, uint32_t Errors);
+void sim_usart_idle(USART_RegDef_t *pUSARTx);
+void sim_gpio_set_input(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Level);
+void sim_gpio_release_input(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber);
+uint8_t sim_gpio_get_pin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber);
+void sim_gpio_watch(GPIO_RegDef_t *pGPIOx, sim_gpio_watch_t Watch, void *pContext);
+
+#endif /* HOST_STM32_SIM_H_ */
@@ -0,0 +1,45 @@
+#ifndef HOST_STM32_SIM_INTERNAL_H_
+#define HOST_STM32_SIM_INTERNAL_H_
+
+/*
+ * Shared between the simulator core (stm32_sim.c) and the peripheral
+ * models (stm32_sim_periph.c). Not for applications.
+ */
+#include "stm32_sim.h"
+
+#define SIM_NO_OF_IRQS				96
+
+#define SIM_PERIPH_BASE				0x40000000U
+#define SIM_PERIPH_SIZE				0x00080000U // APB1, APB2, AHB1
+#define SIM_CORE_BASE				0xE0000000U
+#define SIM_CORE_SIZE				0x00100000U // ITM, DWT, NVIC, SCB
+
+#define SIM_NVIC_BASE				0xE000E100U
+#define SIM_NVIC_END				0xE000E500U
+
+typedef void (*sim_handler_t)(void);
+
+extern const sim_handler_t sim_vectors[SIM_NO_OF_IRQS];
+extern uint64_t sim_now;
+extern sim_stats_t sim_stats;
+
+// register memory as seen by the models (never traps)
+volatile uint32_t *sim_reg(uint32_t Addr);
+
+// core
+void sim_fatal(const char *pMsg, uint32_t Value);
+void sim_unhandled_irq(void);
+
+// trace recorder
+extern uint8_t sim_tracing;
+void sim_trace_add(uint8_t Type, uint32_t Addr, uint32_t Value);
+
+// peripheral models
+void sim_periph_reset_all(void);
+void sim_periph_before(uint32_t Addr, uint8_t IsWrite);
+void sim_periph_after(uint32_t Addr, uint8_t IsWrite, uint32_t Old);
+void sim_periph_advance(uint64_t Now);
+uint64_t sim_periph_next_event(void);
+void sim_periph_irq_lines(uint32_t Lines[3]);
+
+#endif /* HOST_STM32_SIM_INTERNAL_H_ */
@@ -0,0 +1,1428 @@
+/*
+ * Behavioural models of RCC, GPIO, EXTI, SYSCFG, SPI, TIM, DMA, ITM and DWT.
+ * See stm32_sim.h for what is modelled.
+ */
+#include <stdio.h>
+
+#include "stm32_sim_internal.h"
+
+#define SIM_R(addr)					(*sim_reg(addr))
+
+#define SIM_NO_OF_GPIO				9
+#define SIM_NO_OF_SPI				4
+#define SIM_NO_OF_USART				6
+#define SIM_NO_OF_TIM				8
+#define SIM_NO_OF_DMA				2
+
+// RCC register offsets
+#define RCC_OFF_CR					0x00
+#define RCC_OFF_PLLCFGR				0x04
+#define RCC_OFF_CFGR				0x08
+#define RCC_OFF_AHB1RSTR			0x10
+#define RCC_OFF_APB1RSTR			0x20
+#define RCC_OFF_APB2RSTR			0x24
+#define RCC_OFF_AHB1ENR				0x30
+#define RCC_OFF_APB1ENR				0x40
+#define RCC_OFF_APB2ENR				0x44
+
+// GPIO register offsets
+#define GPIO_OFF_MODER				0x00
+#define GPIO_OFF_OTYPER				0x04
+#define GPIO_OFF_OSPEEDR			0x08
+#define GPIO_OFF_PUPDR				0x0C
+#define GPIO_OFF_IDR				0x10
+#define GPIO_OFF_ODR				0x14
+#define GPIO_OFF_BSRR				0x18
+
+// EXTI register offsets
+#define EXTI_OFF_IMR				0x00
+#define EXTI_OFF_RTSR				0x08
+#define EXTI_OFF_FTSR				0x0C
+#define EXTI_OFF_SWIER				0x10
+#define EXTI_OFF_PR					0x14
+
+// SPI register offsets
+#define SPI_OFF_CR1					0x00
+#define SPI_OFF_CR2					0x04
+#define SPI_OFF_SR					0x08
+#define SPI_OFF_DR					0x0C
+#define SPI_OFF_CRCPR				0x10
+#define SPI_OFF_I2SPR				0x20
+
+// USART registers
+#define USART_OFF_SR				0x00
+#define USART_OFF_DR				0x04
+#define USART_OFF_CR1				0x0C
+#define USART_OFF_CR3				0x14
+
+// TIM register offsets
+#define TIM_OFF_CR1					0x00
+#define TIM_OFF_DIER				0x0C
+#define TIM_OFF_SR					0x10
+#define TIM_OFF_EGR					0x14
+#define TIM_OFF_CNT					0x24
+#define TIM_OFF_PSC					0x28
+#define TIM_OFF_ARR					0x2C
+
+// DMA register offsets, stream x registers at 0x10 + 0x18 * x
+#define DMA_OFF_LISR				0x00
+#define DMA_OFF_HISR				0x04
+#define DMA_OFF_LIFCR				0x08
+#define DMA_OFF_HIFCR				0x0C
+#define DMA_OFF_STREAM				0x10
+#define DMA_STREAM_SIZE				0x18
+#define DMA_OFF_SxCR				0x00
+#define DMA_OFF_SxNDTR				0x04
+#define DMA_OFF_SxPAR				0x08
+#define DMA_OFF_SxM0AR				0x0C
+#define DMA_OFF_SxM1AR				0x10
+#define DMA_OFF_SxFCR				0x14
+
+// DMA request sources
+#define SIM_DMA_SPI_RX				0
+#define SIM_DMA_SPI_TX				1
+#define SIM_DMA_TIM_UP				2
+#define SIM_DMA_USART_RX			3
+
+#define ITM_PORT_END				(ITM_BASEADDR + 0x80)
+#define DWT_CTRL_ADDR				0xE0001000U
+#define DWT_CYCCNT_ADDR				0xE0001004U
+
+// outside world driving a GPIO port
+typedef struct
+{
+	uint16_t Level;
+	uint16_t Driven;
+	sim_gpio_watch_t Watch;
+	void *pContext;
+} sim_gpio_t;
+
+typedef struct
+{
+	uint32_t Base;
+	uint8_t IRQNumber;
+	uint8_t RccOffset;				/* APB1 or APB2 enable register */
+	uint8_t RccBit;					/* same bit in the reset register */
+	sim_spi_xfer_t Xfer;
+	void *pContext;
+	uint16_t TxBuffer;
+	uint8_t TxFull;
+	uint16_t Shift;
+	uint8_t Shifting;
+	uint64_t DoneAt;				/* end of the frame in the shift register */
+	uint16_t RxBuffer;
+	uint8_t OvrDrRead;				/* OVR clear sequence: DR read, then SR read */
+	uint8_t ModfSrRead;				/* MODF clear sequence: SR access, then CR1 write */
+} sim_spi_t;
+
+// receiver of a USART, the transmitter is always ready
+typedef struct
+{
+	uint32_t Base;
+	uint8_t IRQNumber;
+	uint8_t RccOffset;
+	uint8_t RccBit;
+	uint16_t RxData;				/* what DR reads */
+	uint8_t SrRead;					/* error/IDLE clear sequence: SR read, then DR read */
+} sim_usart_t;
+
+// basic time base of a timer: update events only, counting up
+typedef struct
+{
+	uint32_t Base;
+	uint8_t IRQNumber;				/* update interrupt */
+	uint8_t RccOffset;
+	uint8_t RccBit;
+	uint8_t Running;
+	uint8_t UpdateReq;				/* DMA request pending (UDE) */
+	uint64_t LastUpdate;			/* sim_now when CNT was 0 */
+	uint64_t NextUpdate;
+} sim_tim_t;
+
+// working copy of a stream's addresses, loaded when EN is set
+typedef struct
+{
+	uint8_t Running;
+	uint16_t Items;					/* NDTR at enable, reloaded in circular mode */
+	uint32_t Periph;
+	uint32_t Mem;
+} sim_dma_stream_t;
+
+// one line of the DMA1/DMA2 request mapping (RM0090 tables 42 and 43)
+typedef struct
+{
+	uint8_t Ctrl;					/* 0: DMA1, 1: DMA2 */
+	uint8_t Stream;
+	uint8_t Channel;
+	uint8_t Source;					/* SIM_DMA_xxx */
+	uint8_t Unit;					/* index in sim_spi or sim_tim */
+} sim_dma_req_t;
+
+static sim_gpio_t sim_gpio[SIM_NO_OF_GPIO];
+
+static sim_spi_t sim_spi[SIM_NO_OF_SPI] =
+{
+	{ .Base = SPI1_BASEADDR, .IRQNumber = 35, .RccOffset = RCC_OFF_APB2ENR, .RccBit = 12 },
+	{ .Base = SPI2_BASEADDR, .IRQNumber = 36, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 14 },
+	{ .Base = SPI3_BASEADDR, .IRQNumber = 51, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 15 },
+	{ .Base = SPI4_BASEADDR, .IRQNumber = 84, .RccOffset = RCC_OFF_APB2ENR, .RccBit = 13 },
+};
+
+static sim_usart_t sim_usart[SIM_NO_OF_USART] =
+{
+	{ .Base = USART1_BASEADDR, .IRQNumber = 37, .RccOffset = RCC_OFF_APB2ENR, .RccBit = 4 },
+	{ .Base = USART2_BASEADDR, .IRQNumber = 38, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 17 },
+	{ .Base = USART3_BASEADDR, .IRQNumber = 39, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 18 },
+	{ .Base = UART4_BASEADDR, .IRQNumber = 52, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 19 },
+	{ .Base = UART5_BASEADDR, .IRQNumber = 53, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 20 },
+	{ .Base = USART6_BASEADDR, .IRQNumber = 71, .RccOffset = RCC_OFF_APB2ENR, .RccBit = 5 },
+};
+
+static sim_tim_t sim_tim[SIM_NO_OF_TIM] =
+{
+	{ .Base = TIM1_BASEADDR, .IRQNumber = 25, .RccOffset = RCC_OFF_APB2ENR, .RccBit = 0 },
+	{ .Base = TIM2_BASEADDR, .IRQNumber = 28, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 0 },
+	{ .Base = TIM3_BASEADDR, .IRQNumber = 29, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 1 },
+	{ .Base = TIM4_BASEADDR, .IRQNumber = 30, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 2 },
+	{ .Base = TIM5_BASEADDR, .IRQNumber = 50, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 3 },
+	{ .Base = TIM6_BASEADDR, .IRQNumber = 54, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 4 },
+	{ .Base = TIM7_BASEADDR, .IRQNumber = 55, .RccOffset = RCC_OFF_APB1ENR, .RccBit = 5 },
+	{ .Base = TIM8_BASEADDR, .IRQNumber = 44, .RccOffset = RCC_OFF_APB2ENR, .RccBit = 1 },
+};
+
+static const uint32_t sim_dma_base[SIM_NO_OF_DMA] = { DMA1_BASEADDR, DMA2_BASEADDR };
+static const uint8_t sim_dma_irq[SIM_NO_OF_DMA][8] =
+{
+	{ 11, 12, 13, 14, 15, 16, 17, 47 },
+	{ 56, 57, 58, 59, 60, 68, 69, 70 },
+};
+static const uint8_t sim_dma_flag_shift[4] = { 0, 6, 16, 22 };
+static sim_dma_stream_t sim_dma[SIM_NO_OF_DMA][8];
+
+static const sim_dma_req_t sim_dma_reqs[] =
+{
+	// SPI1..4 RX and TX
+	{ 1, 0, 3, SIM_DMA_SPI_RX, 0 }, { 1, 2, 3, SIM_DMA_SPI_RX, 0 },
+	{ 1, 3, 3, SIM_DMA_SPI_TX, 0 }, { 1, 5, 3, SIM_DMA_SPI_TX, 0 },
+	{ 0, 3, 0, SIM_DMA_SPI_RX, 1 }, { 0, 4, 0, SIM_DMA_SPI_TX, 1 },
+	{ 0, 0, 0, SIM_DMA_SPI_RX, 2 }, { 0, 2, 0, SIM_DMA_SPI_RX, 2 },
+	{ 0, 5, 0, SIM_DMA_SPI_TX, 2 }, { 0, 7, 0, SIM_DMA_SPI_TX, 2 },
+	{ 1, 0, 4, SIM_DMA_SPI_RX, 3 }, { 1, 3, 5, SIM_DMA_SPI_RX, 3 },
+	{ 1, 1, 4, SIM_DMA_SPI_TX, 3 }, { 1, 4, 5, SIM_DMA_SPI_TX, 3 },
+	// TIM1..8 update
+	{ 1, 5, 6, SIM_DMA_TIM_UP, 0 },
+	{ 0, 1, 3, SIM_DMA_TIM_UP, 1 }, { 0, 7, 3, SIM_DMA_TIM_UP, 1 },
+	{ 0, 2, 5, SIM_DMA_TIM_UP, 2 },
+	{ 0, 6, 2, SIM_DMA_TIM_UP, 3 },
+	{ 0, 0, 6, SIM_DMA_TIM_UP, 4 }, { 0, 6, 6, SIM_DMA_TIM_UP, 4 },
+	{ 0, 1, 7, SIM_DMA_TIM_UP, 5 },
+	{ 0, 2, 1, SIM_DMA_TIM_UP, 6 }, { 0, 4, 1, SIM_DMA_TIM_UP, 6 },
+	{ 1, 1, 7, SIM_DMA_TIM_UP, 7 },
+	// USART1..3, UART4, UART5, USART6 RX
+	{ 1, 2, 4, SIM_DMA_USART_RX, 0 }, { 1, 5, 4, SIM_DMA_USART_RX, 0 },
+	{ 0, 5, 4, SIM_DMA_USART_RX, 1 },
+	{ 0, 1, 4, SIM_DMA_USART_RX, 2 },
+	{ 0, 2, 4, SIM_DMA_USART_RX, 3 },
+	{ 0, 0, 4, SIM_DMA_USART_RX, 4 },
+	{ 1, 1, 5, SIM_DMA_USART_RX, 5 }, { 1, 2, 5, SIM_DMA_USART_RX, 5 },
+};
+
+static uint64_t sim_dwt_base;				// sim_now when CYCCNT was 0
+
+/*
+ * Helper functions (private to this file)
+ */
+static uint8_t sim_drop_unclocked(uint32_t Addr, uint8_t IsWrite, uint32_t Old, uint8_t EnrOffset, uint8_t Bit);
+static uint32_t sim_apb_div(uint8_t EnrOffset);
+static void sim_rcc_reset(void);
+static void sim_rcc_after(uint32_t Offset, uint8_t IsWrite);
+static void sim_gpio_reset(uint8_t Port);
+static void sim_gpio_update(uint8_t Port);
+static void sim_gpio_after(uint8_t Port, uint32_t Offset, uint8_t IsWrite, uint32_t Old);
+static void sim_exti_edges(uint8_t Port, uint16_t OldIdr, uint16_t NewIdr);
+static void sim_exti_after(uint32_t Offset, uint8_t IsWrite, uint32_t Old);
+static void sim_syscfg_reset(void);
+static void sim_spi_reset(sim_spi_t *pSpi);
+static uint32_t sim_spi_frame_cycles(sim_spi_t *pSpi);
+static void sim_spi_start(sim_spi_t *pSpi, uint16_t Data, uint64_t From);
+static void sim_spi_complete(sim_spi_t *pSpi);
+static void sim_spi_after(sim_spi_t *pSpi, uint32_t Offset, uint8_t IsWrite, uint32_t Old);
+static void sim_usart_reset(sim_usart_t *pUsart);
+static void sim_usart_after(sim_usart_t *pUsart, uint32_t Offset, uint8_t IsWrite, uint32_t Old);
+static void sim_tim_reset(sim_tim_t *pTim);
+static uint64_t sim_tim_update_cycles(sim_tim_t *pTim);
+static uint32_t sim_tim_count_cycles(sim_tim_t *pTim);
+static void sim_tim_update(sim_tim_t *pTim);
+static void sim_tim_after(sim_tim_t *pTim, uint32_t Offset, uint8_t IsWrite, uint32_t Old);
+static void sim_dma_reset(uint8_t Ctrl);
+static void sim_dma_flag(uint8_t Ctrl, uint8_t Stream, uint8_t Flag);
+static uint32_t sim_dma_read(uint32_t Addr, uint8_t Size);
+static void sim_dma_write(uint32_t Addr, uint8_t Size, uint32_t Value);
+static uint8_t sim_dma_requested(const sim_dma_req_t *pReq);
+static void sim_dma_item(uint8_t Ctrl, uint8_t Stream);
+static void sim_dma_service(void);
+static void sim_dma_after(uint8_t Ctrl, uint32_t Offset, uint8_t IsWrite, uint32_t Old);
+static uint64_t sim_periph_earliest(sim_spi_t **ppSpi, sim_tim_t **ppTim);
+
+static uint32_t sim_gpio_base(uint8_t Port)
+{
+	return GPIOA_BASEADDR + 0x400U * Port;
+}
+
+static uint8_t sim_gpio_port(GPIO_RegDef_t *pGPIOx)
+{
+	uint32_t addr = (uint32_t)(uintptr_t)pGPIOx;
+
+	if(addr < GPIOA_BASEADDR || addr >= GPIOA_BASEADDR + SIM_NO_OF_GPIO * 0x400U)
+		sim_fatal("not a GPIO port", addr);
+	return (addr - GPIOA_BASEADDR) / 0x400U;
+}
+
+/*
+ * Registers of a peripheral whose clock is off (or which is held in reset)
+ * do not take writes on the chip. Returns 1 if the write was dropped.
+ */
+static uint8_t sim_drop_unclocked(uint32_t Addr, uint8_t IsWrite, uint32_t Old, uint8_t EnrOffset, uint8_t Bit)
+{
+	static uint8_t warned;
+	uint8_t rstr_offset = EnrOffset - (RCC_OFF_AHB1ENR - RCC_OFF_AHB1RSTR);
+
+	if(!IsWrite)
+		return 0;
+	if((SIM_R(RCC_BASEADDR + EnrOffset) & (1U << Bit)) && !(SIM_R(RCC_BASEADDR + rstr_offset) & (1U << Bit)))
+		return 0;
+
+	SIM_R(Addr) = Old;
+	sim_stats.UnclockedWrites++;
+	if(!warned)
+	{
+		warned = 1;
+		fprintf(stderr, "stm32 sim: write to 0x%08X with the peripheral clock off, dropped\n", (unsigned)Addr);
+	}
+	return 1;
+}
+
+/**************************************************************************
+ * Model dispatch (called by the core around every register access)
+ ****************************************************************************/
+void sim_periph_reset_all(void)
+{
+	sim_rcc_reset();
+	for(uint8_t port = 0; port < SIM_NO_OF_GPIO; port++)
+		sim_gpio_reset(port);
+	sim_syscfg_reset();
+	for(uint8_t i = 0; i < SIM_NO_OF_SPI; i++)
+		sim_spi_reset(&sim_spi[i]);
+	for(uint8_t i = 0; i < SIM_NO_OF_USART; i++)
+		sim_usart_reset(&sim_usart[i]);
+	for(uint8_t i = 0; i < SIM_NO_OF_TIM; i++)
+		sim_tim_reset(&sim_tim[i]);
+	for(uint8_t ctrl = 0; ctrl < SIM_NO_OF_DMA; ctrl++)
+		sim_dma_reset(ctrl);
+	for(uint32_t addr = ITM_BASEADDR; addr < ITM_PORT_END; addr += 4)
+		SIM_R(addr) = 1;
+}
+
+void sim_periph_before(uint32_t Addr, uint8_t IsWrite)
+{
+	if(Addr == DWT_CYCCNT_ADDR && !IsWrite && (SIM_R(DWT_CTRL_ADDR) & 1))
+		SIM_R(DWT_CYCCNT_ADDR) = (uint32_t)(sim_now - sim_dwt_base);
+
+	for(uint8_t i = 0; i < SIM_NO_OF_TIM; i++)
+	{
+		sim_tim_t *pTim = &sim_tim[i];
+
+		if(Addr == pTim->Base + TIM_OFF_CNT && !IsWrite && pTim->Running)
+			SIM_R(Addr) = (uint32_t)((sim_now - pTim->LastUpdate) / sim_tim_count_cycles(pTim));
+	}
+}
+
+void sim_periph_after(uint32_t Addr, uint8_t IsWrite, uint32_t Old)
+{
+	if(Addr >= RCC_BASEADDR && Addr < RCC_BASEADDR + 0x400)
+	{
+		sim_rcc_after(Addr - RCC_BASEADDR, IsWrite);
+	} else if(Addr >= GPIOA_BASEADDR && Addr < GPIOA_BASEADDR + SIM_NO_OF_GPIO * 0x400U)
+	{
+		sim_gpio_after((Addr - GPIOA_BASEADDR) / 0x400U, Addr & 0x3FF, IsWrite, Old);
+	} else if(Addr >= EXTI_BASEADDR && Addr < EXTI_BASEADDR + 0x400)
+	{
+		sim_exti_after(Addr - EXTI_BASEADDR, IsWrite, Old);
+	} else if(Addr >= SYSCFG_BASEADDR && Addr < SYSCFG_BASEADDR + 0x400)
+	{
+		sim_drop_unclocked(Addr, IsWrite, Old, RCC_OFF_APB2ENR, 14);
+	} else if(Addr >= ITM_BASEADDR && Addr < ITM_PORT_END)
+	{
+		if(IsWrite)
+			SIM_R(Addr) = 1;		// stimulus port FIFO always ready
+	} else if(Addr == DWT_CYCCNT_ADDR && IsWrite)
+	{
+		sim_dwt_base = sim_now - SIM_R(DWT_CYCCNT_ADDR);
+	} else if(Addr == DWT_CTRL_ADDR && IsWrite)
+	{
+		if((SIM_R(DWT_CTRL_ADDR) & 1) && !(Old & 1))
+			sim_dwt_base = sim_now - SIM_R(DWT_CYCCNT_ADDR);
+	} else
+	{
+		for(uint8_t i = 0; i < SIM_NO_OF_SPI; i++)
+		{
+			if(Addr >= sim_spi[i].Base && Addr < sim_spi[i].Base + 0x400)
+				sim_spi_after(&sim_spi[i], Addr - sim_spi[i].Base, IsWrite, Old);
+		}
+		for(uint8_t i = 0; i < SIM_NO_OF_USART; i++)
+		{
+			if(Addr >= sim_usart[i].Base && Addr < sim_usart[i].Base + 0x400)
+				sim_usart_after(&sim_usart[i], Addr - sim_usart[i].Base, IsWrite, Old);
+		}
+		for(uint8_t i = 0; i < SIM_NO_OF_TIM; i++)
+		{
+			if(Addr >= sim_tim[i].Base && Addr < sim_tim[i].Base + 0x400)
+				sim_tim_after(&sim_tim[i], Addr - sim_tim[i].Base, IsWrite, Old);
+		}
+		for(uint8_t ctrl = 0; ctrl < SIM_NO_OF_DMA; ctrl++)
+		{
+			if(Addr >= sim_dma_base[ctrl] && Addr < sim_dma_base[ctrl] + 0x400)
+				sim_dma_after(ctrl, Addr - sim_dma_base[ctrl], IsWrite, Old);
+		}
+	}
+
+	// the access may have raised a DMA request (or enabled a stream)
+	sim_dma_service();
+}
+
+// SPI frame end or timer update which comes first
+static uint64_t sim_periph_earliest(sim_spi_t **ppSpi, sim_tim_t **ppTim)
+{
+	uint64_t next = UINT64_MAX;
+
+	*ppSpi = 0;
+	*ppTim = 0;
+	for(uint8_t i = 0; i < SIM_NO_OF_SPI; i++)
+	{
+		if(sim_spi[i].Shifting && sim_spi[i].DoneAt < next)
+		{
+			next = sim_spi[i].DoneAt;
+			*ppSpi = &sim_spi[i];
+		}
+	}
+	for(uint8_t i = 0; i < SIM_NO_OF_TIM; i++)
+	{
+		if(sim_tim[i].Running && sim_tim[i].NextUpdate < next)
+		{
+			next = sim_tim[i].NextUpdate;
+			*ppSpi = 0;
+			*ppTim = &sim_tim[i];
+		}
+	}
+	return next;
+}
+
+// events in time order, DMA requests are served after each one
+void sim_periph_advance(uint64_t Now)
+{
+	sim_spi_t *pSpi;
+	sim_tim_t *pTim;
+
+	while(sim_periph_earliest(&pSpi, &pTim) <= Now)
+	{
+		if(pTim)
+			sim_tim_update(pTim);
+		else
+			sim_spi_complete(pSpi);
+		sim_dma_service();
+	}
+}
+
+uint64_t sim_periph_next_event(void)
+{
+	sim_spi_t *pSpi;
+	sim_tim_t *pTim;
+
+	return sim_periph_earliest(&pSpi, &pTim);
+}
+
+void sim_periph_irq_lines(uint32_t Lines[3])
+{
+	uint32_t exti = SIM_R(EXTI_BASEADDR + EXTI_OFF_PR) & SIM_R(EXTI_BASEADDR + EXTI_OFF_IMR);
+
+	// EXTI0..4 have their own IRQs, 5..9 and 10..15 share one
+	for(uint8_t line = 0; line < 5; line++)
+	{
+		if(exti & (1U << line))
+			Lines[0] |= 1U << (IRQ_NO_EXTI0 + line);
+	}
+	if(exti & 0x03E0)
+		Lines[IRQ_NO_EXTI9_5 / 32] |= 1U << (IRQ_NO_EXTI9_5 % 32);
+	if(exti & 0xFC00)
+		Lines[IRQ_NO_EXTI15_10 / 32] |= 1U << (IRQ_NO_EXTI15_10 % 32);
+
+	for(uint8_t i = 0; i < SIM_NO_OF_SPI; i++)
+	{
+		uint32_t sr = SIM_R(sim_spi[i].Base + SPI_OFF_SR);
+		uint32_t cr2 = SIM_R(sim_spi[i].Base + SPI_OFF_CR2);
+
+		if(((sr & (1 << SPI_SR_TXE)) && (cr2 & (1 << SPI_CR2_TXEIE))) ||
+		   ((sr & (1 << SPI_SR_RXNE)) && (cr2 & (1 << SPI_CR2_RXNEIE))) ||
+		   ((sr & ((1 << SPI_SR_OVR) | (1 << SPI_SR_MODF))) && (cr2 & (1 << SPI_CR2_ERRIE))))
+			Lines[sim_spi[i].IRQNumber / 32] |= 1U << (sim_spi[i].IRQNumber % 32);
+	}
+
+	for(uint8_t i = 0; i < SIM_NO_OF_USART; i++)
+	{
+		uint32_t sr = SIM_R(sim_usart[i].Base + USART_OFF_SR);
+		uint32_t cr1 = SIM_R(sim_usart[i].Base + USART_OFF_CR1);
+		uint32_t cr3 = SIM_R(sim_usart[i].Base + USART_OFF_CR3);
+		uint32_t errors = (1 << USART_SR_FE) | (1 << USART_SR_NF) | (1 << USART_SR_ORE);
+
+		// FE and NF only interrupt with EIE in DMA reception (DMAR)
+		if(((sr & (1 << USART_SR_TXE)) && (cr1 & (1 << USART_CR1_TXEIE))) ||
+		   ((sr & (1 << USART_SR_TC)) && (cr1 & (1 << USART_CR1_TCIE))) ||
+		   ((sr & ((1 << USART_SR_RXNE) | (1 << USART_SR_ORE))) && (cr1 & (1 << USART_CR1_RXNEIE))) ||
+		   ((sr & (1 << USART_SR_IDLE)) && (cr1 & (1 << USART_CR1_IDLEIE))) ||
+		   ((sr & (1 << USART_SR_PE)) && (cr1 & (1 << USART_CR1_PEIE))) ||
+		   ((sr & errors) && (cr3 & (1 << USART_CR3_EIE)) && (cr3 & (1 << USART_CR3_DMAR))))
+			Lines[sim_usart[i].IRQNumber / 32] |= 1U << (sim_usart[i].IRQNumber % 32);
+	}
+
+	for(uint8_t i = 0; i < SIM_NO_OF_TIM; i++)
+	{
+		if((SIM_R(sim_tim[i].Base + TIM_OFF_SR) & (1 << TIM_SR_UIF)) &&
+		   (SIM_R(sim_tim[i].Base + TIM_OFF_DIER) & (1 << TIM_DIER_UIE)))
+			Lines[sim_tim[i].IRQNumber / 32] |= 1U << (sim_tim[i].IRQNumber % 32);
+	}
+
+	for(uint8_t ctrl = 0; ctrl < SIM_NO_OF_DMA; ctrl++)
+	{
+		for(uint8_t stream = 0; stream < 8; stream++)
+		{
+			uint32_t sbase = sim_dma_base[ctrl] + DMA_OFF_STREAM + DMA_STREAM_SIZE * stream;
+			uint32_t isr = SIM_R(sim_dma_base[ctrl] + (stream < 4 ? DMA_OFF_LISR : DMA_OFF_HISR));
+			uint32_t flags = (isr >> sim_dma_flag_shift[stream % 4]) & 0x3D;
+			uint32_t cr = SIM_R(sbase + DMA_OFF_SxCR);
+			uint32_t enabled = 0;
+			uint8_t irq = sim_dma_irq[ctrl][stream];
+
+			// TCIE..DMEIE are one bit below TCIF..DMEIF
+			enabled |= (cr & ((1 << DMA_SxCR_TCIE) | (1 << DMA_SxCR_HTIE) | (1 << DMA_SxCR_TEIE) | (1 << DMA_SxCR_DMEIE))) << 1;
+			if(SIM_R(sbase + DMA_OFF_SxFCR) & (1 << DMA_SxFCR_FEIE))
+				enabled |= (1 << DMA_ISR_FEIF);
+			if(flags & enabled)
+				Lines[irq / 32] |= 1U << (irq % 32);
+		}
+	}
+}
+
+/**************************************************************************
+ * RCC
+ ****************************************************************************/
+static void sim_rcc_reset(void)
+{
+	for(uint32_t off = 0; off < 0x90; off += 4)
+		SIM_R(RCC_BASEADDR + off) = 0;
+	SIM_R(RCC_BASEADDR + RCC_OFF_CR) = 0x00000083;		// HSION, HSIRDY
+	SIM_R(RCC_BASEADDR + RCC_OFF_PLLCFGR) = 0x24003010;
+}
+
+static void sim_rcc_after(uint32_t Offset, uint8_t IsWrite)
+{
+	uint32_t value = SIM_R(RCC_BASEADDR + Offset);
+
+	if(!IsWrite)
+		return;
+
+	if(Offset == RCC_OFF_CR)
+	{
+		// oscillators and PLLs are ready at once
+		value &= ~((1U << 1) | (1U << 17) | (1U << 25) | (1U << 27));
+		value |= (value & (1U << 0)) << 1;			// HSIRDY
+		value |= (value & (1U << 16)) << 1;			// HSERDY
+		value |= (value & (1U << 24)) << 1;			// PLLRDY
+		value |= (value & (1U << 26)) << 1;			// PLLI2SRDY
+		SIM_R(RCC_BASEADDR + Offset) = value;
+	} else if(Offset == RCC_OFF_CFGR)
+	{
+		value &= ~(0x3U << 2);
+		value |= (value & 0x3) << 2;				// SWS = SW
+		SIM_R(RCC_BASEADDR + Offset) = value;
+	} else if(Offset == RCC_OFF_AHB1RSTR)
+	{
+		for(uint8_t port = 0; port < SIM_NO_OF_GPIO; port++)
+		{
+			if(value & (1U << port))
+				sim_gpio_reset(port);
+		}
+		for(uint8_t ctrl = 0; ctrl < SIM_NO_OF_DMA; ctrl++)
+		{
+			if(value & (1U << (21 + ctrl)))
+				sim_dma_reset(ctrl);
+		}
+	} else if(Offset == RCC_OFF_APB1RSTR || Offset == RCC_OFF_APB2RSTR)
+	{
+		for(uint8_t i = 0; i < SIM_NO_OF_SPI; i++)
+		{
+			if(sim_spi[i].RccOffset - (RCC_OFF_AHB1ENR - RCC_OFF_AHB1RSTR) == Offset && (value & (1U << sim_spi[i].RccBit)))
+				sim_spi_reset(&sim_spi[i]);
+		}
+		for(uint8_t i = 0; i < SIM_NO_OF_USART; i++)
+		{
+			if(sim_usart[i].RccOffset - (RCC_OFF_AHB1ENR - RCC_OFF_AHB1RSTR) == Offset && (value & (1U << sim_usart[i].RccBit)))
+				sim_usart_reset(&sim_usart[i]);
+		}
+		for(uint8_t i = 0; i < SIM_NO_OF_TIM; i++)
+		{
+			if(sim_tim[i].RccOffset - (RCC_OFF_AHB1ENR - RCC_OFF_AHB1RSTR) == Offset && (value & (1U << sim_tim[i].RccBit)))
+				sim_tim_reset(&sim_tim[i]);
+		}
+		if(Offset == RCC_OFF_APB2RSTR && (value & (1U << 14)))
+			sim_syscfg_reset();
+	}
+}
+
+// HCLK from the clock tree (HSE is the 8 MHz crystal of the discovery board)
+uint32_t sim_get_hclk(void)
+{
+	static const uint16_t ahb_div[8] = { 2, 4, 8, 16, 64, 128, 256, 512 };
+	uint32_t cfgr = SIM_R(RCC_BASEADDR + RCC_OFF_CFGR);
+	uint32_t pllcfgr = SIM_R(RCC_BASEADDR + RCC_OFF_PLLCFGR);
+	uint32_t sysclk;
+	uint8_t hpre = (cfgr >> 4) & 0xF;
+
+	switch((cfgr >> 2) & 0x3)
+	{
+	case 1:
+		sysclk = 8000000U;
+		break;
+	case 2:
+	{
+		uint32_t src = (pllcfgr & (1U << 22)) ? 8000000U : 16000000U;
+		uint32_t m = pllcfgr & 0x3F;
+		uint32_t n = (pllcfgr >> 6) & 0x1FF;
+		uint32_t p = (((pllcfgr >> 16) & 0x3) + 1) * 2;
+
+		sysclk = (uint32_t)(((uint64_t)src / (m ? m : 1)) * n / p);
+		break;
+	}
+	default:
+		sysclk = 16000000U;
+		break;
+	}
+
+	return (hpre < 8) ? sysclk : sysclk / ahb_div[hpre - 8];
+}
+
+static uint32_t sim_apb_div(uint8_t EnrOffset)
+{
+	uint32_t cfgr = SIM_R(RCC_BASEADDR + RCC_OFF_CFGR);
+	uint8_t ppre = (EnrOffset == RCC_OFF_APB1ENR) ? ((cfgr >> 10) & 0x7) : ((cfgr >> 13) & 0x7);
+
+	return (ppre < 4) ? 1 : (1U << (ppre - 3));
+}
+
+/**************************************************************************
+ * GPIO
+ ****************************************************************************/
+static void sim_gpio_reset(uint8_t Port)
+{
+	uint32_t base = sim_gpio_base(Port);
+
+	for(uint32_t off = 0; off < 0x28; off += 4)
+		SIM_R(base + off) = 0;
+
+	// debug pins (JTAG/SWD) after reset
+	if(Port == 0)
+	{
+		SIM_R(base + GPIO_OFF_MODER) = 0xA8000000;
+		SIM_R(base + GPIO_OFF_OSPEEDR) = 0x0C000000;
+		SIM_R(base + GPIO_OFF_PUPDR) = 0x64000000;
+	} else if(Port == 1)
+	{
+		SIM_R(base + GPIO_OFF_MODER) = 0x00000280;
+		SIM_R(base + GPIO_OFF_OSPEEDR) = 0x000000C0;
+		SIM_R(base + GPIO_OFF_PUPDR) = 0x00000100;
+	}
+	sim_gpio_update(Port);
+}
+
+// IDR from the pin modes, ODR and the outside world
+static void sim_gpio_update(uint8_t Port)
+{
+	uint32_t base = sim_gpio_base(Port);
+	uint32_t moder = SIM_R(base + GPIO_OFF_MODER);
+	uint32_t otyper = SIM_R(base + GPIO_OFF_OTYPER);
+	uint32_t pupdr = SIM_R(base + GPIO_OFF_PUPDR);
+	uint32_t odr = SIM_R(base + GPIO_OFF_ODR);
+	uint16_t old_idr = SIM_R(base + GPIO_OFF_IDR) & 0xFFFF;
+	uint16_t idr = 0;
+
+	for(uint8_t pin = 0; pin < 16; pin++)
+	{
+		uint8_t mode = (moder >> (2 * pin)) & 0x3;
+		uint8_t pull = (pupdr >> (2 * pin)) & 0x3;
+		uint8_t driven = (sim_gpio[Port].Driven >> pin) & 1;
+		uint8_t ext = (sim_gpio[Port].Level >> pin) & 1;
+		uint8_t level;
+
+		if(mode == GPIO_MODE_OUT)
+		{
+			level = (odr >> pin) & 1;
+			if((otyper >> pin) & 1)
+				level = level && (!driven || ext);	// open drain: wired AND
+		} else if(mode == GPIO_MODE_ANALOG)
+		{
+			level = 0;
+		} else
+		{
+			level = driven ? ext : (pull == GPIO_PIN_PU);
+		}
+		idr |= (uint16_t)level << pin;
+	}
+
+	SIM_R(base + GPIO_OFF_IDR) = idr;
+	if(idr != old_idr)
+	{
+		sim_exti_edges(Port, old_idr, idr);
+		if(sim_gpio[Port].Watch)
+			sim_gpio[Port].Watch(sim_gpio[Port].pContext, old_idr, idr);
+	}
+}
+
+static void sim_gpio_after(uint8_t Port, uint32_t Offset, uint8_t IsWrite, uint32_t Old)
+{
+	uint32_t base = sim_gpio_base(Port);
+
+	if(!IsWrite || sim_drop_unclocked(base + Offset, IsWrite, Old, RCC_OFF_AHB1ENR, Port))
+		return;
+
+	if(Offset == GPIO_OFF_IDR)
+	{
+		SIM_R(base + Offset) = Old;					// read only
+	} else if(Offset == GPIO_OFF_BSRR)
+	{
+		uint32_t bsrr = SIM_R(base + GPIO_OFF_BSRR);
+		uint32_t odr = SIM_R(base + GPIO_OFF_ODR);
+
+		// set wins over reset
+		SIM_R(base + GPIO_OFF_ODR) = ((odr & ~(bsrr >> 16)) | bsrr) & 0xFFFF;
+		SIM_R(base + GPIO_OFF_BSRR) = 0;			// write only
+	}
+	sim_gpio_update(Port);
+}
+
+void sim_gpio_set_input(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Level)
+{
+	uint8_t port = sim_gpio_port(pGPIOx);
+
+	sim_gpio[port].Driven |= (1U << PinNumber);
+	if(Level)
+		sim_gpio[port].Level |= (1U << PinNumber);
+	else
+		sim_gpio[port].Level &= ~(1U << PinNumber);
+	sim_gpio_update(port);
+}
+
+void sim_gpio_release_input(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber)
+{
+	uint8_t port = sim_gpio_port(pGPIOx);
+
+	sim_gpio[port].Driven &= ~(1U << PinNumber);
+	sim_gpio_update(port);
+}
+
+uint8_t sim_gpio_get_pin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber)
+{
+	uint8_t port = sim_gpio_port(pGPIOx);
+
+	return (SIM_R(sim_gpio_base(port) + GPIO_OFF_IDR) >> PinNumber) & 1;
+}
+
+void sim_gpio_watch(GPIO_RegDef_t *pGPIOx, sim_gpio_watch_t Watch, void *pContext)
+{
+	uint8_t port = sim_gpio_port(pGPIOx);
+
+	sim_gpio[port].Watch = Watch;
+	sim_gpio[port].pContext = pContext;
+}
+
+/**************************************************************************
+ * EXTI and SYSCFG
+ * ************************************************************************
+ * PR latches the selected edges whether the line is masked or not, IMR
+ * only gates the interrupt (RM0090 figure 41).
+ ****************************************************************************/
+static void sim_exti_edges(uint8_t Port, uint16_t OldIdr, uint16_t NewIdr)
+{
+	uint16_t changed = OldIdr ^ NewIdr;
+	uint32_t rtsr = SIM_R(EXTI_BASEADDR + EXTI_OFF_RTSR);
+	uint32_t ftsr = SIM_R(EXTI_BASEADDR + EXTI_OFF_FTSR);
+
+	for(uint8_t line = 0; line < 16; line++)
+	{
+		uint8_t source = (SIM_R(SYSCFG_BASEADDR + 0x08 + 4 * (line / 4)) >> (4 * (line % 4))) & 0xF;
+		uint8_t rising = (NewIdr >> line) & 1;
+
+		if(!((changed >> line) & 1) || source != Port)
+			continue;
+		if((rising && (rtsr & (1U << line))) || (!rising && (ftsr & (1U << line))))
+			SIM_R(EXTI_BASEADDR + EXTI_OFF_PR) |= (1U << line);
+	}
+}
+
+static void sim_exti_after(uint32_t Offset, uint8_t IsWrite, uint32_t Old)
+{
+	uint32_t value = SIM_R(EXTI_BASEADDR + Offset);
+
+	if(!IsWrite)
+		return;
+
+	if(Offset == EXTI_OFF_SWIER)
+	{
+		SIM_R(EXTI_BASEADDR + EXTI_OFF_PR) |= value & ~Old;
+	} else if(Offset == EXTI_OFF_PR)
+	{
+		// write 1 to clear, also clears SWIER
+		SIM_R(EXTI_BASEADDR + EXTI_OFF_PR) = Old & ~value;
+		SIM_R(EXTI_BASEADDR + EXTI_OFF_SWIER) &= ~value;
+	}
+}
+
+static void sim_syscfg_reset(void)
+{
+	for(uint32_t off = 0; off < 0x30; off += 4)
+		SIM_R(SYSCFG_BASEADDR + off) = 0;
+}
+
+/**************************************************************************
+ * SPI (master)
+ * ************************************************************************
+ * A write to DR goes to the shift register when it is idle (TXE stays set)
+ * or to the TX buffer (TXE cleared). At the end of a frame the slave
+ * callback gives the received frame: RXNE, or OVR when RXNE was still set.
+ ****************************************************************************/
+static void sim_spi_reset(sim_spi_t *pSpi)
+{
+	for(uint32_t off = 0; off < 0x24; off += 4)
+		SIM_R(pSpi->Base + off) = 0;
+	SIM_R(pSpi->Base + SPI_OFF_SR) = (1 << SPI_SR_TXE);
+	SIM_R(pSpi->Base + SPI_OFF_CRCPR) = 0x7;
+	SIM_R(pSpi->Base + SPI_OFF_I2SPR) = 0x2;
+
+	pSpi->TxFull = 0;
+	pSpi->Shifting = 0;
+	pSpi->RxBuffer = 0;
+	pSpi->OvrDrRead = 0;
+	pSpi->ModfSrRead = 0;
+}
+
+// CPU cycles per frame: DFF bits, SCK = PCLK / 2^(BR+1)
+static uint32_t sim_spi_frame_cycles(sim_spi_t *pSpi)
+{
+	uint32_t cr1 = SIM_R(pSpi->Base + SPI_OFF_CR1);
+	uint32_t bits = (cr1 & (1 << SPI_CR1_DFF)) ? 16 : 8;
+	uint32_t br = (cr1 >> SPI_CR1_BR) & 0x7;
+
+	return bits * (2U << br) * sim_apb_div(pSpi->RccOffset);
+}
+
+static void sim_spi_start(sim_spi_t *pSpi, uint16_t Data, uint64_t From)
+{
+	pSpi->Shift = Data;
+	pSpi->Shifting = 1;
+	pSpi->DoneAt = From + sim_spi_frame_cycles(pSpi);
+	SIM_R(pSpi->Base + SPI_OFF_SR) |= (1 << SPI_SR_BSY);
+}
+
+static void sim_spi_complete(sim_spi_t *pSpi)
+{
+	uint32_t cr1 = SIM_R(pSpi->Base + SPI_OFF_CR1);
+	uint16_t mask = (cr1 & (1 << SPI_CR1_DFF)) ? 0xFFFF : 0x00FF;
+	uint16_t rx = pSpi->Xfer ? pSpi->Xfer(pSpi->pContext, pSpi->Shift & mask) : 0xFFFF;
+
+	sim_stats.SpiFrames++;
+	if(SIM_R(pSpi->Base + SPI_OFF_SR) & (1 << SPI_SR_RXNE))
+	{
+		// the new frame is lost
+		SIM_R(pSpi->Base + SPI_OFF_SR) |= (1 << SPI_SR_OVR);
+	} else
+	{
+		pSpi->RxBuffer = rx & mask;
+		SIM_R(pSpi->Base + SPI_OFF_DR) = pSpi->RxBuffer;
+		SIM_R(pSpi->Base + SPI_OFF_SR) |= (1 << SPI_SR_RXNE);
+	}
+
+	if(pSpi->TxFull)
+	{
+		// back to back: the next frame starts on the same clock edge
+		pSpi->TxFull = 0;
+		SIM_R(pSpi->Base + SPI_OFF_SR) |= (1 << SPI_SR_TXE);
+		sim_spi_start(pSpi, pSpi->TxBuffer, pSpi->DoneAt);
+	} else
+	{
+		pSpi->Shifting = 0;
+		SIM_R(pSpi->Base + SPI_OFF_SR) &= ~(1 << SPI_SR_BSY);
+	}
+}
+
+static void sim_spi_after(sim_spi_t *pSpi, uint32_t Offset, uint8_t IsWrite, uint32_t Old)
+{
+	uint32_t base = pSpi->Base;
+	uint32_t cr1 = SIM_R(base + SPI_OFF_CR1);
+
+	if(sim_drop_unclocked(base + Offset, IsWrite, Old, pSpi->RccOffset, pSpi->RccBit))
+		return;
+
+	if(Offset == SPI_OFF_CR1 && IsWrite)
+	{
+		if(pSpi->ModfSrRead)
+		{
+			SIM_R(base + SPI_OFF_SR) &= ~(1 << SPI_SR_MODF);
+			pSpi->ModfSrRead = 0;
+		}
+		// master with software NSS low: mode fault, SPE and MSTR are cleared
+		if((cr1 & (1 << SPI_CR1_SPE)) && (cr1 & (1 << SPI_CR1_MSTR)) &&
+		   (cr1 & (1 << SPI_CR1_SSM)) && !(cr1 & (1 << SPI_CR1_SSI)))
+		{
+			SIM_R(base + SPI_OFF_SR) |= (1 << SPI_SR_MODF);
+			SIM_R(base + SPI_OFF_CR1) = cr1 & ~((1 << SPI_CR1_SPE) | (1 << SPI_CR1_MSTR));
+			cr1 = SIM_R(base + SPI_OFF_CR1);
+		}
+		if(!(cr1 & (1 << SPI_CR1_SPE)) && (Old & (1 << SPI_CR1_SPE)))
+		{
+			pSpi->Shifting = 0;
+			pSpi->TxFull = 0;
+			SIM_R(base + SPI_OFF_SR) = (SIM_R(base + SPI_OFF_SR) | (1 << SPI_SR_TXE)) & ~(1 << SPI_SR_BSY);
+		}
+	} else if(Offset == SPI_OFF_SR)
+	{
+		uint32_t sr;
+
+		if(IsWrite)
+		{
+			// only CRCERR is writable (rc_w0)
+			uint32_t value = SIM_R(base + SPI_OFF_SR);
+			SIM_R(base + SPI_OFF_SR) = Old & ~(~value & (1 << SPI_SR_CRCERR));
+		}
+		sr = SIM_R(base + SPI_OFF_SR);
+		if(!IsWrite && (sr & (1 << SPI_SR_OVR)) && pSpi->OvrDrRead)
+		{
+			SIM_R(base + SPI_OFF_SR) = sr & ~(1 << SPI_SR_OVR);
+			pSpi->OvrDrRead = 0;
+		}
+		if(sr & (1 << SPI_SR_MODF))
+			pSpi->ModfSrRead = 1;
+	} else if(Offset == SPI_OFF_DR)
+	{
+		if(!IsWrite)
+		{
+			uint32_t sr = SIM_R(base + SPI_OFF_SR);
+
+			SIM_R(base + SPI_OFF_SR) = sr & ~(1 << SPI_SR_RXNE);
+			if(sr & (1 << SPI_SR_OVR))
+				pSpi->OvrDrRead = 1;
+			return;
+		}
+
+		uint16_t data = SIM_R(base + SPI_OFF_DR) & 0xFFFF;
+		SIM_R(base + SPI_OFF_DR) = pSpi->RxBuffer;	// reads give the RX buffer
+
+		if(!(cr1 & (1 << SPI_CR1_SPE)))
+			return;
+		if(!(cr1 & (1 << SPI_CR1_MSTR)))
+		{
+			// slave: waits for a master clock, which is not modelled
+			pSpi->TxBuffer = data;
+			pSpi->TxFull = 1;
+			SIM_R(base + SPI_OFF_SR) &= ~(1 << SPI_SR_TXE);
+			return;
+		}
+
+		if(!pSpi->Shifting)
+		{
+			sim_spi_start(pSpi, data, sim_now);
+		} else
+		{
+			// a full TX buffer is overwritten
+			pSpi->TxBuffer = data;
+			pSpi->TxFull = 1;
+			SIM_R(base + SPI_OFF_SR) &= ~(1 << SPI_SR_TXE);
+		}
+	}
+}
+
+void sim_spi_attach(SPI_RegDef_t *pSPIx, sim_spi_xfer_t Xfer, void *pContext)
+{
+	for(uint8_t i = 0; i < SIM_NO_OF_SPI; i++)
+	{
+		if(sim_spi[i].Base == (uint32_t)(uintptr_t)pSPIx)
+		{
+			sim_spi[i].Xfer = Xfer;
+			sim_spi[i].pContext = pContext;
+			return;
+		}
+	}
+	sim_fatal("not an SPI", (uint32_t)(uintptr_t)pSPIx);
+}
+
+/**************************************************************************
+ * USART1..6 (receiver)
+ *
+ * Frames come from sim_usart_receive, with their error flags. The
+ * transmitter is always ready: DR writes go nowhere, TXE and TC stay set.
+ ****************************************************************************/
+static void sim_usart_reset(sim_usart_t *pUsart)
+{
+	for(uint32_t off = 0; off < 0x1C; off += 4)
+		SIM_R(pUsart->Base + off) = 0;
+	SIM_R(pUsart->Base + USART_OFF_SR) = (1 << USART_SR_TXE) | (1 << USART_SR_TC);
+
+	pUsart->RxData = 0;
+	pUsart->SrRead = 0;
+}
+
+static void sim_usart_after(sim_usart_t *pUsart, uint32_t Offset, uint8_t IsWrite, uint32_t Old)
+{
+	uint32_t base = pUsart->Base;
+	uint32_t clear;
+
+	if(sim_drop_unclocked(base + Offset, IsWrite, Old, pUsart->RccOffset, pUsart->RccBit))
+		return;
+
+	if(Offset == USART_OFF_SR)
+	{
+		if(!IsWrite)
+		{
+			pUsart->SrRead = 1;
+			return;
+		}
+		// only RXNE, TC, LBD and CTS clear by writing 0, the rest is read-only
+		clear = (1 << USART_SR_RXNE) | (1 << USART_SR_TC) | (1 << USART_SR_LBD) | (1 << USART_SR_CTS);
+		SIM_R(base + USART_OFF_SR) = Old & ~(clear & ~SIM_R(base + USART_OFF_SR));
+	} else if(Offset == USART_OFF_DR)
+	{
+		if(IsWrite)
+		{
+			SIM_R(base + USART_OFF_SR) |= (1 << USART_SR_TXE) | (1 << USART_SR_TC);
+			SIM_R(base + USART_OFF_DR) = pUsart->RxData;	// reads give the received frame
+			return;
+		}
+		// a DR read alone clears RXNE, after an SR read the errors and IDLE too
+		clear = (1 << USART_SR_RXNE);
+		if(pUsart->SrRead)
+			clear |= (1 << USART_SR_PE) | (1 << USART_SR_FE) | (1 << USART_SR_NF) |
+					 (1 << USART_SR_ORE) | (1 << USART_SR_IDLE);
+		SIM_R(base + USART_OFF_SR) &= ~clear;
+		pUsart->SrRead = 0;
+	}
+}
+
+void sim_usart_receive(USART_RegDef_t *pUSARTx, uint16_t Data, uint32_t Errors)
+{
+	sim_usart_t *pUsart = 0;
+	uint32_t sr;
+
+	for(uint8_t i = 0; i < SIM_NO_OF_USART; i++)
+	{
+		if(sim_usart[i].Base == (uint32_t)(uintptr_t)pUSARTx)
+			pUsart = &sim_usart[i];
+	}
+	if(pUsart == 0)
+		sim_fatal("not a USART", (uint32_t)(uintptr_t)pUSARTx);
+
+	if((SIM_R(pUsart->Base + USART_OFF_CR1) & ((1 << USART_CR1_UE) | (1 << USART_CR1_RE))) !=
+	   ((1 << USART_CR1_UE) | (1 << USART_CR1_RE)))
+		return;
+
+	sr = SIM_R(pUsart->Base + USART_OFF_SR);
+	if(sr & (1 << USART_SR_RXNE))
+	{
+		// DR not read in time: the new frame is lost
+		sr |= (1 << USART_SR_ORE);
+	} else
+	{
+		pUsart->RxData = Data;
+		SIM_R(pUsart->Base + USART_OFF_DR) = Data;
+		sr |= (1 << USART_SR_RXNE);
+		sr |= Errors & ((1 << USART_SR_PE) | (1 << USART_SR_FE) | (1 << USART_SR_NF));
+	}
+	SIM_R(pUsart->Base + USART_OFF_SR) = sr;
+
+	sim_dma_service();
+}
+
+void sim_usart_idle(USART_RegDef_t *pUSARTx)
+{
+	for(uint8_t i = 0; i < SIM_NO_OF_USART; i++)
+	{
+		if(sim_usart[i].Base == (uint32_t)(uintptr_t)pUSARTx)
+		{
+			SIM_R(sim_usart[i].Base + USART_OFF_SR) |= (1 << USART_SR_IDLE);
+			return;
+		}
+	}
+	sim_fatal("not a USART", (uint32_t)(uintptr_t)pUSARTx);
+}
+
+/**************************************************************************
+ * TIM1..8 (time base)
+ * ************************************************************************
+ * Up counting with update events only: UIF, the update interrupt, the
+ * update DMA request (UDE), UG, OPM. CNT is computed from the time of the
+ * last update when it is read. PSC and ARR are used as written (no
+ * preload), capture/compare channels, RCR and the burst DMA are not
+ * modelled.
+ ****************************************************************************/
+static void sim_tim_reset(sim_tim_t *pTim)
+{
+	for(uint32_t off = 0; off < 0x54; off += 4)
+		SIM_R(pTim->Base + off) = 0;
+	SIM_R(pTim->Base + TIM_OFF_ARR) = (pTim->Base == TIM2_BASEADDR || pTim->Base == TIM5_BASEADDR) ? 0xFFFFFFFF : 0xFFFF;
+
+	pTim->Running = 0;
+	pTim->UpdateReq = 0;
+}
+
+// CPU cycles per count: the timers run at 2 x PCLK when the APB is divided
+static uint32_t sim_tim_count_cycles(sim_tim_t *pTim)
+{
+	uint32_t div = sim_apb_div(pTim->RccOffset);
+
+	return (SIM_R(pTim->Base + TIM_OFF_PSC) + 1) * (div == 1 ? 1 : div / 2);
+}
+
+static uint64_t sim_tim_update_cycles(sim_tim_t *pTim)
+{
+	return ((uint64_t)SIM_R(pTim->Base + TIM_OFF_ARR) + 1) * sim_tim_count_cycles(pTim);
+}
+
+static void sim_tim_update(sim_tim_t *pTim)
+{
+	uint32_t cr1 = SIM_R(pTim->Base + TIM_OFF_CR1);
+
+	if(!(cr1 & (1 << TIM_CR1_UDIS)))
+	{
+		SIM_R(pTim->Base + TIM_OFF_SR) |= (1 << TIM_SR_UIF);
+		if(SIM_R(pTim->Base + TIM_OFF_DIER) & (1 << TIM_DIER_UDE))
+			pTim->UpdateReq = 1;
+	}
+
+	pTim->LastUpdate = pTim->NextUpdate;
+	if(cr1 & (1 << TIM_CR1_OPM))
+	{
+		// one pulse: the counter stops at the update
+		pTim->Running = 0;
+		SIM_R(pTim->Base + TIM_OFF_CR1) = cr1 & ~(1 << TIM_CR1_CEN);
+		SIM_R(pTim->Base + TIM_OFF_CNT) = 0;
+		return;
+	}
+	pTim->NextUpdate = pTim->LastUpdate + sim_tim_update_cycles(pTim);
+}
+
+static void sim_tim_after(sim_tim_t *pTim, uint32_t Offset, uint8_t IsWrite, uint32_t Old)
+{
+	uint32_t base = pTim->Base;
+	uint32_t value = SIM_R(base + Offset);
+
+	if(!IsWrite || sim_drop_unclocked(base + Offset, IsWrite, Old, pTim->RccOffset, pTim->RccBit))
+		return;
+
+	if(Offset == TIM_OFF_CR1)
+	{
+		if((value & (1 << TIM_CR1_CEN)) && !pTim->Running)
+		{
+			pTim->Running = 1;
+			pTim->LastUpdate = sim_now - (uint64_t)SIM_R(base + TIM_OFF_CNT) * sim_tim_count_cycles(pTim);
+			pTim->NextUpdate = pTim->LastUpdate + sim_tim_update_cycles(pTim);
+		} else if(!(value & (1 << TIM_CR1_CEN)) && pTim->Running)
+		{
+			SIM_R(base + TIM_OFF_CNT) = (uint32_t)((sim_now - pTim->LastUpdate) / sim_tim_count_cycles(pTim));
+			pTim->Running = 0;
+		}
+	} else if(Offset == TIM_OFF_SR)
+	{
+		// rc_w0
+		SIM_R(base + TIM_OFF_SR) = Old & value;
+	} else if(Offset == TIM_OFF_EGR)
+	{
+		SIM_R(base + TIM_OFF_EGR) = 0;				// write only
+		if(value & (1 << TIM_EGR_UG))
+		{
+			// counter restarts, UIF unless URS (only overflows)
+			SIM_R(base + TIM_OFF_CNT) = 0;
+			pTim->LastUpdate = sim_now;
+			pTim->NextUpdate = sim_now + sim_tim_update_cycles(pTim);
+			if(!(SIM_R(base + TIM_OFF_CR1) & (1 << TIM_CR1_URS)))
+			{
+				SIM_R(base + TIM_OFF_SR) |= (1 << TIM_SR_UIF);
+				if(SIM_R(base + TIM_OFF_DIER) & (1 << TIM_DIER_UDE))
+					pTim->UpdateReq = 1;
+			}
+		}
+	} else if(Offset == TIM_OFF_CNT && pTim->Running)
+	{
+		pTim->LastUpdate = sim_now - (uint64_t)value * sim_tim_count_cycles(pTim);
+		pTim->NextUpdate = pTim->LastUpdate + sim_tim_update_cycles(pTim);
+	} else if((Offset == TIM_OFF_PSC || Offset == TIM_OFF_ARR) && pTim->Running)
+	{
+		// taken at once (no preload): the current period ends with the new values
+		pTim->NextUpdate = pTim->LastUpdate + sim_tim_update_cycles(pTim);
+		if(pTim->NextUpdate < sim_now)
+			pTim->NextUpdate = sim_now;
+	}
+}
+
+/**************************************************************************
+ * DMA1/DMA2
+ * ************************************************************************
+ * A stream copies its addresses when EN is set and then moves one item
+ * per request of the peripheral selected by CHSEL (SPI RXNE/TXE with
+ * RXDMAEN/TXDMAEN, timer updates with UDE). Memory to memory streams run
+ * to the end at once. NDTR counts down, HT/TC flags, circular and double
+ * buffer mode, EN cleared at the end of a normal transfer. Data moves
+ * take no time, PSIZE and MSIZE are used per item without FIFO packing.
+ * Memory addresses are host addresses (non-PIE build).
+ ****************************************************************************/
+static void sim_dma_reset(uint8_t Ctrl)
+{
+	uint32_t base = sim_dma_base[Ctrl];
+
+	for(uint32_t off = 0; off < DMA_OFF_STREAM + 8 * DMA_STREAM_SIZE; off += 4)
+		SIM_R(base + off) = 0;
+	for(uint8_t stream = 0; stream < 8; stream++)
+	{
+		SIM_R(base + DMA_OFF_STREAM + DMA_STREAM_SIZE * stream + DMA_OFF_SxFCR) = 0x21;
+		sim_dma[Ctrl][stream].Running = 0;
+	}
+}
+
+static void sim_dma_flag(uint8_t Ctrl, uint8_t Stream, uint8_t Flag)
+{
+	uint32_t isr = sim_dma_base[Ctrl] + (Stream < 4 ? DMA_OFF_LISR : DMA_OFF_HISR);
+
+	SIM_R(isr) |= 1U << (Flag + sim_dma_flag_shift[Stream % 4]);
+}
+
+// a bus access of the DMA: the register models see it like a CPU access
+static uint32_t sim_dma_read(uint32_t Addr, uint8_t Size)
+{
+	uint32_t mask = (Size == 4) ? 0xFFFFFFFF : ((1U << (8 * Size)) - 1);
+	uint32_t reg = Addr & ~3U, value;
+
+	if(Addr < SIM_PERIPH_BASE || Addr >= SIM_PERIPH_BASE + SIM_PERIPH_SIZE)
+	{
+		if(Addr < 0x1000)
+			sim_fatal("DMA read from", Addr);
+		if(Size == 1)
+			return *(uint8_t*)(uintptr_t)Addr;
+		if(Size == 2)
+			return *(uint16_t*)(uintptr_t)Addr;
+		return *(uint32_t*)(uintptr_t)Addr;
+	}
+
+	sim_periph_before(reg, 0);
+	value = SIM_R(reg);
+	sim_periph_after(reg, 0, value);
+	return (value >> (8 * (Addr & 3))) & mask;
+}
+
+static void sim_dma_write(uint32_t Addr, uint8_t Size, uint32_t Value)
+{
+	uint32_t mask = (Size == 4) ? 0xFFFFFFFF : ((1U << (8 * Size)) - 1);
+	uint32_t reg = Addr & ~3U, shift = 8 * (Addr & 3), old;
+
+	if(Addr < SIM_PERIPH_BASE || Addr >= SIM_PERIPH_BASE + SIM_PERIPH_SIZE)
+	{
+		if(Addr < 0x1000)
+			sim_fatal("DMA write to", Addr);
+		if(Size == 1)
+			*(uint8_t*)(uintptr_t)Addr = (uint8_t)Value;
+		else if(Size == 2)
+			*(uint16_t*)(uintptr_t)Addr = (uint16_t)Value;
+		else
+			*(uint32_t*)(uintptr_t)Addr = Value;
+		return;
+	}
+
+	sim_periph_before(reg, 1);
+	old = SIM_R(reg);
+	SIM_R(reg) = (old & ~(mask << shift)) | ((Value & mask) << shift);
+	sim_periph_after(reg, 1, old);
+}
+
+static uint8_t sim_dma_requested(const sim_dma_req_t *pReq)
+{
+	if(pReq->Source == SIM_DMA_TIM_UP)
+		return sim_tim[pReq->Unit].UpdateReq;
+	if(pReq->Source == SIM_DMA_USART_RX)
+		return (SIM_R(sim_usart[pReq->Unit].Base + USART_OFF_CR3) & (1 << USART_CR3_DMAR)) &&
+			   (SIM_R(sim_usart[pReq->Unit].Base + USART_OFF_SR) & (1 << USART_SR_RXNE));
+
+	uint32_t base = sim_spi[pReq->Unit].Base;
+	uint32_t sr = SIM_R(base + SPI_OFF_SR);
+	uint32_t cr2 = SIM_R(base + SPI_OFF_CR2);
+
+	if(pReq->Source == SIM_DMA_SPI_RX)
+		return (cr2 & (1 << SPI_CR2_RXDMAEN)) && (sr & (1 << SPI_SR_RXNE));
+	return (cr2 & (1 << SPI_CR2_TXDMAEN)) && (sr & (1 << SPI_SR_TXE)) &&
+		   (SIM_R(base + SPI_OFF_CR1) & (1 << SPI_CR1_SPE));
+}
+
+static void sim_dma_item(uint8_t Ctrl, uint8_t Stream)
+{
+	sim_dma_stream_t *pStream = &sim_dma[Ctrl][Stream];
+	uint32_t sbase = sim_dma_base[Ctrl] + DMA_OFF_STREAM + DMA_STREAM_SIZE * Stream;
+	uint32_t cr = SIM_R(sbase + DMA_OFF_SxCR);
+	uint8_t psize = 1 << ((cr >> DMA_SxCR_PSIZE) & 0x3);
+	uint8_t msize = 1 << ((cr >> DMA_SxCR_MSIZE) & 0x3);
+	uint32_t ndtr;
+
+	switch((cr >> DMA_SxCR_DIR) & 0x3)
+	{
+	case 0:
+		sim_dma_write(pStream->Mem, msize, sim_dma_read(pStream->Periph, psize));
+		break;
+	case 1:
+		sim_dma_write(pStream->Periph, psize, sim_dma_read(pStream->Mem, msize));
+		break;
+	default:
+		// memory to memory: PAR is the source
+		sim_dma_write(pStream->Mem, msize, sim_dma_read(pStream->Periph, psize));
+		break;
+	}
+	sim_stats.DmaItems++;
+
+	if(cr & (1 << DMA_SxCR_PINC))
+		pStream->Periph += psize;
+	if(cr & (1 << DMA_SxCR_MINC))
+		pStream->Mem += msize;
+
+	ndtr = SIM_R(sbase + DMA_OFF_SxNDTR) - 1;
+	SIM_R(sbase + DMA_OFF_SxNDTR) = ndtr;
+	if(ndtr == pStream->Items / 2)
+		sim_dma_flag(Ctrl, Stream, DMA_ISR_HTIF);
+	if(ndtr != 0)
+		return;
+
+	sim_dma_flag(Ctrl, Stream, DMA_ISR_TCIF);
+	if(cr & ((1 << DMA_SxCR_CIRC) | (1 << DMA_SxCR_DBM)))
+	{
+		if(cr & (1 << DMA_SxCR_DBM))
+		{
+			cr ^= (1 << DMA_SxCR_CT);
+			SIM_R(sbase + DMA_OFF_SxCR) = cr;
+		}
+		SIM_R(sbase + DMA_OFF_SxNDTR) = pStream->Items;
+		pStream->Periph = SIM_R(sbase + DMA_OFF_SxPAR);
+		pStream->Mem = SIM_R(sbase + ((cr & (1 << DMA_SxCR_CT)) ? DMA_OFF_SxM1AR : DMA_OFF_SxM0AR));
+	} else
+	{
+		pStream->Running = 0;
+		SIM_R(sbase + DMA_OFF_SxCR) = cr & ~(1 << DMA_SxCR_EN);
+	}
+}
+
+// serves every pending request, until none is left
+static void sim_dma_service(void)
+{
+	static uint8_t busy;
+	uint8_t moved;
+
+	// the data moves access registers, which come back here
+	if(busy)
+		return;
+	busy = 1;
+
+	do
+	{
+		moved = 0;
+		for(uint8_t ctrl = 0; ctrl < SIM_NO_OF_DMA; ctrl++)
+		{
+			for(uint8_t stream = 0; stream < 8; stream++)
+			{
+				uint32_t cr = SIM_R(sim_dma_base[ctrl] + DMA_OFF_STREAM + DMA_STREAM_SIZE * stream + DMA_OFF_SxCR);
+
+				while(sim_dma[ctrl][stream].Running && ((cr >> DMA_SxCR_DIR) & 0x3) == DMA_DIR_MEM_TO_MEM)
+					sim_dma_item(ctrl, stream);
+			}
+		}
+
+		for(uint32_t i = 0; i < sizeof(sim_dma_reqs) / sizeof(sim_dma_reqs[0]); i++)
+		{
+			const sim_dma_req_t *pReq = &sim_dma_reqs[i];
+			uint32_t cr = SIM_R(sim_dma_base[pReq->Ctrl] + DMA_OFF_STREAM + DMA_STREAM_SIZE * pReq->Stream + DMA_OFF_SxCR);
+
+			if(!sim_dma[pReq->Ctrl][pReq->Stream].Running || ((cr >> DMA_SxCR_CHSEL) & 0x7) != pReq->Channel)
+				continue;
+			if(!sim_dma_requested(pReq))
+				continue;
+
+			if(pReq->Source == SIM_DMA_TIM_UP)
+				sim_tim[pReq->Unit].UpdateReq = 0;
+			sim_dma_item(pReq->Ctrl, pReq->Stream);
+			moved = 1;
+		}
+	} while(moved);
+
+	busy = 0;
+}
+
+static void sim_dma_after(uint8_t Ctrl, uint32_t Offset, uint8_t IsWrite, uint32_t Old)
+{
+	uint32_t base = sim_dma_base[Ctrl];
+	uint32_t value = SIM_R(base + Offset);
+	uint8_t stream, reg;
+	uint32_t sbase;
+
+	if(!IsWrite || sim_drop_unclocked(base + Offset, IsWrite, Old, RCC_OFF_AHB1ENR, 21 + Ctrl))
+		return;
+
+	if(Offset == DMA_OFF_LISR || Offset == DMA_OFF_HISR)
+	{
+		SIM_R(base + Offset) = Old;					// read only
+		return;
+	}
+	if(Offset == DMA_OFF_LIFCR || Offset == DMA_OFF_HIFCR)
+	{
+		// write 1 to clear the flags in LISR/HISR, reads as 0
+		SIM_R(base + Offset - (DMA_OFF_LIFCR - DMA_OFF_LISR)) &= ~value;
+		SIM_R(base + Offset) = 0;
+		return;
+	}
+	if(Offset < DMA_OFF_STREAM || Offset >= DMA_OFF_STREAM + 8 * DMA_STREAM_SIZE)
+		return;
+
+	stream = (Offset - DMA_OFF_STREAM) / DMA_STREAM_SIZE;
+	reg = (Offset - DMA_OFF_STREAM) % DMA_STREAM_SIZE;
+	sbase = base + DMA_OFF_STREAM + DMA_STREAM_SIZE * stream;
+
+	if(reg == DMA_OFF_SxCR)
+	{
+		sim_dma_stream_t *pStream = &sim_dma[Ctrl][stream];
+
+		if(Old & (1 << DMA_SxCR_EN))
+		{
+			if(value & (1 << DMA_SxCR_EN))
+			{
+				SIM_R(base + Offset) = Old;			// locked while enabled
+			} else if(pStream->Running)
+			{
+				// disabled by software: TCIF tells the stream has stopped
+				pStream->Running = 0;
+				sim_dma_flag(Ctrl, stream, DMA_ISR_TCIF);
+			}
+		} else if(value & (1 << DMA_SxCR_EN))
+		{
+			pStream->Items = SIM_R(sbase + DMA_OFF_SxNDTR) & 0xFFFF;
+			if(pStream->Items == 0)
+			{
+				SIM_R(sbase + DMA_OFF_SxCR) = value & ~(1 << DMA_SxCR_EN);
+				return;
+			}
+			pStream->Running = 1;
+			pStream->Periph = SIM_R(sbase + DMA_OFF_SxPAR);
+			pStream->Mem = SIM_R(sbase + ((value & (1 << DMA_SxCR_CT)) ? DMA_OFF_SxM1AR : DMA_OFF_SxM0AR));
+		}
+	} else if((SIM_R(sbase + DMA_OFF_SxCR) & (1 << DMA_SxCR_EN)) &&
+			  (reg == DMA_OFF_SxNDTR || reg == DMA_OFF_SxPAR || reg == DMA_OFF_SxFCR))
+	{
+		SIM_R(base + Offset) = Old;					// locked while enabled
+	}
+}
@@ -0,0 +1,144 @@
+/*
+ * Register access trace recorder. See stm32_sim.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32_sim_internal.h"
+
+#define SIM_TRACE_DEFAULT_RECORDS	(1U << 20)	// 16 MB
+
+uint8_t sim_tracing;
+
+static sim_trace_record_t *sim_trace_buffer;
+static uint32_t sim_trace_max;
+static uint32_t sim_trace_len;
+static uint32_t sim_trace_dropped;
+static const char *sim_trace_path;
+
+void __cyg_profile_func_enter(void *pFunction, void *pCallSite) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void *pFunction, void *pCallSite) __attribute__((no_instrument_function));
+
+void sim_trace_add(uint8_t Type, uint32_t Addr, uint32_t Value)
+{
+	sim_trace_record_t *pRecord;
+
+	if(sim_trace_len == sim_trace_max)
+	{
+		sim_trace_dropped++;
+		return;
+	}
+	pRecord = &sim_trace_buffer[sim_trace_len++];
+	pRecord->Cycle = (uint32_t)sim_now;
+	pRecord->Addr = Addr;
+	pRecord->Value = Value;
+	pRecord->Type = Type;
+	memset(pRecord->Reserved, 0, sizeof(pRecord->Reserved));
+}
+
+/**************************************************************************
+ * @fn			- sim_trace_start
+ *
+ * @brief		- Starts a new trace in a buffer of MaxRecords records.
+ * 				  When the buffer is full further records are counted as
+ * 				  dropped.
+ ****************************************************************************/
+void sim_trace_start(uint32_t MaxRecords)
+{
+	free(sim_trace_buffer);
+	sim_trace_buffer = malloc((size_t)MaxRecords * sizeof(sim_trace_record_t));
+	if(!sim_trace_buffer)
+		sim_fatal("no memory for the trace buffer", MaxRecords);
+	sim_trace_max = MaxRecords;
+	sim_trace_len = 0;
+	sim_trace_dropped = 0;
+	sim_tracing = 1;
+}
+
+void sim_trace_stop(void)
+{
+	sim_tracing = 0;
+}
+
+uint32_t sim_trace_count(void)
+{
+	return sim_trace_len;
+}
+
+const sim_trace_record_t *sim_trace_records(void)
+{
+	return sim_trace_buffer;
+}
+
+/**************************************************************************
+ * @fn			- sim_trace_save
+ *
+ * @brief		- Writes the header and the records to a file.
+ *
+ * @return		- 0 on success, -1 on error
+ ****************************************************************************/
+int sim_trace_save(const char *pPath)
+{
+	sim_trace_header_t header;
+	FILE *pFile = fopen(pPath, "wb");
+	int ok;
+
+	if(!pFile)
+		return -1;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, SIM_TRACE_MAGIC, sizeof(header.Magic));
+	header.Version = SIM_TRACE_VERSION;
+	header.RecordSize = sizeof(sim_trace_record_t);
+	header.Count = sim_trace_len;
+	header.Dropped = sim_trace_dropped;
+	header.Hclk = sim_get_hclk();
+	header.AccessCycles = sim_get_access_cycles();
+
+	ok = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+		 fwrite(sim_trace_buffer, sizeof(sim_trace_record_t), sim_trace_len, pFile) == sim_trace_len;
+	if(fclose(pFile) != 0)
+		ok = 0;
+	return ok ? 0 : -1;
+}
+
+/*
+ * STM32_SIM_TRACE=<file>: trace from start to exit
+ */
+static void sim_trace_atexit(void)
+{
+	sim_tracing = 0;
+	if(sim_trace_save(sim_trace_path) != 0)
+		fprintf(stderr, "stm32 sim: can not write trace %s\n", sim_trace_path);
+	else if(sim_trace_dropped)
+		fprintf(stderr, "stm32 sim: trace buffer full, %u records dropped\n", (unsigned)sim_trace_dropped);
+}
+
+__attribute__((constructor)) static void sim_trace_constructor(void)
+{
+	sim_trace_path = getenv("STM32_SIM_TRACE");
+	if(sim_trace_path && *sim_trace_path)
+	{
+		sim_trace_start(SIM_TRACE_DEFAULT_RECORDS);
+		atexit(sim_trace_atexit);
+	}
+}
+
+/*
+ * Function entry/exit hooks of -finstrument-functions (drivers built with
+ * TRACE=1). They mark the API call boundaries in the trace.
+ */
+void __cyg_profile_func_enter(void *pFunction, void *pCallSite)
+{
+	(void)pCallSite;
+	if(sim_tracing)
+		sim_trace_add(SIM_TRACE_ENTER, (uint32_t)(uintptr_t)pFunction, 0);
+}
+
+void __cyg_profile_func_exit(void *pFunction, void *pCallSite)
+{
+	(void)pCallSite;
+	if(sim_tracing)
+		sim_trace_add(SIM_TRACE_EXIT, (uint32_t)(uintptr_t)pFunction, 0);
+}
@@ -0,0 +1,197 @@
+/*
+ * Interrupt vector table of the host build, IRQ 0..95 in the order of
+ * Startup/startup_stm32f407vgtx.s. Handlers the application does not define
+ * are weak aliases of sim_default_handler.
+ */
+#include "stm32_sim_internal.h"
+
+void sim_default_handler(void)
+{
+	sim_unhandled_irq();
+}
+
+#define SIM_WEAK_HANDLER(name)	void name(void) __attribute__((weak, alias("sim_default_handler")))
+
+SIM_WEAK_HANDLER(WWDG_IRQHandler);
+SIM_WEAK_HANDLER(PVD_IRQHandler);
+SIM_WEAK_HANDLER(TAMP_STAMP_IRQHandler);
+SIM_WEAK_HANDLER(RTC_WKUP_IRQHandler);
+SIM_WEAK_HANDLER(RCC_IRQHandler);
+SIM_WEAK_HANDLER(EXTI0_IRQHandler);
+SIM_WEAK_HANDLER(EXTI1_IRQHandler);
+SIM_WEAK_HANDLER(EXTI2_IRQHandler);
+SIM_WEAK_HANDLER(EXTI3_IRQHandler);
+SIM_WEAK_HANDLER(EXTI4_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream0_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream1_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream2_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream3_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream4_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream5_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream6_IRQHandler);
+SIM_WEAK_HANDLER(ADC_IRQHandler);
+SIM_WEAK_HANDLER(CAN1_TX_IRQHandler);
+SIM_WEAK_HANDLER(CAN1_RX0_IRQHandler);
+SIM_WEAK_HANDLER(CAN1_RX1_IRQHandler);
+SIM_WEAK_HANDLER(CAN1_SCE_IRQHandler);
+SIM_WEAK_HANDLER(EXTI9_5_IRQHandler);
+SIM_WEAK_HANDLER(TIM1_BRK_TIM9_IRQHandler);
+SIM_WEAK_HANDLER(TIM1_UP_TIM10_IRQHandler);
+SIM_WEAK_HANDLER(TIM1_TRG_COM_TIM11_IRQHandler);
+SIM_WEAK_HANDLER(TIM1_CC_IRQHandler);
+SIM_WEAK_HANDLER(TIM2_IRQHandler);
+SIM_WEAK_HANDLER(TIM3_IRQHandler);
+SIM_WEAK_HANDLER(TIM4_IRQHandler);
+SIM_WEAK_HANDLER(I2C1_EV_IRQHandler);
+SIM_WEAK_HANDLER(I2C1_ER_IRQHandler);
+SIM_WEAK_HANDLER(I2C2_EV_IRQHandler);
+SIM_WEAK_HANDLER(I2C2_ER_IRQHandler);
+SIM_WEAK_HANDLER(SPI1_IRQHandler);
+SIM_WEAK_HANDLER(SPI2_IRQHandler);
+SIM_WEAK_HANDLER(USART1_IRQHandler);
+SIM_WEAK_HANDLER(USART2_IRQHandler);
+SIM_WEAK_HANDLER(USART3_IRQHandler);
+SIM_WEAK_HANDLER(EXTI15_10_IRQHandler);
+SIM_WEAK_HANDLER(RTC_Alarm_IRQHandler);
+SIM_WEAK_HANDLER(OTG_FS_WKUP_IRQHandler);
+SIM_WEAK_HANDLER(TIM8_BRK_TIM12_IRQHandler);
+SIM_WEAK_HANDLER(TIM8_UP_TIM13_IRQHandler);
+SIM_WEAK_HANDLER(TIM8_TRG_COM_TIM14_IRQHandler);
+SIM_WEAK_HANDLER(TIM8_CC_IRQHandler);
+SIM_WEAK_HANDLER(DMA1_Stream7_IRQHandler);
+SIM_WEAK_HANDLER(FSMC_IRQHandler);
+SIM_WEAK_HANDLER(SDIO_IRQHandler);
+SIM_WEAK_HANDLER(TIM5_IRQHandler);
+SIM_WEAK_HANDLER(SPI3_IRQHandler);
+SIM_WEAK_HANDLER(UART4_IRQHandler);
+SIM_WEAK_HANDLER(UART5_IRQHandler);
+SIM_WEAK_HANDLER(TIM6_DAC_IRQHandler);
+SIM_WEAK_HANDLER(TIM7_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream0_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream1_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream2_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream3_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream4_IRQHandler);
+SIM_WEAK_HANDLER(ETH_IRQHandler);
+SIM_WEAK_HANDLER(ETH_WKUP_IRQHandler);
+SIM_WEAK_HANDLER(CAN2_TX_IRQHandler);
+SIM_WEAK_HANDLER(CAN2_RX0_IRQHandler);
+SIM_WEAK_HANDLER(CAN2_RX1_IRQHandler);
+SIM_WEAK_HANDLER(CAN2_SCE_IRQHandler);
+SIM_WEAK_HANDLER(OTG_FS_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream5_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream6_IRQHandler);
+SIM_WEAK_HANDLER(DMA2_Stream7_IRQHandler);
+SIM_WEAK_HANDLER(USART6_IRQHandler);
+SIM_WEAK_HANDLER(I2C3_EV_IRQHandler);
+SIM_WEAK_HANDLER(I2C3_ER_IRQHandler);
+SIM_WEAK_HANDLER(OTG_HS_EP1_OUT_IRQHandler);
+SIM_WEAK_HANDLER(OTG_HS_EP1_IN_IRQHandler);
+SIM_WEAK_HANDLER(OTG_HS_WKUP_IRQHandler);
+SIM_WEAK_HANDLER(OTG_HS_IRQHandler);
+SIM_WEAK_HANDLER(DCMI_IRQHandler);
+SIM_WEAK_HANDLER(CRYP_IRQHandler);
+SIM_WEAK_HANDLER(HASH_RNG_IRQHandler);
+SIM_WEAK_HANDLER(FPU_IRQHandler);
+SIM_WEAK_HANDLER(LCD_TFT_IRQHandler);
+SIM_WEAK_HANDLER(LCD_TFT_1_IRQHandler);
+
+const sim_handler_t sim_vectors[SIM_NO_OF_IRQS] =
+{
+	WWDG_IRQHandler,						/* 0 */
+	PVD_IRQHandler,							/* 1 */
+	TAMP_STAMP_IRQHandler,					/* 2 */
+	RTC_WKUP_IRQHandler,					/* 3 */
+	sim_default_handler,					/* 4: reserved */
+	RCC_IRQHandler,							/* 5 */
+	EXTI0_IRQHandler,						/* 6 */
+	EXTI1_IRQHandler,						/* 7 */
+	EXTI2_IRQHandler,						/* 8 */
+	EXTI3_IRQHandler,						/* 9 */
+	EXTI4_IRQHandler,						/* 10 */
+	DMA1_Stream0_IRQHandler,				/* 11 */
+	DMA1_Stream1_IRQHandler,				/* 12 */
+	DMA1_Stream2_IRQHandler,				/* 13 */
+	DMA1_Stream3_IRQHandler,				/* 14 */
+	DMA1_Stream4_IRQHandler,				/* 15 */
+	DMA1_Stream5_IRQHandler,				/* 16 */
+	DMA1_Stream6_IRQHandler,				/* 17 */
+	ADC_IRQHandler,							/* 18 */
+	CAN1_TX_IRQHandler,						/* 19 */
+	CAN1_RX0_IRQHandler,					/* 20 */
+	CAN1_RX1_IRQHandler,					/* 21 */
+	CAN1_SCE_IRQHandler,					/* 22 */
+	EXTI9_5_IRQHandler,						/* 23 */
+	TIM1_BRK_TIM9_IRQHandler,				/* 24 */
+	TIM1_UP_TIM10_IRQHandler,				/* 25 */
+	TIM1_TRG_COM_TIM11_IRQHandler,			/* 26 */
+	TIM1_CC_IRQHandler,						/* 27 */
+	TIM2_IRQHandler,						/* 28 */
+	TIM3_IRQHandler,						/* 29 */
+	TIM4_IRQHandler,						/* 30 */
+	I2C1_EV_IRQHandler,						/* 31 */
+	I2C1_ER_IRQHandler,						/* 32 */
+	I2C2_EV_IRQHandler,						/* 33 */
+	I2C2_ER_IRQHandler,						/* 34 */
+	SPI1_IRQHandler,						/* 35 */
+	SPI2_IRQHandler,						/* 36 */
+	USART1_IRQHandler,						/* 37 */
+	USART2_IRQHandler,						/* 38 */
+	USART3_IRQHandler,						/* 39 */
+	EXTI15_10_IRQHandler,					/* 40 */
+	RTC_Alarm_IRQHandler,					/* 41 */
+	OTG_FS_WKUP_IRQHandler,					/* 42 */
+	TIM8_BRK_TIM12_IRQHandler,				/* 43 */
+	TIM8_UP_TIM13_IRQHandler,				/* 44 */
+	TIM8_TRG_COM_TIM14_IRQHandler,			/* 45 */
+	TIM8_CC_IRQHandler,						/* 46 */
+	DMA1_Stream7_IRQHandler,				/* 47 */
+	FSMC_IRQHandler,						/* 48 */
+	SDIO_IRQHandler,						/* 49 */
+	TIM5_IRQHandler,						/* 50 */
+	SPI3_IRQHandler,						/* 51 */
+	UART4_IRQHandler,						/* 52 */
+	UART5_IRQHandler,						/* 53 */
+	TIM6_DAC_IRQHandler,					/* 54 */
+	TIM7_IRQHandler,						/* 55 */
+	DMA2_Stream0_IRQHandler,				/* 56 */
+	DMA2_Stream1_IRQHandler,				/* 57 */
+	DMA2_Stream2_IRQHandler,				/* 58 */
+	DMA2_Stream3_IRQHandler,				/* 59 */
+	DMA2_Stream4_IRQHandler,				/* 60 */
+	ETH_IRQHandler,							/* 61 */
+	ETH_WKUP_IRQHandler,					/* 62 */
+	CAN2_TX_IRQHandler,						/* 63 */
+	CAN2_RX0_IRQHandler,					/* 64 */
+	CAN2_RX1_IRQHandler,					/* 65 */
+	CAN2_SCE_IRQHandler,					/* 66 */
+	OTG_FS_IRQHandler,						/* 67 */
+	DMA2_Stream5_IRQHandler,				/* 68 */
+	DMA2_Stream6_IRQHandler,				/* 69 */
+	DMA2_Stream7_IRQHandler,				/* 70 */
+	USART6_IRQHandler,						/* 71 */
+	I2C3_EV_IRQHandler,						/* 72 */
+	I2C3_ER_IRQHandler,						/* 73 */
+	OTG_HS_EP1_OUT_IRQHandler,				/* 74 */
+	OTG_HS_EP1_IN_IRQHandler,				/* 75 */
+	OTG_HS_WKUP_IRQHandler,					/* 76 */
+	OTG_HS_IRQHandler,						/* 77 */
+	DCMI_IRQHandler,						/* 78 */
+	CRYP_IRQHandler,						/* 79 */
+	HASH_RNG_IRQHandler,					/* 80 */
+	FPU_IRQHandler,							/* 81 */
+	sim_default_handler,					/* 82: reserved */
+	sim_default_handler,					/* 83: reserved */
+	sim_default_handler,					/* 84: reserved */
+	sim_default_handler,					/* 85: reserved */
+	sim_default_handler,					/* 86: reserved */
+	sim_default_handler,					/* 87: reserved */
+	LCD_TFT_IRQHandler,						/* 88 */
+	LCD_TFT_1_IRQHandler,					/* 89 */
+	sim_default_handler,					/* 90: reserved */
+	sim_default_handler,					/* 91: reserved */
+	sim_default_handler,					/* 92: reserved */
+	sim_default_handler,					/* 93: reserved */
+	sim_default_handler,					/* 94: reserved */
+	sim_default_handler,					/* 95: reserved */
+};